@@ -44,6 +44,76 @@ char * edgex_device_add_device
   edgex_error *err
 );
 
+/** A device to be added by edgex_device_add_devices. The fields are as for edgex_device_add_device. */
+
+typedef struct edgex_device_newdevice
+{
+  const char *name;
+  const char *description;
+  const edgex_strings *labels;
+  const char *profile_name;
+  edgex_protocols *protocols;
+  edgex_device_autoevents *autos;
+} edgex_device_newdevice;
+
+/** The outcome of adding a device with edgex_device_add_devices. */
+
+typedef struct edgex_device_addresult
+{
+  /** The id of the newly created or existing device, or NULL if an error occurred. To be freed by the caller */
+  char *id;
+  /** The reason the device could not be added */
+  edgex_error err;
+} edgex_device_addresult;
+
+/**
+ * @brief Add a number of devices to the EdgeX system. The requests to
+ *        core-metadata are made concurrently, and the devices are entered
+ *        into the service as submitted, without being read back.
+ * @param svc The device service.
+ * @param devices The devices to add.
+ * @param n The number of devices.
+ * @param results An array of n results, which receives the outcome for each device.
+ * @returns The number of devices which were added or were already present.
+ */
+
+unsigned edgex_device_add_devices
+(
+  edgex_device_service *svc,
+  const edgex_device_newdevice *devices,
+  unsigned n,
+  edgex_device_addresult *results
+);
+
+/** A device found by discovery, to be matched against the provision watchers. */
+
+typedef struct edgex_device_discovered
+{
+  /** The name for the device */
+  const char *name;
+  /** Optional description of the device */
+  const char *description;
+  /** Optional labels for the device */
+  const edgex_strings *labels;
+  /** Location of the device specified by one or more protocols */
+  edgex_protocols *protocols;
+} edgex_device_discovered;
+
+/**
+ * @brief Add devices found by discovery. Each device is matched against the
+ *        configured provision watchers, and if one matches it is added with
+ *        the watcher's device profile. Devices which match no watcher, or
+ *        which duplicate a known device (by name, or by the protocol property
+ *        the watcher matched on) are skipped.
+ * @param svc The device service.
+ * @param devices The discovered devices.
+ * @param n The number of devices.
+ * @returns The number of devices added.
+ */
+
+unsigned edgex_device_add_discovered_devices
+  (edgex_device_service *svc, const edgex_device_discovered *devices, unsigned n);
+
 /**
  * @brief Remove a device from EdgeX. The device will be deleted from the device service and from core-metadata.
  * @param svc The device service.
@@ -86,14 +156,17 @@ void edgex_device_update_device
 );
 
 /**
- * @brief Obtain a list of devices known to the system.
+ * @brief Obtain a list of devices known to the system. The devices are deep copies, owned by the caller; where
+ *        the devices are only to be read, edgex_device_acquire_devices avoids the copying.
  * @param svc The device service.
+ * @returns A list of devices. This should be freed using edgex_device_free_device.
  */
 
 edgex_device * edgex_device_devices (edgex_device_service *svc);
 
 /**
- * @brief Retrieve device information.
+ * @brief Retrieve device information. The device is a deep copy, owned by the caller; see also
+ *        edgex_device_acquire_device.
  * @param svc The device service.
  * @param id The device id.
  * @returns The requested device metadata or null if the device was not found.
@@ -102,7 +175,8 @@ edgex_device * edgex_device_devices (edgex_device_service *svc);
 edgex_device * edgex_device_get_device (edgex_device_service *svc, const char *id);
 
 /**
- * @brief Retrieve device information.
+ * @brief Retrieve device information. The device is a deep copy, owned by the caller; see also
+ *        edgex_device_acquire_device_byname.
  * @param svc The device service.
  * @param name The device name.
  * @returns The requested device metadata or null if the device was not found.
@@ -117,6 +191,84 @@ edgex_device * edgex_device_get_device_byname (edgex_device_service *svc, const
 
 void edgex_device_free_device (edgex_device *d);
 
+/*
+ * Shared device records. The following functions return the SDK's own
+ * records rather than copies, so that drivers may look devices up without
+ * allocating. A record must not be modified, and remains valid until it is
+ * released. While it is held, its strings and lists do not change, though
+ * its states and timestamps may be updated. Other changes to the device
+ * cause a new record to replace it for later lookups.
+ */
+
+/**
+ * @brief Obtain the devices known to the system, as shared records.
+ * @param svc The device service.
+ * @returns A NULL-terminated array of devices. This should be released using edgex_device_release_devices.
+ */
+
+edgex_device ** edgex_device_acquire_devices (edgex_device_service *svc);
+
+/**
+ * @brief Retrieve a device, as a shared record.
+ * @param svc The device service.
+ * @param id The device id.
+ * @returns The device, or null if it was not found. This should be released using edgex_device_release.
+ */
+
+edgex_device * edgex_device_acquire_device (edgex_device_service *svc, const char *id);
+
+/**
+ * @brief Retrieve a device, as a shared record.
+ * @param svc The device service.
+ * @param name The device name.
+ * @returns The device, or null if it was not found. This should be released using edgex_device_release.
+ */
+
+edgex_device * edgex_device_acquire_device_byname (edgex_device_service *svc, const char *name);
+
+/**
+ * @brief Find the devices which carry a label, as shared records.
+ * @param svc The device service.
+ * @param label The label to search for.
+ * @returns A NULL-terminated array of devices, or NULL if there are none. This should be released using
+ *          edgex_device_release_devices.
+ */
+
+edgex_device ** edgex_device_devices_bylabel (edgex_device_service *svc, const char *label);
+
+/**
+ * @brief Find the devices having a protocol property with a given value, eg all devices on a particular serial
+ *        port, as shared records.
+ * @param svc The device service.
+ * @param protocol The name of the protocol.
+ * @param property The name of the protocol property.
+ * @param value The value of the protocol property.
+ * @returns A NULL-terminated array of devices, or NULL if there are none. This should be released using
+ *          edgex_device_release_devices.
+ */
+
+edgex_device ** edgex_device_devices_byprotocol
+(
+  edgex_device_service *svc,
+  const char *protocol,
+  const char *property,
+  const char *value
+);
+
+/**
+ * @brief Release a shared device record.
+ * @param dev The device.
+ */
+
+void edgex_device_release (edgex_device *dev);
+
+/**
+ * @brief Release an array of shared device records.
+ * @param devs The array of devices. May be NULL.
+ */
+
+void edgex_device_release_devices (edgex_device **devs);
+
 /**
  * @brief Retrieve the device profiles currently known in the SDK.
  * @param svc The device service.
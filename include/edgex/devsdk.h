@@ -66,6 +66,11 @@ typedef struct edgex_device_commandrequest
   const edgex_nvpairs *attributes;
   /** Type of the data to be read or written */
   edgex_propertytype type;
+  /**
+   * The implementation's plan for the request, as set by its prepare
+   * handler when the profile was compiled, or NULL.
+   */
+  void *plan;
 } edgex_device_commandrequest;
 
 /**
@@ -261,4 +266,208 @@ void edgex_device_service_stop
  */
 
 void edgex_device_service_free (edgex_device_service *svc);
+
+/* Asynchronous get and put */
+
+/**
+ * @brief Opaque token identifying an asynchronous get or put request. It must
+ *        be passed to edgex_device_complete exactly once, when the request
+ *        has finished.
+ */
+
+typedef struct edgex_device_completion edgex_device_completion;
+
+/**
+ * @brief Asynchronous alternative to edgex_device_handle_get. The handler
+ *        should start the request and return; the readings are filled in
+ *        later (typically from the implementation's own I/O loop), and then
+ *        edgex_device_complete is called. The requests and readings remain
+ *        valid until then. Parameters are as for edgex_device_handle_get.
+ * @param completion The token to pass to edgex_device_complete.
+ */
+
+typedef void (*edgex_device_handle_get_async)
+(
+  void *impl,
+  const char *devname,
+  const edgex_protocols *protocols,
+  uint32_t nreadings,
+  const edgex_device_commandrequest *requests,
+  edgex_device_commandresult *readings,
+  edgex_device_completion *completion
+);
+
+/**
+ * @brief Asynchronous alternative to edgex_device_handle_put. The requests
+ *        and values remain valid until edgex_device_complete is called.
+ *        Parameters are as for edgex_device_handle_put.
+ * @param completion The token to pass to edgex_device_complete.
+ */
+
+typedef void (*edgex_device_handle_put_async)
+(
+  void *impl,
+  const char *devname,
+  const edgex_protocols *protocols,
+  uint32_t nvalues,
+  const edgex_device_commandrequest *requests,
+  const edgex_device_commandresult *values,
+  edgex_device_completion *completion
+);
+
+/**
+ * @brief Register asynchronous get and/or put handlers. These are used
+ *        instead of the corresponding handlers in edgex_device_callbacks,
+ *        which may then be NULL. Handlers must be registered before starting
+ *        the service. Outstanding requests must be completed before the
+ *        implementation's stop function returns.
+ * @param svc The device service.
+ * @param getter Asynchronous get handler, or NULL to use the synchronous one.
+ * @param putter Asynchronous put handler, or NULL to use the synchronous one.
+ */
+
+void edgex_device_register_async_handlers
+(
+  edgex_device_service *svc,
+  edgex_device_handle_get_async getter,
+  edgex_device_handle_put_async putter
+);
+
+/**
+ * @brief Signal the completion of an asynchronous request. May be called
+ *        from any thread, including from within the handler itself.
+ * @param completion The token passed to the handler.
+ * @param success true if the operation was successful, false otherwise.
+ */
+
+void edgex_device_complete (edgex_device_completion *completion, bool success);
+
+/**
+ * @brief Callback issued to write the same values to a number of devices in
+ *        a single operation, for protocols which support multicast or
+ *        broadcast writes. Used for PUT requests addressed to all devices,
+ *        once for the devices of each profile.
+ * @param impl The context data passed in when the service was created.
+ * @param ndevices The number of devices to which to write.
+ * @param devnames The names of the devices.
+ * @param protocols The locations of the devices, in the same order.
+ * @param nvalues The number of set operations requested.
+ * @param requests An array specifying the resources to which to write.
+ * @param values An array specifying the values to be written.
+ * @return true if the values were written to all of the devices. If false is
+ *         returned the SDK writes to each device with the put handler.
+ */
+
+typedef bool (*edgex_device_handle_put_group)
+(
+  void *impl,
+  uint32_t ndevices,
+  const char *const *devnames,
+  const edgex_protocols *const *protocols,
+  uint32_t nvalues,
+  const edgex_device_commandrequest *requests,
+  const edgex_device_commandresult *values
+);
+
+/**
+ * @brief Register a group put handler. It must be registered before
+ *        starting the service.
+ * @param svc The device service.
+ * @param putter The group put handler.
+ */
+
+void edgex_device_register_group_handler (edgex_device_service *svc, edgex_device_handle_put_group putter);
+
+/**
+ * @brief Callback issued once for each get and set command of a device
+ *        profile, when the profile is compiled. The implementation may parse
+ *        the attributes of the requests and work out how they are to be
+ *        carried out (eg merging contiguous register ranges into one block
+ *        read), setting the plan field of each request. The requests passed
+ *        to the get and put handlers then carry these plans. Requests from
+ *        more than one command may be passed to the get handler together.
+ * @param impl The context data passed in when the service was created.
+ * @param profile The name of the device profile.
+ * @param cmdname The name of the command.
+ * @param isget true for the get variant of the command, false for the set.
+ * @param nreqs The number of requests which make up the command.
+ * @param requests The requests, whose plan fields may be set.
+ * @return Data owned by the implementation for the command, with which the
+ *         release handler is called when the profile is freed, or NULL.
+ */
+
+typedef void * (*edgex_device_prepare_command)
+(
+  void *impl,
+  const char *profile,
+  const char *cmdname,
+  bool isget,
+  uint32_t nreqs,
+  edgex_device_commandrequest *requests
+);
+
+/**
+ * @brief Callback issued to release the data returned by the prepare handler.
+ *        This may happen after the stop handler has been called.
+ * @param impl The context data passed in when the service was created.
+ * @param plan The data returned by the prepare handler.
+ */
+
+typedef void (*edgex_device_release_command)
+(
+  void *impl,
+  void *plan
+);
+
+/**
+ * @brief Register handlers to prepare plans for the commands of each device
+ *        profile. They must be registered before starting the service.
+ * @param svc The device service.
+ * @param prepare The prepare handler.
+ * @param release The release handler, or NULL if nothing is to be released.
+ */
+
+void edgex_device_register_command_handlers
+(
+  edgex_device_service *svc,
+  edgex_device_prepare_command prepare,
+  edgex_device_release_command release
+);
+
+/**
+ * @brief Attach a release function to a Binary reading. The SDK will then
+ *        share the memory between the copies of the reading that it holds
+ *        rather than duplicating it, and will call the release function
+ *        instead of free() once the last copy is finished with. Binary
+ *        readings returned without a release function must have been
+ *        allocated with malloc().
+ * @param blob The blob, whose bytes and size fields have been set.
+ * @param release Function to call when the memory is no longer required.
+ * @param ctx Context data to pass to the release function.
+ */
+
+void edgex_blob_set_release
+  (edgex_blob *blob, void (*release) (void *ctx, uint8_t *bytes), void *ctx);
+
+/**
+ * @brief Allocate memory for the value of a String or Binary reading from the
+ *        SDK's buffer pool. Buffers are held in size classes and recycled
+ *        through per-thread caches, which avoids fragmenting the heap when
+ *        readings of many different sizes are returned over a long period.
+ *        Readings may be returned in buffers from this function or from
+ *        malloc(); the SDK frees either kind appropriately. This function
+ *        may be called from any thread.
+ * @param size The number of bytes required.
+ * @return The buffer, or NULL if memory could not be allocated.
+ */
+
+void *edgex_device_buffer_alloc (size_t size);
+
+/**
+ * @brief Free a buffer which was not passed to the SDK in a reading. Memory
+ *        obtained from malloc() may also be freed with this function.
+ * @param buf The buffer.
+ */
+
+void edgex_device_buffer_free (void *buf);
 #endif
@@ -88,8 +88,12 @@ typedef struct
   edgex_transformArg base;
   char *assertion;
   char *precision;
+  char *deadband;
+  char *deadbandPercent;
+  char *maxAge;
   char *mediaType;
   bool floatAsBinary;
+  bool floatShortest;
 } edgex_propertyvalue;
 
 typedef struct
@@ -124,6 +128,7 @@ typedef struct edgex_devicecommand
 } edgex_devicecommand;
 
 struct edgex_cmdinfo;
+struct edgex_cmdindex;
 struct edgex_autoimpl;
 
 typedef struct edgex_deviceprofile
@@ -140,6 +145,7 @@ typedef struct edgex_deviceprofile
   edgex_deviceresource *device_resources;
   edgex_devicecommand *device_commands;
   struct edgex_cmdinfo *cmdinfo;
+  struct edgex_cmdindex *cmdindex;
   struct edgex_deviceprofile *next;
 } edgex_deviceprofile;
 
@@ -148,6 +154,11 @@ typedef struct edgex_device_autoevents
   char *resource;
   char *frequency;
   bool onChange;
+  double deadband;
+  double deadbandPercent;
+  char *heartbeat;
+  char *cron;
+  bool align;
   struct edgex_autoimpl *impl;
   struct edgex_device_autoevents *next;
 } edgex_device_autoevents;
@@ -37,6 +37,35 @@ void edgex_device_post_readings
   edgex_device_commandresult *values
 );
 
+/** A set of readings, for posting with edgex_device_post_readings_batch. */
+
+typedef struct edgex_device_readingset
+{
+  /** The name of the device that the readings have come from */
+  const char *device_name;
+  /** Name of the resource or command which defines the Event */
+  const char *resource_name;
+  /** The readings */
+  edgex_device_commandresult *values;
+} edgex_device_readingset;
+
+/**
+ * @brief Post readings from a number of devices. This is equivalent to
+ *        calling edgex_device_post_readings for each set, but the devices are
+ *        looked up together and the resulting events are queued for
+ *        submission as a unit.
+ * @param svc The device service.
+ * @param sets An array of reading sets. Each will be combined into an Event.
+ * @param n The number of sets.
+ */
+
+void edgex_device_post_readings_batch
+(
+  edgex_device_service *svc,
+  const edgex_device_readingset *sets,
+  unsigned n
+);
+
 /**
  * @brief Callback function requesting that automatic events should begin. 
  *        These should be generated according to the schedule given, and posted
@@ -0,0 +1,209 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#ifndef _EDGEX_EVENTRING_H_
+#define _EDGEX_EVENTRING_H_ 1
+
+/**
+ * @file
+ * @brief This file defines the layout of the shared-memory event ring, and
+ *        the functions used by processes on the same host to read it.
+ *
+ * When the EventRing section of the configuration names a ring, the device
+ * service creates a POSIX shared memory object of that name and writes a
+ * record to it for each event generated. Records hold either the encoded
+ * event (JSON or CBOR) or the typed readings, according to the configured
+ * Format. Any number of readers may map the ring; records are read in place,
+ * and reading involves no system calls except to wait for new records.
+ *
+ * The ring does not wait for slow readers: when it is full the oldest records
+ * are overwritten. A reader detects this by calling edgex_eventring_valid
+ * once it has finished with a record, and records skipped are counted.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define EDGEX_EVENTRING_MAGIC 0x52455845
+#define EDGEX_EVENTRING_VERSION 1
+
+/** Records start at this offset from the header */
+
+#define EDGEX_EVENTRING_DATA 4096
+
+/** The kinds of record */
+
+typedef enum
+{
+  /** Filler to the end of the ring, to be skipped */
+  EDGEX_EVENTRING_PAD,
+  /** The event as JSON text */
+  EDGEX_EVENTRING_JSON,
+  /** The event as CBOR */
+  EDGEX_EVENTRING_CBOR,
+  /** An array of typed readings */
+  EDGEX_EVENTRING_READINGS
+} edgex_eventring_kind;
+
+/**
+ * The ring header, at the start of the shared memory object. The head, tail,
+ * notify and waiters fields are updated atomically by the writer and by
+ * waiting readers, and should only be accessed through the functions below.
+ */
+
+typedef struct edgex_eventring_header
+{
+  uint32_t magic;
+  uint32_t version;
+  /** Size of the record area in bytes */
+  uint64_t size;
+  /** Offset (modulo size) at which the next record will be written */
+  uint64_t head;
+  /** Offset of the oldest record which has not been overwritten */
+  uint64_t tail;
+  /** Incremented after each record is written; may be waited on as a futex */
+  uint32_t notify;
+  /** The number of readers waiting on notify */
+  uint32_t waiters;
+} edgex_eventring_header;
+
+/**
+ * A record. The device and source names follow it, each null-terminated,
+ * then the data aligned to 8 bytes. For JSON the data is null-terminated
+ * text, for CBOR it is the encoded event, and for READINGS it is count
+ * edgex_eventring_reading structures.
+ */
+
+typedef struct edgex_eventring_record
+{
+  /** Bytes from this record to the next, a multiple of 8 */
+  uint32_t length;
+  /** An edgex_eventring_kind */
+  uint16_t kind;
+  /** The number of readings */
+  uint16_t count;
+  /** Records are numbered consecutively from 1 */
+  uint64_t seq;
+  /** The event's origin timestamp */
+  uint64_t origin;
+  /** Length of the device name, including the terminator */
+  uint16_t devlen;
+  /** Length of the resource or command name, including the terminator */
+  uint16_t srclen;
+  /** Length of the data */
+  uint32_t datalen;
+} edgex_eventring_record;
+
+/**
+ * A typed reading. The resource name follows it, null-terminated, then for
+ * String and Binary readings the value (strings are null-terminated).
+ */
+
+typedef struct edgex_eventring_reading
+{
+  /** Bytes from this reading to the next, a multiple of 8 */
+  uint32_t length;
+  /** An edgex_propertytype */
+  uint16_t type;
+  /** Length of the resource name, including the terminator */
+  uint16_t namelen;
+  uint64_t origin;
+  /** For String and Binary readings, the length of the value */
+  uint64_t size;
+  union
+  {
+    bool b;
+    uint8_t ui8;
+    uint16_t ui16;
+    uint32_t ui32;
+    uint64_t ui64;
+    int8_t i8;
+    int16_t i16;
+    int32_t i32;
+    int64_t i64;
+    float f32;
+    double f64;
+  } value;
+} edgex_eventring_reading;
+
+typedef struct edgex_eventring_reader edgex_eventring_reader;
+
+/**
+ * @brief Map an event ring for reading. Reading starts with the next record
+ *        to be written.
+ * @param name The name of the ring, as configured in the device service.
+ * @return The reader, or NULL if the ring does not exist or is not valid.
+ */
+
+edgex_eventring_reader *edgex_eventring_open (const char *name);
+
+/**
+ * @brief Obtain the next record, without waiting.
+ * @param r The reader.
+ * @return The record, which is valid until the next call, or NULL if there
+ *         are no new records.
+ */
+
+const edgex_eventring_record *edgex_eventring_next (edgex_eventring_reader *r);
+
+/**
+ * @brief Check that the record last returned by edgex_eventring_next has not
+ *        been overwritten while it was being read. If it has, anything read
+ *        from it should be discarded.
+ * @param r The reader.
+ * @return true if the record was intact.
+ */
+
+bool edgex_eventring_valid (edgex_eventring_reader *r);
+
+/**
+ * @brief Wait for a record to be written.
+ * @param r The reader.
+ * @param timeout The maximum time to wait, in milliseconds.
+ * @return true if there is a new record to read.
+ */
+
+bool edgex_eventring_wait (edgex_eventring_reader *r, uint32_t timeout);
+
+/**
+ * @brief The number of records which were overwritten before they could be
+ *        read.
+ */
+
+uint64_t edgex_eventring_lost (const edgex_eventring_reader *r);
+
+/** The device name in a record */
+
+const char *edgex_eventring_device (const edgex_eventring_record *rec);
+
+/** The resource or command name in a record */
+
+const char *edgex_eventring_source (const edgex_eventring_record *rec);
+
+/** The data in a record */
+
+const void *edgex_eventring_data (const edgex_eventring_record *rec);
+
+/** The reading following rd in a READINGS record, or the first if rd is NULL. Returns NULL after the last */
+
+const edgex_eventring_reading *edgex_eventring_reading_next
+  (const edgex_eventring_record *rec, const edgex_eventring_reading *rd);
+
+/** The resource name of a reading */
+
+const char *edgex_eventring_reading_name (const edgex_eventring_reading *rd);
+
+/** The value of a String or Binary reading */
+
+const void *edgex_eventring_reading_data (const edgex_eventring_reading *rd);
+
+/** Unmap the ring */
+
+void edgex_eventring_close (edgex_eventring_reader *r);
+
+#endif
@@ -25,7 +25,8 @@
 /**
  * @brief A function which is called when the configuration changes.
  * @param updatectx A context specified when this function was registered.
- * @param newconfig The updated configuration.
+ * @param newconfig The configuration values which have changed. Registry
+ *                  implementations may pass unchanged values as well.
  */
 
 typedef void (*edgex_registry_updatefn) (void *updatectx, const edgex_nvpairs *newconfig);
@@ -0,0 +1,148 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#include "admission.h"
+#include "map.h"
+#include "edgex-time.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <time.h>
+
+/* Counts are kept for keys with requests in progress, and removed when they reach zero */
+
+struct edgex_admission_t
+{
+  pthread_mutex_t lock;
+  pthread_cond_t done;
+  uint32_t max;
+  uint32_t perkey;
+  uint32_t queuetime;
+  uint32_t inflight;
+  uint64_t admitted;
+  uint64_t shed;
+  edgex_map_int keys;
+  edgex_histogram wait;
+};
+
+edgex_admission_t *edgex_admission_alloc (uint32_t max, uint32_t perkey, uint32_t queuetime)
+{
+  pthread_condattr_t attr;
+  edgex_admission_t *adm = calloc (1, sizeof (edgex_admission_t));
+
+  pthread_mutex_init (&adm->lock, NULL);
+  pthread_condattr_init (&attr);
+  pthread_condattr_setclock (&attr, CLOCK_MONOTONIC);
+  pthread_cond_init (&adm->done, &attr);
+  pthread_condattr_destroy (&attr);
+  adm->max = max;
+  adm->perkey = perkey;
+  adm->queuetime = queuetime;
+  edgex_map_init (&adm->keys);
+  return adm;
+}
+
+static bool admission_full (edgex_admission_t *adm, const char *key, int **count)
+{
+  *count = *key ? edgex_map_get (&adm->keys, key) : NULL;
+  return (adm->max && adm->inflight >= adm->max) || (*count && adm->perkey && (uint32_t)**count >= adm->perkey);
+}
+
+bool edgex_admission_enter (edgex_admission_t *adm, const char *key)
+{
+  struct timespec deadline;
+  int *count;
+  uint64_t start = edgex_device_nanotime_monotonic ();
+  bool ok = true;
+
+  clock_gettime (CLOCK_MONOTONIC, &deadline);
+  deadline.tv_sec += adm->queuetime / 1000;
+  deadline.tv_nsec += (adm->queuetime % 1000) * 1000000;
+  if (deadline.tv_nsec >= 1000000000)
+  {
+    deadline.tv_sec++;
+    deadline.tv_nsec -= 1000000000;
+  }
+
+  pthread_mutex_lock (&adm->lock);
+  while (ok && admission_full (adm, key, &count))
+  {
+    ok = (pthread_cond_timedwait (&adm->done, &adm->lock, &deadline) != ETIMEDOUT);
+  }
+  if (!ok && !admission_full (adm, key, &count))
+  {
+    ok = true;
+  }
+  if (ok)
+  {
+    adm->inflight++;
+    adm->admitted++;
+    if (count)
+    {
+      (*count)++;
+    }
+    else if (*key)
+    {
+      edgex_map_set (&adm->keys, key, 1);
+    }
+  }
+  else
+  {
+    adm->shed++;
+  }
+  pthread_mutex_unlock (&adm->lock);
+  if (ok)
+  {
+    edgex_histogram_record (&adm->wait, (edgex_device_nanotime_monotonic () - start) / 1000);
+  }
+  return ok;
+}
+
+void edgex_admission_leave (edgex_admission_t *adm, const char *key)
+{
+  pthread_mutex_lock (&adm->lock);
+  adm->inflight--;
+  if (*key)
+  {
+    int *count = edgex_map_get (&adm->keys, key);
+    if (count && --(*count) == 0)
+    {
+      edgex_map_remove (&adm->keys, key);
+    }
+  }
+  pthread_cond_broadcast (&adm->done);
+  pthread_mutex_unlock (&adm->lock);
+}
+
+uint32_t edgex_admission_retryafter (const edgex_admission_t *adm)
+{
+  uint32_t secs = (adm->queuetime + 999) / 1000;
+  return secs ? secs : 1;
+}
+
+void edgex_admission_getstats (edgex_admission_t *adm, edgex_admission_stats *stats)
+{
+  pthread_mutex_lock (&adm->lock);
+  stats->inflight = adm->inflight;
+  stats->admitted = adm->admitted;
+  stats->shed = adm->shed;
+  pthread_mutex_unlock (&adm->lock);
+  stats->wait = &adm->wait;
+}
+
+void edgex_admission_free (edgex_admission_t *adm)
+{
+  if (adm)
+  {
+    edgex_map_deinit (&adm->keys);
+    pthread_cond_destroy (&adm->done);
+    pthread_mutex_destroy (&adm->lock);
+    free (adm);
+  }
+}
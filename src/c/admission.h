@@ -0,0 +1,56 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#ifndef _EDGEX_DEVICE_ADMISSION_H_
+#define _EDGEX_DEVICE_ADMISSION_H_ 1
+
+#include "latency.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Admission control for REST requests which run commands. At most a given
+ * number of requests are in progress at once, overall and for any one key
+ * (the device id, for command requests); 0 means no limit. A request beyond
+ * either limit waits for up to the queue time for another to finish, and is
+ * otherwise refused. The time taken to admit each request is recorded (in
+ * microseconds).
+ */
+
+#define EDGEX_ADMISSION_DEFAULT_QUEUETIME 1000
+
+typedef struct edgex_admission_t edgex_admission_t;
+
+typedef struct edgex_admission_stats
+{
+  uint32_t inflight;
+  uint64_t admitted;
+  uint64_t shed;
+  edgex_histogram *wait;
+} edgex_admission_stats;
+
+/* Limits are on requests overall and per key. The queue time is in milliseconds */
+
+edgex_admission_t *edgex_admission_alloc (uint32_t max, uint32_t perkey, uint32_t queuetime);
+
+/* Wait to admit a request. The key may be empty, in which case only the overall limit applies */
+
+bool edgex_admission_enter (edgex_admission_t *adm, const char *key);
+
+void edgex_admission_leave (edgex_admission_t *adm, const char *key);
+
+/* The number of seconds after which a refused request may be retried, for the Retry-After header */
+
+uint32_t edgex_admission_retryafter (const edgex_admission_t *adm);
+
+void edgex_admission_getstats (edgex_admission_t *adm, edgex_admission_stats *stats);
+
+void edgex_admission_free (edgex_admission_t *adm);
+
+#endif
@@ -0,0 +1,152 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#include "arena.h"
+#include "parson.h"
+#include "memstats.h"
+
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+
+/* Blocks double in size from ARENA_FIRSTBLOCK up to ARENA_MAXBLOCK, or are larger if a single allocation needs it */
+
+#define ARENA_FIRSTBLOCK 16384
+#define ARENA_MAXBLOCK (1024 * 1024)
+
+/* One block of up to this size is kept for the thread's next scope */
+
+#define ARENA_KEEPBLOCK 65536
+
+#define ARENA_ALIGN _Alignof (max_align_t)
+
+typedef struct arena_block
+{
+  struct arena_block *next;
+  size_t size;
+  size_t used;
+  _Alignas (max_align_t) char data[];
+} arena_block;
+
+typedef struct arena_state
+{
+  arena_block *blocks;
+  arena_block *spare;
+  unsigned depth;
+} arena_state;
+
+static _Thread_local arena_state arena;
+static pthread_once_t arena_once = PTHREAD_ONCE_INIT;
+
+/* Used only to free the spare block when a thread exits */
+
+static pthread_key_t arena_key;
+
+static void *arena_malloc (size_t size)
+{
+  arena_block *b = arena.blocks;
+  void *result;
+
+  if (arena.depth == 0)
+  {
+    return malloc (size);
+  }
+  size = (size + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+  if (b == NULL || b->size - b->used < size)
+  {
+    size_t bsize = b ? b->size * 2 : ARENA_FIRSTBLOCK;
+    if (bsize > ARENA_MAXBLOCK)
+    {
+      bsize = ARENA_MAXBLOCK;
+    }
+    if (bsize < size)
+    {
+      bsize = size;
+    }
+    b = malloc (sizeof (arena_block) + bsize);
+    if (b == NULL)
+    {
+      return NULL;
+    }
+    edgex_memstats_alloc (EDGEX_MEM_PARSON, sizeof (arena_block) + bsize);
+    b->size = bsize;
+    b->used = 0;
+    b->next = arena.blocks;
+    arena.blocks = b;
+  }
+  result = b->data + b->used;
+  b->used += size;
+  return result;
+}
+
+static void arena_free (void *ptr)
+{
+  if (arena.depth)
+  {
+    uintptr_t p = (uintptr_t)ptr;
+    for (const arena_block *b = arena.blocks; b; b = b->next)
+    {
+      if (p >= (uintptr_t)b->data && p < (uintptr_t)b->data + b->size)
+      {
+        return;
+      }
+    }
+  }
+  free (ptr);
+}
+
+static void arena_block_free (void *p)
+{
+  arena_block *b = (arena_block *)p;
+  edgex_memstats_free (EDGEX_MEM_PARSON, sizeof (arena_block) + b->size);
+  free (b);
+}
+
+static void arena_init (void)
+{
+  pthread_key_create (&arena_key, arena_block_free);
+  json_set_allocation_functions (arena_malloc, arena_free);
+}
+
+void edgex_arena_begin (void)
+{
+  pthread_once (&arena_once, arena_init);
+  if (arena.depth++ == 0 && arena.spare)
+  {
+    arena.blocks = arena.spare;
+    arena.spare = NULL;
+  }
+}
+
+void edgex_arena_end (void)
+{
+  if (--arena.depth == 0)
+  {
+    arena_block *keep = NULL;
+    arena_block *b = arena.blocks;
+    while (b)
+    {
+      arena_block *next = b->next;
+      if (keep == NULL && b->size <= ARENA_KEEPBLOCK)
+      {
+        keep = b;
+        keep->next = NULL;
+        keep->used = 0;
+      }
+      else
+      {
+        arena_block_free (b);
+      }
+      b = next;
+    }
+    arena.blocks = NULL;
+    arena.spare = keep;
+    pthread_setspecific (arena_key, keep);
+  }
+}
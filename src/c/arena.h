@@ -0,0 +1,28 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#ifndef _EDGEX_DEVICE_ARENA_H_
+#define _EDGEX_DEVICE_ARENA_H_ 1
+
+/*
+ * Arena allocation for parson. Between edgex_arena_begin and edgex_arena_end,
+ * memory allocated by parson on the calling thread is taken from blocks which
+ * are released together at the end, and freeing it does nothing. Outside such
+ * a scope, parson uses malloc and free as normal.
+ *
+ * Nothing allocated by parson within a scope may be used after it ends, or
+ * passed to another thread: strings which are to be kept must be copied.
+ * Scopes may be nested, in which case memory is released at the end of the
+ * outermost one.
+ */
+
+void edgex_arena_begin (void);
+
+void edgex_arena_end (void);
+
+#endif
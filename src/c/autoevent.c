@@ -15,10 +15,18 @@
 #include "parson.h"
 #include "edgex-rest.h"
 #include "correlation.h"
-#include "metadata.h"
+#include "edgex-time.h"
+#include "readcache.h"
+#include "driver.h"
+#include "cron.h"
+#include "recycle.h"
 
+#include <math.h>
+#include <stdio.h>
 #include <microhttpd.h>
 
+struct ae_group;
+
 typedef struct edgex_autoimpl
 {
   edgex_device_service *svc;
@@ -30,107 +38,408 @@ typedef struct edgex_autoimpl
   void *handle;
   atomic_uint_fast32_t refs;
   bool onChange;
+  double *deadband;
+  double *deadbandPct;
+  uint64_t heartbeat;
+  uint64_t lastsent;
+  struct ae_group *group;
+  bool grouped;
+  bool align;
+  edgex_cron *cron;
+  atomic_uint_fast64_t nextrun;
+  atomic_uint_fast64_t due;
 } edgex_autoimpl;
 
-struct sfxstruct
+/*
+ * AutoEvents on a device which share an interval may be grouped, so that a
+ * single driver read covers all of them. The group belongs to its first
+ * member, which alone is scheduled; it holds references to the others. The
+ * requests of the members are merged, with each resource read only once, and
+ * index maps each member's requests to their position in the merged list.
+ */
+
+typedef struct ae_group
 {
-  const char *str;
-  uint64_t factor;
-};
+  unsigned nmembers;
+  edgex_autoimpl **members;
+  unsigned **index;
+  unsigned nreqs;
+  edgex_device_commandrequest *reqs;
+} ae_group;
 
-static struct sfxstruct suffixes[] =
-  { { "ms", 1 }, { "s", 1000 }, { "m", 60000 }, { "h", 3600000 }, { NULL, 0 } };
+static void edgex_autoimpl_release (edgex_autoimpl *ai);
 
-static uint64_t parseTime (const char *spec)
+static void ae_group_free (ae_group *g)
 {
-  char *fend;
-  uint64_t fnum = strtoul (spec, &fend, 10);
-  for (int i = 0; suffixes[i].str; i++)
+  for (unsigned m = 0; m < g->nmembers; m++)
   {
-    if (strcmp (fend, suffixes[i].str) == 0)
+    if (m)
     {
-      return fnum * suffixes[i].factor;
+      edgex_autoimpl_release (g->members[m]);
     }
+    free (g->index[m]);
   }
-  return 0;
+  free (g->index);
+  free (g->members);
+  free (g->reqs);
+  free (g);
 }
 
 static void edgex_autoimpl_release (edgex_autoimpl *ai)
 {
   if (atomic_fetch_add (&ai->refs, -1) == 1)
   {
+    if (ai->group)
+    {
+      ae_group_free (ai->group);
+    }
     free (ai->device);
     edgex_protocols_free (ai->protocols);
     edgex_device_commandresult_free (ai->last, ai->resource->nreqs);
+    free (ai->deadband);
+    free (ai->deadbandPct);
+    free (ai->cron);
     free (ai);
   }
 }
 
-static void ae_runner (void *p)
+static bool ae_numeric (const edgex_device_commandresult *res, double *val)
 {
-  edgex_autoimpl *ai = (edgex_autoimpl *)p;
-  atomic_fetch_add (&ai->refs, 1);
+  switch (res->type)
+  {
+    case Uint8: *val = res->value.ui8_result; return true;
+    case Uint16: *val = res->value.ui16_result; return true;
+    case Uint32: *val = res->value.ui32_result; return true;
+    case Uint64: *val = res->value.ui64_result; return true;
+    case Int8: *val = res->value.i8_result; return true;
+    case Int16: *val = res->value.i16_result; return true;
+    case Int32: *val = res->value.i32_result; return true;
+    case Int64: *val = res->value.i64_result; return true;
+    case Float32: *val = res->value.f32_result; return true;
+    case Float64: *val = res->value.f64_result; return true;
+    default: return false;
+  }
+}
 
-  edgex_device *dev = edgex_devmap_device_byname (ai->svc->devices, ai->device);
-  if (dev)
+/*
+ * Determine whether new readings differ significantly from those last sent.
+ * Numeric readings are considered unchanged if they differ by no more than
+ * the larger of the absolute and percentage deadbands for the resource.
+ */
+
+static bool ae_changed (const edgex_autoimpl *ai, const edgex_device_commandresult *results)
+{
+  for (unsigned i = 0; i < ai->resource->nreqs; i++)
   {
-    if (dev->adminState == LOCKED || dev->operatingState == DISABLED)
-    {
-      edgex_device_release (dev);
-      edgex_autoimpl_release (ai);
-      return;
-    }
-    edgex_device_alloc_crlid (NULL);
-    iot_log_info (ai->svc->logger, "AutoEvent: %s/%s", ai->device, ai->resource->name);
-    edgex_device_commandresult *results = calloc (ai->resource->nreqs, sizeof (edgex_device_commandresult));
+    double current, last;
     if
     (
-      ai->svc->userfns.gethandler
-        (ai->svc->userdata, dev->name, dev->protocols, ai->resource->nreqs, ai->resource->reqs, results)
+      (ai->deadband[i] || ai->deadbandPct[i]) && results[i].type == ai->last[i].type &&
+      ae_numeric (&results[i], &current) && ae_numeric (&ai->last[i], &last)
     )
     {
-      edgex_device_commandresult *resdup = NULL;
-      if (!(ai->onChange && ai->last && edgex_device_commandresult_equal (results, ai->last, ai->resource->nreqs)))
+      double band = fmax (ai->deadband[i], fabs (last) * ai->deadbandPct[i] / 100.0);
+      if (fabs (current - last) > band)
       {
-        edgex_error err = EDGEX_OK;
-        if (ai->onChange)
+        return true;
+      }
+    }
+    else if (!edgex_device_commandresult_equal (&results[i], &ai->last[i], 1))
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
+/* Process the readings taken for an autoevent (ok indicates whether they were obtained) */
+
+static void ae_process (edgex_autoimpl *ai, edgex_device *dev, edgex_device_commandresult *results, bool ok)
+{
+  if (ok)
+  {
+    edgex_device_commandresult *resdup = NULL;
+    uint64_t now = edgex_device_millitime ();
+    if (ai->resource->cached)
+    {
+      edgex_readcache_put (ai->svc->readcache, dev->name, ai->resource, results);
+    }
+    bool due = ai->heartbeat && now - ai->lastsent >= ai->heartbeat;
+    if (!(ai->onChange && ai->last && !due && !ae_changed (ai, results)))
+    {
+      edgex_error err = EDGEX_OK;
+      if (ai->onChange)
+      {
+        resdup = edgex_device_commandresult_dup (results, ai->resource->nreqs);
+      }
+      edgex_latency_entry *lat = edgex_latency_lookup (ai->svc->latency, dev->name, ai->resource->name);
+      edgex_event_cooked *event = edgex_data_process_event
+      (
+        dev->name,
+        ai->resource,
+        results,
+        ai->svc->config.device.datatransform,
+        ai->svc->config.device.shortestfloats,
+        ai->svc->config.device.streamthreshold,
+        edgex_batch_compact (ai->svc->aebatch ? ai->svc->aebatch : ai->svc->batch),
+        lat,
+        ai->svc->eventring
+      );
+      if (event)
+      {
+        if (ai->svc->aebatch)
         {
-          resdup = edgex_device_commandresult_dup (results, ai->resource->nreqs);
+          edgex_batch_add (ai->svc->aebatch, dev->name, event);
         }
-        edgex_event_cooked *event =
-          edgex_data_process_event (dev->name, ai->resource, results, ai->svc->config.device.datatransform);
-        if (event)
+        else
         {
-          edgex_data_client_add_event (ai->svc->logger, &ai->svc->config.endpoints, event, &err);
-          if (err.code == 0)
-          {
-            if (ai->onChange)
-            {
-              edgex_device_commandresult_free (ai->last, ai->resource->nreqs);
-              ai->last = resdup;
-              resdup = NULL;
-            }
-          }
-          else
+          uint64_t start = edgex_latency_start (lat);
+          edgex_data_submit_event (ai->svc, dev->name, event, &err);
+          edgex_latency_record (lat, EDGEX_LATENCY_POST, start);
+        }
+        if (err.code == 0)
+        {
+          if (ai->onChange)
           {
-            iot_log_error (ai->svc->logger, "AutoEvent: unable to push new event");
+            edgex_device_commandresult_free (ai->last, ai->resource->nreqs);
+            ai->last = resdup;
+            resdup = NULL;
+            ai->lastsent = now;
           }
-          edgex_event_cooked_free (event);
         }
         else
         {
-          iot_log_error (ai->svc->logger, "Assertion failed for device %s. Disabling.", dev->name);
-          edgex_metadata_client_set_device_opstate
-            (ai->svc->logger, &ai->svc->config.endpoints, dev->id, DISABLED, &err);
+          iot_log_error (ai->svc->logger, "AutoEvent: unable to push new event");
         }
+        edgex_event_cooked_free (event);
       }
-      edgex_device_commandresult_free (resdup, ai->resource->nreqs);
+      else
+      {
+        iot_log_error (ai->svc->logger, "Assertion failed for device %s. Disabling.", dev->name);
+        edgex_opstate_set (ai->svc->opqueue, dev, DISABLED);
+      }
+    }
+    edgex_device_commandresult_free (resdup, ai->resource->nreqs);
+  }
+  else
+  {
+    iot_log_error (ai->svc->logger, "AutoEvent: Driver for %s failed on GET", dev->name);
+  }
+  edgex_recycle_results_free (results, ai->resource->nreqs);
+}
+
+/*
+ * Process the readings taken for a group of autoevents. Each member is given
+ * copies of the readings for its own resources, and processed as if it had
+ * been read separately.
+ */
+
+static void ae_group_process (edgex_autoimpl *ai, edgex_device *dev, edgex_device_commandresult *results, bool ok)
+{
+  ae_group *g = ai->group;
+  if (ok)
+  {
+    edgex_device_origin_capture ();
+    for (unsigned m = 0; m < g->nmembers; m++)
+    {
+      edgex_autoimpl *member = g->members[m];
+      edgex_device_commandresult *split = edgex_recycle_results (member->resource->nreqs);
+      for (unsigned i = 0; i < member->resource->nreqs; i++)
+      {
+        edgex_device_commandresult *res = &results[g->index[m][i]];
+        edgex_device_commandresult *copy = edgex_device_commandresult_dup (res, 1);
+        split[i] = *copy;
+        split[i].origin = res->origin;
+        free (copy);
+      }
+      ae_process (member, dev, split, true);
+    }
+    edgex_device_origin_release ();
+  }
+  else
+  {
+    iot_log_error (ai->svc->logger, "AutoEvent: Driver for %s failed on GET", dev->name);
+  }
+  edgex_recycle_results_free (results, g->nreqs);
+}
+
+static void ae_dispatch (edgex_autoimpl *ai, edgex_device *dev, edgex_device_commandresult *results, bool ok)
+{
+  if (ai->svc->aecircuit)
+  {
+    edgex_circuit_result (ai->svc->aecircuit, dev->name, ai->interval, ok);
+  }
+  if (ai->group)
+  {
+    ae_group_process (ai, dev, results, ok);
+  }
+  else
+  {
+    ae_process (ai, dev, results, ok);
+  }
+}
+
+/* Driver times for a group are recorded against the leader's resource */
+
+static edgex_latency_entry *ae_latency (edgex_autoimpl *ai, edgex_device *dev)
+{
+  return edgex_latency_lookup (ai->svc->latency, dev->name, ai->resource->name);
+}
+
+/*
+ * An autoevent read which the implementation completes asynchronously. The
+ * completion passes the results to the thread pool for processing, so that
+ * no thread is occupied while the read is in progress.
+ */
+
+static void ae_traceend (edgex_autoimpl *ai, edgex_device *dev)
+{
+  char name[128] = "";
+  if (edgex_trace_start ())
+  {
+    snprintf (name, sizeof (name), "AutoEvent %s/%s", dev->name, ai->resource->name);
+  }
+  edgex_trace_end (EDGEX_TRACE_AUTOEVENT, name);
+}
+
+typedef struct ae_read
+{
+  edgex_autoimpl *ai;
+  edgex_device *dev;
+  edgex_device_commandresult *results;
+  char *crlid;
+  edgex_trace_t *trace;
+  uint64_t start;
+  uint64_t tstart;
+  bool success;
+} ae_read;
+
+static void ae_readjob (void *p)
+{
+  ae_read *rd = (ae_read *)p;
+
+  edgex_device_alloc_crlid (rd->crlid);
+  edgex_trace_resume (rd->trace);
+  edgex_trace_span (EDGEX_TRACE_DRIVER, rd->tstart);
+  ae_dispatch (rd->ai, rd->dev, rd->results, rd->success);
+  ae_traceend (rd->ai, rd->dev);
+  edgex_device_free_crlid ();
+  edgex_device_release (rd->dev);
+  edgex_autoimpl_release (rd->ai);
+  free (rd->crlid);
+  free (rd);
+}
+
+static void ae_readdone (void *p, bool success)
+{
+  ae_read *rd = (ae_read *)p;
+  rd->success = success;
+  edgex_latency_record (ae_latency (rd->ai, rd->dev), EDGEX_LATENCY_DRIVER, rd->start);
+  edgex_pool_add_work (rd->ai->svc->aepool, ae_readjob, rd);
+}
+
+/*
+ * Cron autoevents are run by a timer at the resolution of their expression,
+ * aligned to the clock: only runs at the matching times go ahead. Allowance is
+ * made for the timer firing a little early or late.
+ */
+
+static bool ae_crondue (edgex_autoimpl *ai)
+{
+  uint64_t now = edgex_device_millitime ();
+  uint64_t next = atomic_load (&ai->nextrun);
+  if (now + ai->interval / 2 < next)
+  {
+    return false;
+  }
+  if (!atomic_compare_exchange_strong (&ai->nextrun, &next, edgex_cron_next (ai->cron, now > next ? now : next)))
+  {
+    return false;
+  }
+  edgex_timing_record (EDGEX_TIMING_AUTOEVENT_LAG, now > next ? (now - next) * 1000 : 0);
+  return true;
+}
+
+/*
+ * Record how late an autoevent has run, and when it is next due. If runs
+ * have been missed, the next one is due at the following multiple of the
+ * interval from the original schedule.
+ */
+
+static void ae_lag (edgex_autoimpl *ai)
+{
+  uint64_t now = edgex_device_millitime ();
+  uint64_t due = atomic_load (&ai->due);
+  uint64_t next = due + ai->interval;
+  if (next <= now)
+  {
+    next = now + ai->interval - (now - due) % ai->interval;
+  }
+  atomic_store (&ai->due, next);
+  edgex_timing_record (EDGEX_TIMING_AUTOEVENT_LAG, now > due ? (now - due) * 1000 : 0);
+}
+
+static void ae_runner (void *p)
+{
+  edgex_autoimpl *ai = (edgex_autoimpl *)p;
+  if (ai->cron && !ae_crondue (ai))
+  {
+    return;
+  }
+  if (!ai->cron)
+  {
+    ae_lag (ai);
+  }
+  edgex_counter_inc (EDGEX_COUNTER_AUTOEVENTS);
+  atomic_fetch_add (&ai->refs, 1);
+
+  edgex_device *dev = edgex_devmap_device_byname (ai->svc->devices, ai->device);
+  if (dev)
+  {
+    if
+    (
+      dev->adminState == LOCKED || dev->operatingState == DISABLED ||
+      (ai->svc->aecircuit && !edgex_circuit_allow (ai->svc->aecircuit, dev->name))
+    )
+    {
+      edgex_device_release (dev);
+      edgex_autoimpl_release (ai);
+      return;
+    }
+    unsigned nreqs = ai->group ? ai->group->nreqs : ai->resource->nreqs;
+    const edgex_device_commandrequest *reqs = ai->group ? ai->group->reqs : ai->resource->reqs;
+    edgex_device_alloc_crlid (NULL);
+    edgex_trace_begin ();
+    if (ai->group)
+    {
+      iot_log_info (ai->svc->logger, "AutoEvent: %s (%u grouped)", ai->device, ai->group->nmembers);
     }
     else
     {
-      iot_log_error (ai->svc->logger, "AutoEvent: Driver for %s failed on GET", dev->name);
+      iot_log_info (ai->svc->logger, "AutoEvent: %s/%s", ai->device, ai->resource->name);
+    }
+    edgex_device_commandresult *results = edgex_recycle_results (nreqs);
+    if (edgex_driver_async_get (ai->svc))
+    {
+      ae_read *rd = malloc (sizeof (ae_read));
+      rd->ai = ai;
+      rd->dev = dev;
+      rd->results = results;
+      rd->crlid = strdup (edgex_device_get_crlid ());
+      rd->success = false;
+      rd->start = edgex_latency_start (ae_latency (ai, dev));
+      rd->tstart = edgex_trace_start ();
+      rd->trace = edgex_trace_suspend ();
+      edgex_device_free_crlid ();
+      edgex_driver_get_async (ai->svc, EDGEX_QOS_AUTOEVENT, dev, nreqs, reqs, results, ae_readdone, rd);
+      return;
     }
-    edgex_device_commandresult_free (results, ai->resource->nreqs);
+    edgex_latency_entry *lat = ae_latency (ai, dev);
+    uint64_t start = edgex_latency_start (lat);
+    bool ok = edgex_driver_get (ai->svc, EDGEX_QOS_AUTOEVENT, dev, nreqs, reqs, results);
+    edgex_latency_record (lat, EDGEX_LATENCY_DRIVER, start);
+    ae_dispatch (ai, dev, results, ok);
+    ae_traceend (ai, dev);
     edgex_device_free_crlid ();
     edgex_device_release (dev);
   }
@@ -138,11 +447,125 @@ static void ae_runner (void *p)
   {
     iot_log_error
       (ai->svc->logger, "Autoevent fired for unknown device %s", ai->device);
-    iot_schedule_remove (ai->svc->scheduler, ai->handle);
+    if (ai->svc->aewheel)
+    {
+      edgex_timerwheel_remove (ai->svc->aewheel, ai->handle);
+    }
+    else
+    {
+      iot_schedule_remove (ai->svc->scheduler, ai->handle);
+    }
   }
   edgex_autoimpl_release (ai);
 }
 
+/*
+ * Delay before the first run of an autoevent on the timing wheel. Aligned and
+ * cron autoevents are started at the next multiple of their interval on the
+ * wall clock. Otherwise when spreading, this is an offset within the interval
+ * derived from the device and resource names, so that it is stable and evenly
+ * distributed.
+ */
+
+static uint64_t ae_phase (const edgex_autoimpl *ai)
+{
+  uint32_t hash = 2166136261u;
+  if (ai->align || ai->cron)
+  {
+    return ai->interval - edgex_device_millitime () % ai->interval;
+  }
+  if (!ai->svc->config.device.aespread)
+  {
+    return ai->interval;
+  }
+  for (const char *c = ai->device; *c; c++)
+  {
+    hash = (hash ^ (unsigned char)*c) * 16777619u;
+  }
+  hash = (hash ^ '/') * 16777619u;
+  for (const char *c = ai->resource->name; *c; c++)
+  {
+    hash = (hash ^ (unsigned char)*c) * 16777619u;
+  }
+  return hash % ai->interval;
+}
+
+static bool ae_sameschedule (const edgex_autoimpl *a, const edgex_autoimpl *b)
+{
+  return a->interval == b->interval && a->align == b->align && edgex_cron_equal (a->cron, b->cron);
+}
+
+/*
+ * Form a group from the autoevent given and any later ones on the same
+ * device with the same interval, if there are such.
+ */
+
+static void ae_group_create (edgex_device_autoevents *first)
+{
+  ae_group *g;
+  edgex_autoimpl *leader = first->impl;
+  unsigned count = 1;
+  unsigned maxreqs = leader->resource->nreqs;
+
+  for (edgex_device_autoevents *ae = first->next; ae; ae = ae->next)
+  {
+    if (ae->impl && !ae->impl->grouped && ae_sameschedule (ae->impl, leader))
+    {
+      count++;
+      maxreqs += ae->impl->resource->nreqs;
+    }
+  }
+  if (count == 1)
+  {
+    return;
+  }
+
+  g = malloc (sizeof (ae_group));
+  g->members = malloc (count * sizeof (edgex_autoimpl *));
+  g->index = malloc (count * sizeof (unsigned *));
+  g->reqs = malloc (maxreqs * sizeof (edgex_device_commandrequest));
+  g->nmembers = 0;
+  g->nreqs = 0;
+
+  for (edgex_device_autoevents *ae = first; ae; ae = ae->next)
+  {
+    edgex_autoimpl *ai = ae->impl;
+    if (ai && !ai->grouped && ae_sameschedule (ai, leader))
+    {
+      unsigned m = g->nmembers++;
+      g->members[m] = ai;
+      g->index[m] = malloc (ai->resource->nreqs * sizeof (unsigned));
+      for (unsigned i = 0; i < ai->resource->nreqs; i++)
+      {
+        unsigned r;
+        for (r = 0; r < g->nreqs; r++)
+        {
+          if (strcmp (g->reqs[r].resname, ai->resource->reqs[i].resname) == 0)
+          {
+            break;
+          }
+        }
+        if (r == g->nreqs)
+        {
+          g->reqs[g->nreqs++] = ai->resource->reqs[i];
+        }
+        g->index[m][i] = r;
+      }
+      if (m)
+      {
+        atomic_fetch_add (&ai->refs, 1);
+        ai->grouped = true;
+      }
+    }
+  }
+  leader->group = g;
+  iot_log_debug
+  (
+    leader->svc->logger, "AutoEvents: device %s: %u AutoEvents grouped, reading %u resources",
+    leader->device, g->nmembers, g->nreqs
+  );
+}
+
 static void starter (void *p)
 {
   edgex_autoimpl *ai = (edgex_autoimpl *)p;
@@ -171,7 +594,27 @@ void edgex_device_autoevent_start (edgex_device_service *svc, edgex_device *dev)
         );
         continue;
       }
-      uint64_t interval = parseTime (ae->frequency);
+      uint64_t interval = 0;
+      edgex_cron *cron = NULL;
+      if (ae->cron && *ae->cron)
+      {
+        cron = edgex_cron_parse (ae->cron);
+        if (cron == NULL)
+        {
+          iot_log_error
+          (
+            svc->logger,
+            "AutoEvents: device %s: unable to parse cron expression %s.",
+            dev->name, ae->cron
+          );
+          continue;
+        }
+        interval = edgex_cron_resolution (cron);
+      }
+      else
+      {
+        interval = edgex_device_parsetime (ae->frequency);
+      }
       if (interval == 0)
       {
         iot_log_error
@@ -182,6 +625,22 @@ void edgex_device_autoevent_start (edgex_device_service *svc, edgex_device *dev)
         );
         continue;
       }
+      uint64_t heartbeat = 0;
+      if (ae->heartbeat && *ae->heartbeat)
+      {
+        heartbeat = edgex_device_parsetime (ae->heartbeat);
+        if (heartbeat == 0)
+        {
+          iot_log_error
+          (
+            svc->logger,
+            "AutoEvents: device %s: unable to parse %s for heartbeat.",
+            dev->name, ae->heartbeat
+          );
+          free (cron);
+          continue;
+        }
+      }
       ae->impl = malloc (sizeof (edgex_autoimpl));
       ae->impl->svc = svc;
       ae->impl->last = NULL;
@@ -191,16 +650,61 @@ void edgex_device_autoevent_start (edgex_device_service *svc, edgex_device *dev)
       ae->impl->protocols = edgex_protocols_dup (dev->protocols);
       ae->impl->handle = NULL;
       atomic_store (&ae->impl->refs, 1);
-      ae->impl->onChange = ae->onChange;
+      ae->impl->onChange = ae->onChange || ae->deadband || ae->deadbandPercent;
+      ae->impl->heartbeat = heartbeat;
+      ae->impl->lastsent = 0;
+      ae->impl->group = NULL;
+      ae->impl->grouped = false;
+      ae->impl->align = ae->align;
+      ae->impl->cron = cron;
+      atomic_store (&ae->impl->nextrun, cron ? edgex_cron_next (cron, edgex_device_millitime ()) : 0);
+      atomic_store (&ae->impl->due, 0);
+
+      /*
+       * Deadbands given in the AutoEvent apply to all its readings, otherwise
+       * those of each resource apply. Either is used only for onChange events.
+       */
+
+      ae->impl->deadband = calloc (cmd->nreqs, sizeof (double));
+      ae->impl->deadbandPct = calloc (cmd->nreqs, sizeof (double));
+      for (unsigned i = 0; i < cmd->nreqs; i++)
+      {
+        const edgex_propertyvalue *pv = cmd->pvals[i];
+        ae->impl->deadband[i] = ae->deadband ? ae->deadband : (pv->deadband ? strtod (pv->deadband, NULL) : 0.0);
+        ae->impl->deadbandPct[i] =
+          ae->deadbandPercent ? ae->deadbandPercent : (pv->deadbandPercent ? strtod (pv->deadbandPercent, NULL) : 0.0);
+      }
+    }
+  }
+
+  for (edgex_device_autoevents *ae = dev->autos; ae; ae = ae->next)
+  {
+    if (ae->impl == NULL || ae->impl->grouped)
+    {
+      continue;
     }
     if (ae->impl->svc->autoevstart)
     {
-      iot_threadpool_add_work (svc->thpool, starter, ae->impl, NULL);
+      edgex_pool_add_work (svc->thpool, starter, ae->impl);
+      continue;
+    }
+    if (svc->config.device.aegroup && ae->impl->group == NULL)
+    {
+      ae_group_create (ae);
+    }
+    if (svc->aewheel)
+    {
+      uint64_t phase = ae_phase (ae->impl);
+      atomic_store (&ae->impl->due, edgex_device_millitime () + phase);
+      ae->impl->handle = edgex_timerwheel_add
+        (svc->aewheel, ae_runner, ae->impl, ae->impl->interval, phase);
     }
     else
     {
+      uint64_t start = (ae->impl->align || ae->impl->cron) ? ae_phase (ae->impl) : 0;
+      atomic_store (&ae->impl->due, edgex_device_millitime () + start);
       ae->impl->handle = iot_schedule_create
-        (svc->scheduler, ae_runner, ae->impl, IOT_MS_TO_NS(ae->impl->interval), 0, 0, NULL);
+        (svc->scheduler, ae_runner, ae->impl, IOT_MS_TO_NS(ae->impl->interval), IOT_MS_TO_NS(start), 0, NULL);
       iot_schedule_add (ae->impl->svc->scheduler, ae->impl->handle);
     }
   }
@@ -209,13 +713,23 @@ void edgex_device_autoevent_start (edgex_device_service *svc, edgex_device *dev)
 static void stopper (void *p)
 {
   edgex_autoimpl *ai = (edgex_autoimpl *)p;
-  if (ai->svc->autoevstop)
-  {
-    ai->svc->autoevstop (ai->svc->userdata, ai->handle);
-  }
-  else
+
+  /* Grouped autoevents other than the first in their group are not scheduled */
+
+  if (!ai->grouped)
   {
-    iot_schedule_delete (ai->svc->scheduler, ai->handle);
+    if (ai->svc->autoevstop)
+    {
+      ai->svc->autoevstop (ai->svc->userdata, ai->handle);
+    }
+    else if (ai->svc->aewheel)
+    {
+      edgex_timerwheel_delete (ai->svc->aewheel, ai->handle);
+    }
+    else
+    {
+      iot_schedule_delete (ai->svc->scheduler, ai->handle);
+    }
   }
   edgex_autoimpl_release (ai);
 }
@@ -227,7 +741,7 @@ void edgex_device_autoevent_stop (edgex_device *dev)
     if (ae->impl)
     {
       edgex_autoimpl *ai = ae->impl;
-      iot_threadpool_add_work (ai->svc->thpool, stopper, ai, NULL);
+      edgex_pool_add_work (ai->svc->thpool, stopper, ai);
     }
   }
 }
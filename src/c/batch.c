@@ -0,0 +1,639 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#include "batch.h"
+#include "placement.h"
+#include "service.h"
+#include "rest.h"
+#include "parson.h"
+#include "errorlist.h"
+#include "storefwd.h"
+#include "cborbuf.h"
+#include "map.h"
+
+#include <time.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+#define CBOR_ARRAY_START 0x9f
+#define CBOR_BREAK 0xff
+
+/* Batches are kept for JSON events, CBOR events, and events in the compact encoding */
+
+#define BATCH_COMPACT (CBOR + 1)
+#define BATCH_KINDS (BATCH_COMPACT + 1)
+
+/*
+ * The compact encoding is first offered, with batches posted synchronously
+ * so that a refusal can be seen. It is in use once core-data has accepted a
+ * batch, and abandoned if core-data refuses one.
+ */
+
+typedef enum { BATCH_STANDARD, BATCH_OFFERED, BATCH_ACCEPTED } edgex_batch_encoding;
+
+typedef struct edgex_batch_buf
+{
+  unsigned char *data;
+  size_t len;
+  size_t cap;
+  char **devices;
+  uint32_t count;
+  uint64_t first;
+  edgex_event_cooked **events; /* For compact batches, the events encoded */
+  edgex_map_int names;
+  uint32_t nnames;
+  uint64_t origin;
+} edgex_batch_buf;
+
+struct edgex_batch_t
+{
+  edgex_device_service *svc;
+  uint32_t maxevents;
+  uint64_t linger;
+  edgex_batch_buf bufs[BATCH_KINDS];
+  atomic_int encoding;
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+  pthread_t thread;
+  bool running;
+};
+
+static uint64_t monotime_ms (void)
+{
+  struct timespec ts;
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static void buf_append (edgex_batch_buf *buf, const void *data, size_t len)
+{
+  if (buf->len + len + 1 > buf->cap)
+  {
+    while (buf->len + len + 1 > buf->cap)
+    {
+      buf->cap = buf->cap ? buf->cap * 2 : 4096;
+    }
+    buf->data = realloc (buf->data, buf->cap);
+  }
+  memcpy (buf->data + buf->len, data, len);
+  buf->len += len;
+  buf->data[buf->len] = '\0';
+}
+
+/* Detach the contents of a batch buffer, leaving it empty. Called with the lock held */
+
+static edgex_batch_buf buf_take (edgex_batch_buf *buf, uint32_t maxevents)
+{
+  edgex_batch_buf result = *buf;
+  memset (buf, 0, sizeof (edgex_batch_buf));
+  buf->devices = malloc (maxevents * sizeof (char *));
+  return result;
+}
+
+/* Check the response from core-data, which lists the ids of the events created */
+
+static void check_response (iot_logger_t *lc, const edgex_batch_buf *buf, const char *response)
+{
+  uint32_t failed = 0;
+  JSON_Value *val = response ? json_parse_string (response) : NULL;
+  JSON_Array *ids = json_value_get_array (val);
+
+  if (ids)
+  {
+    for (uint32_t i = 0; i < buf->count; i++)
+    {
+      const char *id = json_array_get_string (ids, i);
+      if (id == NULL || *id == '\0')
+      {
+        iot_log_error (lc, "Batch: event for device %s was not accepted by core-data", buf->devices[i]);
+        failed++;
+      }
+    }
+  }
+  else
+  {
+    iot_log_warn (lc, "Batch: unable to parse response from core-data, assuming all events accepted");
+  }
+  iot_log_debug (lc, "Batch: submitted %u events, %u rejected", buf->count, failed);
+  edgex_counter_add (EDGEX_COUNTER_EVENTS_POSTED, buf->count - failed);
+  edgex_counter_add (EDGEX_COUNTER_EVENTS_DROPPED, failed);
+  json_value_free (val);
+}
+
+static void batch_release (edgex_batch_buf *buf)
+{
+  for (uint32_t i = 0; i < buf->count; i++)
+  {
+    free (buf->devices[i]);
+    if (buf->events)
+    {
+      edgex_event_cooked_free (buf->events[i]);
+    }
+  }
+  free (buf->devices);
+  free (buf->events);
+  free (buf->data);
+  edgex_map_deinit (&buf->names);
+}
+
+/* Store the events of a compact batch individually, in their standard encoding. Returns the number stored */
+
+static uint32_t batch_store_events (edgex_batch_t *batch, const edgex_batch_buf *buf)
+{
+  uint32_t stored = 0;
+
+  for (uint32_t i = 0; i < buf->count; i++)
+  {
+    const edgex_event_cooked *ev = buf->events[i];
+    if (ev->encoding == JSON)
+    {
+      stored += edgex_storefwd_put (batch->svc->storefwd, JSON, ev->value.json, strlen (ev->value.json));
+    }
+    else
+    {
+      stored += edgex_storefwd_put (batch->svc->storefwd, CBOR, edgex_event_cooked_cbor (ev), ev->value.cbor.length);
+    }
+  }
+  return stored;
+}
+
+static void batch_result
+  (edgex_batch_t *batch, int kind, edgex_batch_buf *buf, const edgex_error *err, const char *response)
+{
+  iot_logger_t *lc = batch->svc->logger;
+  uint32_t stored = 0;
+
+  if (err->code && batch->svc->storefwd)
+  {
+    if (kind == BATCH_COMPACT)
+    {
+      stored = batch_store_events (batch, buf);
+    }
+    else if (edgex_storefwd_put (batch->svc->storefwd, kind, buf->data, buf->len))
+    {
+      stored = buf->count;
+    }
+  }
+
+  if (stored)
+  {
+    iot_log_debug (lc, "Batch: %u events stored for later delivery", stored);
+  }
+  if (err->code && stored < buf->count)
+  {
+    iot_log_error (lc, "Batch: unable to push %u events", buf->count - stored);
+    edgex_counter_add (EDGEX_COUNTER_EVENTS_DROPPED, buf->count - stored);
+    for (uint32_t i = 0; i < buf->count; i++)
+    {
+      iot_log_debug (lc, "Batch: event for device %s not delivered", buf->devices[i]);
+    }
+  }
+  else if (err->code == 0)
+  {
+    check_response (lc, buf, response);
+  }
+}
+
+typedef struct batch_async_ctx
+{
+  edgex_batch_t *batch;
+  int kind;
+  edgex_batch_buf buf;
+} batch_async_ctx;
+
+static void batch_async_done (void *p, const edgex_error *err, const char *response, void *data, size_t length)
+{
+  batch_async_ctx *ctx = (batch_async_ctx *)p;
+  batch_result (ctx->batch, ctx->kind, &ctx->buf, err, response);
+  batch_release (&ctx->buf);
+  free (ctx);
+}
+
+static void batch_add_standard (edgex_batch_t *batch, const char *device, const edgex_event_cooked *event);
+
+/* Requeue the events of a compact batch in the standard encoding, and release the batch */
+
+static void batch_requeue (edgex_batch_t *batch, edgex_batch_buf *buf)
+{
+  for (uint32_t i = 0; i < buf->count; i++)
+  {
+    batch_add_standard (batch, buf->devices[i], buf->events[i]);
+  }
+  batch_release (buf);
+}
+
+/* Note the response to a compact batch. Returns false if the encoding was refused */
+
+static bool batch_compact_response (edgex_batch_t *batch, long http_code, const edgex_error *err)
+{
+  iot_logger_t *lc = batch->svc->logger;
+  int offered = BATCH_OFFERED;
+
+  /* A core-data which does not know the encoding may reject it as malformed rather than unsupported */
+
+  if (http_code == 415 || (http_code == 400 && atomic_load (&batch->encoding) == BATCH_OFFERED))
+  {
+    if (atomic_exchange (&batch->encoding, BATCH_STANDARD) != BATCH_STANDARD)
+    {
+      iot_log_warn (lc, "Batch: core-data does not accept compact batches, using the standard encoding");
+    }
+    return false;
+  }
+  if (err->code == 0 && atomic_compare_exchange_strong (&batch->encoding, &offered, BATCH_ACCEPTED))
+  {
+    iot_log_info (lc, "Batch: core-data accepts compact batches");
+  }
+  return true;
+}
+
+/* Post and release a batch which has been detached from the batcher */
+
+static void batch_submit (edgex_batch_t *batch, int kind, edgex_batch_buf *buf)
+{
+  edgex_ctx ctx;
+  edgex_error err = EDGEX_OK;
+  char url[URL_BUF_SIZE];
+  long http_code;
+  const char *mime = (kind == JSON) ? "application/json" : (kind == CBOR) ? "application/cbor" : EDGEX_BATCH_COMPACT_MIME;
+  int encoding = atomic_load (&batch->encoding);
+  iot_logger_t *lc = batch->svc->logger;
+  edgex_service_endpoints *endpoints = &batch->svc->config.endpoints;
+
+  if (kind == BATCH_COMPACT && encoding == BATCH_STANDARD)
+  {
+    batch_requeue (batch, buf);
+    return;
+  }
+
+  snprintf
+  (
+    url,
+    URL_BUF_SIZE - 1,
+    "http://%s:%u/api/v1/event",
+    endpoints->data.host,
+    endpoints->data.port
+  );
+
+  if (kind == JSON)
+  {
+    buf_append (buf, "]", 1);
+  }
+  else
+  {
+    unsigned char brk = CBOR_BREAK;
+    buf_append (buf, &brk, 1);
+  }
+
+  /* While stored payloads are replayed, batches are stored behind them so that events stay in order */
+
+  if (batch->svc->storefwd && edgex_storefwd_count (batch->svc->storefwd))
+  {
+    err = EDGEX_REMOTE_SERVER_DOWN;
+    batch_result (batch, kind, buf, &err, NULL);
+    batch_release (buf);
+    return;
+  }
+
+  if (batch->svc->asyncpost && !(kind == BATCH_COMPACT && encoding == BATCH_OFFERED))
+  {
+    batch_async_ctx *actx = malloc (sizeof (batch_async_ctx));
+    actx->batch = batch;
+    actx->kind = kind;
+    actx->buf = *buf;
+    edgex_http_async_post (batch->svc->asyncpost, url, mime, actx->buf.data, actx->buf.len, batch_async_done, actx);
+    return;
+  }
+
+  memset (&ctx, 0, sizeof (edgex_ctx));
+  ctx.compress = batch->svc->config.device.compression;
+  ctx.compressmin = batch->svc->config.device.compressthreshold;
+  if (kind == JSON)
+  {
+    http_code = edgex_http_post (lc, &ctx, url, (char *)buf->data, edgex_http_write_cb, &err);
+  }
+  else
+  {
+    http_code = edgex_http_postbin (lc, &ctx, url, buf->data, buf->len, mime, edgex_http_write_cb, &err);
+  }
+  if (kind == BATCH_COMPACT && !batch_compact_response (batch, http_code, &err))
+  {
+    free (ctx.buff);
+    batch_requeue (batch, buf);
+    return;
+  }
+  batch_result (batch, kind, buf, &err, ctx.buff);
+  free (ctx.buff);
+  batch_release (buf);
+}
+
+/* Write a name in a compact batch: in full on its first use, and as its index in order of first use thereafter */
+
+static void compact_name (edgex_batch_buf *buf, edgex_cborbuf *cb, const char *name)
+{
+  int *idx = edgex_map_get (&buf->names, name);
+  if (idx)
+  {
+    edgex_cborbuf_head (cb, EDGEX_CBOR_UINT, *idx);
+  }
+  else
+  {
+    edgex_map_set (&buf->names, name, buf->nnames++);
+    edgex_cborbuf_string (cb, name);
+  }
+}
+
+static void compact_value (edgex_cborbuf *cb, const edgex_device_commandresult *v)
+{
+  unsigned char b;
+  switch (v->type)
+  {
+    case Bool:
+      b = v->value.bool_result ? EDGEX_CBOR_TRUE : EDGEX_CBOR_FALSE;
+      edgex_cborbuf_raw (cb, &b, 1);
+      break;
+    case String:
+      edgex_cborbuf_string (cb, v->value.string_result);
+      break;
+    case Binary:
+      edgex_cborbuf_bytes (cb, v->value.binary_result.bytes, v->value.binary_result.size);
+      break;
+    case Uint8:
+      edgex_cborbuf_head (cb, EDGEX_CBOR_UINT, v->value.ui8_result);
+      break;
+    case Uint16:
+      edgex_cborbuf_head (cb, EDGEX_CBOR_UINT, v->value.ui16_result);
+      break;
+    case Uint32:
+      edgex_cborbuf_head (cb, EDGEX_CBOR_UINT, v->value.ui32_result);
+      break;
+    case Uint64:
+      edgex_cborbuf_head (cb, EDGEX_CBOR_UINT, v->value.ui64_result);
+      break;
+    case Int8:
+      edgex_cborbuf_int64 (cb, v->value.i8_result);
+      break;
+    case Int16:
+      edgex_cborbuf_int64 (cb, v->value.i16_result);
+      break;
+    case Int32:
+      edgex_cborbuf_int64 (cb, v->value.i32_result);
+      break;
+    case Int64:
+      edgex_cborbuf_int64 (cb, v->value.i64_result);
+      break;
+    case Float32:
+      edgex_cborbuf_float32 (cb, v->value.f32_result);
+      break;
+    case Float64:
+      edgex_cborbuf_float64 (cb, v->value.f64_result);
+      break;
+  }
+}
+
+/* Append an event to a compact batch. Called with the lock held */
+
+static void compact_append (edgex_batch_buf *buf, const edgex_event_readings *r)
+{
+  edgex_cborbuf cb;
+
+  edgex_cborbuf_init (&cb, 32 + 24 * r->count);
+  edgex_cborbuf_head (&cb, EDGEX_CBOR_ARRAY, 3);
+  compact_name (buf, &cb, r->device);
+  edgex_cborbuf_int64 (&cb, (int64_t)(r->origin - buf->origin));
+  buf->origin = r->origin;
+  edgex_cborbuf_head (&cb, EDGEX_CBOR_ARRAY, r->count);
+  for (uint32_t i = 0; i < r->count; i++)
+  {
+    edgex_cborbuf_head (&cb, EDGEX_CBOR_ARRAY, 3);
+    compact_name (buf, &cb, r->names[i]);
+    edgex_cborbuf_int64 (&cb, r->values[i].origin ? (int64_t)(r->values[i].origin - r->origin) : 0);
+    compact_value (&cb, &r->values[i]);
+  }
+  buf_append (buf, cb.data, cb.len);
+  free (cb.data);
+}
+
+static void *batch_linger_thread (void *p)
+{
+  edgex_batch_t *batch = (edgex_batch_t *)p;
+
+  edgex_placement_apply (EDGEX_PLACEMENT_IO);
+
+  pthread_mutex_lock (&batch->lock);
+  while (batch->running)
+  {
+    uint64_t deadline = 0;
+    for (int e = 0; e < BATCH_KINDS; e++)
+    {
+      if (batch->bufs[e].count && (deadline == 0 || batch->bufs[e].first + batch->linger < deadline))
+      {
+        deadline = batch->bufs[e].first + batch->linger;
+      }
+    }
+
+    if (deadline == 0)
+    {
+      pthread_cond_wait (&batch->cond, &batch->lock);
+      continue;
+    }
+
+    if (monotime_ms () < deadline)
+    {
+      struct timespec ts;
+      ts.tv_sec = deadline / 1000;
+      ts.tv_nsec = (deadline % 1000) * 1000000;
+      pthread_cond_timedwait (&batch->cond, &batch->lock, &ts);
+      continue;
+    }
+
+    for (int e = 0; e < BATCH_KINDS; e++)
+    {
+      if (batch->bufs[e].count && batch->bufs[e].first + batch->linger <= monotime_ms ())
+      {
+        edgex_batch_buf out = buf_take (&batch->bufs[e], batch->maxevents);
+        pthread_mutex_unlock (&batch->lock);
+        batch_submit (batch, e, &out);
+        pthread_mutex_lock (&batch->lock);
+      }
+    }
+  }
+  pthread_mutex_unlock (&batch->lock);
+  return NULL;
+}
+
+edgex_batch_t *edgex_batch_alloc (edgex_device_service *svc, uint32_t maxevents, uint32_t linger, bool compact)
+{
+  pthread_condattr_t attr;
+  edgex_batch_t *batch = calloc (1, sizeof (edgex_batch_t));
+
+  batch->svc = svc;
+  batch->maxevents = maxevents;
+  batch->linger = linger;
+  atomic_init (&batch->encoding, compact ? BATCH_OFFERED : BATCH_STANDARD);
+  for (int e = 0; e < BATCH_KINDS; e++)
+  {
+    batch->bufs[e].devices = malloc (maxevents * sizeof (char *));
+  }
+  pthread_mutex_init (&batch->lock, NULL);
+  pthread_condattr_init (&attr);
+  pthread_condattr_setclock (&attr, CLOCK_MONOTONIC);
+  pthread_cond_init (&batch->cond, &attr);
+  pthread_condattr_destroy (&attr);
+  batch->running = true;
+  pthread_create (&batch->thread, NULL, batch_linger_thread, batch);
+  iot_log_info
+  (
+    svc->logger, "Event batching enabled: up to %u events, linger %ums%s", maxevents, linger,
+    compact ? ", compact encoding offered" : ""
+  );
+  return batch;
+}
+
+bool edgex_batch_compact (edgex_batch_t *batch)
+{
+  return batch && atomic_load (&batch->encoding) != BATCH_STANDARD;
+}
+
+static void batch_add_standard (edgex_batch_t *batch, const char *device, const edgex_event_cooked *event)
+{
+  edgex_batch_buf out;
+  bool full = false;
+  edgex_batch_buf *buf = &batch->bufs[event->encoding];
+
+  pthread_mutex_lock (&batch->lock);
+  if (buf->count == 0)
+  {
+    unsigned char start = CBOR_ARRAY_START;
+    if (event->encoding == JSON)
+    {
+      buf_append (buf, "[", 1);
+    }
+    else
+    {
+      buf_append (buf, &start, 1);
+    }
+    buf->first = monotime_ms ();
+    pthread_cond_signal (&batch->cond);
+  }
+  else if (event->encoding == JSON)
+  {
+    buf_append (buf, ",", 1);
+  }
+
+  if (event->encoding == JSON)
+  {
+    buf_append (buf, event->value.json, strlen (event->value.json));
+  }
+  else
+  {
+    buf_append (buf, edgex_event_cooked_cbor (event), event->value.cbor.length);
+  }
+  buf->devices[buf->count++] = strdup (device);
+
+  if (buf->count >= batch->maxevents)
+  {
+    out = buf_take (buf, batch->maxevents);
+    full = true;
+  }
+  pthread_mutex_unlock (&batch->lock);
+
+  if (full)
+  {
+    batch_submit (batch, event->encoding, &out);
+  }
+}
+
+static void batch_add_compact (edgex_batch_t *batch, const char *device, edgex_event_cooked *event)
+{
+  edgex_batch_buf out;
+  bool full = false;
+  edgex_batch_buf *buf = &batch->bufs[BATCH_COMPACT];
+
+  pthread_mutex_lock (&batch->lock);
+  if (buf->count == 0)
+  {
+    unsigned char start = CBOR_ARRAY_START;
+    buf_append (buf, &start, 1);
+    buf->first = monotime_ms ();
+    pthread_cond_signal (&batch->cond);
+  }
+  if (buf->events == NULL)
+  {
+    buf->events = malloc (batch->maxevents * sizeof (edgex_event_cooked *));
+  }
+  compact_append (buf, event->readings);
+  buf->events[buf->count] = edgex_event_cooked_share (event);
+  buf->devices[buf->count++] = strdup (device);
+
+  if (buf->count >= batch->maxevents)
+  {
+    out = buf_take (buf, batch->maxevents);
+    full = true;
+  }
+  pthread_mutex_unlock (&batch->lock);
+
+  if (full)
+  {
+    batch_submit (batch, BATCH_COMPACT, &out);
+  }
+}
+
+void edgex_batch_add (edgex_batch_t *batch, const char *device, edgex_event_cooked *event)
+{
+  if (event->readings && atomic_load (&batch->encoding) != BATCH_STANDARD)
+  {
+    batch_add_compact (batch, device, event);
+  }
+  else
+  {
+    batch_add_standard (batch, device, event);
+  }
+}
+
+void edgex_batch_flush (edgex_batch_t *batch)
+{
+  /* Compact events go first, as a refused compact batch is requeued in the standard encoding */
+
+  for (int e = BATCH_KINDS - 1; e >= 0; e--)
+  {
+    edgex_batch_buf out;
+    bool pending = false;
+    pthread_mutex_lock (&batch->lock);
+    if (batch->bufs[e].count)
+    {
+      out = buf_take (&batch->bufs[e], batch->maxevents);
+      pending = true;
+    }
+    pthread_mutex_unlock (&batch->lock);
+    if (pending)
+    {
+      batch_submit (batch, e, &out);
+    }
+  }
+}
+
+void edgex_batch_free (edgex_batch_t *batch)
+{
+  if (batch)
+  {
+    pthread_mutex_lock (&batch->lock);
+    batch->running = false;
+    pthread_cond_signal (&batch->cond);
+    pthread_mutex_unlock (&batch->lock);
+    pthread_join (batch->thread, NULL);
+
+    edgex_batch_flush (batch);
+    for (int e = 0; e < BATCH_KINDS; e++)
+    {
+      batch_release (&batch->bufs[e]);
+    }
+    pthread_cond_destroy (&batch->cond);
+    pthread_mutex_destroy (&batch->lock);
+    free (batch);
+  }
+}
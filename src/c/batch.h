@@ -0,0 +1,62 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#ifndef _EDGEX_DEVICE_BATCH_H_
+#define _EDGEX_DEVICE_BATCH_H_ 1
+
+#include "edgex/devsdk.h"
+#include "data.h"
+
+/*
+ * The batching stage accumulates cooked events and submits them to core-data
+ * as a single request. JSON events are sent as a JSON array and CBOR events
+ * as an indefinite-length CBOR array. A batch is flushed when it holds
+ * maxevents events, or when the oldest event in it has waited for linger ms.
+ *
+ * Where compact is set, events which carry their readings are instead sent
+ * in the compact encoding: an indefinite-length CBOR array of events, each an
+ * array of device, origin and readings; each reading an array of name,
+ * origin and value. Names (of devices and resources alike) are written as
+ * text on their first appearance in a batch, and as their index in order of
+ * first appearance thereafter. An event's origin is given relative to that of
+ * the event before it (the first relative to zero), and a reading's relative
+ * to its event's. Values are native CBOR: integers, floats of the reading's
+ * precision, booleans, text or byte strings. If core-data refuses a compact
+ * batch (with status 415, or 400 before any has been accepted), its events
+ * and all those following are sent in the standard encoding.
+ */
+
+#define EDGEX_BATCH_DEFAULT_LINGER 100
+#define EDGEX_BATCH_DEFAULT_SIZE 100
+
+#define EDGEX_BATCH_COMPACT_MIME "application/vnd.edgex.compact+cbor"
+
+typedef struct edgex_batch_t edgex_batch_t;
+
+edgex_batch_t *edgex_batch_alloc (edgex_device_service *svc, uint32_t maxevents, uint32_t linger, bool compact);
+
+/* Whether events for the batcher should carry their readings, ie the compact encoding is in use. False if batch is NULL */
+
+bool edgex_batch_compact (edgex_batch_t *batch);
+
+/*
+ * Add an event to the current batch. The event data is copied, or in the
+ * compact encoding the event is shared, so the caller retains ownership.
+ */
+
+void edgex_batch_add (edgex_batch_t *batch, const char *device, edgex_event_cooked *event);
+
+/* Submit any pending events immediately */
+
+void edgex_batch_flush (edgex_batch_t *batch);
+
+/* Flush pending events, stop the linger timer and free the batcher */
+
+void edgex_batch_free (edgex_batch_t *batch);
+
+#endif
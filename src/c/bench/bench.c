@@ -0,0 +1,525 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+/*
+ * Microbenchmarks for the SDK's hot paths: event encoding, value formatting,
+ * transforms, the hash map, device lookup and JSON handling. Each benchmark
+ * is run for a fixed time and reported as one JSON object per line, so that
+ * results may be collected by scripts and compared between builds.
+ *
+ * Usage: csdk-bench [-t milliseconds] [-f filter] [-l]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <time.h>
+
+#include "edgex/csdk-defs.h"
+#include "../data.h"
+#include "../device.h"
+#include "../devmap.h"
+#include "../edgex-rest.h"
+#include "../transform.h"
+#include "../map.h"
+#include "../parson.h"
+
+#define BENCH_DEVICES 1000
+#define BENCH_MAXTHREADS 8
+
+typedef struct bench_ctx
+{
+  edgex_deviceprofile *prof;
+  const edgex_cmdinfo *jsoncmd;
+  const edgex_cmdinfo *cborcmd;
+  edgex_device_commandresult jsonvals[3];
+  edgex_device_commandresult cborvals[1];
+  edgex_devmap_t *devmap;
+  char **devnames;
+  edgex_map_int maps[3];
+  char **keys;
+  char *devjson;
+  char *profjson;
+} bench_ctx;
+
+typedef void (*bench_fn) (bench_ctx *ctx, uint64_t iters);
+
+typedef struct bench_def
+{
+  const char *name;
+  bench_fn fn;
+  unsigned threads;
+} bench_def;
+
+static const char *bench_profile =
+  "{\"name\":\"BenchProfile\",\"description\":\"csdk-bench\",\"manufacturer\":\"IoTech\",\"model\":\"1\","
+  "\"labels\":[\"bench\"],"
+  "\"deviceResources\":["
+    "{\"name\":\"Temperature\",\"description\":\"d\",\"properties\":{\"value\":{\"type\":\"Float64\",\"readWrite\":\"R\","
+      "\"scale\":\"0.1\",\"offset\":\"-40\"},\"units\":{\"type\":\"String\",\"readWrite\":\"R\",\"defaultValue\":\"C\"}}},"
+    "{\"name\":\"Counter\",\"description\":\"d\",\"properties\":{\"value\":{\"type\":\"Int32\",\"readWrite\":\"RW\","
+      "\"mask\":\"65535\",\"shift\":\"-4\"},\"units\":{}}},"
+    "{\"name\":\"Status\",\"description\":\"d\",\"properties\":{\"value\":{\"type\":\"String\",\"readWrite\":\"R\"},\"units\":{}}},"
+    "{\"name\":\"Image\",\"description\":\"d\",\"properties\":{\"value\":{\"type\":\"Binary\",\"readWrite\":\"R\","
+      "\"mediaType\":\"application/octet-stream\"},\"units\":{}}}"
+  "],"
+  "\"deviceCommands\":["
+    "{\"name\":\"Readings\",\"get\":[{\"operation\":\"get\",\"object\":\"Temperature\"},"
+      "{\"operation\":\"get\",\"object\":\"Counter\"},"
+      "{\"operation\":\"get\",\"object\":\"Status\",\"mappings\":{\"0\":\"Off\",\"1\":\"On\"}}]},"
+    "{\"name\":\"Snapshot\",\"get\":[{\"operation\":\"get\",\"object\":\"Image\"}]}"
+  "]}";
+
+static uint64_t bench_now (void)
+{
+  struct timespec ts;
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static char *bench_devjson (const char *name, const char *profjson)
+{
+  size_t len = strlen (profjson) + 512;
+  char *result = malloc (len);
+  snprintf
+  (
+    result, len,
+    "{\"name\":\"%s\",\"id\":\"id-%s\",\"description\":\"csdk-bench\",\"adminState\":\"UNLOCKED\","
+    "\"operatingState\":\"ENABLED\",\"labels\":[\"bench\"],"
+    "\"protocols\":{\"Other\":{\"Address\":\"%s\",\"Port\":\"502\"}},"
+    "\"service\":{\"name\":\"csdk-bench\",\"id\":\"svc\",\"description\":\"\"},"
+    "\"profile\":%s}",
+    name, name, name, profjson
+  );
+  return result;
+}
+
+static void bench_setvalues (bench_ctx *ctx)
+{
+  static uint8_t image[4096];
+
+  ctx->jsonvals[0].type = Float64;
+  ctx->jsonvals[0].value.f64_result = 215.0;
+  ctx->jsonvals[1].type = Int32;
+  ctx->jsonvals[1].value.i32_result = 0x12345;
+  ctx->jsonvals[2].type = String;
+  ctx->jsonvals[2].value.string_result = "1";
+  ctx->cborvals[0].type = Binary;
+  ctx->cborvals[0].value.binary_result.size = sizeof (image);
+  ctx->cborvals[0].value.binary_result.bytes = image;
+}
+
+static bool bench_setup (bench_ctx *ctx)
+{
+  iot_logger_t *lc = iot_logger_default ();
+  edgex_device *devs = NULL;
+
+  memset (ctx, 0, sizeof (bench_ctx));
+  ctx->prof = edgex_deviceprofile_read (lc, bench_profile);
+  if (ctx->prof == NULL)
+  {
+    fprintf (stderr, "csdk-bench: unable to parse the benchmark profile\n");
+    return false;
+  }
+  edgex_deviceprofile_compile (NULL, ctx->prof);
+  ctx->jsoncmd = edgex_deviceprofile_findcommand ("Readings", ctx->prof, true);
+  ctx->cborcmd = edgex_deviceprofile_findcommand ("Snapshot", ctx->prof, true);
+  if (ctx->jsoncmd == NULL || ctx->cborcmd == NULL)
+  {
+    fprintf (stderr, "csdk-bench: benchmark commands not found\n");
+    return false;
+  }
+  bench_setvalues (ctx);
+
+  ctx->profjson = edgex_deviceprofile_write (ctx->prof, false);
+  ctx->devnames = malloc (BENCH_DEVICES * sizeof (char *));
+  for (unsigned i = 0; i < BENCH_DEVICES; i++)
+  {
+    char name[32];
+    snprintf (name, sizeof (name), "bench-device-%u", i);
+    ctx->devnames[i] = strdup (name);
+    char *json = bench_devjson (name, bench_profile);
+    edgex_device *dev = edgex_device_read (lc, json);
+    if (i == 0)
+    {
+      ctx->devjson = json;
+    }
+    else
+    {
+      free (json);
+    }
+    if (dev == NULL)
+    {
+      fprintf (stderr, "csdk-bench: unable to parse the benchmark device\n");
+      edgex_device_free (devs);
+      return false;
+    }
+    dev->next = devs;
+    devs = dev;
+  }
+  ctx->devmap = edgex_devmap_alloc (NULL);
+  edgex_devmap_populate_devices (ctx->devmap, devs);
+  edgex_device_free (devs);
+
+  ctx->keys = malloc (65536 * sizeof (char *));
+  for (unsigned i = 0; i < 65536; i++)
+  {
+    char key[32];
+    snprintf (key, sizeof (key), "key-%u", i);
+    ctx->keys[i] = strdup (key);
+  }
+  for (unsigned m = 0, n = 16; m < 3; m++, n *= 64)
+  {
+    edgex_map_init (&ctx->maps[m]);
+    for (unsigned i = 0; i < n; i++)
+    {
+      edgex_map_set (&ctx->maps[m], ctx->keys[i], i);
+    }
+  }
+  return true;
+}
+
+static void bench_teardown (bench_ctx *ctx)
+{
+  for (unsigned m = 0; m < 3; m++)
+  {
+    edgex_map_deinit (&ctx->maps[m]);
+  }
+  if (ctx->keys)
+  {
+    for (unsigned i = 0; i < 65536; i++)
+    {
+      free (ctx->keys[i]);
+    }
+    free (ctx->keys);
+  }
+  if (ctx->devmap)
+  {
+    edgex_devmap_clear (ctx->devmap);
+    edgex_devmap_free (ctx->devmap);
+  }
+  if (ctx->devnames)
+  {
+    for (unsigned i = 0; i < BENCH_DEVICES; i++)
+    {
+      free (ctx->devnames[i]);
+    }
+    free (ctx->devnames);
+  }
+  free (ctx->devjson);
+  free (ctx->profjson);
+  edgex_deviceprofile_free (ctx->prof);
+}
+
+/* Benchmarks */
+
+static void bench_event_json (bench_ctx *ctx, uint64_t iters)
+{
+  for (uint64_t i = 0; i < iters; i++)
+  {
+    edgex_event_cooked *ev = edgex_data_process_event
+      ("bench-device-0", ctx->jsoncmd, ctx->jsonvals, false, false, 0, false, NULL, NULL);
+    edgex_event_cooked_free (ev);
+  }
+}
+
+static void bench_event_cbor (bench_ctx *ctx, uint64_t iters)
+{
+  for (uint64_t i = 0; i < iters; i++)
+  {
+    edgex_event_cooked *ev = edgex_data_process_event
+      ("bench-device-0", ctx->cborcmd, ctx->cborvals, false, false, 0, false, NULL, NULL);
+    edgex_event_cooked_free (ev);
+  }
+}
+
+static void bench_tostring_float (bench_ctx *ctx, uint64_t iters)
+{
+  for (uint64_t i = 0; i < iters; i++)
+  {
+    free (edgex_value_tostring (&ctx->jsonvals[0], false));
+  }
+}
+
+static void bench_tostring_int (bench_ctx *ctx, uint64_t iters)
+{
+  for (uint64_t i = 0; i < iters; i++)
+  {
+    free (edgex_value_tostring (&ctx->jsonvals[1], false));
+  }
+}
+
+static void bench_transform_float (bench_ctx *ctx, uint64_t iters)
+{
+  edgex_device_commandresult val;
+  for (uint64_t i = 0; i < iters; i++)
+  {
+    val = ctx->jsonvals[0];
+    edgex_transform_outgoing (&val, &ctx->jsoncmd->xforms[0], ctx->jsoncmd->maps[0]);
+  }
+}
+
+static void bench_transform_int (bench_ctx *ctx, uint64_t iters)
+{
+  edgex_device_commandresult val;
+  for (uint64_t i = 0; i < iters; i++)
+  {
+    val = ctx->jsonvals[1];
+    edgex_transform_outgoing (&val, &ctx->jsoncmd->xforms[1], ctx->jsoncmd->maps[1]);
+  }
+}
+
+static void bench_transform_mapping (bench_ctx *ctx, uint64_t iters)
+{
+  edgex_device_commandresult val;
+  for (uint64_t i = 0; i < iters; i++)
+  {
+    val.type = String;
+    val.value.string_result = edgex_device_buffer_alloc (2);
+    strcpy (val.value.string_result, "1");
+    edgex_transform_outgoing (&val, &ctx->jsoncmd->xforms[2], ctx->jsoncmd->maps[2]);
+    edgex_device_buffer_free (val.value.string_result);
+  }
+}
+
+static void bench_mapget (edgex_map_int *map, char **keys, unsigned n, uint64_t iters)
+{
+  for (uint64_t i = 0; i < iters; i++)
+  {
+    if (edgex_map_get (map, keys[i % n]) == NULL)
+    {
+      abort ();
+    }
+  }
+}
+
+static void bench_map_get16 (bench_ctx *ctx, uint64_t iters)
+{
+  bench_mapget (&ctx->maps[0], ctx->keys, 16, iters);
+}
+
+static void bench_map_get1k (bench_ctx *ctx, uint64_t iters)
+{
+  bench_mapget (&ctx->maps[1], ctx->keys, 1024, iters);
+}
+
+static void bench_map_get64k (bench_ctx *ctx, uint64_t iters)
+{
+  bench_mapget (&ctx->maps[2], ctx->keys, 65536, iters);
+}
+
+static void bench_map_set1k (bench_ctx *ctx, uint64_t iters)
+{
+  for (uint64_t i = 0; i < iters; i++)
+  {
+    edgex_map_set (&ctx->maps[1], ctx->keys[i % 1024], (int)i);
+  }
+}
+
+static void bench_devmap_byname (bench_ctx *ctx, uint64_t iters)
+{
+  for (uint64_t i = 0; i < iters; i++)
+  {
+    edgex_device *dev = edgex_devmap_device_byname (ctx->devmap, ctx->devnames[i % BENCH_DEVICES]);
+    edgex_device_release (dev);
+  }
+}
+
+static void bench_json_parsedevice (bench_ctx *ctx, uint64_t iters)
+{
+  for (uint64_t i = 0; i < iters; i++)
+  {
+    json_value_free (json_parse_string (ctx->devjson));
+  }
+}
+
+static void bench_json_readdevice (bench_ctx *ctx, uint64_t iters)
+{
+  for (uint64_t i = 0; i < iters; i++)
+  {
+    edgex_device_free (edgex_device_read (iot_logger_default (), ctx->devjson));
+  }
+}
+
+static void bench_json_readprofile (bench_ctx *ctx, uint64_t iters)
+{
+  for (uint64_t i = 0; i < iters; i++)
+  {
+    edgex_deviceprofile_free (edgex_deviceprofile_read (iot_logger_default (), ctx->profjson));
+  }
+}
+
+static void bench_json_serialize (bench_ctx *ctx, uint64_t iters)
+{
+  JSON_Value *val = json_parse_string (ctx->devjson);
+  for (uint64_t i = 0; i < iters; i++)
+  {
+    json_free_serialized_string (json_serialize_to_string (val));
+  }
+  json_value_free (val);
+}
+
+static const bench_def benchmarks[] =
+{
+  { "event.json", bench_event_json, 1 },
+  { "event.cbor", bench_event_cbor, 1 },
+  { "value.tostring.float64", bench_tostring_float, 1 },
+  { "value.tostring.int32", bench_tostring_int, 1 },
+  { "transform.float64", bench_transform_float, 1 },
+  { "transform.int32", bench_transform_int, 1 },
+  { "transform.mapping", bench_transform_mapping, 1 },
+  { "map.get.16", bench_map_get16, 1 },
+  { "map.get.1k", bench_map_get1k, 1 },
+  { "map.get.64k", bench_map_get64k, 1 },
+  { "map.set.1k", bench_map_set1k, 1 },
+  { "devmap.byname", bench_devmap_byname, 1 },
+  { "devmap.byname", bench_devmap_byname, 2 },
+  { "devmap.byname", bench_devmap_byname, 4 },
+  { "devmap.byname", bench_devmap_byname, BENCH_MAXTHREADS },
+  { "json.parse.device", bench_json_parsedevice, 1 },
+  { "json.serialize.device", bench_json_serialize, 1 },
+  { "rest.read.device", bench_json_readdevice, 1 },
+  { "rest.read.profile", bench_json_readprofile, 1 },
+  { NULL, NULL, 0 }
+};
+
+/* Runner */
+
+typedef struct bench_thread
+{
+  pthread_t thread;
+  pthread_barrier_t *barrier;
+  bench_ctx *ctx;
+  bench_fn fn;
+  uint64_t iters;
+} bench_thread;
+
+static void *bench_thread_run (void *p)
+{
+  bench_thread *bt = (bench_thread *)p;
+  pthread_barrier_wait (bt->barrier);
+  bt->fn (bt->ctx, bt->iters);
+  return NULL;
+}
+
+/* Run n iterations on each of the threads, returning the elapsed time */
+
+static uint64_t bench_run (bench_ctx *ctx, const bench_def *b, uint64_t iters)
+{
+  uint64_t start;
+
+  if (b->threads <= 1)
+  {
+    start = bench_now ();
+    b->fn (ctx, iters);
+    return bench_now () - start;
+  }
+
+  bench_thread bt[BENCH_MAXTHREADS];
+  pthread_barrier_t barrier;
+  pthread_barrier_init (&barrier, NULL, b->threads + 1);
+  for (unsigned i = 0; i < b->threads; i++)
+  {
+    bt[i].barrier = &barrier;
+    bt[i].ctx = ctx;
+    bt[i].fn = b->fn;
+    bt[i].iters = iters;
+    pthread_create (&bt[i].thread, NULL, bench_thread_run, &bt[i]);
+  }
+  start = bench_now ();
+  pthread_barrier_wait (&barrier);
+  for (unsigned i = 0; i < b->threads; i++)
+  {
+    pthread_join (bt[i].thread, NULL);
+  }
+  uint64_t elapsed = bench_now () - start;
+  pthread_barrier_destroy (&barrier);
+  return elapsed;
+}
+
+/* Increase the iteration count until a run takes at least the target time */
+
+static void bench_measure (bench_ctx *ctx, const bench_def *b, uint64_t target)
+{
+  uint64_t iters = 1;
+  uint64_t elapsed;
+
+  bench_run (ctx, b, 1);
+  while ((elapsed = bench_run (ctx, b, iters)) < target)
+  {
+    uint64_t next = elapsed ? iters * target / elapsed + iters / 2 : iters * 100;
+    iters = (next > iters * 100) ? iters * 100 : (next <= iters ? iters * 2 : next);
+  }
+
+  uint64_t ops = iters * b->threads;
+  printf
+  (
+    "{\"sdk\":\"%s\",\"benchmark\":\"%s\",\"threads\":%u,\"iterations\":%" PRIu64 ",\"ns_per_op\":%.2f,\"ops_per_sec\":%.0f}\n",
+    CSDK_VERSION_STR, b->name, b->threads, ops, (double)elapsed * b->threads / ops,
+    (double)ops * 1e9 / elapsed
+  );
+  fflush (stdout);
+}
+
+int main (int argc, char *argv[])
+{
+  bench_ctx ctx;
+  unsigned ms = 500;
+  const char *filter = NULL;
+  bool list = false;
+  int opt;
+
+  while ((opt = getopt (argc, argv, "t:f:l")) != -1)
+  {
+    switch (opt)
+    {
+      case 't':
+        ms = strtoul (optarg, NULL, 10);
+        break;
+      case 'f':
+        filter = optarg;
+        break;
+      case 'l':
+        list = true;
+        break;
+      default:
+        fprintf (stderr, "Usage: %s [-t milliseconds] [-f filter] [-l]\n", argv[0]);
+        return 1;
+    }
+  }
+
+  if (list)
+  {
+    for (const bench_def *b = benchmarks; b->name; b++)
+    {
+      if (b->threads == 1)
+      {
+        printf ("%s\n", b->name);
+      }
+    }
+    return 0;
+  }
+
+  if (!bench_setup (&ctx))
+  {
+    bench_teardown (&ctx);
+    return 1;
+  }
+  for (const bench_def *b = benchmarks; b->name; b++)
+  {
+    if (filter == NULL || strstr (b->name, filter))
+    {
+      bench_measure (&ctx, b, (uint64_t)ms * 1000000);
+    }
+  }
+  bench_teardown (&ctx);
+  return 0;
+}
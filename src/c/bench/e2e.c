@@ -0,0 +1,883 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+/*
+ * End-to-end harness. A device service is run in a child process against
+ * mock core-data and core-metadata services, which are served here with
+ * libmicrohttpd. The mock metadata holds a profile and a set of devices, with
+ * AutoEvents if an interval is given. The harness measures the rate of events
+ * received by the mock core-data while the AutoEvents run, then drives GET
+ * commands from a number of client threads, and reports for each phase the
+ * event rate, the command latency percentiles, and the CPU use and resident
+ * size of the device service, one JSON object per line.
+ *
+ * Endpoints may be made slow (-s path=ms) or made to fail with a 503 status
+ * for a percentage of requests (-e path=percent), where path is matched
+ * against the start of the request URL, so that the SDK's backpressure and
+ * retry paths may be exercised. Options for the Device section of the
+ * service's configuration are given with -o Key=Value.
+ *
+ * Usage: csdk-e2e [-d devices] [-a interval] [-t seconds] [-c threads]
+ *   [-n commands] [-l latency-us] [-p port] [-o Key=Value] [-s path=ms]
+ *   [-e path=percent] [-k]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <unistd.h>
+#include <signal.h>
+#include <errno.h>
+#include <pthread.h>
+#include <time.h>
+#include <ftw.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <microhttpd.h>
+#include <curl/curl.h>
+
+#include "edgex/csdk-defs.h"
+#include "edgex/devsdk.h"
+#include "../edgex-time.h"
+#include "../parson.h"
+
+#define E2E_MAXFAULTS 8
+#define E2E_MAXOPTS 32
+#define E2E_MAXTHREADS 64
+#define E2E_PROFILE "E2E-Profile"
+#define E2E_SERVICE "device-e2e"
+
+typedef struct e2e_fault
+{
+  const char *path;
+  unsigned delay_ms;
+  unsigned fail_pct;
+} e2e_fault;
+
+typedef struct e2e_mock
+{
+  char *profilejson;
+  char *devicesjson;
+  e2e_fault faults[E2E_MAXFAULTS];
+  unsigned nfaults;
+  atomic_uint_fast64_t events;
+  atomic_uint_fast64_t posts;
+  atomic_uint_fast64_t injected;
+  atomic_uint_fast64_t ids;
+  struct MHD_Daemon *data;
+  struct MHD_Daemon *metadata;
+} e2e_mock;
+
+typedef struct e2e_request
+{
+  char *body;
+  size_t len;
+  size_t cap;
+} e2e_request;
+
+typedef struct e2e_options
+{
+  unsigned devices;
+  const char *interval;
+  unsigned seconds;
+  unsigned threads;
+  unsigned commands;
+  unsigned latency_us;
+  unsigned port;
+  const char *devopts[E2E_MAXOPTS];
+  unsigned ndevopts;
+  bool keep;
+} e2e_options;
+
+static uint64_t e2e_now (void)
+{
+  struct timespec ts;
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void e2e_sleepms (unsigned ms)
+{
+  struct timespec ts = { .tv_sec = ms / 1000, .tv_nsec = (ms % 1000) * 1000000 };
+  while (nanosleep (&ts, &ts) == -1 && errno == EINTR);
+}
+
+/* Device service run in the child process */
+
+typedef struct e2e_driver
+{
+  unsigned latency_us;
+  atomic_uint_fast64_t count;
+} e2e_driver;
+
+static bool e2e_init (void *impl, struct iot_logger_t *lc, const edgex_nvpairs *config)
+{
+  return true;
+}
+
+static bool e2e_get_handler
+(
+  void *impl,
+  const char *devname,
+  const edgex_protocols *protocols,
+  uint32_t nreadings,
+  const edgex_device_commandrequest *requests,
+  edgex_device_commandresult *readings
+)
+{
+  e2e_driver *driver = (e2e_driver *)impl;
+  uint64_t n = atomic_fetch_add (&driver->count, 1);
+
+  if (driver->latency_us)
+  {
+    struct timespec ts = { .tv_sec = driver->latency_us / 1000000, .tv_nsec = (driver->latency_us % 1000000) * 1000 };
+    while (nanosleep (&ts, &ts) == -1 && errno == EINTR);
+  }
+  for (uint32_t i = 0; i < nreadings; i++)
+  {
+    readings[i].type = requests[i].type;
+    if (requests[i].type == Float64)
+    {
+      readings[i].value.f64_result = (n % 1000) / 10.0;
+    }
+    else
+    {
+      readings[i].value.i32_result = n;
+    }
+  }
+  return true;
+}
+
+static bool e2e_put_handler
+(
+  void *impl,
+  const char *devname,
+  const edgex_protocols *protocols,
+  uint32_t nvalues,
+  const edgex_device_commandrequest *requests,
+  const edgex_device_commandresult *values
+)
+{
+  return true;
+}
+
+static bool e2e_disconnect (void *impl, edgex_protocols *device)
+{
+  return true;
+}
+
+static void e2e_stop (void *impl, bool force) {}
+
+static int e2e_service (const char *confdir, unsigned latency_us)
+{
+  e2e_driver driver = { .latency_us = latency_us };
+  edgex_error e;
+  sigset_t set;
+  int sig;
+
+  edgex_device_callbacks impls =
+  {
+    e2e_init,
+    NULL,
+    e2e_get_handler,
+    e2e_put_handler,
+    e2e_disconnect,
+    e2e_stop
+  };
+
+  e.code = 0;
+  atomic_init (&driver.count, 0);
+  edgex_device_service *service = edgex_device_service_new (E2E_SERVICE, CSDK_VERSION_STR, &driver, impls, &e);
+  if (e.code == 0)
+  {
+    edgex_device_service_start (service, NULL, NULL, confdir, &e);
+  }
+  if (e.code)
+  {
+    fprintf (stderr, "csdk-e2e: device service failed to start: %s\n", e.reason);
+    if (service)
+    {
+      edgex_device_service_free (service);
+    }
+    return 1;
+  }
+
+  sigemptyset (&set);
+  sigaddset (&set, SIGTERM);
+  sigwait (&set, &sig);
+
+  edgex_device_service_stop (service, true, &e);
+  edgex_device_service_free (service);
+  return 0;
+}
+
+/* Mock core services */
+
+static char *e2e_id (e2e_mock *mock)
+{
+  char *id = malloc (32);
+  snprintf (id, 32, "e2e-%" PRIu64, (uint64_t)atomic_fetch_add (&mock->ids, 1));
+  return id;
+}
+
+/* Per-thread generator for fault injection */
+
+static _Thread_local unsigned e2e_seed;
+
+static bool e2e_inject (unsigned pct)
+{
+  if (e2e_seed == 0)
+  {
+    e2e_seed = (unsigned)(uintptr_t)&e2e_seed ^ (unsigned)time (NULL);
+  }
+  return (unsigned)(rand_r (&e2e_seed) % 100) < pct;
+}
+
+static const e2e_fault *e2e_findfault (const e2e_mock *mock, const char *url)
+{
+  for (unsigned i = 0; i < mock->nfaults; i++)
+  {
+    if (strncmp (url, mock->faults[i].path, strlen (mock->faults[i].path)) == 0)
+    {
+      return &mock->faults[i];
+    }
+  }
+  return NULL;
+}
+
+/* Count the events in a posted body: one, or the elements of a batch. Compressed bodies are counted as one */
+
+static unsigned e2e_countevents (struct MHD_Connection *conn, const e2e_request *req)
+{
+  unsigned result = 1;
+  if (req->len && req->body[0] == '[' && MHD_lookup_connection_value (conn, MHD_HEADER_KIND, "Content-Encoding") == NULL)
+  {
+    JSON_Value *val = json_parse_string (req->body);
+    result = json_array_get_count (json_value_get_array (val));
+    json_value_free (val);
+  }
+  return result;
+}
+
+static int e2e_route_data
+  (e2e_mock *mock, struct MHD_Connection *conn, const char *url, const char *method, const e2e_request *req, char **reply)
+{
+  if (strcmp (url, "/api/v1/ping") == 0)
+  {
+    *reply = strdup ("pong");
+  }
+  else if (strcmp (url, "/api/v1/event") == 0 && strcmp (method, "POST") == 0)
+  {
+    atomic_fetch_add (&mock->posts, 1);
+    atomic_fetch_add (&mock->events, e2e_countevents (conn, req));
+    *reply = e2e_id (mock);
+  }
+  else if (strcmp (url, "/api/v1/valuedescriptor") == 0)
+  {
+    *reply = strcmp (method, "GET") ? e2e_id (mock) : strdup ("[]");
+  }
+  else
+  {
+    return MHD_HTTP_NOT_FOUND;
+  }
+  return MHD_HTTP_OK;
+}
+
+static int e2e_route_metadata
+  (e2e_mock *mock, struct MHD_Connection *conn, const char *url, const char *method, const e2e_request *req, char **reply)
+{
+  if (strcmp (url, "/api/v1/ping") == 0)
+  {
+    *reply = strdup ("pong");
+  }
+  else if (strcmp (method, "POST") == 0)
+  {
+    *reply = e2e_id (mock);
+  }
+  else if (strcmp (method, "GET"))
+  {
+    *reply = strdup ("");
+  }
+  else if (strcmp (url, "/api/v1/config") == 0)
+  {
+    *reply = strdup ("{}");
+  }
+  else if (strcmp (url, "/api/v1/deviceprofile/name/" E2E_PROFILE) == 0)
+  {
+    *reply = strdup (mock->profilejson);
+  }
+  else if (strcmp (url, "/api/v1/device/servicename/" E2E_SERVICE) == 0)
+  {
+    *reply = strdup (mock->devicesjson);
+  }
+  else
+  {
+    /* Device service, addressable and other profiles are not found, so that the service creates them */
+    return MHD_HTTP_NOT_FOUND;
+  }
+  return MHD_HTTP_OK;
+}
+
+static int e2e_handler
+(
+  void *cls,
+  struct MHD_Connection *conn,
+  const char *url,
+  const char *method,
+  const char *version,
+  const char *upload_data,
+  size_t *upload_data_size,
+  void **context,
+  bool isdata
+)
+{
+  e2e_mock *mock = (e2e_mock *)cls;
+  e2e_request *req = (e2e_request *)*context;
+  char *reply = NULL;
+  int status;
+
+  if (req == NULL)
+  {
+    *context = calloc (1, sizeof (e2e_request));
+    return MHD_YES;
+  }
+  if (*upload_data_size)
+  {
+    if (req->len + *upload_data_size + 1 > req->cap)
+    {
+      req->cap = (req->len + *upload_data_size + 1) * 2;
+      req->body = realloc (req->body, req->cap);
+    }
+    memcpy (req->body + req->len, upload_data, *upload_data_size);
+    req->len += *upload_data_size;
+    req->body[req->len] = '\0';
+    *upload_data_size = 0;
+    return MHD_YES;
+  }
+  *context = NULL;
+
+  const e2e_fault *fault = e2e_findfault (mock, url);
+  if (fault && fault->delay_ms)
+  {
+    e2e_sleepms (fault->delay_ms);
+  }
+  if (fault && fault->fail_pct && e2e_inject (fault->fail_pct))
+  {
+    atomic_fetch_add (&mock->injected, 1);
+    status = MHD_HTTP_SERVICE_UNAVAILABLE;
+    reply = strdup ("Injected failure");
+  }
+  else
+  {
+    status = isdata ?
+      e2e_route_data (mock, conn, url, method, req, &reply) :
+      e2e_route_metadata (mock, conn, url, method, req, &reply);
+  }
+
+  struct MHD_Response *response = reply ?
+    MHD_create_response_from_buffer (strlen (reply), reply, MHD_RESPMEM_MUST_FREE) :
+    MHD_create_response_from_buffer (0, "", MHD_RESPMEM_PERSISTENT);
+  MHD_add_response_header (response, "Content-Type", (reply && (*reply == '{' || *reply == '[')) ? "application/json" : "text/plain");
+  MHD_queue_response (conn, status, response);
+  MHD_destroy_response (response);
+  free (req->body);
+  free (req);
+  return MHD_YES;
+}
+
+static int e2e_data_handler
+  (void *cls, struct MHD_Connection *conn, const char *url, const char *method, const char *version,
+   const char *upload_data, size_t *upload_data_size, void **context)
+{
+  return e2e_handler (cls, conn, url, method, version, upload_data, upload_data_size, context, true);
+}
+
+static int e2e_metadata_handler
+  (void *cls, struct MHD_Connection *conn, const char *url, const char *method, const char *version,
+   const char *upload_data, size_t *upload_data_size, void **context)
+{
+  return e2e_handler (cls, conn, url, method, version, upload_data, upload_data_size, context, false);
+}
+
+static const char *e2e_profile =
+  "{\"id\":\"e2e-profile\",\"name\":\"" E2E_PROFILE "\",\"description\":\"csdk-e2e\",\"manufacturer\":\"IoTech\",\"model\":\"1\","
+  "\"labels\":[\"e2e\"],"
+  "\"deviceResources\":["
+    "{\"name\":\"Value\",\"description\":\"d\",\"properties\":{\"value\":{\"type\":\"Float64\",\"readWrite\":\"R\"},\"units\":{}}},"
+    "{\"name\":\"Count\",\"description\":\"d\",\"properties\":{\"value\":{\"type\":\"Int32\",\"readWrite\":\"RW\"},\"units\":{}}}"
+  "],"
+  "\"deviceCommands\":["
+    "{\"name\":\"Readings\",\"get\":[{\"operation\":\"get\",\"object\":\"Value\"},{\"operation\":\"get\",\"object\":\"Count\"}]}"
+  "]}";
+
+static char *e2e_devices (const e2e_options *opts)
+{
+  size_t plen = strlen (e2e_profile);
+  size_t cap = opts->devices * (plen + 512) + 3;
+  char *result = malloc (cap);
+  size_t len = 0;
+
+  result[len++] = '[';
+  for (unsigned i = 0; i < opts->devices; i++)
+  {
+    char autos[128] = "";
+    if (opts->interval)
+    {
+      snprintf (autos, sizeof (autos), "{\"resource\":\"Readings\",\"frequency\":\"%s\",\"onChange\":false}", opts->interval);
+    }
+    len += snprintf
+    (
+      result + len, cap - len,
+      "%s{\"id\":\"e2e-device-%u\",\"name\":\"E2E-%05u\",\"description\":\"csdk-e2e\",\"adminState\":\"UNLOCKED\","
+      "\"operatingState\":\"ENABLED\",\"labels\":[],\"protocols\":{\"Other\":{\"Address\":\"%u\"}},"
+      "\"autoEvents\":[%s],\"service\":{\"id\":\"e2e-service\",\"name\":\"" E2E_SERVICE "\",\"description\":\"\"},"
+      "\"profile\":%s}",
+      i ? "," : "", i, i, i, autos, e2e_profile
+    );
+  }
+  result[len++] = ']';
+  result[len] = '\0';
+  return result;
+}
+
+/* Process statistics for the device service, from /proc */
+
+typedef struct e2e_procstats
+{
+  uint64_t cputicks;
+  uint64_t rss_kb;
+  uint64_t hwm_kb;
+} e2e_procstats;
+
+static void e2e_getstats (pid_t pid, e2e_procstats *st)
+{
+  char path[64];
+  char line[512];
+  FILE *f;
+
+  memset (st, 0, sizeof (e2e_procstats));
+  snprintf (path, sizeof (path), "/proc/%d/stat", (int)pid);
+  if ((f = fopen (path, "r")))
+  {
+    if (fgets (line, sizeof (line), f))
+    {
+      unsigned long utime, stime;
+      char *p = strrchr (line, ')');
+      if (p && sscanf (p + 2, "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %lu %lu", &utime, &stime) == 2)
+      {
+        st->cputicks = utime + stime;
+      }
+    }
+    fclose (f);
+  }
+  snprintf (path, sizeof (path), "/proc/%d/status", (int)pid);
+  if ((f = fopen (path, "r")))
+  {
+    while (fgets (line, sizeof (line), f))
+    {
+      sscanf (line, "VmRSS: %" SCNu64, &st->rss_kb);
+      sscanf (line, "VmHWM: %" SCNu64, &st->hwm_kb);
+    }
+    fclose (f);
+  }
+}
+
+static double e2e_cpupercent (const e2e_procstats *from, const e2e_procstats *to, uint64_t ns)
+{
+  return ns ? 100.0 * (to->cputicks - from->cputicks) / sysconf (_SC_CLK_TCK) / (ns / 1e9) : 0.0;
+}
+
+/* Command clients */
+
+typedef struct e2e_client
+{
+  pthread_t thread;
+  const e2e_options *opts;
+  unsigned index;
+  uint32_t *latencies;
+  unsigned done;
+  unsigned errors;
+} e2e_client;
+
+static size_t e2e_discard (void *contents, size_t size, size_t nmemb, void *userp)
+{
+  return size * nmemb;
+}
+
+static void *e2e_client_run (void *p)
+{
+  e2e_client *cl = (e2e_client *)p;
+  CURL *curl = curl_easy_init ();
+  char url[128];
+
+  curl_easy_setopt (curl, CURLOPT_WRITEFUNCTION, e2e_discard);
+  curl_easy_setopt (curl, CURLOPT_NOSIGNAL, 1L);
+  for (unsigned i = 0; i < cl->opts->commands; i++)
+  {
+    long rc = 0;
+    unsigned dev = (cl->index + i * cl->opts->threads) % cl->opts->devices;
+    snprintf (url, sizeof (url), "http://localhost:%u/api/v1/device/name/E2E-%05u/Readings", cl->opts->port + 2, dev);
+    curl_easy_setopt (curl, CURLOPT_URL, url);
+    uint64_t start = e2e_now ();
+    CURLcode res = curl_easy_perform (curl);
+    cl->latencies[i] = (e2e_now () - start) / 1000;
+    cl->done++;
+    if (res == CURLE_OK)
+    {
+      curl_easy_getinfo (curl, CURLINFO_RESPONSE_CODE, &rc);
+    }
+    if (rc != 200)
+    {
+      cl->errors++;
+    }
+  }
+  curl_easy_cleanup (curl);
+  return NULL;
+}
+
+static int e2e_cmpu32 (const void *a, const void *b)
+{
+  uint32_t x = *(const uint32_t *)a;
+  uint32_t y = *(const uint32_t *)b;
+  return x < y ? -1 : x > y;
+}
+
+static bool e2e_ping (unsigned port)
+{
+  char url[64];
+  long rc = 0;
+  CURL *curl = curl_easy_init ();
+
+  snprintf (url, sizeof (url), "http://localhost:%u/api/v1/ping", port);
+  curl_easy_setopt (curl, CURLOPT_URL, url);
+  curl_easy_setopt (curl, CURLOPT_WRITEFUNCTION, e2e_discard);
+  curl_easy_setopt (curl, CURLOPT_NOSIGNAL, 1L);
+  curl_easy_setopt (curl, CURLOPT_TIMEOUT_MS, 1000L);
+  if (curl_easy_perform (curl) == CURLE_OK)
+  {
+    curl_easy_getinfo (curl, CURLINFO_RESPONSE_CODE, &rc);
+  }
+  curl_easy_cleanup (curl);
+  return rc == 200;
+}
+
+/* Phases */
+
+static void e2e_autoevents (e2e_mock *mock, const e2e_options *opts, pid_t pid)
+{
+  e2e_procstats st0, st1;
+
+  /* Allow the AutoEvents to start before measuring */
+
+  e2e_sleepms (1000);
+  uint64_t events = atomic_load (&mock->events);
+  uint64_t injected = atomic_load (&mock->injected);
+  e2e_getstats (pid, &st0);
+  uint64_t start = e2e_now ();
+  e2e_sleepms (opts->seconds * 1000);
+  uint64_t ns = e2e_now () - start;
+  e2e_getstats (pid, &st1);
+  events = atomic_load (&mock->events) - events;
+
+  printf
+  (
+    "{\"sdk\":\"%s\",\"phase\":\"autoevents\",\"devices\":%u,\"interval\":\"%s\",\"seconds\":%.1f,"
+    "\"events\":%" PRIu64 ",\"events_per_sec\":%.1f,\"offered_per_sec\":%.1f,\"injected_failures\":%" PRIu64 ","
+    "\"cpu_percent\":%.1f,\"rss_kb\":%" PRIu64 ",\"hwm_kb\":%" PRIu64 "}\n",
+    CSDK_VERSION_STR, opts->devices, opts->interval, ns / 1e9, events, events / (ns / 1e9),
+    opts->devices * 1000.0 / edgex_device_parsetime (opts->interval),
+    (uint64_t)atomic_load (&mock->injected) - injected, e2e_cpupercent (&st0, &st1, ns), st1.rss_kb, st1.hwm_kb
+  );
+  fflush (stdout);
+}
+
+static void e2e_commands (e2e_mock *mock, const e2e_options *opts, pid_t pid)
+{
+  e2e_client clients[E2E_MAXTHREADS];
+  e2e_procstats st0, st1;
+  unsigned total = 0;
+  unsigned errors = 0;
+
+  uint64_t events = atomic_load (&mock->events);
+  e2e_getstats (pid, &st0);
+  uint64_t start = e2e_now ();
+  for (unsigned i = 0; i < opts->threads; i++)
+  {
+    clients[i].opts = opts;
+    clients[i].index = i;
+    clients[i].latencies = malloc (opts->commands * sizeof (uint32_t));
+    clients[i].done = 0;
+    clients[i].errors = 0;
+    pthread_create (&clients[i].thread, NULL, e2e_client_run, &clients[i]);
+  }
+  uint32_t *all = malloc (opts->threads * opts->commands * sizeof (uint32_t));
+  for (unsigned i = 0; i < opts->threads; i++)
+  {
+    pthread_join (clients[i].thread, NULL);
+    memcpy (all + total, clients[i].latencies, clients[i].done * sizeof (uint32_t));
+    total += clients[i].done;
+    errors += clients[i].errors;
+    free (clients[i].latencies);
+  }
+  uint64_t ns = e2e_now () - start;
+  e2e_getstats (pid, &st1);
+  events = atomic_load (&mock->events) - events;
+
+  qsort (all, total, sizeof (uint32_t), e2e_cmpu32);
+  printf
+  (
+    "{\"sdk\":\"%s\",\"phase\":\"commands\",\"devices\":%u,\"threads\":%u,\"seconds\":%.1f,"
+    "\"requests\":%u,\"errors\":%u,\"requests_per_sec\":%.1f,\"p50_us\":%u,\"p99_us\":%u,\"max_us\":%u,"
+    "\"events_per_sec\":%.1f,\"cpu_percent\":%.1f,\"rss_kb\":%" PRIu64 ",\"hwm_kb\":%" PRIu64 "}\n",
+    CSDK_VERSION_STR, opts->devices, opts->threads, ns / 1e9, total, errors, total / (ns / 1e9),
+    total ? all[total / 2] : 0, total ? all[(uint64_t)total * 99 / 100] : 0, total ? all[total - 1] : 0,
+    events / (ns / 1e9), e2e_cpupercent (&st0, &st1, ns), st1.rss_kb, st1.hwm_kb
+  );
+  fflush (stdout);
+  free (all);
+}
+
+/* Setup */
+
+static bool e2e_writeconfig (const char *dir, const e2e_options *opts)
+{
+  char path[256];
+  snprintf (path, sizeof (path), "%s/configuration.toml", dir);
+  FILE *f = fopen (path, "w");
+  if (f == NULL)
+  {
+    return false;
+  }
+  fprintf
+  (
+    f,
+    "[Service]\n  Host = \"localhost\"\n  Port = %u\n  Timeout = 500\n  ConnectRetries = 20\n"
+    "  Labels = [ \"e2e\" ]\n  StartupMsg = \"csdk-e2e device service started\"\n  CheckInterval = \"10s\"\n\n"
+    "[Clients]\n  [Clients.Data]\n    Host = \"localhost\"\n    Port = %u\n\n"
+    "  [Clients.Metadata]\n    Host = \"localhost\"\n    Port = %u\n\n"
+    "  [Clients.Logging]\n    Host = \"localhost\"\n    Port = %u\n\n"
+    "[Device]\n  DataTransform = true\n  Discovery = false\n  MaxCmdOps = 128\n  MaxCmdResultLen = 256\n"
+    "  ProfilesDir = \"%s\"\n",
+    opts->port + 2, opts->port, opts->port + 1, opts->port + 1, dir
+  );
+  for (unsigned i = 0; i < opts->ndevopts; i++)
+  {
+    const char *eq = strchr (opts->devopts[i], '=');
+    fprintf (f, "  %.*s = %s\n", (int)(eq - opts->devopts[i]), opts->devopts[i], eq + 1);
+  }
+  fprintf (f, "\n[Logging]\n  EnableRemote = false\n  File = \"%s/device.log\"\n  LogLevel = \"INFO\"\n", dir);
+  return fclose (f) == 0;
+}
+
+static int e2e_rmfile (const char *path, const struct stat *sb, int flag, struct FTW *ftw)
+{
+  return remove (path);
+}
+
+static bool e2e_addfault (e2e_mock *mock, const char *arg, bool slow)
+{
+  const char *eq = strrchr (arg, '=');
+  if (eq == NULL || eq == arg)
+  {
+    return false;
+  }
+  e2e_fault *fault = NULL;
+  for (unsigned i = 0; i < mock->nfaults; i++)
+  {
+    if (strlen (mock->faults[i].path) == (size_t)(eq - arg) && strncmp (mock->faults[i].path, arg, eq - arg) == 0)
+    {
+      fault = &mock->faults[i];
+    }
+  }
+  if (fault == NULL)
+  {
+    if (mock->nfaults == E2E_MAXFAULTS)
+    {
+      return false;
+    }
+    fault = &mock->faults[mock->nfaults++];
+    fault->path = strndup (arg, eq - arg);
+  }
+  if (slow)
+  {
+    fault->delay_ms = strtoul (eq + 1, NULL, 10);
+  }
+  else
+  {
+    fault->fail_pct = strtoul (eq + 1, NULL, 10);
+  }
+  return true;
+}
+
+static const char *e2e_usage =
+  "Usage: %s [options]\n"
+  "  -d devices\t: Number of devices (default 10)\n"
+  "  -a interval\t: AutoEvent interval, eg 100ms (default: no AutoEvents)\n"
+  "  -t seconds\t: Duration of the AutoEvent phase (default 10)\n"
+  "  -c threads\t: Command client threads (default 4)\n"
+  "  -n commands\t: Commands per client thread (default 1000)\n"
+  "  -l latency\t: Driver latency in microseconds (default 0)\n"
+  "  -p port\t: Base port: core-data, core-metadata and the device service use this and the next two (default 59980)\n"
+  "  -o Key=Value\t: Add an option to the Device section of the service configuration (string values must be quoted)\n"
+  "  -s path=ms\t: Delay responses to requests matching path\n"
+  "  -e path=pct\t: Fail the given percentage of requests matching path with status 503\n"
+  "  -k\t\t: Keep the working directory\n";
+
+int main (int argc, char *argv[])
+{
+  e2e_options opts = { .devices = 10, .seconds = 10, .threads = 4, .commands = 1000, .port = 59980 };
+  e2e_mock mock;
+  char dir[] = "/tmp/csdk-e2e-XXXXXX";
+  sigset_t set;
+  int opt;
+  int result = 0;
+
+  memset (&mock, 0, sizeof (mock));
+  while ((opt = getopt (argc, argv, "d:a:t:c:n:l:p:o:s:e:k")) != -1)
+  {
+    bool ok = true;
+    switch (opt)
+    {
+      case 'd': opts.devices = strtoul (optarg, NULL, 10); break;
+      case 'a': opts.interval = optarg; break;
+      case 't': opts.seconds = strtoul (optarg, NULL, 10); break;
+      case 'c': opts.threads = strtoul (optarg, NULL, 10); break;
+      case 'n': opts.commands = strtoul (optarg, NULL, 10); break;
+      case 'l': opts.latency_us = strtoul (optarg, NULL, 10); break;
+      case 'p': opts.port = strtoul (optarg, NULL, 10); break;
+      case 'k': opts.keep = true; break;
+      case 'o':
+        ok = strchr (optarg, '=') && opts.ndevopts < E2E_MAXOPTS;
+        if (ok)
+        {
+          opts.devopts[opts.ndevopts++] = optarg;
+        }
+        break;
+      case 's': ok = e2e_addfault (&mock, optarg, true); break;
+      case 'e': ok = e2e_addfault (&mock, optarg, false); break;
+      default: ok = false;
+    }
+    if (!ok)
+    {
+      fprintf (stderr, e2e_usage, argv[0]);
+      return 1;
+    }
+  }
+  if (opts.devices == 0 || opts.threads == 0 || opts.threads > E2E_MAXTHREADS)
+  {
+    fprintf (stderr, "csdk-e2e: at least one device, and between 1 and %d threads, are required\n", E2E_MAXTHREADS);
+    return 1;
+  }
+  if (opts.interval && edgex_device_parsetime (opts.interval) == 0)
+  {
+    fprintf (stderr, "csdk-e2e: unable to parse %s as an interval\n", opts.interval);
+    return 1;
+  }
+
+  if (mkdtemp (dir) == NULL || !e2e_writeconfig (dir, &opts))
+  {
+    fprintf (stderr, "csdk-e2e: unable to set up the working directory: %s\n", strerror (errno));
+    return 1;
+  }
+
+  /* Block SIGTERM before any threads are created; the child waits for it */
+
+  sigemptyset (&set);
+  sigaddset (&set, SIGTERM);
+  pthread_sigmask (SIG_BLOCK, &set, NULL);
+
+  fflush (stdout);
+  pid_t pid = fork ();
+  if (pid == 0)
+  {
+    _exit (e2e_service (dir, opts.latency_us));
+  }
+  if (pid < 0)
+  {
+    fprintf (stderr, "csdk-e2e: fork failed: %s\n", strerror (errno));
+    return 1;
+  }
+
+  curl_global_init (CURL_GLOBAL_ALL);
+  mock.profilejson = strdup (e2e_profile);
+  mock.devicesjson = e2e_devices (&opts);
+  mock.data = MHD_start_daemon
+    (MHD_USE_THREAD_PER_CONNECTION, opts.port, NULL, NULL, e2e_data_handler, &mock, MHD_OPTION_END);
+  mock.metadata = MHD_start_daemon
+    (MHD_USE_THREAD_PER_CONNECTION, opts.port + 1, NULL, NULL, e2e_metadata_handler, &mock, MHD_OPTION_END);
+  if (mock.data == NULL || mock.metadata == NULL)
+  {
+    fprintf (stderr, "csdk-e2e: unable to start the mock services on ports %u and %u\n", opts.port, opts.port + 1);
+    result = 1;
+  }
+
+  /* Wait for the device service to come up */
+
+  bool ready = false;
+  for (unsigned i = 0; result == 0 && !ready && i < 60; i++)
+  {
+    int status;
+    if (waitpid (pid, &status, WNOHANG) == pid)
+    {
+      pid = 0;
+      break;
+    }
+    ready = e2e_ping (opts.port + 2);
+    if (!ready)
+    {
+      e2e_sleepms (500);
+    }
+  }
+  if (result == 0 && !ready)
+  {
+    fprintf (stderr, "csdk-e2e: the device service did not start; see %s/device.log\n", dir);
+    opts.keep = true;
+    result = 1;
+  }
+
+  if (result == 0)
+  {
+    if (opts.interval)
+    {
+      e2e_autoevents (&mock, &opts, pid);
+    }
+    e2e_commands (&mock, &opts, pid);
+  }
+
+  if (pid > 0)
+  {
+    kill (pid, SIGTERM);
+    waitpid (pid, NULL, 0);
+  }
+  if (mock.data)
+  {
+    MHD_stop_daemon (mock.data);
+  }
+  if (mock.metadata)
+  {
+    MHD_stop_daemon (mock.metadata);
+  }
+  curl_global_cleanup ();
+
+  if (opts.keep)
+  {
+    fprintf (stderr, "csdk-e2e: working directory %s\n", dir);
+  }
+  else
+  {
+    nftw (dir, e2e_rmfile, 8, FTW_DEPTH | FTW_PHYS);
+  }
+  for (unsigned i = 0; i < mock.nfaults; i++)
+  {
+    free ((char *)mock.faults[i].path);
+  }
+  free (mock.profilejson);
+  free (mock.devicesjson);
+  return result;
+}
@@ -0,0 +1,249 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#include "bufpool.h"
+#include "memstats.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/mman.h>
+
+/* Buffers are carved from the range this many bytes at a time (or one at a time for the largest classes) */
+
+#define BUFPOOL_CHUNK (64 * 1024)
+
+/* Per-thread caches hold up to BUFPOOL_TCACHE buffers or BUFPOOL_TCACHE_BYTES bytes of each class */
+
+#define BUFPOOL_TCACHE 64
+#define BUFPOOL_TCACHE_BYTES (256 * 1024)
+
+typedef struct bufpool_hdr
+{
+  uint32_t sclass;
+  uint32_t spare;
+  uint64_t spare2;
+} bufpool_hdr;
+
+/* Free buffers are linked through their data */
+
+typedef struct bufpool_link
+{
+  struct bufpool_link *next;
+} bufpool_link;
+
+typedef struct bufpool_list
+{
+  bufpool_link *head;
+  unsigned count;
+} bufpool_list;
+
+static char *pool_base;
+static size_t pool_top;
+static bufpool_list pool_shared[EDGEX_BUFPOOL_CLASSES];
+static atomic_uint_fast64_t pool_fallback;
+static pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t pool_once = PTHREAD_ONCE_INIT;
+static pthread_key_t pool_key;
+
+static _Thread_local bufpool_list *pool_cache;
+
+static unsigned bufpool_limit (unsigned c)
+{
+  unsigned n = BUFPOOL_TCACHE_BYTES / EDGEX_BUFPOOL_CSIZE (c);
+  return n < BUFPOOL_TCACHE ? n : BUFPOOL_TCACHE;
+}
+
+static inline bool bufpool_owns (const void *buf)
+{
+  return pool_base && (const char *)buf >= pool_base && (const char *)buf < pool_base + EDGEX_BUFPOOL_RANGE;
+}
+
+static inline bufpool_hdr *bufpool_header (void *buf)
+{
+  return (bufpool_hdr *)((char *)buf - EDGEX_BUFPOOL_HDR);
+}
+
+/* Move n buffers from a list to the shared list. Called with the lock held */
+
+static void bufpool_spill_locked (bufpool_list *from, unsigned c, unsigned n)
+{
+  while (n-- && from->head)
+  {
+    bufpool_link *l = from->head;
+    from->head = l->next;
+    from->count--;
+    l->next = pool_shared[c].head;
+    pool_shared[c].head = l;
+    pool_shared[c].count++;
+  }
+}
+
+static void bufpool_thread_exit (void *p)
+{
+  bufpool_list *cache = (bufpool_list *)p;
+  pthread_mutex_lock (&pool_lock);
+  for (unsigned c = 0; c < EDGEX_BUFPOOL_CLASSES; c++)
+  {
+    bufpool_spill_locked (&cache[c], c, cache[c].count);
+  }
+  pthread_mutex_unlock (&pool_lock);
+  free (cache);
+}
+
+static void bufpool_init (void)
+{
+  void *range = mmap (NULL, EDGEX_BUFPOOL_RANGE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  pool_base = (range == MAP_FAILED) ? NULL : range;
+  pthread_key_create (&pool_key, bufpool_thread_exit);
+}
+
+static bufpool_list *bufpool_cache (void)
+{
+  if (pool_cache == NULL)
+  {
+    pool_cache = calloc (EDGEX_BUFPOOL_CLASSES, sizeof (bufpool_list));
+    pthread_setspecific (pool_key, pool_cache);
+  }
+  return pool_cache;
+}
+
+/* Refill a thread's cache for a class, from the shared list or else from the range */
+
+static void bufpool_refill (bufpool_list *cache, unsigned c)
+{
+  unsigned want = bufpool_limit (c) / 2;
+  size_t csize = EDGEX_BUFPOOL_CSIZE (c);
+
+  if (want == 0)
+  {
+    want = 1;
+  }
+  pthread_mutex_lock (&pool_lock);
+  while (want && pool_shared[c].head)
+  {
+    bufpool_link *l = pool_shared[c].head;
+    pool_shared[c].head = l->next;
+    pool_shared[c].count--;
+    l->next = cache->head;
+    cache->head = l;
+    cache->count++;
+    want--;
+  }
+  if (cache->head == NULL)
+  {
+    unsigned n = (csize < BUFPOOL_CHUNK) ? BUFPOOL_CHUNK / csize : 1;
+    if (n > want)
+    {
+      n = want;
+    }
+    while (n-- && pool_top + csize <= EDGEX_BUFPOOL_RANGE)
+    {
+      char *b = pool_base + pool_top;
+      bufpool_link *l = (bufpool_link *)(b + EDGEX_BUFPOOL_HDR);
+      pool_top += csize;
+      edgex_memstats_alloc (EDGEX_MEM_POOLS, csize);
+      ((bufpool_hdr *)b)->sclass = c;
+      l->next = cache->head;
+      cache->head = l;
+      cache->count++;
+    }
+  }
+  pthread_mutex_unlock (&pool_lock);
+}
+
+void *edgex_device_buffer_alloc (size_t size)
+{
+  unsigned c = 0;
+  bufpool_list *cache;
+  bufpool_link *l;
+
+  pthread_once (&pool_once, bufpool_init);
+  while (c < EDGEX_BUFPOOL_CLASSES && EDGEX_BUFPOOL_CSIZE (c) - EDGEX_BUFPOOL_HDR < size)
+  {
+    c++;
+  }
+  if (c == EDGEX_BUFPOOL_CLASSES || pool_base == NULL)
+  {
+    atomic_fetch_add (&pool_fallback, 1);
+    return malloc (size);
+  }
+
+  cache = &bufpool_cache ()[c];
+  if (cache->head == NULL)
+  {
+    bufpool_refill (cache, c);
+    if (cache->head == NULL)
+    {
+      atomic_fetch_add (&pool_fallback, 1);
+      return malloc (size);
+    }
+  }
+  l = cache->head;
+  cache->head = l->next;
+  cache->count--;
+  return l;
+}
+
+void edgex_device_buffer_free (void *buf)
+{
+  if (!bufpool_owns (buf))
+  {
+    free (buf);
+    return;
+  }
+
+  unsigned c = bufpool_header (buf)->sclass;
+  bufpool_list *cache = &bufpool_cache ()[c];
+  bufpool_link *l = (bufpool_link *)buf;
+
+  l->next = cache->head;
+  cache->head = l;
+  if (++cache->count > bufpool_limit (c))
+  {
+    pthread_mutex_lock (&pool_lock);
+    bufpool_spill_locked (cache, c, cache->count / 2);
+    pthread_mutex_unlock (&pool_lock);
+  }
+}
+
+void *edgex_bufpool_realloc (void *buf, size_t size)
+{
+  if (buf == NULL)
+  {
+    return edgex_device_buffer_alloc (size);
+  }
+  if (!bufpool_owns (buf))
+  {
+    return realloc (buf, size);
+  }
+
+  size_t avail = EDGEX_BUFPOOL_CSIZE (bufpool_header (buf)->sclass) - EDGEX_BUFPOOL_HDR;
+  if (size <= avail)
+  {
+    return buf;
+  }
+  void *result = edgex_device_buffer_alloc (size);
+  if (result)
+  {
+    memcpy (result, buf, avail);
+    edgex_device_buffer_free (buf);
+  }
+  return result;
+}
+
+void edgex_bufpool_getstats (edgex_bufpool_stats *stats)
+{
+  pthread_once (&pool_once, bufpool_init);
+  pthread_mutex_lock (&pool_lock);
+  stats->reserved = pool_base ? EDGEX_BUFPOOL_RANGE : 0;
+  stats->used = pool_top;
+  pthread_mutex_unlock (&pool_lock);
+  stats->fallback = atomic_load (&pool_fallback);
+}
@@ -0,0 +1,46 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#ifndef _EDGEX_DEVICE_BUFPOOL_H_
+#define _EDGEX_DEVICE_BUFPOOL_H_ 1
+
+#include "edgex/devsdk.h"
+
+/*
+ * Size-classed pool for the payloads of String and Binary readings (see
+ * edgex_device_buffer_alloc). Buffers are carved from a single reserved
+ * address range, so that the SDK can tell them from malloc'd memory by
+ * address alone, in classes of powers of two from 32 bytes to 64KiB including
+ * a 16-byte header. Freed buffers are cached per thread, and passed in
+ * batches to a shared list for their class when a thread's cache is full.
+ * Memory in the range is reused but not returned to the system. Larger
+ * requests, and any made once the range is used up, are met with malloc.
+ */
+
+#define EDGEX_BUFPOOL_RANGE (256 * 1024 * 1024)
+
+/* Class c holds buffers of EDGEX_BUFPOOL_CSIZE (c) - EDGEX_BUFPOOL_HDR bytes */
+
+#define EDGEX_BUFPOOL_HDR 16
+#define EDGEX_BUFPOOL_CLASSES 12
+#define EDGEX_BUFPOOL_CSIZE(c) ((size_t)1 << ((c) + 5))
+
+typedef struct edgex_bufpool_stats
+{
+  uint64_t reserved;
+  uint64_t used;
+  uint64_t fallback;
+} edgex_bufpool_stats;
+
+/* As realloc, for memory from the pool or from malloc */
+
+void *edgex_bufpool_realloc (void *buf, size_t size);
+
+void edgex_bufpool_getstats (edgex_bufpool_stats *stats);
+
+#endif
@@ -10,6 +10,7 @@
 #include "profiles.h"
 #include "errorlist.h"
 #include "parson.h"
+#include "arena.h"
 #include "service.h"
 #include "metadata.h"
 #include "edgex-rest.h"
@@ -30,22 +31,45 @@ int edgex_device_handler_callback
 )
 {
   edgex_device *newdev;
+  edgex_device_changes *changes = NULL;
+  edgex_devmap_outcome_t outcome;
   edgex_error err = EDGEX_OK;
   int status = MHD_HTTP_OK;
   edgex_device_service *svc = (edgex_device_service *) ctx;
 
+  const char *action;
+  const char *jid;
+  char *id;
+  bool isdevice;
+
+  /*
+   * The payload is only needed for the type and id, and any changed fields
+   * given, so it is parsed into an arena and freed straight away.
+   */
+
+  edgex_arena_begin ();
   JSON_Value *jval = json_parse_string (upload_data);
   if (jval == NULL)
   {
+    edgex_arena_end ();
     iot_log_error (svc->logger, "callback: Payload did not parse as JSON");
     return MHD_HTTP_BAD_REQUEST;
   }
   JSON_Object *jobj = json_value_get_object (jval);
 
-  const char *action = json_object_get_string (jobj, "type");
-  if (action && strcmp (action, "DEVICE") == 0)
+  action = json_object_get_string (jobj, "type");
+  isdevice = action && strcmp (action, "DEVICE") == 0;
+  jid = json_object_get_string (jobj, "id");
+  id = jid ? strdup (jid) : NULL;
+  if (isdevice && method == PUT)
+  {
+    changes = edgex_device_changes_read (jobj);
+  }
+  json_value_free (jval);
+  edgex_arena_end ();
+
+  if (isdevice)
   {
-    const char *id = json_object_get_string (jobj, "id");
     if (id)
     {
       switch (method)
@@ -64,8 +88,25 @@ int edgex_device_handler_callback
             edgex_devmap_removedevice_byid (svc->devices, id);
           }
           break;
-        case POST:
         case PUT:
+          /* Changes given in the payload are applied without fetching the device */
+
+          if (changes && edgex_devmap_update_device (svc->devices, id, changes, &outcome))
+          {
+            iot_log_info (svc->logger, "callback: Updated fields of device %s", id);
+            if (outcome == UPDATED_DRIVER && svc->updatecallback)
+            {
+              edgex_device *dev = edgex_devmap_device_byid (svc->devices, id);
+              if (dev)
+              {
+                svc->updatecallback (svc->userdata, dev->name, dev->protocols, dev->adminState);
+                edgex_device_release (dev);
+              }
+            }
+            break;
+          }
+          /* fall through */
+        case POST:
           newdev = edgex_metadata_client_get_device
             (svc->logger, &svc->config.endpoints, id, &err);
           if (newdev)
@@ -120,7 +161,8 @@ int edgex_device_handler_callback
     status = MHD_HTTP_NOT_IMPLEMENTED;
   }
 
-  json_value_free (jval);
+  edgex_device_changes_free (changes);
+  free (id);
   return status;
 }
 
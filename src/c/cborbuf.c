@@ -0,0 +1,129 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#include "cborbuf.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+static unsigned char *edgex_cborbuf_reserve (edgex_cborbuf *b, size_t extra)
+{
+  if (b->len + extra > b->cap)
+  {
+    size_t newcap = b->cap ? b->cap : 256;
+    while (b->len + extra > newcap)
+    {
+      newcap *= 2;
+    }
+    b->data = realloc (b->data, newcap);
+    b->cap = newcap;
+  }
+  return b->data + b->len;
+}
+
+void edgex_cborbuf_init (edgex_cborbuf *b, size_t size)
+{
+  b->len = 0;
+  b->cap = size ? size : 256;
+  b->data = malloc (b->cap);
+}
+
+void edgex_cborbuf_raw (edgex_cborbuf *b, const void *data, size_t len)
+{
+  memcpy (edgex_cborbuf_reserve (b, len), data, len);
+  b->len += len;
+}
+
+static void edgex_cborbuf_be (edgex_cborbuf *b, unsigned char initial, uint64_t n, int bytes)
+{
+  unsigned char *p = edgex_cborbuf_reserve (b, bytes + 1);
+  *p++ = initial;
+  for (int i = bytes - 1; i >= 0; i--)
+  {
+    *p++ = (n >> (8 * i)) & 0xff;
+  }
+  b->len += bytes + 1;
+}
+
+void edgex_cborbuf_head (edgex_cborbuf *b, unsigned char major, uint64_t n)
+{
+  if (n < 24)
+  {
+    edgex_cborbuf_be (b, major | n, 0, 0);
+  }
+  else if (n <= UINT8_MAX)
+  {
+    edgex_cborbuf_be (b, major | 24, n, 1);
+  }
+  else if (n <= UINT16_MAX)
+  {
+    edgex_cborbuf_be (b, major | 25, n, 2);
+  }
+  else if (n <= UINT32_MAX)
+  {
+    edgex_cborbuf_be (b, major | 26, n, 4);
+  }
+  else
+  {
+    edgex_cborbuf_be (b, major | 27, n, 8);
+  }
+}
+
+void edgex_cborbuf_uint64 (edgex_cborbuf *b, uint64_t n)
+{
+  edgex_cborbuf_be (b, EDGEX_CBOR_UINT | 27, n, 8);
+}
+
+void edgex_cborbuf_int64 (edgex_cborbuf *b, int64_t n)
+{
+  if (n < 0)
+  {
+    edgex_cborbuf_head (b, EDGEX_CBOR_NEGINT, (uint64_t)(-1 - n));
+  }
+  else
+  {
+    edgex_cborbuf_head (b, EDGEX_CBOR_UINT, (uint64_t)n);
+  }
+}
+
+void edgex_cborbuf_float32 (edgex_cborbuf *b, float f)
+{
+  uint32_t bits;
+  memcpy (&bits, &f, sizeof (bits));
+  edgex_cborbuf_be (b, 0xfa, bits, 4);
+}
+
+void edgex_cborbuf_float64 (edgex_cborbuf *b, double f)
+{
+  uint64_t bits;
+  memcpy (&bits, &f, sizeof (bits));
+  edgex_cborbuf_be (b, 0xfb, bits, 8);
+}
+
+void edgex_cborbuf_string (edgex_cborbuf *b, const char *s)
+{
+  size_t len = strlen (s);
+  edgex_cborbuf_head (b, EDGEX_CBOR_TEXT, len);
+  edgex_cborbuf_raw (b, s, len);
+}
+
+void edgex_cborbuf_bytes (edgex_cborbuf *b, const void *data, size_t len)
+{
+  edgex_cborbuf_head (b, EDGEX_CBOR_BYTES, len);
+  edgex_cborbuf_raw (b, data, len);
+}
+
+unsigned char *edgex_cborbuf_finish (edgex_cborbuf *b, size_t *len)
+{
+  unsigned char *result = b->data;
+  *len = b->len;
+  b->data = NULL;
+  b->len = 0;
+  b->cap = 0;
+  return result;
+}
@@ -0,0 +1,74 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#ifndef _EDGEX_DEVICE_CBORBUF_H_
+#define _EDGEX_DEVICE_CBORBUF_H_ 1
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * A growable buffer for writing CBOR directly, without building a libcbor
+ * item tree. Encodings match those produced by cbor_serialize for the items
+ * used in events: minimal-length headers for strings, arrays and maps, and
+ * eight-byte encodings for uint64 values.
+ */
+
+#define EDGEX_CBOR_UINT 0x00
+#define EDGEX_CBOR_NEGINT 0x20
+#define EDGEX_CBOR_BYTES 0x40
+#define EDGEX_CBOR_TEXT 0x60
+#define EDGEX_CBOR_ARRAY 0x80
+#define EDGEX_CBOR_MAP 0xa0
+#define EDGEX_CBOR_FALSE 0xf4
+#define EDGEX_CBOR_TRUE 0xf5
+
+/* Maximum size of a header (initial byte and length) */
+
+#define EDGEX_CBOR_HDRMAX 9
+
+typedef struct edgex_cborbuf
+{
+  unsigned char *data;
+  size_t len;
+  size_t cap;
+} edgex_cborbuf;
+
+void edgex_cborbuf_init (edgex_cborbuf *b, size_t size);
+
+/* Append pre-encoded CBOR */
+
+void edgex_cborbuf_raw (edgex_cborbuf *b, const void *data, size_t len);
+
+/* Write an initial byte for the given major type and length/value, using the shortest encoding */
+
+void edgex_cborbuf_head (edgex_cborbuf *b, unsigned char major, uint64_t n);
+
+/* Write an unsigned integer using the eight-byte encoding */
+
+void edgex_cborbuf_uint64 (edgex_cborbuf *b, uint64_t n);
+
+/* Write a signed integer using the shortest encoding */
+
+void edgex_cborbuf_int64 (edgex_cborbuf *b, int64_t n);
+
+/* Write floating-point values in single and double precision respectively */
+
+void edgex_cborbuf_float32 (edgex_cborbuf *b, float f);
+
+void edgex_cborbuf_float64 (edgex_cborbuf *b, double f);
+
+void edgex_cborbuf_string (edgex_cborbuf *b, const char *s);
+
+void edgex_cborbuf_bytes (edgex_cborbuf *b, const void *data, size_t len);
+
+/* Return the buffer contents (to be freed by the caller) and reset the buffer */
+
+unsigned char *edgex_cborbuf_finish (edgex_cborbuf *b, size_t *len);
+
+#endif
@@ -0,0 +1,230 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#include "circuit.h"
+#include "map.h"
+
+#include <stdatomic.h>
+#include <pthread.h>
+#include <time.h>
+
+typedef struct edgex_circuit_entry
+{
+  uint32_t failures;
+  uint64_t total;
+  uint64_t next;
+  bool open;
+} edgex_circuit_entry;
+
+typedef edgex_map(edgex_circuit_entry) edgex_map_circuit_entry;
+
+struct edgex_circuit_t
+{
+  iot_logger_t *lc;
+  uint64_t maxbackoff;
+  uint32_t limit;
+  edgex_map_circuit_entry entries;
+  atomic_uint failing;
+  uint32_t open;
+  uint64_t failures;
+  uint64_t skipped;
+  pthread_mutex_t lock;
+};
+
+static uint64_t monotime_ms (void)
+{
+  struct timespec ts;
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+edgex_circuit_t *edgex_circuit_alloc (iot_logger_t *lc, uint32_t maxbackoff, uint32_t limit)
+{
+  edgex_circuit_t *c = calloc (1, sizeof (edgex_circuit_t));
+  c->lc = lc;
+  c->maxbackoff = maxbackoff;
+  c->limit = limit ? limit : 1;
+  edgex_map_init (&c->entries);
+  atomic_init (&c->failing, 0);
+  pthread_mutex_init (&c->lock, NULL);
+  return c;
+}
+
+bool edgex_circuit_allow (edgex_circuit_t *c, const char *device)
+{
+  bool result = true;
+  edgex_circuit_entry *e;
+
+  /* Nothing to check while all devices are healthy */
+
+  if (atomic_load (&c->failing) == 0)
+  {
+    return true;
+  }
+
+  uint64_t now = monotime_ms ();
+  pthread_mutex_lock (&c->lock);
+  e = edgex_map_get (&c->entries, device);
+  if (e && e->failures)
+  {
+    if (now < e->next)
+    {
+      c->skipped++;
+      result = false;
+    }
+    else if (e->open)
+    {
+      /* Let this read through as a probe, holding off any others until it is due again */
+      e->next = now + c->maxbackoff;
+    }
+  }
+  pthread_mutex_unlock (&c->lock);
+  return result;
+}
+
+void edgex_circuit_result (edgex_circuit_t *c, const char *device, uint64_t interval, bool ok)
+{
+  edgex_circuit_entry *e;
+  uint32_t failures = 0;
+  bool opened = false;
+  bool closed = false;
+
+  if (ok && atomic_load (&c->failing) == 0)
+  {
+    return;
+  }
+
+  uint64_t now = monotime_ms ();
+  pthread_mutex_lock (&c->lock);
+  e = edgex_map_get (&c->entries, device);
+  if (ok)
+  {
+    if (e && e->failures)
+    {
+      failures = e->failures;
+      closed = e->open;
+      if (e->open)
+      {
+        c->open--;
+      }
+      e->failures = 0;
+      e->open = false;
+      atomic_fetch_sub (&c->failing, 1);
+    }
+  }
+  else
+  {
+    uint64_t delay = interval * 2;
+    if (e == NULL)
+    {
+      edgex_circuit_entry entry = { 0, 0, 0, false };
+      edgex_map_set (&c->entries, device, entry);
+      e = edgex_map_get (&c->entries, device);
+    }
+    if (e->failures == 0)
+    {
+      atomic_fetch_add (&c->failing, 1);
+    }
+    e->failures++;
+    e->total++;
+    c->failures++;
+    for (uint32_t i = 1; i < e->failures && delay < c->maxbackoff; i++)
+    {
+      delay *= 2;
+    }
+    if (!e->open && e->failures >= c->limit)
+    {
+      e->open = true;
+      c->open++;
+      opened = true;
+      failures = e->failures;
+    }
+    if (e->open || delay > c->maxbackoff)
+    {
+      delay = c->maxbackoff;
+    }
+    e->next = now + delay;
+  }
+  pthread_mutex_unlock (&c->lock);
+
+  if (opened)
+  {
+    iot_log_warn
+    (
+      c->lc, "AutoEvents: device %s failed %u consecutive reads, probing every %" PRIu64 "ms",
+      device, failures, c->maxbackoff
+    );
+  }
+  else if (closed)
+  {
+    iot_log_info (c->lc, "AutoEvents: device %s recovered after %u failed reads", device, failures);
+  }
+}
+
+void edgex_circuit_remove (edgex_circuit_t *c, const char *device)
+{
+  edgex_circuit_entry *e;
+
+  pthread_mutex_lock (&c->lock);
+  e = edgex_map_get (&c->entries, device);
+  if (e)
+  {
+    if (e->failures)
+    {
+      atomic_fetch_sub (&c->failing, 1);
+    }
+    if (e->open)
+    {
+      c->open--;
+    }
+    edgex_map_remove (&c->entries, device);
+  }
+  pthread_mutex_unlock (&c->lock);
+}
+
+void edgex_circuit_getstats (edgex_circuit_t *c, edgex_circuit_stats *stats)
+{
+  pthread_mutex_lock (&c->lock);
+  stats->failing = atomic_load (&c->failing);
+  stats->open = c->open;
+  stats->failures = c->failures;
+  stats->skipped = c->skipped;
+  pthread_mutex_unlock (&c->lock);
+}
+
+JSON_Value *edgex_circuit_devices (edgex_circuit_t *c)
+{
+  const char *name;
+  JSON_Value *result = json_value_init_object ();
+  JSON_Object *obj = json_value_get_object (result);
+
+  pthread_mutex_lock (&c->lock);
+  edgex_map_iter i = edgex_map_iter (c->entries);
+  while ((name = edgex_map_next (&c->entries, &i)))
+  {
+    edgex_circuit_entry *e = edgex_map_get (&c->entries, name);
+    JSON_Value *dval = json_value_init_object ();
+    JSON_Object *dobj = json_value_get_object (dval);
+    json_object_set_uint (dobj, "Failures", e->failures);
+    json_object_set_uint (dobj, "TotalFailures", e->total);
+    json_object_set_boolean (dobj, "Open", e->open);
+    json_object_set_value (obj, name, dval);
+  }
+  pthread_mutex_unlock (&c->lock);
+  return result;
+}
+
+void edgex_circuit_free (edgex_circuit_t *c)
+{
+  if (c)
+  {
+    edgex_map_deinit (&c->entries);
+    pthread_mutex_destroy (&c->lock);
+    free (c);
+  }
+}
@@ -0,0 +1,66 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#ifndef _EDGEX_DEVICE_CIRCUIT_H_
+#define _EDGEX_DEVICE_CIRCUIT_H_ 1
+
+#include "edgex/edgex-logging.h"
+#include "parson.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Failure tracking for AutoEvent reads, per device. After a failed read, the
+ * device's AutoEvents are not run again until a delay has passed, starting at
+ * twice the AutoEvent interval and doubling with each consecutive failure, up
+ * to a maximum. Once the number of consecutive failures reaches a limit the
+ * circuit opens: a single probe read is then allowed at the maximum interval
+ * until one succeeds, at which point normal operation resumes.
+ */
+
+#define EDGEX_CIRCUIT_DEFAULT_LIMIT 5
+
+typedef struct edgex_circuit_t edgex_circuit_t;
+
+typedef struct edgex_circuit_stats
+{
+  uint32_t failing;
+  uint32_t open;
+  uint64_t failures;
+  uint64_t skipped;
+} edgex_circuit_stats;
+
+/*
+ * maxbackoff: the longest delay after a failure, and the interval between probes of an open circuit (ms).
+ * limit: the number of consecutive failures after which the circuit opens.
+ */
+
+edgex_circuit_t *edgex_circuit_alloc (iot_logger_t *lc, uint32_t maxbackoff, uint32_t limit);
+
+/* Whether a read of the device should be made now. Returns false if it is backing off */
+
+bool edgex_circuit_allow (edgex_circuit_t *c, const char *device);
+
+/* Record the outcome of a read, made by an AutoEvent with the given interval (ms) */
+
+void edgex_circuit_result (edgex_circuit_t *c, const char *device, uint64_t interval, bool ok);
+
+/* Forget the failures of a device, when it is removed */
+
+void edgex_circuit_remove (edgex_circuit_t *c, const char *device);
+
+void edgex_circuit_getstats (edgex_circuit_t *c, edgex_circuit_stats *stats);
+
+/* A JSON object describing each device which has failed, keyed by device name */
+
+JSON_Value *edgex_circuit_devices (edgex_circuit_t *c);
+
+void edgex_circuit_free (edgex_circuit_t *c);
+
+#endif
@@ -11,6 +11,23 @@
 
 #include "edgex/edgex.h"
 #include "edgex/devsdk.h"
+#include "map.h"
+#include "transform.h"
+
+/*
+ * An assertion on a resource's readings, parsed into a value of the resource's
+ * type so that readings may be compared without formatting them. The formats
+ * field records, as a bitmask over edgex_floatformat, the float formats under
+ * which the value formats exactly as the assertion text; under other formats
+ * no reading can match.
+ */
+
+typedef struct edgex_assertion
+{
+  const char *text;
+  unsigned formats;
+  edgex_device_commandresult value;
+} edgex_assertion;
 
 typedef struct edgex_cmdinfo
 {
@@ -19,9 +36,30 @@ typedef struct edgex_cmdinfo
   unsigned nreqs;
   edgex_device_commandrequest *reqs;
   edgex_propertyvalue **pvals;
-  edgex_nvpairs **maps;
+  edgex_map_string **maps;
   char **dfls;
+  uint64_t *maxage;
+  edgex_transform *xforms;
+  unsigned *xfruns;
+  edgex_assertion *asserts;
+  bool cached;
+  void *plan;
+  edgex_device_release_command release;
+  void *impl;
   struct edgex_cmdinfo *next;
 } edgex_cmdinfo;
 
+/* Index of a profile's command info by name, holding the get and set variants of each */
+
+typedef struct edgex_cmdpair
+{
+  edgex_cmdinfo *get;
+  edgex_cmdinfo *set;
+} edgex_cmdpair;
+
+typedef struct edgex_cmdindex
+{
+  edgex_map(edgex_cmdpair) map;
+} edgex_cmdindex;
+
 #endif
@@ -122,6 +122,20 @@ static void toml_rtob2 (const char *raw, bool *ret)
   }
 }
 
+/* As toml_rtod but also accept integers */
+
+static void toml_rtod2 (const char *raw, double *ret)
+{
+  if (raw && toml_rtod (raw, ret) != 0)
+  {
+    int64_t dummy;
+    if (toml_rtoi (raw, &dummy) == 0)
+    {
+      *ret = dummy;
+    }
+  }
+}
+
 /* As toml_rtoi but return uint16 */
 
 static void toml_rtoui16
@@ -223,6 +237,7 @@ static void parseClient
   {
     toml_rtos2 (toml_raw_in (client, "Host"), &endpoint->host);
     toml_rtoui16 (toml_raw_in (client, "Port"), &endpoint->port, lc, err);
+    toml_rtos2 (toml_raw_in (client, "UnixSocket"), &endpoint->unixsocket);
   }
 }
 
@@ -291,7 +306,6 @@ void edgex_device_overrideConfig (iot_logger_t *lc, const char *sname, edgex_nvp
   free (query);
 }
 
-#if 0
 void edgex_device_process_configured_watchers
   (edgex_device_service *svc, toml_array_t *watchers, edgex_error *err)
 {
@@ -313,20 +327,21 @@ void edgex_device_process_configured_watchers
       toml_rtos2 (toml_raw_in (table, "DeviceProfile"), &watcher.profile);
       toml_rtos2 (toml_raw_in (table, "Key"), &watcher.key);
       toml_rtos2 (toml_raw_in (table, "MatchString"), &watcher.matchstring);
-      int n = 0;
+      int nids = 0;
       toml_array_t *arr = toml_array_in (table, "Identifiers");
       if (arr)
       {
-        while (toml_raw_at (arr, n))
-        { n++; }
+        while (toml_raw_at (arr, nids))
+        { nids++; }
       }
-      watcher.ids = malloc (sizeof (char *) * (n + 1));
-      for (int j = 0; j < n; j++)
+      watcher.ids = malloc (sizeof (char *) * (nids + 1));
+      for (int j = 0; j < nids; j++)
       {
         raw = toml_raw_at (arr, j);
+        watcher.ids[j] = NULL;
         toml_rtos2 (raw, &watcher.ids[j]);
       }
-      watcher.ids[n] = NULL;
+      watcher.ids[nids] = NULL;
       if (namestr && watcher.profile && watcher.key)
       {
         edgex_map_set (&svc->config.watchers, namestr, watcher);
@@ -343,18 +358,18 @@ void edgex_device_process_configured_watchers
         free (watcher.matchstring);
         if (watcher.ids)
         {
-          for (int n = 0; watcher.ids[n]; n++)
+          for (int j = 0; watcher.ids[j]; j++)
           {
-            free (watcher.ids[n]);
+            free (watcher.ids[j]);
           }
           free (watcher.ids);
         }
         *err = EDGEX_BAD_CONFIG;
       }
+      free (namestr);
     }
   }
 }
-#endif
 
 static char *get_nv_config_string
   (const edgex_nvpairs *config, const char *key)
@@ -458,6 +473,24 @@ void edgex_device_populateConfig
     get_nv_config_string (config, "Service/StartupMsg");
   svc->config.service.checkinterval =
     get_nv_config_string (config, "Service/CheckInterval");
+  svc->config.service.unixsocket =
+    get_nv_config_string (config, "Service/UnixSocket");
+  svc->config.service.serverthreads =
+    get_nv_config_uint32 (svc->logger, config, "Service/ServerThreads", err);
+  svc->config.service.maxconnections =
+    get_nv_config_uint32 (svc->logger, config, "Service/MaxConnections", err);
+  svc->config.service.connectiontimeout =
+    get_nv_config_uint32 (svc->logger, config, "Service/ConnectionTimeout", err);
+  svc->config.service.maxcommands =
+    get_nv_config_uint32 (svc->logger, config, "Service/MaxCommands", err);
+  svc->config.service.maxdevicecommands =
+    get_nv_config_uint32 (svc->logger, config, "Service/MaxDeviceCommands", err);
+  svc->config.service.commandqueuetime =
+    get_nv_config_uint32 (svc->logger, config, "Service/CommandQueueTime", err);
+  if (svc->config.service.commandqueuetime == 0)
+  {
+    svc->config.service.commandqueuetime = EDGEX_ADMISSION_DEFAULT_QUEUETIME;
+  }
 
   char *lstr = get_nv_config_string (config, "Service/Labels");
   if (lstr)
@@ -507,6 +540,94 @@ void edgex_device_populateConfig
     get_nv_config_string (config, "Device/ProfilesDir");
   svc->config.device.sendreadingsonchanged =
     get_nv_config_bool (config, "Device/SendReadingsOnChanged", false);
+  svc->config.device.eventbatchsize =
+    get_nv_config_uint32 (svc->logger, config, "Device/EventBatchSize", err);
+  svc->config.device.eventbatchlinger =
+    get_nv_config_uint32 (svc->logger, config, "Device/EventBatchLinger", err);
+  svc->config.device.compactbatches =
+    get_nv_config_bool (config, "Device/CompactBatches", false);
+  svc->config.device.sffile =
+    get_nv_config_string (config, "Device/StoreForwardFile");
+  svc->config.device.sfsize =
+    get_nv_config_uint32 (svc->logger, config, "Device/StoreForwardSize", err);
+  svc->config.device.sfretention =
+    get_nv_config_uint32 (svc->logger, config, "Device/StoreForwardRetention", err);
+  svc->config.device.sfretry =
+    get_nv_config_uint32 (svc->logger, config, "Device/StoreForwardRetry", err);
+  svc->config.device.snapshotfile =
+    get_nv_config_string (config, "Device/SnapshotFile");
+  svc->config.device.asyncpostlimit =
+    get_nv_config_uint32 (svc->logger, config, "Device/AsyncPostLimit", err);
+  svc->config.device.postqdepth =
+    get_nv_config_uint32 (svc->logger, config, "Device/PostQueueDepth", err);
+  svc->config.device.postqpolicy =
+    get_nv_config_string (config, "Device/PostQueuePolicy");
+  char *compression = get_nv_config_string (config, "Device/Compression");
+  if (!edgex_http_compression_parse (compression, &svc->config.device.compression))
+  {
+    iot_log_error (svc->logger, "Invalid Compression %s", compression);
+    *err = EDGEX_BAD_CONFIG;
+  }
+  free (compression);
+  svc->config.device.shortestfloats =
+    get_nv_config_bool (config, "Device/ShortestFloats", false);
+  svc->config.device.allcmdconcurrency =
+    get_nv_config_uint32 (svc->logger, config, "Device/AllCmdConcurrency", err);
+  svc->config.device.allcmdtimeout =
+    get_nv_config_uint32 (svc->logger, config, "Device/AllCmdTimeout", err);
+  svc->config.device.coalescereads =
+    get_nv_config_bool (config, "Device/CoalesceReads", true);
+  svc->config.device.serializecalls =
+    get_nv_config_bool (config, "Device/SerializeDeviceCalls", false);
+  svc->config.device.aetick =
+    get_nv_config_uint32 (svc->logger, config, "Device/AutoEventTick", err);
+  svc->config.device.aespread =
+    get_nv_config_bool (config, "Device/AutoEventSpread", false);
+  svc->config.device.aegroup =
+    get_nv_config_bool (config, "Device/AutoEventGrouping", false);
+  svc->config.device.aebackoff =
+    get_nv_config_uint32 (svc->logger, config, "Device/AutoEventBackoff", err);
+  svc->config.device.aefaillimit =
+    get_nv_config_uint32 (svc->logger, config, "Device/AutoEventFailureLimit", err);
+  if (svc->config.device.aefaillimit == 0)
+  {
+    svc->config.device.aefaillimit = EDGEX_CIRCUIT_DEFAULT_LIMIT;
+  }
+  svc->config.device.aewindow =
+    get_nv_config_uint32 (svc->logger, config, "Device/AutoEventWindow", err);
+  svc->config.device.aethreads =
+    get_nv_config_uint32 (svc->logger, config, "Device/AutoEventThreads", err);
+  svc->config.device.postthreads =
+    get_nv_config_uint32 (svc->logger, config, "Device/PostThreads", err);
+  svc->config.device.latencymetrics =
+    get_nv_config_bool (config, "Device/LatencyMetrics", false);
+  svc->config.device.driverconcurrency =
+    get_nv_config_uint32 (svc->logger, config, "Device/DriverConcurrency", err);
+  svc->config.device.drivermaxwait =
+    get_nv_config_uint32 (svc->logger, config, "Device/DriverMaxWait", err);
+  if (svc->config.device.drivermaxwait == 0)
+  {
+    svc->config.device.drivermaxwait = EDGEX_QOS_DEFAULT_MAXWAIT;
+  }
+  /* An explicit threshold of 0 means that all bodies are compressed, so the default applies only if none is set */
+
+  char *threshold = get_nv_config_string (config, "Device/CompressionThreshold");
+  svc->config.device.compressthreshold = threshold ?
+    get_nv_config_uint32 (svc->logger, config, "Device/CompressionThreshold", err) : EDGEX_COMPRESS_DEFAULT_THRESHOLD;
+  free (threshold);
+  svc->config.device.streamthreshold =
+    get_nv_config_uint32 (svc->logger, config, "Device/StreamThreshold", err);
+  if (svc->config.device.streamthreshold == 0)
+  {
+    svc->config.device.streamthreshold = EDGEX_STREAM_DEFAULT_THRESHOLD;
+  }
+  char *timesource = get_nv_config_string (config, "Device/Timestamps");
+  if (!edgex_device_timesource_parse (timesource, &svc->config.device.timesource))
+  {
+    iot_log_error (svc->logger, "Invalid Timestamps %s", timesource);
+    *err = EDGEX_BAD_CONFIG;
+  }
+  free (timesource);
 
   for (const edgex_nvpairs *iter = config; iter; iter = iter->next)
   {
@@ -520,6 +641,52 @@ void edgex_device_populateConfig
   svc->config.logging.useremote =
     get_nv_config_bool (config, "Logging/EnableRemote", false);
   svc->config.logging.file = get_nv_config_string (config, "Logging/File");
+  svc->config.logging.maxfilesize =
+    get_nv_config_uint32 (svc->logger, config, "Logging/MaxFileSize", err);
+  svc->config.logging.buffersize =
+    get_nv_config_uint32 (svc->logger, config, "Logging/BufferSize", err);
+  svc->config.logging.overflowpolicy =
+    get_nv_config_string (config, "Logging/OverflowPolicy");
+  svc->config.logging.remotebatch =
+    get_nv_config_uint32 (svc->logger, config, "Logging/RemoteBatchSize", err);
+  svc->config.logging.remoteinterval =
+    get_nv_config_uint32 (svc->logger, config, "Logging/RemoteFlushInterval", err);
+
+  svc->config.tracing.exporter = get_nv_config_string (config, "Tracing/Exporter");
+  svc->config.tracing.destination = get_nv_config_string (config, "Tracing/Destination");
+  svc->config.tracing.buffersize =
+    get_nv_config_uint32 (svc->logger, config, "Tracing/BufferSize", err);
+
+  svc->config.mqtt.broker = get_nv_config_string (config, "MQTT/Broker");
+  svc->config.mqtt.clientid = get_nv_config_string (config, "MQTT/ClientId");
+  svc->config.mqtt.username = get_nv_config_string (config, "MQTT/Username");
+  svc->config.mqtt.password = get_nv_config_string (config, "MQTT/Password");
+  svc->config.mqtt.topic = get_nv_config_string (config, "MQTT/Topic");
+  svc->config.mqtt.qos = get_nv_config_uint32 (svc->logger, config, "MQTT/QoS", err);
+  svc->config.mqtt.cleansession = get_nv_config_bool (config, "MQTT/CleanSession", false);
+  svc->config.mqtt.keepalive =
+    get_nv_config_uint32 (svc->logger, config, "MQTT/KeepAlive", err);
+  svc->config.mqtt.maxinflight =
+    get_nv_config_uint32 (svc->logger, config, "MQTT/MaxInFlight", err);
+  svc->config.mqtt.buffersize =
+    get_nv_config_uint32 (svc->logger, config, "MQTT/BufferSize", err);
+
+  svc->config.eventring.name = get_nv_config_string (config, "EventRing/Name");
+  svc->config.eventring.size =
+    get_nv_config_uint32 (svc->logger, config, "EventRing/Size", err);
+  svc->config.eventring.format = get_nv_config_string (config, "EventRing/Format");
+
+  for (unsigned g = 0; g < EDGEX_PLACEMENT_GROUPS; g++)
+  {
+    char key[32];
+    const char *group = edgex_placement_name (g);
+    snprintf (key, sizeof (key), "Threads/%sCPUs", group);
+    svc->config.threads[g].cpus = get_nv_config_string (config, key);
+    snprintf (key, sizeof (key), "Threads/%sPolicy", group);
+    svc->config.threads[g].policy = get_nv_config_string (config, key);
+    snprintf (key, sizeof (key), "Threads/%sPriority", group);
+    svc->config.threads[g].priority = get_nv_config_uint32 (svc->logger, config, key, err);
+  }
 
   edgex_device_updateConf (svc, config);
 }
@@ -548,7 +715,26 @@ void edgex_device_freeConfig (edgex_device_service *svc)
   free (svc->config.endpoints.data.host);
   free (svc->config.endpoints.metadata.host);
   free (svc->config.endpoints.logging.host);
+  free (svc->config.endpoints.data.unixsocket);
+  free (svc->config.endpoints.metadata.unixsocket);
+  free (svc->config.endpoints.logging.unixsocket);
+  free (svc->config.service.unixsocket);
   free (svc->config.logging.file);
+  free (svc->config.logging.overflowpolicy);
+  free (svc->config.tracing.exporter);
+  free (svc->config.tracing.destination);
+  free (svc->config.mqtt.broker);
+  free (svc->config.mqtt.clientid);
+  free (svc->config.mqtt.username);
+  free (svc->config.mqtt.password);
+  free (svc->config.mqtt.topic);
+  free (svc->config.eventring.name);
+  free (svc->config.eventring.format);
+  for (unsigned g = 0; g < EDGEX_PLACEMENT_GROUPS; g++)
+  {
+    free (svc->config.threads[g].cpus);
+    free (svc->config.threads[g].policy);
+  }
   free (svc->config.service.host);
   free (svc->config.service.startupmsg);
   free (svc->config.service.checkinterval);
@@ -557,6 +743,9 @@ void edgex_device_freeConfig (edgex_device_service *svc)
   free (svc->config.device.removecmd);
   free (svc->config.device.removecmdargs);
   free (svc->config.device.profilesdir);
+  free (svc->config.device.sffile);
+  free (svc->config.device.snapshotfile);
+  free (svc->config.device.postqpolicy);
 
   if (svc->config.service.labels)
   {
@@ -610,18 +799,21 @@ int edgex_device_handler_config
   JSON_Object *mobj = json_value_get_object (mval);
   json_object_set_string (mobj, "Host", svc->config.endpoints.metadata.host);
   json_object_set_uint (mobj, "Port", svc->config.endpoints.metadata.port);
+  json_object_set_string (mobj, "UnixSocket", svc->config.endpoints.metadata.unixsocket);
   json_object_set_value (cobj, "Metadata", mval);
 
   JSON_Value *dval = json_value_init_object ();
   JSON_Object *dobj = json_value_get_object (dval);
   json_object_set_string (dobj, "Host", svc->config.endpoints.data.host);
   json_object_set_uint (dobj, "Port", svc->config.endpoints.data.port);
+  json_object_set_string (dobj, "UnixSocket", svc->config.endpoints.data.unixsocket);
   json_object_set_value (cobj, "Data", dval);
 
   JSON_Value *lsval = json_value_init_object ();
   JSON_Object *lsobj = json_value_get_object (lsval);
   json_object_set_string (lsobj, "Host", svc->config.endpoints.logging.host);
   json_object_set_uint (lsobj, "Port", svc->config.endpoints.logging.port);
+  json_object_set_string (lsobj, "UnixSocket", svc->config.endpoints.logging.unixsocket);
   json_object_set_value (cobj, "Data", lsval);
 
   json_object_set_value (obj, "Clients", cval);
@@ -629,9 +821,56 @@ int edgex_device_handler_config
   JSON_Value *lval = json_value_init_object ();
   JSON_Object *lobj = json_value_get_object (lval);
   json_object_set_string (lobj, "File", svc->config.logging.file);
+  json_object_set_uint (lobj, "MaxFileSize", svc->config.logging.maxfilesize);
+  json_object_set_uint (lobj, "BufferSize", svc->config.logging.buffersize);
+  json_object_set_string (lobj, "OverflowPolicy", svc->config.logging.overflowpolicy);
+  json_object_set_uint (lobj, "RemoteBatchSize", svc->config.logging.remotebatch);
+  json_object_set_uint (lobj, "RemoteFlushInterval", svc->config.logging.remoteinterval);
   json_object_set_boolean (lobj, "EnableRemote", svc->config.logging.useremote);
   json_object_set_value (obj, "Logging", lval);
 
+  JSON_Value *tval = json_value_init_object ();
+  JSON_Object *tobj = json_value_get_object (tval);
+  json_object_set_string (tobj, "Exporter", svc->config.tracing.exporter);
+  json_object_set_string (tobj, "Destination", svc->config.tracing.destination);
+  json_object_set_uint (tobj, "BufferSize", svc->config.tracing.buffersize);
+  json_object_set_value (obj, "Tracing", tval);
+
+  JSON_Value *qval = json_value_init_object ();
+  JSON_Object *qobj = json_value_get_object (qval);
+  json_object_set_string (qobj, "Broker", svc->config.mqtt.broker);
+  json_object_set_string (qobj, "ClientId", svc->config.mqtt.clientid);
+  json_object_set_string (qobj, "Username", svc->config.mqtt.username);
+  json_object_set_string (qobj, "Topic", svc->config.mqtt.topic);
+  json_object_set_uint (qobj, "QoS", svc->config.mqtt.qos);
+  json_object_set_boolean (qobj, "CleanSession", svc->config.mqtt.cleansession);
+  json_object_set_uint (qobj, "KeepAlive", svc->config.mqtt.keepalive);
+  json_object_set_uint (qobj, "MaxInFlight", svc->config.mqtt.maxinflight);
+  json_object_set_uint (qobj, "BufferSize", svc->config.mqtt.buffersize);
+  json_object_set_value (obj, "MQTT", qval);
+
+  JSON_Value *rval = json_value_init_object ();
+  JSON_Object *robj = json_value_get_object (rval);
+  json_object_set_string (robj, "Name", svc->config.eventring.name);
+  json_object_set_uint (robj, "Size", svc->config.eventring.size);
+  json_object_set_string (robj, "Format", svc->config.eventring.format);
+  json_object_set_value (obj, "EventRing", rval);
+
+  JSON_Value *thval = json_value_init_object ();
+  JSON_Object *thobj = json_value_get_object (thval);
+  for (unsigned g = 0; g < EDGEX_PLACEMENT_GROUPS; g++)
+  {
+    char key[32];
+    const char *group = edgex_placement_name (g);
+    snprintf (key, sizeof (key), "%sCPUs", group);
+    json_object_set_string (thobj, key, svc->config.threads[g].cpus);
+    snprintf (key, sizeof (key), "%sPolicy", group);
+    json_object_set_string (thobj, key, svc->config.threads[g].policy);
+    snprintf (key, sizeof (key), "%sPriority", group);
+    json_object_set_uint (thobj, key, svc->config.threads[g].priority);
+  }
+  json_object_set_value (obj, "Threads", thval);
+
   JSON_Value *sval = json_value_init_object ();
   JSON_Object *sobj = json_value_get_object (sval);
   json_object_set_string (sobj, "Host", svc->config.service.host);
@@ -645,6 +884,16 @@ int edgex_device_handler_config
   json_object_set_string (sobj, "StartupMsg", svc->config.service.startupmsg);
   json_object_set_string
     (sobj, "CheckInterval", svc->config.service.checkinterval);
+  json_object_set_string (sobj, "UnixSocket", svc->config.service.unixsocket);
+  json_object_set_uint
+    (sobj, "ServerThreads", svc->config.service.serverthreads);
+  json_object_set_uint
+    (sobj, "MaxConnections", svc->config.service.maxconnections);
+  json_object_set_uint
+    (sobj, "ConnectionTimeout", svc->config.service.connectiontimeout);
+  json_object_set_uint (sobj, "MaxCommands", svc->config.service.maxcommands);
+  json_object_set_uint (sobj, "MaxDeviceCommands", svc->config.service.maxdevicecommands);
+  json_object_set_uint (sobj, "CommandQueueTime", svc->config.service.commandqueuetime);
 
   lval = json_value_init_array ();
   JSON_Array *larr = json_value_get_array (lval);
@@ -672,6 +921,53 @@ int edgex_device_handler_config
   json_object_set_string (dobj, "ProfilesDir", svc->config.device.profilesdir);
   json_object_set_boolean
     (dobj, "SendReadingsOnChanged", svc->config.device.sendreadingsonchanged);
+  json_object_set_uint
+    (dobj, "EventBatchSize", svc->config.device.eventbatchsize);
+  json_object_set_uint
+    (dobj, "EventBatchLinger", svc->config.device.eventbatchlinger);
+  json_object_set_boolean
+    (dobj, "CompactBatches", svc->config.device.compactbatches);
+  json_object_set_string
+    (dobj, "StoreForwardFile", svc->config.device.sffile);
+  json_object_set_uint (dobj, "StoreForwardSize", svc->config.device.sfsize);
+  json_object_set_uint
+    (dobj, "StoreForwardRetention", svc->config.device.sfretention);
+  json_object_set_uint (dobj, "StoreForwardRetry", svc->config.device.sfretry);
+  json_object_set_string
+    (dobj, "SnapshotFile", svc->config.device.snapshotfile);
+  json_object_set_uint
+    (dobj, "AsyncPostLimit", svc->config.device.asyncpostlimit);
+  json_object_set_uint (dobj, "PostQueueDepth", svc->config.device.postqdepth);
+  json_object_set_string
+    (dobj, "PostQueuePolicy", svc->config.device.postqpolicy);
+  json_object_set_string
+    (dobj, "Compression", edgex_http_compression_name (svc->config.device.compression));
+  json_object_set_uint
+    (dobj, "CompressionThreshold", svc->config.device.compressthreshold);
+  json_object_set_uint
+    (dobj, "StreamThreshold", svc->config.device.streamthreshold);
+  json_object_set_boolean
+    (dobj, "ShortestFloats", svc->config.device.shortestfloats);
+  json_object_set_uint
+    (dobj, "AllCmdConcurrency", svc->config.device.allcmdconcurrency);
+  json_object_set_uint (dobj, "AllCmdTimeout", svc->config.device.allcmdtimeout);
+  json_object_set_boolean
+    (dobj, "CoalesceReads", svc->config.device.coalescereads);
+  json_object_set_boolean
+    (dobj, "SerializeDeviceCalls", svc->config.device.serializecalls);
+  json_object_set_uint (dobj, "AutoEventTick", svc->config.device.aetick);
+  json_object_set_boolean (dobj, "AutoEventSpread", svc->config.device.aespread);
+  json_object_set_boolean (dobj, "AutoEventGrouping", svc->config.device.aegroup);
+  json_object_set_uint (dobj, "AutoEventBackoff", svc->config.device.aebackoff);
+  json_object_set_uint (dobj, "AutoEventFailureLimit", svc->config.device.aefaillimit);
+  json_object_set_uint (dobj, "AutoEventWindow", svc->config.device.aewindow);
+  json_object_set_uint (dobj, "AutoEventThreads", svc->config.device.aethreads);
+  json_object_set_uint (dobj, "PostThreads", svc->config.device.postthreads);
+  json_object_set_boolean (dobj, "LatencyMetrics", svc->config.device.latencymetrics);
+  json_object_set_uint (dobj, "DriverConcurrency", svc->config.device.driverconcurrency);
+  json_object_set_uint (dobj, "DriverMaxWait", svc->config.device.drivermaxwait);
+  json_object_set_string
+    (dobj, "Timestamps", edgex_device_timesource_name (svc->config.device.timesource));
   json_object_set_value (obj, "Device", dval);
 
   edgex_nvpairs *iter = svc->config.driverconf;
@@ -787,6 +1083,20 @@ void edgex_device_process_configured_devices
                 (toml_raw_in (aetable, "Frequency"), &newauto->frequency);
               toml_rtob2
                 (toml_raw_in (aetable, "OnChange"), &newauto->onChange);
+              toml_rtod2
+                (toml_raw_in (aetable, "Deadband"), &newauto->deadband);
+              toml_rtod2
+                (toml_raw_in (aetable, "DeadbandPercent"), &newauto->deadbandPercent);
+              toml_rtos2
+                (toml_raw_in (aetable, "Heartbeat"), &newauto->heartbeat);
+              toml_rtos2
+                (toml_raw_in (aetable, "Cron"), &newauto->cron);
+              toml_rtob2
+                (toml_raw_in (aetable, "Align"), &newauto->align);
+              if (newauto->frequency == NULL)
+              {
+                newauto->frequency = strdup ("");
+              }
               newauto->next = autos;
               autos = newauto;
             }
@@ -11,8 +11,11 @@
 
 #include "edgex/devsdk.h"
 #include "rest-server.h"
+#include "rest.h"
 #include "toml.h"
 #include "map.h"
+#include "placement.h"
+#include "edgex-time.h"
 
 typedef struct edgex_device_serviceinfo
 {
@@ -23,12 +26,20 @@ typedef struct edgex_device_serviceinfo
   char *startupmsg;
   struct timespec timeout;
   char *checkinterval;
+  char *unixsocket;
+  uint32_t serverthreads;
+  uint32_t maxconnections;
+  uint32_t connectiontimeout;
+  uint32_t maxcommands;
+  uint32_t maxdevicecommands;
+  uint32_t commandqueuetime;
 } edgex_device_serviceinfo;
 
 typedef struct edgex_device_service_endpoint
 {
   char *host;
   uint16_t port;
+  char *unixsocket;
 } edgex_device_service_endpoint;
 
 typedef struct edgex_service_endpoints
@@ -50,15 +61,86 @@ typedef struct edgex_device_deviceinfo
   char *removecmdargs;
   char *profilesdir;
   bool sendreadingsonchanged;
+  uint32_t eventbatchsize;
+  uint32_t eventbatchlinger;
+  bool compactbatches;
+  char *sffile;
+  uint32_t sfsize;
+  uint32_t sfretention;
+  uint32_t sfretry;
+  char *snapshotfile;
+  uint32_t asyncpostlimit;
+  uint32_t postqdepth;
+  char *postqpolicy;
+  edgex_compression compression;
+  uint32_t compressthreshold;
+  uint32_t streamthreshold;
+  bool shortestfloats;
+  uint32_t allcmdconcurrency;
+  uint32_t allcmdtimeout;
+  bool coalescereads;
+  bool serializecalls;
+  uint32_t aetick;
+  bool aespread;
+  bool aegroup;
+  uint32_t aebackoff;
+  uint32_t aefaillimit;
+  uint32_t aewindow;
+  uint32_t aethreads;
+  uint32_t postthreads;
+  bool latencymetrics;
+  uint32_t driverconcurrency;
+  uint32_t drivermaxwait;
+  edgex_timesource timesource;
 } edgex_device_deviceinfo;
 
 typedef struct edgex_device_logginginfo
 {
   char *file;
+  uint32_t maxfilesize;
+  uint32_t buffersize;
+  char *overflowpolicy;
+  uint32_t remotebatch;
+  uint32_t remoteinterval;
   bool useremote;
   iot_loglevel_t level;
 } edgex_device_logginginfo;
 
+typedef struct edgex_device_tracinginfo
+{
+  char *exporter;
+  char *destination;
+  uint32_t buffersize;
+} edgex_device_tracinginfo;
+
+typedef struct edgex_device_mqttinfo
+{
+  char *broker;
+  char *clientid;
+  char *username;
+  char *password;
+  char *topic;
+  uint32_t qos;
+  bool cleansession;
+  uint32_t keepalive;
+  uint32_t maxinflight;
+  uint32_t buffersize;
+} edgex_device_mqttinfo;
+
+typedef struct edgex_device_eventringinfo
+{
+  char *name;
+  uint32_t size;
+  char *format;
+} edgex_device_eventringinfo;
+
+typedef struct edgex_device_threadinfo
+{
+  char *cpus;
+  char *policy;
+  uint32_t priority;
+} edgex_device_threadinfo;
+
 typedef struct edgex_device_watcherinfo
 {
   char *profile;
@@ -75,6 +157,10 @@ typedef struct edgex_device_config
   edgex_service_endpoints endpoints;
   edgex_device_deviceinfo device;
   edgex_device_logginginfo logging;
+  edgex_device_tracinginfo tracing;
+  edgex_device_mqttinfo mqtt;
+  edgex_device_eventringinfo eventring;
+  edgex_device_threadinfo threads[EDGEX_PLACEMENT_GROUPS];
   edgex_nvpairs *driverconf;
   edgex_map_device_watcherinfo watchers;
 } edgex_device_config;
@@ -103,6 +189,9 @@ void edgex_device_freeConfig (edgex_device_service *svc);
 void edgex_device_process_configured_devices
   (edgex_device_service *svc, toml_array_t *devs, edgex_error *err);
 
+void edgex_device_process_configured_watchers
+  (edgex_device_service *svc, toml_array_t *watchers, edgex_error *err);
+
 int edgex_device_handler_config
 (
   void *ctx,
@@ -7,6 +7,7 @@
  */
 
 #include "consul.h"
+#include "placement.h"
 #include "edgex/registry.h"
 #include "edgex-rest.h"
 #include "rest.h"
@@ -14,13 +15,34 @@
 #include "config.h"
 #include "parson.h"
 #include "iot/base64.h"
+#include "pool.h"
+#include "map.h"
+#include "edgex-time.h"
+
+#include <time.h>
 
 #define CONF_PREFIX "edgex/core/1.0/"
 
+/* Delays before retrying after a failed poll, in milliseconds */
+
+#define POLL_BACKOFF_MIN 1000
+#define POLL_BACKOFF_MAX 60000
+
+/* The ModifyIndex of each key as last read, so that unchanged values can be skipped */
+
+typedef edgex_map(uint64_t) edgex_map_modindex;
+
+/*
+ * Decode the configuration values in a recursive KV read. Only keys which
+ * are not in the known map or whose ModifyIndex has changed are returned,
+ * and the map is updated.
+ */
+
 static edgex_nvpairs *read_pairs
 (
   iot_logger_t *lc,
   const char *json,
+  edgex_map_modindex *known,
   edgex_error *err
 )
 {
@@ -29,6 +51,7 @@ static edgex_nvpairs *read_pairs
   const char *enc;
   size_t nconfs;
   size_t rsize;
+  uint64_t modindex;
   JSON_Object *obj;
   edgex_nvpairs *pair;
   edgex_nvpairs *result = NULL;
@@ -40,8 +63,17 @@ static edgex_nvpairs *read_pairs
   for (size_t i = 0; i < nconfs; i++)
   {
     obj = json_array_get_object (configs, i);
-    pair = malloc (sizeof (edgex_nvpairs));
     key = json_object_get_string (obj, "Key");
+    modindex = json_object_get_uint (obj, "ModifyIndex");
+    if (key && modindex)
+    {
+      uint64_t *prev = edgex_map_get (known, key);
+      if (prev && *prev == modindex)
+      {
+        continue;
+      }
+    }
+    pair = malloc (sizeof (edgex_nvpairs));
     if (key)
     {
       // Skip the prefix and device name in the key
@@ -66,6 +98,7 @@ static edgex_nvpairs *read_pairs
     {
       iot_log_error (lc, "No Key field in consul response. JSON was %s", json);
       *err = EDGEX_CONSUL_RESPONSE;
+      free (pair);
       break;
     }
     enc = json_object_get_string (obj, "Value");
@@ -98,6 +131,10 @@ static edgex_nvpairs *read_pairs
       break;
     }
 
+    if (modindex)
+    {
+      edgex_map_set (known, key, modindex);
+    }
     pair->next = result;
     result = pair;
   }
@@ -112,8 +149,31 @@ struct updatejob
   edgex_registry_updatefn updater;
   void *updatectx;
   atomic_bool *updatedone;
+  edgex_map_modindex known;
+  unsigned seed;
 };
 
+/* Forget the known keys, so that the next read returns them all */
+
+static void reset_known (edgex_map_modindex *known)
+{
+  edgex_map_deinit (known);
+  edgex_map_init (known);
+}
+
+/* Wait for between half and all of the delay, returning early if polling is stopped */
+
+static void poll_backoff (struct updatejob *job, uint32_t delay)
+{
+  uint64_t ms = delay / 2 + rand_r (&job->seed) % (delay / 2 + 1);
+  struct timespec slice = { .tv_sec = 0, .tv_nsec = 100000000 };
+
+  for (uint64_t waited = 0; waited < ms && !*job->updatedone; waited += 100)
+  {
+    nanosleep (&slice, NULL);
+  }
+}
+
 static void poll_consul (void *p)
 {
   char *urltail;
@@ -121,6 +181,7 @@ static void poll_consul (void *p)
   edgex_nvpairs index;
   edgex_nvpairs *conf;
   edgex_error err;
+  uint32_t backoff = POLL_BACKOFF_MIN;
 
   struct updatejob *job = (struct updatejob *)p;
   urltail = job->url + strlen (job->url);
@@ -131,6 +192,7 @@ static void poll_consul (void *p)
 
   while (true)
   {
+    edgex_placement_sync (EDGEX_PLACEMENT_REGISTRY);
     memset (&ctx, 0, sizeof (edgex_ctx));
     err = EDGEX_OK;
     if (index.value)
@@ -149,21 +211,34 @@ static void poll_consul (void *p)
     }
     if (err.code == 0)
     {
-      conf = read_pairs (job->lc, ctx.buff, &err);
+      conf = read_pairs (job->lc, ctx.buff, &job->known, &err);
       if (err.code == 0)
       {
-        job->updater (job->updatectx, conf);
+        if (conf)
+        {
+          job->updater (job->updatectx, conf);
+        }
+        backoff = POLL_BACKOFF_MIN;
+      }
+      else
+      {
+        reset_known (&job->known);
       }
       edgex_nvpairs_free (conf);
     }
-    else
+    if (err.code)
     {
-      sleep (5);
+      free (index.value);
+      index.value = NULL;
+      iot_log_warn (job->lc, "Configuration poll failed, retrying in up to %ums", backoff);
+      poll_backoff (job, backoff);
+      backoff = (backoff < POLL_BACKOFF_MAX / 2) ? backoff * 2 : POLL_BACKOFF_MAX;
     }
     free (ctx.buff);
   }
   free (index.value);
   free (job->url);
+  edgex_map_deinit (&job->known);
   free (job);
 }
 
@@ -184,6 +259,9 @@ edgex_nvpairs *edgex_consul_client_get_config
   char url[URL_BUF_SIZE];
   edgex_nvpairs *result = NULL;
   edgex_registry_hostport *endpoint = (edgex_registry_hostport *)location;
+  struct updatejob *job = malloc (sizeof (struct updatejob));
+
+  edgex_map_init (&job->known);
 
   memset (&ctx, 0, sizeof (edgex_ctx));
   if (profile && *profile)
@@ -209,24 +287,25 @@ edgex_nvpairs *edgex_consul_client_get_config
 
   if (err->code == 0)
   {
-    result = read_pairs (lc, ctx.buff, err);
+    result = read_pairs (lc, ctx.buff, &job->known, err);
     if (err->code)
     {
       edgex_nvpairs_free (result);
       result = NULL;
+      reset_known (&job->known);
     }
   }
 
   free (ctx.buff);
 
-  struct updatejob *job = malloc (sizeof (struct updatejob));
+  job->seed = (unsigned)edgex_device_nanotime ();
   job->url = malloc (URL_BUF_SIZE);
   strcpy (job->url, url);
   job->lc = lc;
   job->updater = updater;
   job->updatectx = updatectx;
   job->updatedone = updatedone;
-  iot_threadpool_add_work (thpool, poll_consul, job, NULL);
+  edgex_pool_add_work (thpool, poll_consul, job);
 
   return result;
 }
@@ -10,9 +10,68 @@
 
 #include <stdlib.h>
 #include <string.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
 #include <uuid/uuid.h>
 
+/*
+ * IDs generated here are formatted as UUIDs: a random prefix chosen once per
+ * process, followed by a sequence number. Each thread claims a block of
+ * sequence numbers at a time, so generating an ID needs no system call,
+ * allocation or contended atomic operation.
+ */
+
+#define CRLID_BLOCKBITS 20
+
 static _Thread_local char *localid = NULL;
+static _Thread_local char genid[37];
+static _Thread_local uint64_t nextseq = 0;
+static _Thread_local uint64_t blockend = 0;
+
+static uint64_t prefix;
+static atomic_uint_fast64_t nextblock = 0;
+static pthread_once_t prefixonce = PTHREAD_ONCE_INIT;
+
+static void crlid_initprefix (void)
+{
+  uuid_t uid;
+  uuid_generate (uid);
+  memcpy (&prefix, uid, sizeof (prefix));
+}
+
+static char *crlid_hex (char *p, uint64_t v, unsigned digits)
+{
+  static const char hex[] = "0123456789abcdef";
+  for (unsigned i = digits; i > 0; i--)
+  {
+    p[i - 1] = hex[v & 0xf];
+    v >>= 4;
+  }
+  return p + digits;
+}
+
+static void crlid_generate (char *id)
+{
+  char *p = id;
+  if (nextseq == blockend)
+  {
+    pthread_once (&prefixonce, crlid_initprefix);
+    nextseq = atomic_fetch_add (&nextblock, 1) << CRLID_BLOCKBITS;
+    blockend = nextseq + (1u << CRLID_BLOCKBITS);
+  }
+  p = crlid_hex (p, prefix >> 32, 8);
+  *p++ = '-';
+  p = crlid_hex (p, prefix >> 16, 4);
+  *p++ = '-';
+  p = crlid_hex (p, prefix, 4);
+  *p++ = '-';
+  p = crlid_hex (p, nextseq >> 48, 4);
+  *p++ = '-';
+  p = crlid_hex (p, nextseq, 12);
+  *p = '\0';
+  nextseq++;
+}
 
 const char *edgex_device_get_crlid ()
 {
@@ -28,15 +87,16 @@ void edgex_device_alloc_crlid (const char *id)
   }
   else
   {
-    uuid_t uid;
-    uuid_generate (uid);
-    localid = malloc (37);
-    uuid_unparse (uid, localid);
+    crlid_generate (genid);
+    localid = genid;
   }
 }
 
 void edgex_device_free_crlid ()
 {
-  free (localid);
+  if (localid != genid)
+  {
+    free (localid);
+  }
   localid = NULL;
 }
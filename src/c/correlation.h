@@ -12,6 +12,9 @@
 #define EDGEX_CRLID_HDR "correlation-id"
 
 const char *edgex_device_get_crlid (void);
+
+/* Set the correlation ID for this thread. If id is NULL, a new one is generated */
+
 void edgex_device_alloc_crlid (const char *id);
 void edgex_device_free_crlid (void);
 
@@ -0,0 +1,57 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#include "counters.h"
+
+#include <stdatomic.h>
+
+typedef struct counter_shard
+{
+  _Alignas (64) atomic_uint_fast64_t values[EDGEX_COUNTERS];
+} counter_shard;
+
+static counter_shard shards[EDGEX_COUNTER_SHARDS];
+static atomic_uint nextshard = 0;
+static _Thread_local counter_shard *myshard = NULL;
+
+static edgex_histogram timings[EDGEX_TIMINGS];
+
+/*
+ * Only this thread (or, beyond EDGEX_COUNTER_SHARDS threads, a few others)
+ * writes to its shard, so the atomic add is uncontended. It is still needed
+ * for shards which are shared, and so that readers see whole values.
+ */
+
+void edgex_counter_add (edgex_counter c, uint64_t n)
+{
+  if (myshard == NULL)
+  {
+    myshard = &shards[atomic_fetch_add (&nextshard, 1) % EDGEX_COUNTER_SHARDS];
+  }
+  atomic_fetch_add_explicit (&myshard->values[c], n, memory_order_relaxed);
+}
+
+uint64_t edgex_counter_value (edgex_counter c)
+{
+  uint64_t total = 0;
+  for (unsigned i = 0; i < EDGEX_COUNTER_SHARDS; i++)
+  {
+    total += atomic_load_explicit (&shards[i].values[c], memory_order_relaxed);
+  }
+  return total;
+}
+
+void edgex_timing_record (edgex_timing t, uint64_t us)
+{
+  edgex_histogram_record (&timings[t], us);
+}
+
+edgex_histogram *edgex_timing_histogram (edgex_timing t)
+{
+  return &timings[t];
+}
@@ -0,0 +1,62 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#ifndef _EDGEX_DEVICE_COUNTERS_H_
+#define _EDGEX_DEVICE_COUNTERS_H_ 1
+
+#include "latency.h"
+
+#include <stdint.h>
+
+/*
+ * Process-wide counters and timings, as exported in OpenMetrics format. Each
+ * thread increments counters in a shard of its own (threads share shards only
+ * when there are more than EDGEX_COUNTER_SHARDS), so that counting on the hot
+ * path does not contend for cache lines; shards are summed when read.
+ * Timings are recorded in microseconds into histograms.
+ */
+
+#define EDGEX_COUNTER_SHARDS 32
+
+typedef enum
+{
+  EDGEX_COUNTER_REQUESTS,
+  EDGEX_COUNTER_REQUEST_ERRORS,
+  EDGEX_COUNTER_REQUESTS_SHED,
+  EDGEX_COUNTER_EVENTS_PRODUCED,
+  EDGEX_COUNTER_EVENTS_POSTED,
+  EDGEX_COUNTER_EVENTS_DROPPED,
+  EDGEX_COUNTER_AUTOEVENTS,
+  EDGEX_COUNTER_HTTP_REQUESTS,
+  EDGEX_COUNTER_HTTP_ERRORS
+} edgex_counter;
+
+#define EDGEX_COUNTERS (EDGEX_COUNTER_HTTP_ERRORS + 1)
+
+typedef enum
+{
+  EDGEX_TIMING_REQUEST,
+  EDGEX_TIMING_AUTOEVENT_LAG,
+  EDGEX_TIMING_HTTP_CLIENT
+} edgex_timing;
+
+#define EDGEX_TIMINGS (EDGEX_TIMING_HTTP_CLIENT + 1)
+
+void edgex_counter_add (edgex_counter c, uint64_t n);
+
+#define edgex_counter_inc(c) edgex_counter_add (c, 1)
+
+/* The total over all shards. Increments made during the call may or may not be included */
+
+uint64_t edgex_counter_value (edgex_counter c);
+
+void edgex_timing_record (edgex_timing t, uint64_t us);
+
+edgex_histogram *edgex_timing_histogram (edgex_timing t);
+
+#endif
@@ -0,0 +1,227 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#include "cron.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* Matches more than this far ahead are not searched for */
+
+#define CRON_HORIZON (5 * 366 * 86400)
+
+static bool cron_field (const char *f, unsigned min, unsigned max, uint64_t *mask)
+{
+  const char *p = f;
+  char *end;
+  *mask = 0;
+
+  while (true)
+  {
+    unsigned long lo, hi, step = 1;
+    if (*p == '*')
+    {
+      lo = min;
+      hi = max;
+      p++;
+    }
+    else
+    {
+      lo = strtoul (p, &end, 10);
+      if (end == p)
+      {
+        return false;
+      }
+      p = end;
+      hi = lo;
+      if (*p == '-')
+      {
+        p++;
+        hi = strtoul (p, &end, 10);
+        if (end == p)
+        {
+          return false;
+        }
+        p = end;
+      }
+      else if (*p == '/')
+      {
+        /* "a/n" runs from a to the end of the range */
+        hi = max;
+      }
+    }
+    if (*p == '/')
+    {
+      p++;
+      step = strtoul (p, &end, 10);
+      if (end == p || step == 0)
+      {
+        return false;
+      }
+      p = end;
+    }
+    if (lo < min || hi > max || lo > hi)
+    {
+      return false;
+    }
+    for (unsigned long v = lo; v <= hi; v += step)
+    {
+      *mask |= 1ULL << v;
+    }
+    if (*p == '\0')
+    {
+      return true;
+    }
+    if (*p++ != ',')
+    {
+      return false;
+    }
+  }
+}
+
+edgex_cron *edgex_cron_parse (const char *spec)
+{
+  char *fields[6];
+  char *saveptr = NULL;
+  unsigned n = 0;
+  uint64_t mask[6];
+  bool ok = true;
+  edgex_cron *result = NULL;
+  char *copy = strdup (spec);
+
+  for (char *tok = strtok_r (copy, " \t", &saveptr); tok; tok = strtok_r (NULL, " \t", &saveptr))
+  {
+    if (n == 6)
+    {
+      n++;
+      break;
+    }
+    fields[n++] = tok;
+  }
+
+  if (n == 5 || n == 6)
+  {
+    static const unsigned mins[] = { 0, 0, 0, 1, 1, 0 };
+    static const unsigned maxs[] = { 59, 59, 23, 31, 12, 7 };
+    unsigned first = (n == 6) ? 0 : 1;
+
+    mask[0] = 1;
+    for (unsigned i = 0; ok && i < n; i++)
+    {
+      ok = cron_field (fields[i], mins[first + i], maxs[first + i], &mask[first + i]);
+    }
+    if (ok)
+    {
+      result = malloc (sizeof (edgex_cron));
+      result->hasseconds = (n == 6);
+      result->seconds = mask[0];
+      result->minutes = mask[1];
+      result->hours = mask[2];
+      result->mdays = mask[3];
+      result->months = mask[4];
+      result->wdays = mask[5];
+      if (result->wdays & (1 << 7))
+      {
+        result->wdays = (result->wdays & 0x7f) | 1;
+      }
+      result->anymday = (*fields[3 - first] == '*');
+      result->anywday = (*fields[5 - first] == '*');
+    }
+  }
+
+  free (copy);
+  return result;
+}
+
+/*
+ * As in the traditional cron, if both the day of month and the day of week
+ * are restricted, a day matching either is accepted.
+ */
+
+static bool cron_day (const edgex_cron *cron, const struct tm *tm)
+{
+  bool mday = cron->mdays & (1u << tm->tm_mday);
+  bool wday = cron->wdays & (1u << tm->tm_wday);
+
+  if (cron->anymday)
+  {
+    return wday;
+  }
+  if (cron->anywday)
+  {
+    return mday;
+  }
+  return mday || wday;
+}
+
+uint64_t edgex_cron_next (const edgex_cron *cron, uint64_t after)
+{
+  struct tm tm;
+  time_t t = after / 1000 + 1;
+  time_t limit = t + CRON_HORIZON;
+
+  if (!cron->hasseconds)
+  {
+    t = (t + 59) / 60 * 60;
+  }
+
+  /* Advance the first field which does not match, resetting those below it */
+
+  while (t <= limit)
+  {
+    gmtime_r (&t, &tm);
+    if ((cron->months & (1u << (tm.tm_mon + 1))) == 0)
+    {
+      tm.tm_mon++;
+      tm.tm_mday = 1;
+      tm.tm_hour = tm.tm_min = tm.tm_sec = 0;
+    }
+    else if (!cron_day (cron, &tm))
+    {
+      tm.tm_mday++;
+      tm.tm_hour = tm.tm_min = tm.tm_sec = 0;
+    }
+    else if ((cron->hours & (1u << tm.tm_hour)) == 0)
+    {
+      tm.tm_hour++;
+      tm.tm_min = tm.tm_sec = 0;
+    }
+    else if ((cron->minutes & (1ULL << tm.tm_min)) == 0)
+    {
+      tm.tm_min++;
+      tm.tm_sec = 0;
+    }
+    else if ((cron->seconds & (1ULL << tm.tm_sec)) == 0)
+    {
+      tm.tm_sec++;
+    }
+    else
+    {
+      return (uint64_t)t * 1000;
+    }
+    t = timegm (&tm);
+  }
+  return UINT64_MAX;
+}
+
+uint64_t edgex_cron_resolution (const edgex_cron *cron)
+{
+  return cron->hasseconds ? 1000 : 60000;
+}
+
+bool edgex_cron_equal (const edgex_cron *a, const edgex_cron *b)
+{
+  if (a == NULL || b == NULL)
+  {
+    return a == b;
+  }
+  return
+    a->seconds == b->seconds && a->minutes == b->minutes && a->hours == b->hours && a->mdays == b->mdays &&
+    a->months == b->months && a->wdays == b->wdays && a->anymday == b->anymday && a->anywday == b->anywday;
+}
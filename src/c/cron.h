@@ -0,0 +1,50 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#ifndef _EDGEX_DEVICE_CRON_H_
+#define _EDGEX_DEVICE_CRON_H_ 1
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Cron-style schedule expressions. An expression has five fields (minute,
+ * hour, day of month, month, day of week) or six, with seconds first. Each
+ * field is "*" or a list of values or ranges ("a", "a-b"), either optionally
+ * followed by a step ("/n"). Days of the week run from 0 (Sunday) to 6, 7 is
+ * also accepted for Sunday. Times are evaluated in UTC.
+ */
+
+typedef struct edgex_cron
+{
+  uint64_t seconds;
+  uint64_t minutes;
+  uint32_t hours;
+  uint32_t mdays;
+  uint32_t months;
+  uint32_t wdays;
+  bool anymday;
+  bool anywday;
+  bool hasseconds;
+} edgex_cron;
+
+/* Parse an expression. Returns NULL if it is invalid */
+
+edgex_cron *edgex_cron_parse (const char *spec);
+
+/* The earliest time after the one given (both in ms since the epoch) which matches, or UINT64_MAX if there is none */
+
+uint64_t edgex_cron_next (const edgex_cron *cron, uint64_t after);
+
+/* The resolution of the schedule: one second if it has a seconds field, otherwise one minute (in ms) */
+
+uint64_t edgex_cron_resolution (const edgex_cron *cron);
+
+bool edgex_cron_equal (const edgex_cron *a, const edgex_cron *b);
+
+#endif
@@ -14,40 +14,95 @@
 #include "edgex-time.h"
 #include "device.h"
 #include "transform.h"
+#include "jsonbuf.h"
+#include "service.h"
+#include "batch.h"
+#include "storefwd.h"
+#include "cborbuf.h"
+#include "intern.h"
+#include "mqtt.h"
+#include "eventring.h"
+#include "memstats.h"
 
-#include <cbor.h>
+#include <pthread.h>
+
+/* Pre-encoded CBOR text strings for the keys used in events */
+
+#define CBOR_KEY_DEVICE "\x66" "device"
+#define CBOR_KEY_ORIGIN "\x66" "origin"
+#define CBOR_KEY_READINGS "\x68" "readings"
+#define CBOR_KEY_NAME "\x64" "name"
+#define CBOR_KEY_VALUE "\x65" "value"
+#define CBOR_KEY_BINARYVALUE "\x6b" "binaryValue"
+
+static void edgex_blob_free (edgex_blob *blob);
+static void edgex_blob_share (const edgex_blob *blob, edgex_blob *copy);
+
+/* Float format for a resource: shortFloats selects the shortest e-notation for all non-base64 resources */
+
+static edgex_floatformat edgex_data_floatformat (const edgex_propertyvalue *pv, bool shortFloats)
+{
+  if (pv->floatAsBinary)
+  {
+    return EDGEX_FLOAT_BASE64;
+  }
+  return (shortFloats || pv->floatShortest) ? EDGEX_FLOAT_SHORTEST : EDGEX_FLOAT_ENOTATION;
+}
+
+/* The size of an event for accounting. Readings kept with it are not included */
+
+static size_t event_footprint (const edgex_event_cooked *e)
+{
+  return sizeof (edgex_event_cooked) + (e->encoding == JSON ? strlen (e->value.json) + 1 : e->value.cbor.length);
+}
 
 edgex_event_cooked *edgex_data_process_event
 (
   const char *device_name,
   const edgex_cmdinfo *commandinfo,
   edgex_device_commandresult *values,
-  bool doTransforms
+  bool doTransforms,
+  bool shortFloats,
+  size_t streammin,
+  bool keepReadings,
+  edgex_latency_entry *lat,
+  edgex_eventring_t *ring
 )
 {
   edgex_event_cooked *result = NULL;
   bool useCBOR = false;
-  uint64_t timenow = edgex_device_nanotime_monotonic ();
-  for (uint32_t i = 0; i < commandinfo->nreqs; i++)
+  uint64_t timenow = edgex_device_origintime ();
+  uint64_t start = edgex_latency_start (lat);
+  uint64_t tstart = edgex_trace_start ();
+
+  if (doTransforms)
   {
-    if (doTransforms)
-    {
-      edgex_transform_outgoing (&values[i], commandinfo->pvals[i], commandinfo->maps[i]);
-    }
-    const char *assertion = commandinfo->pvals[i]->assertion;
-    if (assertion && *assertion)
+    for (uint32_t i = 0, run = 1; i < commandinfo->nreqs; i += run)
     {
-      char *reading = edgex_value_tostring (&values[i], commandinfo->pvals[i]->floatAsBinary);
-      if (strcmp (reading, assertion))
+      run = commandinfo->xfruns[i];
+      if (run > 1)
       {
-        free (reading);
-        return NULL;
+        edgex_transform_outgoing_block (&values[i], run, &commandinfo->xforms[i]);
       }
       else
       {
-        free (reading);
+        edgex_transform_outgoing (&values[i], &commandinfo->xforms[i], commandinfo->maps[i]);
       }
     }
+    edgex_latency_record (lat, EDGEX_LATENCY_TRANSFORM, start);
+    edgex_trace_span (EDGEX_TRACE_TRANSFORM, tstart);
+    start = edgex_latency_start (lat);
+    tstart = edgex_trace_start ();
+  }
+
+  for (uint32_t i = 0; i < commandinfo->nreqs; i++)
+  {
+    const edgex_assertion *asrt = &commandinfo->asserts[i];
+    if (asrt->text && !edgex_assertion_check
+      (asrt, &values[i], edgex_data_floatformat (commandinfo->pvals[i], shortFloats)))
+    {
+      return NULL;
+    }
     if (commandinfo->pvals[i]->type == Binary)
     {
       useCBOR = true;
@@ -55,102 +110,193 @@ edgex_event_cooked *edgex_data_process_event
   }
 
   result = malloc (sizeof (edgex_event_cooked));
+  result->source = edgex_intern (commandinfo->name);
+  result->readings = NULL;
+  atomic_init (&result->refs, 0);
+  if (keepReadings)
+  {
+    edgex_event_readings *r = malloc (sizeof (edgex_event_readings));
+    r->device = edgex_intern (device_name);
+    r->origin = timenow;
+    r->count = commandinfo->nreqs;
+    r->names = malloc (r->count * sizeof (char *));
+    for (uint32_t i = 0; i < r->count; i++)
+    {
+      r->names[i] = edgex_intern (commandinfo->reqs[i].resname);
+    }
+    r->values = edgex_device_commandresult_dup (values, r->count);
+    result->readings = r;
+  }
   if (useCBOR)
   {
-    size_t bsize = 0;
-    cbor_item_t *cevent = cbor_new_definite_map (3);
-    cbor_item_t *crdgs = cbor_new_definite_array (commandinfo->nreqs);
+    edgex_cborbuf buf;
+    edgex_event_pieces *pieces = NULL;
+    uint32_t npieces = 0;
+    size_t bound = 3 * EDGEX_CBOR_HDRMAX + sizeof (CBOR_KEY_DEVICE) + sizeof (CBOR_KEY_ORIGIN) +
+      sizeof (CBOR_KEY_READINGS) + strlen (device_name);
+
+    /* Compute an upper bound for the encoded size so that the buffer is allocated only once */
 
     for (uint32_t i = 0; i < commandinfo->nreqs; i++)
     {
-      cbor_item_t *crdg = cbor_new_definite_map (3);
+      bound += 4 * EDGEX_CBOR_HDRMAX + sizeof (CBOR_KEY_BINARYVALUE) + sizeof (CBOR_KEY_NAME) + sizeof (CBOR_KEY_ORIGIN);
+      bound += strlen (commandinfo->reqs[i].resname);
+      switch (values[i].type)
+      {
+        case Binary:
+          if (streammin && values[i].value.binary_result.size >= streammin)
+          {
+            npieces++;
+          }
+          else
+          {
+            bound += values[i].value.binary_result.size;
+          }
+          break;
+        case String:
+          bound += strlen (values[i].value.string_result);
+          break;
+        default:
+          bound += EDGEX_VALUE_BUFSIZE;
+          break;
+      }
+    }
+
+    /* Large Binary readings are not copied into the encoding, but referenced from its pieces */
 
-      cbor_item_t *cread;
+    if (npieces)
+    {
+      pieces = malloc (sizeof (edgex_event_pieces) + npieces * sizeof (edgex_event_piece));
+      pthread_mutex_init (&pieces->lock, NULL);
+      pieces->count = 0;
+    }
+
+    edgex_cborbuf_init (&buf, bound);
+    edgex_cborbuf_head (&buf, EDGEX_CBOR_MAP, 3);
+    edgex_cborbuf_raw (&buf, CBOR_KEY_DEVICE, sizeof (CBOR_KEY_DEVICE) - 1);
+    edgex_cborbuf_string (&buf, device_name);
+    edgex_cborbuf_raw (&buf, CBOR_KEY_ORIGIN, sizeof (CBOR_KEY_ORIGIN) - 1);
+    edgex_cborbuf_uint64 (&buf, timenow);
+    edgex_cborbuf_raw (&buf, CBOR_KEY_READINGS, sizeof (CBOR_KEY_READINGS) - 1);
+    edgex_cborbuf_head (&buf, EDGEX_CBOR_ARRAY, commandinfo->nreqs);
+
+    for (uint32_t i = 0; i < commandinfo->nreqs; i++)
+    {
+      edgex_cborbuf_head (&buf, EDGEX_CBOR_MAP, 3);
       if (values[i].type == Binary)
       {
-        cread = cbor_build_bytestring (values[i].value.binary_result.bytes, values[i].value.binary_result.size);
-        cbor_map_add (crdg, (struct cbor_pair)
-          { .key = cbor_move (cbor_build_string ("binaryValue")), .value = cbor_move (cread) });
+        edgex_blob *blob = &values[i].value.binary_result;
+        edgex_cborbuf_raw (&buf, CBOR_KEY_BINARYVALUE, sizeof (CBOR_KEY_BINARYVALUE) - 1);
+        if (pieces && blob->size >= streammin)
+        {
+          edgex_event_piece *piece = &pieces->pieces[pieces->count++];
+          edgex_cborbuf_head (&buf, EDGEX_CBOR_BYTES, blob->size);
+          piece->offset = buf.len;
+          edgex_blob_share (blob, &piece->blob);
+        }
+        else
+        {
+          edgex_cborbuf_bytes (&buf, blob->bytes, blob->size);
+        }
       }
       else
       {
-        char *reading = edgex_value_tostring (&values[i], commandinfo->pvals[i]->floatAsBinary);
-        cread = cbor_build_string (reading);
-        free (reading);
-        cbor_map_add (crdg, (struct cbor_pair)
-          { .key = cbor_move (cbor_build_string ("value")), .value = cbor_move (cread) });
+        char vbuf[EDGEX_VALUE_BUFSIZE];
+        edgex_floatformat ffmt = edgex_data_floatformat (commandinfo->pvals[i], shortFloats);
+        edgex_cborbuf_raw (&buf, CBOR_KEY_VALUE, sizeof (CBOR_KEY_VALUE) - 1);
+        edgex_cborbuf_string (&buf, edgex_value_tostring_r (&values[i], ffmt, vbuf, sizeof (vbuf)));
       }
-
-      cbor_map_add (crdg, (struct cbor_pair)
-      {
-        .key = cbor_move (cbor_build_string ("name")),
-        .value = cbor_move (cbor_build_string (commandinfo->reqs[i].resname))
-      });
-
-      cbor_map_add (crdg, (struct cbor_pair)
-      {
-        .key = cbor_move (cbor_build_string ("origin")),
-        .value = cbor_move (cbor_build_uint64 (values[i].origin ? values[i].origin : timenow))
-      });
-
-      cbor_array_push (crdgs, cbor_move (crdg));
+      edgex_cborbuf_raw (&buf, CBOR_KEY_NAME, sizeof (CBOR_KEY_NAME) - 1);
+      edgex_cborbuf_string (&buf, commandinfo->reqs[i].resname);
+      edgex_cborbuf_raw (&buf, CBOR_KEY_ORIGIN, sizeof (CBOR_KEY_ORIGIN) - 1);
+      edgex_cborbuf_uint64 (&buf, values[i].origin ? values[i].origin : timenow);
     }
 
-    cbor_map_add (cevent, (struct cbor_pair)
-      { .key = cbor_move (cbor_build_string ("device")), .value = cbor_move (cbor_build_string (device_name)) });
-    cbor_map_add (cevent, (struct cbor_pair)
-      { .key = cbor_move (cbor_build_string ("origin")), .value = cbor_move (cbor_build_uint64 (timenow)) });
-    cbor_map_add (cevent, (struct cbor_pair)
-      { .key = cbor_move (cbor_build_string ("readings")), .value = cbor_move (crdgs) });
-
     result->encoding = CBOR;
-    result->value.cbor.length = cbor_serialize_alloc (cevent, &result->value.cbor.data, &bsize);
-    cbor_decref (&cevent);
-    return result;
+    result->value.cbor.pieces = pieces;
+    if (pieces)
+    {
+      pieces->envelope = edgex_cborbuf_finish (&buf, &pieces->length);
+      result->value.cbor.data = NULL;
+      result->value.cbor.length = pieces->length;
+      for (uint32_t i = 0; i < pieces->count; i++)
+      {
+        result->value.cbor.length += pieces->pieces[i].blob.size;
+      }
+    }
+    else
+    {
+      result->value.cbor.data = edgex_cborbuf_finish (&buf, &result->value.cbor.length);
+    }
   }
   else
   {
-    JSON_Value *jevent = json_value_init_object ();
-    JSON_Object *jobj = json_value_get_object (jevent);
-    JSON_Value *arrval = json_value_init_array ();
-    JSON_Array *jrdgs = json_value_get_array (arrval);
+    bool first = true;
+    edgex_jsonbuf buf;
+
+    /* Output is as json_serialize_to_string would produce for the equivalent parson tree */
+
+    edgex_jsonbuf_init (&buf, 128 + 96 * commandinfo->nreqs);
+    edgex_jsonbuf_appendc (&buf, '{');
+    edgex_jsonbuf_member_string (&buf, &first, "device", device_name);
+    edgex_jsonbuf_member_uint (&buf, &first, "origin", timenow);
+    edgex_jsonbuf_key (&buf, &first, "readings");
+    edgex_jsonbuf_appendc (&buf, '[');
 
     for (uint32_t i = 0; i < commandinfo->nreqs; i++)
     {
-      char *reading = edgex_value_tostring (&values[i], commandinfo->pvals[i]->floatAsBinary);
-
-      JSON_Value *rval = json_value_init_object ();
-      JSON_Object *robj = json_value_get_object (rval);
+      bool rfirst = true;
+      char vbuf[EDGEX_VALUE_BUFSIZE];
+      char *binstr = NULL;
+      const char *reading = edgex_value_tostring_r
+        (&values[i], edgex_data_floatformat (commandinfo->pvals[i], shortFloats), vbuf, sizeof (vbuf));
+      if (reading == NULL)
+      {
+        reading = binstr = edgex_value_tostring (&values[i], commandinfo->pvals[i]->floatAsBinary);
+      }
 
-      json_object_set_string (robj, "name", commandinfo->reqs[i].resname);
-      json_object_set_string (robj, "value", reading);
-      json_object_set_uint (robj, "origin", values[i].origin ? values[i].origin : timenow);
-      json_array_append_value (jrdgs, rval);
-      free (reading);
+      if (i)
+      {
+        edgex_jsonbuf_appendc (&buf, ',');
+      }
+      edgex_jsonbuf_appendc (&buf, '{');
+      edgex_jsonbuf_member_string (&buf, &rfirst, "name", commandinfo->reqs[i].resname);
+      edgex_jsonbuf_member_string (&buf, &rfirst, "value", reading);
+      edgex_jsonbuf_member_uint (&buf, &rfirst, "origin", values[i].origin ? values[i].origin : timenow);
+      edgex_jsonbuf_appendc (&buf, '}');
+      free (binstr);
     }
 
-    json_object_set_string (jobj, "device", device_name);
-    json_object_set_uint (jobj, "origin", timenow);
-    json_object_set_value (jobj, "readings", arrval);
+    edgex_jsonbuf_append (&buf, "]}", 2);
     result->encoding = JSON;
-    result->value.json = json_serialize_to_string (jevent);
-    json_value_free (jevent);
+    result->value.json = edgex_jsonbuf_finish (&buf);
+  }
+  edgex_latency_record (lat, EDGEX_LATENCY_ENCODE, start);
+  edgex_trace_span (EDGEX_TRACE_ENCODE, tstart);
+  edgex_memstats_alloc (EDGEX_MEM_EVENTS, event_footprint (result));
+  if (ring)
+  {
+    edgex_eventring_put (ring, device_name, commandinfo, values, timenow, result);
   }
+  edgex_counter_inc (EDGEX_COUNTER_EVENTS_PRODUCED);
   return result;
 }
 
 void edgex_data_client_add_event
 (
-  iot_logger_t *lc,
-  edgex_service_endpoints *endpoints,
+  edgex_device_service *svc,
   edgex_event_cooked *eventval,
   edgex_error *err
 )
 {
   edgex_ctx ctx;
   char url[URL_BUF_SIZE];
+  iot_logger_t *lc = svc->logger;
+  edgex_service_endpoints *endpoints = &svc->config.endpoints;
 
   memset (&ctx, 0, sizeof (edgex_ctx));
+  ctx.compress = svc->config.device.compression;
+  ctx.compressmin = svc->config.device.compressthreshold;
   snprintf
   (
     url,
@@ -169,45 +315,449 @@ void edgex_data_client_add_event
     }
     case CBOR:
     {
-      edgex_http_postbin
-        (lc, &ctx, url, eventval->value.cbor.data, eventval->value.cbor.length, "application/cbor", NULL, err);
+      edgex_event_pieces *pieces = eventval->value.cbor.pieces;
+      if (pieces && !(ctx.compress && eventval->value.cbor.length >= ctx.compressmin))
+      {
+        /* Send the envelope around the readings' bytes, in place */
+
+        unsigned nsegs = 0;
+        size_t offset = 0;
+        edgex_http_segment *segs = malloc ((2 * pieces->count + 1) * sizeof (edgex_http_segment));
+        for (uint32_t i = 0; i < pieces->count; i++)
+        {
+          segs[nsegs].data = pieces->envelope + offset;
+          segs[nsegs++].length = pieces->pieces[i].offset - offset;
+          segs[nsegs].data = pieces->pieces[i].blob.bytes;
+          segs[nsegs++].length = pieces->pieces[i].blob.size;
+          offset = pieces->pieces[i].offset;
+        }
+        segs[nsegs].data = pieces->envelope + offset;
+        segs[nsegs++].length = pieces->length - offset;
+        edgex_http_postsegments (lc, &ctx, url, segs, nsegs, "application/cbor", NULL, err);
+        free (segs);
+      }
+      else
+      {
+        edgex_http_postbin
+        (
+          lc, &ctx, url, (void *)edgex_event_cooked_cbor (eventval), eventval->value.cbor.length,
+          "application/cbor", NULL, err
+        );
+      }
       break;
     }
   }
 }
 
+typedef struct edgex_async_event
+{
+  edgex_device_service *svc;
+  edgex_event_encoding encoding;
+  edgex_event_cooked *event;
+  char device[];
+} edgex_async_event;
+
+static void edgex_data_store_event
+  (edgex_device_service *svc, const char *device, edgex_event_encoding enc, const void *data, size_t length, edgex_error *err)
+{
+  if (svc->storefwd && edgex_storefwd_put (svc->storefwd, enc, data, length))
+  {
+    iot_log_debug (svc->logger, "Event for device %s stored for later delivery", device);
+    *err = EDGEX_OK;
+  }
+}
+
+/* Store an event which was not posted, counting it as dropped if that fails */
+
+static void edgex_data_store_event_cooked
+  (edgex_device_service *svc, const char *device, const edgex_event_cooked *eventval, edgex_error *err)
+{
+  if (eventval->encoding == JSON)
+  {
+    edgex_data_store_event (svc, device, JSON, eventval->value.json, strlen (eventval->value.json), err);
+  }
+  else
+  {
+    edgex_data_store_event
+      (svc, device, CBOR, edgex_event_cooked_cbor (eventval), eventval->value.cbor.length, err);
+  }
+  if (err->code)
+  {
+    edgex_counter_inc (EDGEX_COUNTER_EVENTS_DROPPED);
+  }
+}
+
+static void edgex_data_async_done (void *p, const edgex_error *err, const char *response, void *data, size_t length)
+{
+  edgex_async_event *ae = (edgex_async_event *)p;
+  if (err->code)
+  {
+    edgex_error serr = *err;
+    edgex_data_store_event (ae->svc, ae->device, ae->encoding, data, length, &serr);
+    if (serr.code)
+    {
+      iot_log_error (ae->svc->logger, "Unable to push event for device %s", ae->device);
+      edgex_counter_inc (EDGEX_COUNTER_EVENTS_DROPPED);
+    }
+  }
+  else
+  {
+    edgex_counter_inc (EDGEX_COUNTER_EVENTS_POSTED);
+  }
+  edgex_event_cooked_free (ae->event);
+  free (ae);
+}
+
+void edgex_data_submit_event
+(
+  edgex_device_service *svc,
+  const char *device,
+  edgex_event_cooked *eventval,
+  edgex_error *err
+)
+{
+  if (svc->mqtt)
+  {
+    if (edgex_mqtt_publish (svc->mqtt, device, eventval))
+    {
+      *err = EDGEX_OK;
+    }
+    else
+    {
+      iot_log_debug (svc->logger, "MQTT: queue full, dropping event for device %s", device);
+      edgex_counter_inc (EDGEX_COUNTER_EVENTS_DROPPED);
+      *err = EDGEX_REMOTE_SERVER_DOWN;
+    }
+  }
+  else if (svc->batch)
+  {
+    edgex_batch_add (svc->batch, device, eventval);
+    *err = EDGEX_OK;
+  }
+  else if (svc->storefwd && edgex_storefwd_count (svc->storefwd))
+  {
+    *err = EDGEX_REMOTE_SERVER_DOWN;
+    edgex_data_store_event_cooked (svc, device, eventval, err);
+  }
+  else if (svc->asyncpost)
+  {
+    char url[URL_BUF_SIZE];
+    size_t length;
+    void *data;
+    edgex_async_event *ae = malloc (sizeof (edgex_async_event) + strlen (device) + 1);
+
+    /* The request is sent from the event, which is shared until it completes */
+
+    ae->svc = svc;
+    ae->encoding = eventval->encoding;
+    ae->event = edgex_event_cooked_share (eventval);
+    strcpy (ae->device, device);
+    data = (void *)edgex_event_cooked_data (eventval, &length);
+    snprintf
+    (
+      url,
+      URL_BUF_SIZE - 1,
+      "http://%s:%u/api/v1/event",
+      svc->config.endpoints.data.host,
+      svc->config.endpoints.data.port
+    );
+    edgex_http_async_post
+    (
+      svc->asyncpost, url, eventval->encoding == JSON ? "application/json" : "application/cbor",
+      data, length, edgex_data_async_done, ae
+    );
+    *err = EDGEX_OK;
+  }
+  else
+  {
+    edgex_data_client_add_event (svc, eventval, err);
+    if (err->code)
+    {
+      edgex_data_store_event_cooked (svc, device, eventval, err);
+    }
+    else
+    {
+      edgex_counter_inc (EDGEX_COUNTER_EVENTS_POSTED);
+    }
+  }
+}
+
+/* The assembled encoding is cached in the event, as if it had been produced whole */
+
+const unsigned char *edgex_event_cooked_cbor (const edgex_event_cooked *e)
+{
+  edgex_event_pieces *pieces = e->value.cbor.pieces;
+  const unsigned char *result;
+
+  if (pieces == NULL)
+  {
+    return e->value.cbor.data;
+  }
+
+  pthread_mutex_lock (&pieces->lock);
+  if (e->value.cbor.data == NULL)
+  {
+    unsigned char *data = malloc (e->value.cbor.length);
+    size_t offset = 0;
+    size_t out = 0;
+    for (uint32_t i = 0; i < pieces->count; i++)
+    {
+      memcpy (data + out, pieces->envelope + offset, pieces->pieces[i].offset - offset);
+      out += pieces->pieces[i].offset - offset;
+      memcpy (data + out, pieces->pieces[i].blob.bytes, pieces->pieces[i].blob.size);
+      out += pieces->pieces[i].blob.size;
+      offset = pieces->pieces[i].offset;
+    }
+    memcpy (data + out, pieces->envelope + offset, pieces->length - offset);
+    ((edgex_event_cooked *)e)->value.cbor.data = data;
+  }
+  result = e->value.cbor.data;
+  pthread_mutex_unlock (&pieces->lock);
+  return result;
+}
+
+static void edgex_event_readings_free (edgex_event_readings *r)
+{
+  if (r)
+  {
+    for (uint32_t i = 0; i < r->count; i++)
+    {
+      edgex_intern_release (r->names[i]);
+    }
+    edgex_device_commandresult_free (r->values, r->count);
+    edgex_intern_release (r->device);
+    free (r->names);
+    free (r);
+  }
+}
+
+static void edgex_event_pieces_free (edgex_event_pieces *pieces)
+{
+  if (pieces)
+  {
+    for (uint32_t i = 0; i < pieces->count; i++)
+    {
+      edgex_blob_free (&pieces->pieces[i].blob);
+    }
+    pthread_mutex_destroy (&pieces->lock);
+    free (pieces->envelope);
+    free (pieces);
+  }
+}
+
 void edgex_event_cooked_free (edgex_event_cooked *e)
 {
-  if (e)
+  /* refs counts the holders other than the original, so the last release sees zero */
+
+  if (e && atomic_fetch_sub (&e->refs, 1) == 0)
   {
+    edgex_memstats_free (EDGEX_MEM_EVENTS, event_footprint (e));
     switch (e->encoding)
     {
       case JSON:
-        json_free_serialized_string (e->value.json);
+        free (e->value.json);
         break;
       case CBOR:
         free (e->value.cbor.data);
+        edgex_event_pieces_free (e->value.cbor.pieces);
         break;
     }
+    edgex_event_readings_free (e->readings);
+    edgex_intern_release (e->source);
     free (e);
   }
 }
 
-void edgex_device_commandresult_free (edgex_device_commandresult *res, int n)
+edgex_event_cooked *edgex_event_cooked_share (edgex_event_cooked *e)
 {
-  if (res)
+  atomic_fetch_add (&e->refs, 1);
+  return e;
+}
+
+const void *edgex_event_cooked_data (const edgex_event_cooked *e, size_t *length)
+{
+  if (e->encoding == JSON)
   {
-    for (int i = 0; i < n; i++)
+    *length = strlen (e->value.json);
+    return e->value.json;
+  }
+  *length = e->value.cbor.length;
+  return edgex_event_cooked_cbor (e);
+}
+
+/* Shared blobs are reference counted in a table keyed by their bytes, so
+   that edgex_blob itself stays two words. Blobs not in the table are owned
+   outright and freed with edgex_device_buffer_free */
+
+typedef struct edgex_blob_ref
+{
+  const uint8_t *bytes;
+  unsigned refs;
+  void (*release) (void *ctx, uint8_t *bytes);
+  void *ctx;
+  struct edgex_blob_ref *next;
+} edgex_blob_ref;
+
+static pthread_mutex_t edgex_blob_lock = PTHREAD_MUTEX_INITIALIZER;
+static edgex_blob_ref **edgex_blob_table = NULL;
+static size_t edgex_blob_size = 0;
+static size_t edgex_blob_count = 0;
+
+static size_t edgex_blob_hash (const uint8_t *bytes, size_t size)
+{
+  uintptr_t h = (uintptr_t)bytes;
+  h ^= h >> 17;
+  h *= 0x9e3779b1u;
+  return (h ^ (h >> 15)) & (size - 1);
+}
+
+/* Find the entry for some bytes. Called with edgex_blob_lock held */
+
+static edgex_blob_ref **edgex_blob_find (const uint8_t *bytes)
+{
+  edgex_blob_ref **ref;
+  if (edgex_blob_size == 0)
+  {
+    return NULL;
+  }
+  ref = &edgex_blob_table[edgex_blob_hash (bytes, edgex_blob_size)];
+  while (*ref && (*ref)->bytes != bytes)
+  {
+    ref = &(*ref)->next;
+  }
+  return ref;
+}
+
+/* Add an entry, growing the table as needed. Called with edgex_blob_lock held */
+
+static edgex_blob_ref *edgex_blob_insert
+  (const uint8_t *bytes, unsigned refs, void (*release) (void *ctx, uint8_t *bytes), void *ctx)
+{
+  edgex_blob_ref *ref;
+  size_t h;
+
+  if (edgex_blob_count >= edgex_blob_size)
+  {
+    size_t newsize = edgex_blob_size ? edgex_blob_size * 2 : 64;
+    edgex_blob_ref **table = calloc (newsize, sizeof (edgex_blob_ref *));
+    for (size_t i = 0; i < edgex_blob_size; i++)
     {
-      if (res[i].type == String)
-      {
-        free (res[i].value.string_result);
-      }
-      else if (res[i].type == Binary)
+      edgex_blob_ref *next;
+      for (ref = edgex_blob_table[i]; ref; ref = next)
       {
-        free (res[i].value.binary_result.bytes);
+        next = ref->next;
+        h = edgex_blob_hash (ref->bytes, newsize);
+        ref->next = table[h];
+        table[h] = ref;
       }
     }
+    free (edgex_blob_table);
+    edgex_blob_table = table;
+    edgex_blob_size = newsize;
+  }
+  ref = malloc (sizeof (edgex_blob_ref));
+  ref->bytes = bytes;
+  ref->refs = refs;
+  ref->release = release;
+  ref->ctx = ctx;
+  h = edgex_blob_hash (bytes, edgex_blob_size);
+  ref->next = edgex_blob_table[h];
+  edgex_blob_table[h] = ref;
+  edgex_blob_count++;
+  return ref;
+}
+
+void edgex_blob_set_release
+  (edgex_blob *blob, void (*release) (void *ctx, uint8_t *bytes), void *ctx)
+{
+  edgex_blob_ref **ref;
+  pthread_mutex_lock (&edgex_blob_lock);
+  ref = edgex_blob_find (blob->bytes);
+  if (ref && *ref)
+  {
+    (*ref)->release = release;
+    (*ref)->ctx = ctx;
+  }
+  else
+  {
+    edgex_blob_insert (blob->bytes, 1, release, ctx);
+  }
+  pthread_mutex_unlock (&edgex_blob_lock);
+}
+
+static void edgex_blob_free (edgex_blob *blob)
+{
+  edgex_blob_ref **ref;
+  edgex_blob_ref *entry = NULL;
+  bool last = true;
+
+  pthread_mutex_lock (&edgex_blob_lock);
+  ref = edgex_blob_find (blob->bytes);
+  if (ref && *ref)
+  {
+    entry = *ref;
+    last = (--entry->refs == 0);
+    if (last)
+    {
+      *ref = entry->next;
+      edgex_blob_count--;
+    }
+  }
+  pthread_mutex_unlock (&edgex_blob_lock);
+
+  if (last)
+  {
+    if (entry && entry->release)
+    {
+      entry->release (entry->ctx, blob->bytes);
+    }
+    else
+    {
+      edgex_device_buffer_free (blob->bytes);
+    }
+    free (entry);
+  }
+}
+
+/* Obtain a shared copy of a blob. Blobs not yet in the table are entered with a count for both copies */
+
+static void edgex_blob_share (const edgex_blob *blob, edgex_blob *copy)
+{
+  edgex_blob_ref **ref;
+  pthread_mutex_lock (&edgex_blob_lock);
+  ref = edgex_blob_find (blob->bytes);
+  if (ref && *ref)
+  {
+    (*ref)->refs++;
+  }
+  else
+  {
+    edgex_blob_insert (blob->bytes, 2, NULL, NULL);
+  }
+  pthread_mutex_unlock (&edgex_blob_lock);
+  *copy = *blob;
+}
+
+void edgex_device_commandresult_clear (edgex_device_commandresult *res, int n)
+{
+  for (int i = 0; i < n; i++)
+  {
+    if (res[i].type == String)
+    {
+      edgex_device_buffer_free (res[i].value.string_result);
+    }
+    else if (res[i].type == Binary)
+    {
+      edgex_blob_free (&res[i].value.binary_result);
+    }
+  }
+}
+
+void edgex_device_commandresult_free (edgex_device_commandresult *res, int n)
+{
+  if (res)
+  {
+    edgex_device_commandresult_clear (res, n);
     free (res);
   }
 }
@@ -215,7 +765,6 @@ void edgex_device_commandresult_free (edgex_device_commandresult *res, int n)
 edgex_device_commandresult *edgex_device_commandresult_dup (const edgex_device_commandresult *res, int n)
 {
   edgex_device_commandresult *result = calloc (n, sizeof (edgex_device_commandresult));
-  size_t sz;
   for (int i = 0; i < n; i++)
   {
     result[i].type = res[i].type;
@@ -258,10 +807,7 @@ edgex_device_commandresult *edgex_device_commandresult_dup (const edgex_device_c
         result[i].value.string_result = strdup (res[i].value.string_result);
         break;
       case Binary:
-        sz = res[i].value.binary_result.size;
-        result[i].value.binary_result.size = sz;
-        result[i].value.binary_result.bytes = malloc (sz);
-        memcpy (result[i].value.binary_result.bytes, res[i].value.binary_result.bytes, sz);
+        edgex_blob_share (&res[i].value.binary_result, &result[i].value.binary_result);
         break;
     }
   }
@@ -321,7 +867,10 @@ bool edgex_device_commandresult_equal
         result =
         (
           lhs[i].value.binary_result.size == rhs[i].value.binary_result.size &&
-          memcmp (lhs[i].value.binary_result.bytes, rhs[i].value.binary_result.bytes, lhs[i].value.binary_result.size) == 0
+          (
+            lhs[i].value.binary_result.bytes == rhs[i].value.binary_result.bytes ||
+            memcmp (lhs[i].value.binary_result.bytes, rhs[i].value.binary_result.bytes, lhs[i].value.binary_result.size) == 0
+          )
         );
         break;
     }
@@ -384,3 +933,30 @@ edgex_valuedescriptor *edgex_data_client_add_valuedescriptor
 
   return result;
 }
+
+JSON_Value *edgex_data_client_get_valuedescriptors
+  (iot_logger_t *lc, edgex_service_endpoints *endpoints, edgex_error *err)
+{
+  edgex_ctx ctx;
+  JSON_Value *result = NULL;
+  char url[URL_BUF_SIZE];
+
+  memset (&ctx, 0, sizeof (edgex_ctx));
+  snprintf
+  (
+    url,
+    URL_BUF_SIZE - 1,
+    "http://%s:%u/api/v1/valuedescriptor",
+    endpoints->data.host,
+    endpoints->data.port
+  );
+
+  edgex_http_get (lc, &ctx, url, edgex_http_write_cb, err);
+
+  if (err->code == 0)
+  {
+    result = json_parse_string (ctx.buff);
+  }
+  free (ctx.buff);
+  return result;
+}
@@ -12,6 +12,10 @@
 #include "edgex/devsdk.h"
 #include "parson.h"
 #include "cmdinfo.h"
+#include "latency.h"
+
+#include <stdatomic.h>
+#include <pthread.h>
 
 typedef struct edgex_reading
 {
@@ -40,6 +44,41 @@ typedef struct edgex_event
 
 typedef enum { JSON, CBOR} edgex_event_encoding;
 
+/*
+ * A CBOR event with large Binary readings may be held in pieces: its encoding
+ * without the readings' bytes, and shares of the readings, whose bytes belong
+ * at the given offsets in the encoding. Such an event is posted to core-data
+ * without being assembled; edgex_event_cooked_cbor assembles it for other uses.
+ */
+
+typedef struct edgex_event_piece
+{
+  size_t offset;
+  edgex_blob blob;
+} edgex_event_piece;
+
+typedef struct edgex_event_pieces
+{
+  pthread_mutex_t lock; /* Guards the assembly of the event */
+  unsigned char *envelope;
+  size_t length;
+  uint32_t count;
+  edgex_event_piece pieces[];
+} edgex_event_pieces;
+
+#define EDGEX_STREAM_DEFAULT_THRESHOLD 65536
+
+/* The readings from which an event was encoded, where they are kept for re-encoding. Names are interned */
+
+typedef struct edgex_event_readings
+{
+  const char *device;
+  uint64_t origin;
+  uint32_t count;
+  const char **names;
+  edgex_device_commandresult *values;
+} edgex_event_readings;
+
 typedef struct edgex_event_cooked
 {
   edgex_event_encoding encoding;
@@ -48,10 +87,14 @@ typedef struct edgex_event_cooked
     char *json;
     struct
     {
-      unsigned char *data;
+      unsigned char *data; /* NULL for an event in pieces, until assembled */
       size_t length;
+      edgex_event_pieces *pieces;
     } cbor;
   } value;
+  const char *source; /* The resource or command read, interned */
+  edgex_event_readings *readings; /* NULL unless requested */
+  atomic_uint refs;
 } edgex_event_cooked;
 
 typedef struct
@@ -74,21 +117,65 @@ typedef struct
 } edgex_valuedescriptor;
 
 typedef struct edgex_service_endpoints edgex_service_endpoints;
+typedef struct edgex_eventring_t edgex_eventring_t;
+
+/* Release a cooked event. It is freed once every holder of a share has released it */
 
 void edgex_event_cooked_free (edgex_event_cooked *e);
 
+/* Take an additional share of a cooked event */
+
+edgex_event_cooked *edgex_event_cooked_share (edgex_event_cooked *e);
+
+/* The CBOR encoding of an event, assembling it if it is held in pieces */
+
+const unsigned char *edgex_event_cooked_cbor (const edgex_event_cooked *e);
+
+/* The encoded form of an event, which remains valid while the caller holds its share */
+
+const void *edgex_event_cooked_data (const edgex_event_cooked *e, size_t *length);
+
+/*
+ * Transform and encode readings. If lat is not NULL, the time taken by each
+ * stage is recorded there. If ring is not NULL, the event is also written to
+ * the shared-memory event ring. If streammin is not zero, an event with a
+ * Binary reading of at least that many bytes is held in pieces. If
+ * keepReadings is set, the readings (after transformation) are kept with the
+ * event.
+ */
+
 edgex_event_cooked *edgex_data_process_event
 (
   const char *device_name,
   const edgex_cmdinfo *commandinfo,
   edgex_device_commandresult *values,
-  bool doTransforms
+  bool doTransforms,
+  bool shortFloats,
+  size_t streammin,
+  bool keepReadings,
+  edgex_latency_entry *lat,
+  edgex_eventring_t *ring
 );
 
 void edgex_data_client_add_event
 (
-  iot_logger_t *lc,
-  edgex_service_endpoints *endpoints,
+  edgex_device_service *svc,
+  edgex_event_cooked *eventval,
+  edgex_error *err
+);
+
+/*
+ * Submit an event for delivery to core-data. If an MQTT broker is configured
+ * the event is queued for publication there instead. Otherwise, if batching is
+ * enabled the event is added to the current batch, or else it is posted
+ * immediately (or queued for the asynchronous poster, if enabled). If the post
+ * fails and store-and-forward is enabled, the event is queued for replay.
+ */
+
+void edgex_data_submit_event
+(
+  edgex_device_service *svc,
+  const char *device,
   edgex_event_cooked *eventval,
   edgex_error *err
 );
@@ -111,8 +198,19 @@ edgex_valuedescriptor *edgex_data_client_add_valuedescriptor
   edgex_error *err
 );
 
+/* All the value descriptors known to core-data, as a JSON array */
+
+JSON_Value *edgex_data_client_get_valuedescriptors
+  (iot_logger_t *lc, edgex_service_endpoints *endpoints, edgex_error *err);
+
 void edgex_device_commandresult_free (edgex_device_commandresult *res, int n);
 
+/* Free the String and Binary values held in results, but not the array itself */
+
+void edgex_device_commandresult_clear (edgex_device_commandresult *res, int n);
+
+/* Binary values are shared with the copy rather than duplicated, so res is modified to reference-count them */
+
 edgex_device_commandresult *edgex_device_commandresult_dup (const edgex_device_commandresult *res, int n);
 
 bool edgex_device_commandresult_equal
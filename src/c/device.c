@@ -10,18 +10,30 @@
 #include "service.h"
 #include "errorlist.h"
 #include "parson.h"
+#include "arena.h"
 #include "data.h"
-#include "metadata.h"
 #include "edgex-rest.h"
 #include "edgex-time.h"
 #include "cmdinfo.h"
 #include "iot/base64.h"
 #include "transform.h"
+#include "floatfmt.h"
+#include "correlation.h"
+#include "jsonbuf.h"
+#include "cborbuf.h"
+#include "jsonscan.h"
+#include "readcache.h"
+#include "inflight.h"
+#include "driver.h"
+#include "recycle.h"
 
 #include <inttypes.h>
 #include <string.h>
+#include <math.h>
 #include <errno.h>
 #include <microhttpd.h>
+#include <pthread.h>
+#include <time.h>
 
 /* NOTES
  *
@@ -57,83 +69,97 @@ static const char *methStr (edgex_http_method method)
   }
 }
 
-static bool isNumericType (edgex_propertytype type)
+const char *edgex_value_tostring_r
+  (const edgex_device_commandresult *value, edgex_floatformat ffmt, char *buf, size_t size)
 {
-  return (type != Bool && type != String && type != Binary);
-}
-
-char *edgex_value_tostring (const edgex_device_commandresult *value, bool binfloat)
-{
-#define BUFSIZE 32
-
-  size_t sz;
-  char *res = NULL;
-
-  if (isNumericType (value->type))
-  {
-    res = malloc (BUFSIZE);
-  }
-
   switch (value->type)
   {
     case Bool:
-      res = strdup (value->value.bool_result ? "true" : "false");
-      break;
+      return value->value.bool_result ? "true" : "false";
     case Uint8:
-      sprintf (res, "%" PRIu8, value->value.ui8_result);
+      snprintf (buf, size, "%" PRIu8, value->value.ui8_result);
       break;
     case Uint16:
-      sprintf (res, "%" PRIu16, value->value.ui16_result);
+      snprintf (buf, size, "%" PRIu16, value->value.ui16_result);
       break;
     case Uint32:
-      sprintf (res, "%" PRIu32, value->value.ui32_result);
+      snprintf (buf, size, "%" PRIu32, value->value.ui32_result);
       break;
     case Uint64:
-      sprintf (res, "%" PRIu64, value->value.ui64_result);
+      snprintf (buf, size, "%" PRIu64, value->value.ui64_result);
       break;
     case Int8:
-      sprintf (res, "%" PRIi8, value->value.i8_result);
+      snprintf (buf, size, "%" PRIi8, value->value.i8_result);
       break;
     case Int16:
-      sprintf (res, "%" PRIi16, value->value.i16_result);
+      snprintf (buf, size, "%" PRIi16, value->value.i16_result);
       break;
     case Int32:
-      sprintf (res, "%" PRIi32, value->value.i32_result);
+      snprintf (buf, size, "%" PRIi32, value->value.i32_result);
       break;
     case Int64:
-      sprintf (res, "%" PRIi64, value->value.i64_result);
+      snprintf (buf, size, "%" PRIi64, value->value.i64_result);
       break;
     case Float32:
-      if (binfloat)
-      {
-        iot_b64_encode (&value->value.f32_result, sizeof (float), res, BUFSIZE);
-      }
-      else
+      switch (ffmt)
       {
-        sprintf (res, "%.8e", value->value.f32_result);
+        case EDGEX_FLOAT_BASE64:
+          iot_b64_encode (&value->value.f32_result, sizeof (float), buf, size);
+          break;
+        case EDGEX_FLOAT_SHORTEST:
+          edgex_float_tostring (value->value.f32_result, true, buf, size);
+          break;
+        default:
+          snprintf (buf, size, "%.8e", value->value.f32_result);
+          break;
       }
       break;
     case Float64:
-      if (binfloat)
-      {
-        iot_b64_encode (&value->value.f64_result, sizeof (double), res, BUFSIZE);
-      }
-      else
+      switch (ffmt)
       {
-        sprintf (res, "%.16e", value->value.f64_result);
+        case EDGEX_FLOAT_BASE64:
+          iot_b64_encode (&value->value.f64_result, sizeof (double), buf, size);
+          break;
+        case EDGEX_FLOAT_SHORTEST:
+          edgex_float_tostring (value->value.f64_result, false, buf, size);
+          break;
+        default:
+          snprintf (buf, size, "%.16e", value->value.f64_result);
+          break;
       }
       break;
     case String:
-      res = strdup (value->value.string_result);
-      break;
+      return value->value.string_result;
     case Binary:
-      sz = iot_b64_encodesize (value->value.binary_result.size);
-      res = malloc (sz);
+      if (iot_b64_encodesize (value->value.binary_result.size) > size)
+      {
+        return NULL;
+      }
       iot_b64_encode
-        (value->value.binary_result.bytes, value->value.binary_result.size, res, sz);
+        (value->value.binary_result.bytes, value->value.binary_result.size, buf, size);
       break;
   }
-  return res;
+  return buf;
+}
+
+char *edgex_value_tostring (const edgex_device_commandresult *value, bool binfloat)
+{
+  char buf[EDGEX_VALUE_BUFSIZE];
+  const char *str;
+  char *res;
+  size_t sz;
+
+  if (value->type == Binary)
+  {
+    sz = iot_b64_encodesize (value->value.binary_result.size);
+    res = malloc (sz);
+    iot_b64_encode
+      (value->value.binary_result.bytes, value->value.binary_result.size, res, sz);
+    return res;
+  }
+  str = edgex_value_tostring_r
+    (value, binfloat ? EDGEX_FLOAT_BASE64 : EDGEX_FLOAT_ENOTATION, buf, sizeof (buf));
+  return strdup (str);
 }
 
 static bool populateValue
@@ -203,6 +229,110 @@ static bool populateValue
   return false;
 }
 
+/*
+ * Parse an assertion into a value of the resource's type, and determine the
+ * float formats for which formatting that value reproduces the text exactly.
+ * Under those formats, only a reading with the same value formats the same.
+ */
+
+static void compileAssertion (const edgex_propertyvalue *pv, edgex_assertion *asrt)
+{
+  memset (asrt, 0, sizeof (edgex_assertion));
+  if (pv->assertion == NULL || *pv->assertion == '\0')
+  {
+    return;
+  }
+  asrt->text = pv->assertion;
+  asrt->value.type = pv->type;
+  if (pv->type == String)
+  {
+    asrt->formats = ~0u;
+  }
+  else if (populateValue (&asrt->value, pv->assertion))
+  {
+    for (edgex_floatformat ffmt = EDGEX_FLOAT_ENOTATION; ffmt <= EDGEX_FLOAT_BASE64; ffmt++)
+    {
+      char buf[EDGEX_VALUE_BUFSIZE];
+      char *str = NULL;
+      const char *canon = edgex_value_tostring_r (&asrt->value, ffmt, buf, sizeof (buf));
+      if (canon == NULL)
+      {
+        canon = str = edgex_value_tostring (&asrt->value, false);
+      }
+      if (strcmp (canon, pv->assertion) == 0)
+      {
+        asrt->formats |= (1u << ffmt);
+      }
+      free (str);
+    }
+  }
+}
+
+/* NaNs format alike whatever their payload, so only their signs are compared */
+
+static bool sameNaN (double a, double b)
+{
+  return isnan (a) && isnan (b) && signbit (a) == signbit (b);
+}
+
+bool edgex_assertion_check
+  (const edgex_assertion *asrt, const edgex_device_commandresult *value, edgex_floatformat ffmt)
+{
+  const edgex_device_resultvalue *a = &asrt->value.value;
+  const edgex_device_resultvalue *v = &value->value;
+
+  if (value->type != asrt->value.type)
+  {
+    /* The transform may have replaced the reading, eg with "overflow" */
+    char buf[EDGEX_VALUE_BUFSIZE];
+    char *str = NULL;
+    bool match;
+    const char *reading = edgex_value_tostring_r (value, ffmt, buf, sizeof (buf));
+    if (reading == NULL)
+    {
+      reading = str = edgex_value_tostring (value, ffmt == EDGEX_FLOAT_BASE64);
+    }
+    match = (strcmp (reading, asrt->text) == 0);
+    free (str);
+    return match;
+  }
+  if ((asrt->formats & (1u << ffmt)) == 0)
+  {
+    return false;
+  }
+  switch (value->type)
+  {
+    case String:
+      return strcmp (v->string_result, asrt->text) == 0;
+    case Bool:
+      return v->bool_result == a->bool_result;
+    case Uint8:
+      return v->ui8_result == a->ui8_result;
+    case Uint16:
+      return v->ui16_result == a->ui16_result;
+    case Uint32:
+      return v->ui32_result == a->ui32_result;
+    case Uint64:
+      return v->ui64_result == a->ui64_result;
+    case Int8:
+      return v->i8_result == a->i8_result;
+    case Int16:
+      return v->i16_result == a->i16_result;
+    case Int32:
+      return v->i32_result == a->i32_result;
+    case Int64:
+      return v->i64_result == a->i64_result;
+    case Float32:
+      return memcmp (&v->f32_result, &a->f32_result, sizeof (float)) == 0 || sameNaN (v->f32_result, a->f32_result);
+    case Float64:
+      return memcmp (&v->f64_result, &a->f64_result, sizeof (double)) == 0 || sameNaN (v->f64_result, a->f64_result);
+    case Binary:
+      return v->binary_result.size == a->binary_result.size &&
+        memcmp (v->binary_result.bytes, a->binary_result.bytes, a->binary_result.size) == 0;
+  }
+  return false;
+}
+
 static edgex_deviceresource *findDevResource
   (edgex_deviceresource *list, const char *name)
 {
@@ -213,6 +343,13 @@ static edgex_deviceresource *findDevResource
   return list;
 }
 
+/* Maximum age in ms of a cached reading for a resource, or 0 if it is not to be cached */
+
+static uint64_t resMaxAge (const edgex_propertyvalue *pv)
+{
+  return (pv->maxAge && *pv->maxAge) ? edgex_device_parsetime (pv->maxAge) : 0;
+}
+
 static edgex_cmdinfo *infoForRes
   (edgex_deviceprofile *prof, edgex_devicecommand *cmd, bool forGet)
 {
@@ -228,8 +365,13 @@ static edgex_cmdinfo *infoForRes
   result->nreqs = n;
   result->reqs = calloc (n, sizeof (edgex_device_commandrequest));
   result->pvals = calloc (n, sizeof (edgex_propertyvalue *));
-  result->maps = calloc (n, sizeof (edgex_nvpairs *));
+  result->maps = calloc (n, sizeof (edgex_map_string *));
   result->dfls = calloc (n, sizeof (char *));
+  result->maxage = calloc (n, sizeof (uint64_t));
+  result->xforms = calloc (n, sizeof (edgex_transform));
+  result->xfruns = calloc (n, sizeof (unsigned));
+  result->asserts = calloc (n, sizeof (edgex_assertion));
+  result->cached = false;
   for (n = 0, ro = forGet ? cmd->get : cmd->set; ro; n++, ro = ro->next)
   {
     edgex_deviceresource *devres =
@@ -238,7 +380,11 @@ static edgex_cmdinfo *infoForRes
     result->reqs[n].attributes = devres->attributes;
     result->reqs[n].type = devres->properties->value->type;
     result->pvals[n] = devres->properties->value;
-    result->maps[n] = ro->mappings;
+    result->maps[n] = edgex_transform_mappings (ro->mappings);
+    result->maxage[n] = resMaxAge (devres->properties->value);
+    edgex_transform_compile (devres->properties->value, &result->xforms[n]);
+    compileAssertion (devres->properties->value, &result->asserts[n]);
+    result->cached |= (result->maxage[n] != 0);
     if (ro->parameter && *ro->parameter)
     {
       result->dfls[n] = ro->parameter;
@@ -248,6 +394,15 @@ static edgex_cmdinfo *infoForRes
       result->dfls[n] = devres->properties->value->defaultvalue;
     }
   }
+
+  /* Find runs of requests whose readings can be transformed together */
+
+  for (n = result->nreqs; n-- > 0; )
+  {
+    bool same = n + 1 < result->nreqs && result->xforms[n].nout &&
+      edgex_transform_equal (&result->xforms[n], &result->xforms[n + 1]);
+    result->xfruns[n] = same ? result->xfruns[n + 1] + 1 : 1;
+  }
   result->next = NULL;
   return result;
 }
@@ -260,13 +415,23 @@ static edgex_cmdinfo *infoForDevRes (edgex_deviceresource *devres, bool forGet)
   result->nreqs = 1;
   result->reqs = malloc (sizeof (edgex_device_commandrequest));
   result->pvals = malloc (sizeof (edgex_propertyvalue *));
-  result->maps = malloc (sizeof (edgex_nvpairs *));
+  result->maps = malloc (sizeof (edgex_map_string *));
   result->dfls = malloc (sizeof (char *));
+  result->maxage = malloc (sizeof (uint64_t));
+  result->xforms = malloc (sizeof (edgex_transform));
+  result->xfruns = malloc (sizeof (unsigned));
+  result->xfruns[0] = 1;
+  result->asserts = malloc (sizeof (edgex_assertion));
   result->reqs[0].resname = devres->name;
   result->reqs[0].attributes = devres->attributes;
   result->reqs[0].type = devres->properties->value->type;
+  result->reqs[0].plan = NULL;
   result->pvals[0] = devres->properties->value;
   result->maps[0] = NULL;
+  result->maxage[0] = resMaxAge (devres->properties->value);
+  edgex_transform_compile (devres->properties->value, &result->xforms[0]);
+  compileAssertion (devres->properties->value, &result->asserts[0]);
+  result->cached = (result->maxage[0] != 0);
   if (devres->properties->value->defaultvalue && *devres->properties->value->defaultvalue)
   {
     result->dfls[0] = devres->properties->value->defaultvalue;
@@ -279,10 +444,15 @@ static edgex_cmdinfo *infoForDevRes (edgex_deviceresource *devres, bool forGet)
   return result;
 }
 
-static void populateCmdInfo (edgex_deviceprofile *prof)
+void edgex_deviceprofile_compile (edgex_device_service *svc, edgex_deviceprofile *prof)
 {
   edgex_cmdinfo **head = &prof->cmdinfo;
   edgex_devicecommand *cmd = prof->device_commands;
+
+  if (prof->cmdindex)
+  {
+    return;
+  }
   while (cmd)
   {
     if (cmd->get)
@@ -323,58 +493,95 @@ static void populateCmdInfo (edgex_deviceprofile *prof)
     }
     devres = devres->next;
   }
-}
 
-const edgex_cmdinfo *edgex_deviceprofile_findcommand
-  (const char *name, edgex_deviceprofile *prof, bool forGet)
-{
-  if (prof->cmdinfo == NULL)
+  /* Index the command info by name. Where names are duplicated, the first entry is found, as in the list */
+
+  prof->cmdindex = malloc (sizeof (edgex_cmdindex));
+  edgex_map_init (&prof->cmdindex->map);
+  for (edgex_cmdinfo *inf = prof->cmdinfo; inf; inf = inf->next)
   {
-    populateCmdInfo (prof);
+    edgex_cmdpair pair = { NULL, NULL };
+    edgex_cmdpair *existing = edgex_map_get (&prof->cmdindex->map, inf->name);
+    if (existing)
+    {
+      pair = *existing;
+    }
+    if (inf->isget && pair.get == NULL)
+    {
+      pair.get = inf;
+    }
+    else if (!inf->isget && pair.set == NULL)
+    {
+      pair.set = inf;
+    }
+    edgex_map_set (&prof->cmdindex->map, inf->name, pair);
   }
 
-  edgex_cmdinfo *result = prof->cmdinfo;
-  while (result && (strcmp (result->name, name) || forGet != result->isget))
+  for (edgex_cmdinfo *inf = prof->cmdinfo; inf; inf = inf->next)
   {
-    result = result->next;
+    inf->plan = NULL;
+    inf->release = NULL;
+    inf->impl = NULL;
+    if (svc && svc->prepare)
+    {
+      inf->plan = svc->prepare (svc->userdata, prof->name, inf->name, inf->isget, inf->nreqs, inf->reqs);
+      inf->release = inf->plan ? svc->release : NULL;
+      inf->impl = svc->userdata;
+    }
   }
-  return result;
 }
 
-static bool commandExists (const char *name, edgex_deviceprofile *prof)
+const edgex_cmdinfo *edgex_deviceprofile_findcommand
+  (const char *name, edgex_deviceprofile *prof, bool forGet)
 {
-  if (prof->cmdinfo == NULL)
-  {
-    populateCmdInfo (prof);
-  }
+  edgex_cmdpair *pair = prof->cmdindex ? edgex_map_get (&prof->cmdindex->map, name) : NULL;
+  return pair ? (forGet ? pair->get : pair->set) : NULL;
+}
 
-  edgex_cmdinfo *result = prof->cmdinfo;
-  while (result && strcmp (result->name, name))
-  {
-    result = result->next;
-  }
-  return result != NULL;
+static bool commandExists (const char *name, edgex_deviceprofile *prof)
+{
+  return prof->cmdindex && edgex_map_get (&prof->cmdindex->map, name) != NULL;
 }
 
-static int edgex_device_runput
+/*
+ * A PUT is performed in two stages: the payload is parsed and transformed
+ * into values for the command's resources, which depend only on the profile,
+ * and the values are then written to the device. The values for a command
+ * may therefore be prepared once and written to any number of devices.
+ */
+
+static int runput_prepare
 (
   edgex_device_service *svc,
-  edgex_device *dev,
   const edgex_cmdinfo *commandinfo,
-  const char *data
+  const char *data,
+  edgex_device_commandresult **prepared
 )
 {
   const char *value;
   int retcode = MHD_HTTP_OK;
 
-  JSON_Value *jval = json_parse_string (data);
-  if (jval == NULL)
+  /* A command with no resources has nothing to write, and would give zero-length arrays below */
+
+  if (commandinfo->nreqs == 0)
   {
-    iot_log_error (svc->logger, "Payload did not parse as JSON");
+    iot_log_error (svc->logger, "Command %s has no resources to write", commandinfo->name);
     return MHD_HTTP_BAD_REQUEST;
   }
 
-  JSON_Object *jobj = json_value_get_object (jval);
+  const char *resnames[commandinfo->nreqs];
+  const char *values[commandinfo->nreqs];
+
+  for (int i = 0; i < commandinfo->nreqs; i++)
+  {
+    resnames[i] = commandinfo->reqs[i].resname;
+  }
+  char *work = edgex_json_scan_strings (data, commandinfo->nreqs, resnames, values);
+  if (work == NULL)
+  {
+    iot_log_error (svc->logger, "Payload did not parse as a JSON object");
+    return MHD_HTTP_BAD_REQUEST;
+  }
 
   edgex_device_commandresult *results =
     calloc (commandinfo->nreqs, sizeof (edgex_device_commandresult));
@@ -389,7 +596,7 @@ static int edgex_device_runput
       break;
     }
 
-    value = json_object_get_string (jobj, resname);
+    value = values[i];
     if (value == NULL && commandinfo->dfls[i] == NULL)
     {
       retcode = MHD_HTTP_BAD_REQUEST;
@@ -406,7 +613,7 @@ static int edgex_device_runput
     }
     if (svc->config.device.datatransform && value)
     {
-      if (!edgex_transform_incoming (&results[i], commandinfo->pvals[i], commandinfo->maps[i]))
+      if (!edgex_transform_incoming (&results[i], &commandinfo->xforms[i], commandinfo->maps[i]))
       {
         retcode = MHD_HTTP_BAD_REQUEST;
         iot_log_error (svc->logger, "Value \"%s\" for %s overflows after transformations", value, resname);
@@ -415,34 +622,91 @@ static int edgex_device_runput
     }
   }
 
+  free (work);
   if (retcode == MHD_HTTP_OK)
   {
-    if (!svc->userfns.puthandler (svc->userdata, dev->name, dev->protocols, commandinfo->nreqs, commandinfo->reqs, results))
-    {
-      retcode = MHD_HTTP_INTERNAL_SERVER_ERROR;
-      iot_log_error (svc->logger, "Driver for %s failed on PUT", dev->name);
-    }
+    *prepared = results;
+  }
+  else
+  {
+    edgex_device_commandresult_free (results, commandinfo->nreqs);
   }
+  return retcode;
+}
 
-  edgex_device_commandresult_free (results, commandinfo->nreqs);
-  json_value_free (jval);
+static void runput_written (edgex_device_service *svc, edgex_device *dev, const edgex_cmdinfo *commandinfo)
+{
+  if (commandinfo->cached)
+  {
+    edgex_readcache_invalidate (svc->readcache, dev->name, commandinfo);
+  }
+}
 
+static int runput_write
+(
+  edgex_device_service *svc,
+  edgex_device *dev,
+  const edgex_cmdinfo *commandinfo,
+  const edgex_device_commandresult *values
+)
+{
+  int retcode = MHD_HTTP_OK;
+  edgex_latency_entry *lat = edgex_latency_lookup (svc->latency, dev->name, commandinfo->name);
+  uint64_t start = edgex_latency_start (lat);
+  bool ok = edgex_driver_put (svc, EDGEX_QOS_COMMAND, dev, commandinfo->nreqs, commandinfo->reqs, values);
+  edgex_latency_record (lat, EDGEX_LATENCY_DRIVER, start);
+  if (!ok)
+  {
+    retcode = MHD_HTTP_INTERNAL_SERVER_ERROR;
+    iot_log_error (svc->logger, "Driver for %s failed on PUT", dev->name);
+  }
+  runput_written (svc, dev, commandinfo);
   return retcode;
 }
 
-static int edgex_device_runget
+static int edgex_device_runput
 (
   edgex_device_service *svc,
   edgex_device *dev,
   const edgex_cmdinfo *commandinfo,
-  const char *querystr,
-  edgex_event_cooked **reply
+  const char *data
 )
+{
+  edgex_device_commandresult *values;
+  int retcode = runput_prepare (svc, commandinfo, data, &values);
+  if (retcode == MHD_HTTP_OK)
+  {
+    retcode = runput_write (svc, dev, commandinfo, values);
+    edgex_device_commandresult_free (values, commandinfo->nreqs);
+  }
+  return retcode;
+}
+
+/*
+ * A GET is performed in three stages: preparation of the requests (and a
+ * cache lookup), the call to the implementation (unless the readings were
+ * cached), and processing of the results. When the implementation completes
+ * gets asynchronously, the command for all devices issues the calls for every
+ * device before processing any of the results.
+ */
+
+typedef struct runget_op
 {
   edgex_device_commandrequest *requests;
   edgex_device_commandresult *results;
-  int retcode = MHD_HTTP_INTERNAL_SERVER_ERROR;
+  bool cacheable;
+  bool fromcache;
+} runget_op;
 
+static int runget_prepare
+(
+  edgex_device_service *svc,
+  edgex_device *dev,
+  const edgex_cmdinfo *commandinfo,
+  const char *querystr,
+  runget_op *op
+)
+{
   for (int i = 0; i < commandinfo->nreqs; i++)
   {
     if (!commandinfo->pvals[i]->readable)
@@ -452,42 +716,86 @@ static int edgex_device_runget
     }
   }
 
-  results = calloc (commandinfo->nreqs, sizeof (edgex_device_commandresult));
+  op->results = edgex_recycle_results (commandinfo->nreqs);
   if (querystr)
   {
+    /* The requests and the urlRawQuery attribute prepended to each are held in one allocation */
+
     size_t sz = sizeof (edgex_device_commandrequest) * commandinfo->nreqs;
-    requests = malloc (sz);
-    memcpy (requests, commandinfo->reqs, sz);
+    op->requests = edgex_recycle_alloc (sz + sizeof (edgex_nvpairs) * commandinfo->nreqs);
+    memcpy (op->requests, commandinfo->reqs, sz);
+    edgex_nvpairs *pairs = (edgex_nvpairs *)(op->requests + commandinfo->nreqs);
     for (int i = 0; i < commandinfo->nreqs; i++)
     {
-      edgex_nvpairs *pair = malloc (sizeof (edgex_nvpairs));
-      pair->name = "urlRawQuery";
-      pair->value = (char *)querystr;
-      pair->next = (edgex_nvpairs *)requests[i].attributes;
-      requests[i].attributes = pair;
+      pairs[i].name = "urlRawQuery";
+      pairs[i].value = (char *)querystr;
+      pairs[i].next = (edgex_nvpairs *)op->requests[i].attributes;
+      op->requests[i].attributes = &pairs[i];
     }
   }
   else
   {
-    requests = commandinfo->reqs;
+    op->requests = commandinfo->reqs;
+  }
+
+  /* Readings taken with a query string may depend on it, so these bypass the cache */
+
+  op->cacheable = commandinfo->cached && querystr == NULL;
+  op->fromcache = op->cacheable && edgex_readcache_get (svc->readcache, dev->name, commandinfo, op->results);
+  return MHD_HTTP_OK;
+}
+
+static void runget_release (const edgex_cmdinfo *commandinfo, runget_op *op)
+{
+  edgex_recycle_results_free (op->results, commandinfo->nreqs);
+  if (op->requests != commandinfo->reqs)
+  {
+    edgex_recycle_free (op->requests);
   }
+}
+
+/* Process the readings (ok indicates whether they were obtained) and release the operation */
+
+static int runget_finish
+(
+  edgex_device_service *svc,
+  edgex_device *dev,
+  const edgex_cmdinfo *commandinfo,
+  runget_op *op,
+  bool ok,
+  edgex_event_cooked **reply
+)
+{
+  int retcode = MHD_HTTP_INTERNAL_SERVER_ERROR;
 
-  if (svc->userfns.gethandler (svc->userdata, dev->name, dev->protocols, commandinfo->nreqs, requests, results))
+  if (ok)
   {
     edgex_error err = EDGEX_OK;
+    edgex_latency_entry *lat = edgex_latency_lookup (svc->latency, dev->name, commandinfo->name);
+    if (op->cacheable && !op->fromcache)
+    {
+      edgex_readcache_put (svc->readcache, dev->name, commandinfo, op->results);
+    }
     *reply = edgex_data_process_event
-      (dev->name, commandinfo, results, svc->config.device.datatransform);
+    (
+      dev->name, commandinfo, op->results, svc->config.device.datatransform, svc->config.device.shortestfloats,
+      svc->config.device.streamthreshold, edgex_batch_compact (svc->batch), lat, op->fromcache ? NULL : svc->eventring
+    );
 
     if (*reply)
     {
       retcode = MHD_HTTP_OK;
-      edgex_data_client_add_event (svc->logger, &svc->config.endpoints, *reply, &err);
+      if (!op->fromcache)
+      {
+        uint64_t start = edgex_latency_start (lat);
+        edgex_data_submit_event (svc, dev->name, *reply, &err);
+        edgex_latency_record (lat, EDGEX_LATENCY_POST, start);
+      }
     }
     else
     {
       iot_log_error (svc->logger, "Assertion failed for device %s. Disabling.", dev->name);
-      edgex_metadata_client_set_device_opstate
-        (svc->logger, &svc->config.endpoints, dev->id, DISABLED, &err);
+      edgex_opstate_set (svc->opqueue, dev, DISABLED);
     }
   }
   else
@@ -496,28 +804,76 @@ static int edgex_device_runget
       (svc->logger, "Driver for %s failed on GET", dev->name);
   }
 
-  edgex_device_commandresult_free (results, commandinfo->nreqs);
-  if (querystr)
+  runget_release (commandinfo, op);
+  return retcode;
+}
+
+static int runget_read
+(
+  edgex_device_service *svc,
+  edgex_device *dev,
+  const edgex_cmdinfo *commandinfo,
+  const char *querystr,
+  edgex_event_cooked **reply
+)
+{
+  runget_op op;
+  int retcode = runget_prepare (svc, dev, commandinfo, querystr, &op);
+
+  if (retcode == MHD_HTTP_OK)
   {
-    for (int i = 0; i < commandinfo->nreqs; i++)
+    bool ok = op.fromcache;
+    if (!ok)
     {
-      free ((edgex_nvpairs *)requests[i].attributes);
+      edgex_latency_entry *lat = edgex_latency_lookup (svc->latency, dev->name, commandinfo->name);
+      uint64_t start = edgex_latency_start (lat);
+      ok = edgex_driver_get (svc, EDGEX_QOS_COMMAND, dev, commandinfo->nreqs, op.requests, op.results);
+      edgex_latency_record (lat, EDGEX_LATENCY_DRIVER, start);
     }
-    free (requests);
+    retcode = runget_finish (svc, dev, commandinfo, &op, ok, reply);
   }
   return retcode;
 }
 
-static int runOne
+/* Perform a GET, sharing the result of an identical request which is already in progress */
+
+static int edgex_device_runget
 (
   edgex_device_service *svc,
   edgex_device *dev,
-  const edgex_cmdinfo *command,
+  const edgex_cmdinfo *commandinfo,
   const char *querystr,
-  const char *upload_data,
-  size_t upload_data_size,
   edgex_event_cooked **reply
 )
+{
+  int retcode;
+  edgex_inflight_op *op;
+
+  if (svc->inflight == NULL)
+  {
+    return runget_read (svc, dev, commandinfo, querystr, reply);
+  }
+
+  size_t sz = strlen (dev->name) + strlen (commandinfo->name) + (querystr ? strlen (querystr) : 0) + 3;
+  char *key = malloc (sz);
+  snprintf (key, sz, "%s/%s?%s", dev->name, commandinfo->name, querystr ? querystr : "");
+  op = edgex_inflight_join (svc->inflight, key, &retcode, reply);
+  free (key);
+  if (op)
+  {
+    retcode = runget_read (svc, dev, commandinfo, querystr, reply);
+    edgex_inflight_complete (svc->inflight, op, retcode, *reply);
+  }
+  else
+  {
+    iot_log_debug (svc->logger, "GET %s for device %s served by a concurrent request", commandinfo->name, dev->name);
+  }
+  return retcode;
+}
+
+/* Check that a command may be run on a device, returning the HTTP status for the failure if not */
+
+static int commandAllowed (edgex_device_service *svc, edgex_device *dev, const edgex_cmdinfo *command)
 {
   if (dev->adminState == LOCKED)
   {
@@ -551,10 +907,33 @@ static int runOne
     );
     return MHD_HTTP_INTERNAL_SERVER_ERROR;
   }
+  return MHD_HTTP_OK;
+}
+
+static int runOne
+(
+  edgex_device_service *svc,
+  edgex_device *dev,
+  const edgex_cmdinfo *command,
+  const char *querystr,
+  const char *upload_data,
+  size_t upload_data_size,
+  edgex_event_cooked **reply
+)
+{
+  edgex_latency_entry *lat;
+  uint64_t start;
+  int status = commandAllowed (svc, dev, command);
+  if (status != MHD_HTTP_OK)
+  {
+    return status;
+  }
 
+  lat = edgex_latency_lookup (svc->latency, dev->name, command->name);
+  start = edgex_latency_start (lat);
   if (command->isget)
   {
-    return edgex_device_runget (svc, dev, command, querystr, reply);
+    status = edgex_device_runget (svc, dev, command, querystr, reply);
   }
   else
   {
@@ -563,16 +942,515 @@ static int runOne
       iot_log_error (svc->logger, "PUT command recieved with no data");
       return MHD_HTTP_BAD_REQUEST;
     }
-    return edgex_device_runput (svc, dev, command, upload_data);
+    status = edgex_device_runput (svc, dev, command, upload_data);
   }
+  edgex_latency_record (lat, EDGEX_LATENCY_COMMAND, start);
+  return status;
 }
 
-typedef struct devlist
-{
-   edgex_device *dev;
-   const edgex_cmdinfo *cmd;
-   struct devlist *next;
-} devlist;
+/*
+ * Commands for all devices may be run in parallel on the service's command
+ * pool. Each job takes the next unstarted entry from the list until none
+ * remain. Where the implementation completes gets asynchronously, the reads
+ * for GET entries are instead all started from the request thread. The
+ * request thread waits for all entries to complete or for the deadline to
+ * pass; the context is reference counted so that jobs and reads which are
+ * still running at the deadline may complete safely afterwards.
+ *
+ * The payload of a PUT for all devices is prepared once for each command,
+ * ie for each profile, and the values shared by the entries for its devices.
+ * Where the implementation has a group put handler, the devices of each
+ * profile are then written to in a single call from the request thread, and
+ * only the entries it does not complete are run individually.
+ */
+
+typedef enum { ALLCMD_PENDING, ALLCMD_RUNNING, ALLCMD_DONE } allcmd_state;
+
+struct allcmd_ctx;
+
+typedef struct allcmd_entry
+{
+  struct allcmd_ctx *ctx;
+  edgex_device *dev;
+  const edgex_cmdinfo *cmd;
+  allcmd_state state;
+  int status;
+  edgex_event_cooked *reply;
+  char *data;
+  size_t size;
+  runget_op *op;
+  bool success;
+  const edgex_device_commandresult *values;
+} allcmd_entry;
+
+typedef struct allcmd_group
+{
+  const edgex_cmdinfo *cmd;
+  edgex_device_commandresult *values;
+  int status;
+} allcmd_group;
+
+typedef struct allcmd_ctx
+{
+  edgex_device_service *svc;
+  char *querystr;
+  char *upload_data;
+  size_t upload_data_size;
+  char *crlid;
+  allcmd_entry *entries;
+  allcmd_group *groups;
+  uint32_t ngroups;
+  uint32_t count;
+  uint32_t next;
+  uint32_t done;
+  uint32_t refs;
+  bool expired;
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+} allcmd_ctx;
+
+static void allcmd_free (allcmd_ctx *ctx)
+{
+  for (uint32_t i = 0; i < ctx->ngroups; i++)
+  {
+    edgex_device_commandresult_free (ctx->groups[i].values, ctx->groups[i].cmd->nreqs);
+  }
+  for (uint32_t i = 0; i < ctx->count; i++)
+  {
+    if (ctx->entries[i].dev)
+    {
+      edgex_device_release (ctx->entries[i].dev);
+    }
+    edgex_event_cooked_free (ctx->entries[i].reply);
+    free (ctx->entries[i].data);
+  }
+  pthread_cond_destroy (&ctx->cond);
+  pthread_mutex_destroy (&ctx->lock);
+  free (ctx->entries);
+  free (ctx->groups);
+  free (ctx->querystr);
+  free (ctx->upload_data);
+  free (ctx->crlid);
+  free (ctx);
+}
+
+static void allcmd_unref (allcmd_ctx *ctx)
+{
+  bool last;
+  pthread_mutex_lock (&ctx->lock);
+  last = (--ctx->refs == 0);
+  pthread_mutex_unlock (&ctx->lock);
+  if (last)
+  {
+    allcmd_free (ctx);
+  }
+}
+
+/* Record an entry's completion. Called with the lock held */
+
+static void allcmd_done (allcmd_ctx *ctx, allcmd_entry *e)
+{
+  e->state = ALLCMD_DONE;
+  if (++ctx->done == ctx->count)
+  {
+    pthread_cond_signal (&ctx->cond);
+  }
+}
+
+/* Write prepared values to the device of an entry */
+
+static int allcmd_runvalues (allcmd_ctx *ctx, allcmd_entry *e)
+{
+  edgex_latency_entry *lat;
+  uint64_t start;
+  int status = commandAllowed (ctx->svc, e->dev, e->cmd);
+  if (status == MHD_HTTP_OK)
+  {
+    lat = edgex_latency_lookup (ctx->svc->latency, e->dev->name, e->cmd->name);
+    start = edgex_latency_start (lat);
+    status = runput_write (ctx->svc, e->dev, e->cmd, e->values);
+    edgex_latency_record (lat, EDGEX_LATENCY_COMMAND, start);
+  }
+  return status;
+}
+
+/*
+ * Run one entry. Prepared values are used if it has them, then its own
+ * payload if it has one, otherwise that of the request.
+ */
+
+static int allcmd_runentry
+  (allcmd_ctx *ctx, allcmd_entry *e, const char *querystr, const char *data, size_t size, edgex_event_cooked **reply)
+{
+  if (e->values)
+  {
+    return allcmd_runvalues (ctx, e);
+  }
+  return e->data ?
+    runOne (ctx->svc, e->dev, e->cmd, querystr, e->data, e->size, reply) :
+    runOne (ctx->svc, e->dev, e->cmd, querystr, data, size, reply);
+}
+
+/* Find or create the group for a command, preparing its values from the payload */
+
+static allcmd_group *allcmd_group_for (allcmd_ctx *ctx, const edgex_cmdinfo *cmd, const char *data)
+{
+  allcmd_group *g;
+  for (uint32_t i = 0; i < ctx->ngroups; i++)
+  {
+    if (ctx->groups[i].cmd == cmd)
+    {
+      return &ctx->groups[i];
+    }
+  }
+  g = &ctx->groups[ctx->ngroups++];
+  g->cmd = cmd;
+  g->values = NULL;
+  g->status = runput_prepare (ctx->svc, cmd, data, &g->values);
+  return g;
+}
+
+/* Write a group's values to its devices with the group put handler, completing their entries if it succeeds */
+
+static void allcmd_groupput (allcmd_ctx *ctx, allcmd_group *g)
+{
+  uint32_t ndevs = 0;
+  const edgex_device **devs = malloc (ctx->count * sizeof (edgex_device *));
+  edgex_device_service *svc = ctx->svc;
+
+  for (uint32_t i = 0; i < ctx->count; i++)
+  {
+    allcmd_entry *e = &ctx->entries[i];
+    if (e->state == ALLCMD_PENDING && e->values == g->values)
+    {
+      devs[ndevs++] = e->dev;
+    }
+  }
+
+  if (ndevs > 1)
+  {
+    if (edgex_driver_put_group (svc, EDGEX_QOS_COMMAND, ndevs, devs, g->cmd->nreqs, g->cmd->reqs, g->values))
+    {
+      iot_log_debug (svc->logger, "Command %s written to %u devices as a group", g->cmd->name, ndevs);
+      for (uint32_t i = 0; i < ctx->count; i++)
+      {
+        allcmd_entry *e = &ctx->entries[i];
+        if (e->state == ALLCMD_PENDING && e->values == g->values)
+        {
+          runput_written (svc, e->dev, e->cmd);
+          e->status = MHD_HTTP_OK;
+          e->state = ALLCMD_DONE;
+        }
+      }
+    }
+    else
+    {
+      iot_log_debug (svc->logger, "Group put of %s declined, writing to devices individually", g->cmd->name);
+    }
+  }
+  free (devs);
+}
+
+/* Prepare the values for the PUT entries of a request for all devices, and make any group writes */
+
+static void allcmd_prepareput (allcmd_ctx *ctx, const char *data)
+{
+  ctx->groups = calloc (ctx->count, sizeof (allcmd_group));
+  for (uint32_t i = 0; i < ctx->count; i++)
+  {
+    allcmd_entry *e = &ctx->entries[i];
+    allcmd_group *g;
+    if (e->state != ALLCMD_PENDING || e->cmd->isget)
+    {
+      continue;
+    }
+    e->status = commandAllowed (ctx->svc, e->dev, e->cmd);
+    if (e->status == MHD_HTTP_OK)
+    {
+      g = allcmd_group_for (ctx, e->cmd, data);
+      e->status = g->status;
+      e->values = g->values;
+    }
+    if (e->status != MHD_HTTP_OK)
+    {
+      e->state = ALLCMD_DONE;
+    }
+  }
+
+  if (edgex_driver_group_put (ctx->svc))
+  {
+    for (uint32_t i = 0; i < ctx->ngroups; i++)
+    {
+      if (ctx->groups[i].status == MHD_HTTP_OK)
+      {
+        allcmd_groupput (ctx, &ctx->groups[i]);
+      }
+    }
+  }
+}
+
+static void allcmd_job (void *p)
+{
+  allcmd_ctx *ctx = (allcmd_ctx *)p;
+
+  if (ctx->crlid)
+  {
+    edgex_device_alloc_crlid (ctx->crlid);
+  }
+  pthread_mutex_lock (&ctx->lock);
+  while (ctx->next < ctx->count)
+  {
+    int status;
+    edgex_event_cooked *reply = NULL;
+    allcmd_entry *e = &ctx->entries[ctx->next++];
+    if (e->state != ALLCMD_PENDING)
+    {
+      continue;
+    }
+    e->state = ALLCMD_RUNNING;
+    pthread_mutex_unlock (&ctx->lock);
+
+    status = allcmd_runentry (ctx, e, ctx->querystr, ctx->upload_data, ctx->upload_data_size, &reply);
+
+    pthread_mutex_lock (&ctx->lock);
+    if (ctx->expired)
+    {
+      edgex_event_cooked_free (reply);
+      continue;
+    }
+    e->status = status;
+    e->reply = reply;
+    allcmd_done (ctx, e);
+  }
+  pthread_mutex_unlock (&ctx->lock);
+  edgex_device_free_crlid ();
+  allcmd_unref (ctx);
+}
+
+/* Completion of an asynchronous read. The results are processed by the request thread */
+
+static void allcmd_readdone (void *p, bool success)
+{
+  allcmd_entry *e = (allcmd_entry *)p;
+  allcmd_ctx *ctx = e->ctx;
+
+  pthread_mutex_lock (&ctx->lock);
+  if (ctx->expired)
+  {
+    runget_release (e->cmd, e->op);
+    free (e->op);
+    e->op = NULL;
+  }
+  else
+  {
+    e->success = success;
+    allcmd_done (ctx, e);
+  }
+  pthread_mutex_unlock (&ctx->lock);
+  allcmd_unref (ctx);
+}
+
+/* Start asynchronous reads for the pending GET entries */
+
+static void allcmd_async (edgex_device_service *svc, allcmd_ctx *ctx)
+{
+  for (uint32_t i = 0; i < ctx->count; i++)
+  {
+    runget_op op;
+    allcmd_entry *e = &ctx->entries[i];
+    if (e->state != ALLCMD_PENDING || !e->cmd->isget)
+    {
+      continue;
+    }
+
+    e->status = commandAllowed (svc, e->dev, e->cmd);
+    if (e->status == MHD_HTTP_OK)
+    {
+      e->status = runget_prepare (svc, e->dev, e->cmd, ctx->querystr, &op);
+    }
+    if (e->status == MHD_HTTP_OK && op.fromcache)
+    {
+      e->status = runget_finish (svc, e->dev, e->cmd, &op, true, &e->reply);
+    }
+    else if (e->status == MHD_HTTP_OK)
+    {
+      e->op = malloc (sizeof (runget_op));
+      *e->op = op;
+      pthread_mutex_lock (&ctx->lock);
+      e->state = ALLCMD_RUNNING;
+      ctx->refs++;
+      pthread_mutex_unlock (&ctx->lock);
+      edgex_driver_get_async (svc, EDGEX_QOS_COMMAND, e->dev, e->cmd->nreqs, e->op->requests, e->op->results, allcmd_readdone, e);
+      continue;
+    }
+    pthread_mutex_lock (&ctx->lock);
+    allcmd_done (ctx, e);
+    pthread_mutex_unlock (&ctx->lock);
+  }
+}
+
+/* Queue jobs to run the pending entries on the command pool */
+
+static void allcmd_parallel (edgex_device_service *svc, allcmd_ctx *ctx)
+{
+  uint32_t njobs = svc->config.device.allcmdconcurrency ? svc->config.device.allcmdconcurrency : 1;
+
+  pthread_mutex_lock (&ctx->lock);
+  if (njobs > ctx->count - ctx->done)
+  {
+    njobs = ctx->count - ctx->done;
+  }
+  ctx->refs += njobs;
+  pthread_mutex_unlock (&ctx->lock);
+
+  for (uint32_t i = 0; i < njobs; i++)
+  {
+    edgex_pool_add_work (svc->cmdpool, allcmd_job, ctx);
+  }
+}
+
+/* Wait until the entries complete or the deadline passes (if timeout, in ms, is set) */
+
+static void allcmd_wait
+(
+  edgex_device_service *svc,
+  allcmd_ctx *ctx,
+  uint32_t timeout,
+  const struct timespec *deadline
+)
+{
+  pthread_mutex_lock (&ctx->lock);
+  while (ctx->done < ctx->count)
+  {
+    if (timeout)
+    {
+      if (pthread_cond_timedwait (&ctx->cond, &ctx->lock, deadline) == ETIMEDOUT)
+      {
+        break;
+      }
+    }
+    else
+    {
+      pthread_cond_wait (&ctx->cond, &ctx->lock);
+    }
+  }
+
+  /* Any entries not completed by the deadline are reported as timed out. Unstarted ones are abandoned */
+
+  ctx->expired = true;
+  ctx->next = ctx->count;
+  for (uint32_t i = 0; i < ctx->count; i++)
+  {
+    allcmd_entry *e = &ctx->entries[i];
+    if (e->state != ALLCMD_DONE)
+    {
+      iot_log_error
+      (
+        svc->logger,
+        "Command %s for device %s %s within %ums",
+        e->cmd->name, e->dev->name, e->state == ALLCMD_RUNNING ? "did not complete" : "was not started", timeout
+      );
+      e->status = MHD_HTTP_GATEWAY_TIMEOUT;
+    }
+  }
+  pthread_mutex_unlock (&ctx->lock);
+}
+
+/*
+ * Run the entries which are not already complete: asynchronous reads first,
+ * then the remainder on the command pool if it is enabled, otherwise on the
+ * request thread. On return the context's lock is initialised and it holds
+ * one reference for the caller.
+ */
+
+static void allcmd_run
+(
+  edgex_device_service *svc,
+  allcmd_ctx *ctx,
+  const char *querystr,
+  const char *upload_data,
+  size_t upload_data_size
+)
+{
+  pthread_condattr_t attr;
+  struct timespec deadline;
+  uint32_t timeout = svc->config.device.allcmdtimeout;
+
+  pthread_mutex_init (&ctx->lock, NULL);
+  pthread_condattr_init (&attr);
+  pthread_condattr_setclock (&attr, CLOCK_MONOTONIC);
+  pthread_cond_init (&ctx->cond, &attr);
+  pthread_condattr_destroy (&attr);
+  ctx->refs = 1;
+
+  clock_gettime (CLOCK_MONOTONIC, &deadline);
+  deadline.tv_sec += timeout / 1000;
+  deadline.tv_nsec += (timeout % 1000) * 1000000;
+  if (deadline.tv_nsec >= 1000000000)
+  {
+    deadline.tv_sec++;
+    deadline.tv_nsec -= 1000000000;
+  }
+
+  /* Jobs and reads may outlive this request if the deadline passes, so they work on copies of the request data */
+
+  ctx->querystr = querystr ? strdup (querystr) : NULL;
+  for (uint32_t i = 0; i < ctx->count; i++)
+  {
+    ctx->entries[i].ctx = ctx;
+    if (ctx->entries[i].state == ALLCMD_DONE)
+    {
+      ctx->done++;
+    }
+  }
+
+  if (edgex_driver_async_get (svc))
+  {
+    allcmd_async (svc, ctx);
+  }
+
+  if (svc->cmdpool && ctx->done < ctx->count)
+  {
+    if (upload_data_size)
+    {
+      ctx->upload_data = malloc (upload_data_size + 1);
+      memcpy (ctx->upload_data, upload_data, upload_data_size);
+      ctx->upload_data[upload_data_size] = '\0';
+      ctx->upload_data_size = upload_data_size;
+    }
+    ctx->crlid = edgex_device_get_crlid () ? strdup (edgex_device_get_crlid ()) : NULL;
+    allcmd_parallel (svc, ctx);
+  }
+  else
+  {
+    for (uint32_t i = 0; i < ctx->count; i++)
+    {
+      allcmd_entry *e = &ctx->entries[i];
+      if (e->state == ALLCMD_PENDING)
+      {
+        e->status = allcmd_runentry (ctx, e, ctx->querystr, upload_data, upload_data_size, &e->reply);
+        pthread_mutex_lock (&ctx->lock);
+        allcmd_done (ctx, e);
+        pthread_mutex_unlock (&ctx->lock);
+      }
+    }
+  }
+
+  allcmd_wait (svc, ctx, timeout, &deadline);
+
+  /* Process the results of asynchronous reads which completed in time */
+
+  for (uint32_t i = 0; i < ctx->count; i++)
+  {
+    allcmd_entry *e = &ctx->entries[i];
+    if (e->state == ALLCMD_DONE && e->op)
+    {
+      e->status = runget_finish (svc, e->dev, e->cmd, e->op, e->success, &e->reply);
+      free (e->op);
+      e->op = NULL;
+    }
+  }
+}
 
 static int allCommand
 (
@@ -588,93 +1466,173 @@ static int allCommand
 )
 {
   int ret = MHD_HTTP_NOT_FOUND;
-  int retOne;
   edgex_cmdqueue_t *cmdq = NULL;
   edgex_cmdqueue_t *iter;
+  allcmd_ctx *ctx;
   uint32_t nret = 0;
-  char *buff;
   edgex_event_encoding enc;
   size_t bsize;
 
   iot_log_debug
     (svc->logger, "Incoming %s command %s for all", methStr (method), cmd);
 
-  enc = JSON;
-  bsize = 3; // start-array byte + end-array byte + NUL character
-  buff = malloc (bsize);
-  strcpy (buff, "[");
-
   cmdq = edgex_devmap_device_forcmd (svc->devices, cmd, method == GET);
 
+  ctx = calloc (1, sizeof (allcmd_ctx));
+  ctx->svc = svc;
   for (iter = cmdq; iter; iter = iter->next)
   {
-    edgex_event_cooked *ereply = NULL;
-    retOne = runOne (svc, iter->dev, iter->cmd, querystr, upload_data, upload_data_size, &ereply);
-    edgex_device_release (iter->dev);
-    if (ereply)
+    ctx->count++;
+  }
+  ctx->entries = calloc (ctx->count, sizeof (allcmd_entry));
+  ctx->count = 0;
+  while (cmdq)
+  {
+    iter = cmdq->next;
+    ctx->entries[ctx->count].dev = cmdq->dev;
+    ctx->entries[ctx->count++].cmd = cmdq->cmd;
+    free (cmdq);
+    cmdq = iter;
+  }
+
+  if (method != GET && upload_data_size)
+  {
+    allcmd_prepareput (ctx, upload_data);
+  }
+
+  allcmd_run (svc, ctx, querystr, upload_data, upload_data_size);
+
+  /* Check the results in device order, sizing the reply */
+
+  enc = JSON;
+  bsize = 2; // start-array byte + end-array byte
+  pthread_mutex_lock (&ctx->lock);
+  for (uint32_t i = 0; i < ctx->count; i++)
+  {
+    allcmd_entry *e = &ctx->entries[i];
+    if (e->status != MHD_HTTP_OK && e->status != MHD_HTTP_GATEWAY_TIMEOUT)
     {
-      enc = ereply->encoding;
-      switch (enc)
-      {
-        case JSON:
-          bsize += (strlen (ereply->value.json) + (nret ? 1 : 0));
-          buff = realloc (buff, bsize);
-          if (nret)
-          {
-            strcat (buff, ",");
-          }
-          strcat (buff, ereply->value.json);
-          break;
-        case CBOR:
-          buff = realloc (buff, bsize + ereply->value.cbor.length);
-          if (nret == 0)
-          {
-            buff[0] = '\374';
-          }
-          memcpy (buff + bsize - 2, ereply->value.cbor.data, ereply->value.cbor.length);
-          bsize += ereply->value.cbor.length;
-          break;
-      }
+      iot_log_error
+        (svc->logger, "Command %s for device %s failed with status %d", e->cmd->name, e->dev->name, e->status);
+    }
+    if (e->state == ALLCMD_DONE && e->reply)
+    {
+      enc = nret ? enc : e->reply->encoding;
+      bsize += (e->reply->encoding == JSON) ? strlen (e->reply->value.json) + 1 : e->reply->value.cbor.length;
       nret++;
     }
-    edgex_event_cooked_free (ereply);
     if (ret != MHD_HTTP_OK)
     {
-      ret = retOne;
+      ret = e->status;
     }
   }
 
+  /* Assemble the reply in a single allocation, releasing each event once it is copied */
+
   if (ret == MHD_HTTP_OK)
   {
-    switch (enc)
+    edgex_jsonbuf buff;
+    edgex_jsonbuf_init (&buff, bsize + 1);
+    edgex_jsonbuf_appendc (&buff, enc == JSON ? '[' : '\374');
+    nret = 0;
+    for (uint32_t i = 0; i < ctx->count; i++)
     {
-      case JSON:
-        strcat (buff, "]");
-        *reply = buff;
-        *reply_size = strlen (buff);
-        *reply_type = "application/json";
-        break;
-      case CBOR:
-        buff[bsize - 2] = '\377';
-        buff[bsize - 1] = '\0';
-        *reply = buff;
-        *reply_size = bsize - 1;
-        *reply_type = "application/cbor";
-        break;
+      allcmd_entry *e = &ctx->entries[i];
+      if (e->state == ALLCMD_DONE && e->reply)
+      {
+        if (e->reply->encoding != enc)
+        {
+          iot_log_warn (svc->logger, "Omitting reply from device %s: event encoding differs", e->dev->name);
+        }
+        else if (enc == JSON)
+        {
+          if (nret++)
+          {
+            edgex_jsonbuf_appendc (&buff, ',');
+          }
+          edgex_jsonbuf_append (&buff, e->reply->value.json, strlen (e->reply->value.json));
+        }
+        else
+        {
+          edgex_jsonbuf_append (&buff, (const char *)edgex_event_cooked_cbor (e->reply), e->reply->value.cbor.length);
+        }
+        edgex_event_cooked_free (e->reply);
+        e->reply = NULL;
+      }
     }
+    edgex_jsonbuf_appendc (&buff, enc == JSON ? ']' : '\377');
+    *reply_size = buff.len;
+    *reply = edgex_jsonbuf_finish (&buff);
+    *reply_type = enc == JSON ? "application/json" : "application/cbor";
+  }
+  pthread_mutex_unlock (&ctx->lock);
+  allcmd_unref (ctx);
+  return ret;
+}
+
+/*
+ * Locate a device and command. On success *dev must be released by the
+ * caller; otherwise the HTTP status for the failure is returned.
+ */
+
+static int findCommand
+(
+  edgex_device_service *svc,
+  const char *id,
+  bool byName,
+  const char *cmd,
+  bool forGet,
+  edgex_device **dev,
+  const edgex_cmdinfo **command
+)
+{
+  if (byName)
+  {
+    *dev = edgex_devmap_device_byname (svc->devices, id);
   }
   else
   {
-    free (buff);
+    *dev = edgex_devmap_device_byid (svc->devices, id);
   }
 
-  while (cmdq)
+  if (*dev == NULL)
   {
-    iter = cmdq->next;
-    free (cmdq);
-    cmdq = iter;
+    iot_log_error (svc->logger, "No such device {%s}", id);
+    return MHD_HTTP_NOT_FOUND;
   }
-  return ret;
+
+  *command = edgex_deviceprofile_findcommand (cmd, (*dev)->profile, forGet);
+  if (*command)
+  {
+    return MHD_HTTP_OK;
+  }
+
+  int result = MHD_HTTP_NOT_FOUND;
+  if (commandExists (cmd, (*dev)->profile))
+  {
+    iot_log_error
+    (
+      svc->logger,
+      "Wrong method for command %s, device %s",
+      cmd, (*dev)->name
+    );
+    result = MHD_HTTP_METHOD_NOT_ALLOWED;
+  }
+  else
+  {
+    iot_log_error
+      (svc->logger, "No command %s for device %s", cmd, (*dev)->name);
+  }
+  edgex_device_release (*dev);
+  *dev = NULL;
+  return result;
+}
+
+/* The reply to a command for one device is sent from its event, which may also be held for posting */
+
+static void reply_release (void *event)
+{
+  edgex_event_cooked_free (event);
 }
 
 static int oneCommand
@@ -692,7 +1650,7 @@ static int oneCommand
   const char **reply_type
 )
 {
-  int result = MHD_HTTP_NOT_FOUND;
+  int result;
   edgex_device *dev = NULL;
   const edgex_cmdinfo *command = NULL;
 
@@ -703,22 +1661,8 @@ static int oneCommand
     id, cmd, methStr (method)
   );
 
-  if (byName)
-  {
-    dev = edgex_devmap_device_byname (svc->devices, id);
-  }
-  else
-  {
-    dev = edgex_devmap_device_byid (svc->devices, id);
-  }
-
-  if (dev)
-  {
-    command = edgex_deviceprofile_findcommand
-      (cmd, dev->profile, method == GET);
-  }
-
-  if (command)
+  result = findCommand (svc, id, byName, cmd, method == GET, &dev, &command);
+  if (result == MHD_HTTP_OK)
   {
     edgex_event_cooked *ereply = NULL;
     result = runOne
@@ -726,46 +1670,9 @@ static int oneCommand
     edgex_device_release (dev);
     if (ereply)
     {
-      switch (ereply->encoding)
-      {
-        case JSON:
-          *reply = ereply->value.json;
-          *reply_size = strlen (ereply->value.json);
-          *reply_type = "application/json";
-          break;
-        case CBOR:
-          *reply = ereply->value.cbor.data;
-          *reply_size = ereply->value.cbor.length;
-          *reply_type = "application/cbor";
-          break;
-      }
-      free (ereply);
-    }
-  }
-  else
-  {
-    if (dev)
-    {
-      if (commandExists (cmd, dev->profile))
-      {
-        iot_log_error
-        (
-          svc->logger,
-          "Wrong method for command %s, device %s",
-          cmd, dev->name
-        );
-        result = MHD_HTTP_METHOD_NOT_ALLOWED;
-      }
-      else
-      {
-        iot_log_error
-          (svc->logger, "No command %s for device %s", cmd, dev->name);
-      }
-      edgex_device_release (dev);
-    }
-    else
-    {
-      iot_log_error (svc->logger, "No such device {%s}", id);
+      *reply_type = ereply->encoding == JSON ? "application/json" : "application/cbor";
+      *reply = (void *)edgex_event_cooked_data (ereply, reply_size);
+      edgex_rest_server_reply_owned (reply_release, ereply);
     }
   }
   return result;
@@ -830,3 +1737,168 @@ int edgex_device_handler_device
   }
   return result;
 }
+
+/*
+ * Batch commands. The request body is a JSON array of objects, each naming a
+ * device ("device", or "id" to specify it by id), a command and optionally a
+ * method ("get", the default, "put" or "post") and a body for set commands.
+ * The commands are run as for commands for all devices, and the reply is an
+ * array with an element for each command giving its status and any event.
+ */
+
+int edgex_device_handler_batch
+(
+  void *ctx,
+  char *url,
+  char *querystr,
+  edgex_http_method method,
+  const char *upload_data,
+  size_t upload_data_size,
+  void **reply,
+  size_t *reply_size,
+  const char **reply_type
+)
+{
+  edgex_device_service *svc = (edgex_device_service *) ctx;
+  JSON_Value *jval;
+  JSON_Array *jarr;
+  allcmd_ctx *bctx;
+  bool cbor = false;
+
+  /* The request is parsed into an arena: anything kept from it is copied out */
+
+  edgex_arena_begin ();
+  jval = upload_data_size ? json_parse_string (upload_data) : NULL;
+  jarr = json_value_get_array (jval);
+  if (jarr == NULL)
+  {
+    iot_log_error (svc->logger, "Batch request is not a JSON array");
+    json_value_free (jval);
+    edgex_arena_end ();
+    return MHD_HTTP_BAD_REQUEST;
+  }
+
+  bctx = calloc (1, sizeof (allcmd_ctx));
+  bctx->svc = svc;
+  bctx->count = json_array_get_count (jarr);
+  bctx->entries = calloc (bctx->count, sizeof (allcmd_entry));
+  iot_log_debug (svc->logger, "Incoming batch of %u commands", bctx->count);
+
+  for (uint32_t i = 0; i < bctx->count; i++)
+  {
+    allcmd_entry *e = &bctx->entries[i];
+    JSON_Object *obj = json_array_get_object (jarr, i);
+    const char *name = json_object_get_string (obj, "device");
+    const char *id = json_object_get_string (obj, "id");
+    const char *cmd = json_object_get_string (obj, "command");
+    const char *meth = json_object_get_string (obj, "method");
+    bool forGet = (meth == NULL || strcasecmp (meth, "get") == 0);
+
+    if ((name == NULL && id == NULL) || cmd == NULL ||
+        !(forGet || strcasecmp (meth, "put") == 0 || strcasecmp (meth, "post") == 0))
+    {
+      iot_log_error (svc->logger, "Batch: invalid command at index %u", i);
+      e->status = MHD_HTTP_BAD_REQUEST;
+      e->state = ALLCMD_DONE;
+      continue;
+    }
+
+    e->status = findCommand (svc, name ? name : id, name != NULL, cmd, forGet, &e->dev, &e->cmd);
+    if (e->status != MHD_HTTP_OK)
+    {
+      e->state = ALLCMD_DONE;
+      continue;
+    }
+
+    if (!forGet)
+    {
+      JSON_Value *body = json_object_get_value (obj, "body");
+      if (json_value_get_type (body) == JSONString)
+      {
+        e->data = strdup (json_value_get_string (body));
+      }
+      else if (body)
+      {
+        char *json = json_serialize_to_string (body);
+        e->data = json ? strdup (json) : NULL;
+        json_free_serialized_string (json);
+      }
+      e->size = e->data ? strlen (e->data) : 0;
+    }
+  }
+  json_value_free (jval);
+  edgex_arena_end ();
+
+  allcmd_run (svc, bctx, querystr, NULL, 0);
+
+  /* The reply is CBOR if any of the events are */
+
+  pthread_mutex_lock (&bctx->lock);
+  for (uint32_t i = 0; i < bctx->count; i++)
+  {
+    allcmd_entry *e = &bctx->entries[i];
+    if (e->state == ALLCMD_DONE && e->reply && e->reply->encoding == CBOR)
+    {
+      cbor = true;
+    }
+  }
+
+  if (cbor)
+  {
+    edgex_cborbuf buf;
+    edgex_cborbuf_init (&buf, 0);
+    edgex_cborbuf_head (&buf, EDGEX_CBOR_ARRAY, bctx->count);
+    for (uint32_t i = 0; i < bctx->count; i++)
+    {
+      allcmd_entry *e = &bctx->entries[i];
+      edgex_event_cooked *ev = (e->state == ALLCMD_DONE) ? e->reply : NULL;
+      edgex_cborbuf_head (&buf, EDGEX_CBOR_MAP, ev ? 2 : 1);
+      edgex_cborbuf_string (&buf, "status");
+      edgex_cborbuf_head (&buf, EDGEX_CBOR_UINT, e->status);
+      if (ev)
+      {
+        edgex_cborbuf_string (&buf, "event");
+        if (ev->encoding == CBOR)
+        {
+          edgex_cborbuf_raw (&buf, edgex_event_cooked_cbor (ev), ev->value.cbor.length);
+        }
+        else
+        {
+          edgex_cborbuf_string (&buf, ev->value.json);
+        }
+      }
+    }
+    *reply = edgex_cborbuf_finish (&buf, reply_size);
+    *reply_type = "application/cbor";
+  }
+  else
+  {
+    edgex_jsonbuf buf;
+    edgex_jsonbuf_init (&buf, 0);
+    edgex_jsonbuf_appendc (&buf, '[');
+    for (uint32_t i = 0; i < bctx->count; i++)
+    {
+      bool first = true;
+      allcmd_entry *e = &bctx->entries[i];
+      if (i)
+      {
+        edgex_jsonbuf_appendc (&buf, ',');
+      }
+      edgex_jsonbuf_appendc (&buf, '{');
+      edgex_jsonbuf_member_uint (&buf, &first, "status", e->status);
+      if (e->state == ALLCMD_DONE && e->reply)
+      {
+        edgex_jsonbuf_key (&buf, &first, "event");
+        edgex_jsonbuf_append (&buf, e->reply->value.json, strlen (e->reply->value.json));
+      }
+      edgex_jsonbuf_appendc (&buf, '}');
+    }
+    edgex_jsonbuf_appendc (&buf, ']');
+    *reply_size = buf.len;
+    *reply = edgex_jsonbuf_finish (&buf);
+    *reply_type = "application/json";
+  }
+  pthread_mutex_unlock (&bctx->lock);
+  allcmd_unref (bctx);
+  return MHD_HTTP_OK;
+}
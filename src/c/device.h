@@ -28,8 +28,60 @@ extern int edgex_device_handler_device
   const char **reply_type
 );
 
+extern int edgex_device_handler_batch
+(
+  void *ctx,
+  char *url,
+  char *querystr,
+  edgex_http_method method,
+  const char *upload_data,
+  size_t upload_data_size,
+  void **reply,
+  size_t *reply_size,
+  const char **reply_type
+);
+
+/* Buffer size sufficient for formatting any value other than String or Binary */
+
+#define EDGEX_VALUE_BUFSIZE 32
+
+/*
+ * Float formats: e-notation at full precision, e-notation with the fewest
+ * digits which round-trip, or base64 encoding of the binary value.
+ */
+
+typedef enum { EDGEX_FLOAT_ENOTATION, EDGEX_FLOAT_SHORTEST, EDGEX_FLOAT_BASE64 } edgex_floatformat;
+
 extern char *edgex_value_tostring (const edgex_device_commandresult *value, bool binfloat);
 
+/*
+ * As edgex_value_tostring, but without allocation. Numeric and Bool values are
+ * formatted into buf (or a constant string is returned), String values are
+ * returned directly. Binary values are base64-encoded into buf, or NULL is
+ * returned if buf is too small; in that case edgex_value_tostring must be used.
+ */
+
+extern const char *edgex_value_tostring_r
+  (const edgex_device_commandresult *value, edgex_floatformat ffmt, char *buf, size_t size);
+
+/*
+ * Whether a reading satisfies an assertion: true if its string form under the
+ * given float format would equal the assertion text. Readings of the
+ * resource's own type are compared natively.
+ */
+
+extern bool edgex_assertion_check
+  (const edgex_assertion *asrt, const edgex_device_commandresult *value, edgex_floatformat ffmt);
+
+/*
+ * Build the command info and command index for a profile, with the plans of
+ * the service's prepare handler if it has one. This must be done before the
+ * profile is made visible to other threads, ie before it is added to the
+ * devmap.
+ */
+
+extern void edgex_deviceprofile_compile (edgex_device_service *svc, edgex_deviceprofile *prof);
+
 extern const struct edgex_cmdinfo *edgex_deviceprofile_findcommand
   (const char *name, edgex_deviceprofile *prof, bool forGet);
 
@@ -12,6 +12,7 @@
 #include "edgex-rest.h"
 #include "errorlist.h"
 #include "edgex-time.h"
+#include "rest-async.h"
 #include "edgex/device-mgmt.h"
 
 #include <string.h>
@@ -72,6 +73,158 @@ char * edgex_device_add_device
   return result;
 }
 
+/* Bulk addition: POSTs to core-metadata run concurrently on the async engine's connections */
+
+#define EDGEX_BULKADD_INFLIGHT 16
+
+static void bulkadd_done (void *ctx, const edgex_error *err, const char *response, void *data, size_t length)
+{
+  edgex_device_addresult *result = (edgex_device_addresult *)ctx;
+
+  result->err = *err;
+  if (err->code == 0)
+  {
+    if (response && *response)
+    {
+      result->id = strdup (response);
+    }
+    else
+    {
+      result->err = EDGEX_HTTP_ERROR;
+    }
+  }
+  free (data);
+}
+
+unsigned edgex_device_add_devices
+(
+  edgex_device_service *svc,
+  const edgex_device_newdevice *devices,
+  unsigned n,
+  edgex_device_addresult *results
+)
+{
+  edgex_http_async_t *client;
+  edgex_deviceservice ds;
+  edgex_device *devs;
+  edgex_deviceprofile *stubs;
+  edgex_device *list = NULL;
+  edgex_device **last = &list;
+  bool *posted;
+  bool *added;
+  char url[URL_BUF_SIZE];
+  unsigned nposted = 0;
+  unsigned nok = 0;
+  uint64_t now = edgex_device_millitime ();
+
+  memset (&ds, 0, sizeof (ds));
+  ds.name = (char *)svc->name;
+  ds.id = "";
+  ds.description = "";
+  devs = calloc (n, sizeof (edgex_device));
+  stubs = calloc (n, sizeof (edgex_deviceprofile));
+  posted = calloc (n, sizeof (bool));
+  added = calloc (n, sizeof (bool));
+
+  snprintf
+  (
+    url, URL_BUF_SIZE - 1, "http://%s:%u/api/v1/device",
+    svc->config.endpoints.metadata.host, svc->config.endpoints.metadata.port
+  );
+  client = edgex_http_async_alloc (svc->logger, EDGEX_BULKADD_INFLIGHT, EDGEX_COMPRESS_NONE, 0);
+
+  for (unsigned i = 0; i < n; i++)
+  {
+    edgex_device *existing = edgex_devmap_device_byname (svc->devices, devices[i].name);
+    results[i].id = NULL;
+    results[i].err = EDGEX_OK;
+    if (existing)
+    {
+      results[i].id = strdup (existing->id);
+      edgex_device_release (existing);
+      continue;
+    }
+
+    devs[i].name = (char *)devices[i].name;
+    devs[i].description = (char *)(devices[i].description ? devices[i].description : "");
+    devs[i].labels = (edgex_strings *)devices[i].labels;
+    devs[i].protocols = devices[i].protocols;
+    devs[i].autos = devices[i].autos;
+    devs[i].adminState = UNLOCKED;
+    devs[i].operatingState = ENABLED;
+    devs[i].created = devs[i].modified = devs[i].origin = now;
+    devs[i].service = &ds;
+    stubs[i].name = (char *)devices[i].profile_name;
+    devs[i].profile = &stubs[i];
+
+    char *json = edgex_device_write (&devs[i], true);
+    edgex_http_async_post (client, url, "application/json", json, strlen (json), bulkadd_done, &results[i]);
+    posted[i] = true;
+    nposted++;
+  }
+
+  /* Completes all the requests */
+
+  edgex_http_async_free (client);
+
+  /* Enter the new devices into the devmap together, rather than reading each back */
+
+  for (unsigned i = 0; i < n; i++)
+  {
+    if (posted[i])
+    {
+      if (results[i].id)
+      {
+        const edgex_deviceprofile *dp = edgex_deviceprofile_get_internal (svc, devices[i].profile_name, &results[i].err);
+        if (dp)
+        {
+          devs[i].id = results[i].id;
+          devs[i].profile = (edgex_deviceprofile *)dp;
+          *last = &devs[i];
+          last = &devs[i].next;
+        }
+        else
+        {
+          iot_log_warn (svc->logger, "Device %s added with id %s, but its profile could not be retrieved", devices[i].name, results[i].id);
+        }
+        results[i].err = EDGEX_OK;
+        iot_log_info (svc->logger, "Device %s added with id %s", devices[i].name, results[i].id);
+      }
+      else
+      {
+        iot_log_error (svc->logger, "Failed to add Device %s in core-metadata: %s", devices[i].name, results[i].err.reason);
+      }
+    }
+    if (results[i].id)
+    {
+      nok++;
+    }
+  }
+
+  if (list)
+  {
+    edgex_devmap_add_devices (svc->devices, list, added);
+    if (svc->addcallback)
+    {
+      unsigned j = 0;
+      for (const edgex_device *d = list; d; d = d->next)
+      {
+        if (added[j++])
+        {
+          svc->addcallback (svc->userdata, d->name, d->protocols, d->adminState);
+        }
+      }
+    }
+  }
+  iot_log_info (svc->logger, "Bulk add: %u of %u devices posted, %u added or present", nposted, n, nok);
+
+  free (added);
+  free (posted);
+  free (stubs);
+  free (devs);
+  return nok;
+}
+
 edgex_device * edgex_device_devices (edgex_device_service *svc)
 {
   return edgex_devmap_copydevices (svc->devices);
@@ -107,6 +260,45 @@ edgex_device * edgex_device_get_device_byname
   return result;
 }
 
+edgex_device ** edgex_device_acquire_devices (edgex_device_service *svc)
+{
+  return edgex_devmap_devices (svc->devices);
+}
+
+edgex_device * edgex_device_acquire_device (edgex_device_service *svc, const char *id)
+{
+  return edgex_devmap_device_byid (svc->devices, id);
+}
+
+edgex_device * edgex_device_acquire_device_byname (edgex_device_service *svc, const char *name)
+{
+  return edgex_devmap_device_byname (svc->devices, name);
+}
+
+edgex_device ** edgex_device_devices_bylabel
+  (edgex_device_service *svc, const char *label)
+{
+  return edgex_devmap_devices_bylabel (svc->devices, label);
+}
+
+edgex_device ** edgex_device_devices_byprotocol
+  (edgex_device_service *svc, const char *protocol, const char *property, const char *value)
+{
+  return edgex_devmap_devices_byprotocol (svc->devices, protocol, property, value);
+}
+
+void edgex_device_release_devices (edgex_device **devs)
+{
+  if (devs)
+  {
+    for (edgex_device **d = devs; *d; d++)
+    {
+      edgex_device_release (*d);
+    }
+    free (devs);
+  }
+}
+
 void edgex_device_remove_device
   (edgex_device_service *svc, const char *id, edgex_error *err)
 {
@@ -7,47 +7,689 @@
  */
 
 /* Device / profile map implementation. We maintain 3 maps: device by id,
- * device id by name and profile by name. The devices in the device map
- * reference profiles in the profile map by pointer.
+ * device by name and profile by name. The devices in the device map
+ * reference profiles in the profile map by pointer. An index from command
+ * name to the profiles which implement it, and the devices using each of
+ * those profiles, serves commands for all devices. Further indexes find
+ * devices by label and by protocol property.
+ *
+ * The devices are partitioned into shards by a hash of their names. Each
+ * shard holds its maps and indexes in a snapshot which is never modified
+ * once published. Lookups read the current snapshots without locking,
+ * within an epoch read section. Updates to a shard are serialized by its
+ * mutex; each builds a new snapshot of the shard and publishes it. The old
+ * snapshot, and any removed devices, are retired to be freed and released
+ * once their readers have finished, so that no update waits for readers
+ * while it holds a mutex. An update therefore copies only the devices of one
+ * shard, and updates to different shards proceed at once. Lists of devices
+ * may be added, replaced or removed together, publishing each shard once.
+ * Queries over all devices visit each shard in turn. Profiles are held in a
+ * single map, which is replaced in the same way when one is added.
+ *
+ * Where an update involves more than one shard (a device renamed, or a list
+ * of devices) their mutexes are taken in shard order.
  */
 
 #include "devmap.h"
 #include "devutil.h"
 #include "map.h"
+#include "epoch.h"
 #include "edgex-rest.h"
 #include "device.h"
 #include "autoevent.h"
+#include "cmdinfo.h"
+#include "trace.h"
+#include "memstats.h"
+#include "intern.h"
+#include "readcache.h"
+#include "circuit.h"
+#include "latency.h"
+
+#define DEVMAP_SHARDS 16
 
 typedef edgex_map(edgex_device *) edgex_map_device;
 typedef edgex_map(edgex_deviceprofile *) edgex_map_profile;
 
-struct edgex_devmap_t
+/* A group of devices in an index. For the profile index, the group's profile is also held */
+
+typedef struct devmap_devlist
+{
+  edgex_deviceprofile *profile;
+  unsigned count;
+  edgex_device **devices;
+} devmap_devlist;
+
+typedef edgex_map(devmap_devlist) edgex_map_devlist;
+
+/* A command implemented by a profile, listed under the command's name */
+
+typedef struct devmap_cmdtarget
+{
+  const edgex_cmdinfo *cmd;
+  const devmap_devlist *profdevs;
+  struct devmap_cmdtarget *next;
+} devmap_cmdtarget;
+
+typedef edgex_map(devmap_cmdtarget *) edgex_map_cmdtarget;
+
+typedef struct devmap_snapshot
 {
-  pthread_rwlock_t lock;
   edgex_map_device devices;
-  edgex_map_string name_to_id;
-  edgex_map_profile profiles;
+  edgex_map_device byname;
+  edgex_map_devlist byprofile;
+  edgex_map_devlist bylabel;
+  edgex_map_devlist byprotocol;
+  edgex_map_cmdtarget getcmds;
+  edgex_map_cmdtarget setcmds;
+} devmap_snapshot;
+
+typedef struct devmap_shard
+{
+  pthread_mutex_t lock;
+  _Atomic (devmap_snapshot *) current;
+} devmap_shard;
+
+struct edgex_devmap_t
+{
+  devmap_shard shards[DEVMAP_SHARDS];
+  pthread_mutex_t proflock;
+  _Atomic (edgex_map_profile *) profiles;
   edgex_device_service *svc;
 };
 
-edgex_devmap_t *edgex_devmap_alloc (edgex_device_service *svc)
+/* Shards are chosen with a different hash from that of the maps, so that each shard's maps use all their slots */
+
+static unsigned shard_index (const char *name)
+{
+  uint32_t hash = 2166136261u;
+  while (*name)
+  {
+    hash = (hash ^ (unsigned char)*name++) * 16777619u;
+  }
+  return hash % DEVMAP_SHARDS;
+}
+
+static devmap_shard *shard_for (edgex_devmap_t *map, const char *name)
+{
+  return &map->shards[shard_index (name)];
+}
+
+static devmap_snapshot *shard_current (devmap_shard *sh)
+{
+  return atomic_load (&sh->current);
+}
+
+/*
+ * Lookups in a published snapshot. These avoid edgex_map_get, which stores
+ * its result in the map and so would write to memory shared by all readers.
+ */
+
+static edgex_device *snapshot_device (edgex_map_device *m, const char *key)
+{
+  edgex_device **dev = edgex_map_get_ (&m->base, key);
+  return dev ? *dev : NULL;
+}
+
+static edgex_deviceprofile *snapshot_profile (edgex_map_profile *m, const char *key)
+{
+  edgex_deviceprofile **dp = edgex_map_get_ (&m->base, key);
+  return dp ? *dp : NULL;
+}
+
+static devmap_cmdtarget *snapshot_cmdtargets (edgex_map_cmdtarget *m, const char *key)
+{
+  devmap_cmdtarget **t = edgex_map_get_ (&m->base, key);
+  return t ? *t : NULL;
+}
+
+/* Copy the device maps of a snapshot. The indexes are built when the copy is published */
+
+static devmap_snapshot *snapshot_copy (devmap_snapshot *src, unsigned extra)
+{
+  const char *key;
+  devmap_snapshot *dst = malloc (sizeof (devmap_snapshot));
+  edgex_map_init (&dst->devices);
+  edgex_map_init (&dst->byname);
+  edgex_map_init (&dst->byprofile);
+  edgex_map_init (&dst->bylabel);
+  edgex_map_init (&dst->byprotocol);
+  edgex_map_init (&dst->getcmds);
+  edgex_map_init (&dst->setcmds);
+  if (src)
+  {
+    edgex_map_reserve (&dst->devices, edgex_map_size (&src->devices) + extra);
+    edgex_map_reserve (&dst->byname, edgex_map_size (&src->byname) + extra);
+    edgex_map_iter i = edgex_map_iter (src->devices);
+    while ((key = edgex_map_next (&src->devices, &i)))
+    {
+      edgex_device *dev = snapshot_device (&src->devices, key);
+      edgex_map_set (&dst->devices, dev->id, dev);
+      edgex_map_set (&dst->byname, dev->name, dev);
+    }
+  }
+  return dst;
+}
+
+static void cmdtargets_free (edgex_map_cmdtarget *m)
+{
+  const char *key;
+  edgex_map_iter i = edgex_map_iter (*m);
+  while ((key = edgex_map_next (m, &i)))
+  {
+    devmap_cmdtarget *t = snapshot_cmdtargets (m, key);
+    while (t)
+    {
+      devmap_cmdtarget *next = t->next;
+      free (t);
+      t = next;
+    }
+  }
+  edgex_map_deinit (m);
+}
+
+static void devlists_free (edgex_map_devlist *m)
+{
+  const char *key;
+  edgex_map_iter i = edgex_map_iter (*m);
+  while ((key = edgex_map_next (m, &i)))
+  {
+    free (edgex_map_get (m, key)->devices);
+  }
+  edgex_map_deinit (m);
+}
+
+static void snapshot_free (devmap_snapshot *s)
+{
+  devlists_free (&s->byprofile);
+  devlists_free (&s->bylabel);
+  devlists_free (&s->byprotocol);
+  cmdtargets_free (&s->getcmds);
+  cmdtargets_free (&s->setcmds);
+  edgex_map_deinit (&s->devices);
+  edgex_map_deinit (&s->byname);
+  free (s);
+}
+
+/*
+ * Indexes are built in two passes over the devices, first counting the
+ * members of each group and then filling them, so that each group is a
+ * single allocation.
+ */
+
+static void devlist_count (edgex_map_devlist *m, const char *key, edgex_deviceprofile *profile)
+{
+  devmap_devlist *l = edgex_map_get (m, key);
+  if (l)
+  {
+    l->count++;
+  }
+  else
+  {
+    devmap_devlist newl = { .profile = profile, .count = 1, .devices = NULL };
+    edgex_map_set (m, key, newl);
+  }
+}
+
+static void devlist_fill (edgex_map_devlist *m, const char *key, edgex_device *dev)
+{
+  devmap_devlist *l = edgex_map_get (m, key);
+  if (l->devices == NULL)
+  {
+    l->devices = malloc (l->count * sizeof (edgex_device *));
+    l->count = 0;
+  }
+  l->devices[l->count++] = dev;
+}
+
+/* Protocol index keys join the protocol, property and value with a separator which will not appear in them */
+
+static char *protocol_key (const char *protocol, const char *property, const char *value)
+{
+  size_t sz = strlen (protocol) + strlen (property) + strlen (value) + 3;
+  char *key = malloc (sz);
+  snprintf (key, sz, "%s\x1f%s\x1f%s", protocol, property, value);
+  return key;
+}
+
+/* Add a device to, or count it in, each of the groups it belongs to */
+
+static void snapshot_index_device (devmap_snapshot *s, edgex_device *dev, bool fill)
+{
+  if (fill)
+  {
+    devlist_fill (&s->byprofile, dev->profile->name, dev);
+  }
+  else
+  {
+    devlist_count (&s->byprofile, dev->profile->name, dev->profile);
+  }
+  for (const edgex_strings *l = dev->labels; l; l = l->next)
+  {
+    if (fill)
+    {
+      devlist_fill (&s->bylabel, l->str, dev);
+    }
+    else
+    {
+      devlist_count (&s->bylabel, l->str, NULL);
+    }
+  }
+  for (const edgex_protocols *p = dev->protocols; p; p = p->next)
+  {
+    for (const edgex_nvpairs *nv = p->properties; nv; nv = nv->next)
+    {
+      char *key = protocol_key (p->name, nv->name, nv->value);
+      if (fill)
+      {
+        devlist_fill (&s->byprotocol, key, dev);
+      }
+      else
+      {
+        devlist_count (&s->byprotocol, key, NULL);
+      }
+      free (key);
+    }
+  }
+}
+
+static void cmdtarget_add
+  (edgex_map_cmdtarget *m, const char *name, const edgex_cmdinfo *cmd, const devmap_devlist *pd)
+{
+  devmap_cmdtarget *t = malloc (sizeof (devmap_cmdtarget));
+  t->cmd = cmd;
+  t->profdevs = pd;
+  t->next = snapshot_cmdtargets (m, name);
+  edgex_map_set (m, name, t);
+}
+
+/* Build the indexes of an unpublished snapshot */
+
+static void snapshot_index (devmap_snapshot *s)
+{
+  const char *key;
+  devmap_devlist *pd;
+  edgex_map_iter i;
+
+  for (int fill = 0; fill < 2; fill++)
+  {
+    i = edgex_map_iter (s->devices);
+    while ((key = edgex_map_next (&s->devices, &i)))
+    {
+      snapshot_index_device (s, snapshot_device (&s->devices, key), fill);
+    }
+  }
+
+  /*
+   * List the commands of each profile in use, taking them from the profile's
+   * own index so that duplicate names resolve as in findcommand. The map
+   * holds its values in place, so pd remains valid. Profiles are shared
+   * between shards which may be indexed at once, so their indexes are read
+   * without edgex_map_get.
+   */
+
+  i = edgex_map_iter (s->byprofile);
+  while ((key = edgex_map_next (&s->byprofile, &i)))
+  {
+    const char *name;
+    pd = edgex_map_get (&s->byprofile, key);
+    edgex_cmdindex *index = pd->profile->cmdindex;
+    edgex_map_iter ci = edgex_map_iter (index->map);
+    while ((name = edgex_map_next (&index->map, &ci)))
+    {
+      const edgex_cmdpair *pair = edgex_map_get_ (&index->map.base, name);
+      if (pair->get)
+      {
+        cmdtarget_add (&s->getcmds, name, pair->get, pd);
+      }
+      if (pair->set)
+      {
+        cmdtarget_add (&s->setcmds, name, pair->set, pd);
+      }
+    }
+  }
+}
+
+/*
+ * Sizes of device and profile records for accounting: the structures and
+ * strings they own, not counting interned strings such as labels, or the
+ * compiled command information of profiles.
+ */
+
+static size_t nvpairs_footprint (const edgex_nvpairs *p)
+{
+  size_t result = 0;
+  for (; p; p = p->next)
+  {
+    result += sizeof (edgex_nvpairs) + strlen (p->name) + strlen (p->value) + 2;
+  }
+  return result;
+}
+
+static size_t device_footprint (const edgex_device *d)
+{
+  size_t result = sizeof (edgex_device) + sizeof (edgex_deviceservice) +
+    strlen (d->name) + strlen (d->id) + strlen (d->description) + 3;
+  for (const edgex_strings *l = d->labels; l; l = l->next)
+  {
+    result += sizeof (edgex_strings);
+  }
+  for (const edgex_protocols *p = d->protocols; p; p = p->next)
+  {
+    result += sizeof (edgex_protocols) + strlen (p->name) + 1 + nvpairs_footprint (p->properties);
+  }
+  for (const edgex_device_autoevents *a = d->autos; a; a = a->next)
+  {
+    result += sizeof (edgex_device_autoevents) + strlen (a->resource) + strlen (a->frequency) + 2;
+  }
+  return result;
+}
+
+static size_t profile_footprint (const edgex_deviceprofile *p)
+{
+  size_t result = sizeof (edgex_deviceprofile) + strlen (p->name) + 1;
+  for (const edgex_deviceresource *r = p->device_resources; r; r = r->next)
+  {
+    result += sizeof (edgex_deviceresource) + sizeof (edgex_profileproperty) + strlen (r->name) + 1;
+    result += nvpairs_footprint (r->attributes);
+  }
+  for (const edgex_devicecommand *c = p->device_commands; c; c = c->next)
+  {
+    result += sizeof (edgex_devicecommand) + strlen (c->name) + 1;
+  }
+  return result;
+}
+
+/*
+ * An update makes working copies of the snapshots of the shards it changes,
+ * whose mutexes it holds, and publishes them together. The devices it adds
+ * are started, and those it removes retired, once they are published.
+ */
+
+typedef struct devmap_action
+{
+  edgex_device *added;
+  edgex_device *olddev;
+  bool keepautos;
+} devmap_action;
+
+typedef struct devmap_work
+{
+  devmap_snapshot *snaps[DEVMAP_SHARDS];
+  unsigned extra[DEVMAP_SHARDS];
+  devmap_action *actions;
+  unsigned nactions;
+  unsigned size;
+} devmap_work;
+
+static void work_init (devmap_work *w)
+{
+  memset (w, 0, sizeof (devmap_work));
+}
+
+/* A shard as seen by the update: its working copy if it has one */
+
+static devmap_snapshot *work_view (edgex_devmap_t *map, devmap_work *w, unsigned n)
+{
+  return w->snaps[n] ? w->snaps[n] : shard_current (&map->shards[n]);
+}
+
+/* The working copy of a shard, made on first use with room for the devices the update expects to add */
+
+static devmap_snapshot *work_copy (edgex_devmap_t *map, devmap_work *w, unsigned n)
+{
+  if (w->snaps[n] == NULL)
+  {
+    w->snaps[n] = snapshot_copy (shard_current (&map->shards[n]), w->extra[n]);
+  }
+  return w->snaps[n];
+}
+
+static void work_action (devmap_work *w, edgex_device *added, edgex_device *olddev, bool keepautos)
+{
+  if (w->nactions == w->size)
+  {
+    w->size = w->size ? w->size * 2 : 4;
+    w->actions = realloc (w->actions, w->size * sizeof (devmap_action));
+  }
+  w->actions[w->nactions].added = added;
+  w->actions[w->nactions].olddev = olddev;
+  w->actions[w->nactions++].keepautos = keepautos;
+}
+
+/* The shard in the update's view holding the device with the given id, or -1 */
+
+static int work_holding (edgex_devmap_t *map, devmap_work *w, const char *id, edgex_device **dev)
+{
+  for (unsigned n = 0; n < DEVMAP_SHARDS; n++)
+  {
+    *dev = snapshot_device (&work_view (map, w, n)->devices, id);
+    if (*dev)
+    {
+      return n;
+    }
+  }
+  return -1;
+}
+
+static void snapshot_retire (void *p)
+{
+  snapshot_free ((devmap_snapshot *)p);
+}
+
+static void device_retire (void *p)
+{
+  edgex_device_release ((edgex_device *)p);
+}
+
+/* Discard state kept elsewhere under the name of a device which is being removed or renamed */
+
+static void device_forget (edgex_devmap_t *map, const edgex_device *dev)
+{
+  if (map->svc && map->svc->readcache)
+  {
+    edgex_readcache_evict (map->svc->readcache, dev->name);
+  }
+  if (map->svc && map->svc->aecircuit)
+  {
+    edgex_circuit_remove (map->svc->aecircuit, dev->name);
+  }
+  if (map->svc && map->svc->latency)
+  {
+    edgex_latency_evict (map->svc->latency, dev->name);
+  }
+}
+
+/*
+ * Publish the working copies, retiring the snapshots they replace, and carry
+ * out the actions of the update. Returns whether any device was retired, in
+ * which case the caller waits for it to be released once it has unlocked.
+ */
+
+static bool work_publish (edgex_devmap_t *map, devmap_work *w)
+{
+  bool retired = false;
+
+  for (unsigned n = 0; n < DEVMAP_SHARDS; n++)
+  {
+    if (w->snaps[n])
+    {
+      snapshot_index (w->snaps[n]);
+      edgex_epoch_retire (snapshot_retire, atomic_exchange (&map->shards[n].current, w->snaps[n]));
+    }
+  }
+  for (unsigned i = 0; i < w->nactions; i++)
+  {
+    devmap_action *a = &w->actions[i];
+    if (a->keepautos)
+    {
+      /* The autoevent lists are equal, so exchanging them moves the running autoevents to the new record */
+
+      edgex_device_autoevents *autos = a->added->autos;
+      a->added->autos = a->olddev->autos;
+      a->olddev->autos = autos;
+    }
+    else if (a->added)
+    {
+      edgex_device_autoevent_start (map->svc, a->added);
+    }
+    if (a->olddev)
+    {
+      if (a->added == NULL || strcmp (a->added->name, a->olddev->name))
+      {
+        device_forget (map, a->olddev);
+      }
+      edgex_epoch_retire (device_retire, a->olddev);
+      retired = true;
+    }
+  }
+  free (w->actions);
+  return retired;
+}
+
+static void lock_all (edgex_devmap_t *map)
+{
+  for (unsigned n = 0; n < DEVMAP_SHARDS; n++)
+  {
+    pthread_mutex_lock (&map->shards[n].lock);
+  }
+}
+
+static void unlock_all (edgex_devmap_t *map)
+{
+  for (unsigned n = 0; n < DEVMAP_SHARDS; n++)
+  {
+    pthread_mutex_unlock (&map->shards[n].lock);
+  }
+}
+
+/* Lock two shards in order. Either may be NULL, or they may be the same */
+
+static void lock_pair (devmap_shard *a, devmap_shard *b)
+{
+  if (a && b && a != b)
+  {
+    pthread_mutex_lock (a < b ? &a->lock : &b->lock);
+    pthread_mutex_lock (a < b ? &b->lock : &a->lock);
+  }
+  else if (a || b)
+  {
+    pthread_mutex_lock (a ? &a->lock : &b->lock);
+  }
+}
+
+static void unlock_pair (devmap_shard *a, devmap_shard *b)
+{
+  if (a)
+  {
+    pthread_mutex_unlock (&a->lock);
+  }
+  if (b && b != a)
+  {
+    pthread_mutex_unlock (&b->lock);
+  }
+}
+
+/* The shard currently holding the device with the given id, if any. Called within a read section */
+
+static devmap_shard *shard_holding (edgex_devmap_t *map, const char *id, edgex_device **dev)
+{
+  for (unsigned i = 0; i < DEVMAP_SHARDS; i++)
+  {
+    *dev = snapshot_device (&shard_current (&map->shards[i])->devices, id);
+    if (*dev)
+    {
+      return &map->shards[i];
+    }
+  }
+  return NULL;
+}
+
+/*
+ * Lock the shard holding the device with the given id, and return it with
+ * the device; or NULL if there is none. A device may move between shards if
+ * it is renamed, so its shard is checked again once locked.
+ */
+
+static devmap_shard *lock_byid (edgex_devmap_t *map, const char *id, edgex_device **dev)
+{
+  devmap_shard *sh;
+  while (true)
+  {
+    edgex_epoch_enter ();
+    sh = shard_holding (map, id, dev);
+    edgex_epoch_exit ();
+    if (sh == NULL)
+    {
+      return NULL;
+    }
+    pthread_mutex_lock (&sh->lock);
+    *dev = snapshot_device (&shard_current (sh)->devices, id);
+    if (*dev)
+    {
+      return sh;
+    }
+    pthread_mutex_unlock (&sh->lock);
+  }
+}
+
+static void profiles_retire (void *p)
+{
+  edgex_map_profile *m = (edgex_map_profile *)p;
+  edgex_map_deinit (m);
+  free (m);
+}
+
+/*
+ * Return the profile held with the name of dp, which is freed, or if there
+ * is none add dp (compiling it if need be) and return it. The map replaced is
+ * retired, to be reclaimed by the caller once any shard mutex is released.
+ */
+
+static edgex_deviceprofile *profile_intern (edgex_devmap_t *map, edgex_deviceprofile *dp)
 {
-  pthread_rwlockattr_t rwatt;
-  pthread_rwlockattr_init (&rwatt);
-#ifdef  __GLIBC_PREREQ
-#if __GLIBC_PREREQ(2, 1)
-  /* Avoid heavy readlock use (eg spammed "all" commands) blocking updates */
-  pthread_rwlockattr_setkind_np
-    (&rwatt, PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP);
-#endif
-#endif
+  const char *key;
+  edgex_map_profile *old;
+  edgex_map_profile *m;
+  edgex_deviceprofile *existing;
+
+  pthread_mutex_lock (&map->proflock);
+  old = atomic_load (&map->profiles);
+  existing = snapshot_profile (old, dp->name);
+  if (existing)
+  {
+    pthread_mutex_unlock (&map->proflock);
+    edgex_deviceprofile_free (dp);
+    return existing;
+  }
+  edgex_deviceprofile_compile (map->svc, dp);
+  m = malloc (sizeof (edgex_map_profile));
+  edgex_map_init (m);
+  edgex_map_reserve (m, edgex_map_size (old) + 1);
+  edgex_map_iter i = edgex_map_iter (*old);
+  while ((key = edgex_map_next (old, &i)))
+  {
+    edgex_map_set (m, key, snapshot_profile (old, key));
+  }
+  edgex_map_set (m, dp->name, dp);
+  edgex_memstats_alloc (EDGEX_MEM_DEVMAP, profile_footprint (dp));
+  atomic_store (&map->profiles, m);
+  edgex_epoch_retire (profiles_retire, old);
+  pthread_mutex_unlock (&map->proflock);
+  return dp;
+}
 
+edgex_devmap_t *edgex_devmap_alloc (edgex_device_service *svc)
+{
   edgex_devmap_t *res = malloc (sizeof (edgex_devmap_t));
-  pthread_rwlock_init (&res->lock, &rwatt);
-  pthread_rwlockattr_destroy (&rwatt);
-  edgex_map_init (&res->devices);
-  edgex_map_init (&res->name_to_id);
-  edgex_map_init (&res->profiles);
+  edgex_map_profile *profiles = malloc (sizeof (edgex_map_profile));
+  for (unsigned i = 0; i < DEVMAP_SHARDS; i++)
+  {
+    pthread_mutex_init (&res->shards[i].lock, NULL);
+    atomic_init (&res->shards[i].current, snapshot_copy (NULL, 0));
+  }
+  edgex_map_init (profiles);
+  pthread_mutex_init (&res->proflock, NULL);
+  atomic_init (&res->profiles, profiles);
   res->svc = svc;
   return res;
 }
@@ -55,66 +697,172 @@ edgex_devmap_t *edgex_devmap_alloc (edgex_device_service *svc)
 void edgex_devmap_clear (edgex_devmap_t *map)
 {
   const char *key;
-  const char *next;
-  edgex_map_iter i = edgex_map_iter (map->devices);
-  key = edgex_map_next (&map->devices, &i);
-  while (key)
+
+  /* Unpublish the devices of every shard, and release them once their readers have finished */
+
+  lock_all (map);
+  for (unsigned n = 0; n < DEVMAP_SHARDS; n++)
   {
-    edgex_device **e = edgex_map_get (&map->devices, key);
-    edgex_device_release (*e);
-    next = edgex_map_next (&map->devices, &i);
-    edgex_map_remove (&map->devices, key);
-    key = next;
+    devmap_snapshot *old = atomic_exchange (&map->shards[n].current, snapshot_copy (NULL, 0));
+    edgex_map_iter i = edgex_map_iter (old->devices);
+    while ((key = edgex_map_next (&old->devices, &i)))
+    {
+      edgex_epoch_retire (device_retire, snapshot_device (&old->devices, key));
+    }
+    edgex_epoch_retire (snapshot_retire, old);
   }
+  unlock_all (map);
+  edgex_epoch_reclaim (true);
 }
 
 void edgex_devmap_free (edgex_devmap_t *map)
 {
   const char *key;
-  edgex_map_deinit (&map->name_to_id);
-  edgex_map_deinit (&map->devices);
-  edgex_map_iter i = edgex_map_iter (map->profiles);
-  while ((key = edgex_map_next (&map->profiles, &i)))
+  edgex_map_profile *profiles;
+
+  edgex_epoch_reclaim (true);
+  profiles = atomic_load (&map->profiles);
+  edgex_map_iter i = edgex_map_iter (*profiles);
+  while ((key = edgex_map_next (profiles, &i)))
+  {
+    edgex_deviceprofile *p = snapshot_profile (profiles, key);
+    edgex_memstats_free (EDGEX_MEM_DEVMAP, profile_footprint (p));
+    edgex_deviceprofile_free (p);
+  }
+  edgex_map_deinit (profiles);
+  free (profiles);
+  for (unsigned n = 0; n < DEVMAP_SHARDS; n++)
   {
-    edgex_deviceprofile **p = edgex_map_get (&map->profiles, key);
-    edgex_deviceprofile_free (*p);
+    snapshot_free (atomic_load (&map->shards[n].current));
+    pthread_mutex_destroy (&map->shards[n].lock);
   }
-  edgex_map_deinit (&map->profiles);
-  pthread_rwlock_destroy (&map->lock);
+  pthread_mutex_destroy (&map->proflock);
   free (map);
 }
 
-static void add_locked (edgex_devmap_t *map, const edgex_device *newdev)
+/* The devmap's own records hold the strings which recur across devices interned */
+
+static char *devmap_intern (char *str)
+{
+  char *result = (char *)edgex_intern (str);
+  free (str);
+  return result;
+}
+
+static void device_intern (edgex_device *dev)
 {
-  edgex_device *dup = edgex_device_dup (newdev);
-  atomic_store (&dup->refs, 1);
-  edgex_deviceprofile **pp = edgex_map_get (&map->profiles, dup->profile->name);
-  if (pp)
+  for (edgex_strings *l = dev->labels; l; l = l->next)
   {
-    edgex_deviceprofile_free (dup->profile);
-    dup->profile = *pp;
+    l->str = devmap_intern (l->str);
   }
-  else
+  for (edgex_protocols *p = dev->protocols; p; p = p->next)
+  {
+    p->name = devmap_intern (p->name);
+    for (edgex_nvpairs *nv = p->properties; nv; nv = nv->next)
+    {
+      nv->name = devmap_intern (nv->name);
+    }
+  }
+  for (edgex_device_autoevents *a = dev->autos; a; a = a->next)
   {
-    edgex_map_set (&map->profiles, dup->profile->name, dup->profile);
+    a->resource = devmap_intern (a->resource);
+    a->frequency = devmap_intern (a->frequency);
   }
-  edgex_map_set (&map->devices, dup->id, dup);
-  edgex_map_set (&map->name_to_id, dup->name, dup->id);
-  edgex_device_autoevent_start (map->svc, dup);
+}
+
+/* Release the interned strings of a record, leaving the rest for edgex_device_free */
+
+static void device_unintern (edgex_device *dev)
+{
+  for (edgex_strings *l = dev->labels; l; l = l->next)
+  {
+    edgex_intern_release (l->str);
+    l->str = NULL;
+  }
+  for (edgex_protocols *p = dev->protocols; p; p = p->next)
+  {
+    edgex_intern_release (p->name);
+    p->name = NULL;
+    for (edgex_nvpairs *nv = p->properties; nv; nv = nv->next)
+    {
+      edgex_intern_release (nv->name);
+      nv->name = NULL;
+    }
+  }
+  for (edgex_device_autoevents *a = dev->autos; a; a = a->next)
+  {
+    edgex_intern_release (a->resource);
+    edgex_intern_release (a->frequency);
+    a->resource = NULL;
+    a->frequency = NULL;
+  }
+}
+
+/* Add a copy of a device to an unpublished snapshot. Its autoevents are started once it is published */
+
+static edgex_device *add_locked (edgex_devmap_t *map, devmap_snapshot *s, const edgex_device *newdev)
+{
+  edgex_device *dup = edgex_device_dup (newdev);
+  device_intern (dup);
+  atomic_store (&dup->refs, 1);
+  dup->profile = profile_intern (map, dup->profile);
+  edgex_memstats_alloc (EDGEX_MEM_DEVMAP, device_footprint (dup));
+  edgex_map_set (&s->devices, dup->id, dup);
+  edgex_map_set (&s->byname, dup->name, dup);
+  return dup;
 }
 
 void edgex_devmap_populate_devices
   (edgex_devmap_t *map, const edgex_device *devs)
 {
-  pthread_rwlock_wrlock (&map->lock);
+  edgex_devmap_add_devices (map, devs, NULL);
+}
+
+/* The shards with devices to add are locked in order, and those which gain devices published together */
+
+unsigned edgex_devmap_add_devices
+  (edgex_devmap_t *map, const edgex_device *devs, bool *added)
+{
+  devmap_work w;
+  unsigned nadded = 0;
+  bool retired;
+
+  work_init (&w);
+  for (const edgex_device *d = devs; d; d = d->next)
+  {
+    w.extra[shard_index (d->name)]++;
+  }
+  for (unsigned n = 0; n < DEVMAP_SHARDS; n++)
+  {
+    if (w.extra[n])
+    {
+      pthread_mutex_lock (&map->shards[n].lock);
+    }
+  }
   for (const edgex_device *d = devs; d; d = d->next)
   {
-    if (edgex_map_get (&map->name_to_id, d->name) == NULL)
+    unsigned n = shard_index (d->name);
+    bool new = (snapshot_device (&work_view (map, &w, n)->byname, d->name) == NULL);
+    if (new)
+    {
+      work_action (&w, add_locked (map, work_copy (map, &w, n), d), NULL, false);
+      nadded++;
+    }
+    if (added)
+    {
+      *added++ = new;
+    }
+  }
+  retired = work_publish (map, &w);
+  for (unsigned n = 0; n < DEVMAP_SHARDS; n++)
+  {
+    if (w.extra[n])
     {
-      add_locked (map, d);
+      pthread_mutex_unlock (&map->shards[n].lock);
     }
   }
-  pthread_rwlock_unlock (&map->lock);
+  edgex_epoch_reclaim (retired);
+  return nadded;
 }
 
 edgex_device *edgex_devmap_copydevices (edgex_devmap_t *map)
@@ -122,16 +870,34 @@ edgex_device *edgex_devmap_copydevices (edgex_devmap_t *map)
   edgex_device *result = NULL;
   edgex_device *dup;
   const char *key;
+  devmap_snapshot *s;
 
-  pthread_rwlock_rdlock (&map->lock);
-  edgex_map_iter iter = edgex_map_iter (map->devices);
-  while ((key = edgex_map_next (&map->devices, &iter)))
+  edgex_epoch_enter ();
+  for (unsigned n = 0; n < DEVMAP_SHARDS; n++)
   {
-    dup = edgex_device_dup (*edgex_map_get (&map->devices, key));
-    dup->next = result;
-    result = dup;
+    s = shard_current (&map->shards[n]);
+    edgex_map_iter iter = edgex_map_iter (s->devices);
+    while ((key = edgex_map_next (&s->devices, &iter)))
+    {
+      dup = edgex_device_dup (snapshot_device (&s->devices, key));
+      dup->next = result;
+      result = dup;
+    }
+  }
+  edgex_epoch_exit ();
+  return result;
+}
+
+unsigned edgex_devmap_size (edgex_devmap_t *map)
+{
+  unsigned result = 0;
+
+  edgex_epoch_enter ();
+  for (unsigned n = 0; n < DEVMAP_SHARDS; n++)
+  {
+    result += edgex_map_size (&shard_current (&map->shards[n])->devices);
   }
-  pthread_rwlock_unlock (&map->lock);
+  edgex_epoch_exit ();
   return result;
 }
 
@@ -140,49 +906,74 @@ edgex_deviceprofile *edgex_devmap_copyprofiles (edgex_devmap_t *map)
   edgex_deviceprofile *result = NULL;
   edgex_deviceprofile *dup;
   const char *key;
+  edgex_map_profile *profiles;
 
-  pthread_rwlock_rdlock (&map->lock);
-  edgex_map_iter iter = edgex_map_iter (map->profiles);
-  while ((key = edgex_map_next (&map->profiles, &iter)))
+  edgex_epoch_enter ();
+  profiles = atomic_load (&map->profiles);
+  edgex_map_iter iter = edgex_map_iter (*profiles);
+  while ((key = edgex_map_next (profiles, &iter)))
   {
-    dup = edgex_deviceprofile_dup (*edgex_map_get (&map->profiles, key));
+    dup = edgex_deviceprofile_dup (snapshot_profile (profiles, key));
     dup->next = result;
     result = dup;
   }
-  pthread_rwlock_unlock (&map->lock);
+  edgex_epoch_exit ();
   return result;
 }
 
 const edgex_deviceprofile *edgex_devmap_profile
   (edgex_devmap_t *map, const char *name)
 {
-  edgex_deviceprofile **dpp;
-  pthread_rwlock_rdlock (&map->lock);
-  dpp = edgex_map_get (&map->profiles, name);
-  pthread_rwlock_unlock (&map->lock);
-  return dpp ? *dpp : NULL;
+  edgex_deviceprofile *result;
+
+  edgex_epoch_enter ();
+  result = snapshot_profile (atomic_load (&map->profiles), name);
+  edgex_epoch_exit ();
+  return result;
+}
+
+static void remove_locked (devmap_snapshot *s, edgex_device *olddev)
+{
+  edgex_map_remove (&s->byname, olddev->name);
+  edgex_map_remove (&s->devices, olddev->id);
 }
 
-static void remove_locked (edgex_devmap_t *map, edgex_device *olddev)
+/* Remove a device held in shard n from the update, and retire it */
+
+static void remove_work (edgex_devmap_t *map, devmap_work *w, unsigned n, edgex_device *olddev)
 {
-  edgex_map_remove (&map->name_to_id, olddev->name);
-  edgex_map_remove (&map->devices, olddev->id);
-  edgex_device_release (olddev);
+  remove_locked (work_copy (map, w, n), olddev);
+  work_action (w, NULL, olddev, false);
+}
+
+static bool strings_equal (const edgex_strings *a, const edgex_strings *b)
+{
+  while (a && b && strcmp (a->str, b->str) == 0)
+  {
+    a = a->next;
+    b = b->next;
+  }
+  return a == NULL && b == NULL;
 }
 
 /* Update a device, but fail if there could be effects on autoevents or
- * operations in progress. For such attempts we will remove the device and
- * add a new one.
+ * operations in progress, or on the indexes. For such attempts we will
+ * remove the device and add a new one. Only scalar fields are updated in
+ * place, so the strings of a device record may be read by any holder.
+ * If only the description or labels differ, keepautos is set: the new
+ * record may take over the running autoevents of the old one.
  */
 
-static bool update_in_place (edgex_device *dest, const edgex_device *src, edgex_devmap_outcome_t *outcome)
+static bool update_in_place
+  (edgex_device *dest, const edgex_device *src, edgex_devmap_outcome_t *outcome, bool *keepautos)
 {
-  if (!edgex_protocols_equal (dest->protocols, src->protocols))
+  *keepautos = false;
+  if (strcmp (dest->name, src->name))
   {
     *outcome = UPDATED_DRIVER;
     return false;
   }
-  if (strcmp (dest->name, src->name))
+  if (!edgex_protocols_equal (dest->protocols, src->protocols))
   {
     *outcome = UPDATED_DRIVER;
     return false;
@@ -200,136 +991,425 @@ static bool update_in_place (edgex_device *dest, const edgex_device *src, edgex_
   {
     return false;
   }
+  if (strcmp (dest->description, src->description) || !strings_equal (dest->labels, src->labels))
+  {
+    *keepautos = true;
+    return false;
+  }
   dest->operatingState = src->operatingState;
   dest->created = src->created;
   dest->lastConnected = src->lastConnected;
   dest->lastReported = src->lastReported;
   dest->modified = src->modified;
   dest->origin = src->origin;
-  free (dest->description);
-  dest->description = strdup (src->description);
-  edgex_strings_free (dest->labels);
-  dest->labels = edgex_strings_dup (src->labels);
 
   return true;
 }
 
-edgex_devmap_outcome_t edgex_devmap_replace_device (edgex_devmap_t *map, const edgex_device *dev)
+/*
+ * Replace, or add, the device with the id of dev in shard to, for its name.
+ * olddev is the device held with that id, if any, in shard from. The mutexes
+ * of both are held.
+ */
+
+static edgex_devmap_outcome_t replace_work
+  (edgex_devmap_t *map, devmap_work *w, int from, edgex_device *olddev, unsigned to, const edgex_device *dev)
 {
-  edgex_device **olddev;
   edgex_devmap_outcome_t result = UPDATED_SDK;
+  bool keepautos = false;
 
-  pthread_rwlock_wrlock (&map->lock);
-  olddev = edgex_map_get (&map->devices, dev->id);
-  if (olddev == NULL)
+  if (olddev && update_in_place (olddev, dev, &result, &keepautos))
   {
-    add_locked (map, dev);
-    result = CREATED;
+    return result;
+  }
+  if (olddev)
+  {
+    remove_locked (work_copy (map, w, from), olddev);
   }
   else
   {
-    if (!update_in_place (*olddev, dev, &result))
+    result = CREATED;
+  }
+  work_action (w, add_locked (map, work_copy (map, w, to), dev), olddev, keepautos);
+  return result;
+}
+
+/*
+ * The device is placed in the shard for its name, and the one it replaces
+ * may be held in another if it is renamed. Both shards are locked, and the
+ * lookup by id repeated if the device moved before they were.
+ */
+
+edgex_devmap_outcome_t edgex_devmap_replace_device (edgex_devmap_t *map, const edgex_device *dev)
+{
+  edgex_devmap_outcome_t result;
+  devmap_shard *to = shard_for (map, dev->name);
+  devmap_shard *from;
+  edgex_device *olddev;
+  devmap_work w;
+  bool retired;
+
+  while (true)
+  {
+    edgex_epoch_enter ();
+    from = shard_holding (map, dev->id, &olddev);
+    edgex_epoch_exit ();
+    lock_pair (from, to);
+    if (from == NULL)
     {
-      remove_locked (map, *olddev);
-      add_locked (map, dev);
+      olddev = snapshot_device (&shard_current (to)->devices, dev->id);
+      from = olddev ? to : NULL;
+      break;
     }
+    olddev = snapshot_device (&shard_current (from)->devices, dev->id);
+    if (olddev)
+    {
+      break;
+    }
+    unlock_pair (from, to);
   }
-  pthread_rwlock_unlock (&map->lock);
+  work_init (&w);
+  w.extra[to - map->shards] = 1;
+  result = replace_work (map, &w, from ? from - map->shards : -1, olddev, to - map->shards, dev);
+  retired = work_publish (map, &w);
+  unlock_pair (from, to);
+  edgex_epoch_reclaim (retired);
   return result;
 }
 
+/* All of the shards are locked, as the devices may be in any of them */
+
+void edgex_devmap_replace_devices
+  (edgex_devmap_t *map, const edgex_device *devs, edgex_devmap_outcome_t *outcomes)
+{
+  devmap_work w;
+  bool retired;
+
+  work_init (&w);
+  for (const edgex_device *d = devs; d; d = d->next)
+  {
+    w.extra[shard_index (d->name)]++;
+  }
+  lock_all (map);
+  for (const edgex_device *d = devs; d; d = d->next)
+  {
+    edgex_device *olddev;
+    int from = work_holding (map, &w, d->id, &olddev);
+    *outcomes++ = replace_work (map, &w, from, olddev, shard_index (d->name), d);
+  }
+  retired = work_publish (map, &w);
+  unlock_all (map);
+  edgex_epoch_reclaim (retired);
+}
+
+/*
+ * States are updated in place. A new description or labels need a new
+ * record, which is made from the one held with those fields substituted.
+ */
+
+bool edgex_devmap_update_device
+  (edgex_devmap_t *map, const char *id, const edgex_device_changes *changes, edgex_devmap_outcome_t *outcome)
+{
+  edgex_device *olddev;
+  devmap_work w;
+  bool retired;
+  devmap_shard *sh = lock_byid (map, id, &olddev);
+
+  if (sh == NULL)
+  {
+    return false;
+  }
+  work_init (&w);
+  *outcome = UPDATED_SDK;
+  if (changes->hasAdminState && olddev->adminState != changes->adminState)
+  {
+    olddev->adminState = changes->adminState;
+    *outcome = UPDATED_DRIVER;
+  }
+  if (changes->hasOperatingState)
+  {
+    olddev->operatingState = changes->operatingState;
+  }
+  if
+  (
+    (changes->description && strcmp (changes->description, olddev->description)) ||
+    (changes->hasLabels && !strings_equal (changes->labels, olddev->labels))
+  )
+  {
+    edgex_device updated = *olddev;
+    updated.next = NULL;
+    if (changes->description)
+    {
+      updated.description = changes->description;
+    }
+    if (changes->hasLabels)
+    {
+      updated.labels = changes->labels;
+    }
+    w.extra[sh - map->shards] = 1;
+    replace_work (map, &w, sh - map->shards, olddev, sh - map->shards, &updated);
+  }
+  retired = work_publish (map, &w);
+  pthread_mutex_unlock (&sh->lock);
+  edgex_epoch_reclaim (retired);
+  return true;
+}
+
+bool edgex_devmap_set_opstate (edgex_devmap_t *map, const char *id, edgex_device_operatingstate opstate)
+{
+  edgex_device *dev;
+  bool changed;
+  devmap_shard *sh = lock_byid (map, id, &dev);
+
+  if (sh == NULL)
+  {
+    return false;
+  }
+  changed = (dev->operatingState != opstate);
+  dev->operatingState = opstate;
+  pthread_mutex_unlock (&sh->lock);
+  return changed;
+}
+
 edgex_device *edgex_devmap_device_byid (edgex_devmap_t *map, const char *id)
 {
-  edgex_device **dev;
-  edgex_device *result = NULL;
+  edgex_device *result;
+  uint64_t start = edgex_trace_start ();
 
-  pthread_rwlock_rdlock (&map->lock);
-  dev = edgex_map_get (&map->devices, id);
-  if (dev)
+  edgex_epoch_enter ();
+  if (shard_holding (map, id, &result))
   {
-    result = *dev;
     atomic_fetch_add (&result->refs, 1);
   }
-  pthread_rwlock_unlock (&map->lock);
+  edgex_epoch_exit ();
+  edgex_trace_span (EDGEX_TRACE_LOOKUP, start);
   return result;
 }
 
 edgex_device *edgex_devmap_device_byname (edgex_devmap_t *map, const char *name)
 {
-  char **id;
-  edgex_device *result = NULL;
+  edgex_device *result;
+  uint64_t start = edgex_trace_start ();
 
-  pthread_rwlock_rdlock (&map->lock);
-  id = edgex_map_get (&map->name_to_id, name);
-  if (id)
+  edgex_epoch_enter ();
+  result = snapshot_device (&shard_current (shard_for (map, name))->byname, name);
+  if (result)
   {
-    result = *edgex_map_get (&map->devices, *id);
     atomic_fetch_add (&result->refs, 1);
   }
-  pthread_rwlock_unlock (&map->lock);
+  edgex_epoch_exit ();
+  edgex_trace_span (EDGEX_TRACE_LOOKUP, start);
   return result;
 }
 
+void edgex_devmap_devices_bynames
+  (edgex_devmap_t *map, const char * const *names, unsigned n, edgex_device **result)
+{
+  uint64_t start = edgex_trace_start ();
+
+  edgex_epoch_enter ();
+  for (unsigned i = 0; i < n; i++)
+  {
+    result[i] = snapshot_device (&shard_current (shard_for (map, names[i]))->byname, names[i]);
+    if (result[i])
+    {
+      atomic_fetch_add (&result[i]->refs, 1);
+    }
+  }
+  edgex_epoch_exit ();
+  edgex_trace_span (EDGEX_TRACE_LOOKUP, start);
+}
+
 void edgex_devmap_removedevice_byname (edgex_devmap_t *map, const char *name)
 {
-  edgex_device **olddev;
-  char **id;
+  edgex_device *olddev;
+  devmap_work w;
+  bool retired;
+  devmap_shard *sh = shard_for (map, name);
 
-  pthread_rwlock_wrlock (&map->lock);
-  id = edgex_map_get (&map->name_to_id, name);
-  if (id)
+  work_init (&w);
+  pthread_mutex_lock (&sh->lock);
+  olddev = snapshot_device (&shard_current (sh)->byname, name);
+  if (olddev)
   {
-    olddev = edgex_map_get (&map->devices, *id);
-    remove_locked (map, *olddev);
+    remove_work (map, &w, sh - map->shards, olddev);
   }
-  pthread_rwlock_unlock (&map->lock);
+  retired = work_publish (map, &w);
+  pthread_mutex_unlock (&sh->lock);
+  edgex_epoch_reclaim (retired);
 }
 
 void edgex_devmap_removedevice_byid (edgex_devmap_t *map, const char *id)
 {
-  edgex_device **olddev;
-  pthread_rwlock_wrlock (&map->lock);
-  olddev = edgex_map_get (&map->devices, id);
-  remove_locked (map, *olddev);
-  pthread_rwlock_unlock (&map->lock);
+  edgex_device *olddev;
+  devmap_work w;
+  bool retired;
+  devmap_shard *sh = lock_byid (map, id, &olddev);
+
+  if (sh)
+  {
+    work_init (&w);
+    remove_work (map, &w, sh - map->shards, olddev);
+    retired = work_publish (map, &w);
+    pthread_mutex_unlock (&sh->lock);
+    edgex_epoch_reclaim (retired);
+  }
+}
+
+void edgex_devmap_removedevices_byid (edgex_devmap_t *map, const char * const *ids, unsigned n)
+{
+  devmap_work w;
+  bool retired;
+
+  work_init (&w);
+  lock_all (map);
+  for (unsigned i = 0; i < n; i++)
+  {
+    edgex_device *olddev;
+    int sh = work_holding (map, &w, ids[i], &olddev);
+    if (sh >= 0)
+    {
+      remove_work (map, &w, sh, olddev);
+    }
+  }
+  retired = work_publish (map, &w);
+  unlock_all (map);
+  edgex_epoch_reclaim (retired);
 }
 
-void edgex_devmap_add_profile (edgex_devmap_t *map, edgex_deviceprofile *dp)
+/* A profile may be fetched by more than one thread at once; the first to be added is kept */
+
+const edgex_deviceprofile *edgex_devmap_add_profile (edgex_devmap_t *map, edgex_deviceprofile *dp)
 {
-  pthread_rwlock_wrlock (&map->lock);
-  edgex_map_set (&map->profiles, dp->name, dp);
-  pthread_rwlock_unlock (&map->lock);
+  const edgex_deviceprofile *result = profile_intern (map, dp);
+  edgex_epoch_reclaim (false);
+  return result;
 }
 
 edgex_cmdqueue_t *edgex_devmap_device_forcmd
   (edgex_devmap_t *map, const char *cmd, bool forGet)
 {
-  edgex_device *dev;
-  const char *key;
-  const struct edgex_cmdinfo *command;
   edgex_cmdqueue_t *result = NULL;
   edgex_cmdqueue_t *q;
+  devmap_snapshot *s;
 
-  pthread_rwlock_rdlock (&map->lock);
-  edgex_map_iter iter = edgex_map_iter (map->devices);
-  while ((key = edgex_map_next (&map->devices, &iter)))
+  /* Device states may be updated in place, so are checked here rather than when indexing */
+
+  edgex_epoch_enter ();
+  for (unsigned n = 0; n < DEVMAP_SHARDS; n++)
   {
-    dev = *edgex_map_get (&map->devices, key);
-    if (dev->operatingState == ENABLED && dev->adminState == UNLOCKED)
+    s = shard_current (&map->shards[n]);
+    for (devmap_cmdtarget *t = snapshot_cmdtargets (forGet ? &s->getcmds : &s->setcmds, cmd); t; t = t->next)
     {
-      command = edgex_deviceprofile_findcommand (cmd, dev->profile, forGet);
-      if (command)
+      for (unsigned i = 0; i < t->profdevs->count; i++)
       {
-        q = malloc (sizeof (edgex_cmdqueue_t));
-        q->dev = dev;
-        q->cmd = command;
-        q->next = result;
-        result = q;
-        atomic_fetch_add (&dev->refs, 1);
+        edgex_device *dev = t->profdevs->devices[i];
+        if (dev->operatingState == ENABLED && dev->adminState == UNLOCKED)
+        {
+          q = malloc (sizeof (edgex_cmdqueue_t));
+          q->dev = dev;
+          q->cmd = t->cmd;
+          q->next = result;
+          result = q;
+          atomic_fetch_add (&dev->refs, 1);
+        }
       }
     }
   }
-  pthread_rwlock_unlock (&map->lock);
+  edgex_epoch_exit ();
+  return result;
+}
+
+static devmap_devlist *snapshot_devlist (edgex_map_devlist *m, const char *key)
+{
+  return edgex_map_get_ (&m->base, key);
+}
+
+/*
+ * Take a reference on each member of the groups with the given key in the
+ * label or protocol index of every shard, returning them in a NULL-terminated
+ * array, or NULL if there are none. Called within a read section.
+ */
+
+static edgex_device **devlist_take (edgex_devmap_t *map, bool byprotocol, const char *key)
+{
+  const devmap_devlist *lists[DEVMAP_SHARDS];
+  edgex_device **result = NULL;
+  unsigned count = 0;
+
+  for (unsigned n = 0; n < DEVMAP_SHARDS; n++)
+  {
+    devmap_snapshot *s = shard_current (&map->shards[n]);
+    lists[n] = snapshot_devlist (byprotocol ? &s->byprotocol : &s->bylabel, key);
+    count += lists[n] ? lists[n]->count : 0;
+  }
+  if (count)
+  {
+    result = malloc ((count + 1) * sizeof (edgex_device *));
+    count = 0;
+    for (unsigned n = 0; n < DEVMAP_SHARDS; n++)
+    {
+      for (unsigned i = 0; lists[n] && i < lists[n]->count; i++)
+      {
+        result[count] = lists[n]->devices[i];
+        atomic_fetch_add (&result[count++]->refs, 1);
+      }
+    }
+    result[count] = NULL;
+  }
+  return result;
+}
+
+edgex_device **edgex_devmap_devices (edgex_devmap_t *map)
+{
+  const char *key;
+  unsigned n = 0;
+  unsigned size = 0;
+  edgex_device **result;
+  devmap_snapshot *snaps[DEVMAP_SHARDS];
+
+  edgex_epoch_enter ();
+  for (unsigned sh = 0; sh < DEVMAP_SHARDS; sh++)
+  {
+    snaps[sh] = shard_current (&map->shards[sh]);
+    size += edgex_map_size (&snaps[sh]->devices);
+  }
+  result = malloc ((size + 1) * sizeof (edgex_device *));
+  for (unsigned sh = 0; sh < DEVMAP_SHARDS; sh++)
+  {
+    devmap_snapshot *s = snaps[sh];
+    edgex_map_iter iter = edgex_map_iter (s->devices);
+    while ((key = edgex_map_next (&s->devices, &iter)))
+    {
+      result[n] = snapshot_device (&s->devices, key);
+      atomic_fetch_add (&result[n++]->refs, 1);
+    }
+  }
+  edgex_epoch_exit ();
+  result[n] = NULL;
+  return result;
+}
+
+edgex_device **edgex_devmap_devices_bylabel (edgex_devmap_t *map, const char *label)
+{
+  edgex_device **result;
+
+  edgex_epoch_enter ();
+  result = devlist_take (map, false, label);
+  edgex_epoch_exit ();
+  return result;
+}
+
+edgex_device **edgex_devmap_devices_byprotocol
+  (edgex_devmap_t *map, const char *protocol, const char *property, const char *value)
+{
+  edgex_device **result;
+  char *key = protocol_key (protocol, property, value);
+
+  edgex_epoch_enter ();
+  result = devlist_take (map, true, key);
+  edgex_epoch_exit ();
+  free (key);
   return result;
 }
 
@@ -337,9 +1417,10 @@ void edgex_device_release (edgex_device *dev)
 {
   if (atomic_fetch_add (&dev->refs, -1) == 1)
   {
+    edgex_memstats_free (EDGEX_MEM_DEVMAP, device_footprint (dev));
     edgex_device_autoevent_stop (dev);
     dev->profile = NULL;
+    device_unintern (dev);
     edgex_device_free (dev);
   }
 }
-
@@ -13,6 +13,7 @@
 
 #include "edgex/devsdk.h"
 #include "edgex/edgex.h"
+#include "edgex-rest.h"
 
 struct edgex_devmap_t;
 typedef struct edgex_devmap_t edgex_devmap_t;
@@ -54,10 +55,43 @@ extern void edgex_devmap_free (edgex_devmap_t *map);
 extern void edgex_devmap_populate_devices
   (edgex_devmap_t *map, const edgex_device *devs);
 extern edgex_device *edgex_devmap_copydevices (edgex_devmap_t *map);
+extern unsigned edgex_devmap_size (edgex_devmap_t *map);
 extern edgex_deviceprofile *edgex_devmap_copyprofiles (edgex_devmap_t *map);
 extern edgex_devmap_outcome_t edgex_devmap_replace_device
   (edgex_devmap_t *map, const edgex_device *dev);
 
+/*
+ * Replace a list of devices, or add them, as if each were passed to
+ * replace_device, publishing the changes together. The outcome for each
+ * device is returned in outcomes.
+ */
+
+extern void edgex_devmap_replace_devices
+  (edgex_devmap_t *map, const edgex_device *devs, edgex_devmap_outcome_t *outcomes);
+
+/*
+ * Apply changes to individual fields of a device without replacing it. The
+ * outcome is UPDATED_DRIVER if the admin state changed. Returns false if no
+ * device with the given id is held.
+ */
+
+extern bool edgex_devmap_update_device
+  (edgex_devmap_t *map, const char *id, const edgex_device_changes *changes, edgex_devmap_outcome_t *outcome);
+
+/* Set the operating state of the device with the given id. Returns true if it was held and its state changed */
+
+extern bool edgex_devmap_set_opstate
+  (edgex_devmap_t *map, const char *id, edgex_device_operatingstate opstate);
+
+/*
+ * Add a list of devices in one pass, skipping any whose names are already
+ * present. If added is set, it receives for each device whether it was added.
+ * Returns the number added.
+ */
+
+extern unsigned edgex_devmap_add_devices
+  (edgex_devmap_t *map, const edgex_device *devs, bool *added);
+
 /*
  * These functions return pointers to the devices held in the implementation.
  * They must be released after use by calling edgex_device_release().
@@ -67,9 +101,27 @@ extern edgex_device *edgex_devmap_device_byid
   (edgex_devmap_t *map, const char *id);
 extern edgex_device *edgex_devmap_device_byname
   (edgex_devmap_t *map, const char *name);
+
+/* Look up a number of devices in one pass. Devices not found are returned as NULL */
+
+extern void edgex_devmap_devices_bynames
+  (edgex_devmap_t *map, const char * const *names, unsigned n, edgex_device **result);
 extern edgex_cmdqueue_t *edgex_devmap_device_forcmd
   (edgex_devmap_t *map, const char *cmd, bool forGet);
 
+/*
+ * Multiple device queries. These return NULL-terminated arrays of devices;
+ * each device must be released, and the array freed. The indexed queries
+ * return NULL if no devices match.
+ */
+
+extern edgex_device **edgex_devmap_devices (edgex_devmap_t *map);
+
+extern edgex_device **edgex_devmap_devices_bylabel
+  (edgex_devmap_t *map, const char *label);
+extern edgex_device **edgex_devmap_devices_byprotocol
+  (edgex_devmap_t *map, const char *protocol, const char *property, const char *value);
+
 /*
  * Release function. The device is freed when its reference count hits zero.
  */
@@ -85,13 +137,19 @@ extern void edgex_devmap_removedevice_byid
 extern void edgex_devmap_removedevice_byname
   (edgex_devmap_t *map, const char *name);
 
+/* Remove a number of devices in one pass. Ids which are not held are ignored */
+
+extern void edgex_devmap_removedevices_byid
+  (edgex_devmap_t *map, const char * const *ids, unsigned n);
+
 /*
  * Add and retrieve profiles. We take ownership on add, and return pointers
  * to the profiles held in the implementation. Unlike devices these are not
- * refcounted and do not need to be released or freed.
+ * refcounted and do not need to be released or freed. Adding a profile
+ * which is already held frees it, and returns the one held.
  */
 
-extern void edgex_devmap_add_profile
+extern const edgex_deviceprofile *edgex_devmap_add_profile
   (edgex_devmap_t *map, edgex_deviceprofile *dp);
 extern const edgex_deviceprofile *edgex_devmap_profile
   (edgex_devmap_t *map, const char *name);
@@ -0,0 +1,234 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#include "devqueue.h"
+#include "map.h"
+#include "edgex-time.h"
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Each device with callers present has an entry, marked busy while a caller
+ * has its turn, and holding the callers waiting in each class in the order in
+ * which they entered. When the caller whose turn it is leaves, the turn
+ * passes directly to the next of them. The entry is removed when the last caller leaves.
+ * Waiters which block are woken through their condition variable; the others
+ * have their function called.
+ */
+
+typedef struct devqueue_waiter
+{
+  struct devqueue_waiter *next;
+  edgex_devqueue_fn fn;
+  void *ctx;
+  uint64_t queued;
+  bool turn;
+  pthread_cond_t cond;
+} devqueue_waiter;
+
+typedef struct edgex_devqueue_entry
+{
+  bool busy;
+  devqueue_waiter *head[EDGEX_QOS_CLASSES];
+  devqueue_waiter *tail[EDGEX_QOS_CLASSES];
+} edgex_devqueue_entry;
+
+typedef edgex_map(edgex_devqueue_entry *) edgex_map_devqueue_entry;
+
+struct edgex_devqueue_t
+{
+  edgex_map_devqueue_entry devices;
+  pthread_mutex_t lock;
+  uint64_t maxwait;
+};
+
+edgex_devqueue_t *edgex_devqueue_alloc (uint32_t maxwait)
+{
+  edgex_devqueue_t *q = malloc (sizeof (edgex_devqueue_t));
+  edgex_map_init (&q->devices);
+  pthread_mutex_init (&q->lock, NULL);
+  q->maxwait = (uint64_t)maxwait * 1000000;
+  return q;
+}
+
+/* Take the turn if the device is free, otherwise queue the waiter. Called with the lock held */
+
+static bool devqueue_take (edgex_devqueue_t *q, const char *device, edgex_qos_class cls, devqueue_waiter *w)
+{
+  edgex_devqueue_entry *entry;
+  edgex_devqueue_entry **existing = edgex_map_get (&q->devices, device);
+
+  if (existing)
+  {
+    entry = *existing;
+  }
+  else
+  {
+    entry = calloc (1, sizeof (edgex_devqueue_entry));
+    edgex_map_set (&q->devices, device, entry);
+  }
+  if (!entry->busy)
+  {
+    entry->busy = true;
+    return true;
+  }
+  w->next = NULL;
+  w->queued = edgex_device_nanotime_monotonic ();
+  if (entry->tail[cls])
+  {
+    entry->tail[cls]->next = w;
+  }
+  else
+  {
+    entry->head[cls] = w;
+  }
+  entry->tail[cls] = w;
+  return false;
+}
+
+/* Remove and return the next waiter for a device, or NULL if there is none. Called with the lock held */
+
+static devqueue_waiter *devqueue_next (edgex_devqueue_t *q, edgex_devqueue_entry *entry)
+{
+  int top = -1;
+  int oldest = -1;
+  devqueue_waiter *w;
+
+  for (int c = 0; c < EDGEX_QOS_CLASSES; c++)
+  {
+    if (entry->head[c])
+    {
+      if (top == -1)
+      {
+        top = c;
+      }
+      if (oldest == -1 || entry->head[c]->queued < entry->head[oldest]->queued)
+      {
+        oldest = c;
+      }
+    }
+  }
+  if (top == -1)
+  {
+    return NULL;
+  }
+  if (q->maxwait && oldest != top && edgex_device_nanotime_monotonic () - entry->head[oldest]->queued > q->maxwait)
+  {
+    top = oldest;
+  }
+  w = entry->head[top];
+  entry->head[top] = w->next;
+  if (entry->head[top] == NULL)
+  {
+    entry->tail[top] = NULL;
+  }
+  return w;
+}
+
+void edgex_devqueue_enter (edgex_devqueue_t *q, const char *device, edgex_qos_class cls)
+{
+  devqueue_waiter w;
+
+  if (q == NULL)
+  {
+    return;
+  }
+  w.fn = NULL;
+  w.turn = false;
+  pthread_cond_init (&w.cond, NULL);
+  pthread_mutex_lock (&q->lock);
+  if (!devqueue_take (q, device, cls, &w))
+  {
+    while (!w.turn)
+    {
+      pthread_cond_wait (&w.cond, &q->lock);
+    }
+  }
+  pthread_mutex_unlock (&q->lock);
+  pthread_cond_destroy (&w.cond);
+}
+
+bool edgex_devqueue_join
+  (edgex_devqueue_t *q, const char *device, edgex_qos_class cls, edgex_devqueue_fn fn, void *ctx)
+{
+  devqueue_waiter *w;
+  bool result;
+
+  if (q == NULL)
+  {
+    return true;
+  }
+  w = malloc (sizeof (devqueue_waiter));
+  w->fn = fn;
+  w->ctx = ctx;
+  pthread_mutex_lock (&q->lock);
+  result = devqueue_take (q, device, cls, w);
+  pthread_mutex_unlock (&q->lock);
+  if (result)
+  {
+    free (w);
+  }
+  return result;
+}
+
+void edgex_devqueue_leave (edgex_devqueue_t *q, const char *device)
+{
+  edgex_devqueue_entry **existing;
+  devqueue_waiter *next = NULL;
+  edgex_devqueue_fn fn = NULL;
+  void *ctx = NULL;
+
+  if (q == NULL)
+  {
+    return;
+  }
+  pthread_mutex_lock (&q->lock);
+  existing = edgex_map_get (&q->devices, device);
+  if (existing)
+  {
+    edgex_devqueue_entry *entry = *existing;
+    next = devqueue_next (q, entry);
+    if (next)
+    {
+      if (next->fn)
+      {
+        fn = next->fn;
+        ctx = next->ctx;
+        free (next);
+      }
+      else
+      {
+        next->turn = true;
+        pthread_cond_signal (&next->cond);
+      }
+    }
+    else
+    {
+      edgex_map_remove (&q->devices, device);
+      free (entry);
+    }
+  }
+  pthread_mutex_unlock (&q->lock);
+  if (fn)
+  {
+    fn (ctx);
+  }
+}
+
+void edgex_devqueue_free (edgex_devqueue_t *q)
+{
+  if (q)
+  {
+    edgex_map_deinit (&q->devices);
+    pthread_mutex_destroy (&q->lock);
+    free (q);
+  }
+}
@@ -0,0 +1,52 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#ifndef _EDGEX_DEVICE_DEVQUEUE_H_
+#define _EDGEX_DEVICE_DEVQUEUE_H_ 1
+
+#include "qos.h"
+
+#include <stdbool.h>
+
+/*
+ * Per-device serialization of driver calls. A caller enters a device's queue
+ * before calling the driver's get or put handler for it and leaves afterwards;
+ * callers for the same device are admitted one at a time, while calls for
+ * different devices proceed in parallel. Waiting callers are admitted by QoS
+ * class, and in the order in which they entered within a class, except that
+ * one which has waited longer than the starvation limit is admitted next
+ * whatever its class. Queues are keyed on device name, so they persist across
+ * device updates. Where the queue is NULL, enter and leave do nothing.
+ */
+
+typedef struct edgex_devqueue_t edgex_devqueue_t;
+
+typedef void (*edgex_devqueue_fn) (void *ctx);
+
+/* Callers waiting over maxwait milliseconds are promoted; 0 disables this */
+
+edgex_devqueue_t *edgex_devqueue_alloc (uint32_t maxwait);
+
+/* Wait for the caller's turn on the device */
+
+void edgex_devqueue_enter (edgex_devqueue_t *q, const char *device, edgex_qos_class cls);
+
+/*
+ * Enter without waiting. Returns true if the caller's turn has come;
+ * otherwise the function is called with ctx when it does, on the thread which
+ * leaves before it, and false is returned.
+ */
+
+bool edgex_devqueue_join
+  (edgex_devqueue_t *q, const char *device, edgex_qos_class cls, edgex_devqueue_fn fn, void *ctx);
+
+void edgex_devqueue_leave (edgex_devqueue_t *q, const char *device);
+
+void edgex_devqueue_free (edgex_devqueue_t *q);
+
+#endif
@@ -8,23 +8,72 @@
 
 #include "devutil.h"
 
+#include <string.h>
+
+/* FNV-1a, continued from a previous value so that fields may be combined */
+
+static uint64_t hash_string (uint64_t h, const char *s)
+{
+  if (s)
+  {
+    while (*s)
+    {
+      h = (h ^ (unsigned char)*s++) * 0x100000001b3ull;
+    }
+  }
+  return (h ^ 0xff) * 0x100000001b3ull;
+}
+
+static uint64_t hash_bytes (uint64_t h, const void *p, size_t n)
+{
+  const unsigned char *b = (const unsigned char *)p;
+  while (n--)
+  {
+    h = (h ^ *b++) * 0x100000001b3ull;
+  }
+  return h;
+}
+
+#define HASH_SEED 0xcbf29ce484222325ull
+
 /* Macro for generating single-linked-list comparison functions.
  * Assumes a "next" pointer and that the key (name) field is a string.
+ *
+ * Lists from metadata are usually in the same order, so they are first
+ * compared pairwise. Failing that, a sum of element hashes, which does not
+ * depend on order, rules out most differences; only lists which agree on it
+ * are searched element by element.
  */
 
-#define LIST_EQUAL_FUNCTION(TYPENAME,NAMEFIELD,CMPFUNC)           \
-bool TYPENAME ## _equal (const TYPENAME *l1, const TYPENAME *l2)  \
+#define LIST_EQUAL_FUNCTION(SCOPE,TYPENAME,NAMEFIELD,CMPFUNC,HASHFUNC) \
+static uint64_t TYPENAME ## _hash (const TYPENAME *list)          \
+{                                                                 \
+  uint64_t h = 0;                                                 \
+  for (; list; list = list->next) h += HASHFUNC (list);           \
+  return h;                                                       \
+}                                                                 \
+SCOPE bool TYPENAME ## _equal (const TYPENAME *l1, const TYPENAME *l2)  \
 {                                                                 \
   const TYPENAME *l;                                              \
   const TYPENAME *found;                                          \
+  const TYPENAME *a = l1;                                         \
+  const TYPENAME *b = l2;                                         \
+  if (l1 == l2) return true;                                      \
+  while (a && b && strcmp (a->NAMEFIELD, b->NAMEFIELD) == 0 && CMPFUNC (a, b)) \
+  {                                                               \
+    a = a->next;                                                  \
+    b = b->next;                                                  \
+  }                                                               \
+  if (a == NULL || b == NULL) return a == b;                      \
   unsigned n1 = 0;                                                \
   unsigned n2 = 0;                                                \
-  for (l = l1; l; l = l->next, n1++);                             \
-  for (l = l2; l; l = l->next, n2++);                             \
+  for (l = a; l; l = l->next, n1++);                              \
+  for (l = b; l; l = l->next, n2++);                              \
   if (n1 != n2) return false;                                     \
-  for (l = l1; l; l = l->next)                                    \
+  if (TYPENAME ## _hash (a) != TYPENAME ## _hash (b)) return false; \
+  for (l = a; l; l = l->next)                                     \
   {                                                               \
-    for (found = l2; found; found = found->next)                  \
+    for (found = b; found; found = found->next)                   \
     {                                                             \
       if (strcmp (l->NAMEFIELD, found->NAMEFIELD) == 0) break;    \
     }                                                             \
@@ -38,7 +87,12 @@ static bool pair_equal (const edgex_nvpairs *p1, const edgex_nvpairs *p2)
   return (strcmp (p1->value, p2->value) == 0);
 }
 
-static LIST_EQUAL_FUNCTION(edgex_nvpairs, name, pair_equal)
+static uint64_t pair_hash (const edgex_nvpairs *p)
+{
+  return hash_string (hash_string (HASH_SEED, p->name), p->value);
+}
+
+LIST_EQUAL_FUNCTION(static, edgex_nvpairs, name, pair_equal, pair_hash)
 
 static bool protocol_equal
   (const edgex_protocols *p1, const edgex_protocols *p2)
@@ -46,13 +100,33 @@ static bool protocol_equal
   return edgex_nvpairs_equal (p1->properties, p2->properties);
 }
 
-LIST_EQUAL_FUNCTION(edgex_protocols, name, protocol_equal)
+static uint64_t protocol_hash (const edgex_protocols *p)
+{
+  return hash_string (HASH_SEED, p->name) ^ edgex_nvpairs_hash (p->properties);
+}
+
+LIST_EQUAL_FUNCTION(, edgex_protocols, name, protocol_equal, protocol_hash)
 
 static bool autoevent_equal
   (const edgex_device_autoevents *e1, const edgex_device_autoevents *e2)
 {
   return
-    strcmp (e1->frequency, e2->frequency) == 0 && e1->onChange == e2->onChange;
+    strcmp (e1->frequency, e2->frequency) == 0 && e1->onChange == e2->onChange &&
+    e1->deadband == e2->deadband && e1->deadbandPercent == e2->deadbandPercent &&
+    (e1->heartbeat ? (e2->heartbeat && strcmp (e1->heartbeat, e2->heartbeat) == 0) : e2->heartbeat == NULL) &&
+    (e1->cron ? (e2->cron && strcmp (e1->cron, e2->cron) == 0) : e2->cron == NULL) && e1->align == e2->align;
+}
+
+/* Deadbands hash by value, so that 0.0 and -0.0, which compare equal, are hashed alike */
+
+static uint64_t autoevent_hash (const edgex_device_autoevents *e)
+{
+  double db = e->deadband == 0.0 ? 0.0 : e->deadband;
+  double dbp = e->deadbandPercent == 0.0 ? 0.0 : e->deadbandPercent;
+  uint64_t h = hash_string (hash_string (HASH_SEED, e->resource), e->frequency);
+  h = hash_string (hash_string (h, e->heartbeat), e->cron);
+  h = hash_bytes (hash_bytes (h, &db, sizeof (db)), &dbp, sizeof (dbp));
+  return (h ^ (e->onChange ? 1 : 0) ^ (e->align ? 2 : 0)) * 0x100000001b3ull;
 }
 
-LIST_EQUAL_FUNCTION(edgex_device_autoevents, resource, autoevent_equal)
+LIST_EQUAL_FUNCTION(, edgex_device_autoevents, resource, autoevent_equal, autoevent_hash)
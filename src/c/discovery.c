@@ -11,6 +11,8 @@
 #include "profiles.h"
 #include "metadata.h"
 #include "edgex-rest.h"
+#include "errorlist.h"
+#include "edgex/device-mgmt.h"
 
 #include <string.h>
 #include <stdlib.h>
@@ -51,7 +53,7 @@ int edgex_device_handler_discovery
 
   if (pthread_mutex_trylock (&svc->discolock) == 0)
   {
-    iot_threadpool_add_work (svc->thpool, edgex_device_handler_do_discovery, svc, NULL);
+    edgex_pool_add_work (svc->thpool, edgex_device_handler_do_discovery, svc);
     pthread_mutex_unlock (&svc->discolock);
   }
   // else discovery was already running; ignore this request
@@ -66,6 +68,111 @@ void edgex_device_handler_do_discovery (void *p)
   edgex_device_service *svc = (edgex_device_service *) p;
 
   pthread_mutex_lock (&svc->discolock);
+  uint64_t ticket = edgex_qos_enter (svc->qos, EDGEX_QOS_DISCOVERY, NULL);
   svc->userfns.discover (svc->userdata);
+  edgex_qos_leave (svc->qos, EDGEX_QOS_DISCOVERY, ticket);
   pthread_mutex_unlock (&svc->discolock);
 }
+
+/* A discovered device is new if neither it nor the device it is addressed as is known, or was earlier in the batch */
+
+static bool discovered_isnew
+  (edgex_device_service *svc, edgex_map_void *seen, const char *name, const edgex_watchmatch *m)
+{
+  edgex_device *existing;
+  edgex_device **dups;
+  char *addr;
+  size_t sz;
+  bool result = true;
+
+  existing = edgex_devmap_device_byname (svc->devices, name);
+  if (existing)
+  {
+    edgex_device_release (existing);
+    return false;
+  }
+  dups = edgex_devmap_devices_byprotocol (svc->devices, m->protocol, m->key, m->value);
+  if (dups)
+  {
+    for (edgex_device **d = dups; *d; d++)
+    {
+      edgex_device_release (*d);
+    }
+    free (dups);
+    return false;
+  }
+
+  sz = strlen (m->protocol) + strlen (m->key) + strlen (m->value) + 3;
+  addr = malloc (sz);
+  snprintf (addr, sz, "%s\x1f%s\x1f%s", m->protocol, m->key, m->value);
+  if (edgex_map_get (seen, name) || edgex_map_get (seen, addr))
+  {
+    result = false;
+  }
+  else
+  {
+    edgex_map_set (seen, name, NULL);
+    edgex_map_set (seen, addr, NULL);
+  }
+  free (addr);
+  return result;
+}
+
+unsigned edgex_device_add_discovered_devices
+  (edgex_device_service *svc, const edgex_device_discovered *devices, unsigned n)
+{
+  edgex_map_void seen;
+  edgex_device_newdevice *newdevs;
+  edgex_device_addresult *results;
+  unsigned nnew = 0;
+  unsigned added = 0;
+  unsigned unmatched = 0;
+
+  if (svc->watchlist == NULL)
+  {
+    iot_log_warn (svc->logger, "No provision watchers configured, %u discovered devices ignored", n);
+    return 0;
+  }
+
+  newdevs = malloc (n * sizeof (edgex_device_newdevice));
+  edgex_map_init (&seen);
+  edgex_map_reserve (&seen, 2 * n);
+  for (unsigned i = 0; i < n; i++)
+  {
+    edgex_watchmatch m;
+    const edgex_device_discovered *dev = &devices[i];
+
+    if (!edgex_watchlist_match (svc->watchlist, dev->protocols, &m))
+    {
+      unmatched++;
+      continue;
+    }
+    if (discovered_isnew (svc, &seen, dev->name, &m))
+    {
+      iot_log_debug (svc->logger, "Discovered device %s matches watcher %s", dev->name, m.watcher);
+      newdevs[nnew].name = dev->name;
+      newdevs[nnew].description = dev->description;
+      newdevs[nnew].labels = dev->labels;
+      newdevs[nnew].profile_name = m.profile;
+      newdevs[nnew].protocols = dev->protocols;
+      newdevs[nnew].autos = NULL;
+      nnew++;
+    }
+  }
+  edgex_map_deinit (&seen);
+
+  if (nnew)
+  {
+    results = malloc (nnew * sizeof (edgex_device_addresult));
+    added = edgex_device_add_devices (svc, newdevs, nnew, results);
+    for (unsigned i = 0; i < nnew; i++)
+    {
+      free (results[i].id);
+    }
+    free (results);
+  }
+  free (newdevs);
+
+  iot_log_info (svc->logger, "Discovery: %u devices found, %u added, %u matched no watcher", n, added, unmatched);
+  return added;
+}
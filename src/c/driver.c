@@ -0,0 +1,412 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#include "driver.h"
+#include "service.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct edgex_device_completion
+{
+  edgex_device_service *svc;
+  const char *devname;
+  edgex_qos_class cls;
+  uint64_t ticket;
+  edgex_driver_callback cb;
+  void *ctx;
+};
+
+/* Blocking calls to asynchronous handlers wait for the completion here */
+
+typedef struct driver_waiter
+{
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+  bool done;
+  bool success;
+} driver_waiter;
+
+static void driver_waiter_init (driver_waiter *w)
+{
+  pthread_mutex_init (&w->lock, NULL);
+  pthread_cond_init (&w->cond, NULL);
+  w->done = false;
+  w->success = false;
+}
+
+static void driver_wakeup (void *p, bool success)
+{
+  driver_waiter *w = (driver_waiter *)p;
+  pthread_mutex_lock (&w->lock);
+  w->success = success;
+  w->done = true;
+  pthread_cond_signal (&w->cond);
+  pthread_mutex_unlock (&w->lock);
+}
+
+static bool driver_wait (driver_waiter *w)
+{
+  pthread_mutex_lock (&w->lock);
+  while (!w->done)
+  {
+    pthread_cond_wait (&w->cond, &w->lock);
+  }
+  pthread_mutex_unlock (&w->lock);
+  pthread_cond_destroy (&w->cond);
+  pthread_mutex_destroy (&w->lock);
+  return w->success;
+}
+
+/*
+ * Calls wait for their turn on the device, then for admission in their class.
+ * Both are ordered by class, so a command for a device is not held behind the
+ * AutoEvents already waiting for it.
+ */
+
+static uint64_t driver_enter (edgex_device_service *svc, edgex_qos_class cls, const char *devname)
+{
+  edgex_devqueue_enter (svc->devqueue, devname, cls);
+  return edgex_qos_enter (svc->qos, cls, devname);
+}
+
+static void driver_leave (edgex_device_service *svc, edgex_qos_class cls, const char *devname, uint64_t ticket)
+{
+  edgex_qos_leave (svc->qos, cls, ticket);
+  edgex_devqueue_leave (svc->devqueue, devname);
+}
+
+static edgex_device_completion *driver_completion
+(
+  edgex_device_service *svc,
+  edgex_qos_class cls,
+  uint64_t ticket,
+  const char *devname,
+  edgex_driver_callback cb,
+  void *ctx
+)
+{
+  edgex_device_completion *c = malloc (sizeof (edgex_device_completion));
+  c->svc = svc;
+  c->cls = cls;
+  c->ticket = ticket;
+  c->devname = devname;
+  c->cb = cb;
+  c->ctx = ctx;
+  return c;
+}
+
+void edgex_device_complete (edgex_device_completion *completion, bool success)
+{
+  driver_leave (completion->svc, completion->cls, completion->devname, completion->ticket);
+  completion->cb (completion->ctx, success);
+  free (completion);
+}
+
+void edgex_device_register_async_handlers
+(
+  edgex_device_service *svc,
+  edgex_device_handle_get_async getter,
+  edgex_device_handle_put_async putter
+)
+{
+  if (svc->daemon)
+  {
+    iot_log_error
+      (svc->logger, "Asynchronous handlers must be registered before service start.");
+    return;
+  }
+  svc->asyncget = getter;
+  svc->asyncput = putter;
+}
+
+bool edgex_driver_async_get (const edgex_device_service *svc)
+{
+  return svc->asyncget != NULL;
+}
+
+/*
+ * A get started without blocking is held until it has its turn on the device
+ * and is admitted, which may happen on the thread completing the previous
+ * call for the device. Calls which become ready while a thread is issuing
+ * calls are issued by it in turn once the current one returns, so that calls
+ * completed within the handler do not nest.
+ */
+
+typedef struct driver_pending
+{
+  edgex_device_service *svc;
+  edgex_qos_class cls;
+  const edgex_device *dev;
+  uint32_t nreqs;
+  const edgex_device_commandrequest *requests;
+  edgex_device_commandresult *results;
+  edgex_driver_callback cb;
+  void *ctx;
+  uint64_t ticket;
+  struct driver_pending *next;
+} driver_pending;
+
+static _Thread_local driver_pending *driver_ready_head = NULL;
+static _Thread_local driver_pending *driver_ready_tail = NULL;
+static _Thread_local bool driver_issuing = false;
+
+static void driver_issue (driver_pending *p)
+{
+  edgex_device_service *svc = p->svc;
+  if (svc->asyncget)
+  {
+    svc->asyncget
+    (
+      svc->userdata, p->dev->name, p->dev->protocols, p->nreqs, p->requests, p->results,
+      driver_completion (svc, p->cls, p->ticket, p->dev->name, p->cb, p->ctx)
+    );
+  }
+  else
+  {
+    bool ok = svc->userfns.gethandler (svc->userdata, p->dev->name, p->dev->protocols, p->nreqs, p->requests, p->results);
+    driver_leave (svc, p->cls, p->dev->name, p->ticket);
+    p->cb (p->ctx, ok);
+  }
+  free (p);
+}
+
+static void driver_ready (driver_pending *p)
+{
+  p->next = NULL;
+  if (driver_ready_tail)
+  {
+    driver_ready_tail->next = p;
+  }
+  else
+  {
+    driver_ready_head = p;
+  }
+  driver_ready_tail = p;
+  if (!driver_issuing)
+  {
+    driver_issuing = true;
+    while (driver_ready_head)
+    {
+      p = driver_ready_head;
+      driver_ready_head = p->next;
+      if (driver_ready_head == NULL)
+      {
+        driver_ready_tail = NULL;
+      }
+      driver_issue (p);
+    }
+    driver_issuing = false;
+  }
+}
+
+static void driver_admitted (void *ctx, uint64_t ticket)
+{
+  driver_pending *p = (driver_pending *)ctx;
+  p->ticket = ticket;
+  driver_ready (p);
+}
+
+static void driver_turn (void *ctx)
+{
+  driver_pending *p = (driver_pending *)ctx;
+  if (edgex_qos_join (p->svc->qos, p->cls, p->dev->name, driver_admitted, p, &p->ticket))
+  {
+    driver_ready (p);
+  }
+}
+
+void edgex_driver_get_async
+(
+  edgex_device_service *svc,
+  edgex_qos_class cls,
+  const edgex_device *dev,
+  uint32_t nreqs,
+  const edgex_device_commandrequest *requests,
+  edgex_device_commandresult *results,
+  edgex_driver_callback cb,
+  void *ctx
+)
+{
+  driver_pending *p = malloc (sizeof (driver_pending));
+  p->svc = svc;
+  p->cls = cls;
+  p->dev = dev;
+  p->nreqs = nreqs;
+  p->requests = requests;
+  p->results = results;
+  p->cb = cb;
+  p->ctx = ctx;
+  if (edgex_devqueue_join (svc->devqueue, dev->name, cls, driver_turn, p))
+  {
+    driver_turn (p);
+  }
+}
+
+bool edgex_driver_get
+(
+  edgex_device_service *svc,
+  edgex_qos_class cls,
+  const edgex_device *dev,
+  uint32_t nreqs,
+  const edgex_device_commandrequest *requests,
+  edgex_device_commandresult *results
+)
+{
+  bool ok;
+  driver_waiter w;
+  uint64_t start = edgex_trace_start ();
+  uint64_t ticket = driver_enter (svc, cls, dev->name);
+
+  if (svc->asyncget == NULL)
+  {
+    ok = svc->userfns.gethandler (svc->userdata, dev->name, dev->protocols, nreqs, requests, results);
+    driver_leave (svc, cls, dev->name, ticket);
+  }
+  else
+  {
+    driver_waiter_init (&w);
+    svc->asyncget
+    (
+      svc->userdata, dev->name, dev->protocols, nreqs, requests, results,
+      driver_completion (svc, cls, ticket, dev->name, driver_wakeup, &w)
+    );
+    ok = driver_wait (&w);
+  }
+  edgex_trace_span (EDGEX_TRACE_DRIVER, start);
+  return ok;
+}
+
+bool edgex_driver_put
+(
+  edgex_device_service *svc,
+  edgex_qos_class cls,
+  const edgex_device *dev,
+  uint32_t nreqs,
+  const edgex_device_commandrequest *requests,
+  const edgex_device_commandresult *values
+)
+{
+  bool ok;
+  driver_waiter w;
+  uint64_t start = edgex_trace_start ();
+  uint64_t ticket = driver_enter (svc, cls, dev->name);
+
+  if (svc->asyncput == NULL)
+  {
+    ok = svc->userfns.puthandler (svc->userdata, dev->name, dev->protocols, nreqs, requests, values);
+    driver_leave (svc, cls, dev->name, ticket);
+  }
+  else
+  {
+    driver_waiter_init (&w);
+    svc->asyncput
+    (
+      svc->userdata, dev->name, dev->protocols, nreqs, requests, values,
+      driver_completion (svc, cls, ticket, dev->name, driver_wakeup, &w)
+    );
+    ok = driver_wait (&w);
+  }
+  edgex_trace_span (EDGEX_TRACE_DRIVER, start);
+  return ok;
+}
+
+void edgex_device_register_group_handler (edgex_device_service *svc, edgex_device_handle_put_group putter)
+{
+  if (svc->daemon)
+  {
+    iot_log_error
+      (svc->logger, "Group put handler must be registered before service start.");
+    return;
+  }
+  svc->groupput = putter;
+}
+
+void edgex_device_register_command_handlers
+(
+  edgex_device_service *svc,
+  edgex_device_prepare_command prepare,
+  edgex_device_release_command release
+)
+{
+  if (svc->daemon)
+  {
+    iot_log_error
+      (svc->logger, "Command handlers must be registered before service start.");
+    return;
+  }
+  svc->prepare = prepare;
+  svc->release = release;
+}
+
+bool edgex_driver_group_put (const edgex_device_service *svc)
+{
+  return svc->groupput != NULL;
+}
+
+static int driver_cmpname (const void *a, const void *b)
+{
+  return strcmp ((*(const edgex_device *const *)a)->name, (*(const edgex_device *const *)b)->name);
+}
+
+/*
+ * A group put takes its turn on every device, and is admitted once. The
+ * devices are entered in name order so that concurrent group puts to
+ * overlapping sets of devices cannot deadlock.
+ */
+
+bool edgex_driver_put_group
+(
+  edgex_device_service *svc,
+  edgex_qos_class cls,
+  uint32_t ndevs,
+  const edgex_device *const *devs,
+  uint32_t nreqs,
+  const edgex_device_commandrequest *requests,
+  const edgex_device_commandresult *values
+)
+{
+  bool ok;
+  uint64_t ticket;
+  uint64_t start;
+  const edgex_device **sorted;
+  const char **names;
+  const edgex_protocols **protocols;
+
+  if (svc->groupput == NULL)
+  {
+    return false;
+  }
+  start = edgex_trace_start ();
+  sorted = malloc (ndevs * sizeof (edgex_device *));
+  names = malloc (ndevs * sizeof (char *));
+  protocols = malloc (ndevs * sizeof (edgex_protocols *));
+  memcpy (sorted, devs, ndevs * sizeof (edgex_device *));
+  qsort (sorted, ndevs, sizeof (edgex_device *), driver_cmpname);
+  for (uint32_t i = 0; i < ndevs; i++)
+  {
+    edgex_devqueue_enter (svc->devqueue, sorted[i]->name, cls);
+    names[i] = sorted[i]->name;
+    protocols[i] = sorted[i]->protocols;
+  }
+  ticket = edgex_qos_enter (svc->qos, cls, NULL);
+
+  ok = svc->groupput (svc->userdata, ndevs, names, protocols, nreqs, requests, values);
+
+  edgex_qos_leave (svc->qos, cls, ticket);
+  for (uint32_t i = ndevs; i > 0; i--)
+  {
+    edgex_devqueue_leave (svc->devqueue, sorted[i - 1]->name);
+  }
+  free (protocols);
+  free (names);
+  free (sorted);
+  edgex_trace_span (EDGEX_TRACE_DRIVER, start);
+  return ok;
+}
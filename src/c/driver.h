@@ -0,0 +1,91 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#ifndef _EDGEX_DEVICE_DRIVER_H_
+#define _EDGEX_DEVICE_DRIVER_H_ 1
+
+#include "edgex/devsdk.h"
+#include "edgex/edgex.h"
+#include "qos.h"
+
+/*
+ * Calls to the device service implementation's get and put handlers. Where
+ * asynchronous handlers are registered they are used in preference to the
+ * synchronous ones; the blocking calls then wait for the completion. Calls
+ * are serialized per device if the service is so configured, and admitted
+ * according to their class if a limit is set on concurrent calls. The device,
+ * the requests and the results must remain valid until the call has completed.
+ */
+
+typedef void (*edgex_driver_callback) (void *ctx, bool success);
+
+bool edgex_driver_get
+(
+  edgex_device_service *svc,
+  edgex_qos_class cls,
+  const edgex_device *dev,
+  uint32_t nreqs,
+  const edgex_device_commandrequest *requests,
+  edgex_device_commandresult *results
+);
+
+bool edgex_driver_put
+(
+  edgex_device_service *svc,
+  edgex_qos_class cls,
+  const edgex_device *dev,
+  uint32_t nreqs,
+  const edgex_device_commandrequest *requests,
+  const edgex_device_commandresult *values
+);
+
+/*
+ * Start a get, without waiting for the device or for admission. The call is
+ * made once its turn comes, possibly from the thread completing the previous
+ * call. The callback is invoked when it completes: on the thread which made
+ * the call if the synchronous handler is used, otherwise on whichever thread
+ * the implementation completes the request.
+ */
+
+void edgex_driver_get_async
+(
+  edgex_device_service *svc,
+  edgex_qos_class cls,
+  const edgex_device *dev,
+  uint32_t nreqs,
+  const edgex_device_commandrequest *requests,
+  edgex_device_commandresult *results,
+  edgex_driver_callback cb,
+  void *ctx
+);
+
+/*
+ * Put the same values to a number of devices with the group put handler.
+ * Returns false if none is registered or the implementation declined.
+ */
+
+bool edgex_driver_put_group
+(
+  edgex_device_service *svc,
+  edgex_qos_class cls,
+  uint32_t ndevs,
+  const edgex_device *const *devs,
+  uint32_t nreqs,
+  const edgex_device_commandrequest *requests,
+  const edgex_device_commandresult *values
+);
+
+/* Whether a group put handler is registered */
+
+bool edgex_driver_group_put (const edgex_device_service *svc);
+
+/* Whether gets complete asynchronously, ie an asynchronous get handler is registered */
+
+bool edgex_driver_async_get (const edgex_device_service *svc);
+
+#endif
@@ -7,12 +7,15 @@
  */
 
 #include "edgex/edgex-logging.h"
+#include "logfile.h"
+#include "logremote.h"
 
 #include <stdio.h>
 #include <string.h>
 #include <alloca.h>
 #include <stdlib.h>
 #include <pthread.h>
+#include <stdatomic.h>
 
 #include "errorlist.h"
 #include "parson.h"
@@ -20,9 +23,23 @@
 #include "correlation.h"
 
 #define EDGEX_TSIZE 32
+#define EDGEX_LINESIZE 512
 
 static const char * edgex_log_levels[] = {"", "ERROR", "WARNING", "INFO", "DEBUG", "TRACE"};
 
+static _Atomic (edgex_logfile_t *) edgex_log_file = NULL;
+static _Atomic (edgex_logremote_t *) edgex_log_remote = NULL;
+
+void edgex_log_setfile (edgex_logfile_t *lf)
+{
+  atomic_store (&edgex_log_file, lf);
+}
+
+void edgex_log_setremote (edgex_logremote_t *lr)
+{
+  atomic_store (&edgex_log_remote, lr);
+}
+
 void edgex_log_torest
 (
   struct iot_logger_t * logger,
@@ -34,6 +51,13 @@ void edgex_log_torest
   edgex_ctx ctx;
   char *json;
   edgex_error err = EDGEX_OK;
+  edgex_logremote_t *lr = atomic_load (&edgex_log_remote);
+
+  if (lr && strcmp (logger->to, edgex_logremote_url (lr)) == 0)
+  {
+    edgex_logremote_add (lr, logger->name, l, timestamp, message);
+    return;
+  }
 
   memset (&ctx, 0, sizeof (ctx));
 
@@ -52,18 +76,63 @@ void edgex_log_torest
   json_value_free (jval);
 }
 
-void edgex_log_tofile
+static int edgex_log_format
 (
+  char *buf,
+  size_t size,
   struct iot_logger_t * logger,
   iot_loglevel_t l,
   time_t timestamp,
   const char *message
 )
 {
-  FILE *f;
   struct tm tsparts;
   char ts8601[EDGEX_TSIZE];
-  const char *crlid;
+  const char *crlid = edgex_device_get_crlid ();
+
+  gmtime_r (&timestamp, &tsparts);
+  strftime (ts8601, EDGEX_TSIZE, "%FT%TZ", &tsparts);
+  return snprintf
+  (
+    buf,
+    size,
+    "level=%s ts=%s app=%s%s%s msg=\"%s\"\n",
+    edgex_logger_levelname (l),
+    ts8601,
+    logger->name ? logger->name : "(default)",
+    crlid ? " correlation-id=" : "",
+    crlid ? crlid : "",
+    message
+  );
+}
+
+void edgex_log_tofile
+(
+  struct iot_logger_t * logger,
+  iot_loglevel_t l,
+  time_t timestamp,
+  const char *message
+)
+{
+  FILE *f;
+  char buf[EDGEX_LINESIZE];
+  char *line = buf;
+  int len = edgex_log_format (buf, sizeof (buf), logger, l, timestamp, message);
+  edgex_logfile_t *lf = atomic_load (&edgex_log_file);
+
+  if (len >= (int)sizeof (buf))
+  {
+    line = malloc (len + 1);
+    edgex_log_format (line, len + 1, logger, l, timestamp, message);
+  }
+
+  /* Lines for the service's log file are passed to its writer thread */
+
+  if (lf && strcmp (logger->to, edgex_logfile_path (lf)) == 0)
+  {
+    edgex_logfile_write (lf, line == buf ? strdup (buf) : line);
+    return;
+  }
 
   if (strcmp (logger->to, "-") == 0)
   {
@@ -78,20 +147,7 @@ void edgex_log_tofile
     }
   }
 
-  crlid = edgex_device_get_crlid ();
-  gmtime_r (&timestamp, &tsparts);
-  strftime (ts8601, EDGEX_TSIZE, "%FT%TZ", &tsparts);
-  fprintf
-  (
-    f,
-    "level=%s ts=%s app=%s%s%s msg=\"%s\"\n",
-    edgex_logger_levelname (l),
-    ts8601,
-    logger->name ? logger->name : "(default)",
-    crlid ? " correlation-id=" : "",
-    crlid ? crlid : "",
-    message
-  );
+  fputs (line, f);
 
   if (f == stdout)
   {
@@ -101,6 +157,10 @@ void edgex_log_tofile
   {
     fclose (f);
   }
+  if (line != buf)
+  {
+    free (line);
+  }
 }
 
 const char *edgex_logger_levelname (iot_loglevel_t l)
@@ -10,6 +10,9 @@
 #include "edgex/device-mgmt.h"
 #include "cmdinfo.h"
 #include "autoevent.h"
+#include "arena.h"
+#include "jsonsax.h"
+#include "map.h"
 #include "parson.h"
 #include <string.h>
 #include <stdlib.h>
@@ -334,12 +337,16 @@ static edgex_propertyvalue *propertyvalue_read
     result->lsb = get_string (obj, "lsb");
     result->assertion = get_string (obj, "assertion");
     result->precision = get_string (obj, "precision");
+    result->deadband = get_string (obj, "deadband");
+    result->deadbandPercent = get_string (obj, "deadbandPercent");
+    result->maxAge = get_string (obj, "maxAge");
     fe = json_object_get_string (obj, "floatEncoding");
 #ifdef LEGIBLE_FLOATS
     result->floatAsBinary = fe && (strcmp (fe, "base64") == 0);
 #else
-    result->floatAsBinary = !(fe && (strcmp (fe, "eNotation") == 0));
+    result->floatAsBinary = !(fe && (strcmp (fe, "eNotation") == 0 || strcmp (fe, "shortest") == 0));
 #endif
+    result->floatShortest = fe && (strcmp (fe, "shortest") == 0);
     result->mediaType = get_string (obj, "mediaType");
   }
   else
@@ -366,7 +373,7 @@ static void set_arg
     }
     else
     {
-      sprintf (tmp, PRId64, arg.value.ival);
+      sprintf (tmp, "%" PRId64, arg.value.ival);
     }
     json_object_set_string (obj, name, tmp);
   }
@@ -390,8 +397,11 @@ static JSON_Value *propertyvalue_write (const edgex_propertyvalue *e)
   set_arg (obj, "base", e->base, e->type);
   json_object_set_string (obj, "assertion", e->assertion);
   json_object_set_string (obj, "precision", e->precision);
+  json_object_set_string (obj, "deadband", e->deadband);
+  json_object_set_string (obj, "deadbandPercent", e->deadbandPercent);
+  json_object_set_string (obj, "maxAge", e->maxAge);
   json_object_set_string
-    (obj, "floatEncoding", e->floatAsBinary ? "base64" : "eNotation");
+    (obj, "floatEncoding", e->floatAsBinary ? "base64" : e->floatShortest ? "shortest" : "eNotation");
   json_object_set_string (obj, "mediaType", e->mediaType);
   return result;
 }
@@ -416,8 +426,12 @@ static edgex_propertyvalue *propertyvalue_dup (const edgex_propertyvalue *pv)
     result->base = pv->base;
     result->assertion = strdup (pv->assertion);
     result->precision = strdup (pv->precision);
+    result->deadband = strdup (pv->deadband);
+    result->deadbandPercent = strdup (pv->deadbandPercent);
+    result->maxAge = strdup (pv->maxAge);
     result->mediaType = strdup (pv->mediaType);
     result->floatAsBinary = pv->floatAsBinary;
+    result->floatShortest = pv->floatShortest;
   }
   return result;
 }
@@ -430,6 +444,9 @@ static void propertyvalue_free (edgex_propertyvalue *e)
   free (e->lsb);
   free (e->assertion);
   free (e->precision);
+  free (e->deadband);
+  free (e->deadbandPercent);
+  free (e->maxAge);
   free (e->mediaType);
   free (e);
 }
@@ -888,9 +905,11 @@ edgex_deviceprofile *edgex_deviceprofile_read
   (iot_logger_t *lc, const char *json)
 {
   edgex_deviceprofile *result = NULL;
-  JSON_Value *val = json_parse_string (json);
+  JSON_Value *val;
   JSON_Object *obj;
 
+  edgex_arena_begin ();
+  val = json_parse_string (json);
   obj = json_value_get_object (val);
 
   if (obj)
@@ -899,6 +918,7 @@ edgex_deviceprofile *edgex_deviceprofile_read
   }
 
   json_value_free (val);
+  edgex_arena_end ();
 
   return result;
 }
@@ -908,10 +928,26 @@ static void cmdinfo_free (edgex_cmdinfo *inf)
   if (inf)
   {
     cmdinfo_free (inf->next);
+    if (inf->release)
+    {
+      inf->release (inf->impl, inf->plan);
+    }
+    for (unsigned i = 0; i < inf->nreqs; i++)
+    {
+      edgex_transform_mappings_free (inf->maps[i]);
+      if (inf->asserts[i].value.type == Binary)
+      {
+        free (inf->asserts[i].value.value.binary_result.bytes);
+      }
+    }
     free (inf->reqs);
     free (inf->pvals);
     free (inf->maps);
     free (inf->dfls);
+    free (inf->maxage);
+    free (inf->xforms);
+    free (inf->xfruns);
+    free (inf->asserts);
     free (inf);
   }
 }
@@ -922,6 +958,11 @@ static edgex_device_autoevents *autoevent_read (const JSON_Object *obj)
   result->resource = get_string (obj, "resource");
   result->onChange = get_boolean (obj, "onChange", false);
   result->frequency = get_string  (obj, "frequency");
+  result->deadband = json_object_get_number (obj, "deadband");
+  result->deadbandPercent = json_object_get_number (obj, "deadbandPercent");
+  result->heartbeat = SAFE_STRDUP (json_object_get_string (obj, "heartbeat"));
+  result->cron = SAFE_STRDUP (json_object_get_string (obj, "cron"));
+  result->align = get_boolean (obj, "align", false);
   result->impl = NULL;
   result->next = NULL;
   return result;
@@ -939,6 +980,23 @@ static JSON_Value *autoevents_write (const edgex_device_autoevents *e)
     json_object_set_string (pobj, "resource", ae->resource);
     json_object_set_string (pobj, "frequency", ae->frequency);
     json_object_set_boolean (pobj, "onChange", ae->onChange);
+    if (ae->deadband)
+    {
+      json_object_set_number (pobj, "deadband", ae->deadband);
+    }
+    if (ae->deadbandPercent)
+    {
+      json_object_set_number (pobj, "deadbandPercent", ae->deadbandPercent);
+    }
+    json_object_set_string (pobj, "heartbeat", ae->heartbeat);
+    if (ae->cron)
+    {
+      json_object_set_string (pobj, "cron", ae->cron);
+    }
+    if (ae->align)
+    {
+      json_object_set_boolean (pobj, "align", true);
+    }
     json_array_append_value (arr, pval);
   }
   return result;
@@ -954,6 +1012,11 @@ static edgex_device_autoevents *autoevents_dup
     result->resource = strdup (e->resource);
     result->frequency = strdup (e->frequency);
     result->onChange = e->onChange;
+    result->deadband = e->deadband;
+    result->deadbandPercent = e->deadbandPercent;
+    result->heartbeat = SAFE_STRDUP (e->heartbeat);
+    result->cron = SAFE_STRDUP (e->cron);
+    result->align = e->align;
     result->impl = NULL;
     result->next = autoevents_dup (e->next);
   }
@@ -966,6 +1029,8 @@ void edgex_device_autoevents_free (edgex_device_autoevents *e)
   {
     free (e->resource);
     free (e->frequency);
+    free (e->heartbeat);
+    free (e->cron);
     edgex_device_autoevents_free (e->next);
     free (e);
   }
@@ -1252,6 +1317,11 @@ void edgex_deviceprofile_free (edgex_deviceprofile *e)
     deviceresource_free (e->device_resources);
     devicecommand_free (e->device_commands);
     cmdinfo_free (e->cmdinfo);
+    if (e->cmdindex)
+    {
+      edgex_map_deinit (&e->cmdindex->map);
+      free (e->cmdindex);
+    }
     free (e);
     e = next;
   }
@@ -1260,9 +1330,11 @@ void edgex_deviceprofile_free (edgex_deviceprofile *e)
 edgex_deviceservice *edgex_deviceservice_read (const char *json)
 {
   edgex_deviceservice *result = NULL;
-  JSON_Value *val = json_parse_string (json);
+  JSON_Value *val;
   JSON_Object *obj;
 
+  edgex_arena_begin ();
+  val = json_parse_string (json);
   obj = json_value_get_object (val);
 
   if (obj)
@@ -1271,6 +1343,7 @@ edgex_deviceservice *edgex_deviceservice_read (const char *json)
   }
 
   json_value_free (val);
+  edgex_arena_end ();
 
   return result;
 }
@@ -1425,9 +1498,11 @@ void edgex_device_free (edgex_device *e)
 edgex_device *edgex_device_read (iot_logger_t *lc, const char *json)
 {
   edgex_device *result = NULL;
-  JSON_Value *val = json_parse_string (json);
+  JSON_Value *val;
   JSON_Object *obj;
 
+  edgex_arena_begin ();
+  val = json_parse_string (json);
   obj = json_value_get_object (val);
 
   if (obj)
@@ -1436,10 +1511,56 @@ edgex_device *edgex_device_read (iot_logger_t *lc, const char *json)
   }
 
   json_value_free (val);
+  edgex_arena_end ();
 
   return result;
 }
 
+edgex_device_changes *edgex_device_changes_read (const JSON_Object *obj)
+{
+  edgex_device_changes *result;
+  const char *admin = json_object_get_string (obj, "adminState");
+  const char *op = json_object_get_string (obj, "operatingState");
+  const char *desc = json_object_get_string (obj, "description");
+  const JSON_Array *labels = json_object_get_array (obj, "labels");
+
+  if (admin == NULL && op == NULL && desc == NULL && labels == NULL)
+  {
+    return NULL;
+  }
+  result = calloc (1, sizeof (edgex_device_changes));
+  if (admin)
+  {
+    result->hasAdminState = true;
+    result->adminState = edgex_adminstate_fromstring (admin);
+  }
+  if (op)
+  {
+    result->hasOperatingState = true;
+    result->operatingState = edgex_operatingstate_fromstring (op);
+  }
+  if (desc)
+  {
+    result->description = strdup (desc);
+  }
+  if (labels)
+  {
+    result->hasLabels = true;
+    result->labels = array_to_strings (labels);
+  }
+  return result;
+}
+
+void edgex_device_changes_free (edgex_device_changes *c)
+{
+  if (c)
+  {
+    free (c->description);
+    edgex_strings_free (c->labels);
+    free (c);
+  }
+}
+
 char *edgex_device_write (const edgex_device *e, bool create)
 {
   char *result;
@@ -1484,28 +1605,506 @@ char *edgex_device_write_sparse
   return json;
 }
 
-edgex_device *edgex_devices_read (iot_logger_t *lc, const char *json)
+/*
+ * Incremental device list reader. Devices are built directly from the
+ * reader's events; only the profile and service of each device are taken as
+ * text and parsed on their own. Those are usually the same for many devices,
+ * so each distinct text is parsed once, and copied for further devices.
+ */
+
+typedef enum
+{
+  DEVREAD_NAME,
+  DEVREAD_ID,
+  DEVREAD_DESCRIPTION,
+  DEVREAD_ADMINSTATE,
+  DEVREAD_OPSTATE,
+  DEVREAD_CREATED,
+  DEVREAD_MODIFIED,
+  DEVREAD_ORIGIN,
+  DEVREAD_LASTCONNECTED,
+  DEVREAD_LASTREPORTED,
+  DEVREAD_LABELS,
+  DEVREAD_PROTOCOLS,
+  DEVREAD_AUTOEVENTS,
+  DEVREAD_PROFILE,
+  DEVREAD_SERVICE,
+  DEVREAD_OTHER
+} devread_member;
+
+static const char *devread_members[] =
+{
+  "name", "id", "description", "adminState", "operatingState", "created", "modified", "origin",
+  "lastConnected", "lastReported", "labels", "protocols", "autoEvents", "profile", "service"
+};
+
+typedef enum
+{
+  AEREAD_RESOURCE,
+  AEREAD_FREQUENCY,
+  AEREAD_ONCHANGE,
+  AEREAD_DEADBAND,
+  AEREAD_DEADBANDPERCENT,
+  AEREAD_HEARTBEAT,
+  AEREAD_CRON,
+  AEREAD_ALIGN,
+  AEREAD_OTHER
+} aeread_field;
+
+static const char *aeread_fields[] =
+  { "resource", "frequency", "onChange", "deadband", "deadbandPercent", "heartbeat", "cron", "align" };
+
+typedef edgex_map(edgex_deviceprofile *) edgex_map_devread_profile;
+typedef edgex_map(edgex_deviceservice *) edgex_map_devread_service;
+
+struct edgex_devices_reader_t
+{
+  iot_logger_t *lc;
+  edgex_jsonsax_t *sax;
+  edgex_devices_reader_handler handler;
+  void *ctx;
+  unsigned depth;
+  unsigned skipdepth;
+  bool skipping;
+  devread_member member;
+  aeread_field field;
+  char *key;
+  edgex_device *dev;
+  unsigned index;
+  bool gotprofile;
+  bool gotservice;
+  edgex_strings **label;
+  edgex_map_devread_profile profiles;
+  edgex_map_devread_service services;
+};
+
+static unsigned devread_lookup (const char *const *names, unsigned n, const char *key)
 {
-  edgex_device *result = NULL;
-  JSON_Value *val = json_parse_string (json);
-  JSON_Array *array = json_value_get_array (val);
-  edgex_device **last_ptr = &result;
+  unsigned i;
+  for (i = 0; i < n; i++)
+  {
+    if (strcmp (names[i], key) == 0)
+    {
+      break;
+    }
+  }
+  return i;
+}
 
-  if (array)
+/* Integers as json_object_get_uint would return them */
+
+static uint64_t devread_uint (const char *text)
+{
+  char *end;
+  unsigned long long u;
+  errno = 0;
+  u = strtoull (text, &end, 10);
+  return (errno || *end) ? 0 : u;
+}
+
+static void devread_setstring (char **dest, const char *text)
+{
+  free (*dest);
+  *dest = strdup (text);
+}
+
+/* As for device_read, a profile or service which is not an object is read as an empty one */
+
+static edgex_deviceprofile *devread_profile (edgex_devices_reader_t *r, const char *json)
+{
+  edgex_deviceprofile **cached = edgex_map_get (&r->profiles, json);
+  if (cached == NULL)
+  {
+    JSON_Value *val;
+    edgex_arena_begin ();
+    val = json_parse_string (json);
+    edgex_map_set (&r->profiles, json, deviceprofile_read (r->lc, json_value_get_object (val)));
+    json_value_free (val);
+    edgex_arena_end ();
+    cached = edgex_map_get (&r->profiles, json);
+  }
+  return *cached ? edgex_deviceprofile_dup (*cached) : NULL;
+}
+
+static edgex_deviceservice *devread_service (edgex_devices_reader_t *r, const char *json)
+{
+  edgex_deviceservice **cached = edgex_map_get (&r->services, json);
+  if (cached == NULL)
+  {
+    JSON_Value *val;
+    edgex_arena_begin ();
+    val = json_parse_string (json);
+    edgex_map_set (&r->services, json, deviceservice_read (json_value_get_object (val)));
+    json_value_free (val);
+    edgex_arena_end ();
+    cached = edgex_map_get (&r->services, json);
+  }
+  return edgex_deviceservice_dup (*cached);
+}
+
+static void devread_start (edgex_devices_reader_t *r)
+{
+  edgex_device *dev = calloc (1, sizeof (edgex_device));
+  dev->adminState = edgex_adminstate_fromstring (NULL);
+  dev->operatingState = edgex_operatingstate_fromstring (NULL);
+  r->dev = dev;
+  r->gotprofile = false;
+  r->gotservice = false;
+  r->label = &dev->labels;
+}
+
+static void devread_complete (edgex_devices_reader_t *r)
+{
+  edgex_device *dev = r->dev;
+
+  r->dev = NULL;
+  r->index++;
+  if (!r->gotprofile)
+  {
+    dev->profile = deviceprofile_read (r->lc, NULL);
+  }
+  if (dev->profile == NULL)
+  {
+    if (dev->name && *dev->name)
+    {
+      iot_log_error (r->lc, "Device %s has an invalid profile: will not be processed", dev->name);
+    }
+    else if (dev->id && *dev->id)
+    {
+      iot_log_error (r->lc, "Device with id %s has an invalid profile: will not be processed", dev->id);
+    }
+    else
+    {
+      iot_log_error (r->lc, "Device %u in list has an invalid profile: will not be processed", r->index);
+    }
+    edgex_device_free (dev);
+    return;
+  }
+  if (dev->name == NULL)
+  {
+    dev->name = strdup ("");
+  }
+  if (dev->id == NULL)
+  {
+    dev->id = strdup ("");
+  }
+  if (dev->description == NULL)
+  {
+    dev->description = strdup ("");
+  }
+  if (!r->gotservice)
+  {
+    dev->service = deviceservice_read (NULL);
+  }
+  r->handler (r->ctx, dev);
+}
+
+/* A scalar member of the device */
+
+static void devread_value (edgex_devices_reader_t *r, edgex_json_event ev, const char *text)
+{
+  edgex_device *dev = r->dev;
+
+  if (ev == EDGEX_JSON_STRING)
   {
-    size_t count = json_array_get_count (array);
-    for (size_t i = 0; i < count; i++)
+    switch (r->member)
     {
-      edgex_device *temp = device_read (lc, json_array_get_object (array, i));
-      if (temp)
+      case DEVREAD_NAME: devread_setstring (&dev->name, text); break;
+      case DEVREAD_ID: devread_setstring (&dev->id, text); break;
+      case DEVREAD_DESCRIPTION: devread_setstring (&dev->description, text); break;
+      case DEVREAD_ADMINSTATE: dev->adminState = edgex_adminstate_fromstring (text); break;
+      case DEVREAD_OPSTATE: dev->operatingState = edgex_operatingstate_fromstring (text); break;
+      default: break;
+    }
+  }
+  else if (ev == EDGEX_JSON_NUMBER)
+  {
+    switch (r->member)
+    {
+      case DEVREAD_CREATED: dev->created = devread_uint (text); break;
+      case DEVREAD_MODIFIED: dev->modified = devread_uint (text); break;
+      case DEVREAD_ORIGIN: dev->origin = devread_uint (text); break;
+      case DEVREAD_LASTCONNECTED: dev->lastConnected = devread_uint (text); break;
+      case DEVREAD_LASTREPORTED: dev->lastReported = devread_uint (text); break;
+      default: break;
+    }
+  }
+  else if (ev == EDGEX_JSON_RAW)
+  {
+    if (r->member == DEVREAD_PROFILE)
+    {
+      edgex_deviceprofile_free (dev->profile);
+      dev->profile = devread_profile (r, text);
+      r->gotprofile = true;
+    }
+    else if (r->member == DEVREAD_SERVICE)
+    {
+      edgex_deviceservice_free (dev->service);
+      dev->service = devread_service (r, text);
+      r->gotservice = true;
+    }
+  }
+}
+
+/* An element of a labels, protocols or autoEvents member. Returns false if its contents are to be skipped */
+
+static bool devread_element (edgex_devices_reader_t *r, edgex_json_event ev, const char *text)
+{
+  edgex_device *dev = r->dev;
+
+  switch (r->member)
+  {
+    case DEVREAD_LABELS:
+    {
+      edgex_strings *s = malloc (sizeof (edgex_strings));
+      s->str = strdup (ev == EDGEX_JSON_STRING ? text : "");
+      s->next = NULL;
+      *r->label = s;
+      r->label = &s->next;
+      return ev == EDGEX_JSON_STRING;
+    }
+    case DEVREAD_PROTOCOLS:
+      if (ev == EDGEX_JSON_KEY)
+      {
+        edgex_protocols *prot = malloc (sizeof (edgex_protocols));
+        prot->name = strdup (text);
+        prot->properties = NULL;
+        prot->next = dev->protocols;
+        dev->protocols = prot;
+        return true;
+      }
+      return ev == EDGEX_JSON_OBJECT;
+    case DEVREAD_AUTOEVENTS:
+      if (ev == EDGEX_JSON_OBJECT)
+      {
+        edgex_device_autoevents *ae = calloc (1, sizeof (edgex_device_autoevents));
+        ae->resource = strdup ("");
+        ae->frequency = strdup ("");
+        ae->next = dev->autos;
+        dev->autos = ae;
+        return true;
+      }
+      return false;
+    default:
+      return false;
+  }
+}
+
+/* A member of a protocol or an AutoEvent */
+
+static void devread_field (edgex_devices_reader_t *r, edgex_json_event ev, const char *text)
+{
+  if (r->member == DEVREAD_PROTOCOLS)
+  {
+    if (ev == EDGEX_JSON_KEY)
+    {
+      devread_setstring (&r->key, text);
+    }
+    else if (ev == EDGEX_JSON_STRING)
+    {
+      edgex_nvpairs *nv = malloc (sizeof (edgex_nvpairs));
+      nv->name = strdup (r->key);
+      nv->value = strdup (text);
+      nv->next = r->dev->protocols->properties;
+      r->dev->protocols->properties = nv;
+    }
+  }
+  else
+  {
+    edgex_device_autoevents *ae = r->dev->autos;
+    if (ev == EDGEX_JSON_KEY)
+    {
+      r->field = devread_lookup (aeread_fields, AEREAD_OTHER, text);
+    }
+    else if (ev == EDGEX_JSON_STRING)
+    {
+      switch (r->field)
+      {
+        case AEREAD_RESOURCE: devread_setstring (&ae->resource, text); break;
+        case AEREAD_FREQUENCY: devread_setstring (&ae->frequency, text); break;
+        case AEREAD_HEARTBEAT: devread_setstring (&ae->heartbeat, text); break;
+        case AEREAD_CRON: devread_setstring (&ae->cron, text); break;
+        default: break;
+      }
+    }
+    else if (ev == EDGEX_JSON_TRUE || ev == EDGEX_JSON_FALSE)
+    {
+      if (r->field == AEREAD_ONCHANGE)
+      {
+        ae->onChange = (ev == EDGEX_JSON_TRUE);
+      }
+      else if (r->field == AEREAD_ALIGN)
       {
-        *last_ptr = temp;
-        last_ptr = &(temp->next);
+        ae->align = (ev == EDGEX_JSON_TRUE);
+      }
+    }
+    else if (ev == EDGEX_JSON_NUMBER)
+    {
+      if (r->field == AEREAD_DEADBAND)
+      {
+        ae->deadband = strtod (text, NULL);
+      }
+      else if (r->field == AEREAD_DEADBANDPERCENT)
+      {
+        ae->deadbandPercent = strtod (text, NULL);
       }
     }
   }
+}
 
-  json_value_free (val);
+/*
+ * Depths: 1 is the list, 2 a device, 3 the contents of a labels, protocols
+ * or autoEvents member, 4 the contents of a protocol or an AutoEvent. Values
+ * which are not of interest are skipped, along with anything they contain.
+ */
+
+static bool devread_event (void *ctx, edgex_json_event ev, const char *text, size_t len)
+{
+  edgex_devices_reader_t *r = (edgex_devices_reader_t *)ctx;
+  bool open = (ev == EDGEX_JSON_OBJECT || ev == EDGEX_JSON_ARRAY);
+  bool close = (ev == EDGEX_JSON_OBJECT_END || ev == EDGEX_JSON_ARRAY_END);
+  unsigned depth = open ? r->depth++ : close ? --r->depth : r->depth;
+
+  if (r->skipping)
+  {
+    if (close && depth == r->skipdepth)
+    {
+      r->skipping = false;
+    }
+    return true;
+  }
+
+  switch (depth)
+  {
+    case 0:
+      return ev == EDGEX_JSON_ARRAY || ev == EDGEX_JSON_ARRAY_END;
+    case 1:
+      if (ev == EDGEX_JSON_OBJECT)
+      {
+        devread_start (r);
+        return true;
+      }
+      if (ev == EDGEX_JSON_OBJECT_END)
+      {
+        devread_complete (r);
+        return true;
+      }
+      r->index++;
+      iot_log_error (r->lc, "Device %u in list is not a JSON object: will not be processed", r->index);
+      break;
+    case 2:
+      if (ev == EDGEX_JSON_KEY)
+      {
+        r->member = devread_lookup (devread_members, DEVREAD_OTHER, text);
+        if (r->member == DEVREAD_PROFILE || r->member == DEVREAD_SERVICE)
+        {
+          edgex_jsonsax_capture (r->sax);
+        }
+        return true;
+      }
+      if (close)
+      {
+        return true;
+      }
+      if (ev == EDGEX_JSON_ARRAY && (r->member == DEVREAD_LABELS || r->member == DEVREAD_AUTOEVENTS))
+      {
+        return true;
+      }
+      if (ev == EDGEX_JSON_OBJECT && r->member == DEVREAD_PROTOCOLS)
+      {
+        return true;
+      }
+      devread_value (r, ev, text);
+      break;
+    case 3:
+      if (close || devread_element (r, ev, text))
+      {
+        return true;
+      }
+      break;
+    case 4:
+      if (r->member == DEVREAD_PROTOCOLS || r->member == DEVREAD_AUTOEVENTS)
+      {
+        devread_field (r, ev, text);
+      }
+      break;
+    default:
+      break;
+  }
+  if (open)
+  {
+    r->skipping = true;
+    r->skipdepth = depth;
+  }
+  return true;
+}
+
+edgex_devices_reader_t *edgex_devices_reader_alloc
+  (iot_logger_t *lc, edgex_devices_reader_handler handler, void *ctx)
+{
+  edgex_devices_reader_t *r = calloc (1, sizeof (edgex_devices_reader_t));
+  r->lc = lc;
+  r->handler = handler;
+  r->ctx = ctx;
+  r->sax = edgex_jsonsax_alloc (devread_event, r);
+  edgex_map_init (&r->profiles);
+  edgex_map_init (&r->services);
+  return r;
+}
+
+bool edgex_devices_reader_feed (edgex_devices_reader_t *r, const char *json, size_t len)
+{
+  return edgex_jsonsax_feed (r->sax, json, len);
+}
+
+bool edgex_devices_reader_finish (edgex_devices_reader_t *r)
+{
+  return edgex_jsonsax_finish (r->sax);
+}
+
+void edgex_devices_reader_free (edgex_devices_reader_t *r)
+{
+  if (r)
+  {
+    const char *key;
+    edgex_map_iter i = edgex_map_iter (r->profiles);
+    while ((key = edgex_map_next (&r->profiles, &i)))
+    {
+      edgex_deviceprofile_free (*edgex_map_get (&r->profiles, key));
+    }
+    i = edgex_map_iter (r->services);
+    while ((key = edgex_map_next (&r->services, &i)))
+    {
+      edgex_deviceservice_free (*edgex_map_get (&r->services, key));
+    }
+    edgex_map_deinit (&r->profiles);
+    edgex_map_deinit (&r->services);
+    edgex_device_free (r->dev);
+    edgex_jsonsax_free (r->sax);
+    free (r->key);
+    free (r);
+  }
+}
+
+static void devices_append (void *ctx, edgex_device *dev)
+{
+  edgex_device ***last_ptr = (edgex_device ***)ctx;
+  **last_ptr = dev;
+  *last_ptr = &dev->next;
+}
+
+edgex_device *edgex_devices_read (iot_logger_t *lc, const char *json)
+{
+  edgex_device *result = NULL;
+  edgex_device **last_ptr = &result;
+  edgex_devices_reader_t *r = edgex_devices_reader_alloc (lc, devices_append, &last_ptr);
+
+  if (!edgex_devices_reader_feed (r, json, strlen (json)) || !edgex_devices_reader_finish (r))
+  {
+    edgex_device_free (result);
+    result = NULL;
+  }
+  edgex_devices_reader_free (r);
 
   return result;
 }
@@ -1513,9 +2112,11 @@ edgex_device *edgex_devices_read (iot_logger_t *lc, const char *json)
 edgex_addressable *edgex_addressable_read (const char *json)
 {
   edgex_addressable *result = NULL;
-  JSON_Value *val = json_parse_string (json);
+  JSON_Value *val;
   JSON_Object *obj;
 
+  edgex_arena_begin ();
+  val = json_parse_string (json);
   obj = json_value_get_object (val);
 
   if (obj)
@@ -1524,6 +2125,7 @@ edgex_addressable *edgex_addressable_read (const char *json)
   }
 
   json_value_free (val);
+  edgex_arena_end ();
 
   return result;
 }
@@ -1604,9 +2206,11 @@ void edgex_valuedescriptor_free (edgex_valuedescriptor *e)
 edgex_valuedescriptor *edgex_valuedescriptor_read (const char *json)
 {
   edgex_valuedescriptor *result = NULL;
-  JSON_Value *val = json_parse_string (json);
+  JSON_Value *val;
   JSON_Object *obj;
 
+  edgex_arena_begin ();
+  val = json_parse_string (json);
   obj = json_value_get_object (val);
 
   if (obj)
@@ -1615,6 +2219,7 @@ edgex_valuedescriptor *edgex_valuedescriptor_read (const char *json)
   }
 
   json_value_free (val);
+  edgex_arena_end ();
 
   return result;
 }
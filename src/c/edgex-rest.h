@@ -12,6 +12,7 @@
 #include "edgex/edgex.h"
 #include "edgex/edgex-logging.h"
 #include "data.h"
+#include "parson.h"
 
 edgex_strings *edgex_strings_dup (const edgex_strings *strs);
 void edgex_strings_free (edgex_strings *strs);
@@ -36,6 +37,34 @@ char *edgex_device_write_sparse (const char *name, const char *id, const char *d
 edgex_device *edgex_device_dup (const edgex_device *e);
 void edgex_device_free (edgex_device *e);
 edgex_device *edgex_devices_read (iot_logger_t *lc, const char *json);
+
+/* Changes to individual fields of a device, as may be given in a device callback */
+
+typedef struct edgex_device_changes
+{
+  bool hasAdminState;
+  edgex_device_adminstate adminState;
+  bool hasOperatingState;
+  edgex_device_operatingstate operatingState;
+  char *description;
+  bool hasLabels;
+  edgex_strings *labels;
+} edgex_device_changes;
+
+/* Returns NULL if the object contains none of adminState, operatingState, description and labels */
+
+edgex_device_changes *edgex_device_changes_read (const JSON_Object *obj);
+void edgex_device_changes_free (edgex_device_changes *c);
+
+/* Incremental reader for a JSON array of devices, supplied in pieces. Each device is passed to the handler once read */
+
+typedef void (*edgex_devices_reader_handler) (void *ctx, edgex_device *dev);
+typedef struct edgex_devices_reader_t edgex_devices_reader_t;
+edgex_devices_reader_t *edgex_devices_reader_alloc (iot_logger_t *lc, edgex_devices_reader_handler handler, void *ctx);
+bool edgex_devices_reader_feed (edgex_devices_reader_t *r, const char *json, size_t len);
+bool edgex_devices_reader_finish (edgex_devices_reader_t *r);
+void edgex_devices_reader_free (edgex_devices_reader_t *r);
+
 edgex_addressable *edgex_addressable_read (const char *json);
 char *edgex_addressable_write (const edgex_addressable *e, bool create);
 edgex_addressable *edgex_addressable_dup (const edgex_addressable *e);
@@ -8,6 +8,9 @@
 
 #include <time.h>
 #include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
 
 #include "edgex-time.h"
 
@@ -44,3 +47,121 @@ uint64_t edgex_device_nanotime_monotonic()
   } while (!atomic_compare_exchange_weak (&lasttime, &prev, result));
   return result;
 }
+
+static _Atomic(edgex_timesource) timesource = EDGEX_TIME_PRECISE;
+static _Thread_local uint64_t captured = 0;
+static _Thread_local unsigned capturedepth = 0;
+
+static const char *timesource_names[] = { "Precise", "Coarse", "Batch" };
+
+bool edgex_device_timesource_parse (const char *name, edgex_timesource *result)
+{
+  if (name == NULL || *name == '\0')
+  {
+    *result = EDGEX_TIME_PRECISE;
+    return true;
+  }
+  for (int i = EDGEX_TIME_PRECISE; i <= EDGEX_TIME_BATCH; i++)
+  {
+    if (strcasecmp (name, timesource_names[i]) == 0)
+    {
+      *result = i;
+      return true;
+    }
+  }
+  return false;
+}
+
+const char *edgex_device_timesource_name (edgex_timesource src)
+{
+  return timesource_names[src];
+}
+
+void edgex_device_timesource_set (edgex_timesource src)
+{
+  atomic_store (&timesource, src);
+}
+
+edgex_timesource edgex_device_timesource (void)
+{
+  return atomic_load (&timesource);
+}
+
+static uint64_t nanotime_coarse (void)
+{
+#ifdef CLOCK_REALTIME_COARSE
+  struct timespec ts;
+  if (clock_gettime (CLOCK_REALTIME_COARSE, &ts) == 0)
+  {
+    return (uint64_t)ts.tv_sec * EDGEX_NANOS + ts.tv_nsec;
+  }
+#endif
+  return edgex_device_nanotime ();
+}
+
+/* As edgex_device_nanotime_monotonic, for the coarse clock */
+
+static uint64_t nanotime_coarse_monotonic (void)
+{
+  static _Atomic(uint64_t) lasttime = 0;
+  uint64_t prev;
+  uint64_t result = nanotime_coarse ();
+  prev = lasttime;
+  do
+  {
+    if (result <= prev)
+    {
+      result = prev + 1;
+    }
+  } while (!atomic_compare_exchange_weak (&lasttime, &prev, result));
+  return result;
+}
+
+uint64_t edgex_device_origintime (void)
+{
+  switch (atomic_load (&timesource))
+  {
+    case EDGEX_TIME_BATCH:
+      return capturedepth ? captured : nanotime_coarse_monotonic ();
+    case EDGEX_TIME_COARSE:
+      return nanotime_coarse_monotonic ();
+    default:
+      return edgex_device_nanotime_monotonic ();
+  }
+}
+
+void edgex_device_origin_capture (void)
+{
+  if (capturedepth++ == 0 && atomic_load (&timesource) == EDGEX_TIME_BATCH)
+  {
+    captured = nanotime_coarse_monotonic ();
+  }
+}
+
+void edgex_device_origin_release (void)
+{
+  capturedepth--;
+}
+
+struct sfxstruct
+{
+  const char *str;
+  uint64_t factor;
+};
+
+static struct sfxstruct suffixes[] =
+  { { "ms", 1 }, { "s", 1000 }, { "m", 60000 }, { "h", 3600000 }, { NULL, 0 } };
+
+uint64_t edgex_device_parsetime (const char *spec)
+{
+  char *fend;
+  uint64_t fnum = strtoul (spec, &fend, 10);
+  for (int i = 0; suffixes[i].str; i++)
+  {
+    if (strcmp (fend, suffixes[i].str) == 0)
+    {
+      return fnum * suffixes[i].factor;
+    }
+  }
+  return 0;
+}
@@ -10,6 +10,7 @@
 #define _EDGEX_DEVICE_EX_TIME_H_ 1
 
 #include <inttypes.h>
+#include <stdbool.h>
 
 #define EDGEX_MILLIS 1000U
 #define EDGEX_MICROS 1000000U
@@ -19,4 +20,33 @@ extern uint64_t edgex_device_millitime (void);
 extern uint64_t edgex_device_nanotime (void);
 extern uint64_t edgex_device_nanotime_monotonic (void);
 
+/*
+ * The source of origin timestamps for events. Precise reads the real time
+ * clock for each event; Coarse reads the coarse real time clock, which is
+ * cheaper but has a resolution of a few milliseconds. In both cases
+ * successive timestamps are distinct. Batch captures a timestamp once for
+ * each batch of readings, which is shared by all events in the batch, and
+ * otherwise behaves as Coarse.
+ */
+
+typedef enum { EDGEX_TIME_PRECISE, EDGEX_TIME_COARSE, EDGEX_TIME_BATCH } edgex_timesource;
+
+extern bool edgex_device_timesource_parse (const char *name, edgex_timesource *result);
+extern const char *edgex_device_timesource_name (edgex_timesource src);
+extern void edgex_device_timesource_set (edgex_timesource src);
+extern edgex_timesource edgex_device_timesource (void);
+
+/* The origin timestamp for an event, in nanoseconds */
+
+extern uint64_t edgex_device_origintime (void);
+
+/* Share one origin timestamp between the events processed on this thread until released. Captures may nest */
+
+extern void edgex_device_origin_capture (void);
+extern void edgex_device_origin_release (void);
+
+/* Parse a time interval such as "500ms", "10s", "5m" or "1h". Returns the value in milliseconds, or 0 if invalid */
+
+extern uint64_t edgex_device_parsetime (const char *spec);
+
 #endif
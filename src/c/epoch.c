@@ -0,0 +1,198 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#include "epoch.h"
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <sched.h>
+
+#define EPOCH_CACHE_LINE 64
+
+/*
+ * Each thread which reads has a record, holding the epoch in which its
+ * current read section began, or zero when it is not reading. Records are
+ * cache line aligned so that readers on different cores do not contend.
+ * They are never freed; a record released by an exiting thread is reused.
+ */
+
+typedef struct epoch_reader
+{
+  _Alignas (EPOCH_CACHE_LINE) atomic_uint_fast64_t active;
+  atomic_bool inuse;
+  struct epoch_reader *next;
+} epoch_reader;
+
+/* Retired data, with the epoch begun once it was unpublished */
+
+typedef struct epoch_retired
+{
+  edgex_epoch_reclaim_fn fn;
+  void *p;
+  uint_fast64_t epoch;
+  struct epoch_retired *next;
+} epoch_retired;
+
+static atomic_uint_fast64_t epoch_global = 1;
+static _Atomic (epoch_reader *) epoch_readers = NULL;
+static _Thread_local epoch_reader *epoch_self = NULL;
+static pthread_key_t epoch_key;
+static pthread_once_t epoch_once = PTHREAD_ONCE_INIT;
+static pthread_mutex_t epoch_retirelock = PTHREAD_MUTEX_INITIALIZER;
+static epoch_retired *epoch_retiredlist = NULL;
+
+static void epoch_thread_exit (void *p)
+{
+  epoch_reader *r = (epoch_reader *)p;
+  atomic_store (&r->active, 0);
+  atomic_store (&r->inuse, false);
+}
+
+static void epoch_init (void)
+{
+  pthread_key_create (&epoch_key, epoch_thread_exit);
+}
+
+static epoch_reader *epoch_register (void)
+{
+  epoch_reader *r;
+
+  pthread_once (&epoch_once, epoch_init);
+  for (r = atomic_load (&epoch_readers); r; r = r->next)
+  {
+    bool free = false;
+    if (atomic_compare_exchange_strong (&r->inuse, &free, true))
+    {
+      break;
+    }
+  }
+  if (r == NULL)
+  {
+    r = aligned_alloc (EPOCH_CACHE_LINE, sizeof (epoch_reader));
+    atomic_init (&r->active, 0);
+    atomic_init (&r->inuse, true);
+    r->next = atomic_load (&epoch_readers);
+    while (!atomic_compare_exchange_weak (&epoch_readers, &r->next, r));
+  }
+  pthread_setspecific (epoch_key, r);
+  return r;
+}
+
+void edgex_epoch_enter (void)
+{
+  if (epoch_self == NULL)
+  {
+    epoch_self = epoch_register ();
+  }
+  atomic_store (&epoch_self->active, atomic_load (&epoch_global));
+}
+
+void edgex_epoch_exit (void)
+{
+  atomic_store_explicit (&epoch_self->active, 0, memory_order_release);
+}
+
+void edgex_epoch_synchronize (void)
+{
+  /* Readers which began before the epoch advanced may hold old data; wait for them to exit */
+
+  uint_fast64_t e = atomic_fetch_add (&epoch_global, 1) + 1;
+  for (epoch_reader *r = atomic_load (&epoch_readers); r; r = r->next)
+  {
+    uint_fast64_t a;
+    while ((a = atomic_load (&r->active)) && a < e)
+    {
+      sched_yield ();
+    }
+  }
+}
+
+void edgex_epoch_retire (edgex_epoch_reclaim_fn fn, void *p)
+{
+  epoch_retired *r = malloc (sizeof (epoch_retired));
+  r->fn = fn;
+  r->p = p;
+  r->epoch = atomic_fetch_add (&epoch_global, 1) + 1;
+  pthread_mutex_lock (&epoch_retirelock);
+  r->next = epoch_retiredlist;
+  epoch_retiredlist = r;
+  pthread_mutex_unlock (&epoch_retirelock);
+}
+
+/* The earliest epoch in which a current read section began, or UINT_FAST64_MAX if none is in progress */
+
+static uint_fast64_t epoch_oldest (void)
+{
+  uint_fast64_t result = UINT_FAST64_MAX;
+  for (epoch_reader *r = atomic_load (&epoch_readers); r; r = r->next)
+  {
+    uint_fast64_t a = atomic_load (&r->active);
+    if (a && a < result)
+    {
+      result = a;
+    }
+  }
+  return result;
+}
+
+/*
+ * Data retired in epoch e may be seen by readers which began before e, so it
+ * is safe to free once the oldest reader began no earlier. After synchronize
+ * that holds for all the data taken from the list.
+ */
+
+void edgex_epoch_reclaim (bool wait)
+{
+  epoch_retired *list;
+  epoch_retired *keep = NULL;
+  uint_fast64_t oldest;
+
+  pthread_mutex_lock (&epoch_retirelock);
+  list = epoch_retiredlist;
+  epoch_retiredlist = NULL;
+  pthread_mutex_unlock (&epoch_retirelock);
+  if (list == NULL)
+  {
+    return;
+  }
+  if (wait)
+  {
+    edgex_epoch_synchronize ();
+  }
+  oldest = wait ? UINT_FAST64_MAX : epoch_oldest ();
+  while (list)
+  {
+    epoch_retired *r = list;
+    list = r->next;
+    if (r->epoch <= oldest)
+    {
+      r->fn (r->p);
+      free (r);
+    }
+    else
+    {
+      r->next = keep;
+      keep = r;
+    }
+  }
+  if (keep)
+  {
+    epoch_retired *last = keep;
+    pthread_mutex_lock (&epoch_retirelock);
+    while (last->next)
+    {
+      last = last->next;
+    }
+    last->next = epoch_retiredlist;
+    epoch_retiredlist = keep;
+    pthread_mutex_unlock (&epoch_retirelock);
+  }
+}
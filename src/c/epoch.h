@@ -0,0 +1,42 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#ifndef _EDGEX_DEVICE_EPOCH_H_
+#define _EDGEX_DEVICE_EPOCH_H_ 1
+
+/*
+ * Epoch-based reclamation. Readers bracket their access to shared data with
+ * enter and exit, which touch only a record private to the calling thread.
+ * A writer which has unpublished some data calls synchronize, which returns
+ * once every reader that might still see that data has exited, after which
+ * the data may be freed. Read sections must be short, must not nest and must
+ * not call synchronize.
+ *
+ * Rather than wait, a writer may retire the data it has unpublished, which
+ * is passed to the given function once no reader can still see it. Retire
+ * never waits, so it may be called with locks held. Reclaim calls the
+ * functions for retired data which has become safe to free, first waiting
+ * for the readers of all of it if wait is set. It must not be called within
+ * a read section, and is best called with no locks held.
+ */
+
+#include <stdbool.h>
+
+typedef void (*edgex_epoch_reclaim_fn) (void *p);
+
+void edgex_epoch_enter (void);
+
+void edgex_epoch_exit (void);
+
+void edgex_epoch_synchronize (void);
+
+void edgex_epoch_retire (edgex_epoch_reclaim_fn fn, void *p);
+
+void edgex_epoch_reclaim (bool wait);
+
+#endif
@@ -0,0 +1,591 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#include "eventring.h"
+#include "errorlist.h"
+
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdatomic.h>
+#include <string.h>
+#include <strings.h>
+#include <limits.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+#define RING_ALIGN(n) (((n) + 7) & ~(uint64_t)7)
+#define RING_MODE 0660
+
+/*
+ * A reader checks the tail after reading a record; the tail is advanced past
+ * a record before it is overwritten, with a fence between, so a reader which
+ * saw any overwritten data also sees the new tail.
+ */
+
+/*
+ * The header as the SDK accesses it. The public edgex_eventring_header has
+ * the same layout without the atomic qualifiers, so that the layout can be
+ * described to readers not built with C11 atomics.
+ */
+
+typedef struct ring_header
+{
+  uint32_t magic;
+  uint32_t version;
+  uint64_t size;
+  _Atomic uint64_t head;
+  _Atomic uint64_t tail;
+  atomic_uint notify;
+  atomic_uint waiters;
+} ring_header;
+
+_Static_assert (sizeof (ring_header) == sizeof (edgex_eventring_header), "EventRing header size mismatch");
+_Static_assert
+  (offsetof (ring_header, head) == offsetof (edgex_eventring_header, head), "EventRing header layout mismatch");
+_Static_assert
+  (offsetof (ring_header, notify) == offsetof (edgex_eventring_header, notify), "EventRing header layout mismatch");
+_Static_assert
+  (offsetof (ring_header, waiters) == offsetof (edgex_eventring_header, waiters), "EventRing header layout mismatch");
+
+struct edgex_eventring_t
+{
+  char *name;
+  edgex_eventring_format format;
+  ring_header *hdr;
+  unsigned char *data;
+  uint64_t size;
+  size_t maplen;
+  uint64_t seq;
+  uint64_t written;
+  uint64_t dropped;
+  uint64_t overwritten;
+  pthread_mutex_t lock;
+};
+
+struct edgex_eventring_reader
+{
+  ring_header *hdr;
+  const unsigned char *data;
+  size_t maplen;
+  uint64_t size;
+  bool writable;
+  uint64_t pos;
+  uint64_t cur;
+  uint64_t seq;
+  uint64_t lost;
+};
+
+static const char *formatnames[] = { "Events", "Readings" };
+
+/* Shared memory object names have a leading slash, which is supplied if not configured */
+
+static char *ring_objname (const char *name)
+{
+  char *result = malloc (strlen (name) + 2);
+  result[0] = '/';
+  strcpy (result + 1, name[0] == '/' ? name + 1 : name);
+  return result;
+}
+
+static size_t ring_strsize (const char *s)
+{
+  return s ? strlen (s) + 1 : 1;
+}
+
+static char *ring_putstr (char *dest, const char *s, size_t len)
+{
+  if (s)
+  {
+    memcpy (dest, s, len);
+  }
+  else
+  {
+    *dest = '\0';
+  }
+  return dest + len;
+}
+
+/* Reserve len bytes at the head, overwriting the oldest records as needed. Returns the new head. Called with the lock held */
+
+static uint64_t ring_reserve (edgex_eventring_t *r, uint64_t len, edgex_eventring_record **rec)
+{
+  uint64_t head = atomic_load_explicit (&r->hdr->head, memory_order_relaxed);
+  uint64_t off = head % r->size;
+  uint64_t start = (off + len > r->size) ? head + (r->size - off) : head;
+  uint64_t end = start + len;
+  uint64_t tail = atomic_load_explicit (&r->hdr->tail, memory_order_relaxed);
+
+  if (end > r->size && tail < end - r->size)
+  {
+    while (tail < end - r->size)
+    {
+      const edgex_eventring_record *old = (const edgex_eventring_record *)(r->data + tail % r->size);
+      if (old->kind != EDGEX_EVENTRING_PAD)
+      {
+        r->overwritten++;
+      }
+      tail += old->length;
+    }
+    atomic_store_explicit (&r->hdr->tail, tail, memory_order_relaxed);
+    atomic_thread_fence (memory_order_release);
+  }
+
+  if (start != head)
+  {
+    edgex_eventring_record *pad = (edgex_eventring_record *)(r->data + off);
+    pad->length = r->size - off;
+    pad->kind = EDGEX_EVENTRING_PAD;
+  }
+  *rec = (edgex_eventring_record *)(r->data + start % r->size);
+  return end;
+}
+
+static void ring_commit (edgex_eventring_t *r, uint64_t end)
+{
+  atomic_store_explicit (&r->hdr->head, end, memory_order_release);
+  atomic_fetch_add (&r->hdr->notify, 1);
+  if (atomic_load (&r->hdr->waiters))
+  {
+    syscall (SYS_futex, &r->hdr->notify, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+  }
+}
+
+static uint64_t ring_reading_size (const edgex_device_commandrequest *req, const edgex_device_commandresult *val)
+{
+  uint64_t len = sizeof (edgex_eventring_reading) + strlen (req->resname) + 1;
+  if (val->type == String)
+  {
+    len += strlen (val->value.string_result) + 1;
+  }
+  else if (val->type == Binary)
+  {
+    len += val->value.binary_result.size;
+  }
+  return RING_ALIGN (len);
+}
+
+static void ring_put_reading
+(
+  edgex_eventring_reading *rd,
+  uint64_t len,
+  const edgex_device_commandrequest *req,
+  const edgex_device_commandresult *val,
+  uint64_t origin
+)
+{
+  size_t namelen = strlen (req->resname) + 1;
+  char *p = (char *)(rd + 1);
+
+  rd->length = len;
+  rd->type = val->type;
+  rd->namelen = namelen;
+  rd->origin = val->origin ? val->origin : origin;
+  rd->size = 0;
+  rd->value.ui64 = 0;
+  p = ring_putstr (p, req->resname, namelen);
+  switch (val->type)
+  {
+    case Bool: rd->value.b = val->value.bool_result; break;
+    case Uint8: rd->value.ui8 = val->value.ui8_result; break;
+    case Uint16: rd->value.ui16 = val->value.ui16_result; break;
+    case Uint32: rd->value.ui32 = val->value.ui32_result; break;
+    case Uint64: rd->value.ui64 = val->value.ui64_result; break;
+    case Int8: rd->value.i8 = val->value.i8_result; break;
+    case Int16: rd->value.i16 = val->value.i16_result; break;
+    case Int32: rd->value.i32 = val->value.i32_result; break;
+    case Int64: rd->value.i64 = val->value.i64_result; break;
+    case Float32: rd->value.f32 = val->value.f32_result; break;
+    case Float64: rd->value.f64 = val->value.f64_result; break;
+    case String:
+      rd->size = strlen (val->value.string_result) + 1;
+      memcpy (p, val->value.string_result, rd->size);
+      break;
+    case Binary:
+      rd->size = val->value.binary_result.size;
+      memcpy (p, val->value.binary_result.bytes, rd->size);
+      break;
+  }
+}
+
+void edgex_eventring_put
+(
+  edgex_eventring_t *ring,
+  const char *device,
+  const edgex_cmdinfo *cmd,
+  const edgex_device_commandresult *values,
+  uint64_t origin,
+  const edgex_event_cooked *event
+)
+{
+  edgex_eventring_record *rec;
+  size_t devlen = ring_strsize (device);
+  size_t srclen = ring_strsize (cmd->name);
+  uint64_t hdrlen = RING_ALIGN (sizeof (edgex_eventring_record) + devlen + srclen);
+  uint64_t datalen = 0;
+  const void *data = NULL;
+  uint16_t kind;
+  uint64_t end;
+
+  if (ring->format == EDGEX_EVENTRING_TYPED)
+  {
+    kind = EDGEX_EVENTRING_READINGS;
+    for (unsigned i = 0; i < cmd->nreqs; i++)
+    {
+      datalen += ring_reading_size (&cmd->reqs[i], &values[i]);
+    }
+  }
+  else if (event->encoding == JSON)
+  {
+    kind = EDGEX_EVENTRING_JSON;
+    data = event->value.json;
+    datalen = strlen (event->value.json) + 1;
+  }
+  else
+  {
+    kind = EDGEX_EVENTRING_CBOR;
+    data = edgex_event_cooked_cbor (event);
+    datalen = event->value.cbor.length;
+  }
+
+  pthread_mutex_lock (&ring->lock);
+  if
+  (
+    hdrlen + RING_ALIGN (datalen) > ring->size / 2 || hdrlen + RING_ALIGN (datalen) > UINT32_MAX ||
+    devlen > UINT16_MAX || srclen > UINT16_MAX
+  )
+  {
+    ring->dropped++;
+    pthread_mutex_unlock (&ring->lock);
+    return;
+  }
+
+  end = ring_reserve (ring, hdrlen + RING_ALIGN (datalen), &rec);
+  rec->length = hdrlen + RING_ALIGN (datalen);
+  rec->kind = kind;
+  rec->count = (kind == EDGEX_EVENTRING_READINGS) ? cmd->nreqs : 0;
+  rec->seq = ++ring->seq;
+  rec->origin = origin;
+  rec->devlen = devlen;
+  rec->srclen = srclen;
+  rec->datalen = (kind == EDGEX_EVENTRING_JSON) ? datalen - 1 : datalen;
+  ring_putstr (ring_putstr ((char *)(rec + 1), device, devlen), cmd->name, srclen);
+
+  if (kind == EDGEX_EVENTRING_READINGS)
+  {
+    unsigned char *p = (unsigned char *)rec + hdrlen;
+    for (unsigned i = 0; i < cmd->nreqs; i++)
+    {
+      uint64_t len = ring_reading_size (&cmd->reqs[i], &values[i]);
+      ring_put_reading ((edgex_eventring_reading *)p, len, &cmd->reqs[i], &values[i], origin);
+      p += len;
+    }
+  }
+  else
+  {
+    memcpy ((unsigned char *)rec + hdrlen, data, datalen);
+  }
+  ring->written++;
+  ring_commit (ring, end);
+  pthread_mutex_unlock (&ring->lock);
+}
+
+edgex_eventring_t *edgex_eventring_alloc
+  (iot_logger_t *lc, const char *name, uint32_t size, const char *format, edgex_error *err)
+{
+  edgex_eventring_t *ring;
+  edgex_eventring_format fmt = EDGEX_EVENTRING_EVENTS;
+  char *objname;
+  size_t maplen;
+  void *map;
+  int fd;
+
+  if (format && *format)
+  {
+    if (strcasecmp (format, formatnames[EDGEX_EVENTRING_TYPED]) == 0)
+    {
+      fmt = EDGEX_EVENTRING_TYPED;
+    }
+    else if (strcasecmp (format, formatnames[EDGEX_EVENTRING_EVENTS]) != 0)
+    {
+      iot_log_error (lc, "Invalid EventRing Format %s", format);
+      *err = EDGEX_BAD_CONFIG;
+      return NULL;
+    }
+  }
+
+  objname = ring_objname (name);
+  maplen = EDGEX_EVENTRING_DATA + (size_t)(size ? size : EDGEX_EVENTRING_DEFAULT_SIZE) * 1024;
+  shm_unlink (objname);
+  fd = shm_open (objname, O_RDWR | O_CREAT | O_EXCL, RING_MODE);
+  if (fd == -1 || ftruncate (fd, maplen) != 0)
+  {
+    iot_log_error (lc, "EventRing: unable to create shared memory object %s", objname);
+    if (fd != -1)
+    {
+      close (fd);
+      shm_unlink (objname);
+    }
+    free (objname);
+    *err = EDGEX_BAD_CONFIG;
+    return NULL;
+  }
+  map = mmap (NULL, maplen, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close (fd);
+  if (map == MAP_FAILED)
+  {
+    iot_log_error (lc, "EventRing: unable to map %s", objname);
+    shm_unlink (objname);
+    free (objname);
+    *err = EDGEX_BAD_CONFIG;
+    return NULL;
+  }
+
+  ring = calloc (1, sizeof (edgex_eventring_t));
+  ring->name = objname;
+  ring->format = fmt;
+  ring->maplen = maplen;
+  ring->size = maplen - EDGEX_EVENTRING_DATA;
+  ring->hdr = (ring_header *)map;
+  ring->data = (unsigned char *)map + EDGEX_EVENTRING_DATA;
+  ring->hdr->size = ring->size;
+  atomic_init (&ring->hdr->head, 0);
+  atomic_init (&ring->hdr->tail, 0);
+  atomic_init (&ring->hdr->notify, 0);
+  atomic_init (&ring->hdr->waiters, 0);
+  ring->hdr->version = EDGEX_EVENTRING_VERSION;
+  atomic_thread_fence (memory_order_release);
+  ring->hdr->magic = EDGEX_EVENTRING_MAGIC;
+  pthread_mutex_init (&ring->lock, NULL);
+  return ring;
+}
+
+void edgex_eventring_getstats (edgex_eventring_t *ring, edgex_eventring_stats *stats)
+{
+  pthread_mutex_lock (&ring->lock);
+  stats->written = ring->written;
+  stats->dropped = ring->dropped;
+  stats->overwritten = ring->overwritten;
+  pthread_mutex_unlock (&ring->lock);
+}
+
+const char *edgex_eventring_name (const edgex_eventring_t *ring)
+{
+  return ring->name;
+}
+
+const char *edgex_eventring_formatname (const edgex_eventring_t *ring)
+{
+  return formatnames[ring->format];
+}
+
+void edgex_eventring_free (edgex_eventring_t *ring)
+{
+  if (ring)
+  {
+    munmap (ring->hdr, ring->maplen);
+    shm_unlink (ring->name);
+    pthread_mutex_destroy (&ring->lock);
+    free (ring->name);
+    free (ring);
+  }
+}
+
+/* Reader */
+
+edgex_eventring_reader *edgex_eventring_open (const char *name)
+{
+  edgex_eventring_reader *r = NULL;
+  char *objname = ring_objname (name);
+  bool writable = true;
+  struct stat st;
+  void *map;
+  int fd;
+
+  fd = shm_open (objname, O_RDWR, 0);
+  if (fd == -1)
+  {
+    writable = false;
+    fd = shm_open (objname, O_RDONLY, 0);
+  }
+  free (objname);
+  if (fd == -1)
+  {
+    return NULL;
+  }
+  if (fstat (fd, &st) != 0 || st.st_size <= EDGEX_EVENTRING_DATA)
+  {
+    close (fd);
+    return NULL;
+  }
+  map = mmap (NULL, st.st_size, writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0);
+  close (fd);
+  if (map == MAP_FAILED)
+  {
+    return NULL;
+  }
+
+  ring_header *hdr = (ring_header *)map;
+  if
+  (
+    hdr->magic != EDGEX_EVENTRING_MAGIC || hdr->version != EDGEX_EVENTRING_VERSION ||
+    hdr->size + EDGEX_EVENTRING_DATA > (uint64_t)st.st_size
+  )
+  {
+    munmap (map, st.st_size);
+    return NULL;
+  }
+  atomic_thread_fence (memory_order_acquire);
+
+  r = calloc (1, sizeof (edgex_eventring_reader));
+  r->hdr = hdr;
+  r->data = (const unsigned char *)map + EDGEX_EVENTRING_DATA;
+  r->maplen = st.st_size;
+  r->size = hdr->size;
+  r->writable = writable;
+  r->pos = atomic_load_explicit (&hdr->head, memory_order_acquire);
+  return r;
+}
+
+const edgex_eventring_record *edgex_eventring_next (edgex_eventring_reader *r)
+{
+  while (true)
+  {
+    const edgex_eventring_record *rec;
+    uint64_t head = atomic_load_explicit (&r->hdr->head, memory_order_acquire);
+    uint64_t tail = atomic_load_explicit (&r->hdr->tail, memory_order_acquire);
+    uint32_t len;
+    uint16_t kind;
+    uint64_t seq;
+
+    if (r->pos < tail)
+    {
+      r->pos = tail;
+    }
+    if (r->pos >= head)
+    {
+      return NULL;
+    }
+
+    rec = (const edgex_eventring_record *)(r->data + r->pos % r->size);
+    len = rec->length;
+    kind = rec->kind;
+    seq = rec->seq;
+    atomic_thread_fence (memory_order_acquire);
+    if (atomic_load_explicit (&r->hdr->tail, memory_order_relaxed) > r->pos)
+    {
+      continue;
+    }
+    if (len < 8 || len % 8 || r->pos % r->size + len > r->size)
+    {
+      r->pos = head;
+      return NULL;
+    }
+
+    r->cur = r->pos;
+    r->pos += len;
+    if (kind != EDGEX_EVENTRING_PAD)
+    {
+      if (r->seq && seq > r->seq)
+      {
+        r->lost += seq - r->seq;
+      }
+      r->seq = seq + 1;
+      return rec;
+    }
+  }
+}
+
+bool edgex_eventring_valid (edgex_eventring_reader *r)
+{
+  atomic_thread_fence (memory_order_acquire);
+  return atomic_load_explicit (&r->hdr->tail, memory_order_relaxed) <= r->cur;
+}
+
+bool edgex_eventring_wait (edgex_eventring_reader *r, uint32_t timeout)
+{
+  if (r->writable)
+  {
+    struct timespec ts = { timeout / 1000, (timeout % 1000) * 1000000 };
+    atomic_fetch_add (&r->hdr->waiters, 1);
+    unsigned v = atomic_load (&r->hdr->notify);
+    if (atomic_load (&r->hdr->head) <= r->pos)
+    {
+      syscall (SYS_futex, &r->hdr->notify, FUTEX_WAIT, v, &ts, NULL, 0);
+    }
+    atomic_fetch_sub (&r->hdr->waiters, 1);
+  }
+  else
+  {
+    /* Without write access the writer cannot be told of a waiter, so poll */
+
+    struct timespec ts = { 0, 1000000 };
+    for (uint32_t t = 0; t < timeout && atomic_load (&r->hdr->head) <= r->pos; t++)
+    {
+      nanosleep (&ts, NULL);
+    }
+  }
+  return atomic_load (&r->hdr->head) > r->pos;
+}
+
+uint64_t edgex_eventring_lost (const edgex_eventring_reader *r)
+{
+  return r->lost;
+}
+
+const char *edgex_eventring_device (const edgex_eventring_record *rec)
+{
+  return (const char *)(rec + 1);
+}
+
+const char *edgex_eventring_source (const edgex_eventring_record *rec)
+{
+  return (const char *)(rec + 1) + rec->devlen;
+}
+
+const void *edgex_eventring_data (const edgex_eventring_record *rec)
+{
+  return (const unsigned char *)rec + RING_ALIGN (sizeof (edgex_eventring_record) + rec->devlen + rec->srclen);
+}
+
+const edgex_eventring_reading *edgex_eventring_reading_next
+  (const edgex_eventring_record *rec, const edgex_eventring_reading *rd)
+{
+  const unsigned char *end = (const unsigned char *)edgex_eventring_data (rec) + rec->datalen;
+  const unsigned char *next = rd ? (const unsigned char *)rd + rd->length : edgex_eventring_data (rec);
+
+  if (rec->kind != EDGEX_EVENTRING_READINGS || next + sizeof (edgex_eventring_reading) > end)
+  {
+    return NULL;
+  }
+  return (const edgex_eventring_reading *)next;
+}
+
+const char *edgex_eventring_reading_name (const edgex_eventring_reading *rd)
+{
+  return (const char *)(rd + 1);
+}
+
+const void *edgex_eventring_reading_data (const edgex_eventring_reading *rd)
+{
+  return (const char *)(rd + 1) + rd->namelen;
+}
+
+void edgex_eventring_close (edgex_eventring_reader *r)
+{
+  if (r)
+  {
+    munmap (r->hdr, r->maplen);
+    free (r);
+  }
+}
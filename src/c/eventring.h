@@ -0,0 +1,73 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#ifndef _EDGEX_DEVICE_EVENTRING_H_
+#define _EDGEX_DEVICE_EVENTRING_H_ 1
+
+#include "edgex/eventring.h"
+#include "edgex/devsdk.h"
+#include "cmdinfo.h"
+#include "data.h"
+
+/*
+ * Writer for the shared-memory event ring (see edgex/eventring.h for the
+ * layout and the reader). Events are written as they are generated, by
+ * whichever thread generated them, so writes are serialized by a lock; the
+ * ring itself has a single writer. Records larger than half the ring are
+ * dropped.
+ */
+
+#define EDGEX_EVENTRING_DEFAULT_SIZE 4096
+
+typedef enum
+{
+  EDGEX_EVENTRING_EVENTS,
+  EDGEX_EVENTRING_TYPED
+} edgex_eventring_format;
+
+typedef struct edgex_eventring_t edgex_eventring_t;
+
+typedef struct edgex_eventring_stats
+{
+  uint64_t written;
+  uint64_t dropped;
+  uint64_t overwritten;
+} edgex_eventring_stats;
+
+/*
+ * name: the shared memory object's name. Any existing object of that name is replaced.
+ * size: the size of the record area in KiB.
+ * format: Events (encoded events) or Readings (typed readings).
+ */
+
+edgex_eventring_t *edgex_eventring_alloc
+  (iot_logger_t *lc, const char *name, uint32_t size, const char *format, edgex_error *err);
+
+/* Write a record for an event and the readings it was encoded from, in the ring's format */
+
+void edgex_eventring_put
+(
+  edgex_eventring_t *ring,
+  const char *device,
+  const edgex_cmdinfo *cmd,
+  const edgex_device_commandresult *values,
+  uint64_t origin,
+  const edgex_event_cooked *event
+);
+
+void edgex_eventring_getstats (edgex_eventring_t *ring, edgex_eventring_stats *stats);
+
+const char *edgex_eventring_name (const edgex_eventring_t *ring);
+
+const char *edgex_eventring_formatname (const edgex_eventring_t *ring);
+
+/* Unmap and remove the ring. Readers which have it mapped may continue to read what was written */
+
+void edgex_eventring_free (edgex_eventring_t *ring);
+
+#endif
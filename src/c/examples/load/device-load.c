@@ -0,0 +1,481 @@
+/* Synthetic load-generating device service using C SDK */
+
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#include <unistd.h>
+#include <signal.h>
+#include <errno.h>
+#include <math.h>
+#include <time.h>
+#include <inttypes.h>
+
+#include "edgex/devsdk.h"
+#include "edgex/device-mgmt.h"
+
+#define ERR_CHECK(x) if (x.code) { fprintf (stderr, "Error: %d: %s\n", x.code, x.reason); edgex_device_service_free (service); free (impl); return x.code; }
+
+#define LOAD_MAXPROFILES 16
+
+typedef enum { LOAD_NONE, LOAD_FIXED, LOAD_UNIFORM, LOAD_EXPONENTIAL } load_latency;
+
+typedef struct load_driver
+{
+  iot_logger_t * lc;
+  unsigned ndevices;
+  char *profiles[LOAD_MAXPROFILES];
+  unsigned nprofiles;
+  char *command;
+  char *interval;
+  size_t payload;
+  load_latency latency;
+  double latency_us;
+  unsigned report;
+  atomic_uint_fast64_t events;
+  atomic_uint_fast64_t readings;
+  atomic_uint_fast64_t bytes;
+} load_driver;
+
+static const char *findinpairs
+  (const edgex_nvpairs *nvps, const char *name)
+{
+  const edgex_nvpairs *pair = nvps;
+  while (pair)
+  {
+    if (strcmp (pair->name, name) == 0)
+    {
+      return pair->value;
+    }
+    pair = pair->next;
+  }
+  return NULL;
+}
+
+/* xorshift64* generator, one per thread, for values and latencies */
+
+static _Thread_local uint64_t load_seed;
+
+static uint64_t load_random (void)
+{
+  if (load_seed == 0)
+  {
+    load_seed = (uint64_t)(uintptr_t)&load_seed ^ (uint64_t)time (NULL) ^ 0x9e3779b97f4a7c15ULL;
+  }
+  load_seed ^= load_seed >> 12;
+  load_seed ^= load_seed << 25;
+  load_seed ^= load_seed >> 27;
+  return load_seed * 0x2545f4914f6cdd1dULL;
+}
+
+/* A uniformly distributed value in (0, 1] */
+
+static double load_uniform (void)
+{
+  return ((load_random () >> 11) + 1) * (1.0 / 9007199254740992.0);
+}
+
+static void load_delay (const load_driver *driver)
+{
+  double us;
+  struct timespec ts;
+
+  switch (driver->latency)
+  {
+    case LOAD_FIXED:
+      us = driver->latency_us;
+      break;
+    case LOAD_UNIFORM:
+      us = 2.0 * driver->latency_us * load_uniform ();
+      break;
+    case LOAD_EXPONENTIAL:
+      us = -driver->latency_us * log (load_uniform ());
+      break;
+    default:
+      return;
+  }
+  ts.tv_sec = us / 1e6;
+  ts.tv_nsec = (us - ts.tv_sec * 1e6) * 1000;
+  while (nanosleep (&ts, &ts) == -1 && errno == EINTR);
+}
+
+static bool load_init
+  (void *impl, struct iot_logger_t *lc, const edgex_nvpairs *config)
+{
+  load_driver *driver = (load_driver *) impl;
+  const char *val;
+
+  driver->lc = lc;
+  driver->ndevices = 10;
+  driver->payload = 256;
+  driver->latency = LOAD_NONE;
+  driver->latency_us = 0;
+  driver->report = 10;
+
+  if ((val = findinpairs (config, "Devices")))
+  {
+    driver->ndevices = strtoul (val, NULL, 10);
+  }
+  val = findinpairs (config, "Command");
+  driver->command = strdup (val ? val : "Load");
+  val = findinpairs (config, "Interval");
+  driver->interval = strdup (val ? val : "1s");
+  if ((val = findinpairs (config, "PayloadSize")))
+  {
+    driver->payload = strtoul (val, NULL, 10);
+  }
+  if ((val = findinpairs (config, "LatencyMean")))
+  {
+    driver->latency_us = strtod (val, NULL);
+  }
+  if ((val = findinpairs (config, "ReportInterval")))
+  {
+    driver->report = strtoul (val, NULL, 10);
+  }
+  if ((val = findinpairs (config, "Latency")))
+  {
+    if (strcmp (val, "fixed") == 0)
+    {
+      driver->latency = LOAD_FIXED;
+    }
+    else if (strcmp (val, "uniform") == 0)
+    {
+      driver->latency = LOAD_UNIFORM;
+    }
+    else if (strcmp (val, "exponential") == 0)
+    {
+      driver->latency = LOAD_EXPONENTIAL;
+    }
+    else if (strcmp (val, "none"))
+    {
+      iot_log_error (lc, "Unknown latency distribution %s", val);
+      return false;
+    }
+  }
+
+  val = findinpairs (config, "Profiles");
+  char *profiles = strdup (val ? val : "Load-Numeric");
+  char *saveptr = NULL;
+  for (char *p = strtok_r (profiles, ", ", &saveptr); p; p = strtok_r (NULL, ", ", &saveptr))
+  {
+    if (driver->nprofiles == LOAD_MAXPROFILES)
+    {
+      iot_log_error (lc, "At most %d profiles may be used", LOAD_MAXPROFILES);
+      break;
+    }
+    driver->profiles[driver->nprofiles++] = strdup (p);
+  }
+  free (profiles);
+  if (driver->nprofiles == 0)
+  {
+    iot_log_error (lc, "No profiles specified");
+    return false;
+  }
+
+  iot_log_info
+  (
+    lc, "Load: %u devices every %s, payload %zu bytes, latency %s mean %.0fus",
+    driver->ndevices, driver->interval, driver->payload,
+    driver->latency == LOAD_NONE ? "none" : driver->latency == LOAD_FIXED ? "fixed" :
+      driver->latency == LOAD_UNIFORM ? "uniform" : "exponential",
+    driver->latency_us
+  );
+  return true;
+}
+
+/* Fill a buffer of the given size for a String (nul-terminated) or Binary reading */
+
+static uint8_t *load_payload (size_t size, bool terminate)
+{
+  uint8_t *buf = edgex_device_buffer_alloc (terminate ? size + 1 : size);
+  if (buf)
+  {
+    uint64_t r = load_random ();
+    for (size_t i = 0; i < size; i++)
+    {
+      buf[i] = 'a' + (r + i) % 26;
+    }
+    if (terminate)
+    {
+      buf[size] = '\0';
+    }
+  }
+  return buf;
+}
+
+static bool load_get_handler
+(
+  void *impl,
+  const char *devname,
+  const edgex_protocols *protocols,
+  uint32_t nreadings,
+  const edgex_device_commandrequest *requests,
+  edgex_device_commandresult *readings
+)
+{
+  load_driver *driver = (load_driver *)impl;
+  uint64_t bytes = 0;
+
+  load_delay (driver);
+
+  for (uint32_t i = 0; i < nreadings; i++)
+  {
+    uint64_t n = load_random ();
+    const char *sz = findinpairs (requests[i].attributes, "size");
+    size_t size = sz ? strtoul (sz, NULL, 10) : driver->payload;
+
+    readings[i].type = requests[i].type;
+    switch (requests[i].type)
+    {
+      case Bool:
+        readings[i].value.bool_result = n & 1;
+        break;
+      case String:
+        readings[i].value.string_result = (char *)load_payload (size, true);
+        bytes += size;
+        break;
+      case Binary:
+        readings[i].value.binary_result.bytes = load_payload (size, false);
+        readings[i].value.binary_result.size = size;
+        bytes += size;
+        break;
+      case Uint8:
+        readings[i].value.ui8_result = n;
+        break;
+      case Uint16:
+        readings[i].value.ui16_result = n;
+        break;
+      case Uint32:
+        readings[i].value.ui32_result = n;
+        break;
+      case Uint64:
+        readings[i].value.ui64_result = n;
+        break;
+      case Int8:
+        readings[i].value.i8_result = n;
+        break;
+      case Int16:
+        readings[i].value.i16_result = n;
+        break;
+      case Int32:
+        readings[i].value.i32_result = n;
+        break;
+      case Int64:
+        readings[i].value.i64_result = n;
+        break;
+      case Float32:
+        readings[i].value.f32_result = 100.0f * load_uniform ();
+        break;
+      case Float64:
+        readings[i].value.f64_result = 100.0 * load_uniform ();
+        break;
+    }
+  }
+  atomic_fetch_add (&driver->events, 1);
+  atomic_fetch_add (&driver->readings, nreadings);
+  atomic_fetch_add (&driver->bytes, bytes);
+  return true;
+}
+
+static bool load_put_handler
+(
+  void *impl,
+  const char *devname,
+  const edgex_protocols *protocols,
+  uint32_t nvalues,
+  const edgex_device_commandrequest *requests,
+  const edgex_device_commandresult *values
+)
+{
+  load_delay ((load_driver *)impl);
+  return true;
+}
+
+static bool load_disconnect (void *impl, edgex_protocols *device)
+{
+  return true;
+}
+
+static void load_stop (void *impl, bool force) {}
+
+/* Create the devices, assigning the profiles in turn. Devices which already exist are left as they are */
+
+static void load_add_devices (edgex_device_service *service, load_driver *driver)
+{
+  unsigned n = driver->ndevices;
+  edgex_device_newdevice *devs = calloc (n, sizeof (edgex_device_newdevice));
+  edgex_device_addresult *results = calloc (n, sizeof (edgex_device_addresult));
+  char (*names)[32] = malloc (n * sizeof (*names));
+  char (*indices)[16] = malloc (n * sizeof (*indices));
+  edgex_nvpairs *props = calloc (n, sizeof (edgex_nvpairs));
+  edgex_protocols *prots = calloc (n, sizeof (edgex_protocols));
+  edgex_strings label = { "load", NULL };
+  edgex_device_autoevents ae;
+
+  memset (&ae, 0, sizeof (ae));
+  ae.resource = driver->command;
+  ae.frequency = driver->interval;
+
+  for (unsigned i = 0; i < n; i++)
+  {
+    snprintf (names[i], sizeof (names[i]), "Load-%05u", i);
+    snprintf (indices[i], sizeof (indices[i]), "%u", i);
+    props[i].name = "Index";
+    props[i].value = indices[i];
+    prots[i].name = "Load";
+    prots[i].properties = &props[i];
+    devs[i].name = names[i];
+    devs[i].description = "Synthetic load device";
+    devs[i].labels = &label;
+    devs[i].profile_name = driver->profiles[i % driver->nprofiles];
+    devs[i].protocols = &prots[i];
+    devs[i].autos = &ae;
+  }
+
+  unsigned added = edgex_device_add_devices (service, devs, n, results);
+  for (unsigned i = 0; i < n; i++)
+  {
+    if (results[i].id == NULL)
+    {
+      iot_log_error (driver->lc, "Unable to add device %s: %s", names[i], results[i].err.reason);
+    }
+    free (results[i].id);
+  }
+  iot_log_info (driver->lc, "Load: %u of %u devices present", added, n);
+
+  free (prots);
+  free (props);
+  free (indices);
+  free (names);
+  free (results);
+  free (devs);
+}
+
+static double load_elapsed (const struct timespec *from, const struct timespec *to)
+{
+  return (to->tv_sec - from->tv_sec) + (to->tv_nsec - from->tv_nsec) / 1e9;
+}
+
+/* Wait for SIGINT, reporting the achieved rates at each interval */
+
+static void load_run (load_driver *driver)
+{
+  sigset_t set;
+  struct timespec start, last, now;
+  struct timespec wait = { .tv_sec = driver->report ? driver->report : 10, .tv_nsec = 0 };
+  uint64_t levents = 0, lreadings = 0, lbytes = 0;
+
+  sigemptyset (&set);
+  sigaddset (&set, SIGINT);
+  clock_gettime (CLOCK_MONOTONIC, &start);
+  last = start;
+
+  while (sigtimedwait (&set, NULL, &wait) == -1)
+  {
+    if (errno != EAGAIN)
+    {
+      continue;
+    }
+    uint64_t events = atomic_load (&driver->events);
+    uint64_t readings = atomic_load (&driver->readings);
+    uint64_t bytes = atomic_load (&driver->bytes);
+    clock_gettime (CLOCK_MONOTONIC, &now);
+    double secs = load_elapsed (&last, &now);
+    iot_log_info
+    (
+      driver->lc, "Load: %.1f events/s, %.1f readings/s, %.1f KiB/s payload",
+      (events - levents) / secs, (readings - lreadings) / secs, (bytes - lbytes) / secs / 1024
+    );
+    levents = events;
+    lreadings = readings;
+    lbytes = bytes;
+    last = now;
+  }
+
+  clock_gettime (CLOCK_MONOTONIC, &now);
+  double secs = load_elapsed (&start, &now);
+  iot_log_info
+  (
+    driver->lc, "Load: %" PRIu64 " events in %.1fs, %.1f events/s overall",
+    (uint64_t)atomic_load (&driver->events), secs, atomic_load (&driver->events) / secs
+  );
+}
+
+int main (int argc, char *argv[])
+{
+  edgex_device_svcparams params = { "device-load", "", "", "" };
+  sigset_t set;
+
+  load_driver * impl = calloc (1, sizeof (load_driver));
+
+  if (!edgex_device_service_processparams (&argc, argv, &params))
+  {
+    free (impl);
+    return 0;
+  }
+
+  int n = 1;
+  while (n < argc)
+  {
+    if (strcmp (argv[n], "-h") == 0 || strcmp (argv[n], "--help") == 0)
+    {
+      printf ("Options:\n");
+      printf ("  -h, --help\t\t: Show this text\n");
+      edgex_device_service_usage ();
+      free (impl);
+      return 0;
+    }
+    else
+    {
+      printf ("%s: Unrecognized option %s\n", argv[0], argv[n]);
+      free (impl);
+      return 0;
+    }
+  }
+
+  edgex_error e;
+  e.code = 0;
+
+  edgex_device_callbacks loadImpls =
+  {
+    load_init,         /* Initialize */
+    NULL,              /* Discovery */
+    load_get_handler,  /* Get */
+    load_put_handler,  /* Put */
+    load_disconnect,   /* Disconnect */
+    load_stop          /* Stop */
+  };
+
+  /* Block SIGINT before any threads are created, so that only sigtimedwait receives it */
+
+  sigemptyset (&set);
+  sigaddset (&set, SIGINT);
+  pthread_sigmask (SIG_BLOCK, &set, NULL);
+
+  edgex_device_service *service = edgex_device_service_new
+    (params.svcname, "1.0", impl, loadImpls, &e);
+  ERR_CHECK (e);
+
+  edgex_device_service_start (service, params.regURL, params.profile, params.confdir, &e);
+  ERR_CHECK (e);
+
+  load_add_devices (service, impl);
+  load_run (impl);
+
+  edgex_device_service_stop (service, true, &e);
+  ERR_CHECK (e);
+
+  edgex_device_service_free (service);
+  for (unsigned i = 0; i < impl->nprofiles; i++)
+  {
+    free (impl->profiles[i]);
+  }
+  free (impl->command);
+  free (impl->interval);
+  free (impl);
+  return 0;
+}
@@ -0,0 +1,320 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#include "floatfmt.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+/*
+ * Grisu2, after Florian Loitsch, "Printing Floating-Point Numbers Quickly and
+ * Accurately with Integers" (PLDI 2010), and Milo Yip's implementation of it.
+ */
+
+typedef struct diyfp
+{
+  uint64_t f;
+  int e;
+} diyfp;
+
+/* Normalized 64-bit approximations of 10^k for k = -348, -340, ... 340 */
+
+static const uint64_t cached_f[] =
+{
+  0xfa8fd5a0081c0288, 0xbaaee17fa23ebf76, 0x8b16fb203055ac76,
+  0xcf42894a5dce35ea, 0x9a6bb0aa55653b2d, 0xe61acf033d1a45df,
+  0xab70fe17c79ac6ca, 0xff77b1fcbebcdc4f, 0xbe5691ef416bd60c,
+  0x8dd01fad907ffc3c, 0xd3515c2831559a83, 0x9d71ac8fada6c9b5,
+  0xea9c227723ee8bcb, 0xaecc49914078536d, 0x823c12795db6ce57,
+  0xc21094364dfb5637, 0x9096ea6f3848984f, 0xd77485cb25823ac7,
+  0xa086cfcd97bf97f4, 0xef340a98172aace5, 0xb23867fb2a35b28e,
+  0x84c8d4dfd2c63f3b, 0xc5dd44271ad3cdba, 0x936b9fcebb25c996,
+  0xdbac6c247d62a584, 0xa3ab66580d5fdaf6, 0xf3e2f893dec3f126,
+  0xb5b5ada8aaff80b8, 0x87625f056c7c4a8b, 0xc9bcff6034c13053,
+  0x964e858c91ba2655, 0xdff9772470297ebd, 0xa6dfbd9fb8e5b88f,
+  0xf8a95fcf88747d94, 0xb94470938fa89bcf, 0x8a08f0f8bf0f156b,
+  0xcdb02555653131b6, 0x993fe2c6d07b7fac, 0xe45c10c42a2b3b06,
+  0xaa242499697392d3, 0xfd87b5f28300ca0e, 0xbce5086492111aeb,
+  0x8cbccc096f5088cc, 0xd1b71758e219652c, 0x9c40000000000000,
+  0xe8d4a51000000000, 0xad78ebc5ac620000, 0x813f3978f8940984,
+  0xc097ce7bc90715b3, 0x8f7e32ce7bea5c70, 0xd5d238a4abe98068,
+  0x9f4f2726179a2245, 0xed63a231d4c4fb27, 0xb0de65388cc8ada8,
+  0x83c7088e1aab65db, 0xc45d1df942711d9a, 0x924d692ca61be758,
+  0xda01ee641a708dea, 0xa26da3999aef774a, 0xf209787bb47d6b85,
+  0xb454e4a179dd1877, 0x865b86925b9bc5c2, 0xc83553c5c8965d3d,
+  0x952ab45cfa97a0b3, 0xde469fbd99a05fe3, 0xa59bc234db398c25,
+  0xf6c69a72a3989f5c, 0xb7dcbf5354e9bece, 0x88fcf317f22241e2,
+  0xcc20ce9bd35c78a5, 0x98165af37b2153df, 0xe2a0b5dc971f303a,
+  0xa8d9d1535ce3b396, 0xfb9b7cd9a4a7443c, 0xbb764c4ca7a44410,
+  0x8bab8eefb6409c1a, 0xd01fef10a657842c, 0x9b10a4e5e9913129,
+  0xe7109bfba19c0c9d, 0xac2820d9623bf429, 0x80444b5e7aa7cf85,
+  0xbf21e44003acdd2d, 0x8e679c2f5e44ff8f, 0xd433179d9c8cb841,
+  0x9e19db92b4e31ba9, 0xeb96bf6ebadf77d9, 0xaf87023b9bf0ee6b
+};
+
+static const int16_t cached_e[] =
+{
+  -1220, -1193, -1166, -1140, -1113, -1087, -1060, -1034, -1007, -980, -954, -927,
+  -901, -874, -847, -821, -794, -768, -741, -715, -688, -661, -635, -608,
+  -582, -555, -529, -502, -475, -449, -422, -396, -369, -343, -316, -289,
+  -263, -236, -210, -183, -157, -130, -103, -77, -50, -24, 3, 30,
+  56, 83, 109, 136, 162, 189, 216, 242, 269, 295, 322, 348,
+  375, 402, 428, 455, 481, 508, 534, 561, 588, 614, 641, 667,
+  694, 720, 747, 774, 800, 827, 853, 880, 907, 933, 960, 986,
+  1013, 1039, 1066
+};
+
+static const uint32_t pow10_32[] =
+  { 1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000 };
+
+/* Fractional digits may run past the tenth, eg where the integral part p1 has only a few bits */
+
+static const uint64_t pow10_64[] =
+{
+  1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL, 10000000ULL, 100000000ULL,
+  1000000000ULL, 10000000000ULL, 100000000000ULL, 1000000000000ULL, 10000000000000ULL,
+  100000000000000ULL, 1000000000000000ULL, 10000000000000000ULL, 100000000000000000ULL,
+  1000000000000000000ULL, 10000000000000000000ULL
+};
+
+static diyfp diyfp_mul (diyfp x, diyfp y)
+{
+  const uint64_t m32 = 0xffffffff;
+  uint64_t a = x.f >> 32;
+  uint64_t b = x.f & m32;
+  uint64_t c = y.f >> 32;
+  uint64_t d = y.f & m32;
+  uint64_t ac = a * c;
+  uint64_t bc = b * c;
+  uint64_t ad = a * d;
+  uint64_t bd = b * d;
+  uint64_t tmp = (bd >> 32) + (ad & m32) + (bc & m32);
+  tmp += 1U << 31;
+  diyfp result = { ac + (ad >> 32) + (bc >> 32) + (tmp >> 32), x.e + y.e + 64 };
+  return result;
+}
+
+static diyfp diyfp_normalize (diyfp x)
+{
+  int shift = __builtin_clzll (x.f);
+  x.f <<= shift;
+  x.e -= shift;
+  return x;
+}
+
+/* Select a cached power c_k = 10^-K such that the product with 2^e has a binary exponent in [-60, -32] */
+
+static diyfp cached_power (int e, int *K)
+{
+  double dk = (-61 - e) * 0.30102999566398114 + 347;
+  int k = (int)dk;
+  if (dk - k > 0.0)
+  {
+    k++;
+  }
+  unsigned index = (unsigned)((k >> 3) + 1);
+  *K = -(-348 + (int)(index << 3));
+  diyfp result = { cached_f[index], cached_e[index] };
+  return result;
+}
+
+static int count_digits (uint32_t n)
+{
+  int result = 1;
+  while (result < 10 && n >= pow10_32[result])
+  {
+    result++;
+  }
+  return result;
+}
+
+static void grisu_round (char *buf, int len, uint64_t delta, uint64_t rest, uint64_t ten_kappa, uint64_t wp_w)
+{
+  while (rest < wp_w && delta - rest >= ten_kappa && (rest + ten_kappa < wp_w || wp_w - rest > rest + ten_kappa - wp_w))
+  {
+    buf[len - 1]--;
+    rest += ten_kappa;
+  }
+}
+
+static int digit_gen (diyfp w, diyfp mp, uint64_t delta, char *buf, int *K)
+{
+  diyfp one = { (uint64_t)1 << -mp.e, mp.e };
+  uint64_t wp_w = mp.f - w.f;
+  uint32_t p1 = (uint32_t)(mp.f >> -one.e);
+  uint64_t p2 = mp.f & (one.f - 1);
+  int kappa = count_digits (p1);
+  int len = 0;
+
+  while (kappa > 0)
+  {
+    uint32_t d = p1 / pow10_32[kappa - 1];
+    p1 %= pow10_32[kappa - 1];
+    if (d || len)
+    {
+      buf[len++] = '0' + d;
+    }
+    kappa--;
+    uint64_t tmp = ((uint64_t)p1 << -one.e) + p2;
+    if (tmp <= delta)
+    {
+      *K += kappa;
+      grisu_round (buf, len, delta, tmp, (uint64_t)pow10_32[kappa] << -one.e, wp_w);
+      return len;
+    }
+  }
+
+  while (true)
+  {
+    p2 *= 10;
+    delta *= 10;
+    char d = (char)(p2 >> -one.e);
+    if (d || len)
+    {
+      buf[len++] = '0' + d;
+    }
+    p2 &= one.f - 1;
+    kappa--;
+    if (p2 < delta)
+    {
+      *K += kappa;
+      grisu_round (buf, len, delta, p2, one.f, wp_w * pow10_64[-kappa]);
+      return len;
+    }
+  }
+}
+
+/*
+ * Generate the digits of a positive finite value v = f * 2^e, whose neighbours
+ * are at distance 2^e (or 2^(e-1) below, if f is the smallest significand for
+ * the exponent). Returns the number of digits; the value is digits * 10^K.
+ */
+
+static int grisu2 (uint64_t f, int e, bool lowergap, char *buf, int *K)
+{
+  diyfp v = { f, e };
+  diyfp plus = { (f << 1) + 1, e - 1 };
+  diyfp minus = lowergap ? (diyfp){ (f << 2) - 1, e - 2 } : (diyfp){ (f << 1) - 1, e - 1 };
+
+  plus = diyfp_normalize (plus);
+  minus.f <<= minus.e - plus.e;
+  minus.e = plus.e;
+
+  diyfp c_mk = cached_power (plus.e, K);
+  diyfp w = diyfp_mul (diyfp_normalize (v), c_mk);
+  diyfp wp = diyfp_mul (plus, c_mk);
+  diyfp wm = diyfp_mul (minus, c_mk);
+  wm.f++;
+  wp.f--;
+  return digit_gen (w, wp, wp.f - wm.f, buf, K);
+}
+
+size_t edgex_float_tostring (double value, bool single, char *buf, size_t size)
+{
+  char digits[20];
+  char out[EDGEX_FLOAT_BUFSIZE];
+  uint64_t f;
+  int e;
+  bool lowergap;
+  int K = 0;
+  int len;
+  size_t n = 0;
+
+  if (!isfinite (value))
+  {
+    return snprintf (buf, size, "%e", value);
+  }
+  if (signbit (value))
+  {
+    out[n++] = '-';
+    value = -value;
+  }
+
+  if (single)
+  {
+    float fv = (float)value;
+    uint32_t bits;
+    memcpy (&bits, &fv, sizeof (bits));
+    uint32_t be = (bits >> 23) & 0xff;
+    f = bits & 0x7fffff;
+    if (be)
+    {
+      f |= 0x800000;
+      e = (int)be - 150;
+    }
+    else
+    {
+      e = -149;
+    }
+    lowergap = (f == 0x800000 && be > 1);
+  }
+  else
+  {
+    uint64_t bits;
+    memcpy (&bits, &value, sizeof (bits));
+    uint64_t be = (bits >> 52) & 0x7ff;
+    f = bits & 0xfffffffffffffULL;
+    if (be)
+    {
+      f |= 0x10000000000000ULL;
+      e = (int)be - 1075;
+    }
+    else
+    {
+      e = -1074;
+    }
+    lowergap = (f == 0x10000000000000ULL && be > 1);
+  }
+
+  if (f == 0)
+  {
+    digits[0] = '0';
+    len = 1;
+  }
+  else
+  {
+    len = grisu2 (f, e, lowergap, digits, &K);
+  }
+
+  /* Layout as d[.ddd]e±XX */
+
+  int exp10 = K + len - 1;
+  out[n++] = digits[0];
+  if (len > 1)
+  {
+    out[n++] = '.';
+    memcpy (out + n, digits + 1, len - 1);
+    n += len - 1;
+  }
+  out[n++] = 'e';
+  out[n++] = exp10 < 0 ? '-' : '+';
+  if (exp10 < 0)
+  {
+    exp10 = -exp10;
+  }
+  if (exp10 >= 100)
+  {
+    out[n++] = '0' + exp10 / 100;
+    exp10 %= 100;
+  }
+  out[n++] = '0' + exp10 / 10;
+  out[n++] = '0' + exp10 % 10;
+
+  if (n >= size)
+  {
+    n = size ? size - 1 : 0;
+  }
+  memcpy (buf, out, n);
+  if (size)
+  {
+    buf[n] = '\0';
+  }
+  return n;
+}
@@ -0,0 +1,31 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#ifndef _EDGEX_DEVICE_FLOATFMT_H_
+#define _EDGEX_DEVICE_FLOATFMT_H_ 1
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ * Format a floating-point value in e-notation using the fewest significant
+ * digits which will read back as the same value (for Float32 values, when read
+ * as a float rather than a double). Output is as Go's
+ * strconv.FormatFloat (v, 'e', -1, bits), eg "2.35e+01". Digits are generated
+ * with the Grisu2 algorithm, which always round-trips and very rarely produces
+ * a digit more than the shortest possible.
+ *
+ * Returns the length of the string written to buf. buf should have space for
+ * at least EDGEX_FLOAT_BUFSIZE characters.
+ */
+
+#define EDGEX_FLOAT_BUFSIZE 32
+
+size_t edgex_float_tostring (double value, bool single, char *buf, size_t size);
+
+#endif
@@ -0,0 +1,117 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#include "inflight.h"
+#include "map.h"
+
+#include <pthread.h>
+
+struct edgex_inflight_op
+{
+  char *key;
+  bool done;
+  int retcode;
+  edgex_event_cooked *reply;
+  unsigned refs;
+  pthread_cond_t cond;
+};
+
+typedef edgex_map(edgex_inflight_op *) edgex_map_inflight_op;
+
+struct edgex_inflight_t
+{
+  edgex_map_inflight_op ops;
+  uint64_t coalesced;
+  pthread_mutex_t lock;
+};
+
+/* Drop a reference to an operation. Called with the lock held */
+
+static void op_release (edgex_inflight_op *op)
+{
+  if (--op->refs == 0)
+  {
+    edgex_event_cooked_free (op->reply);
+    pthread_cond_destroy (&op->cond);
+    free (op->key);
+    free (op);
+  }
+}
+
+edgex_inflight_t *edgex_inflight_alloc (void)
+{
+  edgex_inflight_t *inf = calloc (1, sizeof (edgex_inflight_t));
+  edgex_map_init (&inf->ops);
+  pthread_mutex_init (&inf->lock, NULL);
+  return inf;
+}
+
+edgex_inflight_op *edgex_inflight_join
+  (edgex_inflight_t *inf, const char *key, int *retcode, edgex_event_cooked **reply)
+{
+  edgex_inflight_op **existing;
+  edgex_inflight_op *op;
+
+  pthread_mutex_lock (&inf->lock);
+  existing = edgex_map_get (&inf->ops, key);
+  if (existing)
+  {
+    op = *existing;
+    op->refs++;
+    inf->coalesced++;
+    while (!op->done)
+    {
+      pthread_cond_wait (&op->cond, &inf->lock);
+    }
+    *retcode = op->retcode;
+    *reply = op->reply ? edgex_event_cooked_share (op->reply) : NULL;
+    op_release (op);
+    pthread_mutex_unlock (&inf->lock);
+    return NULL;
+  }
+
+  op = calloc (1, sizeof (edgex_inflight_op));
+  op->key = strdup (key);
+  op->refs = 1;
+  pthread_cond_init (&op->cond, NULL);
+  edgex_map_set (&inf->ops, key, op);
+  pthread_mutex_unlock (&inf->lock);
+  return op;
+}
+
+void edgex_inflight_complete
+  (edgex_inflight_t *inf, edgex_inflight_op *op, int retcode, edgex_event_cooked *reply)
+{
+  pthread_mutex_lock (&inf->lock);
+  edgex_map_remove (&inf->ops, op->key);
+  op->done = true;
+  op->retcode = retcode;
+  op->reply = reply ? edgex_event_cooked_share (reply) : NULL;
+  pthread_cond_broadcast (&op->cond);
+  op_release (op);
+  pthread_mutex_unlock (&inf->lock);
+}
+
+uint64_t edgex_inflight_coalesced (edgex_inflight_t *inf)
+{
+  uint64_t result;
+  pthread_mutex_lock (&inf->lock);
+  result = inf->coalesced;
+  pthread_mutex_unlock (&inf->lock);
+  return result;
+}
+
+void edgex_inflight_free (edgex_inflight_t *inf)
+{
+  if (inf)
+  {
+    edgex_map_deinit (&inf->ops);
+    pthread_mutex_destroy (&inf->lock);
+    free (inf);
+  }
+}
@@ -0,0 +1,48 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#ifndef _EDGEX_DEVICE_INFLIGHT_H_
+#define _EDGEX_DEVICE_INFLIGHT_H_ 1
+
+#include "data.h"
+
+/*
+ * Coalescing of identical concurrent GET commands. The first request for a
+ * given key leads: it performs the read and publishes the result. Requests
+ * arriving while the read is in progress follow: they wait for the leader
+ * and receive a share of the same cooked event.
+ */
+
+typedef struct edgex_inflight_t edgex_inflight_t;
+
+typedef struct edgex_inflight_op edgex_inflight_op;
+
+edgex_inflight_t *edgex_inflight_alloc (void);
+
+/*
+ * Join the operation for a key. If one is in progress, wait for it to
+ * complete, set *retcode and *reply (a share of the leader's event, or NULL)
+ * and return NULL. Otherwise return a new operation, which the caller must
+ * complete when its result is available.
+ */
+
+edgex_inflight_op *edgex_inflight_join
+  (edgex_inflight_t *inf, const char *key, int *retcode, edgex_event_cooked **reply);
+
+/* Publish the leader's result and wake any followers. The leader retains its reference to the event */
+
+void edgex_inflight_complete
+  (edgex_inflight_t *inf, edgex_inflight_op *op, int retcode, edgex_event_cooked *reply);
+
+/* Returns the number of requests which have been served by another's read */
+
+uint64_t edgex_inflight_coalesced (edgex_inflight_t *inf);
+
+void edgex_inflight_free (edgex_inflight_t *inf);
+
+#endif
@@ -0,0 +1,164 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#include "intern.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+/* The table is split into shards, each with its own lock, so that loading devices on several threads does not contend */
+
+#define INTERN_SHARDS 16
+#define INTERN_INITBUCKETS 64
+
+typedef struct intern_entry
+{
+  struct intern_entry *next;
+  unsigned hash;
+  unsigned refs;
+  char str[];
+} intern_entry;
+
+typedef struct intern_shard
+{
+  pthread_mutex_t lock;
+  intern_entry **buckets;
+  unsigned nbuckets;
+  unsigned count;
+} intern_shard;
+
+static intern_shard intern_shards[INTERN_SHARDS];
+static pthread_once_t intern_once = PTHREAD_ONCE_INIT;
+
+static void intern_init (void)
+{
+  for (unsigned i = 0; i < INTERN_SHARDS; i++)
+  {
+    pthread_mutex_init (&intern_shards[i].lock, NULL);
+  }
+}
+
+static unsigned intern_hash (const char *str)
+{
+  unsigned h = 2166136261u;
+  while (*str)
+  {
+    h = (h ^ (unsigned char)*str++) * 16777619u;
+  }
+  return h;
+}
+
+static intern_entry **intern_bucket (intern_shard *sh, unsigned hash)
+{
+  return &sh->buckets[(hash / INTERN_SHARDS) & (sh->nbuckets - 1)];
+}
+
+static void intern_grow (intern_shard *sh)
+{
+  intern_entry **old = sh->buckets;
+  unsigned oldn = sh->nbuckets;
+
+  sh->nbuckets = oldn ? oldn * 2 : INTERN_INITBUCKETS;
+  sh->buckets = calloc (sh->nbuckets, sizeof (intern_entry *));
+  for (unsigned i = 0; i < oldn; i++)
+  {
+    intern_entry *e = old[i];
+    while (e)
+    {
+      intern_entry *next = e->next;
+      intern_entry **b = intern_bucket (sh, e->hash);
+      e->next = *b;
+      *b = e;
+      e = next;
+    }
+  }
+  free (old);
+}
+
+const char *edgex_intern (const char *str)
+{
+  unsigned hash;
+  intern_shard *sh;
+  intern_entry *e;
+  intern_entry **b;
+  size_t len;
+
+  if (str == NULL)
+  {
+    return NULL;
+  }
+  pthread_once (&intern_once, intern_init);
+  hash = intern_hash (str);
+  sh = &intern_shards[hash % INTERN_SHARDS];
+
+  pthread_mutex_lock (&sh->lock);
+  if (sh->nbuckets)
+  {
+    for (e = *intern_bucket (sh, hash); e; e = e->next)
+    {
+      if (e->hash == hash && strcmp (e->str, str) == 0)
+      {
+        e->refs++;
+        pthread_mutex_unlock (&sh->lock);
+        return e->str;
+      }
+    }
+  }
+  if (sh->count >= sh->nbuckets)
+  {
+    intern_grow (sh);
+  }
+  len = strlen (str);
+  e = malloc (sizeof (intern_entry) + len + 1);
+  memcpy (e->str, str, len + 1);
+  e->hash = hash;
+  e->refs = 1;
+  b = intern_bucket (sh, hash);
+  e->next = *b;
+  *b = e;
+  sh->count++;
+  pthread_mutex_unlock (&sh->lock);
+  return e->str;
+}
+
+void edgex_intern_release (const char *str)
+{
+  unsigned hash;
+  intern_shard *sh;
+
+  if (str == NULL)
+  {
+    return;
+  }
+  pthread_once (&intern_once, intern_init);
+  hash = intern_hash (str);
+  sh = &intern_shards[hash % INTERN_SHARDS];
+
+  pthread_mutex_lock (&sh->lock);
+  if (sh->nbuckets)
+  {
+    for (intern_entry **pe = intern_bucket (sh, hash); *pe; pe = &(*pe)->next)
+    {
+      intern_entry *e = *pe;
+      if (e->str == str)
+      {
+        if (--e->refs == 0)
+        {
+          *pe = e->next;
+          sh->count--;
+          free (e);
+        }
+        pthread_mutex_unlock (&sh->lock);
+        return;
+      }
+    }
+  }
+  pthread_mutex_unlock (&sh->lock);
+  free ((char *)str);
+}
@@ -0,0 +1,29 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#ifndef _EDGEX_DEVICE_INTERN_H_
+#define _EDGEX_DEVICE_INTERN_H_ 1
+
+/*
+ * Process-wide table of shared strings. The devmap holds the strings which
+ * recur across its device records (labels, protocol names and property
+ * keys, AutoEvent resources and frequencies) here once, with a reference
+ * count, as do cooked events for their device and resource names. An
+ * interned string must not be modified, and is released with
+ * edgex_intern_release rather than free.
+ */
+
+/* Returns the shared copy of str, NULL if str is NULL */
+
+const char *edgex_intern (const char *str);
+
+/* Release a string from edgex_intern. Strings which were not interned are freed, so either may be passed */
+
+void edgex_intern_release (const char *str);
+
+#endif
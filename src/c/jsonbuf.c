@@ -0,0 +1,198 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#include "jsonbuf.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define IS_CONT(b) (((unsigned char)(b) & 0xC0) == 0x80)
+
+static const char hexdigits[] = "0123456789abcdef";
+
+static void edgex_jsonbuf_reserve (edgex_jsonbuf *b, size_t extra)
+{
+  if (b->len + extra + 1 > b->cap)
+  {
+    size_t newcap = b->cap ? b->cap : 256;
+    while (b->len + extra + 1 > newcap)
+    {
+      newcap *= 2;
+    }
+    b->data = realloc (b->data, newcap);
+    b->cap = newcap;
+  }
+}
+
+void edgex_jsonbuf_init (edgex_jsonbuf *b, size_t size)
+{
+  b->len = 0;
+  b->cap = size ? size : 256;
+  b->data = malloc (b->cap);
+  b->data[0] = '\0';
+}
+
+void edgex_jsonbuf_append (edgex_jsonbuf *b, const char *s, size_t len)
+{
+  edgex_jsonbuf_reserve (b, len);
+  memcpy (b->data + b->len, s, len);
+  b->len += len;
+  b->data[b->len] = '\0';
+}
+
+void edgex_jsonbuf_appendc (edgex_jsonbuf *b, char c)
+{
+  edgex_jsonbuf_reserve (b, 1);
+  b->data[b->len++] = c;
+  b->data[b->len] = '\0';
+}
+
+void edgex_jsonbuf_uint (edgex_jsonbuf *b, uint64_t n)
+{
+  char tmp[20];
+  int i = sizeof (tmp);
+  do
+  {
+    tmp[--i] = '0' + (n % 10);
+    n /= 10;
+  } while (n);
+  edgex_jsonbuf_append (b, tmp + i, sizeof (tmp) - i);
+}
+
+void edgex_jsonbuf_string (edgex_jsonbuf *b, const char *s)
+{
+  const char *run = s;
+
+  edgex_jsonbuf_appendc (b, '"');
+  for (; *s; s++)
+  {
+    const char *esc = NULL;
+    char uesc[6];
+    unsigned char c = *s;
+
+    if (c >= 0x20 && c != '"' && c != '\\')
+    {
+      continue;
+    }
+
+    switch (c)
+    {
+      case '"': esc = "\\\""; break;
+      case '\\': esc = "\\\\"; break;
+      case '\b': esc = "\\b"; break;
+      case '\f': esc = "\\f"; break;
+      case '\n': esc = "\\n"; break;
+      case '\r': esc = "\\r"; break;
+      case '\t': esc = "\\t"; break;
+      default:
+        memcpy (uesc, "\\u00", 4);
+        uesc[4] = hexdigits[c >> 4];
+        uesc[5] = hexdigits[c & 0xf];
+        break;
+    }
+    edgex_jsonbuf_append (b, run, s - run);
+    if (esc)
+    {
+      edgex_jsonbuf_append (b, esc, strlen (esc));
+    }
+    else
+    {
+      edgex_jsonbuf_append (b, uesc, sizeof (uesc));
+    }
+    run = s + 1;
+  }
+  edgex_jsonbuf_append (b, run, s - run);
+  edgex_jsonbuf_appendc (b, '"');
+}
+
+void edgex_jsonbuf_key (edgex_jsonbuf *b, bool *first, const char *key)
+{
+  if (!*first)
+  {
+    edgex_jsonbuf_appendc (b, ',');
+  }
+  *first = false;
+  edgex_jsonbuf_string (b, key);
+  edgex_jsonbuf_appendc (b, ':');
+}
+
+void edgex_jsonbuf_member_string (edgex_jsonbuf *b, bool *first, const char *key, const char *value)
+{
+  if (value && edgex_json_valid_string (value))
+  {
+    edgex_jsonbuf_key (b, first, key);
+    edgex_jsonbuf_string (b, value);
+  }
+}
+
+void edgex_jsonbuf_member_uint (edgex_jsonbuf *b, bool *first, const char *key, uint64_t value)
+{
+  edgex_jsonbuf_key (b, first, key);
+  edgex_jsonbuf_uint (b, value);
+}
+
+/* UTF-8 validation, following the rules applied by parson */
+
+bool edgex_json_valid_string (const char *str)
+{
+  const unsigned char *s = (const unsigned char *)str;
+  while (*s)
+  {
+    unsigned cp;
+    int len;
+    unsigned char c = *s;
+
+    if (c < 0x80)
+    {
+      s++;
+      continue;
+    }
+    if (c == 0xC0 || c == 0xC1 || c > 0xF4 || IS_CONT (c))
+    {
+      return false;
+    }
+    if ((c & 0xE0) == 0xC0)
+    {
+      len = 2;
+      cp = c & 0x1F;
+    }
+    else if ((c & 0xF0) == 0xE0)
+    {
+      len = 3;
+      cp = c & 0x0F;
+    }
+    else
+    {
+      len = 4;
+      cp = c & 0x07;
+    }
+    for (int i = 1; i < len; i++)
+    {
+      if (!IS_CONT (s[i]))
+      {
+        return false;
+      }
+      cp = (cp << 6) | (s[i] & 0x3F);
+    }
+    if ((cp < 0x800 && len > 2) || (cp < 0x10000 && len > 3) || cp > 0x10FFFF || (cp >= 0xD800 && cp <= 0xDFFF))
+    {
+      return false;
+    }
+    s += len;
+  }
+  return true;
+}
+
+char *edgex_jsonbuf_finish (edgex_jsonbuf *b)
+{
+  char *result = b->data;
+  b->data = NULL;
+  b->len = 0;
+  b->cap = 0;
+  return result;
+}
@@ -0,0 +1,64 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#ifndef _EDGEX_DEVICE_JSONBUF_H_
+#define _EDGEX_DEVICE_JSONBUF_H_ 1
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * A growable buffer for writing JSON text directly, without building a
+ * parson tree. String escaping matches that of json_serialize_to_string.
+ */
+
+typedef struct edgex_jsonbuf
+{
+  char *data;
+  size_t len;
+  size_t cap;
+} edgex_jsonbuf;
+
+void edgex_jsonbuf_init (edgex_jsonbuf *b, size_t size);
+
+void edgex_jsonbuf_append (edgex_jsonbuf *b, const char *s, size_t len);
+
+void edgex_jsonbuf_appendc (edgex_jsonbuf *b, char c);
+
+void edgex_jsonbuf_uint (edgex_jsonbuf *b, uint64_t n);
+
+/* Write a quoted, escaped string */
+
+void edgex_jsonbuf_string (edgex_jsonbuf *b, const char *s);
+
+/*
+ * Start an object member, writing the separator (if this is not the first
+ * member) and the key. *first is updated accordingly.
+ */
+
+void edgex_jsonbuf_key (edgex_jsonbuf *b, bool *first, const char *key);
+
+/*
+ * Write a string-valued object member. As with json_object_set_string, the
+ * member is omitted if the value is NULL or is not valid UTF-8.
+ */
+
+void edgex_jsonbuf_member_string (edgex_jsonbuf *b, bool *first, const char *key, const char *value);
+
+void edgex_jsonbuf_member_uint (edgex_jsonbuf *b, bool *first, const char *key, uint64_t value);
+
+/* Returns true if the string is acceptable to parson as a JSON string value */
+
+bool edgex_json_valid_string (const char *s);
+
+/* Return the buffer contents (null-terminated, to be freed by the caller) and reset the buffer */
+
+char *edgex_jsonbuf_finish (edgex_jsonbuf *b);
+
+#endif
@@ -0,0 +1,522 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#include "jsonsax.h"
+#include "jsonbuf.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+/* What may come next, outside of any token */
+
+typedef enum
+{
+  SAX_VALUE,
+  SAX_VALUE_OR_END,
+  SAX_KEY,
+  SAX_KEY_OR_END,
+  SAX_COLON,
+  SAX_COMMA_OR_END,
+  SAX_NOTHING
+} sax_expect;
+
+/* The token being read */
+
+typedef enum
+{
+  SAX_NONE,
+  SAX_STRING,
+  SAX_ESCAPE,
+  SAX_UNICODE,
+  SAX_NUMBER,
+  SAX_LITERAL
+} sax_lex;
+
+struct edgex_jsonsax_t
+{
+  edgex_jsonsax_handler handler;
+  void *ctx;
+  sax_expect expect;
+  sax_lex lex;
+  bool iskey;
+  bool failed;
+  unsigned depth;
+  char stack[EDGEX_JSONSAX_MAXDEPTH];
+  unsigned hexdigits;
+  uint32_t codepoint;
+  uint32_t surrogate;
+  edgex_jsonbuf tok;
+  bool armed;
+  bool capturing;
+  unsigned capdepth;
+  edgex_jsonbuf cap;
+};
+
+#define SAX_WHITESPACE(c) ((c) == ' ' || (c) == '\t' || (c) == '\n' || (c) == '\r')
+#define SAX_DIGIT(c) ((c) >= '0' && (c) <= '9')
+
+static void sax_reset (edgex_jsonbuf *b)
+{
+  b->len = 0;
+  b->data[0] = '\0';
+}
+
+static void sax_emit (edgex_jsonsax_t *p, edgex_json_event ev, const char *text, size_t len)
+{
+  if (!p->capturing && !p->handler (p->ctx, ev, text, len))
+  {
+    p->failed = true;
+  }
+}
+
+/* A value has been completed. If it ended on a character which is not part of it, that character has been captured */
+
+static void sax_value_done (edgex_jsonsax_t *p, bool terminated)
+{
+  if (p->capturing && p->depth == p->capdepth)
+  {
+    p->capturing = false;
+    if (terminated)
+    {
+      p->cap.data[--p->cap.len] = '\0';
+    }
+    sax_emit (p, EDGEX_JSON_RAW, p->cap.data, p->cap.len);
+  }
+  p->expect = p->depth ? SAX_COMMA_OR_END : SAX_NOTHING;
+}
+
+static bool sax_number_valid (const char *s)
+{
+  if (*s == '-')
+  {
+    s++;
+  }
+  if (*s == '0')
+  {
+    s++;
+  }
+  else if (SAX_DIGIT (*s))
+  {
+    while (SAX_DIGIT (*s)) { s++; }
+  }
+  else
+  {
+    return false;
+  }
+  if (*s == '.')
+  {
+    s++;
+    if (!SAX_DIGIT (*s))
+    {
+      return false;
+    }
+    while (SAX_DIGIT (*s)) { s++; }
+  }
+  if (*s == 'e' || *s == 'E')
+  {
+    s++;
+    if (*s == '+' || *s == '-')
+    {
+      s++;
+    }
+    if (!SAX_DIGIT (*s))
+    {
+      return false;
+    }
+    while (SAX_DIGIT (*s)) { s++; }
+  }
+  return *s == '\0';
+}
+
+static void sax_scalar_end (edgex_jsonsax_t *p, bool terminated)
+{
+  const char *t = p->tok.data;
+  sax_lex lex = p->lex;
+
+  p->lex = SAX_NONE;
+  if (lex == SAX_NUMBER)
+  {
+    if (!sax_number_valid (t))
+    {
+      p->failed = true;
+      return;
+    }
+    sax_emit (p, EDGEX_JSON_NUMBER, t, p->tok.len);
+  }
+  else if (strcmp (t, "true") == 0)
+  {
+    sax_emit (p, EDGEX_JSON_TRUE, NULL, 0);
+  }
+  else if (strcmp (t, "false") == 0)
+  {
+    sax_emit (p, EDGEX_JSON_FALSE, NULL, 0);
+  }
+  else if (strcmp (t, "null") == 0)
+  {
+    sax_emit (p, EDGEX_JSON_NULL, NULL, 0);
+  }
+  else
+  {
+    p->failed = true;
+    return;
+  }
+  sax_value_done (p, terminated);
+}
+
+static void sax_string_end (edgex_jsonsax_t *p)
+{
+  p->lex = SAX_NONE;
+  if (!edgex_json_valid_string (p->tok.data))
+  {
+    p->failed = true;
+  }
+  else if (p->iskey)
+  {
+    sax_emit (p, EDGEX_JSON_KEY, p->tok.data, p->tok.len);
+    p->expect = SAX_COLON;
+  }
+  else
+  {
+    sax_emit (p, EDGEX_JSON_STRING, p->tok.data, p->tok.len);
+    sax_value_done (p, false);
+  }
+}
+
+static void sax_utf8 (edgex_jsonbuf *b, uint32_t cp)
+{
+  char out[4];
+  size_t n;
+
+  if (cp < 0x80)
+  {
+    out[0] = cp;
+    n = 1;
+  }
+  else if (cp < 0x800)
+  {
+    out[0] = 0xC0 | (cp >> 6);
+    out[1] = 0x80 | (cp & 0x3F);
+    n = 2;
+  }
+  else if (cp < 0x10000)
+  {
+    out[0] = 0xE0 | (cp >> 12);
+    out[1] = 0x80 | ((cp >> 6) & 0x3F);
+    out[2] = 0x80 | (cp & 0x3F);
+    n = 3;
+  }
+  else
+  {
+    out[0] = 0xF0 | (cp >> 18);
+    out[1] = 0x80 | ((cp >> 12) & 0x3F);
+    out[2] = 0x80 | ((cp >> 6) & 0x3F);
+    out[3] = 0x80 | (cp & 0x3F);
+    n = 4;
+  }
+  edgex_jsonbuf_append (b, out, n);
+}
+
+static void sax_unicode (edgex_jsonsax_t *p, char c)
+{
+  uint32_t cp;
+  int d;
+
+  if (SAX_DIGIT (c))
+  {
+    d = c - '0';
+  }
+  else if (c >= 'a' && c <= 'f')
+  {
+    d = c - 'a' + 10;
+  }
+  else if (c >= 'A' && c <= 'F')
+  {
+    d = c - 'A' + 10;
+  }
+  else
+  {
+    p->failed = true;
+    return;
+  }
+  p->codepoint = (p->codepoint << 4) | d;
+  if (++p->hexdigits < 4)
+  {
+    return;
+  }
+
+  p->lex = SAX_STRING;
+  cp = p->codepoint;
+  if (p->surrogate)
+  {
+    if (cp < 0xDC00 || cp > 0xDFFF)
+    {
+      p->failed = true;
+      return;
+    }
+    cp = 0x10000 + ((p->surrogate - 0xD800) << 10) + (cp - 0xDC00);
+    p->surrogate = 0;
+  }
+  else if (cp >= 0xD800 && cp <= 0xDBFF)
+  {
+    p->surrogate = cp;
+    return;
+  }
+  else if ((cp >= 0xDC00 && cp <= 0xDFFF) || cp == 0)
+  {
+    p->failed = true;
+    return;
+  }
+  sax_utf8 (&p->tok, cp);
+}
+
+static void sax_escape (edgex_jsonsax_t *p, char c)
+{
+  static const char escapes[] = "\"\\/bfnrt";
+  static const char values[] = "\"\\/\b\f\n\r\t";
+  const char *e;
+
+  if (c == 'u')
+  {
+    p->lex = SAX_UNICODE;
+    p->hexdigits = 0;
+    p->codepoint = 0;
+    return;
+  }
+  e = c ? strchr (escapes, c) : NULL;
+  if (e == NULL || p->surrogate)
+  {
+    p->failed = true;
+    return;
+  }
+  edgex_jsonbuf_appendc (&p->tok, values[e - escapes]);
+  p->lex = SAX_STRING;
+}
+
+static void sax_string (edgex_jsonsax_t *p, char c)
+{
+  if (p->surrogate && c != '\\')
+  {
+    p->failed = true;
+  }
+  else if (c == '"')
+  {
+    sax_string_end (p);
+  }
+  else if (c == '\\')
+  {
+    p->lex = SAX_ESCAPE;
+  }
+  else if ((unsigned char)c < 0x20)
+  {
+    p->failed = true;
+  }
+  else
+  {
+    edgex_jsonbuf_appendc (&p->tok, c);
+  }
+}
+
+static void sax_value (edgex_jsonsax_t *p, char c)
+{
+  if (p->armed)
+  {
+    p->armed = false;
+    p->capturing = true;
+    p->capdepth = p->depth;
+    sax_reset (&p->cap);
+    edgex_jsonbuf_appendc (&p->cap, c);
+  }
+  if (c == '{' || c == '[')
+  {
+    if (p->depth == EDGEX_JSONSAX_MAXDEPTH)
+    {
+      p->failed = true;
+      return;
+    }
+    p->stack[p->depth++] = c;
+    p->expect = (c == '{') ? SAX_KEY_OR_END : SAX_VALUE_OR_END;
+    sax_emit (p, (c == '{') ? EDGEX_JSON_OBJECT : EDGEX_JSON_ARRAY, NULL, 0);
+    return;
+  }
+  sax_reset (&p->tok);
+  if (c == '"')
+  {
+    p->lex = SAX_STRING;
+    p->iskey = false;
+  }
+  else if (c == '-' || SAX_DIGIT (c))
+  {
+    p->lex = SAX_NUMBER;
+    edgex_jsonbuf_appendc (&p->tok, c);
+  }
+  else if (c == 't' || c == 'f' || c == 'n')
+  {
+    p->lex = SAX_LITERAL;
+    edgex_jsonbuf_appendc (&p->tok, c);
+  }
+  else
+  {
+    p->failed = true;
+  }
+}
+
+static void sax_close (edgex_jsonsax_t *p, char c)
+{
+  p->depth--;
+  sax_emit (p, (c == '}') ? EDGEX_JSON_OBJECT_END : EDGEX_JSON_ARRAY_END, NULL, 0);
+  sax_value_done (p, false);
+}
+
+static void sax_structural (edgex_jsonsax_t *p, char c)
+{
+  char top = p->depth ? p->stack[p->depth - 1] : '\0';
+
+  if (SAX_WHITESPACE (c))
+  {
+    return;
+  }
+  switch (p->expect)
+  {
+    case SAX_VALUE_OR_END:
+      if (c == ']')
+      {
+        sax_close (p, c);
+        return;
+      }
+      /* fall through */
+    case SAX_VALUE:
+      sax_value (p, c);
+      return;
+    case SAX_KEY_OR_END:
+      if (c == '}')
+      {
+        sax_close (p, c);
+        return;
+      }
+      /* fall through */
+    case SAX_KEY:
+      if (c == '"')
+      {
+        sax_reset (&p->tok);
+        p->lex = SAX_STRING;
+        p->iskey = true;
+        return;
+      }
+      break;
+    case SAX_COLON:
+      if (c == ':')
+      {
+        p->expect = SAX_VALUE;
+        return;
+      }
+      break;
+    case SAX_COMMA_OR_END:
+      if (c == ',')
+      {
+        p->expect = (top == '{') ? SAX_KEY : SAX_VALUE;
+        return;
+      }
+      if ((c == '}' && top == '{') || (c == ']' && top == '['))
+      {
+        sax_close (p, c);
+        return;
+      }
+      break;
+    case SAX_NOTHING:
+      break;
+  }
+  p->failed = true;
+}
+
+static void sax_char (edgex_jsonsax_t *p, char c)
+{
+  if (p->capturing)
+  {
+    edgex_jsonbuf_appendc (&p->cap, c);
+  }
+  switch (p->lex)
+  {
+    case SAX_STRING:
+      sax_string (p, c);
+      return;
+    case SAX_ESCAPE:
+      sax_escape (p, c);
+      return;
+    case SAX_UNICODE:
+      sax_unicode (p, c);
+      return;
+    case SAX_NUMBER:
+      if (SAX_DIGIT (c) || c == '.' || c == 'e' || c == 'E' || c == '+' || c == '-')
+      {
+        edgex_jsonbuf_appendc (&p->tok, c);
+        return;
+      }
+      sax_scalar_end (p, true);
+      break;
+    case SAX_LITERAL:
+      if (c >= 'a' && c <= 'z')
+      {
+        edgex_jsonbuf_appendc (&p->tok, c);
+        return;
+      }
+      sax_scalar_end (p, true);
+      break;
+    case SAX_NONE:
+      break;
+  }
+  if (!p->failed)
+  {
+    sax_structural (p, c);
+  }
+}
+
+edgex_jsonsax_t *edgex_jsonsax_alloc (edgex_jsonsax_handler handler, void *ctx)
+{
+  edgex_jsonsax_t *p = calloc (1, sizeof (edgex_jsonsax_t));
+  p->handler = handler;
+  p->ctx = ctx;
+  p->expect = SAX_VALUE;
+  p->lex = SAX_NONE;
+  edgex_jsonbuf_init (&p->tok, 0);
+  edgex_jsonbuf_init (&p->cap, 0);
+  return p;
+}
+
+bool edgex_jsonsax_feed (edgex_jsonsax_t *p, const char *text, size_t len)
+{
+  for (size_t i = 0; i < len && !p->failed; i++)
+  {
+    sax_char (p, text[i]);
+  }
+  return !p->failed;
+}
+
+bool edgex_jsonsax_finish (edgex_jsonsax_t *p)
+{
+  if (!p->failed && (p->lex == SAX_NUMBER || p->lex == SAX_LITERAL))
+  {
+    sax_scalar_end (p, false);
+  }
+  return !p->failed && p->lex == SAX_NONE && p->expect == SAX_NOTHING;
+}
+
+void edgex_jsonsax_capture (edgex_jsonsax_t *p)
+{
+  p->armed = true;
+}
+
+void edgex_jsonsax_free (edgex_jsonsax_t *p)
+{
+  if (p)
+  {
+    free (p->tok.data);
+    free (p->cap.data);
+    free (p);
+  }
+}
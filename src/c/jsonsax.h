@@ -0,0 +1,67 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#ifndef _EDGEX_DEVICE_JSONSAX_H_
+#define _EDGEX_DEVICE_JSONSAX_H_ 1
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ * Event-driven JSON reader. Text is supplied in pieces of any size, for
+ * example as it is received, and the handler is called for each element as
+ * it is completed; no tree is built. For keys and strings the text passed to
+ * the handler is unescaped, for numbers it is as written. Text is
+ * null-terminated and is only valid for the duration of the call.
+ *
+ * The handler may return false to stop reading, in which case the text is
+ * treated as invalid.
+ */
+
+#define EDGEX_JSONSAX_MAXDEPTH 64
+
+typedef enum
+{
+  EDGEX_JSON_OBJECT,
+  EDGEX_JSON_OBJECT_END,
+  EDGEX_JSON_ARRAY,
+  EDGEX_JSON_ARRAY_END,
+  EDGEX_JSON_KEY,
+  EDGEX_JSON_STRING,
+  EDGEX_JSON_NUMBER,
+  EDGEX_JSON_TRUE,
+  EDGEX_JSON_FALSE,
+  EDGEX_JSON_NULL,
+  EDGEX_JSON_RAW
+} edgex_json_event;
+
+typedef bool (*edgex_jsonsax_handler) (void *ctx, edgex_json_event ev, const char *text, size_t len);
+
+typedef struct edgex_jsonsax_t edgex_jsonsax_t;
+
+edgex_jsonsax_t *edgex_jsonsax_alloc (edgex_jsonsax_handler handler, void *ctx);
+
+/* Returns false if the text so far is not valid JSON or the handler has stopped reading */
+
+bool edgex_jsonsax_feed (edgex_jsonsax_t *p, const char *text, size_t len);
+
+/* Returns true if the text supplied was a single complete JSON value */
+
+bool edgex_jsonsax_finish (edgex_jsonsax_t *p);
+
+/*
+ * Capture the next value, typically called by the handler for a key. The
+ * value is passed to the handler as a single EDGEX_JSON_RAW event holding its
+ * text, and no events are generated for its contents.
+ */
+
+void edgex_jsonsax_capture (edgex_jsonsax_t *p);
+
+void edgex_jsonsax_free (edgex_jsonsax_t *p);
+
+#endif
@@ -0,0 +1,385 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#include "jsonscan.h"
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* As for parson */
+#define SCAN_MAX_NESTING 2048
+
+typedef struct scanner
+{
+  char *p;
+  size_t nesting;
+} scanner;
+
+static void skip_ws (scanner *s)
+{
+  while (*s->p == ' ' || *s->p == '\t' || *s->p == '\n' || *s->p == '\r' || *s->p == '\f' || *s->p == '\v')
+  {
+    s->p++;
+  }
+}
+
+static bool hex4 (const char *h, unsigned *result)
+{
+  unsigned v = 0;
+  for (int i = 0; i < 4; i++)
+  {
+    char c = h[i];
+    v <<= 4;
+    if (c >= '0' && c <= '9')
+    {
+      v |= c - '0';
+    }
+    else if (c >= 'a' && c <= 'f')
+    {
+      v |= c - 'a' + 10;
+    }
+    else if (c >= 'A' && c <= 'F')
+    {
+      v |= c - 'A' + 10;
+    }
+    else
+    {
+      return false;
+    }
+  }
+  *result = v;
+  return true;
+}
+
+/* Write a code point as UTF-8, returning the number of bytes */
+
+static int put_utf8 (char *out, unsigned cp)
+{
+  if (cp < 0x80)
+  {
+    out[0] = (char)cp;
+    return 1;
+  }
+  if (cp < 0x800)
+  {
+    out[0] = 0xC0 | (cp >> 6);
+    out[1] = 0x80 | (cp & 0x3F);
+    return 2;
+  }
+  if (cp < 0x10000)
+  {
+    out[0] = 0xE0 | (cp >> 12);
+    out[1] = 0x80 | ((cp >> 6) & 0x3F);
+    out[2] = 0x80 | (cp & 0x3F);
+    return 3;
+  }
+  out[0] = 0xF0 | (cp >> 18);
+  out[1] = 0x80 | ((cp >> 12) & 0x3F);
+  out[2] = 0x80 | ((cp >> 6) & 0x3F);
+  out[3] = 0x80 | (cp & 0x3F);
+  return 4;
+}
+
+/*
+ * Unescape the string at the current position in place (the result is never
+ * longer than its encoding), returning its start or NULL if it is invalid.
+ */
+
+static char *scan_string (scanner *s)
+{
+  char *in = s->p + 1;
+  char *out = s->p;
+  char *result = out;
+
+  if (*s->p != '"')
+  {
+    return NULL;
+  }
+  while (*in != '"')
+  {
+    if ((unsigned char)*in < 0x20)
+    {
+      return NULL;
+    }
+    if (*in != '\\')
+    {
+      *out++ = *in++;
+      continue;
+    }
+    in++;
+    switch (*in++)
+    {
+      case '"': *out++ = '"'; break;
+      case '\\': *out++ = '\\'; break;
+      case '/': *out++ = '/'; break;
+      case 'b': *out++ = '\b'; break;
+      case 'f': *out++ = '\f'; break;
+      case 'n': *out++ = '\n'; break;
+      case 'r': *out++ = '\r'; break;
+      case 't': *out++ = '\t'; break;
+      case 'u':
+      {
+        unsigned cp, trail;
+        if (!hex4 (in, &cp))
+        {
+          return NULL;
+        }
+        in += 4;
+        if (cp >= 0xDC00 && cp <= 0xDFFF)
+        {
+          return NULL;
+        }
+        if (cp >= 0xD800 && cp <= 0xDBFF)
+        {
+          if (in[0] != '\\' || in[1] != 'u' || !hex4 (in + 2, &trail) || trail < 0xDC00 || trail > 0xDFFF)
+          {
+            return NULL;
+          }
+          in += 6;
+          cp = (((cp - 0xD800) << 10) | (trail - 0xDC00)) + 0x10000;
+        }
+        out += put_utf8 (out, cp);
+        break;
+      }
+      default:
+        return NULL;
+    }
+  }
+  *out = '\0';
+  s->p = in + 1;
+  return result;
+}
+
+static bool scan_literal (scanner *s, const char *lit)
+{
+  size_t len = strlen (lit);
+  if (strncmp (s->p, lit, len))
+  {
+    return false;
+  }
+  s->p += len;
+  return true;
+}
+
+static bool scan_number (scanner *s)
+{
+  char *start;
+  if (*s->p == '-')
+  {
+    s->p++;
+  }
+  start = s->p;
+  while (*s->p >= '0' && *s->p <= '9')
+  {
+    s->p++;
+  }
+  if (s->p == start || (*start == '0' && s->p - start > 1))
+  {
+    return false;
+  }
+  if (*s->p == '.')
+  {
+    /* A trailing point is accepted, as by parson */
+    s->p++;
+    while (*s->p >= '0' && *s->p <= '9')
+    {
+      s->p++;
+    }
+  }
+  if (*s->p == 'e' || *s->p == 'E')
+  {
+    s->p++;
+    if (*s->p == '+' || *s->p == '-')
+    {
+      s->p++;
+    }
+    start = s->p;
+    while (*s->p >= '0' && *s->p <= '9')
+    {
+      s->p++;
+    }
+    if (s->p == start)
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+static bool skip_value (scanner *s);
+
+/* Skip the members of an object or the elements of an array */
+
+static bool skip_container (scanner *s, char close, bool object)
+{
+  if (++s->nesting > SCAN_MAX_NESTING)
+  {
+    return false;
+  }
+  s->p++;
+  skip_ws (s);
+  if (*s->p == close)
+  {
+    s->p++;
+    s->nesting--;
+    return true;
+  }
+  while (true)
+  {
+    if (object)
+    {
+      if (scan_string (s) == NULL)
+      {
+        return false;
+      }
+      skip_ws (s);
+      if (*s->p++ != ':')
+      {
+        return false;
+      }
+    }
+    if (!skip_value (s))
+    {
+      return false;
+    }
+    skip_ws (s);
+    if (*s->p == close)
+    {
+      s->p++;
+      s->nesting--;
+      return true;
+    }
+    if (*s->p++ != ',')
+    {
+      return false;
+    }
+    skip_ws (s);
+  }
+}
+
+static bool skip_value (scanner *s)
+{
+  skip_ws (s);
+  switch (*s->p)
+  {
+    case '{':
+      return skip_container (s, '}', true);
+    case '[':
+      return skip_container (s, ']', false);
+    case '"':
+      return scan_string (s) != NULL;
+    case 't':
+      return scan_literal (s, "true");
+    case 'f':
+      return scan_literal (s, "false");
+    case 'n':
+      return scan_literal (s, "null");
+    default:
+      return scan_number (s);
+  }
+}
+
+/* Find a key, trying first the one expected next (members are usually supplied in order) */
+
+static int find_key (const char *key, unsigned nkeys, const char *const *keys, unsigned hint)
+{
+  if (hint < nkeys && strcmp (keys[hint], key) == 0)
+  {
+    return hint;
+  }
+  for (unsigned i = 0; i < nkeys; i++)
+  {
+    if (strcmp (keys[i], key) == 0)
+    {
+      return i;
+    }
+  }
+  return -1;
+}
+
+static bool scan_members
+  (scanner *s, unsigned nkeys, const char *const *keys, const char **values, bool *seen)
+{
+  unsigned hint = 0;
+
+  skip_ws (s);
+  if (*s->p++ != '{')
+  {
+    return false;
+  }
+  skip_ws (s);
+  if (*s->p == '}')
+  {
+    return true;
+  }
+  while (true)
+  {
+    int k;
+    char *key = scan_string (s);
+    if (key == NULL)
+    {
+      return false;
+    }
+    skip_ws (s);
+    if (*s->p++ != ':')
+    {
+      return false;
+    }
+    skip_ws (s);
+    k = find_key (key, nkeys, keys, hint);
+    if (k >= 0)
+    {
+      if (seen[k])
+      {
+        return false;
+      }
+      seen[k] = true;
+      hint = k + 1;
+    }
+    if (k >= 0 && *s->p == '"')
+    {
+      if ((values[k] = scan_string (s)) == NULL)
+      {
+        return false;
+      }
+    }
+    else if (!skip_value (s))
+    {
+      return false;
+    }
+    skip_ws (s);
+    if (*s->p == '}')
+    {
+      return true;
+    }
+    if (*s->p++ != ',')
+    {
+      return false;
+    }
+    skip_ws (s);
+  }
+}
+
+char *edgex_json_scan_strings
+  (const char *json, unsigned nkeys, const char *const *keys, const char **values)
+{
+  bool *seen = calloc (nkeys ? nkeys : 1, sizeof (bool));
+  char *work = strdup (json);
+  scanner s = { work, 1 };
+
+  memset (values, 0, nkeys * sizeof (const char *));
+  if (!scan_members (&s, nkeys, keys, values, seen))
+  {
+    memset (values, 0, nkeys * sizeof (const char *));
+    free (work);
+    work = NULL;
+  }
+  free (seen);
+  return work;
+}
@@ -0,0 +1,26 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#ifndef _EDGEX_DEVICE_JSONSCAN_H_
+#define _EDGEX_DEVICE_JSONSCAN_H_ 1
+
+/*
+ * Single-pass extraction of string members from a JSON object, without
+ * building a parson tree. The object is scanned once; members whose keys
+ * appear in the keys array have their (unescaped) values stored at the
+ * corresponding index in values, other members are validated and skipped.
+ * A value is NULL if its key is absent or its member is not a string.
+ *
+ * Returns a workspace holding the values, to be freed by the caller, or NULL
+ * if the text is not a JSON object or one of the keys appears more than once.
+ */
+
+char *edgex_json_scan_strings
+  (const char *json, unsigned nkeys, const char *const *keys, const char **values);
+
+#endif
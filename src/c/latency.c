@@ -0,0 +1,333 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#include "latency.h"
+#include "map.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+
+typedef struct latency_node
+{
+  char *device;
+  char *command;
+  edgex_latency_entry entry;
+  struct latency_node *next;
+} latency_node;
+
+typedef edgex_map(latency_node *) edgex_map_latency_node;
+
+struct edgex_latency_t
+{
+  edgex_map_latency_node nodes;
+  latency_node *spare;
+  pthread_rwlock_t lock;
+};
+
+/* Lookups may run concurrently, so the map's own get (which records the result in the map) is not used */
+
+#define latency_get(m, key) ((latency_node **)edgex_map_get_ (&(m)->base, key))
+
+static const char *stagenames[] = { "Driver", "Transform", "Encode", "Post", "Command" };
+
+static unsigned hist_index (uint64_t v)
+{
+  unsigned e;
+  if (v < EDGEX_HIST_SUBBUCKETS)
+  {
+    return v;
+  }
+  e = 63 - __builtin_clzll (v);
+  if (e >= EDGEX_HIST_MAXBITS)
+  {
+    return EDGEX_HIST_BUCKETS - 1;
+  }
+  return (e - EDGEX_HIST_SUBBITS + 1) * EDGEX_HIST_SUBBUCKETS +
+    ((v >> (e - EDGEX_HIST_SUBBITS)) & (EDGEX_HIST_SUBBUCKETS - 1));
+}
+
+static uint64_t hist_upper (unsigned idx)
+{
+  unsigned group = idx / EDGEX_HIST_SUBBUCKETS;
+  unsigned shift;
+  if (group == 0)
+  {
+    return idx;
+  }
+  shift = group - 1;
+  return ((uint64_t)(EDGEX_HIST_SUBBUCKETS + idx % EDGEX_HIST_SUBBUCKETS + 1) << shift) - 1;
+}
+
+void edgex_histogram_record (edgex_histogram *h, uint64_t value)
+{
+  uint64_t max = atomic_load_explicit (&h->max, memory_order_relaxed);
+  atomic_fetch_add_explicit (&h->buckets[hist_index (value)], 1, memory_order_relaxed);
+  atomic_fetch_add_explicit (&h->count, 1, memory_order_relaxed);
+  atomic_fetch_add_explicit (&h->sum, value, memory_order_relaxed);
+  while (value > max)
+  {
+    if (atomic_compare_exchange_weak_explicit (&h->max, &max, value, memory_order_relaxed, memory_order_relaxed))
+    {
+      break;
+    }
+  }
+}
+
+uint64_t edgex_histogram_below (edgex_histogram *h, unsigned bits)
+{
+  uint64_t total = 0;
+  unsigned end = bits <= EDGEX_HIST_SUBBITS ? (1u << bits) : (bits - EDGEX_HIST_SUBBITS + 1) * EDGEX_HIST_SUBBUCKETS;
+  if (end > EDGEX_HIST_BUCKETS)
+  {
+    end = EDGEX_HIST_BUCKETS;
+  }
+  for (unsigned i = 0; i < end; i++)
+  {
+    total += atomic_load_explicit (&h->buckets[i], memory_order_relaxed);
+  }
+  return total;
+}
+
+/*
+ * The buckets are read while they may still be updated, so the total is
+ * taken from the buckets themselves rather than from the count.
+ */
+
+uint64_t edgex_histogram_percentile (edgex_histogram *h, double q)
+{
+  uint32_t counts[EDGEX_HIST_BUCKETS];
+  uint64_t total = 0;
+  uint64_t target;
+  uint64_t seen = 0;
+  uint64_t max = atomic_load_explicit (&h->max, memory_order_relaxed);
+
+  for (unsigned i = 0; i < EDGEX_HIST_BUCKETS; i++)
+  {
+    counts[i] = atomic_load_explicit (&h->buckets[i], memory_order_relaxed);
+    total += counts[i];
+  }
+  if (total == 0)
+  {
+    return 0;
+  }
+  target = (uint64_t)(q * total + 0.5);
+  if (target == 0)
+  {
+    target = 1;
+  }
+  for (unsigned i = 0; i < EDGEX_HIST_BUCKETS; i++)
+  {
+    seen += counts[i];
+    if (seen >= target)
+    {
+      uint64_t upper = hist_upper (i);
+      return (max && upper > max) ? max : upper;
+    }
+  }
+  return max;
+}
+
+edgex_latency_t *edgex_latency_alloc (void)
+{
+  edgex_latency_t *lat = malloc (sizeof (edgex_latency_t));
+  edgex_map_init (&lat->nodes);
+  lat->spare = NULL;
+  pthread_rwlock_init (&lat->lock, NULL);
+  return lat;
+}
+
+/*
+ * A node for a new device and command, reusing one evicted for a removed
+ * device if there is one. Called with the lock held exclusively.
+ */
+
+static latency_node *latency_node_alloc (edgex_latency_t *lat)
+{
+  latency_node *node = lat->spare;
+  if (node == NULL)
+  {
+    return calloc (1, sizeof (latency_node));
+  }
+  lat->spare = node->next;
+  free (node->device);
+  free (node->command);
+  for (unsigned s = 0; s < EDGEX_LATENCY_STAGES; s++)
+  {
+    edgex_histogram *h = &node->entry.stages[s];
+    for (unsigned b = 0; b < EDGEX_HIST_BUCKETS; b++)
+    {
+      atomic_store (&h->buckets[b], 0);
+    }
+    atomic_store (&h->count, 0);
+    atomic_store (&h->sum, 0);
+    atomic_store (&h->max, 0);
+  }
+  return node;
+}
+
+edgex_latency_entry *edgex_latency_lookup (edgex_latency_t *lat, const char *device, const char *command)
+{
+  latency_node **found;
+  latency_node *node;
+  size_t dlen, clen;
+
+  if (lat == NULL)
+  {
+    return NULL;
+  }
+  dlen = strlen (device);
+  clen = strlen (command);
+  char key[dlen + clen + 2];
+  memcpy (key, device, dlen);
+  key[dlen] = '\n';
+  memcpy (key + dlen + 1, command, clen + 1);
+
+  pthread_rwlock_rdlock (&lat->lock);
+  found = latency_get (&lat->nodes, key);
+  node = found ? *found : NULL;
+  pthread_rwlock_unlock (&lat->lock);
+  if (node)
+  {
+    return &node->entry;
+  }
+
+  pthread_rwlock_wrlock (&lat->lock);
+  found = latency_get (&lat->nodes, key);
+  if (found)
+  {
+    node = *found;
+  }
+  else
+  {
+    node = latency_node_alloc (lat);
+    node->device = strdup (device);
+    node->command = strdup (command);
+    edgex_map_set (&lat->nodes, key, node);
+  }
+  pthread_rwlock_unlock (&lat->lock);
+  return &node->entry;
+}
+
+/* Intervals are read from the monotonic clock, which needs no shared state and is unaffected by changes to the wall clock */
+
+static uint64_t latency_now (void)
+{
+  struct timespec ts;
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+uint64_t edgex_latency_start (const edgex_latency_entry *e)
+{
+  return e ? latency_now () : 0;
+}
+
+void edgex_latency_record (edgex_latency_entry *e, edgex_latency_stage stage, uint64_t start)
+{
+  if (e)
+  {
+    edgex_histogram_record (&e->stages[stage], (latency_now () - start) / 1000);
+  }
+}
+
+/*
+ * Evicted nodes are kept for reuse rather than freed, as operations still in
+ * progress for the removed device may record into them.
+ */
+
+void edgex_latency_evict (edgex_latency_t *lat, const char *device)
+{
+  const char *key;
+  edgex_map_iter iter = edgex_map_iter (lat->nodes);
+
+  pthread_rwlock_wrlock (&lat->lock);
+  while ((key = edgex_map_next (&lat->nodes, &iter)))
+  {
+    latency_node *node = *latency_get (&lat->nodes, key);
+    if (strcmp (node->device, device) == 0)
+    {
+      edgex_map_remove (&lat->nodes, key);
+      node->next = lat->spare;
+      lat->spare = node;
+    }
+  }
+  pthread_rwlock_unlock (&lat->lock);
+}
+
+JSON_Value *edgex_histogram_json (edgex_histogram *h)
+{
+  JSON_Value *val = json_value_init_object ();
+  JSON_Object *obj = json_value_get_object (val);
+  json_object_set_uint (obj, "Count", atomic_load (&h->count));
+  json_object_set_uint (obj, "P50", edgex_histogram_percentile (h, 0.5));
+  json_object_set_uint (obj, "P90", edgex_histogram_percentile (h, 0.9));
+  json_object_set_uint (obj, "P99", edgex_histogram_percentile (h, 0.99));
+  json_object_set_uint (obj, "Max", atomic_load (&h->max));
+  return val;
+}
+
+JSON_Value *edgex_latency_json (edgex_latency_t *lat)
+{
+  const char *key;
+  edgex_map_iter iter = edgex_map_iter (lat->nodes);
+  JSON_Value *result = json_value_init_object ();
+  JSON_Object *robj = json_value_get_object (result);
+
+  pthread_rwlock_rdlock (&lat->lock);
+  while ((key = edgex_map_next (&lat->nodes, &iter)))
+  {
+    latency_node *node = *latency_get (&lat->nodes, key);
+    JSON_Object *dobj = json_object_get_object (robj, node->device);
+    JSON_Value *cval = json_value_init_object ();
+    JSON_Object *cobj = json_value_get_object (cval);
+    if (dobj == NULL)
+    {
+      json_object_set_value (robj, node->device, json_value_init_object ());
+      dobj = json_object_get_object (robj, node->device);
+    }
+    for (unsigned s = 0; s < EDGEX_LATENCY_STAGES; s++)
+    {
+      if (atomic_load (&node->entry.stages[s].count))
+      {
+        json_object_set_value (cobj, stagenames[s], edgex_histogram_json (&node->entry.stages[s]));
+      }
+    }
+    json_object_set_value (dobj, node->command, cval);
+  }
+  pthread_rwlock_unlock (&lat->lock);
+  return result;
+}
+
+void edgex_latency_free (edgex_latency_t *lat)
+{
+  if (lat)
+  {
+    const char *key;
+    edgex_map_iter iter = edgex_map_iter (lat->nodes);
+    while ((key = edgex_map_next (&lat->nodes, &iter)))
+    {
+      latency_node *node = *latency_get (&lat->nodes, key);
+      free (node->device);
+      free (node->command);
+      free (node);
+    }
+    while (lat->spare)
+    {
+      latency_node *node = lat->spare;
+      lat->spare = node->next;
+      free (node->device);
+      free (node->command);
+      free (node);
+    }
+    edgex_map_deinit (&lat->nodes);
+    pthread_rwlock_destroy (&lat->lock);
+    free (lat);
+  }
+}
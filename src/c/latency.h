@@ -0,0 +1,97 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#ifndef _EDGEX_DEVICE_LATENCY_H_
+#define _EDGEX_DEVICE_LATENCY_H_ 1
+
+#include "parson.h"
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Latency histograms for each stage of command processing, kept per device
+ * and command. Times are recorded in microseconds into log-linear buckets:
+ * each power of two is divided into EDGEX_HIST_SUBBUCKETS, so a percentile is
+ * reported to within 1 / EDGEX_HIST_SUBBUCKETS of its true value. Times of
+ * 2^EDGEX_HIST_MAXBITS us (about 12 days) or more share the last bucket.
+ * Recording is lock-free; finding the histograms for a device and command
+ * takes a shared lock, and only the first use of a pair takes it exclusively.
+ */
+
+#define EDGEX_HIST_SUBBITS 3
+#define EDGEX_HIST_SUBBUCKETS (1 << EDGEX_HIST_SUBBITS)
+#define EDGEX_HIST_MAXBITS 40
+#define EDGEX_HIST_BUCKETS ((EDGEX_HIST_MAXBITS - EDGEX_HIST_SUBBITS + 1) * EDGEX_HIST_SUBBUCKETS)
+
+typedef struct edgex_histogram
+{
+  _Atomic uint32_t buckets[EDGEX_HIST_BUCKETS];
+  atomic_uint_fast64_t count;
+  atomic_uint_fast64_t sum;
+  atomic_uint_fast64_t max;
+} edgex_histogram;
+
+typedef enum
+{
+  EDGEX_LATENCY_DRIVER,
+  EDGEX_LATENCY_TRANSFORM,
+  EDGEX_LATENCY_ENCODE,
+  EDGEX_LATENCY_POST,
+  EDGEX_LATENCY_COMMAND
+} edgex_latency_stage;
+
+#define EDGEX_LATENCY_STAGES (EDGEX_LATENCY_COMMAND + 1)
+
+typedef struct edgex_latency_entry
+{
+  edgex_histogram stages[EDGEX_LATENCY_STAGES];
+} edgex_latency_entry;
+
+typedef struct edgex_latency_t edgex_latency_t;
+
+void edgex_histogram_record (edgex_histogram *h, uint64_t value);
+
+/* The number of recorded values which are at most 2^bits - 1 */
+
+uint64_t edgex_histogram_below (edgex_histogram *h, unsigned bits);
+
+/* The value below which the fraction q of recorded values lie (the upper bound of its bucket), 0 if there are none */
+
+uint64_t edgex_histogram_percentile (edgex_histogram *h, double q);
+
+edgex_latency_t *edgex_latency_alloc (void);
+
+/* The histograms for a device and command. Returns NULL if lat is NULL, ie latency metrics are not enabled */
+
+edgex_latency_entry *edgex_latency_lookup (edgex_latency_t *lat, const char *device, const char *command);
+
+/* Discard the histograms for a device, when it is removed */
+
+void edgex_latency_evict (edgex_latency_t *lat, const char *device);
+
+/* Start timing a stage. Returns 0 if the entry is NULL */
+
+uint64_t edgex_latency_start (const edgex_latency_entry *e);
+
+/* Record the time since start for the stage */
+
+void edgex_latency_record (edgex_latency_entry *e, edgex_latency_stage stage, uint64_t start);
+
+/* An object giving the count, p50, p90, p99 and max of the recorded values */
+
+JSON_Value *edgex_histogram_json (edgex_histogram *h);
+
+/* An object keyed by device and then by command, giving the count, p50, p90, p99 and max of each stage (in us) */
+
+JSON_Value *edgex_latency_json (edgex_latency_t *lat);
+
+void edgex_latency_free (edgex_latency_t *lat);
+
+#endif
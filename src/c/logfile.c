@@ -0,0 +1,301 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#include "logfile.h"
+#include "placement.h"
+#include "errorlist.h"
+#include "memstats.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <inttypes.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <time.h>
+
+#define LOGFILE_IOBUF 65536
+#define LOGFILE_TSIZE 32
+
+/*
+ * Bounded multi-producer queue (after Vyukov). Each slot's sequence number
+ * indicates whether it is free for the producer claiming position pos (seq ==
+ * pos) or holds a line for the consumer at that position (seq == pos + 1).
+ */
+
+typedef struct edgex_logfile_slot
+{
+  atomic_size_t seq;
+  char *line;
+} edgex_logfile_slot;
+
+struct edgex_logfile_t
+{
+  char *path;
+  edgex_logfile_policy policy;
+  uint64_t maxsize;
+  edgex_logfile_slot *slots;
+  size_t mask;
+  atomic_size_t tail;
+  size_t head;
+  sem_t ready;
+  atomic_bool stop;
+  atomic_uint_fast64_t dropped;
+  atomic_uint_fast64_t written;
+  atomic_uint_fast64_t rotations;
+  uint64_t reported;
+  FILE *f;
+  char *iobuf;
+  uint64_t size;
+  pthread_t thread;
+};
+
+static const char *policynames[] = { "Block", "DropNewest" };
+
+static void logfile_open (edgex_logfile_t *lf)
+{
+  lf->f = fopen (lf->path, "a");
+  if (lf->f)
+  {
+    setvbuf (lf->f, lf->iobuf, _IOFBF, LOGFILE_IOBUF);
+    fseek (lf->f, 0, SEEK_END);
+    lf->size = ftell (lf->f);
+  }
+  else
+  {
+    lf->size = 0;
+  }
+}
+
+static void logfile_rotate (edgex_logfile_t *lf)
+{
+  size_t len = strlen (lf->path);
+  char *old = malloc (len + 3);
+  memcpy (old, lf->path, len);
+  strcpy (old + len, ".1");
+  fclose (lf->f);
+  rename (lf->path, old);
+  free (old);
+  logfile_open (lf);
+  atomic_fetch_add (&lf->rotations, 1);
+}
+
+/* Lines are written to stdout if the file cannot be opened */
+
+static void logfile_put (edgex_logfile_t *lf, const char *line)
+{
+  size_t len = strlen (line);
+  if (lf->f && lf->maxsize && lf->size && lf->size + len > lf->maxsize)
+  {
+    logfile_rotate (lf);
+  }
+  fputs (line, lf->f ? lf->f : stdout);
+  lf->size += len;
+  atomic_fetch_add (&lf->written, 1);
+}
+
+static void logfile_reportdrops (edgex_logfile_t *lf)
+{
+  uint64_t dropped = atomic_load (&lf->dropped);
+  if (dropped != lf->reported)
+  {
+    char line[128];
+    char ts8601[LOGFILE_TSIZE];
+    struct tm tsparts;
+    time_t now = time (NULL);
+    gmtime_r (&now, &tsparts);
+    strftime (ts8601, LOGFILE_TSIZE, "%FT%TZ", &tsparts);
+    snprintf
+    (
+      line, sizeof (line), "level=WARNING ts=%s msg=\"%" PRIu64 " log messages dropped, buffer full\"\n",
+      ts8601, dropped - lf->reported
+    );
+    lf->reported = dropped;
+    logfile_put (lf, line);
+  }
+}
+
+static char *logfile_pop (edgex_logfile_t *lf)
+{
+  char *line = NULL;
+  edgex_logfile_slot *slot = &lf->slots[lf->head & lf->mask];
+  if (atomic_load_explicit (&slot->seq, memory_order_acquire) == lf->head + 1)
+  {
+    line = slot->line;
+    atomic_store_explicit (&slot->seq, lf->head + lf->mask + 1, memory_order_release);
+    lf->head++;
+  }
+  return line;
+}
+
+static void *logfile_thread (void *p)
+{
+  edgex_logfile_t *lf = (edgex_logfile_t *)p;
+  char *line;
+  bool stopping = false;
+
+  edgex_placement_apply (EDGEX_PLACEMENT_IO);
+
+  while (!stopping)
+  {
+    sem_wait (&lf->ready);
+    stopping = atomic_load (&lf->stop);
+    while ((line = logfile_pop (lf)))
+    {
+      logfile_put (lf, line);
+      edgex_memstats_free (EDGEX_MEM_LOGGING, strlen (line) + 1);
+      free (line);
+    }
+    logfile_reportdrops (lf);
+    fflush (lf->f ? lf->f : stdout);
+  }
+  return NULL;
+}
+
+static bool logfile_push (edgex_logfile_t *lf, char *line)
+{
+  edgex_logfile_slot *slot;
+  size_t pos = atomic_load_explicit (&lf->tail, memory_order_relaxed);
+
+  while (true)
+  {
+    slot = &lf->slots[pos & lf->mask];
+    size_t seq = atomic_load_explicit (&slot->seq, memory_order_acquire);
+    intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+    if (diff == 0)
+    {
+      if (atomic_compare_exchange_weak_explicit (&lf->tail, &pos, pos + 1, memory_order_relaxed, memory_order_relaxed))
+      {
+        break;
+      }
+    }
+    else if (diff < 0)
+    {
+      return false;
+    }
+    else
+    {
+      pos = atomic_load_explicit (&lf->tail, memory_order_relaxed);
+    }
+  }
+  slot->line = line;
+  atomic_store_explicit (&slot->seq, pos + 1, memory_order_release);
+  sem_post (&lf->ready);
+  return true;
+}
+
+edgex_logfile_t *edgex_logfile_alloc
+  (iot_logger_t *lc, const char *path, uint32_t slots, uint64_t maxsize, const char *policy, edgex_error *err)
+{
+  edgex_logfile_t *lf;
+  edgex_logfile_policy p = EDGEX_LOGFILE_BLOCK;
+  size_t n = 2;
+
+  if (policy)
+  {
+    for (p = EDGEX_LOGFILE_BLOCK; p <= EDGEX_LOGFILE_DROP_NEWEST; p++)
+    {
+      if (strcasecmp (policy, policynames[p]) == 0)
+      {
+        break;
+      }
+    }
+    if (p > EDGEX_LOGFILE_DROP_NEWEST)
+    {
+      iot_log_error (lc, "Invalid Logging OverflowPolicy %s", policy);
+      *err = EDGEX_BAD_CONFIG;
+      return NULL;
+    }
+  }
+  while (n < slots)
+  {
+    n <<= 1;
+  }
+
+  lf = calloc (1, sizeof (edgex_logfile_t));
+  lf->path = strdup (path);
+  lf->policy = p;
+  lf->maxsize = maxsize;
+  lf->mask = n - 1;
+  lf->slots = malloc (n * sizeof (edgex_logfile_slot));
+  for (size_t i = 0; i < n; i++)
+  {
+    atomic_init (&lf->slots[i].seq, i);
+  }
+  atomic_init (&lf->tail, 0);
+  atomic_init (&lf->stop, false);
+  atomic_init (&lf->dropped, 0);
+  atomic_init (&lf->written, 0);
+  atomic_init (&lf->rotations, 0);
+  sem_init (&lf->ready, 0, 0);
+  lf->iobuf = malloc (LOGFILE_IOBUF);
+  logfile_open (lf);
+  if (lf->f == NULL)
+  {
+    iot_log_error (lc, "Unable to open log file %s, logging to stdout", path);
+  }
+  pthread_create (&lf->thread, NULL, logfile_thread, lf);
+  return lf;
+}
+
+const char *edgex_logfile_path (const edgex_logfile_t *lf)
+{
+  return lf->path;
+}
+
+void edgex_logfile_write (edgex_logfile_t *lf, char *line)
+{
+  size_t size = strlen (line) + 1;
+
+  edgex_memstats_alloc (EDGEX_MEM_LOGGING, size);
+  while (!logfile_push (lf, line))
+  {
+    if (lf->policy == EDGEX_LOGFILE_DROP_NEWEST)
+    {
+      atomic_fetch_add (&lf->dropped, 1);
+      edgex_memstats_free (EDGEX_MEM_LOGGING, size);
+      free (line);
+      return;
+    }
+    sched_yield ();
+  }
+}
+
+void edgex_logfile_getstats (edgex_logfile_t *lf, edgex_logfile_stats *stats)
+{
+  stats->written = atomic_load (&lf->written);
+  stats->dropped = atomic_load (&lf->dropped);
+  stats->rotations = atomic_load (&lf->rotations);
+}
+
+const char *edgex_logfile_policyname (const edgex_logfile_t *lf)
+{
+  return policynames[lf->policy];
+}
+
+void edgex_logfile_free (edgex_logfile_t *lf)
+{
+  if (lf)
+  {
+    atomic_store (&lf->stop, true);
+    sem_post (&lf->ready);
+    pthread_join (lf->thread, NULL);
+    if (lf->f)
+    {
+      fclose (lf->f);
+    }
+    sem_destroy (&lf->ready);
+    free (lf->iobuf);
+    free (lf->slots);
+    free (lf->path);
+    free (lf);
+  }
+}
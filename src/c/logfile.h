@@ -0,0 +1,73 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#ifndef _EDGEX_DEVICE_LOGFILE_H_
+#define _EDGEX_DEVICE_LOGFILE_H_ 1
+
+#include "edgex/edgex-logging.h"
+#include "edgex/error.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Asynchronous writer for a log file. Log lines are passed through a bounded
+ * lock-free ring buffer to a single thread, which keeps the file open and
+ * flushes it whenever the buffer empties, so that lines logged in bursts are
+ * written together. When the file would exceed a maximum size it is renamed
+ * with a ".1" suffix (replacing any previous one) and a new file started.
+ *
+ * If a line is logged while the buffer is full, the policy determines what
+ * happens:
+ *
+ *   Block      - the caller waits until there is space.
+ *   DropNewest - the line is discarded. A count of discarded lines is written
+ *                to the file once there is space again.
+ */
+
+typedef enum { EDGEX_LOGFILE_BLOCK, EDGEX_LOGFILE_DROP_NEWEST } edgex_logfile_policy;
+
+#define EDGEX_LOGFILE_DEFAULT_SLOTS 1024
+
+typedef struct edgex_logfile_t edgex_logfile_t;
+
+typedef struct edgex_logfile_stats
+{
+  uint64_t written;
+  uint64_t dropped;
+  uint64_t rotations;
+} edgex_logfile_stats;
+
+/*
+ * slots: the capacity of the buffer, rounded up to a power of two.
+ * maxsize: the size in bytes at which the file is rotated, 0 for no limit.
+ * policy: name of the policy, NULL for Block.
+ */
+
+edgex_logfile_t *edgex_logfile_alloc
+  (iot_logger_t *lc, const char *path, uint32_t slots, uint64_t maxsize, const char *policy, edgex_error *err);
+
+const char *edgex_logfile_path (const edgex_logfile_t *lf);
+
+/* Queue a line for writing. The writer takes ownership of the line */
+
+void edgex_logfile_write (edgex_logfile_t *lf, char *line);
+
+void edgex_logfile_getstats (edgex_logfile_t *lf, edgex_logfile_stats *stats);
+
+const char *edgex_logfile_policyname (const edgex_logfile_t *lf);
+
+/* Lines logged to this file by edgex_log_tofile are passed to the writer. NULL reverts to synchronous writes */
+
+void edgex_log_setfile (edgex_logfile_t *lf);
+
+/* Writes any queued lines and closes the file */
+
+void edgex_logfile_free (edgex_logfile_t *lf);
+
+#endif
@@ -0,0 +1,243 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#include "logremote.h"
+#include "placement.h"
+#include "rest.h"
+#include "jsonbuf.h"
+#include "errorlist.h"
+#include "memstats.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+typedef struct edgex_logremote_entry
+{
+  const char *service;
+  iot_loglevel_t level;
+  time_t created;
+  char *message;
+} edgex_logremote_entry;
+
+struct edgex_logremote_t
+{
+  char *url;
+  uint32_t size;
+  uint32_t batch;
+  uint64_t interval;
+  edgex_logremote_entry *entries;
+  uint32_t head;
+  uint32_t count;
+  uint64_t first;
+  uint64_t sent;
+  uint64_t dropped;
+  uint64_t failed;
+  bool running;
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+  pthread_t thread;
+};
+
+static uint64_t monotime_ms (void)
+{
+  struct timespec ts;
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/*
+ * Post entries taken from the buffer: with a batch size of 1, the object which
+ * edgex_log_torest would send, otherwise an array of such objects. Failures
+ * are not logged, as the logger may be the one posting here.
+ */
+
+static void logremote_submit (edgex_logremote_t *lr, edgex_logremote_entry *entries, uint32_t n)
+{
+  edgex_ctx ctx;
+  edgex_jsonbuf buf;
+  edgex_error err = EDGEX_OK;
+  char *json;
+  bool array = (lr->batch > 1);
+
+  edgex_jsonbuf_init (&buf, 128 * n);
+  if (array)
+  {
+    edgex_jsonbuf_appendc (&buf, '[');
+  }
+  for (uint32_t i = 0; i < n; i++)
+  {
+    bool first = true;
+    if (i)
+    {
+      edgex_jsonbuf_appendc (&buf, ',');
+    }
+    edgex_jsonbuf_appendc (&buf, '{');
+    edgex_jsonbuf_member_string (&buf, &first, "originService", entries[i].service);
+    edgex_jsonbuf_member_string (&buf, &first, "logLevel", edgex_logger_levelname (entries[i].level));
+    edgex_jsonbuf_member_uint (&buf, &first, "created", entries[i].created);
+    edgex_jsonbuf_member_string (&buf, &first, "message", entries[i].message);
+    edgex_jsonbuf_appendc (&buf, '}');
+    edgex_memstats_free (EDGEX_MEM_LOGGING, strlen (entries[i].message) + 1);
+    free (entries[i].message);
+  }
+  if (array)
+  {
+    edgex_jsonbuf_appendc (&buf, ']');
+  }
+  json = edgex_jsonbuf_finish (&buf);
+
+  memset (&ctx, 0, sizeof (ctx));
+  edgex_http_post (iot_logger_default (), &ctx, lr->url, json, NULL, &err);
+  free (json);
+
+  pthread_mutex_lock (&lr->lock);
+  if (err.code)
+  {
+    lr->failed += n;
+  }
+  else
+  {
+    lr->sent += n;
+  }
+  pthread_mutex_unlock (&lr->lock);
+}
+
+/* Detach up to a batch of the oldest entries. Called with the lock held */
+
+static uint32_t logremote_take (edgex_logremote_t *lr, edgex_logremote_entry *out)
+{
+  uint32_t n = lr->count < lr->batch ? lr->count : lr->batch;
+  for (uint32_t i = 0; i < n; i++)
+  {
+    out[i] = lr->entries[lr->head];
+    lr->head = (lr->head + 1) % lr->size;
+  }
+  lr->count -= n;
+  lr->first = lr->count ? monotime_ms () : 0;
+  return n;
+}
+
+static void *logremote_thread (void *p)
+{
+  edgex_logremote_t *lr = (edgex_logremote_t *)p;
+  edgex_logremote_entry *out = malloc (lr->batch * sizeof (edgex_logremote_entry));
+
+  edgex_placement_apply (EDGEX_PLACEMENT_IO);
+
+  pthread_mutex_lock (&lr->lock);
+  while (lr->running || lr->count)
+  {
+    uint64_t deadline = lr->first + lr->interval;
+
+    if (lr->count == 0)
+    {
+      pthread_cond_wait (&lr->cond, &lr->lock);
+      continue;
+    }
+
+    if (lr->running && lr->count < lr->batch && monotime_ms () < deadline)
+    {
+      struct timespec ts;
+      ts.tv_sec = deadline / 1000;
+      ts.tv_nsec = (deadline % 1000) * 1000000;
+      pthread_cond_timedwait (&lr->cond, &lr->lock, &ts);
+      continue;
+    }
+
+    uint32_t n = logremote_take (lr, out);
+    pthread_mutex_unlock (&lr->lock);
+    logremote_submit (lr, out, n);
+    pthread_mutex_lock (&lr->lock);
+  }
+  pthread_mutex_unlock (&lr->lock);
+  free (out);
+  return NULL;
+}
+
+edgex_logremote_t *edgex_logremote_alloc (const char *url, uint32_t size, uint32_t batch, uint32_t interval)
+{
+  pthread_condattr_t attr;
+  edgex_logremote_t *lr = calloc (1, sizeof (edgex_logremote_t));
+
+  lr->url = strdup (url);
+  lr->size = size ? size : 1;
+  lr->batch = (batch && batch < lr->size) ? batch : lr->size;
+  lr->interval = interval;
+  lr->entries = malloc (lr->size * sizeof (edgex_logremote_entry));
+  pthread_mutex_init (&lr->lock, NULL);
+  pthread_condattr_init (&attr);
+  pthread_condattr_setclock (&attr, CLOCK_MONOTONIC);
+  pthread_cond_init (&lr->cond, &attr);
+  pthread_condattr_destroy (&attr);
+  lr->running = true;
+  pthread_create (&lr->thread, NULL, logremote_thread, lr);
+  return lr;
+}
+
+const char *edgex_logremote_url (const edgex_logremote_t *lr)
+{
+  return lr->url;
+}
+
+void edgex_logremote_add
+  (edgex_logremote_t *lr, const char *service, iot_loglevel_t l, time_t timestamp, const char *message)
+{
+  pthread_mutex_lock (&lr->lock);
+  if (lr->count == lr->size)
+  {
+    lr->dropped++;
+  }
+  else
+  {
+    edgex_logremote_entry *e = &lr->entries[(lr->head + lr->count) % lr->size];
+    e->service = service;
+    e->level = l;
+    e->created = timestamp;
+    e->message = strdup (message);
+    edgex_memstats_alloc (EDGEX_MEM_LOGGING, strlen (message) + 1);
+    if (lr->count++ == 0)
+    {
+      lr->first = monotime_ms ();
+      pthread_cond_signal (&lr->cond);
+    }
+    else if (lr->count == lr->batch)
+    {
+      pthread_cond_signal (&lr->cond);
+    }
+  }
+  pthread_mutex_unlock (&lr->lock);
+}
+
+void edgex_logremote_getstats (edgex_logremote_t *lr, edgex_logremote_stats *stats)
+{
+  pthread_mutex_lock (&lr->lock);
+  stats->queued = lr->count;
+  stats->sent = lr->sent;
+  stats->dropped = lr->dropped;
+  stats->failed = lr->failed;
+  pthread_mutex_unlock (&lr->lock);
+}
+
+void edgex_logremote_free (edgex_logremote_t *lr)
+{
+  if (lr)
+  {
+    pthread_mutex_lock (&lr->lock);
+    lr->running = false;
+    pthread_cond_signal (&lr->cond);
+    pthread_mutex_unlock (&lr->lock);
+    pthread_join (lr->thread, NULL);
+    pthread_cond_destroy (&lr->cond);
+    pthread_mutex_destroy (&lr->lock);
+    free (lr->entries);
+    free (lr->url);
+    free (lr);
+  }
+}
@@ -0,0 +1,65 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#ifndef _EDGEX_DEVICE_LOGREMOTE_H_
+#define _EDGEX_DEVICE_LOGREMOTE_H_ 1
+
+#include "edgex/edgex-logging.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Submission of log entries to the support-logging service. Entries are held
+ * in a bounded buffer and posted by a thread of their own. By default each is
+ * posted singly as it arrives. If a batch size above 1 is set, entries are
+ * posted as a JSON array when a batch has filled or the flush interval has
+ * passed since the oldest was logged; the logging service must then accept
+ * arrays. Entries logged while the buffer is full are dropped.
+ */
+
+#define EDGEX_LOGREMOTE_DEFAULT_BATCH 1
+#define EDGEX_LOGREMOTE_DEFAULT_INTERVAL 1000
+
+typedef struct edgex_logremote_t edgex_logremote_t;
+
+typedef struct edgex_logremote_stats
+{
+  uint32_t queued;
+  uint64_t sent;
+  uint64_t dropped;
+  uint64_t failed;
+} edgex_logremote_stats;
+
+/*
+ * url: the logging service's endpoint for log entries.
+ * size: the maximum number of entries held.
+ * batch: the maximum number of entries in a request.
+ * interval: the longest time an entry waits to be sent (ms).
+ */
+
+edgex_logremote_t *edgex_logremote_alloc (const char *url, uint32_t size, uint32_t batch, uint32_t interval);
+
+const char *edgex_logremote_url (const edgex_logremote_t *lr);
+
+/* Queue an entry. The message is copied */
+
+void edgex_logremote_add
+  (edgex_logremote_t *lr, const char *service, iot_loglevel_t l, time_t timestamp, const char *message);
+
+void edgex_logremote_getstats (edgex_logremote_t *lr, edgex_logremote_stats *stats);
+
+/* Entries logged to this URL by edgex_log_torest are passed to the batcher. NULL reverts to synchronous posts */
+
+void edgex_log_setremote (edgex_logremote_t *lr);
+
+/* Sends any queued entries and stops the thread */
+
+void edgex_logremote_free (edgex_logremote_t *lr);
+
+#endif
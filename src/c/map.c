@@ -12,13 +12,27 @@
  * under the terms of the MIT license. See LICENSE for details.
  */
 
+/* Tables are kept no more than three quarters full, counting removed slots */
+
+#define EDGEX_MAP_MINSLOTS 8
+
 typedef struct edgex_map_node
 {
-  unsigned hash;
   void *value;
-  edgex_map_node *next;
 } edgex_map_node;
 
+typedef struct edgex_map_slot
+{
+  unsigned hash;
+  edgex_map_node *node;
+} edgex_map_slot;
+
+static edgex_map_node edgex_map_removed;
+
+#define EDGEX_MAP_REMOVED (&edgex_map_removed)
+
+#define edgex_map_key(node) ((const char *) ((node) + 1))
+
 static unsigned edgex_hash (const char *str)
 {
   unsigned hash = 5381u;
@@ -26,6 +40,14 @@ static unsigned edgex_hash (const char *str)
   {
     hash = ((hash << 5) + hash) ^ *str++;
   }
+
+  /* Mix the bits, as only the low ones select the initial slot */
+
+  hash ^= hash >> 16;
+  hash *= 0x85ebca6bu;
+  hash ^= hash >> 13;
+  hash *= 0xc2b2ae35u;
+  hash ^= hash >> 16;
   return hash;
 }
 
@@ -39,181 +61,163 @@ static edgex_map_node *edgex_map_newnode
   if (!node)
   { return NULL; }
   memcpy (node + 1, key, ksize);
-  node->hash = edgex_hash (key);
   node->value = ((char *) (node + 1)) + voffset;
   memcpy (node->value, value, vsize);
   return node;
 }
 
-static int edgex_map_bucketidx (edgex_map_base *m, unsigned hash)
-{
-  /* If the implementation is changed to allow a non-power-of-2 bucket count,
-   * the line below should be changed to use mod instead of AND
-   */
-  return hash & (m->nbuckets - 1);
-}
-
-static void edgex_map_addnode (edgex_map_base *m, edgex_map_node *node)
-{
-  int n = edgex_map_bucketidx (m, node->hash);
-  node->next = m->buckets[n];
-  m->buckets[n] = node;
-}
+/* Find the slot holding a key, or NULL */
 
-static int edgex_map_resize (edgex_map_base *m, int nbuckets)
+static edgex_map_slot *edgex_map_find (const edgex_map_base *m, const char *key, unsigned hash)
 {
-  edgex_map_node *nodes, *node, *next;
-  edgex_map_node **buckets;
-  int i;
-  /* Chain all nodes together */
-  nodes = NULL;
-  i = m->nbuckets;
-  while (i--)
+  if (m->nslots)
   {
-    node = (m->buckets)[i];
-    while (node)
+    unsigned mask = m->nslots - 1;
+    for (unsigned i = hash & mask; m->slots[i].node; i = (i + 1) & mask)
     {
-      next = node->next;
-      node->next = nodes;
-      nodes = node;
-      node = next;
+      edgex_map_slot *slot = &m->slots[i];
+      if (slot->hash == hash && slot->node != EDGEX_MAP_REMOVED && !strcmp (edgex_map_key (slot->node), key))
+      {
+        return slot;
+      }
     }
   }
-  /* Reset buckets */
-  buckets = realloc (m->buckets, sizeof (*m->buckets) * nbuckets);
-  if (buckets != NULL)
+  return NULL;
+}
+
+/* Rebuild the table with the given number of slots (a power of 2), discarding removed slots */
+
+static int edgex_map_resize (edgex_map_base *m, unsigned nslots)
+{
+  edgex_map_slot *slots = calloc (nslots, sizeof (edgex_map_slot));
+  if (slots == NULL)
   {
-    m->buckets = buckets;
-    m->nbuckets = nbuckets;
+    return -1;
   }
-  if (m->buckets)
+  for (unsigned i = 0; i < m->nslots; i++)
   {
-    memset (m->buckets, 0, sizeof (*m->buckets) * m->nbuckets);
-    /* Re-add nodes to buckets */
-    node = nodes;
-    while (node)
+    edgex_map_slot *old = &m->slots[i];
+    if (old->node && old->node != EDGEX_MAP_REMOVED)
     {
-      next = node->next;
-      edgex_map_addnode (m, node);
-      node = next;
+      unsigned j = old->hash & (nslots - 1);
+      while (slots[j].node)
+      {
+        j = (j + 1) & (nslots - 1);
+      }
+      slots[j] = *old;
     }
   }
-  /* Return error code if realloc() failed */
-  return (buckets == NULL) ? -1 : 0;
+  free (m->slots);
+  m->slots = slots;
+  m->nslots = nslots;
+  m->nused = m->nnodes;
+  return 0;
 }
 
-static edgex_map_node **edgex_map_getref (edgex_map_base *m, const char *key)
+static unsigned edgex_map_slotsfor (unsigned n)
 {
-  unsigned hash = edgex_hash (key);
-  if (m->nbuckets > 0)
+  unsigned nslots = EDGEX_MAP_MINSLOTS;
+  while (nslots / 4 * 3 < n)
   {
-    edgex_map_node **next = &m->buckets[edgex_map_bucketidx (m, hash)];
-    while (*next)
-    {
-      if ((*next)->hash == hash && !strcmp ((char *) (*next + 1), key))
-      {
-        return next;
-      }
-      next = &(*next)->next;
-    }
+    nslots <<= 1;
   }
-  return NULL;
+  return nslots;
 }
 
 void edgex_map_deinit_ (edgex_map_base *m)
 {
-  edgex_map_node *next, *node;
-  int i;
-  i = m->nbuckets;
-  while (i--)
+  for (unsigned i = 0; i < m->nslots; i++)
   {
-    node = m->buckets[i];
-    while (node)
+    if (m->slots[i].node != EDGEX_MAP_REMOVED)
     {
-      next = node->next;
-      free (node);
-      node = next;
+      free (m->slots[i].node);
     }
   }
-  free (m->buckets);
+  free (m->slots);
 }
 
 void *edgex_map_get_ (edgex_map_base *m, const char *key)
 {
-  edgex_map_node **next = edgex_map_getref (m, key);
-  return next ? (*next)->value : NULL;
+  edgex_map_slot *slot = edgex_map_find (m, key, edgex_hash (key));
+  return slot ? slot->node->value : NULL;
 }
 
 int edgex_map_set_ (edgex_map_base *m, const char *key, void *value, int vsize)
 {
-  int n, err;
-  edgex_map_node **next, *node;
+  edgex_map_node *node;
+  unsigned hash = edgex_hash (key);
+  unsigned mask;
+  unsigned i;
+
   /* Find & replace existing node */
-  next = edgex_map_getref (m, key);
-  if (next)
+
+  edgex_map_slot *slot = edgex_map_find (m, key, hash);
+  if (slot)
   {
-    memcpy ((*next)->value, value, vsize);
+    memcpy (slot->node->value, value, vsize);
     return 0;
   }
-  /* Add new node */
+
+  /* Add new node, first growing (or clearing removed slots from) the table if necessary */
+
   node = edgex_map_newnode (key, value, vsize);
   if (node == NULL)
-  { goto fail; }
-  if (m->nnodes >= m->nbuckets)
   {
-    n = (m->nbuckets > 0) ? (m->nbuckets << 1) : 1;
-    err = edgex_map_resize (m, n);
-    if (err)
-    { goto fail; }
+    return -1;
+  }
+  if (m->nused + 1 > m->nslots / 4 * 3)
+  {
+    if (edgex_map_resize (m, edgex_map_slotsfor (m->nnodes + 1)))
+    {
+      free (node);
+      return -1;
+    }
   }
-  edgex_map_addnode (m, node);
+  mask = m->nslots - 1;
+  for (i = hash & mask; m->slots[i].node && m->slots[i].node != EDGEX_MAP_REMOVED; i = (i + 1) & mask);
+  if (m->slots[i].node == NULL)
+  {
+    m->nused++;
+  }
+  m->slots[i].hash = hash;
+  m->slots[i].node = node;
   m->nnodes++;
   return 0;
-  fail:
-  if (node)
-  { free (node); }
-  return -1;
 }
 
 void edgex_map_remove_ (edgex_map_base *m, const char *key)
 {
-  edgex_map_node **next = edgex_map_getref (m, key);
-  if (next)
+  edgex_map_slot *slot = edgex_map_find (m, key, edgex_hash (key));
+  if (slot)
   {
-    edgex_map_node *node = *next;
-    *next = (*next)->next;
-    free (node);
+    free (slot->node);
+    slot->node = EDGEX_MAP_REMOVED;
     m->nnodes--;
   }
 }
 
+int edgex_map_reserve_ (edgex_map_base *m, unsigned n)
+{
+  unsigned nslots = edgex_map_slotsfor (n);
+  return (nslots > m->nslots) ? edgex_map_resize (m, nslots) : 0;
+}
+
 edgex_map_iter edgex_map_iter_ (void)
 {
   edgex_map_iter iter;
-  iter.bucketidx = -1;
-  iter.node = NULL;
+  iter.slotidx = -1;
   return iter;
 }
 
 const char *edgex_map_next_ (edgex_map_base *m, edgex_map_iter *iter)
 {
-  if (iter->node)
-  {
-    iter->node = iter->node->next;
-    if (iter->node == NULL)
-    { goto nextBucket; }
-  }
-  else
+  while (++iter->slotidx < m->nslots)
   {
-    nextBucket:
-    do
+    edgex_map_node *node = m->slots[iter->slotidx].node;
+    if (node && node != EDGEX_MAP_REMOVED)
     {
-      if (++iter->bucketidx >= m->nbuckets)
-      {
-        return NULL;
-      }
-      iter->node = m->buckets[iter->bucketidx];
-    } while (iter->node == NULL);
+      return edgex_map_key (node);
+    }
   }
-  return (char *) (iter->node + 1);
+  return NULL;
 }
@@ -10,20 +10,31 @@
  * under the terms of the MIT license. See LICENSE for details.
  */
 
+/*
+ * The table is open-addressed with linear probing. Each slot caches the
+ * hash of its key alongside a pointer to the node which holds the key and
+ * value together in one allocation, so probes compare hashes without
+ * touching the nodes, and pointers to values remain valid until their key is
+ * removed. Removed slots are marked rather than emptied, so removal during
+ * iteration is safe.
+ */
+
 struct edgex_map_node;
 typedef struct edgex_map_node edgex_map_node;
 
+struct edgex_map_slot;
+
 typedef struct
 {
-  edgex_map_node **buckets;
-  unsigned nbuckets;
+  struct edgex_map_slot *slots;
+  unsigned nslots;
   unsigned nnodes;
+  unsigned nused;
 } edgex_map_base;
 
 typedef struct
 {
-  unsigned bucketidx;
-  edgex_map_node *node;
+  unsigned slotidx;
 } edgex_map_iter;
 
 #define edgex_map(T) \
@@ -46,6 +57,10 @@ struct \
 
 #define edgex_map_remove(m, key) edgex_map_remove_ (&(m)->base, key)
 
+#define edgex_map_reserve(m, n) edgex_map_reserve_ (&(m)->base, n)
+
+#define edgex_map_size(m) ((m)->base.nnodes)
+
 #define edgex_map_iter(m) edgex_map_iter_ ()
 
 #define edgex_map_next(m, iter) edgex_map_next_ (&(m)->base, iter)
@@ -59,6 +74,10 @@ extern int edgex_map_set_
 
 extern void edgex_map_remove_ (edgex_map_base *m, const char *key);
 
+/* Size the table to hold n entries without further resizing */
+
+extern int edgex_map_reserve_ (edgex_map_base *m, unsigned n);
+
 extern edgex_map_iter edgex_map_iter_ (void);
 
 extern const char *edgex_map_next_ (edgex_map_base *m, edgex_map_iter *iter);
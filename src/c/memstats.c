@@ -0,0 +1,60 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#include "memstats.h"
+
+#include <stdatomic.h>
+
+/* Each subsystem's counters are on a cache line of their own */
+
+typedef struct memstats_tag
+{
+  _Alignas (64) atomic_int_fast64_t live;
+  atomic_int_fast64_t peak;
+  atomic_uint_fast64_t allocated;
+  atomic_uint_fast64_t allocations;
+} memstats_tag;
+
+static memstats_tag tags[EDGEX_MEMTAGS];
+
+static const char *tagnames[EDGEX_MEMTAGS] =
+  { "Devmap", "Events", "HttpClient", "RestServer", "Parson", "Logging", "Pools" };
+
+void edgex_memstats_alloc (edgex_memtag tag, size_t bytes)
+{
+  memstats_tag *t = &tags[tag];
+  int_fast64_t live = atomic_fetch_add_explicit (&t->live, bytes, memory_order_relaxed) + bytes;
+  int_fast64_t peak = atomic_load_explicit (&t->peak, memory_order_relaxed);
+
+  while (live > peak && !atomic_compare_exchange_weak_explicit
+    (&t->peak, &peak, live, memory_order_relaxed, memory_order_relaxed));
+  atomic_fetch_add_explicit (&t->allocated, bytes, memory_order_relaxed);
+  atomic_fetch_add_explicit (&t->allocations, 1, memory_order_relaxed);
+}
+
+void edgex_memstats_free (edgex_memtag tag, size_t bytes)
+{
+  atomic_fetch_sub_explicit (&tags[tag].live, bytes, memory_order_relaxed);
+}
+
+/* Sizes are as reckoned by each subsystem, so live is reported as zero should they disagree */
+
+void edgex_memstats_get (edgex_memtag tag, edgex_memstats *stats)
+{
+  memstats_tag *t = &tags[tag];
+  int_fast64_t live = atomic_load_explicit (&t->live, memory_order_relaxed);
+  stats->live = live > 0 ? live : 0;
+  stats->peak = atomic_load_explicit (&t->peak, memory_order_relaxed);
+  stats->allocated = atomic_load_explicit (&t->allocated, memory_order_relaxed);
+  stats->allocations = atomic_load_explicit (&t->allocations, memory_order_relaxed);
+}
+
+const char *edgex_memstats_tagname (edgex_memtag tag)
+{
+  return tagnames[tag];
+}
@@ -0,0 +1,62 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#ifndef _EDGEX_DEVICE_MEMSTATS_H_
+#define _EDGEX_DEVICE_MEMSTATS_H_ 1
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Process-wide accounting of memory held by SDK subsystems. Each subsystem
+ * reports the bytes of the structures it owns as they are allocated and
+ * released; allocator overheads are not included. For each subsystem the
+ * live and peak bytes, and the total bytes and number of allocations, are
+ * kept.
+ *
+ *   Devmap     - device and profile records held in the device map.
+ *   Events     - encoded events, until they are freed.
+ *   HttpClient - response bodies being received from other services.
+ *   RestServer - contexts and bodies of requests in progress.
+ *   Parson     - arena blocks used for JSON parsing.
+ *   Logging    - log messages queued for a file or a remote logging service.
+ *   Pools      - buffers held by the reading and result pools.
+ */
+
+typedef enum
+{
+  EDGEX_MEM_DEVMAP,
+  EDGEX_MEM_EVENTS,
+  EDGEX_MEM_HTTPCLIENT,
+  EDGEX_MEM_RESTSERVER,
+  EDGEX_MEM_PARSON,
+  EDGEX_MEM_LOGGING,
+  EDGEX_MEM_POOLS
+} edgex_memtag;
+
+#define EDGEX_MEMTAGS (EDGEX_MEM_POOLS + 1)
+
+typedef struct edgex_memstats
+{
+  uint64_t live;
+  uint64_t peak;
+  uint64_t allocated;
+  uint64_t allocations;
+} edgex_memstats;
+
+/* Account an allocation, or the release of memory previously accounted */
+
+void edgex_memstats_alloc (edgex_memtag tag, size_t bytes);
+
+void edgex_memstats_free (edgex_memtag tag, size_t bytes);
+
+void edgex_memstats_get (edgex_memtag tag, edgex_memstats *stats);
+
+const char *edgex_memstats_tagname (edgex_memtag tag);
+
+#endif
@@ -15,6 +15,170 @@
 #include "errorlist.h"
 #include "config.h"
 #include "profiles.h"
+#include "map.h"
+
+#include <pthread.h>
+
+/*
+ * Responses to GET requests for device services, profiles and devices are
+ * cached if metadata supplies an ETag or Last-Modified header. Later
+ * requests for the same URL are made conditional, and a 304 response is
+ * answered from the cache. When the cache is full the least recently used
+ * entry is discarded.
+ */
+
+#define METADATA_CACHE_MAX 256
+
+typedef struct metadata_cached
+{
+  char *etag;
+  char *modified;
+  char *body;
+  uint64_t used;
+} metadata_cached;
+
+typedef edgex_map(metadata_cached) edgex_map_metadata_cached;
+
+static edgex_map_metadata_cached mdcache;
+static bool mdcache_init = false;
+static uint64_t mdcache_tick = 0;
+static pthread_mutex_t mdcache_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void mdcache_entry_free (metadata_cached *e)
+{
+  free (e->etag);
+  free (e->modified);
+  free (e->body);
+}
+
+/* Called with the lock held */
+
+static void mdcache_evict (void)
+{
+  const char *key;
+  const char *oldest = NULL;
+  uint64_t oldtick = UINT64_MAX;
+  edgex_map_iter iter = edgex_map_iter (mdcache);
+
+  while ((key = edgex_map_next (&mdcache, &iter)))
+  {
+    metadata_cached *e = edgex_map_get (&mdcache, key);
+    if (e->used < oldtick)
+    {
+      oldtick = e->used;
+      oldest = key;
+    }
+  }
+  if (oldest)
+  {
+    mdcache_entry_free (edgex_map_get (&mdcache, oldest));
+    edgex_map_remove (&mdcache, oldest);
+  }
+}
+
+static long metadata_get (iot_logger_t *lc, edgex_ctx *ctx, const char *url, edgex_error *err)
+{
+  long rc;
+  metadata_cached *e;
+  edgex_nvpairs etagreq = { .name = "If-None-Match", .value = NULL, .next = NULL };
+  edgex_nvpairs modreq = { .name = "If-Modified-Since", .value = NULL, .next = NULL };
+  edgex_nvpairs modrsp = { .name = "Last-Modified", .value = NULL, .next = NULL };
+  edgex_nvpairs etagrsp = { .name = "ETag", .value = NULL, .next = &modrsp };
+
+  pthread_mutex_lock (&mdcache_lock);
+  if (!mdcache_init)
+  {
+    edgex_map_init (&mdcache);
+    mdcache_init = true;
+  }
+  e = edgex_map_get (&mdcache, url);
+  if (e)
+  {
+    if (e->etag)
+    {
+      etagreq.value = strdup (e->etag);
+      ctx->reqhdrs = &etagreq;
+    }
+    else
+    {
+      modreq.value = strdup (e->modified);
+      ctx->reqhdrs = &modreq;
+    }
+  }
+  pthread_mutex_unlock (&mdcache_lock);
+
+  ctx->rsphdrs = &etagrsp;
+  rc = edgex_http_get (lc, ctx, url, edgex_http_write_cb, err);
+  ctx->reqhdrs = NULL;
+  ctx->rsphdrs = NULL;
+
+  pthread_mutex_lock (&mdcache_lock);
+  e = edgex_map_get (&mdcache, url);
+  if (rc == 304)
+  {
+    free (ctx->buff);
+    ctx->buff = NULL;
+    if (e)
+    {
+      ctx->buff = strdup (e->body);
+      e->used = ++mdcache_tick;
+      *err = EDGEX_OK;
+      rc = 200;
+    }
+    else
+    {
+      *err = EDGEX_HTTP_ERROR;
+    }
+  }
+  else if (err->code == 0 && ctx->buff && (etagrsp.value || modrsp.value))
+  {
+    metadata_cached entry;
+    if (e)
+    {
+      mdcache_entry_free (e);
+    }
+    else if (edgex_map_size (&mdcache) >= METADATA_CACHE_MAX)
+    {
+      mdcache_evict ();
+    }
+    entry.etag = etagrsp.value;
+    entry.modified = modrsp.value;
+    entry.body = strdup (ctx->buff);
+    entry.used = ++mdcache_tick;
+    edgex_map_set (&mdcache, url, entry);
+    etagrsp.value = NULL;
+    modrsp.value = NULL;
+  }
+  else if (e)
+  {
+    mdcache_entry_free (e);
+    edgex_map_remove (&mdcache, url);
+  }
+  pthread_mutex_unlock (&mdcache_lock);
+
+  free (etagreq.value);
+  free (modreq.value);
+  free (etagrsp.value);
+  free (modrsp.value);
+  return rc;
+}
+
+void edgex_metadata_client_cache_clear (void)
+{
+  pthread_mutex_lock (&mdcache_lock);
+  if (mdcache_init)
+  {
+    const char *key;
+    edgex_map_iter iter = edgex_map_iter (mdcache);
+    while ((key = edgex_map_next (&mdcache, &iter)))
+    {
+      mdcache_entry_free (edgex_map_get (&mdcache, key));
+    }
+    edgex_map_deinit (&mdcache);
+    mdcache_init = false;
+  }
+  pthread_mutex_unlock (&mdcache_lock);
+}
 
 edgex_deviceprofile *edgex_metadata_client_get_deviceprofile
 (
@@ -42,7 +206,7 @@ edgex_deviceprofile *edgex_metadata_client_get_deviceprofile
     ename
   );
 
-  edgex_http_get (lc, &ctx, url, edgex_http_write_cb, err);
+  metadata_get (lc, &ctx, url, err);
 
   if (err->code == 0)
   {
@@ -215,7 +379,7 @@ edgex_deviceservice *edgex_metadata_client_get_deviceservice
     name
   );
 
-  rc = edgex_http_get (lc, &ctx, url, edgex_http_write_cb, err);
+  rc = metadata_get (lc, &ctx, url, err);
 
   if (rc == 404)
   {
@@ -298,6 +462,108 @@ edgex_device *edgex_metadata_client_get_devices
   return result;
 }
 
+/*
+ * Incremental device list loader. The response is a JSON array of device
+ * objects, which is read as it arrives; devices are built directly from it,
+ * so neither the whole response nor a tree for it is held in memory. The
+ * edgex_ctx must be the first member, as curl passes it to the write callback.
+ */
+
+typedef struct devload_ctx
+{
+  edgex_ctx ctx;
+  edgex_devices_reader_t *reader;
+  bool invalid;
+  unsigned pagesize;
+  unsigned count;
+  edgex_device *page;
+  edgex_device **tail;
+  edgex_metadata_devices_handler handler;
+  void *hctx;
+} devload_ctx;
+
+static void devload_flush (devload_ctx *dl)
+{
+  if (dl->page)
+  {
+    dl->handler (dl->hctx, dl->page);
+    dl->page = NULL;
+    dl->tail = &dl->page;
+    dl->count = 0;
+  }
+}
+
+static void devload_add (void *ctx, edgex_device *dev)
+{
+  devload_ctx *dl = (devload_ctx *)ctx;
+  *dl->tail = dev;
+  dl->tail = &dev->next;
+  if (++dl->count == dl->pagesize)
+  {
+    devload_flush (dl);
+  }
+}
+
+static size_t devload_write_cb (void *contents, size_t size, size_t nmemb, void *userp)
+{
+  devload_ctx *dl = (devload_ctx *)userp;
+  size *= nmemb;
+  if (!dl->invalid && !edgex_devices_reader_feed (dl->reader, contents, size))
+  {
+    dl->invalid = true;
+  }
+  return size;
+}
+
+void edgex_metadata_client_load_devices
+(
+  iot_logger_t *lc,
+  edgex_service_endpoints *endpoints,
+  const char *servicename,
+  unsigned pagesize,
+  edgex_metadata_devices_handler handler,
+  void *ctx,
+  edgex_error *err
+)
+{
+  devload_ctx dl;
+  char url[URL_BUF_SIZE];
+
+  memset (&dl, 0, sizeof (devload_ctx));
+  dl.reader = edgex_devices_reader_alloc (lc, devload_add, &dl);
+  dl.pagesize = pagesize;
+  dl.tail = &dl.page;
+  dl.handler = handler;
+  dl.hctx = ctx;
+  snprintf
+  (
+    url,
+    URL_BUF_SIZE - 1,
+    "http://%s:%u/api/v1/device/servicename/%s",
+    endpoints->metadata.host,
+    endpoints->metadata.port,
+    servicename
+  );
+
+  edgex_http_get (lc, &dl.ctx, url, devload_write_cb, err);
+
+  if (err->code == 0 && (dl.invalid || !edgex_devices_reader_finish (dl.reader)))
+  {
+    iot_log_error (lc, "Device list from metadata is not a valid JSON array");
+    *err = EDGEX_HTTP_ERROR;
+  }
+  if (err->code)
+  {
+    edgex_device_free (dl.page);
+  }
+  else
+  {
+    devload_flush (&dl);
+  }
+  edgex_devices_reader_free (dl.reader);
+  free (dl.ctx.buff);
+}
+
 char *edgex_metadata_client_add_device
 (
   iot_logger_t *lc,
@@ -389,7 +655,7 @@ edgex_device *edgex_metadata_client_get_device
     deviceid
   );
 
-  edgex_http_get (lc, &ctx, url, edgex_http_write_cb, err);
+  metadata_get (lc, &ctx, url, err);
 
   if (err->code)
   {
@@ -425,7 +691,7 @@ edgex_device *edgex_metadata_client_get_device_byname
     devicename
   );
 
-  edgex_http_get (lc, &ctx, url, edgex_http_write_cb, err);
+  metadata_get (lc, &ctx, url, err);
 
   if (err->code)
   {
@@ -560,7 +826,7 @@ edgex_addressable *edgex_metadata_client_get_addressable
     name
   );
 
-  rc = edgex_http_get (lc, &ctx, url, edgex_http_write_cb, err);
+  rc = metadata_get (lc, &ctx, url, err);
 
   if (err->code)
   {
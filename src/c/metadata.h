@@ -80,6 +80,30 @@ edgex_device * edgex_metadata_client_get_devices
   const char * servicename,
   edgex_error *err
 );
+
+/*
+ * Retrieve the service's devices as for get_devices, but parse them as the
+ * response arrives, passing them to the handler in lists of at most pagesize
+ * devices. The handler takes ownership of each list.
+ */
+
+typedef void (*edgex_metadata_devices_handler) (void *ctx, edgex_device *devs);
+
+void edgex_metadata_client_load_devices
+(
+  iot_logger_t *lc,
+  edgex_service_endpoints * endpoints,
+  const char * servicename,
+  unsigned pagesize,
+  edgex_metadata_devices_handler handler,
+  void *ctx,
+  edgex_error *err
+);
+
+/* Discard the cached responses to metadata requests */
+
+void edgex_metadata_client_cache_clear (void);
+
 char * edgex_metadata_client_add_device
 (
   iot_logger_t *lc,
@@ -10,6 +10,12 @@
 #include "parson.h"
 #include "service.h"
 #include "edgex-time.h"
+#include "jsonbuf.h"
+#include "bufpool.h"
+#include "memstats.h"
+
+#include <inttypes.h>
+#include <stdio.h>
 
 #include <sys/time.h>
 #include <sys/resource.h>
@@ -40,16 +46,42 @@ int edgex_device_handler_metrics
   JSON_Value *val = json_value_init_object ();
   JSON_Object *obj = json_value_get_object (val);
 
-#ifdef __GNU_LIBRARY__
   JSON_Value *memval = json_value_init_object ();
   JSON_Object *memobj = json_value_get_object (memval);
+  JSON_Value *subval = json_value_init_object ();
+  JSON_Object *subobj = json_value_get_object (subval);
+  double uptime = (double)(edgex_device_millitime () - svc->starttime) / EDGEX_MILLIS;
+
+  /* mallinfo2 does not overflow on heaps over 4GiB, where it is available */
 
+#if defined (__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+  struct mallinfo2 mi = mallinfo2 ();
+  json_object_set_uint (memobj, "Alloc", mi.uordblks);
+  json_object_set_uint (memobj, "TotalAlloc", mi.arena + mi.hblkhd);
+#elif defined (__GNU_LIBRARY__)
   struct mallinfo mi = mallinfo ();
   json_object_set_uint (memobj, "Alloc", mi.uordblks);
   json_object_set_uint (memobj, "TotalAlloc", mi.arena + mi.hblkhd);
+#endif
+
+  for (unsigned t = 0; t < EDGEX_MEMTAGS; t++)
+  {
+    edgex_memstats ms;
+    JSON_Value *tval = json_value_init_object ();
+    JSON_Object *tobj = json_value_get_object (tval);
 
+    edgex_memstats_get (t, &ms);
+    json_object_set_uint (tobj, "Live", ms.live);
+    json_object_set_uint (tobj, "Peak", ms.peak);
+    json_object_set_uint (tobj, "Allocated", ms.allocated);
+    json_object_set_uint (tobj, "Allocations", ms.allocations);
+    json_object_set_number (tobj, "AllocRate", uptime > 0.0 ? ms.allocated / uptime : 0.0);
+    json_object_set_value (subobj, edgex_memstats_tagname (t), tval);
+  }
+  json_object_set_value (memobj, "Subsystems", subval);
   json_object_set_value (obj, "Memory", memval);
 
+#ifdef __GNU_LIBRARY__
   double loads[1];
   if (getloadavg (loads, 1) == 1)
   {
@@ -66,9 +98,446 @@ int edgex_device_handler_metrics
     json_object_set_number (obj, "CpuTime", cputime);
     json_object_set_number (obj, "CpuAvgUsage", cputime / walltime);
   }
+
+  if (svc->postq)
+  {
+    edgex_postq_stats qstats;
+    JSON_Value *qval = json_value_init_object ();
+    JSON_Object *qobj = json_value_get_object (qval);
+
+    edgex_postq_getstats (svc->postq, &qstats);
+    json_object_set_uint (qobj, "Depth", qstats.depth);
+    json_object_set_string (qobj, "Policy", edgex_postq_policyname (svc->postq));
+    json_object_set_uint (qobj, "Queued", qstats.queued);
+    json_object_set_uint (qobj, "Dropped", qstats.dropped);
+    json_object_set_uint (qobj, "Coalesced", qstats.coalesced);
+    json_object_set_value (obj, "PostQueue", qval);
+  }
+
+  if (svc->readcache)
+  {
+    edgex_readcache_stats cstats;
+    JSON_Value *cval = json_value_init_object ();
+    JSON_Object *cobj = json_value_get_object (cval);
+
+    edgex_readcache_getstats (svc->readcache, &cstats);
+    json_object_set_uint (cobj, "Entries", cstats.entries);
+    json_object_set_uint (cobj, "Hits", cstats.hits);
+    json_object_set_uint (cobj, "Misses", cstats.misses);
+    json_object_set_value (obj, "ReadCache", cval);
+  }
+
+  if (svc->aecircuit)
+  {
+    edgex_circuit_stats astats;
+    JSON_Value *aval = json_value_init_object ();
+    JSON_Object *aobj = json_value_get_object (aval);
+
+    edgex_circuit_getstats (svc->aecircuit, &astats);
+    json_object_set_uint (aobj, "Failing", astats.failing);
+    json_object_set_uint (aobj, "Open", astats.open);
+    json_object_set_uint (aobj, "Failures", astats.failures);
+    json_object_set_uint (aobj, "Skipped", astats.skipped);
+    json_object_set_value (aobj, "Devices", edgex_circuit_devices (svc->aecircuit));
+    json_object_set_value (obj, "AutoEventFailures", aval);
+  }
+
+  if (svc->logfile)
+  {
+    edgex_logfile_stats lstats;
+    JSON_Value *lval = json_value_init_object ();
+    JSON_Object *lobj = json_value_get_object (lval);
+
+    edgex_logfile_getstats (svc->logfile, &lstats);
+    json_object_set_string (lobj, "Policy", edgex_logfile_policyname (svc->logfile));
+    json_object_set_uint (lobj, "Written", lstats.written);
+    json_object_set_uint (lobj, "Dropped", lstats.dropped);
+    json_object_set_uint (lobj, "Rotations", lstats.rotations);
+    json_object_set_value (obj, "LogFile", lval);
+  }
+
+  if (svc->logremote)
+  {
+    edgex_logremote_stats rstats;
+    JSON_Value *rval = json_value_init_object ();
+    JSON_Object *robj = json_value_get_object (rval);
+
+    edgex_logremote_getstats (svc->logremote, &rstats);
+    json_object_set_uint (robj, "Queued", rstats.queued);
+    json_object_set_uint (robj, "Sent", rstats.sent);
+    json_object_set_uint (robj, "Dropped", rstats.dropped);
+    json_object_set_uint (robj, "Failed", rstats.failed);
+    json_object_set_value (obj, "RemoteLog", rval);
+  }
+
+  if (svc->mqtt)
+  {
+    edgex_mqtt_stats mstats;
+    JSON_Value *mval = json_value_init_object ();
+    JSON_Object *mobj = json_value_get_object (mval);
+
+    edgex_mqtt_getstats (svc->mqtt, &mstats);
+    json_object_set_string (mobj, "Broker", edgex_mqtt_broker (svc->mqtt));
+    json_object_set_boolean (mobj, "Connected", mstats.connected);
+    json_object_set_uint (mobj, "Queued", mstats.queued);
+    json_object_set_uint (mobj, "InFlight", mstats.inflight);
+    json_object_set_uint (mobj, "Published", mstats.published);
+    json_object_set_uint (mobj, "Dropped", mstats.dropped);
+    json_object_set_uint (mobj, "Connects", mstats.connects);
+    json_object_set_value (obj, "MQTT", mval);
+  }
+
+  if (svc->eventring)
+  {
+    edgex_eventring_stats estats;
+    JSON_Value *eval = json_value_init_object ();
+    JSON_Object *eobj = json_value_get_object (eval);
+
+    edgex_eventring_getstats (svc->eventring, &estats);
+    json_object_set_string (eobj, "Name", edgex_eventring_name (svc->eventring));
+    json_object_set_string (eobj, "Format", edgex_eventring_formatname (svc->eventring));
+    json_object_set_uint (eobj, "Written", estats.written);
+    json_object_set_uint (eobj, "Dropped", estats.dropped);
+    json_object_set_uint (eobj, "Overwritten", estats.overwritten);
+    json_object_set_value (obj, "EventRing", eval);
+  }
+
+  {
+    edgex_bufpool_stats bstats;
+    JSON_Value *bval = json_value_init_object ();
+    JSON_Object *bobj = json_value_get_object (bval);
+
+    edgex_bufpool_getstats (&bstats);
+    json_object_set_uint (bobj, "Reserved", bstats.reserved);
+    json_object_set_uint (bobj, "Used", bstats.used);
+    json_object_set_uint (bobj, "Fallback", bstats.fallback);
+    json_object_set_value (obj, "BufferPool", bval);
+  }
+
+  if (svc->tracer)
+  {
+    edgex_tracer_stats tstats;
+    JSON_Value *tval = json_value_init_object ();
+    JSON_Object *tobj = json_value_get_object (tval);
+
+    edgex_tracer_getstats (svc->tracer, &tstats);
+    json_object_set_string (tobj, "Exporter", edgex_tracer_exportername (svc->tracer));
+    json_object_set_uint (tobj, "Exported", tstats.exported);
+    json_object_set_uint (tobj, "Dropped", tstats.dropped);
+    json_object_set_uint (tobj, "Failed", tstats.failed);
+    json_object_set_value (obj, "Tracing", tval);
+  }
+
+  {
+    edgex_pool_stats ps;
+    JSON_Value *pval = json_value_init_object ();
+    JSON_Object *pobj = json_value_get_object (pval);
+
+    for (unsigned i = 0; edgex_pool_getstats (i, &ps); i++)
+    {
+      JSON_Value *tval = json_value_init_object ();
+      JSON_Object *tobj = json_value_get_object (tval);
+      json_object_set_uint (tobj, "Threads", ps.threads);
+      json_object_set_uint (tobj, "Active", ps.active);
+      json_object_set_uint (tobj, "Queued", ps.queued);
+      json_object_set_uint (tobj, "Completed", ps.completed);
+      json_object_set_value (tobj, "Wait", edgex_histogram_json (ps.wait));
+      json_object_set_value (pobj, ps.name, tval);
+    }
+    json_object_set_value (obj, "ThreadPools", pval);
+  }
+
+  json_object_set_value (obj, "AutoEventLag", edgex_histogram_json (edgex_timing_histogram (EDGEX_TIMING_AUTOEVENT_LAG)));
+
+  if (svc->latency)
+  {
+    json_object_set_value (obj, "Latency", edgex_latency_json (svc->latency));
+  }
+
+  if (svc->admission)
+  {
+    edgex_admission_stats as;
+    JSON_Value *aval = json_value_init_object ();
+    JSON_Object *aobj = json_value_get_object (aval);
+
+    edgex_admission_getstats (svc->admission, &as);
+    json_object_set_uint (aobj, "InFlight", as.inflight);
+    json_object_set_uint (aobj, "Admitted", as.admitted);
+    json_object_set_uint (aobj, "Shed", as.shed);
+    json_object_set_value (aobj, "Wait", edgex_histogram_json (as.wait));
+    json_object_set_value (obj, "Admission", aval);
+  }
+
+  if (svc->qos)
+  {
+    edgex_qos_stats qs;
+    JSON_Value *qval = json_value_init_object ();
+    JSON_Object *qobj = json_value_get_object (qval);
+
+    json_object_set_uint (qobj, "Slots", edgex_qos_slots (svc->qos));
+    for (unsigned c = 0; c < EDGEX_QOS_CLASSES; c++)
+    {
+      JSON_Value *cval = json_value_init_object ();
+      JSON_Object *cobj = json_value_get_object (cval);
+      edgex_qos_getstats (svc->qos, c, &qs);
+      json_object_set_uint (cobj, "Waiting", qs.waiting);
+      json_object_set_uint (cobj, "Admitted", qs.admitted);
+      json_object_set_uint (cobj, "Promoted", qs.promoted);
+      json_object_set_value (cobj, "Wait", edgex_histogram_json (qs.wait));
+      json_object_set_value (cobj, "Service", edgex_histogram_json (qs.service));
+      json_object_set_value (qobj, edgex_qos_classname (c), cval);
+    }
+    json_object_set_value (obj, "DriverCalls", qval);
+  }
+
+  if (svc->inflight)
+  {
+    json_object_set_uint (obj, "CoalescedReads", edgex_inflight_coalesced (svc->inflight));
+  }
+
   *reply = json_serialize_to_string (val);
   *reply_size = strlen (*reply);
   *reply_type = "application/json";
   json_value_free (val);
   return MHD_HTTP_OK;
 }
+
+/* Histogram buckets are reported for times up to 2^OM_MAXBITS - 1 us (about 33s) */
+
+#define OM_MINBITS 4
+#define OM_MAXBITS 25
+
+static void om_family (edgex_jsonbuf *b, const char *name, const char *type, const char *help)
+{
+  char line[256];
+  snprintf (line, sizeof (line), "# TYPE %s %s\n# HELP %s %s\n", name, type, name, help);
+  edgex_jsonbuf_append (b, line, strlen (line));
+}
+
+static void om_sample (edgex_jsonbuf *b, const char *name, const char *suffix, uint64_t value)
+{
+  char line[256];
+  snprintf (line, sizeof (line), "%s%s %" PRIu64 "\n", name, suffix, value);
+  edgex_jsonbuf_append (b, line, strlen (line));
+}
+
+static void om_counter (edgex_jsonbuf *b, const char *name, const char *help, edgex_counter c)
+{
+  om_family (b, name, "counter", help);
+  om_sample (b, name, "_total", edgex_counter_value (c));
+}
+
+static void om_gauge (edgex_jsonbuf *b, const char *name, const char *help, uint64_t value)
+{
+  om_family (b, name, "gauge", help);
+  om_sample (b, name, "", value);
+}
+
+/*
+ * Write the samples of a histogram. Labels, if not empty, are given as
+ * name="value" pairs followed by a comma. Bucket bounds are whole numbers of
+ * microseconds, so they are exact when given in seconds.
+ */
+
+static void om_buckets (edgex_jsonbuf *b, const char *name, const char *labels, edgex_histogram *h)
+{
+  char line[256];
+  uint64_t count = atomic_load (&h->count);
+  uint64_t sum = atomic_load (&h->sum);
+  size_t llen = strlen (labels);
+
+  for (unsigned bits = OM_MINBITS; bits <= OM_MAXBITS; bits++)
+  {
+    uint64_t le = (UINT64_C (1) << bits) - 1;
+    uint64_t below = edgex_histogram_below (h, bits);
+    snprintf
+    (
+      line, sizeof (line), "%s_bucket{%sle=\"%" PRIu64 ".%06" PRIu64 "\"} %" PRIu64 "\n",
+      name, labels, le / EDGEX_MICROS, le % EDGEX_MICROS, below > count ? count : below
+    );
+    edgex_jsonbuf_append (b, line, strlen (line));
+  }
+  snprintf (line, sizeof (line), "%s_bucket{%sle=\"+Inf\"} %" PRIu64 "\n", name, labels, count);
+  edgex_jsonbuf_append (b, line, strlen (line));
+  snprintf
+  (
+    line, sizeof (line), "%s_count%s%.*s%s %" PRIu64 "\n%s_sum%s%.*s%s %" PRIu64 ".%06" PRIu64 "\n",
+    name, llen ? "{" : "", (int)(llen ? llen - 1 : 0), labels, llen ? "}" : "", count,
+    name, llen ? "{" : "", (int)(llen ? llen - 1 : 0), labels, llen ? "}" : "", sum / EDGEX_MICROS, sum % EDGEX_MICROS
+  );
+  edgex_jsonbuf_append (b, line, strlen (line));
+}
+
+static void om_histogram (edgex_jsonbuf *b, const char *name, const char *help, edgex_timing t)
+{
+  om_family (b, name, "histogram", help);
+  om_buckets (b, name, "", edgex_timing_histogram (t));
+}
+
+/* Gauges, counters and histograms for each of the thread pools, labelled by pool */
+
+static void om_pools (edgex_jsonbuf *b)
+{
+  char line[256];
+  char labels[64];
+  edgex_pool_stats ps;
+
+  om_family (b, "edgex_device_threadpool_threads", "gauge", "Threads in the pool");
+  for (unsigned i = 0; edgex_pool_getstats (i, &ps); i++)
+  {
+    snprintf (line, sizeof (line), "edgex_device_threadpool_threads{pool=\"%s\"} %" PRIu32 "\n", ps.name, ps.threads);
+    edgex_jsonbuf_append (b, line, strlen (line));
+  }
+  om_family (b, "edgex_device_threadpool_active", "gauge", "Threads running a job");
+  for (unsigned i = 0; edgex_pool_getstats (i, &ps); i++)
+  {
+    snprintf (line, sizeof (line), "edgex_device_threadpool_active{pool=\"%s\"} %" PRIu32 "\n", ps.name, ps.active);
+    edgex_jsonbuf_append (b, line, strlen (line));
+  }
+  om_family (b, "edgex_device_threadpool_queued", "gauge", "Jobs waiting to start");
+  for (unsigned i = 0; edgex_pool_getstats (i, &ps); i++)
+  {
+    snprintf (line, sizeof (line), "edgex_device_threadpool_queued{pool=\"%s\"} %" PRIu64 "\n", ps.name, ps.queued);
+    edgex_jsonbuf_append (b, line, strlen (line));
+  }
+  om_family (b, "edgex_device_threadpool_jobs", "counter", "Jobs completed");
+  for (unsigned i = 0; edgex_pool_getstats (i, &ps); i++)
+  {
+    snprintf (line, sizeof (line), "edgex_device_threadpool_jobs_total{pool=\"%s\"} %" PRIu64 "\n", ps.name, ps.completed);
+    edgex_jsonbuf_append (b, line, strlen (line));
+  }
+  om_family (b, "edgex_device_threadpool_wait_seconds", "histogram", "Time jobs waited to start");
+  for (unsigned i = 0; edgex_pool_getstats (i, &ps); i++)
+  {
+    snprintf (labels, sizeof (labels), "pool=\"%s\",", ps.name);
+    om_buckets (b, "edgex_device_threadpool_wait_seconds", labels, ps.wait);
+  }
+}
+
+/* Gauges and counters for the memory accounted by each SDK subsystem, labelled by subsystem */
+
+static void om_memory (edgex_jsonbuf *b)
+{
+  static const struct { const char *name; const char *type; const char *suffix; const char *help; } families[] =
+  {
+    { "edgex_device_memory_live_bytes", "gauge", "", "Memory held by the subsystem" },
+    { "edgex_device_memory_peak_bytes", "gauge", "", "Most memory held by the subsystem at once" },
+    { "edgex_device_memory_allocated_bytes", "counter", "_total", "Memory allocated by the subsystem" },
+    { "edgex_device_memory_allocations", "counter", "_total", "Allocations made by the subsystem" }
+  };
+  char line[256];
+  edgex_memstats ms[EDGEX_MEMTAGS];
+
+  for (unsigned t = 0; t < EDGEX_MEMTAGS; t++)
+  {
+    edgex_memstats_get (t, &ms[t]);
+  }
+  for (unsigned f = 0; f < sizeof (families) / sizeof (families[0]); f++)
+  {
+    om_family (b, families[f].name, families[f].type, families[f].help);
+    for (unsigned t = 0; t < EDGEX_MEMTAGS; t++)
+    {
+      uint64_t values[] = { ms[t].live, ms[t].peak, ms[t].allocated, ms[t].allocations };
+      snprintf
+      (
+        line, sizeof (line), "%s%s{subsystem=\"%s\"} %" PRIu64 "\n",
+        families[f].name, families[f].suffix, edgex_memstats_tagname (t), values[f]
+      );
+      edgex_jsonbuf_append (b, line, strlen (line));
+    }
+  }
+}
+
+/* Gauges, counters and histograms for each class of driver call, labelled by class */
+
+static void om_qos (edgex_jsonbuf *b, edgex_qos_t *q)
+{
+  char line[256];
+  char labels[64];
+  edgex_qos_stats qs;
+
+  om_family (b, "edgex_device_driver_waiting", "gauge", "Driver calls waiting for admission");
+  for (unsigned c = 0; c < EDGEX_QOS_CLASSES; c++)
+  {
+    edgex_qos_getstats (q, c, &qs);
+    snprintf (line, sizeof (line), "edgex_device_driver_waiting{class=\"%s\"} %" PRIu32 "\n", edgex_qos_classname (c), qs.waiting);
+    edgex_jsonbuf_append (b, line, strlen (line));
+  }
+  om_family (b, "edgex_device_driver_calls", "counter", "Driver calls admitted");
+  for (unsigned c = 0; c < EDGEX_QOS_CLASSES; c++)
+  {
+    edgex_qos_getstats (q, c, &qs);
+    snprintf (line, sizeof (line), "edgex_device_driver_calls_total{class=\"%s\"} %" PRIu64 "\n", edgex_qos_classname (c), qs.admitted);
+    edgex_jsonbuf_append (b, line, strlen (line));
+  }
+  om_family (b, "edgex_device_driver_promoted", "counter", "Driver calls admitted ahead of higher classes after waiting too long");
+  for (unsigned c = 0; c < EDGEX_QOS_CLASSES; c++)
+  {
+    edgex_qos_getstats (q, c, &qs);
+    snprintf (line, sizeof (line), "edgex_device_driver_promoted_total{class=\"%s\"} %" PRIu64 "\n", edgex_qos_classname (c), qs.promoted);
+    edgex_jsonbuf_append (b, line, strlen (line));
+  }
+  om_family (b, "edgex_device_driver_wait_seconds", "histogram", "Time driver calls waited for admission");
+  for (unsigned c = 0; c < EDGEX_QOS_CLASSES; c++)
+  {
+    edgex_qos_getstats (q, c, &qs);
+    snprintf (labels, sizeof (labels), "class=\"%s\",", edgex_qos_classname (c));
+    om_buckets (b, "edgex_device_driver_wait_seconds", labels, qs.wait);
+  }
+  om_family (b, "edgex_device_driver_duration_seconds", "histogram", "Time taken by admitted driver calls");
+  for (unsigned c = 0; c < EDGEX_QOS_CLASSES; c++)
+  {
+    edgex_qos_getstats (q, c, &qs);
+    snprintf (labels, sizeof (labels), "class=\"%s\",", edgex_qos_classname (c));
+    om_buckets (b, "edgex_device_driver_duration_seconds", labels, qs.service);
+  }
+}
+
+int edgex_device_handler_openmetrics
+(
+  void *ctx,
+  char *url,
+  char *querystr,
+  edgex_http_method method,
+  const char *upload_data,
+  size_t upload_data_size,
+  void **reply,
+  size_t *reply_size,
+  const char **reply_type
+)
+{
+  edgex_jsonbuf buf;
+  edgex_device_service *svc = (edgex_device_service *)ctx;
+
+  edgex_jsonbuf_init (&buf, 8192);
+  om_counter (&buf, "edgex_device_requests", "REST requests handled", EDGEX_COUNTER_REQUESTS);
+  om_counter
+    (&buf, "edgex_device_request_errors", "REST requests which failed with a 4xx or 5xx status", EDGEX_COUNTER_REQUEST_ERRORS);
+  om_counter
+    (&buf, "edgex_device_requests_shed", "REST requests refused by admission control", EDGEX_COUNTER_REQUESTS_SHED);
+  om_histogram (&buf, "edgex_device_request_duration_seconds", "Time taken to handle REST requests", EDGEX_TIMING_REQUEST);
+  om_counter (&buf, "edgex_device_events_produced", "Events generated from readings", EDGEX_COUNTER_EVENTS_PRODUCED);
+  om_counter (&buf, "edgex_device_events_posted", "Events accepted by core-data", EDGEX_COUNTER_EVENTS_POSTED);
+  om_counter
+    (&buf, "edgex_device_events_dropped", "Events discarded or not delivered to core-data", EDGEX_COUNTER_EVENTS_DROPPED);
+  om_counter (&buf, "edgex_device_autoevents", "AutoEvent runs", EDGEX_COUNTER_AUTOEVENTS);
+  om_histogram
+    (&buf, "edgex_device_autoevent_lag_seconds", "Delay of AutoEvent runs after their scheduled time", EDGEX_TIMING_AUTOEVENT_LAG);
+  om_counter (&buf, "edgex_device_http_client_requests", "Outgoing HTTP requests", EDGEX_COUNTER_HTTP_REQUESTS);
+  om_counter (&buf, "edgex_device_http_client_errors", "Outgoing HTTP requests which failed", EDGEX_COUNTER_HTTP_ERRORS);
+  om_histogram
+    (&buf, "edgex_device_http_client_duration_seconds", "Time taken by outgoing HTTP requests", EDGEX_TIMING_HTTP_CLIENT);
+  om_pools (&buf);
+  om_memory (&buf);
+  if (svc->qos)
+  {
+    om_qos (&buf, svc->qos);
+  }
+  om_gauge (&buf, "edgex_device_devices", "Devices in the device map", edgex_devmap_size (svc->devices));
+  edgex_jsonbuf_append (&buf, "# EOF\n", 6);
+
+  *reply = edgex_jsonbuf_finish (&buf);
+  *reply_size = strlen (*reply);
+  *reply_type = "application/openmetrics-text; version=1.0.0; charset=utf-8";
+  return MHD_HTTP_OK;
+}
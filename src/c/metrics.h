@@ -26,4 +26,19 @@ extern int edgex_device_handler_metrics
   const char **reply_type
 );
 
+/* The service's counters and timings in the OpenMetrics text format, for scraping by Prometheus */
+
+extern int edgex_device_handler_openmetrics
+(
+  void *ctx,
+  char *url,
+  char *querystr,
+  edgex_http_method method,
+  const char *upload_data,
+  size_t upload_data_size,
+  void **reply,
+  size_t *reply_size,
+  const char **reply_type
+);
+
 #endif
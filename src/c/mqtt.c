@@ -0,0 +1,777 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#include "mqtt.h"
+#include "mqttwire.h"
+#include "placement.h"
+#include "counters.h"
+#include "errorlist.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <netdb.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+#define MQTT_CONNECT 0x10
+#define MQTT_CONNACK 0x20
+#define MQTT_PUBLISH 0x30
+#define MQTT_PUBACK 0x40
+#define MQTT_PINGREQ 0xc0
+#define MQTT_PINGRESP 0xd0
+#define MQTT_DISCONNECT 0xe0
+#define MQTT_DUP 0x08
+
+#define MQTT_RXMAX 1024
+#define MQTT_TIMEOUT 5000
+#define MQTT_BACKOFF_MIN 500
+#define MQTT_BACKOFF_MAX 30000
+
+/* A publication, queued or in flight. In the in-flight window, an id of 0 marks one which has been acknowledged */
+
+typedef struct mqtt_msg
+{
+  char *topic;
+  edgex_event_cooked *event;
+  uint16_t id;
+} mqtt_msg;
+
+struct edgex_mqtt_t
+{
+  iot_logger_t *lc;
+  char *broker;
+  char *host;
+  char *port;
+  char *service;
+  char *clientid;
+  char *username;
+  char *password;
+  char *topic;
+  unsigned qos;
+  bool cleansession;
+  uint64_t keepalive;
+  uint32_t size;
+  mqtt_msg *queue;
+  uint32_t head;
+  uint32_t count;
+  uint32_t maxinflight;
+  mqtt_msg *inflight;
+  uint32_t ihead;
+  uint32_t icount;
+  uint16_t nextid;
+  int sock;
+  int wake[2];
+  unsigned char rx[MQTT_RXMAX];
+  size_t rxlen;
+  size_t rxskip;
+  int connack;
+  bool sessionpresent;
+  uint64_t lastsent;
+  uint64_t pingsent;
+  bool connected;
+  bool warned;
+  uint64_t published;
+  uint64_t dropped;
+  uint64_t connects;
+  bool running;
+  pthread_mutex_t lock;
+  pthread_t thread;
+};
+
+static const char *connack_reasons[] =
+{
+  "unacceptable protocol version",
+  "client identifier rejected",
+  "server unavailable",
+  "bad user name or password",
+  "not authorized"
+};
+
+static uint64_t monotime_ms (void)
+{
+  struct timespec ts;
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static void mqtt_msg_release (mqtt_msg *msg)
+{
+  free (msg->topic);
+  edgex_event_cooked_free (msg->event);
+}
+
+static void mqtt_put_string (unsigned char *out, size_t *pos, const char *s)
+{
+  size_t len = strlen (s);
+  out[(*pos)++] = len >> 8;
+  out[(*pos)++] = len & 0xff;
+  memcpy (out + *pos, s, len);
+  *pos += len;
+}
+
+static bool mqtt_send (edgex_mqtt_t *m, struct iovec *iov, int n)
+{
+  struct msghdr msg;
+
+  memset (&msg, 0, sizeof (msg));
+  msg.msg_iov = iov;
+  msg.msg_iovlen = n;
+  while (msg.msg_iovlen)
+  {
+    ssize_t w = sendmsg (m->sock, &msg, MSG_NOSIGNAL);
+    if (w < 0)
+    {
+      if (errno == EINTR)
+      {
+        continue;
+      }
+      return false;
+    }
+    while (msg.msg_iovlen && (size_t)w >= msg.msg_iov->iov_len)
+    {
+      w -= msg.msg_iov->iov_len;
+      msg.msg_iov++;
+      msg.msg_iovlen--;
+    }
+    if (msg.msg_iovlen)
+    {
+      msg.msg_iov->iov_base = (char *)msg.msg_iov->iov_base + w;
+      msg.msg_iov->iov_len -= w;
+    }
+  }
+  m->lastsent = monotime_ms ();
+  return true;
+}
+
+static bool mqtt_send_packet (edgex_mqtt_t *m, unsigned char type)
+{
+  unsigned char pkt[2] = { type, 0 };
+  struct iovec iov = { pkt, sizeof (pkt) };
+  return mqtt_send (m, &iov, 1);
+}
+
+static bool mqtt_send_publish (edgex_mqtt_t *m, const mqtt_msg *msg, bool dup)
+{
+  unsigned char hdr[5];
+  unsigned char tlen[2];
+  unsigned char id[2];
+  size_t topiclen = strlen (msg->topic);
+  void *payload;
+  size_t plen;
+  size_t hlen;
+
+  if (msg->event->encoding == JSON)
+  {
+    payload = msg->event->value.json;
+    plen = strlen (msg->event->value.json);
+  }
+  else
+  {
+    payload = (void *)edgex_event_cooked_cbor (msg->event);
+    plen = msg->event->value.cbor.length;
+  }
+  hdr[0] = MQTT_PUBLISH | (m->qos << 1) | (dup ? MQTT_DUP : 0);
+  hlen = 1 + edgex_mqtt_put_remaining (hdr + 1, 2 + topiclen + (m->qos ? 2 : 0) + plen);
+  tlen[0] = topiclen >> 8;
+  tlen[1] = topiclen & 0xff;
+  id[0] = msg->id >> 8;
+  id[1] = msg->id & 0xff;
+
+  struct iovec iov[5] =
+  {
+    { hdr, hlen },
+    { tlen, 2 },
+    { msg->topic, topiclen },
+    { id, m->qos ? 2 : 0 },
+    { payload, plen }
+  };
+  return mqtt_send (m, iov, 5);
+}
+
+static void mqtt_acked (edgex_mqtt_t *m, uint16_t id)
+{
+  uint32_t done = 0;
+
+  for (uint32_t i = 0; i < m->icount; i++)
+  {
+    mqtt_msg *msg = &m->inflight[(m->ihead + i) % m->maxinflight];
+    if (msg->id == id)
+    {
+      mqtt_msg_release (msg);
+      msg->id = 0;
+      done++;
+      break;
+    }
+  }
+  if (done)
+  {
+    edgex_counter_inc (EDGEX_COUNTER_EVENTS_POSTED);
+    pthread_mutex_lock (&m->lock);
+    m->published++;
+    while (m->icount && m->inflight[m->ihead].id == 0)
+    {
+      m->ihead = (m->ihead + 1) % m->maxinflight;
+      m->icount--;
+    }
+    pthread_mutex_unlock (&m->lock);
+  }
+}
+
+static void mqtt_packet (void *ctx, unsigned char type, const unsigned char *data, size_t len)
+{
+  edgex_mqtt_t *m = (edgex_mqtt_t *)ctx;
+
+  switch (type & 0xf0)
+  {
+    case MQTT_CONNACK:
+      if (len >= 2)
+      {
+        m->sessionpresent = data[0] & 1;
+        m->connack = data[1];
+      }
+      break;
+    case MQTT_PUBACK:
+      if (len >= 2)
+      {
+        mqtt_acked (m, (data[0] << 8) | data[1]);
+      }
+      break;
+    case MQTT_PINGRESP:
+      m->pingsent = 0;
+      break;
+    default:
+      break;
+  }
+}
+
+/* Read what is available and handle any complete packets. Returns false if the connection has failed */
+
+static bool mqtt_receive (edgex_mqtt_t *m)
+{
+  ssize_t off;
+  ssize_t r = recv (m->sock, m->rx + m->rxlen, MQTT_RXMAX - m->rxlen, MSG_DONTWAIT);
+
+  if (r <= 0)
+  {
+    return r < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR);
+  }
+  m->rxlen += r;
+  off = edgex_mqtt_scan (m->rx, m->rxlen, MQTT_RXMAX, &m->rxskip, mqtt_packet, m);
+  if (off < 0)
+  {
+    return false;
+  }
+  memmove (m->rx, m->rx + off, m->rxlen - off);
+  m->rxlen -= off;
+  return true;
+}
+
+static void mqtt_disconnected (edgex_mqtt_t *m)
+{
+  close (m->sock);
+  m->sock = -1;
+  pthread_mutex_lock (&m->lock);
+  m->connected = false;
+  pthread_mutex_unlock (&m->lock);
+}
+
+static int mqtt_open (edgex_mqtt_t *m)
+{
+  struct addrinfo hints;
+  struct addrinfo *res;
+  int fd = -1;
+  int one = 1;
+  struct timeval tv = { MQTT_TIMEOUT / 1000, 0 };
+
+  memset (&hints, 0, sizeof (hints));
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  if (getaddrinfo (m->host, m->port, &hints, &res) != 0)
+  {
+    return -1;
+  }
+  for (struct addrinfo *ai = res; ai && fd == -1; ai = ai->ai_next)
+  {
+    fd = socket (ai->ai_family, ai->ai_socktype | SOCK_CLOEXEC | SOCK_NONBLOCK, ai->ai_protocol);
+    if (fd != -1 && connect (fd, ai->ai_addr, ai->ai_addrlen) != 0)
+    {
+      struct pollfd pfd = { fd, POLLOUT, 0 };
+      int soerr = 0;
+      socklen_t slen = sizeof (soerr);
+
+      if
+      (
+        errno != EINPROGRESS || poll (&pfd, 1, MQTT_TIMEOUT) != 1 ||
+        getsockopt (fd, SOL_SOCKET, SO_ERROR, &soerr, &slen) != 0 || soerr
+      )
+      {
+        close (fd);
+        fd = -1;
+      }
+    }
+  }
+  freeaddrinfo (res);
+
+  if (fd != -1)
+  {
+    fcntl (fd, F_SETFL, fcntl (fd, F_GETFL) & ~O_NONBLOCK);
+    setsockopt (fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof (one));
+    setsockopt (fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof (tv));
+  }
+  return fd;
+}
+
+/* Connect and resend any publications which were not acknowledged on the previous connection */
+
+static bool mqtt_connect (edgex_mqtt_t *m)
+{
+  unsigned char *pkt;
+  size_t pos = 0;
+  size_t len = 10 + 2 + strlen (m->clientid);
+  unsigned char flags = m->cleansession ? 0x02 : 0;
+  uint64_t until;
+  struct iovec iov;
+
+  m->sock = mqtt_open (m);
+  if (m->sock == -1)
+  {
+    if (!m->warned)
+    {
+      iot_log_warn (m->lc, "MQTT: unable to connect to %s", m->broker);
+      m->warned = true;
+    }
+    return false;
+  }
+
+  if (m->username)
+  {
+    flags |= 0x80;
+    len += 2 + strlen (m->username);
+  }
+  if (m->password)
+  {
+    flags |= 0x40;
+    len += 2 + strlen (m->password);
+  }
+  pkt = malloc (len + 5);
+  pkt[pos++] = MQTT_CONNECT;
+  pos += edgex_mqtt_put_remaining (pkt + pos, len);
+  mqtt_put_string (pkt, &pos, "MQTT");
+  pkt[pos++] = 4;
+  pkt[pos++] = flags;
+  pkt[pos++] = (m->keepalive / 1000) >> 8;
+  pkt[pos++] = (m->keepalive / 1000) & 0xff;
+  mqtt_put_string (pkt, &pos, m->clientid);
+  if (m->username)
+  {
+    mqtt_put_string (pkt, &pos, m->username);
+  }
+  if (m->password)
+  {
+    mqtt_put_string (pkt, &pos, m->password);
+  }
+  iov.iov_base = pkt;
+  iov.iov_len = pos;
+  m->rxlen = 0;
+  m->rxskip = 0;
+  m->connack = -1;
+  m->pingsent = 0;
+  bool ok = mqtt_send (m, &iov, 1);
+  free (pkt);
+
+  until = monotime_ms () + MQTT_TIMEOUT;
+  while (ok && m->connack == -1)
+  {
+    struct pollfd pfd = { m->sock, POLLIN, 0 };
+    uint64_t now = monotime_ms ();
+    ok = now < until && poll (&pfd, 1, until - now) == 1 && mqtt_receive (m);
+  }
+  if (!ok || m->connack)
+  {
+    if (m->connack > 0)
+    {
+      iot_log_error
+      (
+        m->lc, "MQTT: connection to %s refused: %s", m->broker,
+        m->connack <= 5 ? connack_reasons[m->connack - 1] : "unknown reason"
+      );
+    }
+    else if (!m->warned)
+    {
+      iot_log_warn (m->lc, "MQTT: no response from %s", m->broker);
+    }
+    m->warned = true;
+    mqtt_disconnected (m);
+    return false;
+  }
+
+  iot_log_info
+    (m->lc, "MQTT: connected to %s%s", m->broker, m->sessionpresent ? " (session resumed)" : "");
+  m->warned = false;
+  pthread_mutex_lock (&m->lock);
+  m->connected = true;
+  m->connects++;
+  pthread_mutex_unlock (&m->lock);
+
+  for (uint32_t i = 0; i < m->icount && ok; i++)
+  {
+    mqtt_msg *msg = &m->inflight[(m->ihead + i) % m->maxinflight];
+    if (msg->id)
+    {
+      ok = mqtt_send_publish (m, msg, true);
+    }
+  }
+  if (!ok)
+  {
+    mqtt_disconnected (m);
+  }
+  return ok;
+}
+
+/* Publish queued events while the in-flight window allows */
+
+static bool mqtt_send_queued (edgex_mqtt_t *m)
+{
+  while (true)
+  {
+    mqtt_msg msg;
+
+    pthread_mutex_lock (&m->lock);
+    if (m->count == 0 || (m->qos && m->icount == m->maxinflight))
+    {
+      pthread_mutex_unlock (&m->lock);
+      return true;
+    }
+    msg = m->queue[m->head];
+    m->head = (m->head + 1) % m->size;
+    m->count--;
+    if (m->qos)
+    {
+      if (++m->nextid == 0)
+      {
+        m->nextid = 1;
+      }
+      msg.id = m->nextid;
+      m->inflight[(m->ihead + m->icount) % m->maxinflight] = msg;
+      m->icount++;
+    }
+    pthread_mutex_unlock (&m->lock);
+
+    bool ok = mqtt_send_publish (m, &msg, false);
+    if (m->qos == 0)
+    {
+      mqtt_msg_release (&msg);
+      edgex_counter_inc (ok ? EDGEX_COUNTER_EVENTS_POSTED : EDGEX_COUNTER_EVENTS_DROPPED);
+      pthread_mutex_lock (&m->lock);
+      if (ok)
+      {
+        m->published++;
+      }
+      else
+      {
+        m->dropped++;
+      }
+      pthread_mutex_unlock (&m->lock);
+    }
+    if (!ok)
+    {
+      return false;
+    }
+  }
+}
+
+/* If the pipe is full the thread is due to wake anyway, so a failed write is of no consequence */
+
+static void mqtt_wakeup (edgex_mqtt_t *m)
+{
+  ssize_t rc = write (m->wake[1], "", 1);
+  (void)rc;
+}
+
+static void mqtt_drain_wake (edgex_mqtt_t *m)
+{
+  char buf[64];
+  while (read (m->wake[0], buf, sizeof (buf)) > 0);
+}
+
+/* Wait for up to limit ms (-1 for no limit) for data from the broker or a new event, sending keepalives as needed */
+
+static bool mqtt_wait (edgex_mqtt_t *m, int limit)
+{
+  struct pollfd fds[2] = { { m->sock, POLLIN, 0 }, { m->wake[0], POLLIN, 0 } };
+  int timeout = limit;
+
+  if (m->keepalive)
+  {
+    uint64_t now = monotime_ms ();
+    uint64_t due;
+    if (m->pingsent)
+    {
+      if (now - m->pingsent >= m->keepalive)
+      {
+        iot_log_warn (m->lc, "MQTT: no keepalive response from %s", m->broker);
+        return false;
+      }
+      due = m->pingsent + m->keepalive;
+    }
+    else
+    {
+      if (now - m->lastsent >= m->keepalive)
+      {
+        if (!mqtt_send_packet (m, MQTT_PINGREQ))
+        {
+          return false;
+        }
+        m->pingsent = now;
+      }
+      due = (m->pingsent ? m->pingsent : m->lastsent) + m->keepalive;
+    }
+    if (timeout < 0 || due - now < (uint64_t)timeout)
+    {
+      timeout = due - now;
+    }
+  }
+
+  if (poll (fds, 2, timeout) > 0)
+  {
+    if (fds[1].revents)
+    {
+      mqtt_drain_wake (m);
+    }
+    if (fds[0].revents)
+    {
+      return mqtt_receive (m);
+    }
+  }
+  return true;
+}
+
+static void *mqtt_thread (void *p)
+{
+  edgex_mqtt_t *m = (edgex_mqtt_t *)p;
+  uint64_t backoff = MQTT_BACKOFF_MIN;
+  uint64_t deadline = 0;
+  uint32_t lost = 0;
+
+  edgex_placement_apply (EDGEX_PLACEMENT_IO);
+
+  while (true)
+  {
+    bool running;
+    uint32_t pending;
+
+    pthread_mutex_lock (&m->lock);
+    running = m->running;
+    pending = m->count;
+    pthread_mutex_unlock (&m->lock);
+
+    if (!running)
+    {
+      uint64_t now = monotime_ms ();
+      if (deadline == 0)
+      {
+        deadline = now + EDGEX_MQTT_DRAIN_TIME;
+      }
+      if (m->sock == -1 || (pending == 0 && m->icount == 0) || now >= deadline)
+      {
+        break;
+      }
+    }
+
+    if (m->sock == -1)
+    {
+      if (mqtt_connect (m))
+      {
+        backoff = MQTT_BACKOFF_MIN;
+      }
+      else
+      {
+        struct pollfd pfd = { m->wake[0], POLLIN, 0 };
+        poll (&pfd, 1, backoff);
+        mqtt_drain_wake (m);
+        backoff = (backoff * 2 > MQTT_BACKOFF_MAX) ? MQTT_BACKOFF_MAX : backoff * 2;
+      }
+      continue;
+    }
+
+    uint64_t now = monotime_ms ();
+    int limit = running ? -1 : (deadline > now) ? (int)(deadline - now) : 0;
+    if (!mqtt_send_queued (m) || !mqtt_wait (m, limit))
+    {
+      iot_log_warn (m->lc, "MQTT: connection to %s lost", m->broker);
+      mqtt_disconnected (m);
+    }
+  }
+
+  if (m->sock != -1)
+  {
+    mqtt_send_packet (m, MQTT_DISCONNECT);
+    mqtt_disconnected (m);
+  }
+
+  /* Anything left could not be published in time */
+
+  for (uint32_t i = 0; i < m->icount; i++)
+  {
+    mqtt_msg *msg = &m->inflight[(m->ihead + i) % m->maxinflight];
+    if (msg->id)
+    {
+      mqtt_msg_release (msg);
+      lost++;
+    }
+  }
+  pthread_mutex_lock (&m->lock);
+  m->icount = 0;
+  while (m->count)
+  {
+    mqtt_msg_release (&m->queue[m->head]);
+    m->head = (m->head + 1) % m->size;
+    m->count--;
+    lost++;
+  }
+  m->dropped += lost;
+  pthread_mutex_unlock (&m->lock);
+  edgex_counter_add (EDGEX_COUNTER_EVENTS_DROPPED, lost);
+  return NULL;
+}
+
+edgex_mqtt_t *edgex_mqtt_alloc
+  (iot_logger_t *lc, const char *service, const edgex_device_mqttinfo *info, edgex_error *err)
+{
+  edgex_mqtt_t *m;
+
+  if (info->qos > 1)
+  {
+    iot_log_error (lc, "MQTT QoS must be 0 or 1");
+    *err = EDGEX_BAD_CONFIG;
+    return NULL;
+  }
+
+  m = calloc (1, sizeof (edgex_mqtt_t));
+  if (!edgex_mqtt_parse_broker (info->broker, EDGEX_MQTT_DEFAULT_PORT, &m->host, &m->port))
+  {
+    iot_log_error (lc, "Invalid MQTT Broker %s", info->broker);
+    *err = EDGEX_BAD_CONFIG;
+    free (m);
+    return NULL;
+  }
+  if (pipe2 (m->wake, O_NONBLOCK | O_CLOEXEC) != 0)
+  {
+    iot_log_error (lc, "Unable to create MQTT wakeup pipe: %s", strerror (errno));
+    *err = EDGEX_BAD_CONFIG;
+    free (m->host);
+    free (m->port);
+    free (m);
+    return NULL;
+  }
+  m->lc = lc;
+  m->broker = strdup (info->broker);
+  m->service = strdup (service);
+  m->clientid = strdup ((info->clientid && *info->clientid) ? info->clientid : service);
+  m->username = (info->username && *info->username) ? strdup (info->username) : NULL;
+  m->password = (info->password && *info->password) ? strdup (info->password) : NULL;
+  m->topic = strdup ((info->topic && *info->topic) ? info->topic : EDGEX_MQTT_DEFAULT_TOPIC);
+  m->qos = info->qos;
+  m->cleansession = info->cleansession;
+  m->keepalive = 1000 * (uint64_t)(info->keepalive ? info->keepalive : EDGEX_MQTT_DEFAULT_KEEPALIVE);
+  m->size = info->buffersize ? info->buffersize : EDGEX_MQTT_DEFAULT_BUFFER;
+  m->queue = malloc (m->size * sizeof (mqtt_msg));
+  m->maxinflight = info->maxinflight ? info->maxinflight : EDGEX_MQTT_DEFAULT_INFLIGHT;
+  m->inflight = malloc (m->maxinflight * sizeof (mqtt_msg));
+  m->sock = -1;
+  pthread_mutex_init (&m->lock, NULL);
+  m->running = true;
+  pthread_create (&m->thread, NULL, mqtt_thread, m);
+  return m;
+}
+
+bool edgex_mqtt_publish (edgex_mqtt_t *m, const char *device, edgex_event_cooked *event)
+{
+  bool queued = false;
+  bool wake = false;
+  char *topic = edgex_mqtt_topic (m->topic, m->service, device, event->source);
+  size_t topiclen = strlen (topic);
+  size_t plen = (event->encoding == JSON) ? strlen (event->value.json) : event->value.cbor.length;
+
+  pthread_mutex_lock (&m->lock);
+  if (m->count < m->size && topiclen <= UINT16_MAX && plen + topiclen + 4 <= EDGEX_MQTT_MAXREMAINING)
+  {
+    mqtt_msg *msg = &m->queue[(m->head + m->count) % m->size];
+    msg->topic = topic;
+    msg->event = edgex_event_cooked_share (event);
+    msg->id = 0;
+    wake = (m->count++ == 0);
+    queued = true;
+  }
+  else
+  {
+    m->dropped++;
+  }
+  pthread_mutex_unlock (&m->lock);
+
+  if (!queued)
+  {
+    free (topic);
+  }
+  else if (wake)
+  {
+    mqtt_wakeup (m);
+  }
+  return queued;
+}
+
+void edgex_mqtt_getstats (edgex_mqtt_t *m, edgex_mqtt_stats *stats)
+{
+  pthread_mutex_lock (&m->lock);
+  stats->connected = m->connected;
+  stats->queued = m->count;
+  stats->inflight = m->icount;
+  stats->published = m->published;
+  stats->dropped = m->dropped;
+  stats->connects = m->connects;
+  pthread_mutex_unlock (&m->lock);
+}
+
+const char *edgex_mqtt_broker (const edgex_mqtt_t *m)
+{
+  return m->broker;
+}
+
+void edgex_mqtt_free (edgex_mqtt_t *m)
+{
+  if (m)
+  {
+    pthread_mutex_lock (&m->lock);
+    m->running = false;
+    pthread_mutex_unlock (&m->lock);
+    mqtt_wakeup (m);
+    pthread_join (m->thread, NULL);
+    close (m->wake[0]);
+    close (m->wake[1]);
+    pthread_mutex_destroy (&m->lock);
+    free (m->queue);
+    free (m->inflight);
+    free (m->broker);
+    free (m->host);
+    free (m->port);
+    free (m->service);
+    free (m->clientid);
+    free (m->username);
+    free (m->password);
+    free (m->topic);
+    free (m);
+  }
+}
@@ -0,0 +1,67 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#ifndef _EDGEX_DEVICE_MQTT_H_
+#define _EDGEX_DEVICE_MQTT_H_ 1
+
+#include "config.h"
+#include "data.h"
+
+/*
+ * Publication of events to an MQTT (3.1.1) broker, as an alternative to
+ * posting them to core-data. Events are queued and published by a thread of
+ * their own, which keeps the connection open and reconnects with backoff if
+ * it is lost. At QoS 1 up to MaxInFlight publications may await
+ * acknowledgement; unacknowledged ones are resent when the connection is
+ * restored, and with a persistent session the broker retains any
+ * subscriptions' messages in the meantime. Events submitted while the queue
+ * is full are dropped.
+ *
+ * The topic for each event is formed from the Topic template, in which
+ * {service}, {device} and {source} are replaced by the service name, the
+ * device name, and the device resource or command which produced the event.
+ */
+
+#define EDGEX_MQTT_DEFAULT_PORT 1883
+#define EDGEX_MQTT_DEFAULT_TOPIC "edgex/events/{device}/{source}"
+#define EDGEX_MQTT_DEFAULT_KEEPALIVE 60
+#define EDGEX_MQTT_DEFAULT_INFLIGHT 16
+#define EDGEX_MQTT_DEFAULT_BUFFER 1024
+
+typedef struct edgex_mqtt_t edgex_mqtt_t;
+
+typedef struct edgex_mqtt_stats
+{
+  bool connected;
+  uint32_t queued;
+  uint32_t inflight;
+  uint64_t published;
+  uint64_t dropped;
+  uint64_t connects;
+} edgex_mqtt_stats;
+
+/* The broker is given as tcp://host:port or host:port. Fails with EDGEX_BAD_CONFIG for invalid settings */
+
+edgex_mqtt_t *edgex_mqtt_alloc
+  (iot_logger_t *lc, const char *service, const edgex_device_mqttinfo *info, edgex_error *err);
+
+/* Queue an event for publication, sharing it rather than copying. Returns false if the queue is full */
+
+bool edgex_mqtt_publish (edgex_mqtt_t *m, const char *device, edgex_event_cooked *event);
+
+void edgex_mqtt_getstats (edgex_mqtt_t *m, edgex_mqtt_stats *stats);
+
+const char *edgex_mqtt_broker (const edgex_mqtt_t *m);
+
+/* Publishes queued events for up to EDGEX_MQTT_DRAIN_TIME ms, disconnects and stops the thread */
+
+#define EDGEX_MQTT_DRAIN_TIME 2000
+
+void edgex_mqtt_free (edgex_mqtt_t *m);
+
+#endif
@@ -0,0 +1,199 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#include "mqttwire.h"
+#include "jsonbuf.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+size_t edgex_mqtt_put_remaining (unsigned char *out, size_t len)
+{
+  size_t n = 0;
+  do
+  {
+    out[n] = len % 128;
+    len /= 128;
+    if (len)
+    {
+      out[n] |= 0x80;
+    }
+    n++;
+  } while (len);
+  return n;
+}
+
+int edgex_mqtt_get_header (const unsigned char *data, size_t len, size_t *remaining)
+{
+  size_t rem = 0;
+
+  for (int n = 1; n <= 4; n++)
+  {
+    if ((size_t)n >= len)
+    {
+      return 0;
+    }
+    rem += (size_t)(data[n] & 0x7f) << (7 * (n - 1));
+    if ((data[n] & 0x80) == 0)
+    {
+      *remaining = rem;
+      return n + 1;
+    }
+  }
+  return -1;
+}
+
+ssize_t edgex_mqtt_scan
+  (const unsigned char *buf, size_t len, size_t max, size_t *skip, edgex_mqtt_packet_fn fn, void *ctx)
+{
+  size_t off = 0;
+
+  /* Packets we have no use for which are too large to buffer are discarded as they arrive */
+
+  if (*skip)
+  {
+    off = (*skip < len) ? *skip : len;
+    *skip -= off;
+  }
+
+  while (off < len)
+  {
+    size_t rem;
+    int n = edgex_mqtt_get_header (buf + off, len - off, &rem);
+    if (n < 0)
+    {
+      return -1;
+    }
+    if (n == 0)
+    {
+      break;
+    }
+    if (n + rem > max)
+    {
+      *skip = n + rem - (len - off);
+      off = len;
+      break;
+    }
+    if (off + n + rem > len)
+    {
+      break;
+    }
+    fn (ctx, buf[off], buf + off + n, rem);
+    off += n + rem;
+  }
+  return off;
+}
+
+bool edgex_mqtt_parse_broker (const char *broker, unsigned dflt, char **host, char **port)
+{
+  const char *h = broker;
+  const char *end;
+  const char *p = NULL;
+
+  if (strncasecmp (h, "tcp://", 6) == 0)
+  {
+    h += 6;
+  }
+  else if (strncasecmp (h, "mqtt://", 7) == 0)
+  {
+    h += 7;
+  }
+  else if (strstr (h, "://"))
+  {
+    return false;
+  }
+
+  if (*h == '[')
+  {
+    h++;
+    end = strchr (h, ']');
+    if (end == NULL)
+    {
+      return false;
+    }
+    if (end[1] == ':')
+    {
+      p = end + 2;
+    }
+    else if (end[1])
+    {
+      return false;
+    }
+  }
+  else
+  {
+    end = strchr (h, ':');
+    if (end)
+    {
+      p = end + 1;
+    }
+    else
+    {
+      end = h + strlen (h);
+    }
+  }
+  if (end == h || (p && (*p == '\0' || strspn (p, "0123456789") != strlen (p))))
+  {
+    return false;
+  }
+
+  *host = strndup (h, end - h);
+  if (p)
+  {
+    *port = strdup (p);
+  }
+  else
+  {
+    *port = malloc (11);
+    sprintf (*port, "%u", dflt);
+  }
+  return true;
+}
+
+char *edgex_mqtt_topic (const char *tmpl, const char *service, const char *device, const char *source)
+{
+  edgex_jsonbuf b;
+  const char *t = tmpl;
+
+  edgex_jsonbuf_init (&b, 128);
+  while (*t)
+  {
+    const char *val = NULL;
+    size_t skip = 0;
+    if (strncmp (t, "{device}", 8) == 0)
+    {
+      val = device;
+      skip = 8;
+    }
+    else if (strncmp (t, "{source}", 8) == 0)
+    {
+      val = source ? source : "";
+      skip = 8;
+    }
+    else if (strncmp (t, "{service}", 9) == 0)
+    {
+      val = service;
+      skip = 9;
+    }
+    if (val)
+    {
+      for (; *val; val++)
+      {
+        edgex_jsonbuf_appendc (&b, (*val == '+' || *val == '#') ? '_' : *val);
+      }
+      t += skip;
+    }
+    else
+    {
+      edgex_jsonbuf_appendc (&b, *t++);
+    }
+  }
+  return edgex_jsonbuf_finish (&b);
+}
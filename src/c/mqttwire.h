@@ -0,0 +1,52 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#ifndef _EDGEX_DEVICE_MQTTWIRE_H_
+#define _EDGEX_DEVICE_MQTTWIRE_H_ 1
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+/* Encoding and decoding of the parts of MQTT 3.1.1 packets used by the publisher in mqtt.c */
+
+#define EDGEX_MQTT_MAXREMAINING 268435455
+
+/* Encode a packet's remaining length into out, which has room for four bytes. Returns the number of bytes used */
+
+size_t edgex_mqtt_put_remaining (unsigned char *out, size_t len);
+
+/* Decode the fixed header at the start of data. Returns the length of the header and sets *remaining, or returns 0 if
+ * more data is required, or -1 if the remaining length is malformed.
+ */
+
+int edgex_mqtt_get_header (const unsigned char *data, size_t len, size_t *remaining);
+
+typedef void (*edgex_mqtt_packet_fn) (void *ctx, unsigned char type, const unsigned char *data, size_t len);
+
+/* Call fn for each complete packet in buf, which holds len bytes and has room for max. A packet which could not fit in
+ * max bytes is discarded: what follows of it is counted in *skip, and skipped by subsequent calls. Returns the number
+ * of bytes consumed, or -1 if the data are malformed.
+ */
+
+ssize_t edgex_mqtt_scan
+  (const unsigned char *buf, size_t len, size_t max, size_t *skip, edgex_mqtt_packet_fn fn, void *ctx);
+
+/* Split a broker address of the form [tcp://|mqtt://]host[:port], where an IPv6 host is enclosed in brackets. The
+ * port defaults to dflt. On success the host and port are returned in allocated strings.
+ */
+
+bool edgex_mqtt_parse_broker (const char *broker, unsigned dflt, char **host, char **port);
+
+/* Form a topic from a template, replacing {service}, {device} and {source}. Wildcard characters in the substituted
+ * names are replaced by underscores, as they may not be published to.
+ */
+
+char *edgex_mqtt_topic (const char *tmpl, const char *service, const char *device, const char *source);
+
+#endif
@@ -0,0 +1,187 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#include "opstate.h"
+#include "service.h"
+#include "metadata.h"
+#include "map.h"
+#include "errorlist.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* Pending changes are held by device id, so that a later change replaces an earlier one */
+
+struct edgex_opstate_t
+{
+  edgex_device_service *svc;
+  uint32_t retry;
+  edgex_map_int pending;
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+  pthread_t thread;
+  bool running;
+};
+
+static void opstate_wait (edgex_opstate_t *q, uint32_t ms)
+{
+  struct timespec ts;
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  ts.tv_sec += ms / 1000;
+  ts.tv_nsec += (ms % 1000) * 1000000;
+  if (ts.tv_nsec >= 1000000000)
+  {
+    ts.tv_sec++;
+    ts.tv_nsec -= 1000000000;
+  }
+  pthread_cond_timedwait (&q->cond, &q->lock, &ts);
+}
+
+/*
+ * Sender thread. All pending changes are taken at once and sent without the
+ * lock held. Those which fail are put back unless a newer change for the same
+ * device has been queued in the meantime.
+ */
+
+static void *opstate_thread (void *p)
+{
+  edgex_opstate_t *q = (edgex_opstate_t *)p;
+  iot_logger_t *lc = q->svc->logger;
+
+  pthread_mutex_lock (&q->lock);
+  while (q->running)
+  {
+    unsigned n = edgex_map_size (&q->pending);
+    unsigned failed = 0;
+    const char *key;
+    char **ids;
+    int *states;
+
+    if (n == 0)
+    {
+      pthread_cond_wait (&q->cond, &q->lock);
+      continue;
+    }
+
+    ids = malloc (n * sizeof (char *));
+    states = malloc (n * sizeof (int));
+    n = 0;
+    edgex_map_iter i = edgex_map_iter (q->pending);
+    while ((key = edgex_map_next (&q->pending, &i)))
+    {
+      ids[n] = strdup (key);
+      states[n++] = *edgex_map_get (&q->pending, key);
+    }
+    edgex_map_deinit (&q->pending);
+    edgex_map_init (&q->pending);
+    pthread_mutex_unlock (&q->lock);
+
+    for (unsigned s = 0; s < n; s++)
+    {
+      edgex_error err = EDGEX_OK;
+      edgex_metadata_client_set_device_opstate (lc, &q->svc->config.endpoints, ids[s], states[s], &err);
+      if (err.code)
+      {
+        ids[failed] = ids[s];
+        states[failed++] = states[s];
+      }
+      else
+      {
+        free (ids[s]);
+      }
+    }
+
+    pthread_mutex_lock (&q->lock);
+    for (unsigned f = 0; f < failed; f++)
+    {
+      if (edgex_map_get (&q->pending, ids[f]) == NULL)
+      {
+        edgex_map_set (&q->pending, ids[f], states[f]);
+      }
+      free (ids[f]);
+    }
+    free (ids);
+    free (states);
+    if (failed && q->running)
+    {
+      iot_log_debug (lc, "Operating state: core-metadata unavailable, %u changes pending", failed);
+      opstate_wait (q, q->retry);
+    }
+  }
+  pthread_mutex_unlock (&q->lock);
+  return NULL;
+}
+
+edgex_opstate_t *edgex_opstate_alloc (edgex_device_service *svc, uint32_t retry)
+{
+  pthread_condattr_t attr;
+  edgex_opstate_t *q = calloc (1, sizeof (edgex_opstate_t));
+
+  q->svc = svc;
+  q->retry = retry;
+  edgex_map_init (&q->pending);
+  pthread_mutex_init (&q->lock, NULL);
+  pthread_condattr_init (&attr);
+  pthread_condattr_setclock (&attr, CLOCK_MONOTONIC);
+  pthread_cond_init (&q->cond, &attr);
+  pthread_condattr_destroy (&attr);
+  q->running = true;
+  pthread_create (&q->thread, NULL, opstate_thread, q);
+  return q;
+}
+
+/*
+ * The state is a scalar field of the device record, so it is updated in place
+ * under the device map's shard lock, as for changes notified by core-metadata.
+ * Holders of the device see it on their next check, so AutoEvents on a
+ * disabled device stop at once. Our own lock is held meanwhile so that the
+ * queued changes are in the same order as the updates.
+ */
+
+void edgex_opstate_set (edgex_opstate_t *q, edgex_device *dev, edgex_device_operatingstate opstate)
+{
+  pthread_mutex_lock (&q->lock);
+  if (edgex_devmap_set_opstate (q->svc->devices, dev->id, opstate))
+  {
+    edgex_map_set (&q->pending, dev->id, opstate);
+    pthread_cond_signal (&q->cond);
+  }
+  pthread_mutex_unlock (&q->lock);
+}
+
+unsigned edgex_opstate_pending (edgex_opstate_t *q)
+{
+  unsigned result;
+  pthread_mutex_lock (&q->lock);
+  result = edgex_map_size (&q->pending);
+  pthread_mutex_unlock (&q->lock);
+  return result;
+}
+
+void edgex_opstate_free (edgex_opstate_t *q)
+{
+  if (q)
+  {
+    pthread_mutex_lock (&q->lock);
+    q->running = false;
+    pthread_cond_signal (&q->cond);
+    pthread_mutex_unlock (&q->lock);
+    pthread_join (q->thread, NULL);
+
+    if (edgex_map_size (&q->pending))
+    {
+      iot_log_warn (q->svc->logger, "Operating state: %u changes not sent to core-metadata", edgex_map_size (&q->pending));
+    }
+    edgex_map_deinit (&q->pending);
+    pthread_cond_destroy (&q->cond);
+    pthread_mutex_destroy (&q->lock);
+    free (q);
+  }
+}
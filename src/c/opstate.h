@@ -0,0 +1,41 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#ifndef _EDGEX_DEVICE_OPSTATE_H_
+#define _EDGEX_DEVICE_OPSTATE_H_ 1
+
+#include "edgex/devsdk.h"
+#include "edgex/edgex.h"
+
+/*
+ * Queue of device operating state changes to be sent to core-metadata. The
+ * device's state is changed locally at once, and the change is sent by a
+ * background thread. Only the latest state for each device is kept, so that
+ * repeated changes are sent once, and changes which could not be sent are
+ * retried until they succeed or are superseded.
+ */
+
+#define EDGEX_OPSTATE_RETRY 5000
+
+typedef struct edgex_opstate_t edgex_opstate_t;
+
+/* retry: interval in milliseconds between attempts while core-metadata is unavailable */
+
+edgex_opstate_t *edgex_opstate_alloc (edgex_device_service *svc, uint32_t retry);
+
+/* Set the operating state of a device, and queue the change for core-metadata if it is a change */
+
+void edgex_opstate_set (edgex_opstate_t *q, edgex_device *dev, edgex_device_operatingstate opstate);
+
+/* Number of changes waiting to be sent */
+
+unsigned edgex_opstate_pending (edgex_opstate_t *q);
+
+void edgex_opstate_free (edgex_opstate_t *q);
+
+#endif
@@ -0,0 +1,271 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#include "placement.h"
+#include "config.h"
+#include "errorlist.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+typedef struct placement
+{
+  bool cpusvalid;
+  bool schedvalid;
+  cpu_set_t cpus;
+  int policy;
+  int priority;
+} placement;
+
+static const char *placement_names[EDGEX_PLACEMENT_GROUPS] = { "Server", "Pool", "Scheduler", "Registry", "IO" };
+
+static const struct
+{
+  const char *name;
+  int policy;
+} placement_policies[] =
+{
+  { "OTHER", SCHED_OTHER }, { "BATCH", SCHED_BATCH }, { "IDLE", SCHED_IDLE }, { "FIFO", SCHED_FIFO }, { "RR", SCHED_RR }
+};
+
+static placement placement_groups[EDGEX_PLACEMENT_GROUPS];
+static iot_logger_t *placement_lc;
+static atomic_uint placement_gen;
+static pthread_mutex_t placement_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* The group in which this thread was last placed, and the configuration then in force */
+
+static _Thread_local int placed_group = -1;
+static _Thread_local unsigned placed_gen;
+
+const char *edgex_placement_name (edgex_placement_group group)
+{
+  return placement_names[group];
+}
+
+/* Parse a list of CPUs and ranges, eg "0-3,6" */
+
+static bool placement_parse_cpus (const char *s, cpu_set_t *set)
+{
+  CPU_ZERO (set);
+  while (*s)
+  {
+    char *end;
+    unsigned long lo = strtoul (s, &end, 10);
+    unsigned long hi = lo;
+    if (end == s)
+    {
+      return false;
+    }
+    s = end;
+    if (*s == '-')
+    {
+      s++;
+      hi = strtoul (s, &end, 10);
+      if (end == s || hi < lo)
+      {
+        return false;
+      }
+      s = end;
+    }
+    if (hi >= CPU_SETSIZE)
+    {
+      return false;
+    }
+    for (unsigned long c = lo; c <= hi; c++)
+    {
+      CPU_SET (c, set);
+    }
+    while (*s == ' ')
+    {
+      s++;
+    }
+    if (*s == ',')
+    {
+      s++;
+    }
+    else if (*s)
+    {
+      return false;
+    }
+  }
+  return CPU_COUNT (set) > 0;
+}
+
+static bool placement_parse
+  (iot_logger_t *lc, const char *name, const edgex_device_threadinfo *info, placement *result)
+{
+  memset (result, 0, sizeof (placement));
+  if (info->cpus && *info->cpus)
+  {
+    cpu_set_t allowed;
+    if (!placement_parse_cpus (info->cpus, &result->cpus))
+    {
+      iot_log_error (lc, "Threads: invalid CPU list \"%s\" for %s", info->cpus, name);
+      return false;
+    }
+    if (sched_getaffinity (0, sizeof (cpu_set_t), &allowed) == 0)
+    {
+      CPU_AND (&allowed, &allowed, &result->cpus);
+      if (CPU_COUNT (&allowed) == 0)
+      {
+        iot_log_error (lc, "Threads: none of the CPUs \"%s\" for %s are available", info->cpus, name);
+        return false;
+      }
+    }
+    result->cpusvalid = true;
+  }
+  if (info->policy && *info->policy)
+  {
+    unsigned i;
+    for (i = 0; i < sizeof (placement_policies) / sizeof (*placement_policies); i++)
+    {
+      if (strcasecmp (info->policy, placement_policies[i].name) == 0)
+      {
+        break;
+      }
+    }
+    if (i == sizeof (placement_policies) / sizeof (*placement_policies))
+    {
+      iot_log_error (lc, "Threads: unknown scheduling policy \"%s\" for %s", info->policy, name);
+      return false;
+    }
+    result->policy = placement_policies[i].policy;
+    result->schedvalid = true;
+    if (result->policy == SCHED_FIFO || result->policy == SCHED_RR)
+    {
+      int min = sched_get_priority_min (result->policy);
+      int max = sched_get_priority_max (result->policy);
+      result->priority = info->priority ? (int)info->priority : min;
+      if (result->priority < min || result->priority > max)
+      {
+        iot_log_error (lc, "Threads: priority for %s must be between %d and %d", name, min, max);
+        return false;
+      }
+    }
+    else if (info->priority)
+    {
+      iot_log_warn (lc, "Threads: priority for %s is ignored with the %s policy", name, placement_policies[i].name);
+    }
+  }
+  else if (info->priority)
+  {
+    iot_log_error (lc, "Threads: a priority is set for %s but no scheduling policy", name);
+    return false;
+  }
+  return true;
+}
+
+void edgex_placement_configure (iot_logger_t *lc, const edgex_device_config *config, edgex_error *err)
+{
+  placement groups[EDGEX_PLACEMENT_GROUPS];
+
+  for (unsigned g = 0; g < EDGEX_PLACEMENT_GROUPS; g++)
+  {
+    if (!placement_parse (lc, placement_names[g], &config->threads[g], &groups[g]))
+    {
+      *err = EDGEX_BAD_CONFIG;
+      return;
+    }
+    if (groups[g].cpusvalid || groups[g].schedvalid)
+    {
+      iot_log_info
+      (
+        lc, "Threads: %s on CPUs %s, policy %s priority %d", placement_names[g],
+        groups[g].cpusvalid ? config->threads[g].cpus : "(any)",
+        groups[g].schedvalid ? config->threads[g].policy : "(default)", groups[g].priority
+      );
+    }
+  }
+
+  pthread_mutex_lock (&placement_lock);
+  memcpy (placement_groups, groups, sizeof (groups));
+  placement_lc = lc;
+  atomic_fetch_add (&placement_gen, 1);
+  pthread_mutex_unlock (&placement_lock);
+}
+
+void edgex_placement_reset (void)
+{
+  pthread_mutex_lock (&placement_lock);
+  memset (placement_groups, 0, sizeof (placement_groups));
+  placement_lc = NULL;
+  atomic_fetch_add (&placement_gen, 1);
+  pthread_mutex_unlock (&placement_lock);
+}
+
+void edgex_placement_apply (edgex_placement_group group)
+{
+  placement p;
+  iot_logger_t *lc;
+  int rc;
+
+  pthread_mutex_lock (&placement_lock);
+  p = placement_groups[group];
+  lc = placement_lc;
+  placed_gen = atomic_load (&placement_gen);
+  pthread_mutex_unlock (&placement_lock);
+  placed_group = group;
+
+  if (p.cpusvalid && (rc = pthread_setaffinity_np (pthread_self (), sizeof (cpu_set_t), &p.cpus)) && lc)
+  {
+    iot_log_warn (lc, "Threads: unable to set CPUs for %s thread: %s", placement_names[group], strerror (rc));
+  }
+  if (p.schedvalid)
+  {
+    struct sched_param param = { .sched_priority = p.priority };
+    if ((rc = pthread_setschedparam (pthread_self (), p.policy, &param)) && lc)
+    {
+      iot_log_warn (lc, "Threads: unable to set scheduling for %s thread: %s", placement_names[group], strerror (rc));
+    }
+  }
+}
+
+void edgex_placement_sync (edgex_placement_group group)
+{
+  if (placed_group != (int)group || placed_gen != atomic_load_explicit (&placement_gen, memory_order_relaxed))
+  {
+    edgex_placement_apply (group);
+  }
+}
+
+void edgex_placement_enter (edgex_placement_group group, edgex_placement_saved *saved)
+{
+  pthread_t self = pthread_self ();
+
+  pthread_mutex_lock (&placement_lock);
+  saved->cpusvalid = placement_groups[group].cpusvalid;
+  saved->schedvalid = placement_groups[group].schedvalid;
+  pthread_mutex_unlock (&placement_lock);
+
+  if (saved->cpusvalid)
+  {
+    saved->cpusvalid = (pthread_getaffinity_np (self, sizeof (cpu_set_t), &saved->cpus) == 0);
+  }
+  if (saved->schedvalid)
+  {
+    saved->schedvalid = (pthread_getschedparam (self, &saved->policy, &saved->param) == 0);
+  }
+  edgex_placement_apply (group);
+}
+
+void edgex_placement_leave (const edgex_placement_saved *saved)
+{
+  if (saved->cpusvalid)
+  {
+    pthread_setaffinity_np (pthread_self (), sizeof (cpu_set_t), &saved->cpus);
+  }
+  if (saved->schedvalid)
+  {
+    pthread_setschedparam (pthread_self (), saved->policy, &saved->param);
+  }
+  placed_group = -1;
+}
@@ -0,0 +1,79 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#ifndef _EDGEX_DEVICE_PLACEMENT_H_
+#define _EDGEX_DEVICE_PLACEMENT_H_ 1
+
+#include "edgex/error.h"
+#include "iot/logger.h"
+
+#include <sched.h>
+#include <stdbool.h>
+
+/*
+ * Placement of the SDK's threads on CPUs, and their scheduling policy and
+ * priority, configured per group of threads. Threads owned by the SDK apply
+ * their group's placement as they start; threads in the pools apply it on
+ * starting their next job, so that threads already running when the
+ * configuration is read are placed too. Threads created by the REST server
+ * and the scheduler inherit the placement of the thread which creates them,
+ * which takes it on for the duration (see edgex_placement_enter). A group
+ * for which nothing is configured is left as it is.
+ */
+
+typedef enum
+{
+  EDGEX_PLACEMENT_SERVER,
+  EDGEX_PLACEMENT_POOL,
+  EDGEX_PLACEMENT_SCHEDULER,
+  EDGEX_PLACEMENT_REGISTRY,
+  EDGEX_PLACEMENT_IO
+} edgex_placement_group;
+
+#define EDGEX_PLACEMENT_GROUPS (EDGEX_PLACEMENT_IO + 1)
+
+/* The calling thread's placement, as saved by edgex_placement_enter */
+
+typedef struct edgex_placement_saved
+{
+  bool cpusvalid;
+  bool schedvalid;
+  cpu_set_t cpus;
+  int policy;
+  struct sched_param param;
+} edgex_placement_saved;
+
+struct edgex_device_config;
+
+/* The name of a group, as used in the Threads section of the configuration */
+
+const char *edgex_placement_name (edgex_placement_group group);
+
+/* Parse the configuration for all groups. Threads take on the new placements as described above */
+
+void edgex_placement_configure (iot_logger_t *lc, const struct edgex_device_config *config, edgex_error *err);
+
+/* Forget the configured placements. Threads which have been placed are left as they are */
+
+void edgex_placement_reset (void);
+
+/* Place the calling thread in a group */
+
+void edgex_placement_apply (edgex_placement_group group);
+
+/* As edgex_placement_apply, unless the thread is in the group and the configuration is unchanged since */
+
+void edgex_placement_sync (edgex_placement_group group);
+
+/* Place the calling thread in a group while it creates threads for that group, then restore it */
+
+void edgex_placement_enter (edgex_placement_group group, edgex_placement_saved *saved);
+
+void edgex_placement_leave (const edgex_placement_saved *saved);
+
+#endif
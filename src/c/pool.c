@@ -0,0 +1,140 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#include "pool.h"
+#include "edgex-time.h"
+#include "placement.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Entries are never freed, so a job may safely update the entry it was
+ * queued under even if the pool has since been unregistered.
+ */
+
+typedef struct pool_entry
+{
+  _Atomic (iot_threadpool_t *) pool;
+  const char *name;
+  uint32_t threads;
+  atomic_uint_fast64_t queued;
+  atomic_uint_fast64_t started;
+  atomic_uint_fast64_t completed;
+  edgex_histogram wait;
+} pool_entry;
+
+typedef struct pool_job
+{
+  void (*fn) (void *);
+  void *arg;
+  pool_entry *entry;
+  uint64_t queued;
+} pool_job;
+
+static pool_entry entries[EDGEX_POOL_MAX];
+static pthread_mutex_t reglock = PTHREAD_MUTEX_INITIALIZER;
+
+static pool_entry *pool_find (iot_threadpool_t *pool)
+{
+  for (unsigned i = 0; i < EDGEX_POOL_MAX; i++)
+  {
+    if (atomic_load_explicit (&entries[i].pool, memory_order_acquire) == pool)
+    {
+      return &entries[i];
+    }
+  }
+  return NULL;
+}
+
+void edgex_pool_register (iot_threadpool_t *pool, const char *name, uint32_t threads)
+{
+  pool_entry *e;
+
+  pthread_mutex_lock (&reglock);
+  if (pool_find (pool) == NULL && (e = pool_find (NULL)))
+  {
+    e->name = name;
+    e->threads = threads;
+    atomic_store (&e->queued, 0);
+    atomic_store (&e->started, 0);
+    atomic_store (&e->completed, 0);
+    memset (&e->wait, 0, sizeof (e->wait));
+    atomic_store_explicit (&e->pool, pool, memory_order_release);
+  }
+  pthread_mutex_unlock (&reglock);
+}
+
+void edgex_pool_unregister (iot_threadpool_t *pool)
+{
+  pool_entry *e;
+
+  pthread_mutex_lock (&reglock);
+  if (pool && (e = pool_find (pool)))
+  {
+    atomic_store (&e->pool, NULL);
+  }
+  pthread_mutex_unlock (&reglock);
+}
+
+static void pool_run (void *p)
+{
+  pool_job job = *(pool_job *)p;
+  free (p);
+  edgex_placement_sync (EDGEX_PLACEMENT_POOL);
+  atomic_fetch_add_explicit (&job.entry->started, 1, memory_order_relaxed);
+  edgex_histogram_record (&job.entry->wait, (edgex_device_nanotime_monotonic () - job.queued) / 1000);
+  job.fn (job.arg);
+  atomic_fetch_add_explicit (&job.entry->completed, 1, memory_order_relaxed);
+}
+
+void edgex_pool_add_work (iot_threadpool_t *pool, void (*fn) (void *), void *arg)
+{
+  pool_entry *e = pool_find (pool);
+  if (e)
+  {
+    pool_job *job = malloc (sizeof (pool_job));
+    job->fn = fn;
+    job->arg = arg;
+    job->entry = e;
+    job->queued = edgex_device_nanotime_monotonic ();
+    atomic_fetch_add_explicit (&e->queued, 1, memory_order_relaxed);
+    iot_threadpool_add_work (pool, pool_run, job, NULL);
+  }
+  else
+  {
+    iot_threadpool_add_work (pool, fn, arg, NULL);
+  }
+}
+
+/* The counts are read separately, so are adjusted for jobs which start or complete meanwhile */
+
+bool edgex_pool_getstats (unsigned i, edgex_pool_stats *stats)
+{
+  unsigned n = 0;
+  for (unsigned j = 0; j < EDGEX_POOL_MAX; j++)
+  {
+    pool_entry *e = &entries[j];
+    if (atomic_load_explicit (&e->pool, memory_order_acquire) && n++ == i)
+    {
+      uint64_t completed = atomic_load (&e->completed);
+      uint64_t started = atomic_load (&e->started);
+      uint64_t queued = atomic_load (&e->queued);
+      stats->name = e->name;
+      stats->threads = e->threads;
+      stats->active = started > completed ? started - completed : 0;
+      stats->queued = queued > started ? queued - started : 0;
+      stats->completed = completed;
+      stats->wait = &e->wait;
+      return true;
+    }
+  }
+  return false;
+}
@@ -0,0 +1,52 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#ifndef _EDGEX_DEVICE_POOL_H_
+#define _EDGEX_DEVICE_POOL_H_ 1
+
+#include "latency.h"
+#include "iot/threadpool.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Instrumentation for the thread pools. The iot thread pool does not report
+ * on its queue, so jobs submitted through edgex_pool_add_work are counted
+ * when queued, started and completed, and the time each waits to start is
+ * recorded (in microseconds). Statistics are kept for up to EDGEX_POOL_MAX
+ * registered pools; jobs for other pools are run without being counted.
+ */
+
+#define EDGEX_POOL_MAX 8
+
+typedef struct edgex_pool_stats
+{
+  const char *name;
+  uint32_t threads;
+  uint32_t active;
+  uint64_t queued;
+  uint64_t completed;
+  edgex_histogram *wait;
+} edgex_pool_stats;
+
+/* Start collecting statistics for a pool. The name is not copied */
+
+void edgex_pool_register (iot_threadpool_t *pool, const char *name, uint32_t threads);
+
+/* Stop collecting statistics for a pool, which should be idle */
+
+void edgex_pool_unregister (iot_threadpool_t *pool);
+
+void edgex_pool_add_work (iot_threadpool_t *pool, void (*fn) (void *), void *arg);
+
+/* Statistics for the i'th registered pool. Returns false if there are no more */
+
+bool edgex_pool_getstats (unsigned i, edgex_pool_stats *stats);
+
+#endif
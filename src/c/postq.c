@@ -0,0 +1,368 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#include "postq.h"
+#include "service.h"
+#include "errorlist.h"
+#include "map.h"
+
+#include <pthread.h>
+
+typedef struct edgex_postq_item
+{
+  char *device;
+  char *key;
+  edgex_event_cooked *event;
+  struct edgex_postq_item *next;
+} edgex_postq_item;
+
+typedef edgex_map(edgex_postq_item *) edgex_map_postq_item;
+
+struct edgex_postq_t
+{
+  edgex_device_service *svc;
+  uint32_t depth;
+  edgex_postq_policy policy;
+  edgex_postq_item *head;
+  edgex_postq_item *tail;
+  uint32_t count;
+  uint64_t dropped;
+  uint64_t coalesced;
+  edgex_map_postq_item latest;
+  pthread_mutex_t lock;
+  pthread_cond_t space;
+};
+
+static const char *policynames[] = { "Block", "DropOldest", "DropNewest", "Coalesce" };
+
+static void postq_item_free (edgex_postq_item *item)
+{
+  edgex_event_cooked_free (item->event);
+  free (item->device);
+  free (item->key);
+  free (item);
+}
+
+/* Detach the oldest item. Called with the lock held */
+
+static edgex_postq_item *postq_pop (edgex_postq_t *q)
+{
+  edgex_postq_item *item = q->head;
+  if (item)
+  {
+    q->head = item->next;
+    if (q->head == NULL)
+    {
+      q->tail = NULL;
+    }
+    if (item->key)
+    {
+      edgex_postq_item **latest = edgex_map_get (&q->latest, item->key);
+      if (latest && *latest == item)
+      {
+        edgex_map_remove (&q->latest, item->key);
+      }
+    }
+    q->count--;
+    pthread_cond_signal (&q->space);
+  }
+  return item;
+}
+
+/* Submit up to n queued items. Called from the thread pool */
+
+static void postq_submit (edgex_postq_t *q, unsigned n)
+{
+  edgex_postq_item *item;
+
+  for (unsigned i = 0; i < n; i++)
+  {
+    pthread_mutex_lock (&q->lock);
+    item = postq_pop (q);
+    pthread_mutex_unlock (&q->lock);
+
+    if (item == NULL)
+    {
+      break;
+    }
+    edgex_error err = EDGEX_OK;
+    edgex_data_submit_event (q->svc, item->device, item->event, &err);
+    postq_item_free (item);
+  }
+}
+
+/*
+ * Thread pool job. One job is queued for each item added, but an item may be
+ * dropped or coalesced before its job runs, so a job may find nothing to do.
+ */
+
+static void postq_run (void *p)
+{
+  postq_submit ((edgex_postq_t *)p, 1);
+}
+
+/* Job for a number of items added together */
+
+typedef struct postq_batchjob
+{
+  edgex_postq_t *q;
+  unsigned n;
+} postq_batchjob;
+
+static void postq_runbatch (void *p)
+{
+  postq_batchjob *job = (postq_batchjob *)p;
+  postq_submit (job->q, job->n);
+  free (job);
+}
+
+edgex_postq_t *edgex_postq_alloc
+  (edgex_device_service *svc, uint32_t depth, const char *policy, edgex_error *err)
+{
+  edgex_postq_t *q;
+  edgex_postq_policy p = EDGEX_POSTQ_BLOCK;
+
+  if (policy)
+  {
+    for (p = EDGEX_POSTQ_BLOCK; p <= EDGEX_POSTQ_COALESCE; p++)
+    {
+      if (strcasecmp (policy, policynames[p]) == 0)
+      {
+        break;
+      }
+    }
+    if (p > EDGEX_POSTQ_COALESCE)
+    {
+      iot_log_error (svc->logger, "Invalid PostQueuePolicy %s", policy);
+      *err = EDGEX_BAD_CONFIG;
+      return NULL;
+    }
+  }
+
+  q = calloc (1, sizeof (edgex_postq_t));
+  q->svc = svc;
+  q->depth = depth;
+  q->policy = p;
+  edgex_map_init (&q->latest);
+  pthread_mutex_init (&q->lock, NULL);
+  pthread_cond_init (&q->space, NULL);
+  if (depth)
+  {
+    iot_log_info (svc->logger, "Ingestion queue depth %u, policy %s", depth, policynames[p]);
+  }
+  return q;
+}
+
+static char *postq_key (edgex_postq_t *q, const char *device, const char *resource)
+{
+  char *key = NULL;
+  if (q->policy == EDGEX_POSTQ_COALESCE)
+  {
+    size_t sz = strlen (device) + strlen (resource) + 2;
+    key = malloc (sz);
+    snprintf (key, sz, "%s/%s", device, resource);
+  }
+  return key;
+}
+
+/*
+ * Queue an event, taking ownership of the key. Called with the lock held.
+ * Returns true if an item was queued. An event replaced or discarded is
+ * returned in *stale, and an item dropped from the queue is prepended to
+ * *dropped, to be freed once the lock is released.
+ */
+
+static bool postq_put_locked
+(
+  edgex_postq_t *q,
+  const char *device,
+  char *key,
+  edgex_event_cooked *event,
+  edgex_event_cooked **stale,
+  edgex_postq_item **dropped
+)
+{
+  edgex_postq_item *item;
+  bool full = q->depth && q->count >= q->depth;
+
+  /* Events are only coalesced when the queue is full; until then every reading is sent */
+
+  if (key && full)
+  {
+    edgex_postq_item **existing = edgex_map_get (&q->latest, key);
+    if (existing)
+    {
+      *stale = (*existing)->event;
+      (*existing)->event = event;
+      q->coalesced++;
+      free (key);
+      return false;
+    }
+  }
+
+  if (full)
+  {
+    switch (q->policy)
+    {
+      case EDGEX_POSTQ_BLOCK:
+        while (q->count >= q->depth)
+        {
+          pthread_cond_wait (&q->space, &q->lock);
+        }
+        break;
+      case EDGEX_POSTQ_DROP_NEWEST:
+        q->dropped++;
+        edgex_counter_inc (EDGEX_COUNTER_EVENTS_DROPPED);
+        iot_log_debug (q->svc->logger, "Ingestion queue full, discarding event for device %s", device);
+        *stale = event;
+        free (key);
+        return false;
+      default:
+        item = postq_pop (q);
+        item->next = *dropped;
+        *dropped = item;
+        q->dropped++;
+        edgex_counter_inc (EDGEX_COUNTER_EVENTS_DROPPED);
+        break;
+    }
+  }
+
+  item = malloc (sizeof (edgex_postq_item));
+  item->device = strdup (device);
+  item->key = key;
+  item->event = event;
+  item->next = NULL;
+  if (q->tail)
+  {
+    q->tail->next = item;
+  }
+  else
+  {
+    q->head = item;
+  }
+  q->tail = item;
+  if (key)
+  {
+    edgex_map_set (&q->latest, key, item);
+  }
+  q->count++;
+  return true;
+}
+
+static void postq_free_dropped (edgex_postq_t *q, edgex_postq_item *dropped)
+{
+  while (dropped)
+  {
+    edgex_postq_item *next = dropped->next;
+    iot_log_debug (q->svc->logger, "Ingestion queue full, discarding oldest event (device %s)", dropped->device);
+    postq_item_free (dropped);
+    dropped = next;
+  }
+}
+
+void edgex_postq_add
+  (edgex_postq_t *q, const char *device, const char *resource, edgex_event_cooked *event)
+{
+  edgex_event_cooked *stale = NULL;
+  edgex_postq_item *dropped = NULL;
+  char *key = postq_key (q, device, resource);
+  bool queued;
+
+  pthread_mutex_lock (&q->lock);
+  queued = postq_put_locked (q, device, key, event, &stale, &dropped);
+  pthread_mutex_unlock (&q->lock);
+
+  edgex_event_cooked_free (stale);
+  postq_free_dropped (q, dropped);
+  if (queued)
+  {
+    edgex_pool_add_work (q->svc->postpool, postq_run, q);
+  }
+}
+
+void edgex_postq_addv
+(
+  edgex_postq_t *q,
+  unsigned n,
+  const char * const *devices,
+  const char * const *resources,
+  edgex_event_cooked **events
+)
+{
+  edgex_event_cooked **stale = calloc (n, sizeof (edgex_event_cooked *));
+  char **keys = malloc (n * sizeof (char *));
+  edgex_postq_item *dropped = NULL;
+  unsigned nqueued = 0;
+
+  for (unsigned i = 0; i < n; i++)
+  {
+    keys[i] = postq_key (q, devices[i], resources[i]);
+  }
+
+  pthread_mutex_lock (&q->lock);
+  for (unsigned i = 0; i < n; i++)
+  {
+    if (postq_put_locked (q, devices[i], keys[i], events[i], &stale[i], &dropped))
+    {
+      nqueued++;
+    }
+  }
+  pthread_mutex_unlock (&q->lock);
+
+  for (unsigned i = 0; i < n; i++)
+  {
+    edgex_event_cooked_free (stale[i]);
+  }
+  postq_free_dropped (q, dropped);
+  free (stale);
+  free (keys);
+
+  if (nqueued)
+  {
+    postq_batchjob *job = malloc (sizeof (postq_batchjob));
+    job->q = q;
+    job->n = nqueued;
+    edgex_pool_add_work (q->svc->postpool, postq_runbatch, job);
+  }
+}
+
+void edgex_postq_getstats (edgex_postq_t *q, edgex_postq_stats *stats)
+{
+  pthread_mutex_lock (&q->lock);
+  stats->depth = q->depth;
+  stats->queued = q->count;
+  stats->dropped = q->dropped;
+  stats->coalesced = q->coalesced;
+  pthread_mutex_unlock (&q->lock);
+}
+
+const char *edgex_postq_policyname (edgex_postq_t *q)
+{
+  return policynames[q->policy];
+}
+
+void edgex_postq_free (edgex_postq_t *q)
+{
+  if (q)
+  {
+    edgex_postq_item *item;
+    while ((item = postq_pop (q)))
+    {
+      postq_item_free (item);
+    }
+    if (q->dropped || q->coalesced)
+    {
+      iot_log_info
+        (q->svc->logger, "Ingestion queue: %" PRIu64 " events dropped, %" PRIu64 " coalesced", q->dropped, q->coalesced);
+    }
+    edgex_map_deinit (&q->latest);
+    pthread_cond_destroy (&q->space);
+    pthread_mutex_destroy (&q->lock);
+    free (q);
+  }
+}
@@ -0,0 +1,70 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#ifndef _EDGEX_DEVICE_POSTQ_H_
+#define _EDGEX_DEVICE_POSTQ_H_ 1
+
+#include "edgex/devsdk.h"
+#include "data.h"
+
+/*
+ * Ingestion queue for readings submitted via edgex_device_post_readings.
+ * Events are queued here and submitted by the service's thread pool. If a
+ * depth is set, the number of queued events is bounded, and the policy
+ * determines what happens when a new event arrives at a full queue:
+ *
+ *   Block      - the caller waits until there is space.
+ *   DropOldest - the oldest queued event is discarded.
+ *   DropNewest - the new event is discarded.
+ *   Coalesce   - a queued event for the same device and resource is replaced
+ *                by the new one, so only the latest value is sent. If there is
+ *                none, the oldest queued event is discarded.
+ */
+
+typedef enum { EDGEX_POSTQ_BLOCK, EDGEX_POSTQ_DROP_OLDEST, EDGEX_POSTQ_DROP_NEWEST, EDGEX_POSTQ_COALESCE } edgex_postq_policy;
+
+typedef struct edgex_postq_t edgex_postq_t;
+
+typedef struct edgex_postq_stats
+{
+  uint32_t depth;
+  uint32_t queued;
+  uint64_t dropped;
+  uint64_t coalesced;
+} edgex_postq_stats;
+
+/* depth: maximum number of queued events, 0 for no limit. policy: name of the policy, NULL for Block */
+
+edgex_postq_t *edgex_postq_alloc
+  (edgex_device_service *svc, uint32_t depth, const char *policy, edgex_error *err);
+
+/* Queue an event for submission. The queue takes ownership of the event */
+
+void edgex_postq_add
+  (edgex_postq_t *q, const char *device, const char *resource, edgex_event_cooked *event);
+
+/* Queue a number of events under one lock, to be submitted by a single job */
+
+void edgex_postq_addv
+(
+  edgex_postq_t *q,
+  unsigned n,
+  const char * const *devices,
+  const char * const *resources,
+  edgex_event_cooked **events
+);
+
+void edgex_postq_getstats (edgex_postq_t *q, edgex_postq_stats *stats);
+
+const char *edgex_postq_policyname (edgex_postq_t *q);
+
+/* Must be called once the thread pool has completed its work */
+
+void edgex_postq_free (edgex_postq_t *q);
+
+#endif
@@ -14,12 +14,28 @@
 #include "edgex-rest.h"
 #include "edgex-time.h"
 #include "errorlist.h"
+#include "pool.h"
+#include "map.h"
 
+#include <inttypes.h>
+#include <unistd.h>
 #include <dirent.h>
 #include <errno.h>
 #include <yaml.h>
 
 #define MAX_PATH_SIZE 256
+#define UPLOAD_THREADS 8
+
+/*
+ * The names of the profiles in the directory are cached in this file, keyed
+ * by a hash of each file's contents, so that only new or changed files need
+ * to be parsed. The file holds a header and count, then for each entry the
+ * hash, the length of the name and the name, in host byte order.
+ */
+
+#define NAMECACHE_FILE ".profilenames"
+#define NAMECACHE_MAGIC "EDPN"
+#define NAMECACHE_VERSION 1
 
 static int yamlselect (const struct dirent *d)
 {
@@ -48,51 +64,205 @@ static bool need_vds (edgex_device_service *svc)
   return result;
 }
 
-static void generate_value_descriptors
-(
-  edgex_device_service *svc,
-  const edgex_deviceprofile *dp
-)
+/*
+ * State shared by the uploads of a directory of profiles. Whether value
+ * descriptors are to be created, and those which core-data already holds,
+ * are found when first needed; after that they are only read.
+ */
+
+typedef edgex_map(JSON_Object *) edgex_map_vdobj;
+
+typedef struct profile_upload
+{
+  edgex_device_service *svc;
+  iot_threadpool_t *pool;
+  pthread_mutex_t lock;
+  bool checked;
+  bool needvds;
+  JSON_Value *existing;
+  edgex_map_vdobj vds;
+  edgex_map_string names;
+  edgex_map_string found;
+  bool namesdirty;
+  edgex_error err;
+} profile_upload;
+
+typedef struct upload_job
+{
+  profile_upload *up;
+  char *path;
+} upload_job;
+
+typedef struct vd_job
+{
+  profile_upload *up;
+  const edgex_deviceresource *res;
+  uint64_t timenow;
+} vd_job;
+
+static void upload_init (profile_upload *up, edgex_device_service *svc, iot_threadpool_t *pool)
+{
+  up->svc = svc;
+  up->pool = pool;
+  pthread_mutex_init (&up->lock, NULL);
+  up->checked = false;
+  up->needvds = false;
+  up->existing = NULL;
+  edgex_map_init (&up->vds);
+  edgex_map_init (&up->names);
+  edgex_map_init (&up->found);
+  up->namesdirty = false;
+  up->err = EDGEX_OK;
+}
+
+static void names_free (edgex_map_string *names)
+{
+  const char *key;
+  edgex_map_iter iter = edgex_map_iter (*names);
+  while ((key = edgex_map_next (names, &iter)))
+  {
+    free (*edgex_map_get (names, key));
+  }
+  edgex_map_deinit (names);
+}
+
+static void upload_fini (profile_upload *up)
+{
+  names_free (&up->names);
+  names_free (&up->found);
+  edgex_map_deinit (&up->vds);
+  json_value_free (up->existing);
+  pthread_mutex_destroy (&up->lock);
+}
+
+static bool upload_needvds (profile_upload *up)
+{
+  pthread_mutex_lock (&up->lock);
+  if (!up->checked)
+  {
+    edgex_error err = EDGEX_OK;
+    up->needvds = need_vds (up->svc);
+    if (up->needvds)
+    {
+      up->existing = edgex_data_client_get_valuedescriptors (up->svc->logger, &up->svc->config.endpoints, &err);
+      JSON_Array *array = json_value_get_array (up->existing);
+      size_t count = json_array_get_count (array);
+      for (size_t i = 0; i < count; i++)
+      {
+        JSON_Object *obj = json_array_get_object (array, i);
+        const char *name = json_object_get_string (obj, "name");
+        if (name)
+        {
+          edgex_map_set (&up->vds, name, obj);
+        }
+      }
+    }
+    up->checked = true;
+  }
+  pthread_mutex_unlock (&up->lock);
+  return up->needvds;
+}
+
+static bool vd_field_equal (JSON_Object *obj, const char *field, const char *value)
+{
+  const char *existing = json_object_get_string (obj, field);
+  return strcmp (existing ? existing : "", value ? value : "") == 0;
+}
+
+/* Whether core-data already has a value descriptor matching the resource. The map is read concurrently, so its own get is not used */
+
+static bool vd_exists (profile_upload *up, const edgex_deviceresource *res, const char *type)
+{
+  JSON_Object **found = (JSON_Object **)edgex_map_get_ (&up->vds.base, res->name);
+  edgex_propertyvalue *pv = res->properties->value;
+  return found &&
+    vd_field_equal (*found, "type", type) &&
+    vd_field_equal (*found, "min", pv->minimum) &&
+    vd_field_equal (*found, "max", pv->maximum) &&
+    vd_field_equal (*found, "uomLabel", res->properties->units->defaultvalue) &&
+    vd_field_equal (*found, "defaultValue", pv->defaultvalue) &&
+    vd_field_equal (*found, "mediaType", pv->mediaType);
+}
+
+static void add_value_descriptor (profile_upload *up, const edgex_deviceresource *res, uint64_t timenow)
+{
+  edgex_device_service *svc = up->svc;
+  edgex_propertyvalue *pv = res->properties->value;
+  edgex_units *units = res->properties->units;
+  char type[2];
+  edgex_valuedescriptor *vd;
+  edgex_error err;
+  iot_logger_t *lc = svc->logger;
+
+  type[0] = edgex_propertytype_tostring (pv->type)[0];
+  type[1] = '\0';
+  vd = edgex_data_client_add_valuedescriptor
+  (
+    lc,
+    &svc->config.endpoints,
+    res->name,
+    timenow,
+    pv->minimum,
+    pv->maximum,
+    type,
+    units->defaultvalue,
+    pv->defaultvalue,
+    "%s",
+    res->description,
+    pv->mediaType,
+    pv->floatAsBinary ? "base64" : "eNotation",
+    &err
+  );
+  if (err.code)
+  {
+    iot_log_error (lc, "Unable to create ValueDescriptor for %s", res->name);
+  }
+  edgex_valuedescriptor_free (vd);
+}
+
+static void vd_run (void *p)
+{
+  vd_job *job = (vd_job *)p;
+  add_value_descriptor (job->up, job->res, job->timenow);
+  free (job);
+}
+
+/* Value descriptors are created on the upload pool if there is one, otherwise in turn */
+
+static void generate_value_descriptors (profile_upload *up, const edgex_deviceprofile *dp)
 {
   uint64_t timenow = edgex_device_millitime ();
+  unsigned skipped = 0;
 
   for (edgex_deviceresource *res = dp->device_resources; res; res = res->next)
   {
-    edgex_propertyvalue *pv = res->properties->value;
-    edgex_units *units = res->properties->units;
     char type[2];
-    edgex_valuedescriptor *vd;
-    edgex_error err;
-    iot_logger_t *lc = svc->logger;
-
-    type[0] = edgex_propertytype_tostring (pv->type)[0];
+    type[0] = edgex_propertytype_tostring (res->properties->value->type)[0];
     type[1] = '\0';
-    vd = edgex_data_client_add_valuedescriptor
-    (
-      lc,
-      &svc->config.endpoints,
-      res->name,
-      timenow,
-      pv->minimum,
-      pv->maximum,
-      type,
-      units->defaultvalue,
-      pv->defaultvalue,
-      "%s",
-      res->description,
-      pv->mediaType,
-      pv->floatAsBinary ? "base64" : "eNotation",
-      &err
-    );
-    if (err.code)
+    if (vd_exists (up, res, type))
     {
-      iot_log_error (lc, "Unable to create ValueDescriptor for %s", res->name);
+      skipped++;
     }
-    edgex_valuedescriptor_free (vd);
+    else if (up->pool)
+    {
+      vd_job *job = malloc (sizeof (vd_job));
+      job->up = up;
+      job->res = res;
+      job->timenow = timenow;
+      edgex_pool_add_work (up->pool, vd_run, job);
+    }
+    else
+    {
+      add_value_descriptor (up, res, timenow);
+    }
+  }
+  if (skipped)
+  {
+    iot_log_debug (up->svc->logger, "%u ValueDescriptors for DeviceProfile %s already exist", skipped, dp->name);
   }
 }
 
-static const edgex_deviceprofile *edgex_deviceprofile_get_internal
+const edgex_deviceprofile *edgex_deviceprofile_get_internal
 (
   edgex_device_service *svc,
   const char *name,
@@ -108,13 +278,127 @@ static const edgex_deviceprofile *edgex_deviceprofile_get_internal
       (svc->logger, &svc->config.endpoints, name, err);
     if (newdp)
     {
-      edgex_devmap_add_profile (svc->devices, newdp);
-      dp = newdp;
+      dp = edgex_devmap_add_profile (svc->devices, newdp);
     }
   }
   return dp;
 }
 
+static void add_profile (profile_upload *up, const char *fname, edgex_error *err);
+
+static void namecache_load (profile_upload *up, const char *dir)
+{
+  char path[MAX_PATH_SIZE];
+  char magic[4];
+  uint32_t version;
+  uint32_t count;
+  FILE *f;
+
+  snprintf (path, MAX_PATH_SIZE, "%s/%s", dir, NAMECACHE_FILE);
+  f = fopen (path, "rb");
+  if (f == NULL)
+  {
+    return;
+  }
+  if
+  (
+    fread (magic, sizeof (magic), 1, f) == 1 && memcmp (magic, NAMECACHE_MAGIC, 4) == 0 &&
+    fread (&version, sizeof (version), 1, f) == 1 && version == NAMECACHE_VERSION &&
+    fread (&count, sizeof (count), 1, f) == 1
+  )
+  {
+    for (uint32_t i = 0; i < count; i++)
+    {
+      uint64_t hash;
+      uint32_t len;
+      char key[17];
+      char *name;
+      if (fread (&hash, sizeof (hash), 1, f) != 1 || fread (&len, sizeof (len), 1, f) != 1 || len > MAX_PATH_SIZE)
+      {
+        break;
+      }
+      name = malloc (len + 1);
+      if (fread (name, 1, len, f) != len)
+      {
+        free (name);
+        break;
+      }
+      name[len] = '\0';
+      snprintf (key, sizeof (key), "%016" PRIx64, hash);
+      edgex_map_set (&up->names, key, name);
+    }
+  }
+  fclose (f);
+}
+
+/* Write the names found in this run if they differ from the cache, through a temporary file so that a failed write leaves the old cache intact. Failure (eg a read-only directory) only means that files are parsed again */
+
+static void namecache_save (profile_upload *up, const char *dir)
+{
+  char path[MAX_PATH_SIZE];
+  char tmppath[MAX_PATH_SIZE + sizeof (".tmp")];
+  uint32_t version = NAMECACHE_VERSION;
+  uint32_t count = edgex_map_size (&up->found);
+  const char *key;
+  edgex_map_iter iter;
+  bool ok;
+  FILE *f;
+
+  if (!up->namesdirty && count == edgex_map_size (&up->names))
+  {
+    return;
+  }
+  snprintf (path, MAX_PATH_SIZE, "%s/%s", dir, NAMECACHE_FILE);
+  snprintf (tmppath, sizeof (tmppath), "%s.tmp", path);
+  f = fopen (tmppath, "wb");
+  if (f == NULL)
+  {
+    iot_log_debug (up->svc->logger, "Unable to write profile name cache %s: %s", tmppath, strerror (errno));
+    return;
+  }
+  ok = fwrite (NAMECACHE_MAGIC, 4, 1, f) == 1 && fwrite (&version, sizeof (version), 1, f) == 1 &&
+    fwrite (&count, sizeof (count), 1, f) == 1;
+  iter = edgex_map_iter (up->found);
+  while (ok && (key = edgex_map_next (&up->found, &iter)))
+  {
+    const char *name = *edgex_map_get (&up->found, key);
+    uint64_t hash = strtoull (key, NULL, 16);
+    uint32_t len = strlen (name);
+    ok = fwrite (&hash, sizeof (hash), 1, f) == 1 && fwrite (&len, sizeof (len), 1, f) == 1 &&
+      fwrite (name, 1, len, f) == len;
+  }
+  ok = (fclose (f) == 0) && ok;
+  if (!ok || rename (tmppath, path) != 0)
+  {
+    iot_log_debug (up->svc->logger, "Unable to write profile name cache %s", path);
+    unlink (tmppath);
+  }
+}
+
+static void upload_run (void *p)
+{
+  upload_job *job = (upload_job *)p;
+  edgex_error err = EDGEX_OK;
+  add_profile (job->up, job->path, &err);
+  if (err.code)
+  {
+    pthread_mutex_lock (&job->up->lock);
+    if (job->up->err.code == 0)
+    {
+      job->up->err = err;
+    }
+    pthread_mutex_unlock (&job->up->lock);
+  }
+  free (job->path);
+  free (job);
+}
+
+/*
+ * The profiles are parsed and uploaded on a pool of threads, which also
+ * creates any value descriptors needed. The first error encountered is
+ * returned, but the remaining profiles are still processed.
+ */
+
 void edgex_device_profiles_upload (edgex_device_service *svc, edgex_error *err)
 {
   struct dirent **filenames = NULL;
@@ -123,6 +407,8 @@ void edgex_device_profiles_upload (edgex_device_service *svc, edgex_error *err)
   char pathname[MAX_PATH_SIZE];
   const char *profileDir = svc->config.device.profilesdir;
   iot_logger_t *lc = svc->logger;
+  iot_threadpool_t *pool;
+  profile_upload up;
 
   *err = EDGEX_OK;
   n = scandir (profileDir, &filenames, yamlselect, NULL);
@@ -142,24 +428,33 @@ void edgex_device_profiles_upload (edgex_device_service *svc, edgex_error *err)
 
   iot_log_info (lc, "Processing Device Profiles from %s", profileDir);
 
+  pool = iot_threadpool_alloc (n && n < UPLOAD_THREADS ? n : UPLOAD_THREADS, 0, NULL, lc);
+  iot_threadpool_start (pool);
+  upload_init (&up, svc, pool);
+  namecache_load (&up, profileDir);
   while (n--)
   {
-    if (err->code == 0)
+    fname = filenames[n]->d_name;
+    if (snprintf (pathname, MAX_PATH_SIZE, "%s/%s", profileDir, fname) < MAX_PATH_SIZE)
     {
-      fname = filenames[n]->d_name;
-      if (snprintf (pathname, MAX_PATH_SIZE, "%s/%s", profileDir, fname) < MAX_PATH_SIZE)
-      {
-        edgex_device_add_profile (svc, pathname, err);
-      }
-      else
-      {
-        iot_log_error (lc, "%s: Pathname too long (max %d chars)", fname, MAX_PATH_SIZE - 1);
-        *err = EDGEX_PROFILE_PARSE_ERROR;
-      }
+      upload_job *job = malloc (sizeof (upload_job));
+      job->up = &up;
+      job->path = strdup (pathname);
+      edgex_pool_add_work (pool, upload_run, job);
+    }
+    else if (up.err.code == 0)
+    {
+      iot_log_error (lc, "%s: Pathname too long (max %d chars)", fname, MAX_PATH_SIZE - 1);
+      up.err = EDGEX_PROFILE_PARSE_ERROR;
     }
     free (filenames[n]);
   }
   free (filenames);
+  iot_threadpool_wait (pool);
+  iot_threadpool_free (pool);
+  namecache_save (&up, profileDir);
+  *err = up.err;
+  upload_fini (&up);
 }
 
 static char *getProfName (iot_logger_t *lc, const char *fname, edgex_error *err)
@@ -230,15 +525,79 @@ static char *getProfName (iot_logger_t *lc, const char *fname, edgex_error *err)
   return result;
 }
 
-void edgex_device_add_profile (edgex_device_service *svc, const char *fname, edgex_error *err)
+static bool file_hash (const char *fname, uint64_t *hash)
+{
+  unsigned char buf[4096];
+  size_t n;
+  uint64_t h = 14695981039346656037u;
+  FILE *f = fopen (fname, "rb");
+
+  if (f == NULL)
+  {
+    return false;
+  }
+  while ((n = fread (buf, 1, sizeof (buf), f)) > 0)
+  {
+    for (size_t i = 0; i < n; i++)
+    {
+      h = (h ^ buf[i]) * 1099511628211u;
+    }
+  }
+  fclose (f);
+  *hash = h;
+  return true;
+}
+
+/* The profile name from the cache if the file is unchanged, otherwise from parsing it */
+
+static char *profile_name (profile_upload *up, const char *fname, edgex_error *err)
+{
+  char key[17];
+  char **cached;
+  char *result = NULL;
+  bool parsed = false;
+  uint64_t hash;
+
+  if (!file_hash (fname, &hash))
+  {
+    return getProfName (up->svc->logger, fname, err);
+  }
+  snprintf (key, sizeof (key), "%016" PRIx64, hash);
+  pthread_mutex_lock (&up->lock);
+  cached = edgex_map_get (&up->names, key);
+  if (cached)
+  {
+    result = strdup (*cached);
+  }
+  pthread_mutex_unlock (&up->lock);
+  if (result == NULL)
+  {
+    parsed = true;
+    result = getProfName (up->svc->logger, fname, err);
+  }
+  if (result)
+  {
+    pthread_mutex_lock (&up->lock);
+    up->namesdirty |= parsed;
+    if (edgex_map_get (&up->found, key) == NULL)
+    {
+      edgex_map_set (&up->found, key, strdup (result));
+    }
+    pthread_mutex_unlock (&up->lock);
+  }
+  return result;
+}
+
+static void add_profile (profile_upload *up, const char *fname, edgex_error *err)
 {
+  edgex_device_service *svc = up->svc;
   const edgex_deviceprofile *dp;
   edgex_service_endpoints *endpoints = &svc->config.endpoints;
   char *profname;
   iot_logger_t *lc = svc->logger;
 
   *err = EDGEX_OK;
-  profname = getProfName (lc, fname, err);
+  profname = profile_name (up, fname, err);
   if (profname)
   {
     iot_log_debug (lc, "Checking existence of DeviceProfile %s", profname);
@@ -260,10 +619,10 @@ void edgex_device_add_profile (edgex_device_service *svc, const char *fname, edg
         dp = edgex_deviceprofile_get_internal (svc, profname, err);
         if (dp)
         {
-          if (need_vds (svc))
+          if (upload_needvds (up))
           {
             iot_log_info (lc, "Generating value descriptors for DeviceProfile %s", profname);
-            generate_value_descriptors (svc, dp);
+            generate_value_descriptors (up, dp);
           }
         }
         else
@@ -276,6 +635,14 @@ void edgex_device_add_profile (edgex_device_service *svc, const char *fname, edg
   }
 }
 
+void edgex_device_add_profile (edgex_device_service *svc, const char *fname, edgex_error *err)
+{
+  profile_upload up;
+  upload_init (&up, svc, NULL);
+  add_profile (&up, fname, err);
+  upload_fini (&up);
+}
+
 edgex_deviceprofile *edgex_device_get_deviceprofile_byname
   (edgex_device_service *svc, const char *name)
 {
@@ -17,4 +17,13 @@ extern void edgex_device_profiles_upload
   edgex_error *err
 );
 
+/* Obtain a profile from the devmap, retrieving it from metadata if necessary */
+
+extern const edgex_deviceprofile *edgex_deviceprofile_get_internal
+(
+  edgex_device_service *svc,
+  const char *name,
+  edgex_error *err
+);
+
 #endif
@@ -0,0 +1,384 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#include "qos.h"
+#include "map.h"
+#include "edgex-time.h"
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Each waiting caller is queued twice: on its device's list within its class,
+ * and on the class's list in order of arrival, whose head is the caller which
+ * has waited longest. Devices with callers waiting are kept on a list per
+ * class, from whose head the next caller is taken; the device then goes to
+ * the back of the list, or is removed if it has no more callers waiting.
+ * Callers which block wait on their condition variable; those which joined
+ * without blocking have their function called when they are admitted.
+ */
+
+typedef struct qos_waiter
+{
+  struct qos_waiter *next;
+  struct qos_waiter *older;
+  struct qos_waiter *newer;
+  struct qos_device *dev;
+  edgex_qos_class cls;
+  uint64_t queued;
+  bool admitted;
+  edgex_qos_fn fn;
+  void *ctx;
+  pthread_cond_t cond;
+} qos_waiter;
+
+typedef struct qos_device
+{
+  struct qos_device *prev;
+  struct qos_device *next;
+  qos_waiter *head;
+  qos_waiter *tail;
+  char *name;
+} qos_device;
+
+typedef edgex_map(qos_device *) edgex_map_qos_device;
+
+typedef struct qos_class
+{
+  edgex_map_qos_device devices;
+  qos_device *first;
+  qos_device *last;
+  qos_waiter *oldest;
+  qos_waiter *newest;
+  uint32_t waiting;
+  uint64_t admitted;
+  uint64_t promoted;
+  edgex_histogram wait;
+  edgex_histogram service;
+} qos_class;
+
+struct edgex_qos_t
+{
+  pthread_mutex_t lock;
+  uint32_t slots;
+  uint32_t busy;
+  uint32_t waiting;
+  uint64_t maxwait;
+  qos_class classes[EDGEX_QOS_CLASSES];
+};
+
+static const char *qos_names[EDGEX_QOS_CLASSES] = { "Command", "AutoEvent", "Discovery" };
+
+edgex_qos_t *edgex_qos_alloc (uint32_t slots, uint32_t maxwait)
+{
+  edgex_qos_t *q = calloc (1, sizeof (edgex_qos_t));
+  pthread_mutex_init (&q->lock, NULL);
+  q->slots = slots ? slots : 1;
+  q->maxwait = (uint64_t)maxwait * 1000000;
+  for (unsigned c = 0; c < EDGEX_QOS_CLASSES; c++)
+  {
+    edgex_map_init (&q->classes[c].devices);
+  }
+  return q;
+}
+
+const char *edgex_qos_classname (edgex_qos_class cls)
+{
+  return qos_names[cls];
+}
+
+uint32_t edgex_qos_slots (const edgex_qos_t *q)
+{
+  return q->slots;
+}
+
+static void qos_enqueue (edgex_qos_t *q, qos_waiter *w, const char *device)
+{
+  qos_class *c = &q->classes[w->cls];
+  qos_device **existing = edgex_map_get (&c->devices, device);
+  qos_device *d;
+
+  if (existing)
+  {
+    d = *existing;
+    d->tail->next = w;
+  }
+  else
+  {
+    d = calloc (1, sizeof (qos_device));
+    d->name = strdup (device);
+    d->head = w;
+    d->prev = c->last;
+    if (c->last)
+    {
+      c->last->next = d;
+    }
+    else
+    {
+      c->first = d;
+    }
+    c->last = d;
+    edgex_map_set (&c->devices, device, d);
+  }
+  d->tail = w;
+  w->dev = d;
+
+  w->older = c->newest;
+  if (c->newest)
+  {
+    c->newest->newer = w;
+  }
+  else
+  {
+    c->oldest = w;
+  }
+  c->newest = w;
+  c->waiting++;
+  q->waiting++;
+}
+
+static void qos_unlink_device (qos_class *c, qos_device *d)
+{
+  if (d->prev)
+  {
+    d->prev->next = d->next;
+  }
+  else
+  {
+    c->first = d->next;
+  }
+  if (d->next)
+  {
+    d->next->prev = d->prev;
+  }
+  else
+  {
+    c->last = d->prev;
+  }
+  d->prev = d->next = NULL;
+}
+
+/* Remove a waiter, which is at the head of its device's list */
+
+static void qos_dequeue (edgex_qos_t *q, qos_waiter *w)
+{
+  qos_class *c = &q->classes[w->cls];
+  qos_device *d = w->dev;
+
+  d->head = w->next;
+  qos_unlink_device (c, d);
+  if (d->head)
+  {
+    d->prev = c->last;
+    if (c->last)
+    {
+      c->last->next = d;
+    }
+    else
+    {
+      c->first = d;
+    }
+    c->last = d;
+  }
+  else
+  {
+    edgex_map_remove (&c->devices, d->name);
+    free (d->name);
+    free (d);
+  }
+
+  if (w->older)
+  {
+    w->older->newer = w->newer;
+  }
+  else
+  {
+    c->oldest = w->newer;
+  }
+  if (w->newer)
+  {
+    w->newer->older = w->older;
+  }
+  else
+  {
+    c->newest = w->older;
+  }
+  c->waiting--;
+  c->admitted++;
+  q->waiting--;
+}
+
+/* Choose the next caller to admit. Called with the lock held and callers waiting */
+
+static qos_waiter *qos_next (edgex_qos_t *q)
+{
+  qos_waiter *oldest = NULL;
+  qos_class *top = NULL;
+
+  for (unsigned c = 0; c < EDGEX_QOS_CLASSES; c++)
+  {
+    qos_waiter *w = q->classes[c].oldest;
+    if (w && (oldest == NULL || w->queued < oldest->queued))
+    {
+      oldest = w;
+    }
+    if (top == NULL && w)
+    {
+      top = &q->classes[c];
+    }
+  }
+  if (q->maxwait && &q->classes[oldest->cls] != top && edgex_device_nanotime_monotonic () - oldest->queued > q->maxwait)
+  {
+    q->classes[oldest->cls].promoted++;
+    return oldest;
+  }
+  return top->first->head;
+}
+
+/* Admit a caller at once if a slot is free and none is waiting. Called with the lock held */
+
+static bool qos_admit (edgex_qos_t *q, edgex_qos_class cls)
+{
+  if (q->busy < q->slots && q->waiting == 0)
+  {
+    q->busy++;
+    q->classes[cls].admitted++;
+    return true;
+  }
+  return false;
+}
+
+uint64_t edgex_qos_enter (edgex_qos_t *q, edgex_qos_class cls, const char *device)
+{
+  qos_waiter w;
+  uint64_t now;
+
+  if (q == NULL)
+  {
+    return 0;
+  }
+  pthread_mutex_lock (&q->lock);
+  now = edgex_device_nanotime_monotonic ();
+  if (qos_admit (q, cls))
+  {
+    pthread_mutex_unlock (&q->lock);
+    edgex_histogram_record (&q->classes[cls].wait, 0);
+    return now;
+  }
+
+  memset (&w, 0, sizeof (w));
+  w.cls = cls;
+  w.queued = now;
+  pthread_cond_init (&w.cond, NULL);
+  qos_enqueue (q, &w, device ? device : "");
+  while (!w.admitted)
+  {
+    pthread_cond_wait (&w.cond, &q->lock);
+  }
+  pthread_mutex_unlock (&q->lock);
+  pthread_cond_destroy (&w.cond);
+
+  now = edgex_device_nanotime_monotonic ();
+  edgex_histogram_record (&q->classes[cls].wait, (now - w.queued) / 1000);
+  return now;
+}
+
+bool edgex_qos_join
+  (edgex_qos_t *q, edgex_qos_class cls, const char *device, edgex_qos_fn fn, void *ctx, uint64_t *ticket)
+{
+  qos_waiter *w;
+
+  if (q == NULL)
+  {
+    *ticket = 0;
+    return true;
+  }
+  pthread_mutex_lock (&q->lock);
+  *ticket = edgex_device_nanotime_monotonic ();
+  if (qos_admit (q, cls))
+  {
+    pthread_mutex_unlock (&q->lock);
+    edgex_histogram_record (&q->classes[cls].wait, 0);
+    return true;
+  }
+  w = calloc (1, sizeof (qos_waiter));
+  w->cls = cls;
+  w->queued = *ticket;
+  w->fn = fn;
+  w->ctx = ctx;
+  qos_enqueue (q, w, device ? device : "");
+  pthread_mutex_unlock (&q->lock);
+  return false;
+}
+
+/* The slot of a call which finishes passes directly to the next caller, if there is one */
+
+void edgex_qos_leave (edgex_qos_t *q, edgex_qos_class cls, uint64_t ticket)
+{
+  qos_waiter *joined = NULL;
+
+  if (q == NULL)
+  {
+    return;
+  }
+  edgex_histogram_record (&q->classes[cls].service, (edgex_device_nanotime_monotonic () - ticket) / 1000);
+  pthread_mutex_lock (&q->lock);
+  if (q->waiting)
+  {
+    qos_waiter *w = qos_next (q);
+    qos_dequeue (q, w);
+    if (w->fn)
+    {
+      joined = w;
+    }
+    else
+    {
+      w->admitted = true;
+      pthread_cond_signal (&w->cond);
+    }
+  }
+  else
+  {
+    q->busy--;
+  }
+  pthread_mutex_unlock (&q->lock);
+  if (joined)
+  {
+    uint64_t now = edgex_device_nanotime_monotonic ();
+    edgex_histogram_record (&q->classes[joined->cls].wait, (now - joined->queued) / 1000);
+    joined->fn (joined->ctx, now);
+    free (joined);
+  }
+}
+
+void edgex_qos_getstats (edgex_qos_t *q, edgex_qos_class cls, edgex_qos_stats *stats)
+{
+  qos_class *c = &q->classes[cls];
+  pthread_mutex_lock (&q->lock);
+  stats->waiting = c->waiting;
+  stats->admitted = c->admitted;
+  stats->promoted = c->promoted;
+  pthread_mutex_unlock (&q->lock);
+  stats->wait = &c->wait;
+  stats->service = &c->service;
+}
+
+void edgex_qos_free (edgex_qos_t *q)
+{
+  if (q)
+  {
+    for (unsigned c = 0; c < EDGEX_QOS_CLASSES; c++)
+    {
+      edgex_map_deinit (&q->classes[c].devices);
+    }
+    pthread_mutex_destroy (&q->lock);
+    free (q);
+  }
+}
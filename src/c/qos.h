@@ -0,0 +1,80 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#ifndef _EDGEX_DEVICE_QOS_H_
+#define _EDGEX_DEVICE_QOS_H_ 1
+
+#include "latency.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Prioritized admission of calls to the device service implementation. At
+ * most a configured number of calls are made at once; when a call finishes,
+ * its slot passes to a waiting caller of the highest class present, taking
+ * the devices with callers waiting in that class in turn and the callers for
+ * each device in the order in which they arrived. A caller which has waited
+ * longer than the starvation limit is admitted next whatever its class. The
+ * time each call waits to be admitted, and then takes, is recorded per class
+ * (in microseconds). Where the gate is NULL, enter and leave do nothing.
+ */
+
+typedef enum
+{
+  EDGEX_QOS_COMMAND,
+  EDGEX_QOS_AUTOEVENT,
+  EDGEX_QOS_DISCOVERY
+} edgex_qos_class;
+
+#define EDGEX_QOS_CLASSES (EDGEX_QOS_DISCOVERY + 1)
+
+#define EDGEX_QOS_DEFAULT_MAXWAIT 1000
+
+typedef struct edgex_qos_t edgex_qos_t;
+
+typedef struct edgex_qos_stats
+{
+  uint32_t waiting;
+  uint64_t admitted;
+  uint64_t promoted;
+  edgex_histogram *wait;
+  edgex_histogram *service;
+} edgex_qos_stats;
+
+/* Allow up to slots calls at once. Callers waiting over maxwait milliseconds are promoted; 0 disables this */
+
+edgex_qos_t *edgex_qos_alloc (uint32_t slots, uint32_t maxwait);
+
+/* Wait for admission of a call for a device (which may be NULL). Returns a ticket to pass to edgex_qos_leave */
+
+uint64_t edgex_qos_enter (edgex_qos_t *q, edgex_qos_class cls, const char *device);
+
+/*
+ * Join the queue for admission without waiting. Returns true, with the
+ * ticket set, if the call is admitted at once; otherwise the function is
+ * called with ctx and the ticket when it is, on the thread which leaves
+ * before it, and false is returned.
+ */
+
+typedef void (*edgex_qos_fn) (void *ctx, uint64_t ticket);
+
+bool edgex_qos_join
+  (edgex_qos_t *q, edgex_qos_class cls, const char *device, edgex_qos_fn fn, void *ctx, uint64_t *ticket);
+
+void edgex_qos_leave (edgex_qos_t *q, edgex_qos_class cls, uint64_t ticket);
+
+const char *edgex_qos_classname (edgex_qos_class cls);
+
+uint32_t edgex_qos_slots (const edgex_qos_t *q);
+
+void edgex_qos_getstats (edgex_qos_t *q, edgex_qos_class cls, edgex_qos_stats *stats);
+
+void edgex_qos_free (edgex_qos_t *q);
+
+#endif
@@ -0,0 +1,199 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#include "readcache.h"
+#include "data.h"
+#include "edgex-time.h"
+#include "map.h"
+
+#include <pthread.h>
+#include <time.h>
+
+typedef struct edgex_readcache_entry
+{
+  edgex_device_commandresult *value;
+  uint64_t stored;
+} edgex_readcache_entry;
+
+typedef edgex_map(edgex_readcache_entry) edgex_map_readcache_entry;
+
+struct edgex_readcache_t
+{
+  edgex_map_readcache_entry entries;
+  uint32_t count;
+  uint64_t hits;
+  uint64_t misses;
+  pthread_mutex_t lock;
+};
+
+static uint64_t monotime_ms (void)
+{
+  struct timespec ts;
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static char *cache_key (const char *device, const char *resource)
+{
+  size_t sz = strlen (device) + strlen (resource) + 2;
+  char *key = malloc (sz);
+  snprintf (key, sz, "%s/%s", device, resource);
+  return key;
+}
+
+edgex_readcache_t *edgex_readcache_alloc (void)
+{
+  edgex_readcache_t *cache = calloc (1, sizeof (edgex_readcache_t));
+  edgex_map_init (&cache->entries);
+  pthread_mutex_init (&cache->lock, NULL);
+  return cache;
+}
+
+void edgex_readcache_put
+  (edgex_readcache_t *cache, const char *device, const edgex_cmdinfo *cmd, edgex_device_commandresult *results)
+{
+  uint64_t now = monotime_ms ();
+  uint64_t origin = edgex_device_nanotime ();
+
+  for (unsigned i = 0; i < cmd->nreqs; i++)
+  {
+    if (cmd->maxage[i])
+    {
+      edgex_readcache_entry entry;
+      edgex_readcache_entry *existing;
+      char *key = cache_key (device, cmd->reqs[i].resname);
+
+      if (results[i].origin == 0)
+      {
+        results[i].origin = origin;
+      }
+      entry.value = edgex_device_commandresult_dup (&results[i], 1);
+      entry.stored = now;
+
+      pthread_mutex_lock (&cache->lock);
+      existing = edgex_map_get (&cache->entries, key);
+      if (existing)
+      {
+        edgex_device_commandresult_free (existing->value, 1);
+      }
+      else
+      {
+        cache->count++;
+      }
+      edgex_map_set (&cache->entries, key, entry);
+      pthread_mutex_unlock (&cache->lock);
+      free (key);
+    }
+  }
+}
+
+bool edgex_readcache_get
+  (edgex_readcache_t *cache, const char *device, const edgex_cmdinfo *cmd, edgex_device_commandresult *results)
+{
+  unsigned i;
+  uint64_t now = monotime_ms ();
+
+  pthread_mutex_lock (&cache->lock);
+  for (i = 0; i < cmd->nreqs; i++)
+  {
+    edgex_readcache_entry *entry = NULL;
+    if (cmd->maxage[i])
+    {
+      char *key = cache_key (device, cmd->reqs[i].resname);
+      entry = edgex_map_get (&cache->entries, key);
+      free (key);
+    }
+    if (entry == NULL || now - entry->stored > cmd->maxage[i])
+    {
+      break;
+    }
+    edgex_device_commandresult *copy = edgex_device_commandresult_dup (entry->value, 1);
+    results[i] = *copy;
+    free (copy);
+  }
+
+  if (i < cmd->nreqs)
+  {
+    cache->misses++;
+    pthread_mutex_unlock (&cache->lock);
+    edgex_device_commandresult *partial = malloc (cmd->nreqs * sizeof (edgex_device_commandresult));
+    memcpy (partial, results, cmd->nreqs * sizeof (edgex_device_commandresult));
+    memset (results, 0, cmd->nreqs * sizeof (edgex_device_commandresult));
+    edgex_device_commandresult_free (partial, i);
+    return false;
+  }
+  cache->hits++;
+  pthread_mutex_unlock (&cache->lock);
+  return true;
+}
+
+void edgex_readcache_invalidate (edgex_readcache_t *cache, const char *device, const edgex_cmdinfo *cmd)
+{
+  for (unsigned i = 0; i < cmd->nreqs; i++)
+  {
+    if (cmd->maxage[i])
+    {
+      edgex_readcache_entry *entry;
+      char *key = cache_key (device, cmd->reqs[i].resname);
+      pthread_mutex_lock (&cache->lock);
+      entry = edgex_map_get (&cache->entries, key);
+      if (entry)
+      {
+        edgex_device_commandresult_free (entry->value, 1);
+        edgex_map_remove (&cache->entries, key);
+        cache->count--;
+      }
+      pthread_mutex_unlock (&cache->lock);
+      free (key);
+    }
+  }
+}
+
+void edgex_readcache_evict (edgex_readcache_t *cache, const char *device)
+{
+  const char *key;
+  edgex_map_iter iter = edgex_map_iter (cache->entries);
+  size_t len = strlen (device);
+
+  pthread_mutex_lock (&cache->lock);
+  while ((key = edgex_map_next (&cache->entries, &iter)))
+  {
+    if (strncmp (key, device, len) == 0 && key[len] == '/')
+    {
+      edgex_device_commandresult_free (edgex_map_get (&cache->entries, key)->value, 1);
+      edgex_map_remove (&cache->entries, key);
+      cache->count--;
+    }
+  }
+  pthread_mutex_unlock (&cache->lock);
+}
+
+void edgex_readcache_getstats (edgex_readcache_t *cache, edgex_readcache_stats *stats)
+{
+  pthread_mutex_lock (&cache->lock);
+  stats->entries = cache->count;
+  stats->hits = cache->hits;
+  stats->misses = cache->misses;
+  pthread_mutex_unlock (&cache->lock);
+}
+
+void edgex_readcache_free (edgex_readcache_t *cache)
+{
+  if (cache)
+  {
+    const char *key;
+    edgex_map_iter iter = edgex_map_iter (cache->entries);
+    while ((key = edgex_map_next (&cache->entries, &iter)))
+    {
+      edgex_device_commandresult_free (edgex_map_get (&cache->entries, key)->value, 1);
+    }
+    edgex_map_deinit (&cache->entries);
+    pthread_mutex_destroy (&cache->lock);
+    free (cache);
+  }
+}
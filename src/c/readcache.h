@@ -0,0 +1,59 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#ifndef _EDGEX_DEVICE_READCACHE_H_
+#define _EDGEX_DEVICE_READCACHE_H_ 1
+
+#include "edgex/devsdk.h"
+#include "cmdinfo.h"
+
+/*
+ * Last-value cache for device resources whose profile property specifies a
+ * maxAge. Readings are stored, as returned by the driver, when a GET command
+ * or an AutoEvent reads the resource; a GET command is served from the cache
+ * if all of its resources have readings no older than their maxAge.
+ */
+
+typedef struct edgex_readcache_t edgex_readcache_t;
+
+typedef struct edgex_readcache_stats
+{
+  uint32_t entries;
+  uint64_t hits;
+  uint64_t misses;
+} edgex_readcache_stats;
+
+edgex_readcache_t *edgex_readcache_alloc (void);
+
+/*
+ * Store the results of reading a command's resources. Results without an
+ * origin are given the current time, so that readings served from the cache
+ * carry the time at which they were taken.
+ */
+
+void edgex_readcache_put
+  (edgex_readcache_t *cache, const char *device, const edgex_cmdinfo *cmd, edgex_device_commandresult *results);
+
+/* Fill in results for a command from the cache. Returns false (leaving results empty) unless all are fresh */
+
+bool edgex_readcache_get
+  (edgex_readcache_t *cache, const char *device, const edgex_cmdinfo *cmd, edgex_device_commandresult *results);
+
+/* Discard any cached readings for a command's resources, eg after they have been written */
+
+void edgex_readcache_invalidate (edgex_readcache_t *cache, const char *device, const edgex_cmdinfo *cmd);
+
+/* Discard all cached readings for a device, when it is removed */
+
+void edgex_readcache_evict (edgex_readcache_t *cache, const char *device);
+
+void edgex_readcache_getstats (edgex_readcache_t *cache, edgex_readcache_stats *stats);
+
+void edgex_readcache_free (edgex_readcache_t *cache);
+
+#endif
@@ -0,0 +1,161 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#include "recycle.h"
+#include "data.h"
+#include "memstats.h"
+
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <pthread.h>
+
+/* Classes hold buffers of 64 << class bytes, up to 4KiB. Up to RECYCLE_KEEP buffers of each class are kept per thread */
+
+#define RECYCLE_MINSHIFT 6
+#define RECYCLE_CLASSES 7
+#define RECYCLE_UNCACHED RECYCLE_CLASSES
+#define RECYCLE_KEEP 16
+
+/* Buffers in use hold their class, and for uncached buffers the size, in place of the link */
+
+typedef struct recycle_buf
+{
+  union
+  {
+    struct recycle_buf *next;
+    struct
+    {
+      unsigned sclass;
+      size_t size;
+    } info;
+    max_align_t align;
+  } hdr;
+  _Alignas (max_align_t) char data[];
+} recycle_buf;
+
+typedef struct recycle_state
+{
+  recycle_buf *free[RECYCLE_CLASSES];
+  unsigned count[RECYCLE_CLASSES];
+} recycle_state;
+
+static _Thread_local recycle_state *recycle;
+static pthread_once_t recycle_once = PTHREAD_ONCE_INIT;
+static pthread_key_t recycle_key;
+
+#define RECYCLE_CLASSBYTES(c) (sizeof (recycle_buf) + ((size_t)1 << ((c) + RECYCLE_MINSHIFT)))
+
+static void recycle_thread_exit (void *p)
+{
+  recycle_state *st = (recycle_state *)p;
+  for (unsigned c = 0; c < RECYCLE_CLASSES; c++)
+  {
+    while (st->free[c])
+    {
+      recycle_buf *b = st->free[c];
+      st->free[c] = b->hdr.next;
+      edgex_memstats_free (EDGEX_MEM_POOLS, RECYCLE_CLASSBYTES (c));
+      free (b);
+    }
+  }
+  free (st);
+}
+
+static void recycle_init (void)
+{
+  pthread_key_create (&recycle_key, recycle_thread_exit);
+}
+
+static recycle_state *recycle_get (void)
+{
+  if (recycle == NULL)
+  {
+    pthread_once (&recycle_once, recycle_init);
+    recycle = calloc (1, sizeof (recycle_state));
+    pthread_setspecific (recycle_key, recycle);
+  }
+  return recycle;
+}
+
+static unsigned recycle_class (size_t size)
+{
+  unsigned c = 0;
+  while (c < RECYCLE_CLASSES && ((size_t)1 << (c + RECYCLE_MINSHIFT)) < size)
+  {
+    c++;
+  }
+  return c;
+}
+
+void *edgex_recycle_alloc (size_t size)
+{
+  unsigned c = recycle_class (size);
+  recycle_buf *b = NULL;
+
+  if (c == RECYCLE_UNCACHED)
+  {
+    b = malloc (sizeof (recycle_buf) + size);
+    b->hdr.info.size = size;
+    edgex_memstats_alloc (EDGEX_MEM_POOLS, sizeof (recycle_buf) + size);
+  }
+  else
+  {
+    recycle_state *st = recycle_get ();
+    b = st->free[c];
+    if (b)
+    {
+      st->free[c] = b->hdr.next;
+      st->count[c]--;
+    }
+    else
+    {
+      b = malloc (RECYCLE_CLASSBYTES (c));
+      edgex_memstats_alloc (EDGEX_MEM_POOLS, RECYCLE_CLASSBYTES (c));
+    }
+  }
+  b->hdr.info.sclass = c;
+  memset (b->data, 0, size);
+  return b->data;
+}
+
+void edgex_recycle_free (void *buf)
+{
+  if (buf)
+  {
+    recycle_buf *b = (recycle_buf *)((char *)buf - offsetof (recycle_buf, data));
+    unsigned c = b->hdr.info.sclass;
+    recycle_state *st;
+
+    if (c == RECYCLE_UNCACHED || (st = recycle_get ())->count[c] >= RECYCLE_KEEP)
+    {
+      edgex_memstats_free (EDGEX_MEM_POOLS, c == RECYCLE_UNCACHED ? sizeof (recycle_buf) + b->hdr.info.size : RECYCLE_CLASSBYTES (c));
+      free (b);
+    }
+    else
+    {
+      b->hdr.next = st->free[c];
+      st->free[c] = b;
+      st->count[c]++;
+    }
+  }
+}
+
+edgex_device_commandresult *edgex_recycle_results (unsigned n)
+{
+  return edgex_recycle_alloc (n * sizeof (edgex_device_commandresult));
+}
+
+void edgex_recycle_results_free (edgex_device_commandresult *res, unsigned n)
+{
+  if (res)
+  {
+    edgex_device_commandresult_clear (res, n);
+    edgex_recycle_free (res);
+  }
+}
@@ -0,0 +1,34 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#ifndef _EDGEX_DEVICE_RECYCLE_H_
+#define _EDGEX_DEVICE_RECYCLE_H_ 1
+
+#include "edgex/devsdk.h"
+
+/*
+ * Recycled buffers for the arrays of requests and results used on the read
+ * path. Buffers are taken from and returned to a cache on the calling thread,
+ * held in power-of-two size classes, so that repeated reads of a command do
+ * not allocate. A buffer may be freed on a different thread from the one that
+ * allocated it. Large buffers are not cached.
+ */
+
+/* A zero-filled buffer of at least size bytes */
+
+void *edgex_recycle_alloc (size_t size);
+
+void edgex_recycle_free (void *buf);
+
+/* An array of n results, and its release (which frees any String or Binary values, as edgex_device_commandresult_free) */
+
+edgex_device_commandresult *edgex_recycle_results (unsigned n);
+
+void edgex_recycle_results_free (edgex_device_commandresult *res, unsigned n);
+
+#endif
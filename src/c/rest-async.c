@@ -0,0 +1,302 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#include "rest-async.h"
+#include "placement.h"
+#include "errorlist.h"
+#include "correlation.h"
+#include "counters.h"
+#include "edgex-time.h"
+
+#include <curl/curl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if (LIBCURL_VERSION_NUM >= 0x074400)
+#define USE_CURL_WAKEUP
+#endif
+
+/* Wait time for socket activity when curl_multi_wakeup is unavailable */
+#define ASYNC_POLL_MS 10
+
+typedef struct edgex_async_req
+{
+  CURL *hnd;
+  char *url;
+  struct curl_slist *hdrs;
+  void *data;
+  size_t length;
+  void *zbuf;
+  size_t zlen;
+  char *rsp;
+  size_t rsplen;
+  edgex_http_async_callback cb;
+  void *ctx;
+  uint64_t start;
+  struct edgex_async_req *next;
+} edgex_async_req;
+
+struct edgex_http_async_t
+{
+  iot_logger_t *lc;
+  CURLM *multi;
+  unsigned maxinflight;
+  edgex_compression compress;
+  size_t compressmin;
+  unsigned inflight;
+  unsigned queued;
+  edgex_async_req *head;
+  edgex_async_req *tail;
+  pthread_mutex_t lock;
+  pthread_cond_t idle;
+  pthread_t thread;
+  bool running;
+};
+
+static size_t async_write_cb (void *contents, size_t size, size_t nmemb, void *userp)
+{
+  edgex_async_req *req = (edgex_async_req *)userp;
+  size *= nmemb;
+  req->rsp = realloc (req->rsp, req->rsplen + size + 1);
+  memcpy (req->rsp + req->rsplen, contents, size);
+  req->rsplen += size;
+  req->rsp[req->rsplen] = '\0';
+  return size;
+}
+
+static void async_start (edgex_http_async_t *client, edgex_async_req *req)
+{
+  req->hnd = edgex_curl_acquire (req->url);
+  curl_easy_setopt (req->hnd, CURLOPT_URL, req->url);
+  curl_easy_setopt (req->hnd, CURLOPT_USERAGENT, "edgex");
+  curl_easy_setopt (req->hnd, CURLOPT_TCP_KEEPALIVE, 1L);
+  curl_easy_setopt (req->hnd, CURLOPT_POST, 1L);
+  if (req->zbuf)
+  {
+    curl_easy_setopt (req->hnd, CURLOPT_POSTFIELDS, req->zbuf);
+    curl_easy_setopt (req->hnd, CURLOPT_POSTFIELDSIZE_LARGE, (curl_off_t)req->zlen);
+  }
+  else
+  {
+    curl_easy_setopt (req->hnd, CURLOPT_POSTFIELDS, req->data);
+    curl_easy_setopt (req->hnd, CURLOPT_POSTFIELDSIZE_LARGE, (curl_off_t)req->length);
+  }
+  curl_easy_setopt (req->hnd, CURLOPT_HTTPHEADER, req->hdrs);
+  curl_easy_setopt (req->hnd, CURLOPT_WRITEFUNCTION, async_write_cb);
+  curl_easy_setopt (req->hnd, CURLOPT_WRITEDATA, req);
+  curl_easy_setopt (req->hnd, CURLOPT_PRIVATE, req);
+  req->start = edgex_device_nanotime_monotonic ();
+  curl_multi_add_handle (client->multi, req->hnd);
+}
+
+static void async_complete (edgex_http_async_t *client, edgex_async_req *req, CURLcode rc)
+{
+  long http_code = 0;
+  edgex_error err = EDGEX_OK;
+
+  if (rc == CURLE_OK)
+  {
+    curl_easy_getinfo (req->hnd, CURLINFO_RESPONSE_CODE, &http_code);
+    if (http_code == 409)
+    {
+      err = EDGEX_HTTP_CONFLICT;
+    }
+    else if (http_code < 200 || http_code >= 300)
+    {
+      iot_log_debug (client->lc, "HTTP response: %ld", http_code);
+      err = EDGEX_HTTP_ERROR;
+    }
+  }
+  else
+  {
+    iot_log_error (client->lc, "Curl failed with code %d (%s)", rc, curl_easy_strerror (rc));
+    err = EDGEX_HTTP_ERROR;
+  }
+  edgex_timing_record (EDGEX_TIMING_HTTP_CLIENT, (edgex_device_nanotime_monotonic () - req->start) / 1000);
+  edgex_counter_inc (EDGEX_COUNTER_HTTP_REQUESTS);
+  if (err.code)
+  {
+    edgex_counter_inc (EDGEX_COUNTER_HTTP_ERRORS);
+  }
+
+  curl_multi_remove_handle (client->multi, req->hnd);
+  edgex_curl_release (req->hnd, req->url);
+  curl_slist_free_all (req->hdrs);
+
+  req->cb (req->ctx, &err, req->rsp, req->data, req->length);
+
+  free (req->rsp);
+  free (req->zbuf);
+  free (req->url);
+  free (req);
+}
+
+static void *async_thread (void *p)
+{
+  edgex_http_async_t *client = (edgex_http_async_t *)p;
+  int running = 0;
+
+  edgex_placement_apply (EDGEX_PLACEMENT_IO);
+
+  pthread_mutex_lock (&client->lock);
+  while (client->running || client->queued || client->inflight)
+  {
+    /* Start queued requests, up to the in-flight limit */
+
+    while (client->head && client->inflight < client->maxinflight)
+    {
+      edgex_async_req *req = client->head;
+      client->head = req->next;
+      if (client->head == NULL)
+      {
+        client->tail = NULL;
+      }
+      client->queued--;
+      client->inflight++;
+      async_start (client, req);
+    }
+    pthread_mutex_unlock (&client->lock);
+
+    curl_multi_perform (client->multi, &running);
+
+    CURLMsg *msg;
+    int remaining;
+    while ((msg = curl_multi_info_read (client->multi, &remaining)))
+    {
+      if (msg->msg == CURLMSG_DONE)
+      {
+        edgex_async_req *req;
+        CURLcode rc = msg->data.result;
+        curl_easy_getinfo (msg->easy_handle, CURLINFO_PRIVATE, (char **)&req);
+        async_complete (client, req, rc);
+        pthread_mutex_lock (&client->lock);
+        client->inflight--;
+        pthread_mutex_unlock (&client->lock);
+      }
+    }
+
+#ifdef USE_CURL_WAKEUP
+    curl_multi_poll (client->multi, NULL, 0, 1000, NULL);
+#else
+    curl_multi_wait (client->multi, NULL, 0, ASYNC_POLL_MS, NULL);
+#endif
+
+    pthread_mutex_lock (&client->lock);
+    if (client->queued == 0 && client->inflight == 0)
+    {
+      pthread_cond_broadcast (&client->idle);
+      if (client->running)
+      {
+        pthread_cond_wait (&client->idle, &client->lock);
+      }
+    }
+  }
+  pthread_mutex_unlock (&client->lock);
+  return NULL;
+}
+
+edgex_http_async_t *edgex_http_async_alloc
+  (iot_logger_t *lc, unsigned inflight, edgex_compression compress, size_t compressmin)
+{
+  edgex_http_async_t *client = calloc (1, sizeof (edgex_http_async_t));
+  client->lc = lc;
+  client->maxinflight = inflight ? inflight : 1;
+  client->compress = compress;
+  client->compressmin = compressmin;
+  client->multi = curl_multi_init ();
+  curl_multi_setopt (client->multi, CURLMOPT_MAX_TOTAL_CONNECTIONS, (long)client->maxinflight);
+  pthread_mutex_init (&client->lock, NULL);
+  pthread_cond_init (&client->idle, NULL);
+  client->running = true;
+  pthread_create (&client->thread, NULL, async_thread, client);
+  return client;
+}
+
+void edgex_http_async_post
+(
+  edgex_http_async_t *client,
+  const char *url,
+  const char *mime,
+  void *data,
+  size_t length,
+  edgex_http_async_callback cb,
+  void *ctx
+)
+{
+  char hdr[128];
+  const char *crlid = edgex_device_get_crlid ();
+  edgex_async_req *req = calloc (1, sizeof (edgex_async_req));
+
+  req->url = strdup (url);
+  req->data = data;
+  req->length = length;
+  req->cb = cb;
+  req->ctx = ctx;
+  snprintf (hdr, sizeof (hdr), "Content-Type: %s", mime);
+  req->hdrs = curl_slist_append (NULL, hdr);
+  if (client->compress && length >= client->compressmin)
+  {
+    req->zbuf = edgex_http_compress (client->compress, data, length, &req->zlen);
+    if (req->zbuf)
+    {
+      snprintf (hdr, sizeof (hdr), "Content-Encoding: %s", edgex_http_compression_name (client->compress));
+      req->hdrs = curl_slist_append (req->hdrs, hdr);
+    }
+  }
+  if (crlid)
+  {
+    snprintf (hdr, sizeof (hdr), "%s: %s", EDGEX_CRLID_HDR, crlid);
+    req->hdrs = curl_slist_append (req->hdrs, hdr);
+  }
+
+  pthread_mutex_lock (&client->lock);
+  if (client->tail)
+  {
+    client->tail->next = req;
+  }
+  else
+  {
+    client->head = req;
+  }
+  client->tail = req;
+  client->queued++;
+  pthread_cond_broadcast (&client->idle);
+  pthread_mutex_unlock (&client->lock);
+#ifdef USE_CURL_WAKEUP
+  curl_multi_wakeup (client->multi);
+#endif
+}
+
+unsigned edgex_http_async_pending (edgex_http_async_t *client)
+{
+  unsigned result;
+  pthread_mutex_lock (&client->lock);
+  result = client->queued + client->inflight;
+  pthread_mutex_unlock (&client->lock);
+  return result;
+}
+
+void edgex_http_async_free (edgex_http_async_t *client)
+{
+  if (client)
+  {
+    pthread_mutex_lock (&client->lock);
+    client->running = false;
+    pthread_cond_broadcast (&client->idle);
+    pthread_mutex_unlock (&client->lock);
+#ifdef USE_CURL_WAKEUP
+    curl_multi_wakeup (client->multi);
+#endif
+    pthread_join (client->thread, NULL);
+    curl_multi_cleanup (client->multi);
+    pthread_cond_destroy (&client->idle);
+    pthread_mutex_destroy (&client->lock);
+    free (client);
+  }
+}
@@ -0,0 +1,69 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#ifndef _EDGEX_DEVICE_REST_ASYNC_H_
+#define _EDGEX_DEVICE_REST_ASYNC_H_ 1
+
+#include "edgex/edgex-logging.h"
+#include "edgex/edgex-base.h"
+#include "edgex/error.h"
+#include "rest.h"
+
+/*
+ * Non-blocking HTTP POST engine. Requests are queued by the caller and
+ * performed by a single thread driving a curl multi handle, so that many
+ * requests may be in progress without occupying a thread each. A completion
+ * callback is invoked (on the engine's thread) when each request finishes.
+ * Handles come from the pool used by the synchronous client, so connections
+ * are reused across requests.
+ */
+
+typedef struct edgex_http_async_t edgex_http_async_t;
+
+/*
+ * Completion callback. err indicates whether the request succeeded (a 2xx
+ * response was received); response is the body returned by the server, if
+ * any. The callback is responsible for freeing the request data.
+ */
+
+typedef void (*edgex_http_async_callback) (void *ctx, const edgex_error *err, const char *response, void *data, size_t length);
+
+/*
+ * inflight: the maximum number of requests to have in progress at once.
+ * compress, compressmin: request bodies of at least compressmin bytes are compressed, as for edgex_http_post.
+ */
+
+edgex_http_async_t *edgex_http_async_alloc
+  (iot_logger_t *lc, unsigned inflight, edgex_compression compress, size_t compressmin);
+
+/*
+ * Queue a POST request. The data remains owned by the caller until the
+ * callback is invoked with it. The correlation id of the calling thread, if
+ * any, is sent with the request.
+ */
+
+void edgex_http_async_post
+(
+  edgex_http_async_t *client,
+  const char *url,
+  const char *mime,
+  void *data,
+  size_t length,
+  edgex_http_async_callback cb,
+  void *ctx
+);
+
+/* Number of requests queued or in progress */
+
+unsigned edgex_http_async_pending (edgex_http_async_t *client);
+
+/* Complete all outstanding requests, then stop the engine */
+
+void edgex_http_async_free (edgex_http_async_t *client);
+
+#endif
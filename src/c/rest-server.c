@@ -10,37 +10,271 @@
 #include "microhttpd.h"
 #include "correlation.h"
 #include "errorlist.h"
+#include "counters.h"
+#include "trace.h"
+#include "edgex-time.h"
+#include "memstats.h"
 
+#include <stdio.h>
+#include <inttypes.h>
 #include <string.h>
 #include <stdlib.h>
 #include <pthread.h>
-
-#define STR_BLK_SIZE 512
+#include <stdatomic.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#define ARENA_BLOCK_SIZE 1024
+#define ARENA_PRESIZE_MAX (1024 * 1024)
 #define EDGEX_DS_PREFIX "ds-"
 
+/* The owner of the reply being generated on this thread, if it is not to be freed */
+
+typedef struct reply_owner
+{
+  void (*release) (void *ctx);
+  void *ctx;
+  const char *data;
+  size_t size;
+} reply_owner;
+
+static _Thread_local reply_owner owner;
+
 typedef struct handler_list
 {
   const char *url;
   uint32_t methods;
   void *context;
   http_method_handler_fn handler;
+  edgex_admission_t *admission;
+  edgex_admission_key_fn keyfn;
   struct handler_list *next;
 } handler_list;
 
+/*
+ * Routes are compiled into a trie keyed on path segments. A node holds the
+ * handler for the path ending at it and/or the handler for paths below it
+ * (registered with a trailing slash). Tables are immutable once published:
+ * registration builds a new one and swaps it in atomically, so that requests
+ * are dispatched without locking. Superseded tables are kept until the
+ * server is destroyed, since a request may still be using one.
+ */
+
+typedef struct route_node
+{
+  const char *segment;
+  size_t seglen;
+  const handler_list *exact;
+  const handler_list *prefix;
+  struct route_node *children;
+  struct route_node *sibling;
+} route_node;
+
+typedef struct route_table
+{
+  const handler_list *handlers;
+  route_node *root;
+  struct route_table *prev;
+} route_table;
+
 struct edgex_rest_server
 {
   iot_logger_t *lc;
   struct MHD_Daemon *daemon;
+  struct MHD_Daemon *udsdaemon;
+  char *sockpath;
   handler_list *handlers;
+  _Atomic (route_table *) routes;
   pthread_mutex_t lock;
 };
 
+/*
+ * Per-request storage. The request body, normalized url and query string are
+ * allocated from an arena whose first block is allocated with the context and
+ * sized, when the request arrives, from the Content-Length, url and arguments.
+ * Usually the whole request is therefore held in a single allocation. Further
+ * blocks are added if the body is larger than announced (or is chunked).
+ */
+
+typedef struct arena_block
+{
+  struct arena_block *next;
+  size_t size;
+  size_t used;
+} arena_block;
+
 typedef struct http_context_s
 {
+  arena_block *blocks;
+  char *nurl;
+  char *querystr;
   char *m_data;
   size_t m_size;
+  size_t m_cap;
 } http_context_t;
 
+static void *arena_alloc (http_context_t *ctx, size_t size)
+{
+  arena_block *b = ctx->blocks;
+  size = (size + sizeof (void *) - 1) & ~(sizeof (void *) - 1);
+  if (b->used + size > b->size)
+  {
+    size_t bsize = size > ARENA_BLOCK_SIZE ? size : ARENA_BLOCK_SIZE;
+    b = malloc (sizeof (arena_block) + bsize);
+    edgex_memstats_alloc (EDGEX_MEM_RESTSERVER, sizeof (arena_block) + bsize);
+    b->size = bsize;
+    b->used = 0;
+    b->next = ctx->blocks;
+    ctx->blocks = b;
+  }
+  void *result = (char *)(b + 1) + b->used;
+  b->used += size;
+  return result;
+}
+
+static http_context_t *http_context_alloc (size_t size)
+{
+  http_context_t *ctx = malloc (sizeof (http_context_t) + sizeof (arena_block) + size);
+  edgex_memstats_alloc (EDGEX_MEM_RESTSERVER, sizeof (http_context_t) + sizeof (arena_block) + size);
+  memset (ctx, 0, sizeof (http_context_t));
+  ctx->blocks = (arena_block *)(ctx + 1);
+  ctx->blocks->next = NULL;
+  ctx->blocks->size = size;
+  ctx->blocks->used = 0;
+  return ctx;
+}
+
+static void http_context_free (http_context_t *ctx)
+{
+  arena_block *b = ctx->blocks;
+  while (b != (arena_block *)(ctx + 1))
+  {
+    arena_block *next = b->next;
+    edgex_memstats_free (EDGEX_MEM_RESTSERVER, sizeof (arena_block) + b->size);
+    free (b);
+    b = next;
+  }
+  edgex_memstats_free (EDGEX_MEM_RESTSERVER, sizeof (http_context_t) + sizeof (arena_block) + b->size);
+  free (ctx);
+}
+
+static void http_append_body (http_context_t *ctx, const char *data, size_t size)
+{
+  if (ctx->m_size + size > ctx->m_cap)
+  {
+    size_t cap = ctx->m_cap ? ctx->m_cap * 2 : ARENA_BLOCK_SIZE;
+    while (cap < ctx->m_size + size)
+    {
+      cap *= 2;
+    }
+    char *buf = arena_alloc (ctx, cap + 1);
+    if (ctx->m_size)
+    {
+      memcpy (buf, ctx->m_data, ctx->m_size);
+    }
+    ctx->m_data = buf;
+    ctx->m_cap = cap;
+  }
+  memcpy (ctx->m_data + ctx->m_size, data, size);
+  ctx->m_size += size;
+  ctx->m_data[ctx->m_size] = '\0';
+}
+
+static route_node *route_child (route_node *node, const char *seg, size_t len)
+{
+  route_node *child;
+  for (child = node->children; child; child = child->sibling)
+  {
+    if (child->seglen == len && strncmp (child->segment, seg, len) == 0)
+    {
+      break;
+    }
+  }
+  return child;
+}
+
+static void route_add (route_node *root, const handler_list *h)
+{
+  route_node *node = root;
+  const char *p = h->url;
+
+  /* Each segment follows a slash; a trailing slash makes this a prefix route */
+
+  while (*p == '/' && p[1])
+  {
+    const char *seg = p + 1;
+    size_t len = strcspn (seg, "/");
+    route_node *child = route_child (node, seg, len);
+    if (child == NULL)
+    {
+      child = calloc (1, sizeof (route_node));
+      child->segment = seg;
+      child->seglen = len;
+      child->sibling = node->children;
+      node->children = child;
+    }
+    node = child;
+    p = seg + len;
+  }
+
+  /* Where routes coincide, the one registered last takes precedence */
+
+  if (*p == '/')
+  {
+    if (node->prefix == NULL)
+    {
+      node->prefix = h;
+    }
+  }
+  else if (node->exact == NULL)
+  {
+    node->exact = h;
+  }
+}
+
+static void route_free (route_node *node)
+{
+  while (node)
+  {
+    route_node *next = node->sibling;
+    route_free (node->children);
+    free (node);
+    node = next;
+  }
+}
+
+/* Find the handler for a (normalized) url, preferring the longest match */
+
+static const handler_list *route_find (const route_table *rt, const char *url)
+{
+  const handler_list *result = NULL;
+  const route_node *node = rt->root;
+  const char *p = url;
+
+  while (*p == '/')
+  {
+    if (node->prefix)
+    {
+      result = node->prefix;
+    }
+    const char *seg = p + 1;
+    size_t len = strcspn (seg, "/");
+    node = route_child ((route_node *)node, seg, len);
+    if (node == NULL)
+    {
+      break;
+    }
+    p = seg + len;
+    if (*p == '\0' && node->exact)
+    {
+      result = node->exact;
+    }
+  }
+  return result;
+}
+
 static edgex_http_method method_from_string (const char *str)
 {
   if (strcmp (str, "GET") == 0)
@@ -56,11 +290,11 @@ static edgex_http_method method_from_string (const char *str)
   return UNKNOWN;
 }
 
-static char *normalizeUrl (const char *url)
+static char *normalizeUrl (http_context_t *ctx, const char *url)
 {
   /* Only deduplication of '/' is performed */
 
-  char *res = malloc (strlen (url) + 1);
+  char *res = arena_alloc (ctx, strlen (url) + 1);
   const char *upos = url;
   char *rpos = res;
   while (*upos)
@@ -77,11 +311,31 @@ static char *normalizeUrl (const char *url)
   return res;
 }
 
-typedef struct stringbuf
+/* Arguments other than those for the device service itself are passed to handlers */
+
+static int queryLength (void *p, enum MHD_ValueKind kind, const char *key, const char *value)
+{
+  if (strncmp (key, EDGEX_DS_PREFIX, strlen (EDGEX_DS_PREFIX)) != 0)
+  {
+    *(size_t *)p += strlen (key) + (value ? 1 + strlen (value) : 0) + 1;
+  }
+  return MHD_YES;
+}
+
+/* The query string is assembled into a buffer sized by queryLength, tracking its length as it grows */
+
+typedef struct querybuf
 {
   char *str;
-  size_t size;
-} stringbuf;
+  size_t len;
+} querybuf;
+
+static void querybuf_append (querybuf *buf, const char *str)
+{
+  size_t len = strlen (str);
+  memcpy (buf->str + buf->len, str, len);
+  buf->len += len;
+}
 
 static int queryIterator (void *p, enum MHD_ValueKind kind, const char *key, const char *value)
 {
@@ -90,39 +344,80 @@ static int queryIterator (void *p, enum MHD_ValueKind kind, const char *key, con
     return MHD_YES;
   }
 
-  stringbuf *buf = (stringbuf *)p;
-
-  size_t newsz = (buf->str ? strlen (buf->str) + 1 : 0) + strlen (key) + (value ? 1 + strlen (value) : 0) + 1;
-
-  size_t newalloc = buf->size;
-  while (newalloc <= newsz)
+  querybuf *buf = (querybuf *)p;
+  if (buf->len)
   {
-    newalloc += STR_BLK_SIZE;
+    buf->str[buf->len++] = '&';
   }
-  if (newalloc > buf->size)
+  querybuf_append (buf, key);
+  if (value)
   {
-    buf->str = realloc (buf->str, newalloc);
-    if (buf->size == 0)
-    {
-      *buf->str = '\0';
-    }
-    buf->size = newalloc;
+    buf->str[buf->len++] = '=';
+    querybuf_append (buf, value);
   }
+  return MHD_YES;
+}
 
-  if (*buf->str)
-  {
-    strcat (buf->str, "&");
-  }
-  strcat (buf->str, key);
-  if (value)
+/* The admission key for a request: the part of its url below the handler's, without the last segment */
+
+static const char *admission_key (http_context_t *ctx, const handler_list *h, const char *path)
+{
+  const char *end = strrchr (path, '/');
+  size_t len = end ? end - path : 0;
+  char *key = arena_alloc (ctx, len + 1);
+  memcpy (key, path, len);
+  key[len] = '\0';
+  if (h->keyfn)
   {
-    strcat (buf->str, "=");
-    strcat (buf->str, value);
+    char *mapped = h->keyfn (h->context, key);
+    if (mapped)
+    {
+      len = strlen (mapped);
+      key = arena_alloc (ctx, len + 1);
+      memcpy (key, mapped, len + 1);
+      free (mapped);
+    }
   }
+  return key;
+}
 
-  return MHD_YES;
+#if MHD_VERSION >= 0x00097302
+
+static struct MHD_Response *reply_owned_response (void *reply, size_t size)
+{
+  return MHD_create_response_from_buffer_with_free_callback_cls (size, reply, owner.release, owner.ctx);
 }
 
+#else
+
+/* Without free callbacks for buffers, an owned reply is read from a copy of its owner */
+
+static ssize_t reply_owned_read (void *cls, uint64_t pos, char *buf, size_t max)
+{
+  reply_owner *o = (reply_owner *)cls;
+  size_t n = (o->size - pos < max) ? o->size - pos : max;
+  memcpy (buf, o->data + pos, n);
+  return n;
+}
+
+static void reply_owned_free (void *cls)
+{
+  reply_owner *o = (reply_owner *)cls;
+  o->release (o->ctx);
+  free (o);
+}
+
+static struct MHD_Response *reply_owned_response (void *reply, size_t size)
+{
+  reply_owner *o = malloc (sizeof (reply_owner));
+  *o = owner;
+  o->data = reply;
+  o->size = size;
+  return MHD_create_response_from_callback (size, 4096, reply_owned_read, o, reply_owned_free);
+}
+
+#endif
+
 static int http_handler
 (
   void *this,
@@ -142,15 +437,44 @@ static int http_handler
   void *reply = NULL;
   size_t reply_size = 0;
   const char *reply_type = NULL;
-  handler_list *h;
+  uint32_t retryafter = 0;
+  const handler_list *h;
+  const route_table *rt = atomic_load (&svr->routes);
 
   /* First call used to create call context */
 
   if (ctx == 0)
   {
-    ctx = (http_context_t *) malloc (sizeof (*ctx));
-    ctx->m_size = 0;
-    ctx->m_data = NULL;
+    size_t clen = 0;
+    size_t qlen = 0;
+    const char *clenstr = MHD_lookup_connection_value (conn, MHD_HEADER_KIND, MHD_HTTP_HEADER_CONTENT_LENGTH);
+    if (clenstr)
+    {
+      clen = strtoul (clenstr, NULL, 10);
+      if (clen > ARENA_PRESIZE_MAX)
+      {
+        clen = ARENA_PRESIZE_MAX;
+      }
+    }
+    MHD_get_connection_values (conn, MHD_GET_ARGUMENT_KIND, queryLength, &qlen);
+
+    /* Allow for the rounding of each of the three allocations */
+
+    ctx = http_context_alloc (strlen (url) + qlen + clen + 3 * sizeof (void *) + 2);
+    ctx->nurl = normalizeUrl (ctx, url);
+    if (qlen)
+    {
+      querybuf qbuf = { arena_alloc (ctx, qlen), 0 };
+      MHD_get_connection_values (conn, MHD_GET_ARGUMENT_KIND, queryIterator, &qbuf);
+      qbuf.str[qbuf.len] = '\0';
+      ctx->querystr = qbuf.str;
+    }
+    if (clen)
+    {
+      ctx->m_data = arena_alloc (ctx, clen + 1);
+      ctx->m_cap = clen;
+      *ctx->m_data = '\0';
+    }
     *context = (void *) ctx;
     return MHD_YES;
   }
@@ -159,10 +483,7 @@ static int http_handler
 
   if (*upload_data_size)
   {
-    ctx->m_data = (char *) realloc
-      (ctx->m_data, ctx->m_size + (*upload_data_size) + 1);
-    memcpy (ctx->m_data + ctx->m_size, upload_data, (*upload_data_size) + 1);
-    ctx->m_size += *upload_data_size;
+    http_append_body (ctx, upload_data, *upload_data_size);
     *upload_data_size = 0;
     return MHD_YES;
   }
@@ -170,8 +491,11 @@ static int http_handler
 
   /* Last call with no data handles request */
 
+  uint64_t start = edgex_device_nanotime_monotonic ();
+  uint64_t tstart;
   edgex_device_alloc_crlid
     (MHD_lookup_connection_value (conn, MHD_HEADER_KIND, EDGEX_CRLID_HDR));
+  edgex_trace_begin ();
 
   edgex_http_method method = method_from_string (methodname);
 
@@ -181,20 +505,18 @@ static int http_handler
     {
       /* List available handlers */
       reply_size = 0;
-      pthread_mutex_lock (&svr->lock);
-      for (h = svr->handlers; h; h = h->next)
+      for (h = rt->handlers; h; h = h->next)
       {
         reply_size += strlen (h->url) + 1;
       }
       char *buff = malloc (reply_size + 1);
       buff[0] = '\0';
-      for (h = svr->handlers; h; h = h->next)
+      for (h = rt->handlers; h; h = h->next)
       {
         strcat (buff, h->url);
         strcat (buff, "\n");
       }
       reply = buff;
-      pthread_mutex_unlock (&svr->lock);
     }
     else
     {
@@ -204,32 +526,30 @@ static int http_handler
   else
   {
     status = MHD_HTTP_NOT_FOUND;
-    char *nurl = normalizeUrl (url);
-    pthread_mutex_lock (&svr->lock);
-    for (h = svr->handlers; h; h = h->next)
+    h = route_find (rt, ctx->nurl);
+    if (h)
     {
-      if
-      (
-        (h->url[strlen (h->url) - 1] == '/') ?
-        (strncmp (nurl, h->url, strlen (h->url)) == 0) :
-        (strcmp (nurl, h->url) == 0)
-      )
+      const char *key = "";
+      if (h->admission && (method & h->methods))
       {
-        break;
+        key = admission_key (ctx, h, ctx->nurl + strlen (h->url));
+        if (!edgex_admission_enter (h->admission, key))
+        {
+          status = MHD_HTTP_SERVICE_UNAVAILABLE;
+          retryafter = edgex_admission_retryafter (h->admission);
+          reply = strdup ("Too many requests in progress\n");
+          reply_size = strlen (reply);
+          edgex_counter_inc (EDGEX_COUNTER_REQUESTS_SHED);
+        }
       }
-    }
-    pthread_mutex_unlock (&svr->lock);
-    if (h)
-    {
-      if (method & h->methods)
+      if (retryafter == 0 && (method & h->methods))
       {
-        stringbuf qbuf = { NULL, 0 };
-        MHD_get_connection_values (conn, MHD_GET_ARGUMENT_KIND, queryIterator, &qbuf);
+        owner.release = NULL;
         status = h->handler
         (
           h->context,
-          nurl + strlen (h->url),
-          qbuf.str,
+          ctx->nurl + strlen (h->url),
+          ctx->querystr,
           method,
           ctx->m_data,
           ctx->m_size,
@@ -237,78 +557,216 @@ static int http_handler
           &reply_size,
           &reply_type
         );
-        free (qbuf.str);
+        if (h->admission)
+        {
+          edgex_admission_leave (h->admission, key);
+        }
       }
-      else
+      else if (retryafter == 0)
       {
         status = MHD_HTTP_METHOD_NOT_ALLOWED;
       }
     }
-    free (nurl);
   }
 
   /* Send reply */
 
+  tstart = edgex_trace_start ();
   if (reply_type == NULL)
   {
     reply_type = "text/plain";
   }
+  if (owner.release && reply == NULL)
+  {
+    owner.release (owner.ctx);
+    owner.release = NULL;
+  }
   if (reply == NULL)
   {
     reply = strdup ("");
     reply_size = 0;
   }
-  response = MHD_create_response_from_buffer (reply_size, reply, MHD_RESPMEM_MUST_FREE);
+  if (owner.release)
+  {
+    response = reply_owned_response (reply, reply_size);
+    owner.release = NULL;
+  }
+  else
+  {
+    response = MHD_create_response_from_buffer (reply_size, reply, MHD_RESPMEM_MUST_FREE);
+  }
   MHD_add_response_header (response, "Content-Type", reply_type);
+  if (retryafter)
+  {
+    char secs[16];
+    snprintf (secs, sizeof (secs), "%" PRIu32, retryafter);
+    MHD_add_response_header (response, MHD_HTTP_HEADER_RETRY_AFTER, secs);
+  }
   MHD_queue_response (conn, status, response);
   MHD_destroy_response (response);
+  if (tstart)
+  {
+    char name[128];
+    snprintf (name, sizeof (name), "%s %s", methodname, url);
+    edgex_trace_span (EDGEX_TRACE_RESPONSE, tstart);
+    edgex_trace_end (EDGEX_TRACE_REQUEST, name);
+  }
+  else
+  {
+    edgex_trace_end (EDGEX_TRACE_REQUEST, "");
+  }
+  edgex_counter_inc (EDGEX_COUNTER_REQUESTS);
+  if (status >= MHD_HTTP_BAD_REQUEST)
+  {
+    edgex_counter_inc (EDGEX_COUNTER_REQUEST_ERRORS);
+  }
+  edgex_timing_record (EDGEX_TIMING_REQUEST, (edgex_device_nanotime_monotonic () - start) / 1000);
 
   /* Clean up */
 
-  if (ctx->m_data)
-  { free (ctx->m_data); }
-  free (ctx);
+  http_context_free (ctx);
   edgex_device_free_crlid ();
   return MHD_YES;
 }
 
+void edgex_rest_server_reply_owned (void (*release) (void *ctx), void *ctx)
+{
+  owner.release = release;
+  owner.ctx = ctx;
+}
+
+/* Create a listening socket bound to the given path, replacing any existing socket there */
+
+static int unix_listen (iot_logger_t *lc, const char *path)
+{
+  int fd;
+  struct sockaddr_un addr;
+
+  if (strlen (path) >= sizeof (addr.sun_path))
+  {
+    iot_log_error (lc, "Unix socket path %s is too long", path);
+    return -1;
+  }
+  memset (&addr, 0, sizeof (addr));
+  addr.sun_family = AF_UNIX;
+  strcpy (addr.sun_path, path);
+
+  fd = socket (AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0)
+  {
+    iot_log_error (lc, "Unable to create unix socket: %s", strerror (errno));
+    return -1;
+  }
+  unlink (path);
+  if (bind (fd, (struct sockaddr *)&addr, sizeof (addr)) != 0 || listen (fd, SOMAXCONN) != 0)
+  {
+    iot_log_error (lc, "Unable to listen on unix socket %s: %s", path, strerror (errno));
+    close (fd);
+    return -1;
+  }
+  return fd;
+}
+
 edgex_rest_server *edgex_rest_server_create
-  (iot_logger_t *lc, uint16_t port, edgex_error *err)
+(
+  iot_logger_t *lc,
+  uint16_t port,
+  const char *sockpath,
+  uint32_t threads,
+  uint32_t maxconns,
+  uint32_t timeout,
+  edgex_error *err
+)
 {
   edgex_rest_server *svr;
-  uint16_t flags = MHD_USE_THREAD_PER_CONNECTION;
+  unsigned int flags = MHD_USE_THREAD_PER_CONNECTION;
+  struct MHD_OptionItem opts[5];
+  int nopts = 0;
   /* config: flags |= MHD_USE_IPv6 ? */
 
+  if (threads)
+  {
+    flags = MHD_USE_AUTO_INTERNAL_THREAD;
+    opts[nopts++] = (struct MHD_OptionItem) { MHD_OPTION_THREAD_POOL_SIZE, threads, NULL };
+  }
+  if (maxconns)
+  {
+    opts[nopts++] = (struct MHD_OptionItem) { MHD_OPTION_CONNECTION_LIMIT, maxconns, NULL };
+  }
+  if (timeout)
+  {
+    opts[nopts++] = (struct MHD_OptionItem) { MHD_OPTION_CONNECTION_TIMEOUT, timeout, NULL };
+  }
+  opts[nopts] = (struct MHD_OptionItem) { MHD_OPTION_END, 0, NULL };
+
   svr = malloc (sizeof (edgex_rest_server));
   svr->lc = lc;
+  svr->daemon = NULL;
+  svr->udsdaemon = NULL;
+  svr->sockpath = NULL;
   svr->handlers = NULL;
+  route_table *rt = calloc (1, sizeof (route_table));
+  rt->root = calloc (1, sizeof (route_node));
+  atomic_init (&svr->routes, rt);
   pthread_mutex_init (&svr->lock, NULL);
 
-  /* Start http server */
+  /* Start http server, on TCP unless only a unix socket is required */
 
-  iot_log_debug (lc, "Starting HTTP server on port %d", port);
-  svr->daemon =
-    MHD_start_daemon (flags, port, 0, 0, http_handler, svr, MHD_OPTION_END);
-  if (svr->daemon == NULL)
+  if (port || sockpath == NULL)
   {
-    *err = EDGEX_HTTP_SERVER_FAIL;
-    iot_log_debug (lc, "MHD_start_daemon failed");
-    edgex_rest_server_destroy (svr);
-    return NULL;
+    if (threads)
+    {
+      iot_log_debug (lc, "Starting HTTP server on port %d with %u threads", port, threads);
+    }
+    else
+    {
+      iot_log_debug (lc, "Starting HTTP server on port %d", port);
+    }
+    svr->daemon = MHD_start_daemon
+      (flags, port, 0, 0, http_handler, svr, MHD_OPTION_ARRAY, opts, MHD_OPTION_END);
+    if (svr->daemon == NULL)
+    {
+      *err = EDGEX_HTTP_SERVER_FAIL;
+      iot_log_debug (lc, "MHD_start_daemon failed");
+      edgex_rest_server_destroy (svr);
+      return NULL;
+    }
   }
-  else
+
+  if (sockpath)
   {
-    return svr;
+    int fd = unix_listen (lc, sockpath);
+    if (fd >= 0)
+    {
+      svr->sockpath = strdup (sockpath);
+      iot_log_debug (lc, "Starting HTTP server on unix socket %s", sockpath);
+      svr->udsdaemon = MHD_start_daemon
+        (flags, 0, 0, 0, http_handler, svr, MHD_OPTION_ARRAY, opts, MHD_OPTION_LISTEN_SOCKET, fd, MHD_OPTION_END);
+      if (svr->udsdaemon == NULL)
+      {
+        close (fd);
+      }
+    }
+    if (svr->udsdaemon == NULL)
+    {
+      *err = EDGEX_HTTP_SERVER_FAIL;
+      iot_log_error (lc, "Unable to start HTTP server on unix socket %s", sockpath);
+      edgex_rest_server_destroy (svr);
+      return NULL;
+    }
   }
+  return svr;
 }
 
-void edgex_rest_server_register_handler
+static void register_entry
 (
   edgex_rest_server *svr,
   const char *url,
   uint32_t methods,
   void *context,
-  http_method_handler_fn handler
+  http_method_handler_fn handler,
+  edgex_admission_t *admission,
+  edgex_admission_key_fn keyfn
 )
 {
   handler_list *entry = malloc (sizeof (handler_list));
@@ -316,12 +774,50 @@ void edgex_rest_server_register_handler
   entry->url = url;
   entry->methods = methods;
   entry->context = context;
+  entry->admission = admission;
+  entry->keyfn = keyfn;
   pthread_mutex_lock (&svr->lock);
   entry->next = svr->handlers;
   svr->handlers = entry;
+
+  route_table *rt = calloc (1, sizeof (route_table));
+  rt->handlers = svr->handlers;
+  rt->root = calloc (1, sizeof (route_node));
+  for (const handler_list *h = rt->handlers; h; h = h->next)
+  {
+    route_add (rt->root, h);
+  }
+  rt->prev = atomic_load (&svr->routes);
+  atomic_store (&svr->routes, rt);
   pthread_mutex_unlock (&svr->lock);
 }
 
+void edgex_rest_server_register_handler
+(
+  edgex_rest_server *svr,
+  const char *url,
+  uint32_t methods,
+  void *context,
+  http_method_handler_fn handler
+)
+{
+  register_entry (svr, url, methods, context, handler, NULL, NULL);
+}
+
+void edgex_rest_server_register_admitted_handler
+(
+  edgex_rest_server *svr,
+  const char *url,
+  edgex_http_method methods,
+  void *context,
+  http_method_handler_fn handler,
+  edgex_admission_t *admission,
+  edgex_admission_key_fn keyfn
+)
+{
+  register_entry (svr, url, methods, context, handler, admission, keyfn);
+}
+
 void edgex_rest_server_destroy (edgex_rest_server *svr)
 {
   handler_list *tmp;
@@ -329,6 +825,23 @@ void edgex_rest_server_destroy (edgex_rest_server *svr)
   {
     MHD_stop_daemon (svr->daemon);
   }
+  if (svr->udsdaemon)
+  {
+    MHD_stop_daemon (svr->udsdaemon);
+  }
+  if (svr->sockpath)
+  {
+    unlink (svr->sockpath);
+    free (svr->sockpath);
+  }
+  route_table *rt = atomic_load (&svr->routes);
+  while (rt)
+  {
+    route_table *prev = rt->prev;
+    route_free (rt->root);
+    free (rt);
+    rt = prev;
+  }
   while (svr->handlers)
   {
     tmp = svr->handlers->next;
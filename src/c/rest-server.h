@@ -12,6 +12,7 @@
 #include "edgex/edgex.h"
 #include "edgex/edgex-logging.h"
 #include "edgex/error.h"
+#include "admission.h"
 
 struct edgex_rest_server;
 typedef struct edgex_rest_server edgex_rest_server;
@@ -39,8 +40,26 @@ typedef int (*http_method_handler_fn)
   const char **reply_type
 );
 
+/*
+ * sockpath: if set, the server also listens on a unix domain socket at this
+ * path. If port is zero, it listens only there.
+ * threads: if zero, a thread is used for each connection. Otherwise
+ * connections are multiplexed (using epoll where available) over a pool of
+ * this many threads.
+ * maxconns: the maximum number of concurrent connections, 0 for no limit.
+ * timeout: idle connections are closed after this many seconds, 0 for never.
+ */
+
 extern edgex_rest_server *edgex_rest_server_create
-  (iot_logger_t *lc, uint16_t port, edgex_error *err);
+(
+  iot_logger_t *lc,
+  uint16_t port,
+  const char *sockpath,
+  uint32_t threads,
+  uint32_t maxconns,
+  uint32_t timeout,
+  edgex_error *err
+);
 
 extern void edgex_rest_server_register_handler
 (
@@ -51,6 +70,41 @@ extern void edgex_rest_server_register_handler
   http_method_handler_fn handler
 );
 
+/*
+ * Maps the admission key for a request to the one under which it is admitted,
+ * so that different urls for the same object share a limit. Returns a
+ * replacement, which the server frees, or NULL to use the key as it is.
+ */
+
+typedef char *(*edgex_admission_key_fn) (void *context, const char *key);
+
+/*
+ * As edgex_rest_server_register_handler, for a handler whose requests are
+ * subject to admission control. The key for a request is the part of the url
+ * following the handler's, less its last segment, as mapped by keyfn if that
+ * is set. Requests which are not admitted are refused with 503 and a
+ * Retry-After header.
+ */
+
+extern void edgex_rest_server_register_admitted_handler
+(
+  edgex_rest_server *svr,
+  const char *url,
+  edgex_http_method method,
+  void *context,
+  http_method_handler_fn handler,
+  edgex_admission_t *admission,
+  edgex_admission_key_fn keyfn
+);
+
+/*
+ * Called by a handler whose reply belongs to another object rather than
+ * having been allocated for the server to free. The server passes ctx to the
+ * release function once the reply has been sent, instead of freeing it.
+ */
+
+extern void edgex_rest_server_reply_owned (void (*release) (void *ctx), void *ctx);
+
 extern void edgex_rest_server_destroy (edgex_rest_server *svr);
 
 #endif
@@ -24,9 +24,17 @@ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
 #include <stdlib.h>
 #include <stdint.h>
 #include <string.h>
+#include <strings.h>
+#include <pthread.h>
+#include <zlib.h>
 #include "errorlist.h"
 #include "correlation.h"
 #include "rest.h"
+#include "map.h"
+#include "counters.h"
+#include "trace.h"
+#include "edgex-time.h"
+#include "memstats.h"
 
 #if (LIBCURL_VERSION_NUM >= 0x073800)
 #define USE_CURL_MIME
@@ -35,6 +43,294 @@ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
 #define MAX_TOKEN_LEN 600
 #define EDGEX_AUTH_HDR "Authorization: Bearer "
 
+/* Maximum number of idle handles retained for each endpoint */
+#define EDGEX_CURL_MAX_IDLE 8
+
+/*
+ * Pool of curl easy handles. Handles are reused (and so retain their open
+ * connections) for requests to the same endpoint, ie scheme, host and port.
+ * DNS, TLS session and connection caches are shared between all handles.
+ */
+
+typedef struct edgex_curl_idle
+{
+  CURL *hnd;
+  struct edgex_curl_idle *next;
+} edgex_curl_idle;
+
+typedef struct edgex_curl_endpoint
+{
+  edgex_curl_idle *idle;
+  unsigned count;
+} edgex_curl_endpoint;
+
+typedef edgex_map(edgex_curl_endpoint) edgex_map_curl_endpoint;
+
+typedef struct edgex_curl_pool
+{
+  edgex_map_curl_endpoint endpoints;
+  edgex_map_string sockets;
+  CURLSH *share;
+  pthread_mutex_t sharelocks[CURL_LOCK_DATA_LAST];
+} edgex_curl_pool;
+
+static edgex_curl_pool *pool = NULL;
+static pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void edgex_share_lock (CURL *hnd, curl_lock_data data, curl_lock_access access, void *p)
+{
+  pthread_mutex_lock (&((edgex_curl_pool *)p)->sharelocks[data]);
+}
+
+static void edgex_share_unlock (CURL *hnd, curl_lock_data data, void *p)
+{
+  pthread_mutex_unlock (&((edgex_curl_pool *)p)->sharelocks[data]);
+}
+
+/* Create the pool. Called with pool_lock held */
+
+static void edgex_curl_pool_init (void)
+{
+  pool = malloc (sizeof (edgex_curl_pool));
+  edgex_map_init (&pool->endpoints);
+  edgex_map_init (&pool->sockets);
+  for (int i = 0; i < CURL_LOCK_DATA_LAST; i++)
+  {
+    pthread_mutex_init (&pool->sharelocks[i], NULL);
+  }
+  pool->share = curl_share_init ();
+  curl_share_setopt (pool->share, CURLSHOPT_LOCKFUNC, edgex_share_lock);
+  curl_share_setopt (pool->share, CURLSHOPT_UNLOCKFUNC, edgex_share_unlock);
+  curl_share_setopt (pool->share, CURLSHOPT_USERDATA, pool);
+  curl_share_setopt (pool->share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+  curl_share_setopt (pool->share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+#if (LIBCURL_VERSION_NUM >= 0x073900)
+  curl_share_setopt (pool->share, CURLSHOPT_SHARE, CURL_LOCK_DATA_CONNECT);
+#endif
+}
+
+/* Extract the endpoint (scheme://host:port) part of a URL */
+
+static char *edgex_url_endpoint (const char *url)
+{
+  const char *start = strstr (url, "://");
+  const char *end = strchr (start ? start + 3 : url, '/');
+  return end ? strndup (url, end - url) : strdup (url);
+}
+
+/* Obtain a handle for the given URL, reusing an idle one for the same endpoint if available */
+
+CURL *edgex_curl_acquire (const char *url)
+{
+  CURL *hnd = NULL;
+  CURLSH *share;
+  edgex_curl_endpoint *ep;
+  char *key = edgex_url_endpoint (url);
+
+  pthread_mutex_lock (&pool_lock);
+  if (pool == NULL)
+  {
+    edgex_curl_pool_init ();
+  }
+  share = pool->share;
+  ep = edgex_map_get (&pool->endpoints, key);
+  if (ep && ep->idle)
+  {
+    edgex_curl_idle *i = ep->idle;
+    ep->idle = i->next;
+    ep->count--;
+    hnd = i->hnd;
+    free (i);
+  }
+  if (hnd == NULL)
+  {
+    hnd = curl_easy_init ();
+  }
+
+  /* Curl copies the socket path, so it may be set while the lock is held */
+
+  char **path = edgex_map_get (&pool->sockets, key);
+  if (path)
+  {
+    curl_easy_setopt (hnd, CURLOPT_UNIX_SOCKET_PATH, *path);
+  }
+  pthread_mutex_unlock (&pool_lock);
+  free (key);
+
+  curl_easy_setopt (hnd, CURLOPT_SHARE, share);
+  curl_easy_setopt (hnd, CURLOPT_NOSIGNAL, 1L);
+  return hnd;
+}
+
+/* Return a handle to the pool. Options are reset but cached connections are kept */
+
+void edgex_curl_release (CURL *hnd, const char *url)
+{
+  edgex_curl_endpoint *ep;
+  char *key = edgex_url_endpoint (url);
+
+  curl_easy_reset (hnd);
+  pthread_mutex_lock (&pool_lock);
+  ep = pool ? edgex_map_get (&pool->endpoints, key) : NULL;
+  if (pool && ep == NULL)
+  {
+    edgex_curl_endpoint newep = { .idle = NULL, .count = 0 };
+    edgex_map_set (&pool->endpoints, key, newep);
+    ep = edgex_map_get (&pool->endpoints, key);
+  }
+  if (ep && ep->count < EDGEX_CURL_MAX_IDLE)
+  {
+    edgex_curl_idle *i = malloc (sizeof (edgex_curl_idle));
+    i->hnd = hnd;
+    i->next = ep->idle;
+    ep->idle = i;
+    ep->count++;
+    hnd = NULL;
+  }
+  pthread_mutex_unlock (&pool_lock);
+  free (key);
+
+  if (hnd)
+  {
+    curl_easy_cleanup (hnd);
+  }
+}
+
+void edgex_http_set_unix_socket (const char *host, uint16_t port, const char *path)
+{
+  char key[URL_BUF_SIZE];
+  char **existing;
+
+  snprintf (key, URL_BUF_SIZE, "http://%s:%u", host, port);
+  pthread_mutex_lock (&pool_lock);
+  if (pool == NULL)
+  {
+    edgex_curl_pool_init ();
+  }
+  existing = edgex_map_get (&pool->sockets, key);
+  if (existing)
+  {
+    free (*existing);
+    edgex_map_remove (&pool->sockets, key);
+  }
+  if (path)
+  {
+    edgex_map_set (&pool->sockets, key, strdup (path));
+  }
+  pthread_mutex_unlock (&pool_lock);
+}
+
+char *edgex_http_unix_socket (const char *url)
+{
+  char *result = NULL;
+  char *key = edgex_url_endpoint (url);
+
+  pthread_mutex_lock (&pool_lock);
+  if (pool)
+  {
+    char **path = edgex_map_get (&pool->sockets, key);
+    if (path)
+    {
+      result = strdup (*path);
+    }
+  }
+  pthread_mutex_unlock (&pool_lock);
+  free (key);
+  return result;
+}
+
+void edgex_http_fini (void)
+{
+  pthread_mutex_lock (&pool_lock);
+  if (pool)
+  {
+    const char *key;
+    edgex_map_iter iter = edgex_map_iter (pool->endpoints);
+    while ((key = edgex_map_next (&pool->endpoints, &iter)))
+    {
+      edgex_curl_endpoint *ep = edgex_map_get (&pool->endpoints, key);
+      while (ep->idle)
+      {
+        edgex_curl_idle *i = ep->idle;
+        ep->idle = i->next;
+        curl_easy_cleanup (i->hnd);
+        free (i);
+      }
+    }
+    edgex_map_deinit (&pool->endpoints);
+    iter = edgex_map_iter (pool->sockets);
+    while ((key = edgex_map_next (&pool->sockets, &iter)))
+    {
+      free (*edgex_map_get (&pool->sockets, key));
+    }
+    edgex_map_deinit (&pool->sockets);
+    curl_share_cleanup (pool->share);
+    for (int i = 0; i < CURL_LOCK_DATA_LAST; i++)
+    {
+      pthread_mutex_destroy (&pool->sharelocks[i]);
+    }
+    free (pool);
+    pool = NULL;
+  }
+  pthread_mutex_unlock (&pool_lock);
+}
+
+static const char *compression_names[] = { NULL, "gzip", "deflate" };
+
+bool edgex_http_compression_parse (const char *name, edgex_compression *result)
+{
+  if (name == NULL || *name == '\0' || strcasecmp (name, "none") == 0)
+  {
+    *result = EDGEX_COMPRESS_NONE;
+    return true;
+  }
+  for (int i = EDGEX_COMPRESS_GZIP; i <= EDGEX_COMPRESS_DEFLATE; i++)
+  {
+    if (strcasecmp (name, compression_names[i]) == 0)
+    {
+      *result = i;
+      return true;
+    }
+  }
+  return false;
+}
+
+const char *edgex_http_compression_name (edgex_compression method)
+{
+  return compression_names[method];
+}
+
+void *edgex_http_compress (edgex_compression method, const void *data, size_t length, size_t *result_length)
+{
+  z_stream zs;
+  unsigned char *result;
+  uLong bound;
+
+  memset (&zs, 0, sizeof (zs));
+  /* windowBits of 15 gives a zlib stream (HTTP "deflate"); adding 16 gives a gzip stream */
+  if (deflateInit2 (&zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED, method == EDGEX_COMPRESS_GZIP ? 31 : 15, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+  {
+    return NULL;
+  }
+  bound = deflateBound (&zs, length);
+  result = malloc (bound);
+  zs.next_in = (Bytef *)data;
+  zs.avail_in = length;
+  zs.next_out = result;
+  zs.avail_out = bound;
+  if (deflate (&zs, Z_FINISH) != Z_STREAM_END || zs.total_out >= length)
+  {
+    free (result);
+    result = NULL;
+  }
+  else
+  {
+    *result_length = zs.total_out;
+  }
+  deflateEnd (&zs);
+  return result;
+}
+
 /* Add a request header to the list */
 
 static struct curl_slist *edgex_add_hdr (struct curl_slist *slist, const char *name, const char *value)
@@ -91,7 +387,7 @@ static size_t edgex_check_rsp_hdr (char *buffer, size_t size, size_t nitems, voi
   for (edgex_nvpairs *i = (edgex_nvpairs *)v; i; i = i->next)
   {
     int len = strlen (i->name);
-    if ((end - buffer > len) && (strncmp (buffer, i->name, len) == 0) && (buffer[len] == ':'))
+    if ((end - buffer > len) && (strncasecmp (buffer, i->name, len) == 0) && (buffer[len] == ':'))
     {
       char *start = buffer + len + 1;
       while (start < end && *start == ' ') start++;
@@ -124,7 +420,7 @@ static void edgex_log_peer_cert (iot_logger_t *lc, edgex_ctx *ctx, CURL *hnd)
   }
 }
 
-/* Append a chunk of returned data to the buffer */
+/* Append a chunk of returned data to the buffer. It is accounted until the request completes, when the caller takes it */
 
 size_t edgex_http_write_cb (void *contents, size_t size, size_t nmemb, void *userp)
 {
@@ -134,6 +430,7 @@ size_t edgex_http_write_cb (void *contents, size_t size, size_t nmemb, void *use
   memcpy (&(ctx->buff[ctx->size]), contents, size);
   ctx->size += size;
   ctx->buff[ctx->size] = 0;
+  edgex_memstats_alloc (EDGEX_MEM_HTTPCLIENT, size);
 
   return size;
 }
@@ -173,6 +470,7 @@ static long edgex_run_curl
   struct curl_slist *slist;
   CURLcode rc;
   long http_code = 0;
+  uint64_t start;
 
   /* Init buffer */
   ctx->buff = NULL;
@@ -242,7 +540,15 @@ static long edgex_run_curl
   }
 
   /* Make the call */
+  start = edgex_device_nanotime_monotonic ();
+  uint64_t tstart = edgex_trace_start ();
   rc = curl_easy_perform (hnd);
+  edgex_trace_span (EDGEX_TRACE_HTTP, tstart);
+  edgex_timing_record (EDGEX_TIMING_HTTP_CLIENT, (edgex_device_nanotime_monotonic () - start) / 1000);
+  if (writefunc == (void *)edgex_http_write_cb)
+  {
+    edgex_memstats_free (EDGEX_MEM_HTTPCLIENT, ctx->size);
+  }
 
   if (rc == CURLE_OK)
   {
@@ -260,8 +566,10 @@ static long edgex_run_curl
       iot_log_debug (lc, "HTTP response 409 - Conflict");
       *err = EDGEX_HTTP_CONFLICT;
     }
-    else if (http_code < 200 || http_code >= 300)
+    else if ((http_code < 200 || http_code >= 300) && http_code != 304)
     {
+      /* 304 (Not Modified) is only returned to conditional requests, whose callers check for it */
+
       iot_log_debug (lc, "HTTP response: %ld", http_code);
       *err = EDGEX_HTTP_ERROR;
     }
@@ -280,52 +588,173 @@ static long edgex_run_curl
     iot_log_error (lc, "Curl failed with code %d (%s)", rc, curl_easy_strerror (rc));
     *err = EDGEX_HTTP_ERROR;
   }
+  edgex_counter_inc (EDGEX_COUNTER_HTTP_REQUESTS);
+  if (err->code)
+  {
+    edgex_counter_inc (EDGEX_COUNTER_HTTP_ERRORS);
+  }
 
-  curl_easy_cleanup (hnd);
+  edgex_curl_release (hnd, url);
   curl_slist_free_all (slist);
   return http_code;
 }
 
 long edgex_http_get (iot_logger_t *lc, edgex_ctx *ctx, const char *url, void *writefunc, edgex_error *err)
 {
-  CURL *hnd = curl_easy_init ();
+  CURL *hnd = edgex_curl_acquire (url);
   return edgex_run_curl (lc, ctx, hnd, url, writefunc, NULL, err);
 }
 
 long edgex_http_delete (iot_logger_t *lc, edgex_ctx *ctx, const char *url, void *writefunc, edgex_error *err)
 {
-  CURL *hnd = curl_easy_init ();
+  CURL *hnd = edgex_curl_acquire (url);
   curl_easy_setopt (hnd, CURLOPT_CUSTOMREQUEST, "DELETE");
 
   return edgex_run_curl (lc, ctx, hnd, url, writefunc, NULL, err);
 }
 
-long edgex_http_post
-  (iot_logger_t *lc, edgex_ctx *ctx, const char *url, const char *data, void *writefunc, edgex_error *err)
+/* Set the body of a POST request, compressing it if required. Returns the buffer to free afterwards */
+
+static void *edgex_set_postbody
+  (iot_logger_t *lc, edgex_ctx *ctx, CURL *hnd, const void *data, size_t length, struct curl_slist **slist)
 {
-  struct curl_slist *slist;
-  CURL *hnd = curl_easy_init ();
+  void *zbuf = NULL;
+  size_t zlen = 0;
+
+  if (ctx->compress && length >= ctx->compressmin)
+  {
+    zbuf = edgex_http_compress (ctx->compress, data, length, &zlen);
+  }
+  if (zbuf)
+  {
+    iot_log_trace (lc, "Compressed request body from %zu to %zu bytes", length, zlen);
+    data = zbuf;
+    length = zlen;
+    *slist = edgex_add_hdr (*slist, "Content-Encoding", edgex_http_compression_name (ctx->compress));
+  }
 
   curl_easy_setopt (hnd, CURLOPT_CUSTOMREQUEST, "POST");
   curl_easy_setopt (hnd, CURLOPT_POST, 1L);
   curl_easy_setopt (hnd, CURLOPT_POSTFIELDS, data);
+  curl_easy_setopt (hnd, CURLOPT_POSTFIELDSIZE_LARGE, (curl_off_t)length);
+  return zbuf;
+}
 
-  slist = edgex_add_hdr (NULL, "Content-Type", "application/json");
-  return edgex_run_curl (lc, ctx, hnd, url, writefunc, slist, err);
+long edgex_http_post
+  (iot_logger_t *lc, edgex_ctx *ctx, const char *url, const char *data, void *writefunc, edgex_error *err)
+{
+  long result;
+  void *zbuf;
+  CURL *hnd = edgex_curl_acquire (url);
+  struct curl_slist *slist = edgex_add_hdr (NULL, "Content-Type", "application/json");
+
+  zbuf = edgex_set_postbody (lc, ctx, hnd, data, strlen (data), &slist);
+  result = edgex_run_curl (lc, ctx, hnd, url, writefunc, slist, err);
+  free (zbuf);
+  return result;
 }
 
 long edgex_http_postbin
   (iot_logger_t *lc, edgex_ctx *ctx, const char *url, void *data, size_t length, const char *mime, void *writefunc, edgex_error *err)
 {
-  struct curl_slist *slist;
-  CURL *hnd = curl_easy_init ();
+  long result;
+  void *zbuf;
+  CURL *hnd = edgex_curl_acquire (url);
+  struct curl_slist *slist = edgex_add_hdr (NULL, "Content-Type", mime);
+
+  zbuf = edgex_set_postbody (lc, ctx, hnd, data, length, &slist);
+  result = edgex_run_curl (lc, ctx, hnd, url, writefunc, slist, err);
+  free (zbuf);
+  return result;
+}
+
+struct segment_data
+{
+  const edgex_http_segment *segs;
+  unsigned nsegs;
+  unsigned current;
+  size_t offset;
+};
+
+static size_t segment_read_callback (char *buffer, size_t size, size_t nitems, void *userdata)
+{
+  struct segment_data *sd = (struct segment_data *) userdata;
+  size_t max_size = size * nitems;
+  size_t transferred = 0;
+
+  while (transferred < max_size && sd->current < sd->nsegs)
+  {
+    const edgex_http_segment *seg = &sd->segs[sd->current];
+    size_t n = seg->length - sd->offset;
+    if (n > max_size - transferred)
+    {
+      n = max_size - transferred;
+    }
+    memcpy (buffer + transferred, (const char *)seg->data + sd->offset, n);
+    transferred += n;
+    sd->offset += n;
+    if (sd->offset == seg->length)
+    {
+      sd->current++;
+      sd->offset = 0;
+    }
+  }
+
+  return transferred;
+}
+
+/* Curl rewinds the body to resend it, eg. on a redirect or after authentication */
+
+static int segment_seek_callback (void *userdata, curl_off_t offset, int origin)
+{
+  struct segment_data *sd = (struct segment_data *) userdata;
 
+  if (origin != SEEK_SET || offset < 0)
+  {
+    return CURL_SEEKFUNC_CANTSEEK;
+  }
+  sd->current = 0;
+  sd->offset = 0;
+  while (sd->current < sd->nsegs && (size_t)offset >= sd->segs[sd->current].length)
+  {
+    offset -= sd->segs[sd->current++].length;
+  }
+  if (sd->current == sd->nsegs && offset)
+  {
+    return CURL_SEEKFUNC_FAIL;
+  }
+  sd->offset = offset;
+  return CURL_SEEKFUNC_OK;
+}
+
+long edgex_http_postsegments
+(
+  iot_logger_t *lc,
+  edgex_ctx *ctx,
+  const char *url,
+  const edgex_http_segment *segs,
+  unsigned nsegs,
+  const char *mime,
+  void *writefunc,
+  edgex_error *err
+)
+{
+  struct segment_data sd = { .segs = segs, .nsegs = nsegs, .current = 0, .offset = 0 };
+  curl_off_t length = 0;
+  CURL *hnd = edgex_curl_acquire (url);
+  struct curl_slist *slist = edgex_add_hdr (NULL, "Content-Type", mime);
+
+  for (unsigned i = 0; i < nsegs; i++)
+  {
+    length += segs[i].length;
+  }
   curl_easy_setopt (hnd, CURLOPT_CUSTOMREQUEST, "POST");
   curl_easy_setopt (hnd, CURLOPT_POST, 1L);
-  curl_easy_setopt (hnd, CURLOPT_POSTFIELDS, data);
-  curl_easy_setopt (hnd, CURLOPT_POSTFIELDSIZE_LARGE, (curl_off_t)length);
-
-  slist = edgex_add_hdr (NULL, "Content-Type", mime);
+  curl_easy_setopt (hnd, CURLOPT_READFUNCTION, segment_read_callback);
+  curl_easy_setopt (hnd, CURLOPT_READDATA, &sd);
+  curl_easy_setopt (hnd, CURLOPT_SEEKFUNCTION, segment_seek_callback);
+  curl_easy_setopt (hnd, CURLOPT_SEEKDATA, &sd);
+  curl_easy_setopt (hnd, CURLOPT_POSTFIELDSIZE_LARGE, length);
   return edgex_run_curl (lc, ctx, hnd, url, writefunc, slist, err);
 }
 
@@ -342,7 +771,7 @@ long edgex_http_postfile
   struct curl_httppost *lastptr = NULL;
 #endif
 
-  hnd = curl_easy_init ();
+  hnd = edgex_curl_acquire (url);
 
 #ifdef USE_CURL_MIME
   form = curl_mime_init (hnd);
@@ -402,7 +831,7 @@ long edgex_http_put
 {
   struct curl_slist *slist;
   struct put_data cb_data;
-  CURL *hnd = curl_easy_init ();
+  CURL *hnd = edgex_curl_acquire (url);
 
   curl_easy_setopt(hnd, CURLOPT_UPLOAD, 1L);
 
@@ -13,6 +13,12 @@
 #include "edgex/edgex-base.h"
 #include "edgex/error.h"
 
+/* Content-Encoding which may be applied to POST bodies */
+
+typedef enum { EDGEX_COMPRESS_NONE, EDGEX_COMPRESS_GZIP, EDGEX_COMPRESS_DEFLATE } edgex_compression;
+
+#define EDGEX_COMPRESS_DEFAULT_THRESHOLD 256
+
 typedef struct edgex_ctx
 {
   char *cacerts_file;     // Location of CA certificates Curl will use to verify peer
@@ -25,6 +31,8 @@ typedef struct edgex_ctx
   atomic_bool *aborter;   // if non-null, can kill a request by setting to true
   char *buff;             // data returned from the request
   size_t size;            // current buffer size
+  edgex_compression compress; // encoding to apply to POST bodies
+  size_t compressmin;     // POST bodies smaller than this are sent uncompressed
 } edgex_ctx;
 
 #define URL_BUF_SIZE 512
@@ -35,6 +43,47 @@ typedef struct edgex_ctx
  */
 size_t edgex_http_write_cb (void *contents, size_t size, size_t nmemb, void *userp);
 
+/*
+ * Requests are made using handles taken from a process-wide pool, so that connections to each endpoint
+ * are kept alive and reused. DNS, TLS session and connection caches are shared between handles.
+ * edgex_http_fini releases the pool and any open connections.
+ */
+
+void edgex_http_fini (void);
+
+/*
+ * Take a handle (a CURL *) for a request to url from the pool, and return it
+ * once the request is complete. Handles are set up to use the shared caches
+ * and any Unix domain socket configured for the endpoint.
+ */
+
+void *edgex_curl_acquire (const char *url);
+
+void edgex_curl_release (void *hnd, const char *url);
+
+/*
+ * Requests to http://host:port are made over the Unix domain socket at path
+ * (or over TCP again if path is NULL). edgex_http_unix_socket returns a copy
+ * of the path configured for the endpoint of a URL, or NULL if there is none.
+ */
+
+void edgex_http_set_unix_socket (const char *host, uint16_t port, const char *path);
+
+char *edgex_http_unix_socket (const char *url);
+
+/*
+ * Bodies sent by edgex_http_post and edgex_http_postbin are compressed if ctx->compress is set and the
+ * body is at least ctx->compressmin bytes long. A Content-Encoding header is added to such requests.
+ * edgex_http_compress returns a newly allocated buffer containing the compressed data, or NULL if
+ * compression failed or would not reduce the size of the data.
+ */
+
+bool edgex_http_compression_parse (const char *name, edgex_compression *result);
+
+const char *edgex_http_compression_name (edgex_compression method);
+
+void *edgex_http_compress (edgex_compression method, const void *data, size_t length, size_t *result_length);
+
 /*
  * These functions use libcurl to send http get/post/put/delete requests.
  * TLS peer verification is enabled, but not HTTP authentication.
@@ -71,4 +120,28 @@ long edgex_http_postfile
 long edgex_http_put
   (iot_logger_t *lc, edgex_ctx *ctx, const char *url, const char *data, void *writefunc, edgex_error *err);
 
+/*
+ * Post a body made up of the given segments in order, without copying them into one buffer. The body
+ * is read from the segments as it is sent, with its total length given as the Content-Length. Such
+ * bodies are not compressed.
+ */
+
+typedef struct edgex_http_segment
+{
+  const void *data;
+  size_t length;
+} edgex_http_segment;
+
+long edgex_http_postsegments
+(
+  iot_logger_t *lc,
+  edgex_ctx *ctx,
+  const char *url,
+  const edgex_http_segment *segs,
+  unsigned nsegs,
+  const char *mime,
+  void *writefunc,
+  edgex_error *err
+);
+
 #endif
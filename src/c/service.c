@@ -33,17 +33,18 @@
 #define EDGEX_DEV_API_VERSION "/api/version"
 #define EDGEX_DEV_API_DISCOVERY "/api/v1/discovery"
 #define EDGEX_DEV_API_DEVICE "/api/v1/device/"
+#define EDGEX_DEV_API_BATCH "/api/v1/batch"
 #define EDGEX_DEV_API_CALLBACK "/api/v1/callback"
 #define EDGEX_DEV_API_CONFIG "/api/v1/config"
 #define EDGEX_DEV_API_METRICS "/api/v1/metrics"
+#define EDGEX_DEV_API_OPENMETRICS "/api/v1/metrics/prometheus"
+#define EDGEX_DEV_API_READY "/api/v1/ready"
 
+/* Size of the general thread pool, which also runs AutoEvents and posts unless they are given pools of their own */
 #define POOL_THREADS 8
 
-typedef struct postparams
-{
-  edgex_device_service *svc;
-  edgex_event_cooked *event;
-} postparams;
+/* Number of devices parsed from metadata before each insertion into the device map */
+#define DEVICE_LOAD_PAGE 256
 
 void edgex_device_service_usage ()
 {
@@ -174,8 +175,10 @@ edgex_device_service *edgex_device_service_new
   result->logger = iot_logger_alloc_custom (name, IOT_LOG_TRACE, "-", edgex_log_tofile, NULL);
   iot_logger_start (result->logger);
   result->thpool = iot_threadpool_alloc (POOL_THREADS, 0, NULL, result->logger);
-  result->scheduler = iot_scheduler_alloc (result->thpool, result->logger);
+  edgex_pool_register (result->thpool, "General", POOL_THREADS);
   pthread_mutex_init (&result->discolock, NULL);
+  pthread_mutex_init (&result->reconcilelock, NULL);
+  atomic_init (&result->stopping, false);
   return result;
 }
 
@@ -199,6 +202,31 @@ static int ping_handler
   return MHD_HTTP_OK;
 }
 
+/* Report the progress of startup, with status 503 until it has completed */
+
+static int ready_handler
+(
+  void *ctx,
+  char *url,
+  char *querystr,
+  edgex_http_method method,
+  const char *upload_data,
+  size_t upload_data_size,
+  void **reply,
+  size_t *reply_size,
+  const char **reply_type
+)
+{
+  edgex_device_service *svc = (edgex_device_service *) ctx;
+  JSON_Value *val = edgex_startup_status (svc->startup);
+  bool ready = json_object_get_boolean (json_value_get_object (val), "Ready") == 1;
+  *reply = json_serialize_to_string (val);
+  *reply_size = strlen (*reply);
+  *reply_type = "application/json";
+  json_value_free (val);
+  return ready ? MHD_HTTP_OK : MHD_HTTP_SERVICE_UNAVAILABLE;
+}
+
 static int version_handler
 (
   void *ctx,
@@ -262,39 +290,8 @@ static bool ping_client
   return false;
 }
 
-static void startConfigured (edgex_device_service *svc, toml_table_t *config, edgex_error *err)
+static void register_service (edgex_device_service *svc, const char *myhost, edgex_error *err)
 {
-  char *myhost;
-  struct utsname buffer;
-
-  if (svc->config.service.host)
-  {
-    myhost = svc->config.service.host;
-  }
-  else
-  {
-    uname (&buffer);
-    myhost = buffer.nodename;
-  }
-
-  svc->adminstate = UNLOCKED;
-  svc->opstate = ENABLED;
-
-  /* Wait for metadata and data to be available */
-
-  if (!ping_client (svc->logger, "core-data", &svc->config.endpoints.data, svc->config.service.connectretries, svc->config.service.timeout, err))
-  {
-    return;
-  }
-  if (!ping_client (svc->logger, "core-metadata", &svc->config.endpoints.metadata, svc->config.service.connectretries, svc->config.service.timeout, err))
-  {
-    return;
-  }
-
-  *err = EDGEX_OK;
-
-  /* Register device service in metadata */
-
   edgex_deviceservice *ds;
   ds = edgex_metadata_client_get_deviceservice
     (svc->logger, &svc->config.endpoints, svc->name, err);
@@ -376,37 +373,246 @@ static void startConfigured (edgex_device_service *svc, toml_table_t *config, ed
     }
   }
   edgex_deviceservice_free (ds);
+}
 
-  /* Load DeviceProfiles from files and register in metadata */
+static bool ping_services (edgex_device_service *svc, edgex_error *err)
+{
+  return
+    ping_client (svc->logger, "core-data", &svc->config.endpoints.data, svc->config.service.connectretries, svc->config.service.timeout, err) &&
+    ping_client (svc->logger, "core-metadata", &svc->config.endpoints.metadata, svc->config.service.connectretries, svc->config.service.timeout, err);
+}
 
-  edgex_device_profiles_upload (svc, err);
-  if (err->code)
+static void populate_devices (void *ctx, edgex_device *devs)
+{
+  edgex_device_service *svc = (edgex_device_service *)ctx;
+  edgex_devmap_populate_devices (svc->devices, devs);
+  edgex_device_free (devs);
+}
+
+/* Add the profiles and devices from the snapshot file to the map, if there is one */
+
+static bool load_snapshot (edgex_device_service *svc)
+{
+  edgex_deviceprofile *profiles;
+  edgex_device *devices;
+
+  if
+  (
+    svc->config.device.snapshotfile == NULL ||
+    !edgex_snapshot_load (svc->logger, svc->config.device.snapshotfile, &profiles, &devices)
+  )
   {
-    return;
+    return false;
+  }
+  while (profiles)
+  {
+    edgex_deviceprofile *dp = profiles;
+    profiles = dp->next;
+    dp->next = NULL;
+    edgex_devmap_add_profile (svc->devices, dp);
   }
+  iot_log_info (svc->logger, "Starting with devices from snapshot %s", svc->config.device.snapshotfile);
+  populate_devices (svc, devices);
+  return true;
+}
 
-  /* Obtain Devices from metadata */
+/* Collects the pages of devices from metadata into a single list */
 
-  edgex_device *devs = edgex_metadata_client_get_devices
-    (svc->logger, &svc->config.endpoints, svc->name, err);
+static void collect_devices (void *ctx, edgex_device *devs)
+{
+  edgex_device **list = (edgex_device **)ctx;
+  edgex_device *last = devs;
+  if (devs)
+  {
+    while (last->next)
+    {
+      last = last->next;
+    }
+    last->next = *list;
+    *list = devs;
+  }
+}
 
-  if (err->code)
+/* Bring the map into line with the devices held by metadata, informing the implementation of changes */
+
+static void reconcile_devices (edgex_device_service *svc, const edgex_device *devs)
+{
+  edgex_device **current = edgex_devmap_devices (svc->devices);
+  edgex_devmap_outcome_t *outcomes;
+  edgex_map_char ids;
+  const char **removed;
+  bool *gone;
+  unsigned ndevs = 0;
+  unsigned nremoved = 0;
+  unsigned n = 0;
+
+  for (const edgex_device *d = devs; d; d = d->next)
   {
-    iot_log_error (svc->logger, "Unable to retrieve device list from metadata");
-    return;
+    ndevs++;
   }
+  edgex_map_init (&ids);
+  edgex_map_reserve (&ids, ndevs);
+  outcomes = malloc ((ndevs + 1) * sizeof (edgex_devmap_outcome_t));
+  edgex_devmap_replace_devices (svc->devices, devs, outcomes);
+  for (const edgex_device *d = devs; d; d = d->next)
+  {
+    edgex_map_set (&ids, d->id, 1);
+    switch (outcomes[n++])
+    {
+      case CREATED:
+        if (svc->addcallback)
+        {
+          svc->addcallback (svc->userdata, d->name, d->protocols, d->adminState);
+        }
+        break;
+      case UPDATED_DRIVER:
+        if (svc->updatecallback)
+        {
+          svc->updatecallback (svc->userdata, d->name, d->protocols, d->adminState);
+        }
+        break;
+      case UPDATED_SDK:
+        break;
+    }
+  }
+  free (outcomes);
 
-  edgex_devmap_populate_devices (svc->devices, devs);
-  edgex_device_free (devs);
+  /* The devices no longer in metadata are removed together, then the implementation informed */
+
+  for (n = 0; current[n]; n++);
+  removed = malloc ((n + 1) * sizeof (char *));
+  gone = calloc (n + 1, sizeof (bool));
+  for (unsigned i = 0; current[i]; i++)
+  {
+    if (edgex_map_get (&ids, current[i]->id) == NULL)
+    {
+      iot_log_info (svc->logger, "Device %s is no longer in metadata", current[i]->name);
+      removed[nremoved++] = current[i]->id;
+      gone[i] = true;
+    }
+  }
+  edgex_devmap_removedevices_byid (svc->devices, removed, nremoved);
+  for (unsigned i = 0; current[i]; i++)
+  {
+    if (gone[i] && svc->removecallback)
+    {
+      svc->removecallback (svc->userdata, current[i]->name, current[i]->protocols);
+    }
+    edgex_device_release (current[i]);
+  }
+  edgex_map_deinit (&ids);
+  free (gone);
+  free (removed);
+  free (current);
+}
 
-  /* Start REST server now so that we get the callbacks on device addition */
+typedef struct reconcile_job
+{
+  edgex_device_service *svc;
+  char *host;
+} reconcile_job;
 
-  svc->daemon = edgex_rest_server_create
-    (svc->logger, svc->config.service.port, err);
+/*
+ * After a start from a snapshot, perform the steps skipped at startup:
+ * register with metadata, upload profiles, and update the map from the
+ * device list. If metadata cannot be reached the snapshot remains in use.
+ */
+
+static void reconcile_metadata (void *p)
+{
+  reconcile_job *job = (reconcile_job *)p;
+  edgex_device_service *svc = job->svc;
+  edgex_device *devs = NULL;
+  edgex_error err = EDGEX_OK;
+
+  pthread_mutex_lock (&svc->reconcilelock);
+  if (!atomic_load (&svc->stopping) && ping_services (svc, &err))
+  {
+    err = EDGEX_OK;
+    register_service (svc, job->host, &err);
+    if (err.code == 0 && !atomic_load (&svc->stopping))
+    {
+      edgex_device_profiles_upload (svc, &err);
+    }
+    if (err.code == 0 && !atomic_load (&svc->stopping))
+    {
+      edgex_metadata_client_load_devices
+        (svc->logger, &svc->config.endpoints, svc->name, DEVICE_LOAD_PAGE, collect_devices, &devs, &err);
+      if (err.code == 0 && !atomic_load (&svc->stopping))
+      {
+        reconcile_devices (svc, devs);
+        edgex_snapshot_save (svc->logger, svc->config.device.snapshotfile, svc->devices);
+        iot_log_info (svc->logger, "Devices reconciled with metadata");
+      }
+      edgex_device_free (devs);
+    }
+  }
+  if (err.code)
+  {
+    iot_log_error (svc->logger, "Unable to reconcile with metadata, continuing with snapshot: %s", err.reason);
+  }
+  pthread_mutex_unlock (&svc->reconcilelock);
+  free (job->host);
+  free (job);
+}
+
+/* Stages of startup. Registration, profile upload and the device fetch run in parallel */
+
+typedef struct startup_args
+{
+  edgex_device_service *svc;
+  const char *host;
+  toml_table_t *config;
+} startup_args;
+
+static void startup_ping (void *p, edgex_error *err)
+{
+  startup_args *args = (startup_args *)p;
+  if (ping_services (args->svc, err))
+  {
+    *err = EDGEX_OK;
+  }
+}
+
+static void startup_register (void *p, edgex_error *err)
+{
+  startup_args *args = (startup_args *)p;
+  register_service (args->svc, args->host, err);
+}
+
+static void startup_profiles (void *p, edgex_error *err)
+{
+  startup_args *args = (startup_args *)p;
+  edgex_device_profiles_upload (args->svc, err);
+}
+
+/* Obtain Devices from metadata, adding them to the map as they arrive */
+
+static void startup_devices (void *p, edgex_error *err)
+{
+  edgex_device_service *svc = ((startup_args *)p)->svc;
+
+  edgex_metadata_client_load_devices
+    (svc->logger, &svc->config.endpoints, svc->name, DEVICE_LOAD_PAGE, populate_devices, svc, err);
   if (err->code)
   {
+    iot_log_error (svc->logger, "Unable to retrieve device list from metadata");
     return;
   }
+  if (svc->config.device.snapshotfile)
+  {
+    edgex_snapshot_save (svc->logger, svc->config.device.snapshotfile, svc->devices);
+  }
+}
+
+/* Add Devices and provision watchers from configuration, once those in metadata are known */
+
+static void startup_configured (void *p, edgex_error *err)
+{
+  startup_args *args = (startup_args *)p;
+  edgex_device_service *svc = args->svc;
+
+  /* Callbacks on device addition are accepted from now on */
 
   edgex_rest_server_register_handler
   (
@@ -414,48 +620,298 @@ static void startConfigured (edgex_device_service *svc, toml_table_t *config, ed
     edgex_device_handler_callback
   );
 
-  /* Add Devices from configuration */
-
-  if (config)
+  if (args->config)
   {
     edgex_device_process_configured_devices
-      (svc, toml_array_in (config, "DeviceList"), err);
+      (svc, toml_array_in (args->config, "DeviceList"), err);
+    if (err->code)
+    {
+      return;
+    }
+    edgex_device_process_configured_watchers
+      (svc, toml_array_in (args->config, "Watchers"), err);
     if (err->code)
     {
       return;
     }
   }
 
-  /* Driver configuration */
+  /* Compile provision watchers for discovered devices */
 
-  if (!svc->userfns.init (svc->userdata, svc->logger, svc->config.driverconf))
+  if (edgex_map_size (&svc->config.watchers))
+  {
+    svc->watchlist = edgex_watchlist_alloc (svc->logger, &svc->config.watchers, err);
+    if (err->code)
+    {
+      return;
+    }
+    iot_log_info (svc->logger, "Compiled %u provision watchers", edgex_watchlist_size (svc->watchlist));
+  }
+}
+
+/* Requests for a device by name are admitted under its id, so that a device has one limit however it is addressed */
+
+static char *device_admission_key (void *ctx, const char *key)
+{
+  char *result = NULL;
+  edgex_device_service *svc = (edgex_device_service *) ctx;
+
+  if (strncmp (key, "name/", 5) == 0)
+  {
+    edgex_device *dev = edgex_devmap_device_byname (svc->devices, key + 5);
+    if (dev)
+    {
+      result = strdup (dev->id);
+      edgex_device_release (dev);
+    }
+  }
+  return result;
+}
+
+static void startConfigured (edgex_device_service *svc, toml_table_t *config, edgex_error *err)
+{
+  char *myhost;
+  struct utsname buffer;
+  bool warm;
+  edgex_placement_saved placed;
+  startup_args args;
+  uint32_t deps = 0;
+
+  if (svc->config.service.host)
+  {
+    myhost = svc->config.service.host;
+  }
+  else
+  {
+    uname (&buffer);
+    myhost = buffer.nodename;
+  }
+
+  svc->adminstate = UNLOCKED;
+  svc->opstate = ENABLED;
+
+  /*
+   * If a snapshot of the devices is available, serve them at once and
+   * contact metadata in the background once the service has started
+   */
+
+  warm = load_snapshot (svc);
+  svc->startup = edgex_startup_alloc (svc->logger);
+
+  /* Open the store-and-forward queue if configured */
+
+  if (svc->config.device.sffile)
+  {
+    svc->storefwd = edgex_storefwd_alloc
+    (
+      svc,
+      svc->config.device.sffile,
+      (uint64_t)(svc->config.device.sfsize ? svc->config.device.sfsize : EDGEX_SF_DEFAULT_SIZE) * 1024,
+      svc->config.device.sfretention,
+      svc->config.device.sfretry ? svc->config.device.sfretry : EDGEX_SF_DEFAULT_RETRY,
+      err
+    );
+    if (err->code)
+    {
+      return;
+    }
+  }
+
+  /* Create the shared-memory event ring if configured */
+
+  if (svc->config.eventring.name && *svc->config.eventring.name)
+  {
+    svc->eventring = edgex_eventring_alloc
+      (svc->logger, svc->config.eventring.name, svc->config.eventring.size, svc->config.eventring.format, err);
+    if (err->code)
+    {
+      return;
+    }
+    iot_log_info (svc->logger, "Writing events to shared memory ring %s", edgex_eventring_name (svc->eventring));
+  }
+
+  /* Start the MQTT publisher if configured. Events are then published rather than posted to core-data */
+
+  if (svc->config.mqtt.broker && *svc->config.mqtt.broker)
+  {
+    svc->mqtt = edgex_mqtt_alloc (svc->logger, svc->name, &svc->config.mqtt, err);
+    if (err->code)
+    {
+      return;
+    }
+    iot_log_info (svc->logger, "Publishing events to MQTT broker %s", svc->config.mqtt.broker);
+  }
+
+  /* Start the asynchronous event poster if configured */
+
+  if (svc->mqtt == NULL && svc->config.device.asyncpostlimit)
+  {
+    svc->asyncpost = edgex_http_async_alloc
+    (
+      svc->logger,
+      svc->config.device.asyncpostlimit,
+      svc->config.device.compression,
+      svc->config.device.compressthreshold
+    );
+  }
+
+  /* Start the event batching stage if configured */
+
+  if (svc->mqtt == NULL && svc->config.device.eventbatchsize > 1)
+  {
+    svc->batch = edgex_batch_alloc
+    (
+      svc,
+      svc->config.device.eventbatchsize,
+      svc->config.device.eventbatchlinger ? svc->config.device.eventbatchlinger : EDGEX_BATCH_DEFAULT_LINGER,
+      svc->config.device.compactbatches
+    );
+  }
+
+  /* Events generated by AutoEvents within the same window are submitted together */
+
+  if (svc->mqtt == NULL && svc->config.device.aewindow)
+  {
+    svc->aebatch = edgex_batch_alloc
+    (
+      svc,
+      svc->config.device.eventbatchsize > 1 ? svc->config.device.eventbatchsize : EDGEX_BATCH_DEFAULT_SIZE,
+      svc->config.device.aewindow,
+      svc->config.device.compactbatches
+    );
+  }
+
+  /* Create the ingestion queue for asynchronous readings */
+
+  svc->postq = edgex_postq_alloc
+    (svc, svc->config.device.postqdepth, svc->config.device.postqpolicy, err);
+  if (err->code)
   {
-    *err = EDGEX_DRIVER_UNSTART;
-    iot_log_error (svc->logger, "Protocol driver initialization failed");
     return;
   }
 
-  /* Start scheduled events */
+  /* Create the pool for running commands on all devices in parallel */
 
-  iot_scheduler_start (svc->scheduler);
+  if (svc->config.device.allcmdconcurrency > 1 || svc->config.device.allcmdtimeout)
+  {
+    uint32_t threads = svc->config.device.allcmdconcurrency ? svc->config.device.allcmdconcurrency : 1;
+    svc->cmdpool = iot_threadpool_alloc (threads, 0, NULL, svc->logger);
+    edgex_pool_register (svc->cmdpool, "Command", threads);
+    iot_threadpool_start (svc->cmdpool);
+    iot_log_info
+      (svc->logger, "Commands for all devices: concurrency %u, timeout %ums", threads, svc->config.device.allcmdtimeout);
+  }
 
-  /* Register REST handlers */
+  /*
+   * Create separate pools for AutoEvents and posted readings if configured,
+   * so that they are not held up by other work such as discovery
+   */
 
-  edgex_rest_server_register_handler
+  svc->aepool = svc->thpool;
+  if (svc->config.device.aethreads)
+  {
+    svc->aepool = iot_threadpool_alloc (svc->config.device.aethreads, 0, NULL, svc->logger);
+    edgex_pool_register (svc->aepool, "AutoEvent", svc->config.device.aethreads);
+    iot_threadpool_start (svc->aepool);
+    iot_log_info (svc->logger, "AutoEvents run on %u threads", svc->config.device.aethreads);
+  }
+  svc->postpool = svc->thpool;
+  if (svc->config.device.postthreads)
+  {
+    svc->postpool = iot_threadpool_alloc (svc->config.device.postthreads, 0, NULL, svc->logger);
+    edgex_pool_register (svc->postpool, "Post", svc->config.device.postthreads);
+    iot_threadpool_start (svc->postpool);
+    iot_log_info (svc->logger, "Posted readings are submitted on %u threads", svc->config.device.postthreads);
+  }
+
+  svc->readcache = edgex_readcache_alloc ();
+  if (svc->config.device.coalescereads)
+  {
+    svc->inflight = edgex_inflight_alloc ();
+  }
+  if (svc->config.device.serializecalls)
+  {
+    svc->devqueue = edgex_devqueue_alloc (svc->config.device.drivermaxwait);
+    iot_log_info (svc->logger, "Driver calls are serialized per device");
+  }
+  if (svc->config.device.driverconcurrency)
+  {
+    svc->qos = edgex_qos_alloc (svc->config.device.driverconcurrency, svc->config.device.drivermaxwait);
+    iot_log_info
+    (
+      svc->logger, "Driver calls: up to %u at once, by priority; callers waiting over %ums are promoted",
+      svc->config.device.driverconcurrency, svc->config.device.drivermaxwait
+    );
+  }
+  if (svc->config.device.latencymetrics)
+  {
+    svc->latency = edgex_latency_alloc ();
+  }
+  edgex_device_timesource_set (svc->config.device.timesource);
+  if (svc->config.device.aetick)
+  {
+    svc->aewheel = edgex_timerwheel_alloc (svc->aepool, svc->config.device.aetick);
+    iot_log_info (svc->logger, "AutoEvents scheduled with a %ums tick", svc->config.device.aetick);
+  }
+  else
+  {
+    svc->scheduler = iot_scheduler_alloc (svc->aepool, svc->logger);
+  }
+  if (svc->config.device.aebackoff)
+  {
+    svc->aecircuit = edgex_circuit_alloc (svc->logger, svc->config.device.aebackoff, svc->config.device.aefaillimit);
+    iot_log_info
+    (
+      svc->logger, "AutoEvents back off on failure: up to %ums, probing after %u failures",
+      svc->config.device.aebackoff, svc->config.device.aefaillimit
+    );
+  }
+  svc->opqueue = edgex_opstate_alloc (svc, EDGEX_OPSTATE_RETRY);
+  if (svc->config.service.maxcommands || svc->config.service.maxdevicecommands)
+  {
+    svc->admission = edgex_admission_alloc
+      (svc->config.service.maxcommands, svc->config.service.maxdevicecommands, svc->config.service.commandqueuetime);
+    iot_log_info
+    (
+      svc->logger, "Command requests: up to %u at once, %u per device, queued for up to %ums",
+      svc->config.service.maxcommands, svc->config.service.maxdevicecommands, svc->config.service.commandqueuetime
+    );
+  }
+
+  /*
+   * Start the REST server before contacting the core services, so that
+   * progress can be reported. Handlers which act on devices are registered
+   * once the devices are known.
+   */
+
+  edgex_placement_enter (EDGEX_PLACEMENT_SERVER, &placed);
+  svc->daemon = edgex_rest_server_create
   (
-    svc->daemon, EDGEX_DEV_API_DEVICE, GET | PUT | POST, svc,
-    edgex_device_handler_device
+    svc->logger,
+    svc->config.service.port,
+    svc->config.service.unixsocket,
+    svc->config.service.serverthreads,
+    svc->config.service.maxconnections,
+    svc->config.service.connectiontimeout,
+    err
   );
+  edgex_placement_leave (&placed);
+  if (err->code)
+  {
+    return;
+  }
+
+  edgex_rest_server_register_handler
+    (svc->daemon, EDGEX_DEV_API_READY, GET, svc, ready_handler);
 
   edgex_rest_server_register_handler
   (
-    svc->daemon, EDGEX_DEV_API_DISCOVERY, POST, svc,
-    edgex_device_handler_discovery
+    svc->daemon, EDGEX_DEV_API_METRICS, GET, svc, edgex_device_handler_metrics
   );
 
   edgex_rest_server_register_handler
   (
-    svc->daemon, EDGEX_DEV_API_METRICS, GET, svc, edgex_device_handler_metrics
+    svc->daemon, EDGEX_DEV_API_OPENMETRICS, GET, svc, edgex_device_handler_openmetrics
   );
 
   edgex_rest_server_register_handler
@@ -471,6 +927,67 @@ static void startConfigured (edgex_device_service *svc, toml_table_t *config, ed
     svc->daemon, EDGEX_DEV_API_PING, GET, svc, ping_handler
   );
 
+  /*
+   * Wait for metadata and data to be available, then register the device
+   * service, upload DeviceProfiles and fetch Devices from metadata together.
+   * Configured Devices are added once these are done.
+   */
+
+  args.svc = svc;
+  args.host = myhost;
+  args.config = config;
+  if (!warm)
+  {
+    uint32_t core = edgex_startup_stage (svc->startup, "CoreServices", startup_ping, &args, 0);
+    deps |= edgex_startup_stage (svc->startup, "Registration", startup_register, &args, core);
+    deps |= edgex_startup_stage (svc->startup, "Profiles", startup_profiles, &args, core);
+    deps |= edgex_startup_stage (svc->startup, "Devices", startup_devices, &args, core);
+  }
+  edgex_startup_stage (svc->startup, "ConfiguredDevices", startup_configured, &args, deps);
+  edgex_startup_run (svc->startup, svc->thpool, err);
+  if (err->code)
+  {
+    return;
+  }
+
+  /* Driver configuration */
+
+  if (!svc->userfns.init (svc->userdata, svc->logger, svc->config.driverconf))
+  {
+    *err = EDGEX_DRIVER_UNSTART;
+    iot_log_error (svc->logger, "Protocol driver initialization failed");
+    return;
+  }
+
+  /* Start scheduled events */
+
+  if (svc->scheduler)
+  {
+    edgex_placement_enter (EDGEX_PLACEMENT_SCHEDULER, &placed);
+    iot_scheduler_start (svc->scheduler);
+    edgex_placement_leave (&placed);
+  }
+
+  /* Register REST handlers for devices, limiting those which run commands if configured */
+
+  edgex_rest_server_register_admitted_handler
+  (
+    svc->daemon, EDGEX_DEV_API_DEVICE, GET | PUT | POST, svc,
+    edgex_device_handler_device, svc->admission, device_admission_key
+  );
+
+  edgex_rest_server_register_admitted_handler
+  (
+    svc->daemon, EDGEX_DEV_API_BATCH, POST, svc,
+    edgex_device_handler_batch, svc->admission, NULL
+  );
+
+  edgex_rest_server_register_handler
+  (
+    svc->daemon, EDGEX_DEV_API_DISCOVERY, POST, svc,
+    edgex_device_handler_discovery
+  );
+
   /* Ready. Register ourselves and log that we have started. */
 
   if (svc->registry)
@@ -491,10 +1008,19 @@ static void startConfigured (edgex_device_service *svc, toml_table_t *config, ed
     }
   }
 
+  edgex_startup_ready (svc->startup);
   if (svc->config.service.startupmsg)
   {
     iot_log_info (svc->logger, svc->config.service.startupmsg);
   }
+
+  if (warm)
+  {
+    reconcile_job *job = malloc (sizeof (reconcile_job));
+    job->svc = svc;
+    job->host = strdup (myhost);
+    edgex_pool_add_work (svc->thpool, reconcile_metadata, job);
+  }
 }
 
 void edgex_device_service_start
@@ -617,10 +1143,39 @@ void edgex_device_service_start
     }
   }
 
+  /* Place the SDK's threads, including the pool threads already running */
+
+  edgex_placement_configure (svc->logger, &svc->config, err);
+  if (err->code)
+  {
+    edgex_nvpairs_free (confpairs);
+    toml_free (config);
+    return;
+  }
+
   if (svc->config.logging.file)
   {
     free (svc->logger->to);
     svc->logger->to = strdup (svc->config.logging.file);
+    if (strcmp (svc->config.logging.file, "-"))
+    {
+      svc->logfile = edgex_logfile_alloc
+      (
+        svc->logger,
+        svc->config.logging.file,
+        svc->config.logging.buffersize ? svc->config.logging.buffersize : EDGEX_LOGFILE_DEFAULT_SLOTS,
+        (uint64_t)svc->config.logging.maxfilesize * 1024,
+        svc->config.logging.overflowpolicy,
+        err
+      );
+      if (err->code)
+      {
+        edgex_nvpairs_free (confpairs);
+        toml_free (config);
+        return;
+      }
+      edgex_log_setfile (svc->logfile);
+    }
   }
 
   if (svc->registry)
@@ -635,6 +1190,16 @@ void edgex_device_service_start
     edgex_device_parseTomlClients (svc->logger, toml_table_in (config, "Clients"), &svc->config.endpoints, err);
   }
 
+  edgex_device_service_endpoint *clients[] =
+    { &svc->config.endpoints.data, &svc->config.endpoints.metadata, &svc->config.endpoints.logging };
+  for (size_t i = 0; i < sizeof (clients) / sizeof (*clients); i++)
+  {
+    if (clients[i]->unixsocket)
+    {
+      edgex_http_set_unix_socket (clients[i]->host, clients[i]->port, clients[i]->unixsocket);
+    }
+  }
+
   if (svc->config.logging.useremote)
   {
     if (ping_client (svc->logger, "support-logging", &svc->config.endpoints.logging, svc->config.service.connectretries, svc->config.service.timeout, err))
@@ -646,6 +1211,14 @@ void edgex_device_service_start
         "http://%s:%u/api/v1/logs",
         svc->config.endpoints.logging.host, svc->config.endpoints.logging.port
       );
+      svc->logremote = edgex_logremote_alloc
+      (
+        url,
+        svc->config.logging.buffersize ? svc->config.logging.buffersize : EDGEX_LOGFILE_DEFAULT_SLOTS,
+        svc->config.logging.remotebatch ? svc->config.logging.remotebatch : EDGEX_LOGREMOTE_DEFAULT_BATCH,
+        svc->config.logging.remoteinterval ? svc->config.logging.remoteinterval : EDGEX_LOGREMOTE_DEFAULT_INTERVAL
+      );
+      edgex_log_setremote (svc->logremote);
       if (svc->config.logging.file)
       {
         svc->logger->next = iot_logger_alloc_custom (svc->name, svc->config.logging.level, url, edgex_log_torest, NULL);
@@ -665,6 +1238,27 @@ void edgex_device_service_start
     }
   }
 
+  if (svc->config.tracing.exporter && *svc->config.tracing.exporter)
+  {
+    svc->tracer = edgex_tracer_alloc
+    (
+      svc->logger,
+      svc->name,
+      svc->config.tracing.exporter,
+      svc->config.tracing.destination,
+      svc->config.tracing.buffersize,
+      err
+    );
+    if (err->code)
+    {
+      edgex_nvpairs_free (confpairs);
+      toml_free (config);
+      return;
+    }
+    edgex_trace_settracer (svc->tracer);
+    iot_log_info (svc->logger, "Tracing to %s", svc->config.tracing.destination);
+  }
+
   if (svc->config.device.profilesdir == NULL)
   {
     svc->config.device.profilesdir = strdup (confDir);
@@ -690,22 +1284,6 @@ void edgex_device_service_start
   }
 }
 
-static void doPost (void *p)
-{
-  postparams *pp = (postparams *) p;
-  edgex_error err = EDGEX_OK;
-  edgex_data_client_add_event
-  (
-    pp->svc->logger,
-    &pp->svc->config.endpoints,
-    pp->event,
-    &err
-  );
-
-  edgex_event_cooked_free (pp->event);
-  free (pp);
-}
-
 void edgex_device_post_readings
 (
   edgex_device_service *svc,
@@ -728,14 +1306,14 @@ void edgex_device_post_readings
   if (command)
   {
     edgex_event_cooked *event = edgex_data_process_event
-      (devname, command, values, svc->config.device.datatransform);
+    (
+      devname, command, values, svc->config.device.datatransform, svc->config.device.shortestfloats,
+      svc->config.device.streamthreshold, edgex_batch_compact (svc->batch), edgex_latency_lookup (svc->latency, devname, command->name), svc->eventring
+    );
 
     if (event)
     {
-      postparams *pp = malloc (sizeof (postparams));
-      pp->svc = svc;
-      pp->event = event;
-      iot_threadpool_add_work (svc->thpool, doPost, pp, NULL);
+      edgex_postq_add (svc->postq, devname, resname, event);
     }
   }
   else
@@ -744,11 +1322,102 @@ void edgex_device_post_readings
   }
 }
 
+void edgex_device_post_readings_batch
+(
+  edgex_device_service *svc,
+  const edgex_device_readingset *sets,
+  unsigned n
+)
+{
+  const char **names;
+  const char **devnames;
+  const char **resnames;
+  edgex_device **devs;
+  edgex_event_cooked **events;
+  const edgex_deviceprofile *lastprof = NULL;
+  const char *lastres = NULL;
+  const edgex_cmdinfo *command = NULL;
+  unsigned nevents = 0;
+
+  if (n == 0)
+  {
+    return;
+  }
+  names = malloc (n * sizeof (char *));
+  devnames = malloc (n * sizeof (char *));
+  resnames = malloc (n * sizeof (char *));
+  devs = malloc (n * sizeof (edgex_device *));
+  events = malloc (n * sizeof (edgex_event_cooked *));
+  for (unsigned i = 0; i < n; i++)
+  {
+    names[i] = sets[i].device_name;
+  }
+  edgex_devmap_devices_bynames (svc->devices, names, n, devs);
+  edgex_device_origin_capture ();
+
+  /* Events are queued under the names of the devices resolved, which are held until they have been queued */
+
+  for (unsigned i = 0; i < n; i++)
+  {
+    if (devs[i] == NULL)
+    {
+      iot_log_error (svc->logger, "Post readings: no such device %s", sets[i].device_name);
+      continue;
+    }
+
+    /* Frames commonly hold the same resource for many devices of one profile */
+
+    if (devs[i]->profile != lastprof || strcmp (sets[i].resource_name, lastres))
+    {
+      lastprof = devs[i]->profile;
+      lastres = sets[i].resource_name;
+      command = edgex_deviceprofile_findcommand (lastres, devs[i]->profile, true);
+    }
+    if (command)
+    {
+      edgex_event_cooked *event = edgex_data_process_event
+      (
+        devs[i]->name, command, sets[i].values, svc->config.device.datatransform, svc->config.device.shortestfloats,
+        svc->config.device.streamthreshold, edgex_batch_compact (svc->batch), edgex_latency_lookup (svc->latency, devs[i]->name, command->name), svc->eventring
+      );
+      if (event)
+      {
+        devnames[nevents] = devs[i]->name;
+        resnames[nevents] = sets[i].resource_name;
+        events[nevents++] = event;
+      }
+    }
+    else
+    {
+      iot_log_error (svc->logger, "Post readings: no such resource %s", sets[i].resource_name);
+    }
+  }
+
+  edgex_device_origin_release ();
+  if (nevents)
+  {
+    edgex_postq_addv (svc->postq, nevents, devnames, resnames, events);
+  }
+  for (unsigned i = 0; i < n; i++)
+  {
+    if (devs[i])
+    {
+      edgex_device_release (devs[i]);
+    }
+  }
+  free (events);
+  free (devs);
+  free (resnames);
+  free (devnames);
+  free (names);
+}
+
 void edgex_device_service_stop
   (edgex_device_service *svc, bool force, edgex_error *err)
 {
   *err = EDGEX_OK;
   iot_log_debug (svc->logger, "Stop device service");
+  atomic_store (&svc->stopping, true);
   if (svc->stopconfig)
   {
     *svc->stopconfig = true;
@@ -757,12 +1426,33 @@ void edgex_device_service_stop
   {
     iot_scheduler_stop (svc->scheduler);
   }
+  if (svc->aewheel)
+  {
+    edgex_timerwheel_stop (svc->aewheel);
+  }
   if (svc->daemon)
   {
     edgex_rest_server_destroy (svc->daemon);
   }
+  edgex_admission_free (svc->admission);
+  svc->admission = NULL;
+  edgex_startup_free (svc->startup);
+  svc->startup = NULL;
+  if (svc->cmdpool)
+  {
+    iot_threadpool_wait (svc->cmdpool);
+    edgex_pool_unregister (svc->cmdpool);
+    iot_threadpool_free (svc->cmdpool);
+    svc->cmdpool = NULL;
+  }
   svc->userfns.stop (svc->userdata, force);
+  pthread_mutex_lock (&svc->reconcilelock);
+  if (svc->config.device.snapshotfile && edgex_devmap_size (svc->devices))
+  {
+    edgex_snapshot_save (svc->logger, svc->config.device.snapshotfile, svc->devices);
+  }
   edgex_devmap_clear (svc->devices);
+  pthread_mutex_unlock (&svc->reconcilelock);
   if (svc->registry)
   {
     edgex_registry_deregister_service (svc->registry, svc->name, err);
@@ -771,8 +1461,58 @@ void edgex_device_service_stop
       iot_log_error (svc->logger, "Unable to deregister service from registry");
     }
   }
-  iot_scheduler_free (svc->scheduler);
+  if (svc->scheduler)
+  {
+    iot_scheduler_free (svc->scheduler);
+    svc->scheduler = NULL;
+  }
   iot_threadpool_wait (svc->thpool);
+  if (svc->aepool && svc->aepool != svc->thpool)
+  {
+    iot_threadpool_wait (svc->aepool);
+    edgex_pool_unregister (svc->aepool);
+    iot_threadpool_free (svc->aepool);
+  }
+  svc->aepool = NULL;
+  if (svc->postpool && svc->postpool != svc->thpool)
+  {
+    iot_threadpool_wait (svc->postpool);
+    edgex_pool_unregister (svc->postpool);
+    iot_threadpool_free (svc->postpool);
+  }
+  svc->postpool = NULL;
+  edgex_timerwheel_free (svc->aewheel);
+  svc->aewheel = NULL;
+  edgex_circuit_free (svc->aecircuit);
+  svc->aecircuit = NULL;
+  edgex_opstate_free (svc->opqueue);
+  svc->opqueue = NULL;
+  edgex_postq_free (svc->postq);
+  svc->postq = NULL;
+  edgex_readcache_free (svc->readcache);
+  svc->readcache = NULL;
+  edgex_inflight_free (svc->inflight);
+  svc->inflight = NULL;
+  edgex_devqueue_free (svc->devqueue);
+  svc->devqueue = NULL;
+  edgex_qos_free (svc->qos);
+  svc->qos = NULL;
+  edgex_latency_free (svc->latency);
+  svc->latency = NULL;
+  edgex_batch_free (svc->aebatch);
+  svc->aebatch = NULL;
+  edgex_batch_free (svc->batch);
+  svc->batch = NULL;
+  edgex_http_async_free (svc->asyncpost);
+  svc->asyncpost = NULL;
+  edgex_mqtt_free (svc->mqtt);
+  svc->mqtt = NULL;
+  edgex_eventring_free (svc->eventring);
+  svc->eventring = NULL;
+  edgex_watchlist_free (svc->watchlist);
+  svc->watchlist = NULL;
+  edgex_storefwd_free (svc->storefwd);
+  svc->storefwd = NULL;
   iot_log_info (svc->logger, "Stopped device service");
 }
 
@@ -781,10 +1521,21 @@ void edgex_device_service_free (edgex_device_service *svc)
   if (svc)
   {
     edgex_devmap_free (svc->devices);
+    edgex_pool_unregister (svc->thpool);
     iot_threadpool_free (svc->thpool);
+    edgex_log_setremote (NULL);
+    edgex_logremote_free (svc->logremote);
+    edgex_trace_settracer (NULL);
+    edgex_tracer_free (svc->tracer);
     edgex_registry_free (svc->registry);
     edgex_registry_fini ();
+    edgex_metadata_client_cache_clear ();
+    edgex_http_fini ();
     pthread_mutex_destroy (&svc->discolock);
+    pthread_mutex_destroy (&svc->reconcilelock);
+    edgex_log_setfile (NULL);
+    edgex_logfile_free (svc->logfile);
+    edgex_placement_reset ();
     iot_logger_free (svc->logger);
     edgex_device_freeConfig (svc);
     free (svc->stopconfig);
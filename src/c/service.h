@@ -16,7 +16,29 @@
 #include "edgex/registry.h"
 #include "config.h"
 #include "devmap.h"
+#include "batch.h"
+#include "mqtt.h"
+#include "eventring.h"
+#include "watchers.h"
+#include "storefwd.h"
+#include "rest-async.h"
+#include "postq.h"
+#include "readcache.h"
+#include "inflight.h"
+#include "devqueue.h"
+#include "qos.h"
+#include "startup.h"
+#include "timerwheel.h"
+#include "circuit.h"
+#include "opstate.h"
+#include "logfile.h"
+#include "logremote.h"
+#include "latency.h"
+#include "counters.h"
+#include "pool.h"
+#include "trace.h"
 #include "rest-server.h"
+#include "snapshot.h"
 #include "iot/threadpool.h"
 #include "iot/scheduler.h"
 
@@ -28,6 +50,11 @@ struct edgex_device_service
   edgex_device_callbacks userfns;
   edgex_device_autoevent_start_handler autoevstart;
   edgex_device_autoevent_stop_handler autoevstop;
+  edgex_device_handle_get_async asyncget;
+  edgex_device_handle_put_async asyncput;
+  edgex_device_handle_put_group groupput;
+  edgex_device_prepare_command prepare;
+  edgex_device_release_command release;
   edgex_device_add_device_callback addcallback;
   edgex_device_update_device_callback updatecallback;
   edgex_device_remove_device_callback removecallback;
@@ -42,8 +69,34 @@ struct edgex_device_service
 
   edgex_devmap_t *devices;
   iot_threadpool_t *thpool;
+  iot_threadpool_t *aepool;
+  iot_threadpool_t *postpool;
   iot_scheduler_t *scheduler;
+  edgex_timerwheel_t *aewheel;
+  edgex_circuit_t *aecircuit;
+  edgex_opstate_t *opqueue;
+  edgex_batch_t *batch;
+  edgex_batch_t *aebatch;
+  edgex_storefwd_t *storefwd;
+  edgex_http_async_t *asyncpost;
+  edgex_mqtt_t *mqtt;
+  edgex_eventring_t *eventring;
+  edgex_watchlist_t *watchlist;
+  edgex_postq_t *postq;
+  iot_threadpool_t *cmdpool;
+  edgex_readcache_t *readcache;
+  edgex_inflight_t *inflight;
+  edgex_devqueue_t *devqueue;
+  edgex_qos_t *qos;
+  edgex_admission_t *admission;
+  edgex_startup_t *startup;
+  edgex_logfile_t *logfile;
+  edgex_logremote_t *logremote;
+  edgex_latency_t *latency;
+  edgex_tracer_t *tracer;
   pthread_mutex_t discolock;
+  pthread_mutex_t reconcilelock;
+  atomic_bool stopping;
 };
 
 #endif
@@ -0,0 +1,238 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#include "snapshot.h"
+#include "edgex-rest.h"
+#include "parson.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+
+#define SNAPSHOT_MAGIC "EDSS"
+#define SNAPSHOT_VERSION 1
+
+typedef struct snapshot_header
+{
+  char magic[4];
+  uint32_t version;
+  uint32_t nprofiles;
+  uint32_t ndevices;
+} snapshot_header;
+
+static uint32_t snapshot_checksum (uint32_t h, const void *data, size_t len)
+{
+  const unsigned char *p = data;
+  for (size_t i = 0; i < len; i++)
+  {
+    h = (h ^ p[i]) * 16777619u;
+  }
+  return h;
+}
+
+static bool snapshot_write (FILE *f, uint32_t *sum, const void *data, size_t len)
+{
+  *sum = snapshot_checksum (*sum, data, len);
+  return fwrite (data, 1, len, f) == len;
+}
+
+static bool snapshot_record (FILE *f, uint32_t *sum, char *json)
+{
+  uint32_t len = strlen (json);
+  bool ok = snapshot_write (f, sum, &len, sizeof (len)) && snapshot_write (f, sum, json, len);
+  json_free_serialized_string (json);
+  return ok;
+}
+
+/* Returns the next record as a string, or NULL if it overruns the buffer */
+
+static char *snapshot_next (const char *buf, size_t size, size_t *pos)
+{
+  uint32_t len;
+  char *result;
+
+  if (size - *pos < sizeof (len))
+  {
+    return NULL;
+  }
+  memcpy (&len, buf + *pos, sizeof (len));
+  *pos += sizeof (len);
+  if (size - *pos < len)
+  {
+    return NULL;
+  }
+  result = malloc (len + 1);
+  memcpy (result, buf + *pos, len);
+  result[len] = '\0';
+  *pos += len;
+  return result;
+}
+
+static char *snapshot_readfile (iot_logger_t *lc, const char *filename, size_t *size)
+{
+  char *buf = NULL;
+  long len;
+  FILE *f = fopen (filename, "rb");
+
+  if (f == NULL)
+  {
+    if (errno != ENOENT)
+    {
+      iot_log_error (lc, "Snapshot: unable to open %s: %s", filename, strerror (errno));
+    }
+    return NULL;
+  }
+  if (fseek (f, 0, SEEK_END) == 0 && (len = ftell (f)) > 0 && fseek (f, 0, SEEK_SET) == 0)
+  {
+    buf = malloc (len);
+    if (fread (buf, 1, len, f) == (size_t)len)
+    {
+      *size = len;
+    }
+    else
+    {
+      iot_log_error (lc, "Snapshot: unable to read %s", filename);
+      free (buf);
+      buf = NULL;
+    }
+  }
+  fclose (f);
+  return buf;
+}
+
+bool edgex_snapshot_load
+(
+  iot_logger_t *lc,
+  const char *filename,
+  edgex_deviceprofile **profiles,
+  edgex_device **devices
+)
+{
+  snapshot_header hdr;
+  uint32_t sum;
+  size_t size = 0;
+  size_t pos = sizeof (hdr);
+  bool ok = true;
+  char *buf = snapshot_readfile (lc, filename, &size);
+
+  *profiles = NULL;
+  *devices = NULL;
+  if (buf == NULL)
+  {
+    return false;
+  }
+  if (size < sizeof (hdr) + sizeof (sum))
+  {
+    ok = false;
+  }
+  else
+  {
+    memcpy (&hdr, buf, sizeof (hdr));
+    memcpy (&sum, buf + size - sizeof (sum), sizeof (sum));
+    size -= sizeof (sum);
+    ok = memcmp (hdr.magic, SNAPSHOT_MAGIC, 4) == 0 && hdr.version == SNAPSHOT_VERSION &&
+      snapshot_checksum (2166136261u, buf, size) == sum;
+  }
+
+  for (uint32_t i = 0; ok && i < hdr.nprofiles; i++)
+  {
+    char *json = snapshot_next (buf, size, &pos);
+    edgex_deviceprofile *dp = json ? edgex_deviceprofile_read (lc, json) : NULL;
+    if (dp)
+    {
+      dp->next = *profiles;
+      *profiles = dp;
+    }
+    ok = (dp != NULL);
+    free (json);
+  }
+  for (uint32_t i = 0; ok && i < hdr.ndevices; i++)
+  {
+    char *json = snapshot_next (buf, size, &pos);
+    edgex_device *dev = json ? edgex_device_read (lc, json) : NULL;
+    if (dev)
+    {
+      dev->next = *devices;
+      *devices = dev;
+    }
+    ok = (dev != NULL);
+    free (json);
+  }
+  free (buf);
+
+  if (!ok)
+  {
+    iot_log_error (lc, "Snapshot: %s is not a valid snapshot, ignoring it", filename);
+    edgex_deviceprofile_free (*profiles);
+    edgex_device_free (*devices);
+    *profiles = NULL;
+    *devices = NULL;
+  }
+  return ok;
+}
+
+bool edgex_snapshot_save (iot_logger_t *lc, const char *filename, edgex_devmap_t *map)
+{
+  snapshot_header hdr;
+  FILE *f;
+  bool ok;
+  uint32_t sum = 2166136261u;
+  size_t flen = strlen (filename);
+  char tmpname[flen + 5];
+  edgex_deviceprofile *profiles = edgex_devmap_copyprofiles (map);
+  edgex_device *devices = edgex_devmap_copydevices (map);
+
+  memcpy (tmpname, filename, flen);
+  strcpy (tmpname + flen, ".tmp");
+  memcpy (hdr.magic, SNAPSHOT_MAGIC, 4);
+  hdr.version = SNAPSHOT_VERSION;
+  hdr.nprofiles = 0;
+  hdr.ndevices = 0;
+  for (const edgex_deviceprofile *dp = profiles; dp; dp = dp->next)
+  {
+    hdr.nprofiles++;
+  }
+  for (const edgex_device *dev = devices; dev; dev = dev->next)
+  {
+    hdr.ndevices++;
+  }
+
+  f = fopen (tmpname, "wb");
+  ok = (f != NULL) && snapshot_write (f, &sum, &hdr, sizeof (hdr));
+  for (const edgex_deviceprofile *dp = profiles; ok && dp; dp = dp->next)
+  {
+    ok = snapshot_record (f, &sum, edgex_deviceprofile_write (dp, false));
+  }
+  for (const edgex_device *dev = devices; ok && dev; dev = dev->next)
+  {
+    ok = snapshot_record (f, &sum, edgex_device_write (dev, false));
+  }
+  if (f)
+  {
+    ok = ok && fwrite (&sum, sizeof (sum), 1, f) == 1 && fflush (f) == 0 && fsync (fileno (f)) == 0;
+    ok = (fclose (f) == 0) && ok;
+  }
+  ok = ok && rename (tmpname, filename) == 0;
+  if (ok)
+  {
+    iot_log_debug (lc, "Snapshot: saved %u profiles and %u devices", hdr.nprofiles, hdr.ndevices);
+  }
+  else
+  {
+    iot_log_error (lc, "Snapshot: unable to write %s: %s", filename, strerror (errno));
+    if (f)
+    {
+      unlink (tmpname);
+    }
+  }
+  edgex_deviceprofile_free (profiles);
+  edgex_device_free (devices);
+  return ok;
+}
@@ -0,0 +1,39 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#ifndef _EDGEX_DEVICE_SNAPSHOT_H_
+#define _EDGEX_DEVICE_SNAPSHOT_H_ 1
+
+#include "edgex/edgex-logging.h"
+#include "edgex/edgex.h"
+#include "devmap.h"
+
+/*
+ * Snapshot of the device profiles and devices obtained from metadata, so that
+ * a restarted service can begin serving them before metadata has been
+ * contacted. The file holds a header giving the numbers of profiles and
+ * devices, a length-prefixed record for each (in the form used by the
+ * metadata REST API), and a checksum. It is written in host byte order, and
+ * replaced atomically.
+ */
+
+/* Read a snapshot. Returns false if the file is missing, unreadable or corrupt */
+
+bool edgex_snapshot_load
+(
+  iot_logger_t *lc,
+  const char *filename,
+  edgex_deviceprofile **profiles,
+  edgex_device **devices
+);
+
+/* Write the profiles and devices currently in the map */
+
+bool edgex_snapshot_save (iot_logger_t *lc, const char *filename, edgex_devmap_t *map);
+
+#endif
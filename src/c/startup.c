@@ -0,0 +1,240 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#include "startup.h"
+#include "pool.h"
+#include "edgex-time.h"
+#include "errorlist.h"
+
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdlib.h>
+
+typedef struct startup_stage
+{
+  struct edgex_startup_t *owner;
+  const char *name;
+  edgex_startup_fn fn;
+  void *ctx;
+  uint32_t deps;
+  edgex_stage_state state;
+  uint64_t started;
+  uint64_t finished;
+  edgex_error err;
+} startup_stage;
+
+struct edgex_startup_t
+{
+  pthread_mutex_t lock;
+  pthread_cond_t done;
+  iot_logger_t *lc;
+  iot_threadpool_t *pool;
+  unsigned count;
+  unsigned running;
+  bool ready;
+  startup_stage stages[EDGEX_STARTUP_MAXSTAGES];
+};
+
+static const char *startup_states[] = { "Pending", "Running", "Done", "Failed", "Skipped" };
+
+static uint64_t startup_ms (void)
+{
+  return edgex_device_nanotime_monotonic () / 1000000;
+}
+
+edgex_startup_t *edgex_startup_alloc (iot_logger_t *lc)
+{
+  edgex_startup_t *st = calloc (1, sizeof (edgex_startup_t));
+  pthread_mutex_init (&st->lock, NULL);
+  pthread_cond_init (&st->done, NULL);
+  st->lc = lc;
+  return st;
+}
+
+uint32_t edgex_startup_stage (edgex_startup_t *st, const char *name, edgex_startup_fn fn, void *ctx, uint32_t deps)
+{
+  startup_stage *s;
+  uint32_t result;
+
+  pthread_mutex_lock (&st->lock);
+  result = 1u << st->count;
+  s = &st->stages[st->count++];
+  s->owner = st;
+  s->name = name;
+  s->fn = fn;
+  s->ctx = ctx;
+  s->deps = deps;
+  s->state = EDGEX_STAGE_PENDING;
+  s->err = EDGEX_OK;
+  pthread_mutex_unlock (&st->lock);
+  return result;
+}
+
+static void startup_schedule (edgex_startup_t *st);
+
+static void startup_job (void *p)
+{
+  startup_stage *s = (startup_stage *)p;
+  edgex_startup_t *st = s->owner;
+  edgex_error err = EDGEX_OK;
+
+  s->fn (s->ctx, &err);
+
+  pthread_mutex_lock (&st->lock);
+  s->finished = startup_ms ();
+  s->err = err;
+  s->state = err.code ? EDGEX_STAGE_FAILED : EDGEX_STAGE_DONE;
+  if (err.code)
+  {
+    iot_log_error (st->lc, "Startup: %s failed: %s", s->name, err.reason);
+  }
+  else
+  {
+    iot_log_debug (st->lc, "Startup: %s completed in %" PRIu64 "ms", s->name, s->finished - s->started);
+  }
+  st->running--;
+  startup_schedule (st);
+  pthread_cond_broadcast (&st->done);
+  pthread_mutex_unlock (&st->lock);
+}
+
+/*
+ * Start the pending stages whose dependencies have completed, and skip those
+ * for which a dependency has not. Called with the lock held. Skipping one
+ * stage may cause others to be skipped, so this repeats until nothing changes.
+ */
+
+static void startup_schedule (edgex_startup_t *st)
+{
+  bool changed = true;
+
+  while (changed)
+  {
+    changed = false;
+    for (unsigned i = 0; i < st->count; i++)
+    {
+      startup_stage *s = &st->stages[i];
+      bool ready = true;
+      bool blocked = false;
+
+      if (s->state != EDGEX_STAGE_PENDING)
+      {
+        continue;
+      }
+      for (unsigned d = 0; d < st->count; d++)
+      {
+        if (s->deps & (1u << d))
+        {
+          edgex_stage_state ds = st->stages[d].state;
+          ready = ready && (ds == EDGEX_STAGE_DONE);
+          blocked = blocked || (ds == EDGEX_STAGE_FAILED || ds == EDGEX_STAGE_SKIPPED);
+        }
+      }
+      if (blocked)
+      {
+        iot_log_warn (st->lc, "Startup: %s skipped", s->name);
+        s->state = EDGEX_STAGE_SKIPPED;
+        changed = true;
+      }
+      else if (ready)
+      {
+        s->state = EDGEX_STAGE_RUNNING;
+        s->started = startup_ms ();
+        st->running++;
+        edgex_pool_add_work (st->pool, startup_job, s);
+      }
+    }
+  }
+}
+
+void edgex_startup_run (edgex_startup_t *st, iot_threadpool_t *pool, edgex_error *err)
+{
+  pthread_mutex_lock (&st->lock);
+  st->pool = pool;
+  startup_schedule (st);
+  while (st->running)
+  {
+    pthread_cond_wait (&st->done, &st->lock);
+  }
+
+  /* Stages left pending depend on stages which were never added */
+
+  *err = EDGEX_OK;
+  for (unsigned i = 0; i < st->count; i++)
+  {
+    startup_stage *s = &st->stages[i];
+    if (s->state == EDGEX_STAGE_PENDING)
+    {
+      iot_log_error (st->lc, "Startup: %s has unmet dependencies", s->name);
+      s->state = EDGEX_STAGE_SKIPPED;
+    }
+    if (s->state == EDGEX_STAGE_FAILED && err->code == 0)
+    {
+      *err = s->err;
+    }
+  }
+  pthread_mutex_unlock (&st->lock);
+}
+
+void edgex_startup_ready (edgex_startup_t *st)
+{
+  pthread_mutex_lock (&st->lock);
+  st->ready = true;
+  pthread_mutex_unlock (&st->lock);
+}
+
+bool edgex_startup_isready (edgex_startup_t *st)
+{
+  bool result;
+  pthread_mutex_lock (&st->lock);
+  result = st->ready;
+  pthread_mutex_unlock (&st->lock);
+  return result;
+}
+
+JSON_Value *edgex_startup_status (edgex_startup_t *st)
+{
+  JSON_Value *val = json_value_init_object ();
+  JSON_Object *obj = json_value_get_object (val);
+  JSON_Value *sval = json_value_init_array ();
+  JSON_Array *stages = json_value_get_array (sval);
+  uint64_t now = startup_ms ();
+
+  pthread_mutex_lock (&st->lock);
+  json_object_set_boolean (obj, "Ready", st->ready);
+  for (unsigned i = 0; i < st->count; i++)
+  {
+    const startup_stage *s = &st->stages[i];
+    JSON_Value *stval = json_value_init_object ();
+    JSON_Object *stobj = json_value_get_object (stval);
+    json_object_set_string (stobj, "Name", s->name);
+    json_object_set_string (stobj, "State", startup_states[s->state]);
+    if (s->state == EDGEX_STAGE_RUNNING)
+    {
+      json_object_set_number (stobj, "Duration", now - s->started);
+    }
+    else if (s->state == EDGEX_STAGE_DONE || s->state == EDGEX_STAGE_FAILED)
+    {
+      json_object_set_number (stobj, "Duration", s->finished - s->started);
+    }
+    json_array_append_value (stages, stval);
+  }
+  pthread_mutex_unlock (&st->lock);
+  json_object_set_value (obj, "Stages", sval);
+  return val;
+}
+
+void edgex_startup_free (edgex_startup_t *st)
+{
+  if (st)
+  {
+    pthread_cond_destroy (&st->done);
+    pthread_mutex_destroy (&st->lock);
+    free (st);
+  }
+}
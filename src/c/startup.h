@@ -0,0 +1,64 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#ifndef _EDGEX_DEVICE_STARTUP_H_
+#define _EDGEX_DEVICE_STARTUP_H_ 1
+
+#include "edgex/error.h"
+#include "parson.h"
+#include "iot/threadpool.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Staged startup. Each stage names the stages it depends on, and is run on a
+ * thread pool once they have all completed, so that independent stages run
+ * in parallel. A stage whose dependencies did not all complete is skipped.
+ * The progress of the stages, and whether the service is ready, may be
+ * reported while they run.
+ */
+
+#define EDGEX_STARTUP_MAXSTAGES 16
+
+typedef enum
+{
+  EDGEX_STAGE_PENDING,
+  EDGEX_STAGE_RUNNING,
+  EDGEX_STAGE_DONE,
+  EDGEX_STAGE_FAILED,
+  EDGEX_STAGE_SKIPPED
+} edgex_stage_state;
+
+typedef struct edgex_startup_t edgex_startup_t;
+
+typedef void (*edgex_startup_fn) (void *ctx, edgex_error *err);
+
+edgex_startup_t *edgex_startup_alloc (iot_logger_t *lc);
+
+/* Add a stage, which depends on the stages in deps. Returns the stage, for use in the deps of others */
+
+uint32_t edgex_startup_stage (edgex_startup_t *st, const char *name, edgex_startup_fn fn, void *ctx, uint32_t deps);
+
+/* Run the stages added, returning once all have finished. The error from the first stage to fail is returned */
+
+void edgex_startup_run (edgex_startup_t *st, iot_threadpool_t *pool, edgex_error *err);
+
+/* Startup is complete */
+
+void edgex_startup_ready (edgex_startup_t *st);
+
+bool edgex_startup_isready (edgex_startup_t *st);
+
+/* Ready, and the state and running time (in milliseconds) of each stage */
+
+JSON_Value *edgex_startup_status (edgex_startup_t *st);
+
+void edgex_startup_free (edgex_startup_t *st);
+
+#endif
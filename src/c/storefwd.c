@@ -0,0 +1,382 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#include "storefwd.h"
+#include "placement.h"
+#include "service.h"
+#include "errorlist.h"
+#include "edgex-time.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#define SF_MAGIC 0x45584653   /* "EXFS" */
+#define SF_VERSION 1
+#define SF_REC_DATA 0x52454344
+#define SF_REC_WRAP 0x57524150
+#define SF_ALIGN(n) (((n) + 7) & ~(uint64_t)7)
+
+typedef struct edgex_sf_header
+{
+  uint32_t magic;
+  uint32_t version;
+  uint64_t capacity;
+  uint64_t head;
+  uint64_t tail;
+  uint64_t count;
+} edgex_sf_header;
+
+typedef struct edgex_sf_record
+{
+  uint32_t magic;
+  uint32_t encoding;
+  uint64_t length;
+  uint64_t stored;
+} edgex_sf_record;
+
+#define SF_HDR_SIZE SF_ALIGN (sizeof (edgex_sf_header))
+
+struct edgex_storefwd_t
+{
+  edgex_device_service *svc;
+  int fd;
+  size_t mapsize;
+  edgex_sf_header *hdr;
+  unsigned char *ring;
+  uint64_t retention;
+  uint32_t retry;
+  uint64_t popped;
+  uint64_t dropped;
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+  pthread_t thread;
+  bool running;
+};
+
+static edgex_sf_record *sf_record_at (edgex_storefwd_t *sf, uint64_t offset)
+{
+  return (edgex_sf_record *)(sf->ring + offset);
+}
+
+/* Locate the oldest record, following a wrap marker if present. Called with the lock held */
+
+static edgex_sf_record *sf_head (edgex_storefwd_t *sf)
+{
+  edgex_sf_header *hdr = sf->hdr;
+  if (hdr->capacity - hdr->head < sizeof (edgex_sf_record) || sf_record_at (sf, hdr->head)->magic == SF_REC_WRAP)
+  {
+    hdr->head = 0;
+  }
+  return sf_record_at (sf, hdr->head);
+}
+
+static void sf_pop (edgex_storefwd_t *sf)
+{
+  edgex_sf_record *rec = sf_head (sf);
+  sf->hdr->head += SF_ALIGN (sizeof (edgex_sf_record) + rec->length);
+  if (--sf->hdr->count == 0)
+  {
+    sf->hdr->head = sf->hdr->tail = 0;
+  }
+  sf->popped++;
+}
+
+/* Schedule write-back of the pages of the ring holding the given range, and of the header */
+
+static void sf_sync (edgex_storefwd_t *sf, uint64_t offset, uint64_t len)
+{
+  uintptr_t page = (uintptr_t)sysconf (_SC_PAGESIZE);
+  uintptr_t start = (uintptr_t)(sf->ring + offset) & ~(page - 1);
+  uintptr_t end = (uintptr_t)(sf->ring + offset + len);
+
+  msync (sf->hdr, SF_HDR_SIZE, MS_ASYNC);
+  if (end > start)
+  {
+    msync ((void *)start, end - start, MS_ASYNC);
+  }
+}
+
+static void sf_write (edgex_storefwd_t *sf, uint64_t offset, edgex_event_encoding enc, const void *data, size_t len)
+{
+  edgex_sf_record *rec = sf_record_at (sf, offset);
+  rec->encoding = enc;
+  rec->length = len;
+  rec->stored = edgex_device_nanotime ();
+  memcpy (sf->ring + offset + sizeof (edgex_sf_record), data, len);
+  rec->magic = SF_REC_DATA;
+  sf->hdr->tail = offset + SF_ALIGN (sizeof (edgex_sf_record) + len);
+  sf->hdr->count++;
+}
+
+bool edgex_storefwd_put
+  (edgex_storefwd_t *sf, edgex_event_encoding encoding, const void *data, size_t length)
+{
+  uint64_t rs = SF_ALIGN (sizeof (edgex_sf_record) + length);
+  edgex_sf_header *hdr = sf->hdr;
+  uint64_t dropped = 0;
+
+  if (rs > hdr->capacity)
+  {
+    iot_log_error (sf->svc->logger, "Store-and-forward: payload of %zu bytes exceeds capacity", length);
+    return false;
+  }
+
+  pthread_mutex_lock (&sf->lock);
+  while (true)
+  {
+    if (hdr->count == 0)
+    {
+      hdr->head = hdr->tail = 0;
+    }
+    if (hdr->count == 0 || hdr->tail > hdr->head)
+    {
+      if (hdr->capacity - hdr->tail >= rs)
+      {
+        sf_write (sf, hdr->tail, encoding, data, length);
+        break;
+      }
+      if (hdr->head >= rs)
+      {
+        if (hdr->capacity - hdr->tail >= sizeof (edgex_sf_record))
+        {
+          sf_record_at (sf, hdr->tail)->magic = SF_REC_WRAP;
+          sf_sync (sf, hdr->tail, sizeof (edgex_sf_record));
+        }
+        sf_write (sf, 0, encoding, data, length);
+        break;
+      }
+    }
+    else if (hdr->tail < hdr->head && hdr->head - hdr->tail >= rs)
+    {
+      sf_write (sf, hdr->tail, encoding, data, length);
+      break;
+    }
+    sf_pop (sf);
+    dropped++;
+  }
+  sf_sync (sf, hdr->tail - rs, rs);
+  sf->dropped += dropped;
+  edgex_counter_add (EDGEX_COUNTER_EVENTS_DROPPED, dropped);
+  pthread_cond_signal (&sf->cond);
+  pthread_mutex_unlock (&sf->lock);
+
+  if (dropped)
+  {
+    iot_log_warn (sf->svc->logger, "Store-and-forward: queue full, discarded %" PRIu64 " oldest payloads", dropped);
+  }
+  return true;
+}
+
+uint64_t edgex_storefwd_count (edgex_storefwd_t *sf)
+{
+  uint64_t result;
+  pthread_mutex_lock (&sf->lock);
+  result = sf->hdr->count;
+  pthread_mutex_unlock (&sf->lock);
+  return result;
+}
+
+static void sf_wait (edgex_storefwd_t *sf, uint32_t ms)
+{
+  struct timespec ts;
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  ts.tv_sec += ms / 1000;
+  ts.tv_nsec += (ms % 1000) * 1000000;
+  if (ts.tv_nsec >= 1000000000)
+  {
+    ts.tv_sec++;
+    ts.tv_nsec -= 1000000000;
+  }
+  pthread_cond_timedwait (&sf->cond, &sf->lock, &ts);
+}
+
+/*
+ * Replay thread. The oldest payload is copied out of the ring so that posting
+ * does not hold the lock; it is removed only if it has not been discarded by
+ * a concurrent put in the meantime.
+ */
+
+static void *sf_replay_thread (void *p)
+{
+  edgex_storefwd_t *sf = (edgex_storefwd_t *)p;
+  iot_logger_t *lc = sf->svc->logger;
+
+  edgex_placement_apply (EDGEX_PLACEMENT_IO);
+
+  pthread_mutex_lock (&sf->lock);
+  while (sf->running)
+  {
+    if (sf->hdr->count == 0)
+    {
+      pthread_cond_wait (&sf->cond, &sf->lock);
+      continue;
+    }
+
+    edgex_sf_record *rec = sf_head (sf);
+    uint64_t gen = sf->popped;
+    uint64_t now = edgex_device_nanotime ();
+    if (sf->retention && now > rec->stored && now - rec->stored > sf->retention)
+    {
+      sf_pop (sf);
+      sf->dropped++;
+      edgex_counter_inc (EDGEX_COUNTER_EVENTS_DROPPED);
+      iot_log_debug (lc, "Store-and-forward: discarded expired payload");
+      continue;
+    }
+
+    edgex_event_cooked ev;
+    edgex_error err = EDGEX_OK;
+    size_t len = rec->length;
+    unsigned char *copy = malloc (len + 1);
+    memcpy (copy, (unsigned char *)rec + sizeof (edgex_sf_record), len);
+    copy[len] = '\0';
+    ev.encoding = rec->encoding;
+    ev.source = NULL;
+    ev.readings = NULL;
+    if (ev.encoding == JSON)
+    {
+      ev.value.json = (char *)copy;
+    }
+    else
+    {
+      ev.value.cbor.data = copy;
+      ev.value.cbor.length = len;
+      ev.value.cbor.pieces = NULL;
+    }
+    pthread_mutex_unlock (&sf->lock);
+
+    edgex_data_client_add_event (sf->svc, &ev, &err);
+    free (copy);
+
+    pthread_mutex_lock (&sf->lock);
+    if (err.code == 0)
+    {
+      if (sf->popped == gen && sf->hdr->count)
+      {
+        sf_pop (sf);
+      }
+      if (sf->hdr->count == 0)
+      {
+        iot_log_info (lc, "Store-and-forward: all stored payloads delivered");
+      }
+    }
+    else if (sf->running)
+    {
+      iot_log_debug (lc, "Store-and-forward: core-data unavailable, %" PRIu64 " payloads pending", sf->hdr->count);
+      sf_wait (sf, sf->retry);
+    }
+  }
+  pthread_mutex_unlock (&sf->lock);
+  return NULL;
+}
+
+edgex_storefwd_t *edgex_storefwd_alloc
+(
+  edgex_device_service *svc,
+  const char *filename,
+  uint64_t size,
+  uint32_t retention,
+  uint32_t retry,
+  edgex_error *err
+)
+{
+  edgex_storefwd_t *sf;
+  pthread_condattr_t attr;
+  struct stat st;
+  size_t mapsize = SF_HDR_SIZE + SF_ALIGN (size);
+  void *map;
+
+  int fd = open (filename, O_RDWR | O_CREAT, 0600);
+  if (fd < 0)
+  {
+    iot_log_error (svc->logger, "Store-and-forward: unable to open %s: %s", filename, strerror (errno));
+    *err = EDGEX_BAD_CONFIG;
+    return NULL;
+  }
+  if (fstat (fd, &st) != 0 || (st.st_size != mapsize && ftruncate (fd, mapsize) != 0))
+  {
+    iot_log_error (svc->logger, "Store-and-forward: unable to size %s: %s", filename, strerror (errno));
+    close (fd);
+    *err = EDGEX_BAD_CONFIG;
+    return NULL;
+  }
+  map = mmap (NULL, mapsize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (map == MAP_FAILED)
+  {
+    iot_log_error (svc->logger, "Store-and-forward: unable to map %s: %s", filename, strerror (errno));
+    close (fd);
+    *err = EDGEX_BAD_CONFIG;
+    return NULL;
+  }
+
+  sf = calloc (1, sizeof (edgex_storefwd_t));
+  sf->svc = svc;
+  sf->fd = fd;
+  sf->mapsize = mapsize;
+  sf->hdr = map;
+  sf->ring = (unsigned char *)map + SF_HDR_SIZE;
+  sf->retention = (uint64_t)retention * EDGEX_NANOS;
+  sf->retry = retry;
+
+  if (sf->hdr->magic == SF_MAGIC && sf->hdr->version == SF_VERSION && sf->hdr->capacity == SF_ALIGN (size))
+  {
+    if (sf->hdr->count)
+    {
+      iot_log_info (svc->logger, "Store-and-forward: %" PRIu64 " stored payloads pending delivery", sf->hdr->count);
+    }
+  }
+  else
+  {
+    if (sf->hdr->magic == SF_MAGIC)
+    {
+      iot_log_warn (svc->logger, "Store-and-forward: size of %s changed, discarding contents", filename);
+    }
+    memset (sf->hdr, 0, sizeof (edgex_sf_header));
+    sf->hdr->magic = SF_MAGIC;
+    sf->hdr->version = SF_VERSION;
+    sf->hdr->capacity = SF_ALIGN (size);
+  }
+
+  pthread_mutex_init (&sf->lock, NULL);
+  pthread_condattr_init (&attr);
+  pthread_condattr_setclock (&attr, CLOCK_MONOTONIC);
+  pthread_cond_init (&sf->cond, &attr);
+  pthread_condattr_destroy (&attr);
+  sf->running = true;
+  pthread_create (&sf->thread, NULL, sf_replay_thread, sf);
+  return sf;
+}
+
+void edgex_storefwd_free (edgex_storefwd_t *sf)
+{
+  if (sf)
+  {
+    pthread_mutex_lock (&sf->lock);
+    sf->running = false;
+    pthread_cond_signal (&sf->cond);
+    pthread_mutex_unlock (&sf->lock);
+    pthread_join (sf->thread, NULL);
+
+    if (sf->hdr->count)
+    {
+      iot_log_info (sf->svc->logger, "Store-and-forward: %" PRIu64 " payloads retained for delivery", sf->hdr->count);
+    }
+    msync (sf->hdr, sf->mapsize, MS_SYNC);
+    munmap (sf->hdr, sf->mapsize);
+    close (sf->fd);
+    pthread_cond_destroy (&sf->cond);
+    pthread_mutex_destroy (&sf->lock);
+    free (sf);
+  }
+}
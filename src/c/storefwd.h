@@ -0,0 +1,60 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#ifndef _EDGEX_DEVICE_STOREFWD_H_
+#define _EDGEX_DEVICE_STOREFWD_H_ 1
+
+#include "edgex/devsdk.h"
+#include "data.h"
+
+/*
+ * Store-and-forward queue. Event payloads which could not be delivered to
+ * core-data are appended to a memory-mapped ring file, and replayed in order
+ * by a background thread once core-data can be reached again. When the ring
+ * is full the oldest payloads are discarded. The contents of the file survive
+ * a restart of the service.
+ */
+
+#define EDGEX_SF_DEFAULT_SIZE 10240
+#define EDGEX_SF_DEFAULT_RETRY 5000
+
+typedef struct edgex_storefwd_t edgex_storefwd_t;
+
+/*
+ * Open (creating if necessary) the ring file.
+ * size: capacity of the ring in bytes.
+ * retention: payloads older than this many seconds are discarded rather than replayed, 0 for no limit.
+ * retry: interval in milliseconds between replay attempts while core-data is unavailable.
+ */
+
+edgex_storefwd_t *edgex_storefwd_alloc
+(
+  edgex_device_service *svc,
+  const char *filename,
+  uint64_t size,
+  uint32_t retention,
+  uint32_t retry,
+  edgex_error *err
+);
+
+/* Store a payload (a single event, or a batch of events) for later delivery */
+
+bool edgex_storefwd_put
+  (edgex_storefwd_t *sf, edgex_event_encoding encoding, const void *data, size_t length);
+
+/*
+ * Number of payloads waiting to be replayed. While this is nonzero, new
+ * payloads should be stored rather than posted, so that they reach core-data
+ * after those stored before them.
+ */
+
+uint64_t edgex_storefwd_count (edgex_storefwd_t *sf);
+
+void edgex_storefwd_free (edgex_storefwd_t *sf);
+
+#endif
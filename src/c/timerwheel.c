@@ -0,0 +1,308 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#include "timerwheel.h"
+#include "placement.h"
+#include "pool.h"
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <time.h>
+
+#define TW_LEVELS 4
+#define TW_BITS 6
+#define TW_SLOTS (1u << TW_BITS)
+#define TW_MASK (TW_SLOTS - 1)
+
+/* Timers due further ahead than the wheels reach are held at the end of the outermost one */
+#define TW_RANGE (1ull << (TW_LEVELS * TW_BITS))
+
+/* Slots are circular lists headed by a sentinel, so that a timer may unlink itself */
+
+typedef struct tw_link
+{
+  struct tw_link *prev;
+  struct tw_link *next;
+} tw_link;
+
+struct edgex_timer
+{
+  tw_link link;
+  edgex_timer_fn fn;
+  void *arg;
+  uint64_t period;
+  uint64_t expires;
+  bool scheduled;
+};
+
+typedef struct tw_job
+{
+  edgex_timer_fn fn;
+  void *arg;
+} tw_job;
+
+struct edgex_timerwheel_t
+{
+  iot_threadpool_t *pool;
+  uint64_t tickms;
+  uint64_t tick;
+  uint64_t start;
+  tw_link wheels[TW_LEVELS][TW_SLOTS];
+  tw_job *jobs;
+  size_t njobs;
+  size_t jobcap;
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+  pthread_t thread;
+  bool running;
+};
+
+static uint64_t tw_now (void)
+{
+  struct timespec ts;
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static void tw_unlink (edgex_timer *t)
+{
+  t->link.prev->next = t->link.next;
+  t->link.next->prev = t->link.prev;
+}
+
+/* Place a timer in the slot for its expiry time. Called with the lock held */
+
+static void tw_insert (edgex_timerwheel_t *tw, edgex_timer *t)
+{
+  unsigned level = 0;
+  uint64_t delta = t->expires - tw->tick;
+  uint64_t when = t->expires;
+
+  if (delta >= TW_RANGE)
+  {
+    delta = TW_RANGE - 1;
+    when = tw->tick + delta;
+  }
+  while (delta >= (1ull << ((level + 1) * TW_BITS)))
+  {
+    level++;
+  }
+  tw_link *head = &tw->wheels[level][(when >> (level * TW_BITS)) & TW_MASK];
+  t->link.next = head;
+  t->link.prev = head->prev;
+  head->prev->next = &t->link;
+  head->prev = &t->link;
+}
+
+/* Detach the contents of a slot */
+
+static tw_link *tw_take (tw_link *head)
+{
+  tw_link *first = head->next;
+  if (first == head)
+  {
+    return NULL;
+  }
+  head->prev->next = NULL;
+  head->next = head->prev = head;
+  return first;
+}
+
+static void tw_addjob (edgex_timerwheel_t *tw, edgex_timer *t)
+{
+  if (tw->njobs == tw->jobcap)
+  {
+    tw->jobcap = tw->jobcap ? tw->jobcap * 2 : 64;
+    tw->jobs = realloc (tw->jobs, tw->jobcap * sizeof (tw_job));
+  }
+  tw->jobs[tw->njobs].fn = t->fn;
+  tw->jobs[tw->njobs++].arg = t->arg;
+}
+
+/* Advance by one tick, collecting the timers which expire. Called with the lock held */
+
+static void tw_advance (edgex_timerwheel_t *tw)
+{
+  tw_link *l;
+  tw_link *next;
+
+  tw->tick++;
+
+  /* On reaching the start of a slot in an outer wheel, redistribute its timers inwards */
+
+  for (unsigned level = 1; level < TW_LEVELS; level++)
+  {
+    if ((tw->tick & ((1ull << (level * TW_BITS)) - 1)) != 0)
+    {
+      break;
+    }
+    for (l = tw_take (&tw->wheels[level][(tw->tick >> (level * TW_BITS)) & TW_MASK]); l; l = next)
+    {
+      next = l->next;
+      tw_insert (tw, (edgex_timer *)l);
+    }
+  }
+
+  for (l = tw_take (&tw->wheels[0][tw->tick & TW_MASK]); l; l = next)
+  {
+    edgex_timer *t = (edgex_timer *)l;
+    next = l->next;
+    tw_addjob (tw, t);
+    t->expires += t->period;
+    tw_insert (tw, t);
+  }
+}
+
+static void *tw_thread (void *p)
+{
+  edgex_timerwheel_t *tw = (edgex_timerwheel_t *)p;
+
+  edgex_placement_apply (EDGEX_PLACEMENT_SCHEDULER);
+
+  pthread_mutex_lock (&tw->lock);
+  while (tw->running)
+  {
+    uint64_t due = tw->start + (tw->tick + 1) * tw->tickms;
+    if (tw_now () < due)
+    {
+      struct timespec ts;
+      ts.tv_sec = due / 1000;
+      ts.tv_nsec = (due % 1000) * 1000000;
+      pthread_cond_timedwait (&tw->cond, &tw->lock, &ts);
+      continue;
+    }
+
+    /* Catch up with any ticks missed, then run the expired timers outside the lock */
+
+    uint64_t target = (tw_now () - tw->start) / tw->tickms;
+    while (tw->tick < target)
+    {
+      tw_advance (tw);
+    }
+    size_t njobs = tw->njobs;
+    tw_job *jobs = tw->jobs;
+    tw->jobs = NULL;
+    tw->njobs = tw->jobcap = 0;
+    pthread_mutex_unlock (&tw->lock);
+    for (size_t i = 0; i < njobs; i++)
+    {
+      edgex_pool_add_work (tw->pool, jobs[i].fn, jobs[i].arg);
+    }
+    free (jobs);
+    pthread_mutex_lock (&tw->lock);
+  }
+  pthread_mutex_unlock (&tw->lock);
+  return NULL;
+}
+
+edgex_timerwheel_t *edgex_timerwheel_alloc (iot_threadpool_t *pool, uint64_t tickms)
+{
+  pthread_condattr_t attr;
+  edgex_timerwheel_t *tw = calloc (1, sizeof (edgex_timerwheel_t));
+
+  tw->pool = pool;
+  tw->tickms = tickms ? tickms : 1;
+  tw->start = tw_now ();
+  for (unsigned level = 0; level < TW_LEVELS; level++)
+  {
+    for (unsigned slot = 0; slot < TW_SLOTS; slot++)
+    {
+      tw->wheels[level][slot].next = tw->wheels[level][slot].prev = &tw->wheels[level][slot];
+    }
+  }
+  pthread_mutex_init (&tw->lock, NULL);
+  pthread_condattr_init (&attr);
+  pthread_condattr_setclock (&attr, CLOCK_MONOTONIC);
+  pthread_cond_init (&tw->cond, &attr);
+  pthread_condattr_destroy (&attr);
+  tw->running = true;
+  pthread_create (&tw->thread, NULL, tw_thread, tw);
+  return tw;
+}
+
+static uint64_t tw_ticks (const edgex_timerwheel_t *tw, uint64_t ms)
+{
+  uint64_t ticks = (ms + tw->tickms / 2) / tw->tickms;
+  return ticks ? ticks : 1;
+}
+
+edgex_timer *edgex_timerwheel_add
+  (edgex_timerwheel_t *tw, edgex_timer_fn fn, void *arg, uint64_t period, uint64_t delay)
+{
+  edgex_timer *t = malloc (sizeof (edgex_timer));
+  t->fn = fn;
+  t->arg = arg;
+  t->period = tw_ticks (tw, period);
+  pthread_mutex_lock (&tw->lock);
+  t->expires = tw->tick + tw_ticks (tw, delay);
+  t->scheduled = true;
+  tw_insert (tw, t);
+  pthread_mutex_unlock (&tw->lock);
+  return t;
+}
+
+void edgex_timerwheel_remove (edgex_timerwheel_t *tw, edgex_timer *t)
+{
+  pthread_mutex_lock (&tw->lock);
+  if (t->scheduled)
+  {
+    tw_unlink (t);
+    t->scheduled = false;
+  }
+  pthread_mutex_unlock (&tw->lock);
+}
+
+void edgex_timerwheel_delete (edgex_timerwheel_t *tw, edgex_timer *t)
+{
+  if (t)
+  {
+    edgex_timerwheel_remove (tw, t);
+    free (t);
+  }
+}
+
+void edgex_timerwheel_stop (edgex_timerwheel_t *tw)
+{
+  pthread_mutex_lock (&tw->lock);
+  if (tw->running)
+  {
+    tw->running = false;
+    pthread_cond_signal (&tw->cond);
+    pthread_mutex_unlock (&tw->lock);
+    pthread_join (tw->thread, NULL);
+  }
+  else
+  {
+    pthread_mutex_unlock (&tw->lock);
+  }
+}
+
+void edgex_timerwheel_free (edgex_timerwheel_t *tw)
+{
+  if (tw)
+  {
+    edgex_timerwheel_stop (tw);
+    for (unsigned level = 0; level < TW_LEVELS; level++)
+    {
+      for (unsigned slot = 0; slot < TW_SLOTS; slot++)
+      {
+        tw_link *next;
+        for (tw_link *l = tw_take (&tw->wheels[level][slot]); l; l = next)
+        {
+          next = l->next;
+          free (l);
+        }
+      }
+    }
+    free (tw->jobs);
+    pthread_cond_destroy (&tw->cond);
+    pthread_mutex_destroy (&tw->lock);
+    free (tw);
+  }
+}
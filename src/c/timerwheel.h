@@ -0,0 +1,56 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#ifndef _EDGEX_DEVICE_TIMERWHEEL_H_
+#define _EDGEX_DEVICE_TIMERWHEEL_H_ 1
+
+#include "iot/threadpool.h"
+
+#include <stdint.h>
+
+/*
+ * Hierarchical timing wheel for large numbers of periodic timers. Time is
+ * divided into ticks of a fixed length; each timer is held in a slot of one
+ * of four wheels according to how far away it is, and is moved to a finer
+ * wheel as it nears. Adding and removing a timer take constant time, and a
+ * single thread advances the wheels, passing the functions of expired timers
+ * to a thread pool.
+ */
+
+typedef struct edgex_timerwheel_t edgex_timerwheel_t;
+typedef struct edgex_timer edgex_timer;
+
+typedef void (*edgex_timer_fn) (void *arg);
+
+edgex_timerwheel_t *edgex_timerwheel_alloc (iot_threadpool_t *pool, uint64_t tickms);
+
+/*
+ * Create a timer which runs fn (arg) every period ms, first after delay ms.
+ * Both are rounded to whole ticks, of at least one.
+ */
+
+edgex_timer *edgex_timerwheel_add
+  (edgex_timerwheel_t *tw, edgex_timer_fn fn, void *arg, uint64_t period, uint64_t delay);
+
+/* Stop a timer from running further. A run already passed to the thread pool is not affected */
+
+void edgex_timerwheel_remove (edgex_timerwheel_t *tw, edgex_timer *t);
+
+/* Remove and free a timer */
+
+void edgex_timerwheel_delete (edgex_timerwheel_t *tw, edgex_timer *t);
+
+/* Stop the wheels turning. Timers may still be removed and deleted */
+
+void edgex_timerwheel_stop (edgex_timerwheel_t *tw);
+
+/* Free the wheel and any timers remaining in it */
+
+void edgex_timerwheel_free (edgex_timerwheel_t *tw);
+
+#endif
@@ -0,0 +1,491 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#include "trace.h"
+#include "placement.h"
+#include "correlation.h"
+#include "edgex-time.h"
+#include "errorlist.h"
+#include "jsonbuf.h"
+#include "rest.h"
+
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#define TRACE_CRLIDLEN 64
+#define TRACE_NAMELEN 96
+
+#define trace_literal(b, s) edgex_jsonbuf_append (b, s, sizeof (s) - 1)
+
+typedef enum { TRACE_FILE, TRACE_OTLP } trace_exporter;
+
+static const char *exporternames[] = { "File", "OTLP" };
+
+static const char *stagenames[] =
+  { "Request", "AutoEvent", "Lookup", "Driver", "Transform", "Encode", "HTTP", "Response" };
+
+/* Span times are taken from the monotonic clock, and converted to real time relative to the start of the trace */
+
+typedef struct trace_span
+{
+  edgex_trace_stage stage;
+  uint64_t start;
+  uint64_t end;
+} trace_span;
+
+typedef struct trace_record
+{
+  char traceid[33];
+  char crlid[TRACE_CRLIDLEN];
+  char name[TRACE_NAMELEN];
+  edgex_trace_stage stage;
+  uint64_t realstart;
+  uint64_t start;
+  uint64_t end;
+  unsigned nspans;
+  trace_span spans[EDGEX_TRACE_MAXSPANS];
+} trace_record;
+
+struct edgex_tracer_t
+{
+  char *service;
+  char *destination;
+  trace_exporter exporter;
+  FILE *f;
+  uint32_t size;
+  trace_record *records;
+  uint32_t head;
+  uint32_t count;
+  uint64_t exported;
+  uint64_t dropped;
+  uint64_t failed;
+  bool running;
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+  pthread_t thread;
+};
+
+static _Atomic (edgex_tracer_t *) tracer = NULL;
+
+struct edgex_trace_t
+{
+  trace_record record;
+};
+
+static _Thread_local trace_record current;
+static _Thread_local unsigned depth = 0;
+
+static uint64_t trace_realtime (const trace_record *r, uint64_t t)
+{
+  return r->realstart + (t - r->start);
+}
+
+/* The trace ID is the correlation ID if that is a UUID, otherwise a hash of it */
+
+static void trace_setid (trace_record *r, const char *crlid)
+{
+  unsigned n = 0;
+  for (const char *c = crlid; *c && n < 32; c++)
+  {
+    if ((*c >= '0' && *c <= '9') || (*c >= 'a' && *c <= 'f'))
+    {
+      r->traceid[n++] = *c;
+    }
+    else if (*c != '-')
+    {
+      break;
+    }
+  }
+  if (n < 32 || strlen (crlid) != 36)
+  {
+    uint64_t h1 = 14695981039346656037u;
+    uint64_t h2 = 1099511628211u;
+    for (const char *c = crlid; *c; c++)
+    {
+      h1 = (h1 ^ (unsigned char)*c) * 1099511628211u;
+      h2 = (h2 ^ (unsigned char)*c) * 14695981039346656037u;
+    }
+    snprintf (r->traceid, sizeof (r->traceid), "%016" PRIx64 "%016" PRIx64, h1, h2);
+  }
+  r->traceid[32] = '\0';
+}
+
+void edgex_trace_begin (void)
+{
+  if (depth++ == 0 && atomic_load_explicit (&tracer, memory_order_acquire))
+  {
+    const char *crlid = edgex_device_get_crlid ();
+    if (crlid == NULL)
+    {
+      crlid = "";
+    }
+    trace_setid (&current, crlid);
+    strncpy (current.crlid, crlid, TRACE_CRLIDLEN - 1);
+    current.crlid[TRACE_CRLIDLEN - 1] = '\0';
+    current.nspans = 0;
+    current.realstart = edgex_device_nanotime ();
+    current.start = edgex_device_nanotime_monotonic ();
+  }
+  else if (depth == 1)
+  {
+    current.start = 0;
+  }
+}
+
+uint64_t edgex_trace_start (void)
+{
+  return (depth && current.start) ? edgex_device_nanotime_monotonic () : 0;
+}
+
+void edgex_trace_span (edgex_trace_stage stage, uint64_t start)
+{
+  if (start && depth && current.start && current.nspans < EDGEX_TRACE_MAXSPANS)
+  {
+    trace_span *s = &current.spans[current.nspans++];
+    s->stage = stage;
+    s->start = start;
+    s->end = edgex_device_nanotime_monotonic ();
+  }
+}
+
+void edgex_trace_end (edgex_trace_stage stage, const char *name)
+{
+  edgex_tracer_t *t;
+  if (depth == 0 || --depth || current.start == 0)
+  {
+    return;
+  }
+  current.end = edgex_device_nanotime_monotonic ();
+  current.stage = stage;
+  strncpy (current.name, name, TRACE_NAMELEN - 1);
+  current.name[TRACE_NAMELEN - 1] = '\0';
+
+  t = atomic_load_explicit (&tracer, memory_order_acquire);
+  if (t)
+  {
+    pthread_mutex_lock (&t->lock);
+    if (t->count == t->size)
+    {
+      t->dropped++;
+    }
+    else
+    {
+      t->records[(t->head + t->count) % t->size] = current;
+      if (t->count++ == 0)
+      {
+        pthread_cond_signal (&t->cond);
+      }
+    }
+    pthread_mutex_unlock (&t->lock);
+  }
+  current.start = 0;
+}
+
+edgex_trace_t *edgex_trace_suspend (void)
+{
+  edgex_trace_t *result;
+  if (depth == 0 || --depth || current.start == 0)
+  {
+    return NULL;
+  }
+  result = malloc (sizeof (edgex_trace_t));
+  result->record = current;
+  return result;
+}
+
+void edgex_trace_resume (edgex_trace_t *trace)
+{
+  if (depth++ == 0)
+  {
+    if (trace)
+    {
+      current = trace->record;
+    }
+    else
+    {
+      current.start = 0;
+    }
+  }
+  free (trace);
+}
+
+static void trace_member_time (edgex_jsonbuf *b, bool *first, const char *key, uint64_t t)
+{
+  char str[24];
+  snprintf (str, sizeof (str), "%" PRIu64, t);
+  edgex_jsonbuf_member_string (b, first, key, str);
+}
+
+static void trace_file_record (edgex_jsonbuf *b, const trace_record *r)
+{
+  bool first = true;
+  edgex_jsonbuf_appendc (b, '{');
+  edgex_jsonbuf_member_string (b, &first, "traceId", r->traceid);
+  edgex_jsonbuf_member_string (b, &first, "correlationId", r->crlid);
+  edgex_jsonbuf_member_string (b, &first, "kind", stagenames[r->stage]);
+  edgex_jsonbuf_member_string (b, &first, "name", r->name);
+  edgex_jsonbuf_member_uint (b, &first, "start", r->realstart);
+  edgex_jsonbuf_member_uint (b, &first, "duration", r->end - r->start);
+  edgex_jsonbuf_key (b, &first, "spans");
+  edgex_jsonbuf_appendc (b, '[');
+  for (unsigned i = 0; i < r->nspans; i++)
+  {
+    bool sfirst = true;
+    if (i)
+    {
+      edgex_jsonbuf_appendc (b, ',');
+    }
+    edgex_jsonbuf_appendc (b, '{');
+    edgex_jsonbuf_member_string (b, &sfirst, "stage", stagenames[r->spans[i].stage]);
+    edgex_jsonbuf_member_uint (b, &sfirst, "start", trace_realtime (r, r->spans[i].start));
+    edgex_jsonbuf_member_uint (b, &sfirst, "duration", r->spans[i].end - r->spans[i].start);
+    edgex_jsonbuf_appendc (b, '}');
+  }
+  trace_literal (b, "]}\n");
+}
+
+/* Span IDs are derived from the trace ID and start time, with the root span numbered 0 */
+
+static void trace_spanid (const trace_record *r, unsigned n, char *out)
+{
+  uint64_t x = r->realstart + n * 0x9e3779b97f4a7c15u;
+  for (const char *c = r->traceid; *c; c++)
+  {
+    x = (x ^ (unsigned char)*c) * 1099511628211u;
+  }
+  x ^= x >> 31;
+  x *= 0xbf58476d1ce4e5b9u;
+  x ^= x >> 27;
+  snprintf (out, 17, "%016" PRIx64, x ? x : 1);
+}
+
+static void trace_otlp_span
+  (edgex_jsonbuf *b, const trace_record *r, unsigned n, const char *name, int kind, uint64_t start, uint64_t end)
+{
+  bool first = true;
+  char spanid[17];
+  char parentid[17];
+
+  trace_spanid (r, n, spanid);
+  edgex_jsonbuf_appendc (b, '{');
+  edgex_jsonbuf_member_string (b, &first, "traceId", r->traceid);
+  edgex_jsonbuf_member_string (b, &first, "spanId", spanid);
+  if (n)
+  {
+    trace_spanid (r, 0, parentid);
+    edgex_jsonbuf_member_string (b, &first, "parentSpanId", parentid);
+  }
+  edgex_jsonbuf_member_string (b, &first, "name", name);
+  edgex_jsonbuf_member_uint (b, &first, "kind", kind);
+  trace_member_time (b, &first, "startTimeUnixNano", trace_realtime (r, start));
+  trace_member_time (b, &first, "endTimeUnixNano", trace_realtime (r, end));
+  if (n == 0)
+  {
+    edgex_jsonbuf_key (b, &first, "attributes");
+    trace_literal (b, "[{\"key\":\"edgex.correlation_id\",\"value\":{\"stringValue\":");
+    edgex_jsonbuf_string (b, r->crlid);
+    trace_literal (b, "}}]");
+  }
+  edgex_jsonbuf_appendc (b, '}');
+}
+
+/* OTLP span kinds: 1 is internal, 2 is server */
+
+static char *trace_otlp_body (edgex_tracer_t *t, const trace_record *records, uint32_t n)
+{
+  edgex_jsonbuf b;
+  edgex_jsonbuf_init (&b, 1024 * n);
+  trace_literal (&b, "{\"resourceSpans\":[{\"resource\":{\"attributes\":[{\"key\":\"service.name\",\"value\":{\"stringValue\":");
+  edgex_jsonbuf_string (&b, t->service);
+  trace_literal (&b, "}}]},\"scopeSpans\":[{\"scope\":{\"name\":\"device-sdk-c\"},\"spans\":[");
+  for (uint32_t i = 0; i < n; i++)
+  {
+    const trace_record *r = &records[i];
+    if (i)
+    {
+      edgex_jsonbuf_appendc (&b, ',');
+    }
+    trace_otlp_span (&b, r, 0, r->name, r->stage == EDGEX_TRACE_REQUEST ? 2 : 1, r->start, r->end);
+    for (unsigned s = 0; s < r->nspans; s++)
+    {
+      edgex_jsonbuf_appendc (&b, ',');
+      trace_otlp_span (&b, r, s + 1, stagenames[r->spans[s].stage], 1, r->spans[s].start, r->spans[s].end);
+    }
+  }
+  trace_literal (&b, "]}]}]}");
+  return edgex_jsonbuf_finish (&b);
+}
+
+/* Export failures are counted but not logged, as logging may itself be traced */
+
+static bool trace_export (edgex_tracer_t *t, const trace_record *records, uint32_t n)
+{
+  bool ok = true;
+  if (t->exporter == TRACE_FILE)
+  {
+    edgex_jsonbuf b;
+    edgex_jsonbuf_init (&b, 1024 * n);
+    for (uint32_t i = 0; i < n; i++)
+    {
+      trace_file_record (&b, &records[i]);
+    }
+    char *lines = edgex_jsonbuf_finish (&b);
+    ok = t->f && fputs (lines, t->f) >= 0 && fflush (t->f) == 0;
+    free (lines);
+  }
+  else
+  {
+    edgex_ctx ctx;
+    edgex_error err = EDGEX_OK;
+    char *body = trace_otlp_body (t, records, n);
+    memset (&ctx, 0, sizeof (ctx));
+    edgex_http_post (iot_logger_default (), &ctx, t->destination, body, NULL, &err);
+    free (body);
+    ok = (err.code == 0);
+  }
+  return ok;
+}
+
+static void *trace_thread (void *p)
+{
+  edgex_tracer_t *t = (edgex_tracer_t *)p;
+  trace_record *out = malloc (t->size * sizeof (trace_record));
+
+  edgex_placement_apply (EDGEX_PLACEMENT_IO);
+
+  pthread_mutex_lock (&t->lock);
+  while (t->running || t->count)
+  {
+    uint32_t n;
+    if (t->count == 0)
+    {
+      pthread_cond_wait (&t->cond, &t->lock);
+      continue;
+    }
+    for (n = 0; n < t->count; n++)
+    {
+      out[n] = t->records[(t->head + n) % t->size];
+    }
+    t->head = (t->head + n) % t->size;
+    t->count = 0;
+    pthread_mutex_unlock (&t->lock);
+    bool ok = trace_export (t, out, n);
+    pthread_mutex_lock (&t->lock);
+    if (ok)
+    {
+      t->exported += n;
+    }
+    else
+    {
+      t->failed += n;
+    }
+  }
+  pthread_mutex_unlock (&t->lock);
+  free (out);
+  return NULL;
+}
+
+edgex_tracer_t *edgex_tracer_alloc
+(
+  iot_logger_t *lc,
+  const char *service,
+  const char *exporter,
+  const char *destination,
+  uint32_t size,
+  edgex_error *err
+)
+{
+  edgex_tracer_t *t;
+  trace_exporter e;
+
+  for (e = TRACE_FILE; e <= TRACE_OTLP; e++)
+  {
+    if (strcasecmp (exporter, exporternames[e]) == 0)
+    {
+      break;
+    }
+  }
+  if (e > TRACE_OTLP)
+  {
+    iot_log_error (lc, "Invalid Tracing Exporter %s", exporter);
+    *err = EDGEX_BAD_CONFIG;
+    return NULL;
+  }
+  if (destination == NULL || *destination == '\0')
+  {
+    iot_log_error (lc, "Tracing Destination must be set for the %s exporter", exporternames[e]);
+    *err = EDGEX_BAD_CONFIG;
+    return NULL;
+  }
+
+  t = calloc (1, sizeof (edgex_tracer_t));
+  t->service = strdup (service);
+  t->destination = strdup (destination);
+  t->exporter = e;
+  if (e == TRACE_FILE)
+  {
+    t->f = fopen (destination, "a");
+    if (t->f == NULL)
+    {
+      iot_log_error (lc, "Unable to open trace file %s", destination);
+    }
+  }
+  t->size = size ? size : EDGEX_TRACE_DEFAULT_BUFFER;
+  t->records = malloc (t->size * sizeof (trace_record));
+  pthread_mutex_init (&t->lock, NULL);
+  pthread_cond_init (&t->cond, NULL);
+  t->running = true;
+  pthread_create (&t->thread, NULL, trace_thread, t);
+  return t;
+}
+
+void edgex_tracer_getstats (edgex_tracer_t *t, edgex_tracer_stats *stats)
+{
+  pthread_mutex_lock (&t->lock);
+  stats->exported = t->exported;
+  stats->dropped = t->dropped;
+  stats->failed = t->failed;
+  pthread_mutex_unlock (&t->lock);
+}
+
+const char *edgex_tracer_exportername (const edgex_tracer_t *t)
+{
+  return exporternames[t->exporter];
+}
+
+void edgex_trace_settracer (edgex_tracer_t *t)
+{
+  atomic_store_explicit (&tracer, t, memory_order_release);
+}
+
+void edgex_tracer_free (edgex_tracer_t *t)
+{
+  if (t)
+  {
+    pthread_mutex_lock (&t->lock);
+    t->running = false;
+    pthread_cond_signal (&t->cond);
+    pthread_mutex_unlock (&t->lock);
+    pthread_join (t->thread, NULL);
+    if (t->f)
+    {
+      fclose (t->f);
+    }
+    pthread_cond_destroy (&t->cond);
+    pthread_mutex_destroy (&t->lock);
+    free (t->records);
+    free (t->destination);
+    free (t->service);
+    free (t);
+  }
+}
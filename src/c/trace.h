@@ -0,0 +1,117 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#ifndef _EDGEX_DEVICE_TRACE_H_
+#define _EDGEX_DEVICE_TRACE_H_ 1
+
+#include "edgex/edgex-logging.h"
+#include "edgex/error.h"
+
+#include <stdint.h>
+
+/*
+ * Span tracing. A trace covers the handling of a REST request or an
+ * AutoEvent run on one thread, and is identified by the correlation ID in
+ * effect when it begins. The stages of processing within it are recorded as
+ * spans, and the completed trace is passed to an exporter which runs on a
+ * thread of its own. Exporters are:
+ *
+ *   File - each trace is appended to a file as a line of JSON.
+ *   OTLP - traces are posted in batches to an OpenTelemetry collector, using
+ *          the OTLP/HTTP JSON encoding.
+ *
+ * Traces completed while the exporter's buffer is full are dropped. When no
+ * tracer is set, the functions here do nothing beyond testing for it.
+ */
+
+#define EDGEX_TRACE_DEFAULT_BUFFER 256
+
+/* The maximum number of spans recorded in a trace; further ones are not recorded */
+
+#define EDGEX_TRACE_MAXSPANS 32
+
+typedef enum
+{
+  EDGEX_TRACE_REQUEST,
+  EDGEX_TRACE_AUTOEVENT,
+  EDGEX_TRACE_LOOKUP,
+  EDGEX_TRACE_DRIVER,
+  EDGEX_TRACE_TRANSFORM,
+  EDGEX_TRACE_ENCODE,
+  EDGEX_TRACE_HTTP,
+  EDGEX_TRACE_RESPONSE
+} edgex_trace_stage;
+
+typedef struct edgex_tracer_t edgex_tracer_t;
+
+typedef struct edgex_tracer_stats
+{
+  uint64_t exported;
+  uint64_t dropped;
+  uint64_t failed;
+} edgex_tracer_stats;
+
+/*
+ * exporter: File or OTLP.
+ * destination: the file's path, or the collector's URL for traces (eg http://localhost:4318/v1/traces).
+ * size: the maximum number of completed traces awaiting export.
+ */
+
+edgex_tracer_t *edgex_tracer_alloc
+(
+  iot_logger_t *lc,
+  const char *service,
+  const char *exporter,
+  const char *destination,
+  uint32_t size,
+  edgex_error *err
+);
+
+void edgex_tracer_getstats (edgex_tracer_t *t, edgex_tracer_stats *stats);
+
+const char *edgex_tracer_exportername (const edgex_tracer_t *t);
+
+/* Traces are recorded while a tracer is set. NULL stops tracing */
+
+void edgex_trace_settracer (edgex_tracer_t *t);
+
+/* Exports any completed traces and stops the thread */
+
+void edgex_tracer_free (edgex_tracer_t *t);
+
+/* Begin a trace on this thread for the current correlation ID. Does nothing if tracing is not enabled */
+
+void edgex_trace_begin (void);
+
+/* The time at which a span starts, 0 if no trace is in progress on this thread */
+
+uint64_t edgex_trace_start (void);
+
+/* Record a span from start until now, if start is non-zero */
+
+void edgex_trace_span (edgex_trace_stage stage, uint64_t start);
+
+/* Complete the trace in progress on this thread, if any. The name describes the request or AutoEvent */
+
+void edgex_trace_end (edgex_trace_stage stage, const char *name);
+
+/*
+ * For work which completes on another thread: edgex_trace_suspend detaches
+ * the trace begun on this thread, as edgex_trace_end would complete it, and
+ * edgex_trace_resume continues it (or nothing, if NULL) on the completing
+ * thread as edgex_trace_begin would begin one. It is then completed there by
+ * edgex_trace_end. Returns NULL if no trace is being recorded here.
+ */
+
+typedef struct edgex_trace_t edgex_trace_t;
+
+edgex_trace_t *edgex_trace_suspend (void);
+
+void edgex_trace_resume (edgex_trace_t *trace);
+
+#endif
@@ -7,37 +7,22 @@
  */
 
 #include "transform.h"
+#include "bufpool.h"
 
+#include <stdlib.h>
 #include <math.h>
 #include <limits.h>
 #include <float.h>
 #include <assert.h>
 
-static bool transformsOn (const edgex_propertyvalue *pv)
+static double getDouble (edgex_device_resultvalue value, edgex_propertytype type)
 {
-  return (pv->offset.enabled || pv->scale.enabled || pv->base.enabled || pv->shift.enabled || pv->mask.enabled);
+  return (type == Float64) ? value.f64_result : value.f32_result;
 }
 
-static const char *checkMapping (const edgex_nvpairs *map, const char *in)
+static bool setLongDouble (long double ldval, edgex_device_resultvalue *value, edgex_propertytype type)
 {
-  for (const edgex_nvpairs *pair = map; pair; pair = pair->next)
-  {
-    if (strcmp (in, pair->name) == 0)
-    {
-      return pair->value;
-    }
-  }
-  return NULL;
-}
-
-static long double getLongDouble (edgex_device_resultvalue value, edgex_propertyvalue *props)
-{
-  return (props->type == Float64) ? value.f64_result : value.f32_result;
-}
-
-static bool setLongDouble (long double ldval, edgex_device_resultvalue *value, edgex_propertyvalue *props)
-{
-  if (props->type == Float64)
+  if (type == Float64)
   {
     if (ldval <= DBL_MAX && ldval >= -DBL_MAX)
     {
@@ -57,9 +42,9 @@ static bool setLongDouble (long double ldval, edgex_device_resultvalue *value, e
   }
 }
 
-static long long int getLLInt (edgex_device_resultvalue value, edgex_propertyvalue *props)
+static long long int getLLInt (edgex_device_resultvalue value, edgex_propertytype type)
 {
-  switch (props->type)
+  switch (type)
   {
     case Uint8: return value.ui8_result; break;
     case Uint16: return value.ui16_result; break;
@@ -73,9 +58,9 @@ static long long int getLLInt (edgex_device_resultvalue value, edgex_propertyval
   }
 }
 
-static bool setLLInt (long long int llival, edgex_device_resultvalue *value, edgex_propertyvalue *props)
+static bool setLLInt (long long int llival, edgex_device_resultvalue *value, edgex_propertytype type)
 {
-  switch (props->type)
+  switch (type)
   {
     case Uint8:
       if (llival >= 0 && llival <= UCHAR_MAX)
@@ -139,27 +124,52 @@ static bool setLLInt (long long int llival, edgex_device_resultvalue *value, edg
   return false;
 }
 
-void edgex_transform_outgoing
-  (edgex_device_commandresult *cres, edgex_propertyvalue *props, edgex_nvpairs *mappings)
+static void intOp (edgex_transform_op *ops, unsigned *n, edgex_transform_opcode op, long long int arg)
 {
+  ops[*n].op = op;
+  if (op == EDGEX_XF_LOG)
+  {
+    ops[*n].arg.l = logl (arg);
+  }
+  else
+  {
+    ops[*n].arg.i = arg;
+  }
+  (*n)++;
+}
+
+static void floatOp (edgex_transform_op *ops, unsigned *n, edgex_transform_opcode op, double arg)
+{
+  ops[*n].op = op;
+  if (op == EDGEX_XF_LOG)
+  {
+    ops[*n].arg.l = logl (arg);
+  }
+  else
+  {
+    ops[*n].arg.d = arg;
+  }
+  (*n)++;
+}
+
+void edgex_transform_compile (const edgex_propertyvalue *props, edgex_transform *xf)
+{
+  memset (xf, 0, sizeof (edgex_transform));
+  xf->type = props->type;
+
   switch (props->type)
   {
     case Float32:
     case Float64:
-    if (transformsOn (props))
-    {
-      long double result = getLongDouble (cres->value, props);
-      if (props->base.enabled) result = powl (props->base.value.dval, result);
-      if (props->scale.enabled) result *= props->scale.value.dval;
-      if (props->offset.enabled) result += props->offset.value.dval;
+      xf->wide = props->base.enabled;
+      if (props->base.enabled) floatOp (xf->out, &xf->nout, EDGEX_XF_POW, props->base.value.dval);
+      if (props->scale.enabled) floatOp (xf->out, &xf->nout, EDGEX_XF_MUL, props->scale.value.dval);
+      if (props->offset.enabled) floatOp (xf->out, &xf->nout, EDGEX_XF_ADD, props->offset.value.dval);
 
-      if (!setLongDouble (result, &cres->value, props))
-      {
-        cres->type = String;
-        cres->value.string_result = strdup ("overflow");
-      }
-    }
-    break;
+      if (props->offset.enabled) floatOp (xf->in, &xf->nin, EDGEX_XF_SUB, props->offset.value.dval);
+      if (props->scale.enabled) floatOp (xf->in, &xf->nin, EDGEX_XF_DIV, props->scale.value.dval);
+      if (props->base.enabled) floatOp (xf->in, &xf->nin, EDGEX_XF_LOG, props->base.value.dval);
+      break;
     case Uint8:
     case Uint16:
     case Uint32:
@@ -168,103 +178,329 @@ void edgex_transform_outgoing
     case Int16:
     case Int32:
     case Int64:
-    if (transformsOn (props))
     {
-      long long int result = getLLInt (cres->value, props);
-      if (props->mask.enabled) result &= props->mask.value.ival;
-      if (props->shift.enabled)
-      {
-        if (props->shift.value.ival < 0)
-        {
-          result <<= -props->shift.value.ival;
-        }
-        else
-        {
-          result >>= props->shift.value.ival;
-        }
-      }
-      if (props->base.enabled) result = powl (props->base.value.ival, result);
-      if (props->scale.enabled) result *= props->scale.value.ival;
-      if (props->offset.enabled) result += props->offset.value.ival;
+      long long int shift = props->shift.value.ival;
+      if (props->mask.enabled) intOp (xf->out, &xf->nout, EDGEX_XF_MASK, props->mask.value.ival);
+      if (props->shift.enabled) intOp (xf->out, &xf->nout, shift < 0 ? EDGEX_XF_SHL : EDGEX_XF_SHR, llabs (shift));
+      if (props->base.enabled) intOp (xf->out, &xf->nout, EDGEX_XF_POW, props->base.value.ival);
+      if (props->scale.enabled) intOp (xf->out, &xf->nout, EDGEX_XF_MUL, props->scale.value.ival);
+      if (props->offset.enabled) intOp (xf->out, &xf->nout, EDGEX_XF_ADD, props->offset.value.ival);
 
-      if (!setLLInt (result, &cres->value, props))
-      {
-        cres->type = String;
-        cres->value.string_result = strdup ("overflow");
-      }
+      if (props->offset.enabled) intOp (xf->in, &xf->nin, EDGEX_XF_SUB, props->offset.value.ival);
+      if (props->scale.enabled) intOp (xf->in, &xf->nin, EDGEX_XF_DIV, props->scale.value.ival);
+      if (props->base.enabled) intOp (xf->in, &xf->nin, EDGEX_XF_LOG, props->base.value.ival);
+      if (props->shift.enabled) intOp (xf->in, &xf->nin, shift < 0 ? EDGEX_XF_SHR : EDGEX_XF_SHL, llabs (shift));
+      // Mask transform NYI. Possibly will be done in the driver.
+      break;
     }
-    break;
-    case String:
+    default:
+      break;
+  }
+}
+
+static long long int runInt (const edgex_transform_op *ops, unsigned n, long long int val)
+{
+  for (unsigned i = 0; i < n; i++)
+  {
+    switch (ops[i].op)
     {
-      const char *remap = checkMapping (mappings, cres->value.string_result);
-      if (remap)
-      {
-        free (cres->value.string_result);
-        cres->value.string_result = strdup (remap);
-      }
+      case EDGEX_XF_MASK: val &= ops[i].arg.i; break;
+      case EDGEX_XF_SHL: val <<= ops[i].arg.i; break;
+      case EDGEX_XF_SHR: val >>= ops[i].arg.i; break;
+      case EDGEX_XF_POW: val = powl (ops[i].arg.i, val); break;
+      case EDGEX_XF_MUL: val *= ops[i].arg.i; break;
+      case EDGEX_XF_ADD: val += ops[i].arg.i; break;
+      case EDGEX_XF_SUB: val -= ops[i].arg.i; break;
+      case EDGEX_XF_DIV: val /= ops[i].arg.i; break;
+      case EDGEX_XF_LOG: val = llroundl (logl (val) / ops[i].arg.l); break;
     }
-    default:
-    break;
   }
+  return val;
 }
 
-bool edgex_transform_incoming
-  (edgex_device_commandresult *cres, edgex_propertyvalue *props, edgex_nvpairs *mappings)
+/* Scale and offset only */
+
+static double runDouble (const edgex_transform_op *ops, unsigned n, double val)
 {
-  bool success = true;
-  switch (props->type)
+  for (unsigned i = 0; i < n; i++)
   {
-    case Float32:
-    case Float64:
-    if (transformsOn (props))
+    switch (ops[i].op)
     {
-      long double result = getLongDouble (cres->value, props);
-      if (props->offset.enabled) result -= props->offset.value.dval;
-      if (props->scale.enabled) result /= props->scale.value.dval;
-      if (props->base.enabled) result = logl (result) / logl (props->base.value.dval);
-      success = setLongDouble (result, &cres->value, props);
+      case EDGEX_XF_MUL: val *= ops[i].arg.d; break;
+      case EDGEX_XF_ADD: val += ops[i].arg.d; break;
+      case EDGEX_XF_SUB: val -= ops[i].arg.d; break;
+      case EDGEX_XF_DIV: val /= ops[i].arg.d; break;
+      default: assert (0);
     }
-    break;
-    case Uint8:
-    case Uint16:
-    case Uint32:
-    case Uint64:
-    case Int8:
-    case Int16:
-    case Int32:
-    case Int64:
-    if (transformsOn (props))
+  }
+  return val;
+}
+
+static long double runLongDouble (const edgex_transform_op *ops, unsigned n, long double val)
+{
+  for (unsigned i = 0; i < n; i++)
+  {
+    switch (ops[i].op)
+    {
+      case EDGEX_XF_POW: val = powl (ops[i].arg.d, val); break;
+      case EDGEX_XF_MUL: val *= ops[i].arg.d; break;
+      case EDGEX_XF_ADD: val += ops[i].arg.d; break;
+      case EDGEX_XF_SUB: val -= ops[i].arg.d; break;
+      case EDGEX_XF_DIV: val /= ops[i].arg.d; break;
+      case EDGEX_XF_LOG: val = logl (val) / ops[i].arg.l; break;
+      default: assert (0);
+    }
+  }
+  return val;
+}
+
+static bool transformNumeric (edgex_device_commandresult *cres, const edgex_transform *xf, bool outgoing)
+{
+  const edgex_transform_op *ops = outgoing ? xf->out : xf->in;
+  unsigned n = outgoing ? xf->nout : xf->nin;
+
+  if (xf->type == Float32 || xf->type == Float64)
+  {
+    double val = getDouble (cres->value, xf->type);
+    return setLongDouble (xf->wide ? runLongDouble (ops, n, val) : runDouble (ops, n, val), &cres->value, xf->type);
+  }
+  return setLLInt (runInt (ops, n, getLLInt (cres->value, xf->type)), &cres->value, xf->type);
+}
+
+edgex_map_string *edgex_transform_mappings (const edgex_nvpairs *pairs)
+{
+  edgex_map_string *result;
+  unsigned n = 0;
+
+  if (pairs == NULL)
+  {
+    return NULL;
+  }
+  for (const edgex_nvpairs *pair = pairs; pair; pair = pair->next)
+  {
+    n++;
+  }
+  result = malloc (sizeof (edgex_map_string));
+  edgex_map_init (result);
+  edgex_map_reserve (result, n);
+  for (const edgex_nvpairs *pair = pairs; pair; pair = pair->next)
+  {
+    if (edgex_map_get (result, pair->name) == NULL)
+    {
+      edgex_map_set (result, pair->name, pair->value);
+    }
+  }
+  return result;
+}
+
+void edgex_transform_mappings_free (edgex_map_string *mappings)
+{
+  if (mappings)
+  {
+    edgex_map_deinit (mappings);
+    free (mappings);
+  }
+}
+
+/*
+ * The lookup does not modify the table, so it may be shared between threads.
+ * The mapped value is copied over the reading, which is only reallocated if the
+ * value is longer.
+ */
+
+static void remapString (edgex_device_commandresult *cres, const edgex_map_string *mappings)
+{
+  char **remap;
+  size_t len;
+
+  if (mappings == NULL || cres->value.string_result == NULL)
+  {
+    return;
+  }
+  remap = edgex_map_get_ ((edgex_map_base *)&mappings->base, cres->value.string_result);
+  if (remap)
+  {
+    len = strlen (*remap);
+    if (len > strlen (cres->value.string_result))
     {
-      long long int result = getLLInt (cres->value, props);
-      if (props->offset.enabled) result -= props->offset.value.ival;
-      if (props->scale.enabled) result /= props->scale.value.ival;
-      if (props->base.enabled) result = llroundl (logl (result) / logl (props->base.value.ival));
-      if (props->shift.enabled)
+      cres->value.string_result = edgex_bufpool_realloc (cres->value.string_result, len + 1);
+    }
+    memcpy (cres->value.string_result, *remap, len + 1);
+  }
+}
+
+void edgex_transform_outgoing
+  (edgex_device_commandresult *cres, const edgex_transform *xf, const edgex_map_string *mappings)
+{
+  if (xf->type == String)
+  {
+    remapString (cres, mappings);
+  }
+  else if (xf->nout && !transformNumeric (cres, xf, true))
+  {
+    cres->type = String;
+    cres->value.string_result = strdup ("overflow");
+  }
+}
+
+/* Process readings in chunks of this size, held in local arrays */
+
+#define XF_BLOCK 256
+
+static bool blockable (const edgex_transform *xf)
+{
+  if (xf->type == Float32 || xf->type == Float64)
+  {
+    return !xf->wide;
+  }
+  for (unsigned i = 0; i < xf->nout; i++)
+  {
+    if (xf->out[i].op == EDGEX_XF_POW)
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+static void blockInt (long long int *buf, unsigned len, const edgex_transform_op *op)
+{
+  long long int arg = op->arg.i;
+  switch (op->op)
+  {
+    case EDGEX_XF_MASK: for (unsigned j = 0; j < len; j++) buf[j] &= arg; break;
+    case EDGEX_XF_SHL: for (unsigned j = 0; j < len; j++) buf[j] <<= arg; break;
+    case EDGEX_XF_SHR: for (unsigned j = 0; j < len; j++) buf[j] >>= arg; break;
+    case EDGEX_XF_MUL: for (unsigned j = 0; j < len; j++) buf[j] *= arg; break;
+    case EDGEX_XF_ADD: for (unsigned j = 0; j < len; j++) buf[j] += arg; break;
+    default: assert (0);
+  }
+}
+
+static void blockDouble (double *buf, unsigned len, const edgex_transform_op *op)
+{
+  double arg = op->arg.d;
+  switch (op->op)
+  {
+    case EDGEX_XF_MUL: for (unsigned j = 0; j < len; j++) buf[j] *= arg; break;
+    case EDGEX_XF_ADD: for (unsigned j = 0; j < len; j++) buf[j] += arg; break;
+    default: assert (0);
+  }
+}
+
+void edgex_transform_outgoing_block (edgex_device_commandresult *cres, unsigned n, const edgex_transform *xf)
+{
+  if (xf->nout == 0)
+  {
+    return;
+  }
+  if (!blockable (xf))
+  {
+    for (unsigned i = 0; i < n; i++)
+    {
+      edgex_transform_outgoing (&cres[i], xf, NULL);
+    }
+    return;
+  }
+
+  for (unsigned base = 0; base < n; base += XF_BLOCK)
+  {
+    unsigned len = (n - base < XF_BLOCK) ? n - base : XF_BLOCK;
+    edgex_device_commandresult *block = cres + base;
+    bool ok;
+
+    if (xf->type == Float32 || xf->type == Float64)
+    {
+      double buf[XF_BLOCK];
+      for (unsigned j = 0; j < len; j++)
       {
-        if (props->shift.value.ival < 0)
-        {
-          result >>= -props->shift.value.ival;
-        }
-        else
+        buf[j] = getDouble (block[j].value, xf->type);
+      }
+      for (unsigned i = 0; i < xf->nout; i++)
+      {
+        blockDouble (buf, len, &xf->out[i]);
+      }
+      for (unsigned j = 0; j < len; j++)
+      {
+        ok = setLongDouble (buf[j], &block[j].value, xf->type);
+        if (!ok)
         {
-          result <<= props->shift.value.ival;
+          block[j].type = String;
+          block[j].value.string_result = strdup ("overflow");
         }
       }
-      // Mask transform NYI. Possibly will be done in the driver.
-      success = setLLInt (result, &cres->value, props);
     }
-    break;
-    case String:
+    else
     {
-      const char *remap = checkMapping (mappings, cres->value.string_result);
-      if (remap)
+      long long int buf[XF_BLOCK];
+      for (unsigned j = 0; j < len; j++)
+      {
+        buf[j] = getLLInt (block[j].value, xf->type);
+      }
+      for (unsigned i = 0; i < xf->nout; i++)
+      {
+        blockInt (buf, len, &xf->out[i]);
+      }
+      for (unsigned j = 0; j < len; j++)
       {
-        free (cres->value.string_result);
-        cres->value.string_result = strdup (remap);
+        ok = setLLInt (buf[j], &block[j].value, xf->type);
+        if (!ok)
+        {
+          block[j].type = String;
+          block[j].value.string_result = strdup ("overflow");
+        }
       }
     }
-    default:
-    break;
   }
-  return success;
+}
+
+/*
+ * Operations are compared by the member of their argument which is in use,
+ * as the others (and the padding of a long double) need not be the same.
+ */
+
+static bool opsEqual (edgex_propertytype type, const edgex_transform_op *a, const edgex_transform_op *b, unsigned n)
+{
+  for (unsigned i = 0; i < n; i++)
+  {
+    bool same;
+    if (a[i].op != b[i].op)
+    {
+      return false;
+    }
+    if (a[i].op == EDGEX_XF_LOG)
+    {
+      same = (a[i].arg.l == b[i].arg.l);
+    }
+    else if (type == Float32 || type == Float64)
+    {
+      same = (a[i].arg.d == b[i].arg.d);
+    }
+    else
+    {
+      same = (a[i].arg.i == b[i].arg.i);
+    }
+    if (!same)
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool edgex_transform_equal (const edgex_transform *a, const edgex_transform *b)
+{
+  return a->type == b->type && a->wide == b->wide && a->nout == b->nout && a->nin == b->nin &&
+    opsEqual (a->type, a->out, b->out, a->nout) && opsEqual (a->type, a->in, b->in, a->nin);
+}
+
+bool edgex_transform_incoming
+  (edgex_device_commandresult *cres, const edgex_transform *xf, const edgex_map_string *mappings)
+{
+  if (xf->type == String)
+  {
+    remapString (cres, mappings);
+    return true;
+  }
+  return xf->nin ? transformNumeric (cres, xf, false) : true;
 }
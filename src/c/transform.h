@@ -11,11 +11,79 @@
 
 #include "edgex/devsdk.h"
 #include "edgex/edgex.h"
+#include "map.h"
+
+/*
+ * The transforms specified for a device resource are compiled into sequences
+ * of operations, one for each direction, containing only those which are
+ * enabled. Integer values are transformed using integer arithmetic (except
+ * for base) and floating point values using double precision, unless a base is
+ * specified when long double is used throughout.
+ */
+
+typedef enum
+{
+  EDGEX_XF_MASK,
+  EDGEX_XF_SHL,
+  EDGEX_XF_SHR,
+  EDGEX_XF_POW,
+  EDGEX_XF_MUL,
+  EDGEX_XF_ADD,
+  EDGEX_XF_SUB,
+  EDGEX_XF_DIV,
+  EDGEX_XF_LOG
+} edgex_transform_opcode;
+
+typedef struct edgex_transform_op
+{
+  edgex_transform_opcode op;
+  union
+  {
+    long long int i;
+    double d;
+    long double l;
+  } arg;
+} edgex_transform_op;
+
+typedef struct edgex_transform
+{
+  edgex_propertytype type;
+  bool wide;
+  unsigned nout;
+  unsigned nin;
+  edgex_transform_op out[5];
+  edgex_transform_op in[4];
+} edgex_transform;
+
+void edgex_transform_compile (const edgex_propertyvalue *props, edgex_transform *xf);
+
+/*
+ * The value mappings of a resource operation are indexed by a hash table when
+ * the profile is loaded. The table refers to the names and values held in the
+ * profile. Returns NULL if there are no mappings. Where a name is repeated the
+ * first mapping for it is used.
+ */
+
+edgex_map_string *edgex_transform_mappings (const edgex_nvpairs *pairs);
+
+void edgex_transform_mappings_free (edgex_map_string *mappings);
 
 void edgex_transform_outgoing
-  (edgex_device_commandresult *cres, edgex_propertyvalue *props, edgex_nvpairs *mappings);
+  (edgex_device_commandresult *cres, const edgex_transform *xf, const edgex_map_string *mappings);
+
+/*
+ * Apply a transform to a block of n numeric readings of the same resource
+ * type. Where the operations allow, each is applied across the whole block
+ * in a simple loop which the compiler can vectorize for the target.
+ */
+
+void edgex_transform_outgoing_block (edgex_device_commandresult *cres, unsigned n, const edgex_transform *xf);
+
+/* Whether two transforms have the same type and operations, so that readings for them may be transformed as a block */
+
+bool edgex_transform_equal (const edgex_transform *a, const edgex_transform *b);
 
 bool edgex_transform_incoming
-  (edgex_device_commandresult *cres, edgex_propertyvalue *props, edgex_nvpairs *mappings);
+  (edgex_device_commandresult *cres, const edgex_transform *xf, const edgex_map_string *mappings);
 
 #endif
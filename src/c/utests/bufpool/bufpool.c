@@ -0,0 +1,183 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#include "CUnit.h"
+#include "bufpool.h"
+#include "../../bufpool.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#define TEST_NBUFS 200
+
+static int suite_init (void)
+{
+  return 0;
+}
+
+static int suite_clean (void)
+{
+  return 0;
+}
+
+static uint64_t fallbacks (void)
+{
+  edgex_bufpool_stats stats;
+  edgex_bufpool_getstats (&stats);
+  return stats.fallback;
+}
+
+static uint64_t used (void)
+{
+  edgex_bufpool_stats stats;
+  edgex_bufpool_getstats (&stats);
+  return stats.used;
+}
+
+/* A buffer of the largest size for a class is resized in place up to that size, and moves on growing past it */
+
+static void test_boundaries (void)
+{
+  for (unsigned c = 0; c < EDGEX_BUFPOOL_CLASSES; c++)
+  {
+    size_t max = EDGEX_BUFPOOL_CSIZE (c) - EDGEX_BUFPOOL_HDR;
+    uint64_t fb = fallbacks ();
+    char *buf = edgex_device_buffer_alloc (max);
+    char *next;
+
+    CU_ASSERT_PTR_NOT_NULL_FATAL (buf);
+    CU_ASSERT_EQUAL (fallbacks (), fb);
+    memset (buf, 'x', max);
+    CU_ASSERT_PTR_EQUAL (edgex_bufpool_realloc (buf, max), buf);
+    CU_ASSERT_PTR_EQUAL (edgex_bufpool_realloc (buf, 1), buf);
+    CU_ASSERT_PTR_EQUAL (edgex_bufpool_realloc (buf, max), buf);
+    edgex_device_buffer_free (buf);
+
+    /* One byte more is met from the next class, or from malloc beyond the last */
+
+    next = edgex_device_buffer_alloc (max + 1);
+    CU_ASSERT_PTR_NOT_NULL_FATAL (next);
+    memset (next, 'y', max + 1);
+    if (c + 1 < EDGEX_BUFPOOL_CLASSES)
+    {
+      CU_ASSERT_EQUAL (fallbacks (), fb);
+      CU_ASSERT_PTR_EQUAL (edgex_bufpool_realloc (next, EDGEX_BUFPOOL_CSIZE (c + 1) - EDGEX_BUFPOOL_HDR), next);
+    }
+    else
+    {
+      CU_ASSERT_EQUAL (fallbacks (), fb + 1);
+    }
+    edgex_device_buffer_free (next);
+  }
+}
+
+static void test_realloc (void)
+{
+  char *buf = edgex_bufpool_realloc (NULL, 20);
+  char *grown;
+  uint64_t fb;
+
+  CU_ASSERT_PTR_NOT_NULL_FATAL (buf);
+  for (int i = 0; i < 20; i++)
+  {
+    buf[i] = i;
+  }
+
+  /* Within the 32 byte class the buffer stays put */
+
+  CU_ASSERT_PTR_EQUAL (edgex_bufpool_realloc (buf, 32 - EDGEX_BUFPOOL_HDR), buf);
+
+  /* Across classes the contents are copied */
+
+  grown = edgex_bufpool_realloc (buf, 1000);
+  CU_ASSERT_PTR_NOT_NULL_FATAL (grown);
+  CU_ASSERT_PTR_NOT_EQUAL (grown, buf);
+  for (int i = 0; i < 16; i++)
+  {
+    CU_ASSERT_EQUAL (grown[i], i);
+  }
+  memset (grown, 'z', 1000);
+
+  /* And out of the pool altogether, to malloc */
+
+  fb = fallbacks ();
+  buf = edgex_bufpool_realloc (grown, 100000);
+  CU_ASSERT_PTR_NOT_NULL_FATAL (buf);
+  CU_ASSERT_EQUAL (fallbacks (), fb + 1);
+  CU_ASSERT_EQUAL (buf[0], 'z');
+  CU_ASSERT_EQUAL (buf[999], 'z');
+  buf[99999] = 'z';
+  edgex_device_buffer_free (buf);
+}
+
+/* Memory from malloc may be passed to the pool's functions */
+
+static void test_malloc (void)
+{
+  char *buf = malloc (100);
+  char *grown;
+
+  memset (buf, 'm', 100);
+  grown = edgex_bufpool_realloc (buf, 200);
+  CU_ASSERT_PTR_NOT_NULL_FATAL (grown);
+  CU_ASSERT_EQUAL (grown[99], 'm');
+  edgex_device_buffer_free (grown);
+  edgex_device_buffer_free (malloc (1));
+  edgex_device_buffer_free (NULL);
+}
+
+/* Buffers freed on another thread return to the shared lists when it exits, and are reused */
+
+static void *free_all (void *p)
+{
+  char **bufs = (char **)p;
+  for (int i = 0; i < TEST_NBUFS; i++)
+  {
+    edgex_device_buffer_free (bufs[i]);
+  }
+  return NULL;
+}
+
+static void test_thread (void)
+{
+  char *bufs[TEST_NBUFS];
+  pthread_t thread;
+  uint64_t before;
+
+  for (int i = 0; i < TEST_NBUFS; i++)
+  {
+    bufs[i] = edgex_device_buffer_alloc (300);
+    CU_ASSERT_PTR_NOT_NULL_FATAL (bufs[i]);
+    memset (bufs[i], i, 300);
+  }
+  before = used ();
+  pthread_create (&thread, NULL, free_all, bufs);
+  pthread_join (thread, NULL);
+
+  for (int i = 0; i < TEST_NBUFS; i++)
+  {
+    bufs[i] = edgex_device_buffer_alloc (300);
+    CU_ASSERT_PTR_NOT_NULL_FATAL (bufs[i]);
+    memset (bufs[i], i, 300);
+  }
+  CU_ASSERT_EQUAL (used (), before);
+  for (int i = 0; i < TEST_NBUFS; i++)
+  {
+    edgex_device_buffer_free (bufs[i]);
+  }
+}
+
+void cunit_bufpool_test_init (void)
+{
+  CU_pSuite suite = CU_add_suite ("bufpool", suite_init, suite_clean);
+  CU_add_test (suite, "test_boundaries", test_boundaries);
+  CU_add_test (suite, "test_realloc", test_realloc);
+  CU_add_test (suite, "test_malloc", test_malloc);
+  CU_add_test (suite, "test_thread", test_thread);
+}
@@ -0,0 +1,151 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#include "CUnit.h"
+#include "circuit.h"
+#include "../../circuit.h"
+
+#include <time.h>
+
+/* A read every 5ms backs off for 10ms after one failure; two failures open the circuit, probing every 40ms */
+
+#define TEST_INTERVAL 5
+#define TEST_MAXBACKOFF 40
+#define TEST_LIMIT 2
+
+static int suite_init (void)
+{
+  return 0;
+}
+
+static int suite_clean (void)
+{
+  return 0;
+}
+
+static void sleep_ms (long ms)
+{
+  struct timespec ts = { ms / 1000, (ms % 1000) * 1000000 };
+  nanosleep (&ts, NULL);
+}
+
+static void test_closed (void)
+{
+  edgex_circuit_stats stats;
+  edgex_circuit_t *c = edgex_circuit_alloc (iot_logger_default (), TEST_MAXBACKOFF, TEST_LIMIT);
+
+  CU_ASSERT (edgex_circuit_allow (c, "dev"));
+  edgex_circuit_result (c, "dev", TEST_INTERVAL, true);
+  CU_ASSERT (edgex_circuit_allow (c, "dev"));
+  edgex_circuit_getstats (c, &stats);
+  CU_ASSERT_EQUAL (stats.failing, 0);
+  CU_ASSERT_EQUAL (stats.failures, 0);
+  edgex_circuit_free (c);
+}
+
+static void test_backoff (void)
+{
+  edgex_circuit_stats stats;
+  edgex_circuit_t *c = edgex_circuit_alloc (iot_logger_default (), TEST_MAXBACKOFF, TEST_LIMIT);
+
+  edgex_circuit_result (c, "dev", TEST_INTERVAL, false);
+  CU_ASSERT (!edgex_circuit_allow (c, "dev"));
+  CU_ASSERT (edgex_circuit_allow (c, "other"));
+  edgex_circuit_getstats (c, &stats);
+  CU_ASSERT_EQUAL (stats.failing, 1);
+  CU_ASSERT_EQUAL (stats.open, 0);
+  CU_ASSERT_EQUAL (stats.skipped, 1);
+
+  sleep_ms (TEST_INTERVAL * 2 + 5);
+  CU_ASSERT (edgex_circuit_allow (c, "dev"));
+  edgex_circuit_result (c, "dev", TEST_INTERVAL, true);
+  CU_ASSERT (edgex_circuit_allow (c, "dev"));
+  edgex_circuit_getstats (c, &stats);
+  CU_ASSERT_EQUAL (stats.failing, 0);
+  CU_ASSERT_EQUAL (stats.failures, 1);
+  edgex_circuit_free (c);
+}
+
+/* Once open, a single probe is let through each time the maximum backoff passes */
+
+static void test_open (void)
+{
+  edgex_circuit_stats stats;
+  edgex_circuit_t *c = edgex_circuit_alloc (iot_logger_default (), TEST_MAXBACKOFF, TEST_LIMIT);
+
+  edgex_circuit_result (c, "dev", TEST_INTERVAL, false);
+  edgex_circuit_result (c, "dev", TEST_INTERVAL, false);
+  edgex_circuit_getstats (c, &stats);
+  CU_ASSERT_EQUAL (stats.open, 1);
+
+  sleep_ms (TEST_INTERVAL * 4 + 5);
+  CU_ASSERT (!edgex_circuit_allow (c, "dev"));
+  sleep_ms (TEST_MAXBACKOFF);
+  CU_ASSERT (edgex_circuit_allow (c, "dev"));
+  CU_ASSERT (!edgex_circuit_allow (c, "dev"));
+
+  edgex_circuit_result (c, "dev", TEST_INTERVAL, false);
+  edgex_circuit_getstats (c, &stats);
+  CU_ASSERT_EQUAL (stats.open, 1);
+  CU_ASSERT_EQUAL (stats.failures, 3);
+  CU_ASSERT (!edgex_circuit_allow (c, "dev"));
+  edgex_circuit_free (c);
+}
+
+/* A successful probe closes the circuit */
+
+static void test_half_open (void)
+{
+  edgex_circuit_stats stats;
+  edgex_circuit_t *c = edgex_circuit_alloc (iot_logger_default (), TEST_MAXBACKOFF, TEST_LIMIT);
+
+  edgex_circuit_result (c, "dev", TEST_INTERVAL, false);
+  edgex_circuit_result (c, "dev", TEST_INTERVAL, false);
+  sleep_ms (TEST_MAXBACKOFF + 5);
+  CU_ASSERT (edgex_circuit_allow (c, "dev"));
+  edgex_circuit_result (c, "dev", TEST_INTERVAL, true);
+  edgex_circuit_getstats (c, &stats);
+  CU_ASSERT_EQUAL (stats.open, 0);
+  CU_ASSERT_EQUAL (stats.failing, 0);
+  CU_ASSERT (edgex_circuit_allow (c, "dev"));
+  CU_ASSERT (edgex_circuit_allow (c, "dev"));
+
+  edgex_circuit_result (c, "dev", TEST_INTERVAL, false);
+  edgex_circuit_getstats (c, &stats);
+  CU_ASSERT_EQUAL (stats.open, 0);
+  CU_ASSERT_EQUAL (stats.failing, 1);
+  edgex_circuit_free (c);
+}
+
+static void test_remove (void)
+{
+  edgex_circuit_stats stats;
+  edgex_circuit_t *c = edgex_circuit_alloc (iot_logger_default (), TEST_MAXBACKOFF, TEST_LIMIT);
+
+  edgex_circuit_result (c, "dev", TEST_INTERVAL, false);
+  edgex_circuit_result (c, "dev", TEST_INTERVAL, false);
+  edgex_circuit_result (c, "dev2", TEST_INTERVAL, false);
+  edgex_circuit_remove (c, "dev");
+  edgex_circuit_remove (c, "absent");
+  edgex_circuit_getstats (c, &stats);
+  CU_ASSERT_EQUAL (stats.failing, 1);
+  CU_ASSERT_EQUAL (stats.open, 0);
+  CU_ASSERT (edgex_circuit_allow (c, "dev"));
+  CU_ASSERT (!edgex_circuit_allow (c, "dev2"));
+  edgex_circuit_free (c);
+}
+
+void cunit_circuit_test_init (void)
+{
+  CU_pSuite suite = CU_add_suite ("circuit", suite_init, suite_clean);
+  CU_add_test (suite, "test_closed", test_closed);
+  CU_add_test (suite, "test_backoff", test_backoff);
+  CU_add_test (suite, "test_open", test_open);
+  CU_add_test (suite, "test_half_open", test_half_open);
+  CU_add_test (suite, "test_remove", test_remove);
+}
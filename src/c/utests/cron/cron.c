@@ -0,0 +1,92 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#include "CUnit.h"
+#include "cron.h"
+#include "../../cron.h"
+
+#include <stdlib.h>
+
+/* 2019-06-15 12:34:56 UTC, a Saturday */
+
+#define BASE 1560602096000ULL
+
+static int suite_init (void)
+{
+  return 0;
+}
+
+static int suite_clean (void)
+{
+  return 0;
+}
+
+static uint64_t next_after (const char *spec, uint64_t after)
+{
+  uint64_t result = 0;
+  edgex_cron *cron = edgex_cron_parse (spec);
+  CU_ASSERT_PTR_NOT_NULL_FATAL (cron);
+  result = edgex_cron_next (cron, after);
+  free (cron);
+  return result;
+}
+
+static void test_next (void)
+{
+  CU_ASSERT_EQUAL (next_after ("* * * * *", BASE), 1560602100000ULL);
+  CU_ASSERT_EQUAL (next_after ("* * * * *", 1560602100000ULL), 1560602160000ULL);
+  CU_ASSERT_EQUAL (next_after ("*/10 * * * * *", BASE), 1560602100000ULL);
+  CU_ASSERT_EQUAL (next_after ("0 9 * * 1-5", BASE), 1560762000000ULL);
+  CU_ASSERT_EQUAL (next_after ("0 0 1 * *", BASE), 1561939200000ULL);
+  CU_ASSERT_EQUAL (next_after ("0 0 29 2 *", BASE), 1582934400000ULL);
+}
+
+static void test_days (void)
+{
+  /* Either the day of month or the day of week may match when both are given */
+  CU_ASSERT_EQUAL (next_after ("0 0 1 * 1", BASE), 1560729600000ULL);
+  CU_ASSERT_EQUAL (next_after ("0 0 * * 7", BASE), next_after ("0 0 * * 0", BASE));
+  CU_ASSERT_EQUAL (next_after ("0 0 30 2 *", BASE), UINT64_MAX);
+}
+
+static void test_invalid (void)
+{
+  static const char *specs[] =
+  {
+    "", "* * * *", "* * * * * * *", "60 * * * *", "* 24 * * *", "* * 0 * *",
+    "*/0 * * * *", "5-1 * * * *", "a * * * *", "1,,2 * * * *", "1- * * * *", NULL
+  };
+  for (const char **s = specs; *s; s++)
+  {
+    edgex_cron *cron = edgex_cron_parse (*s);
+    CU_ASSERT_PTR_NULL (cron);
+    free (cron);
+  }
+}
+
+static void test_resolution (void)
+{
+  edgex_cron *minutes = edgex_cron_parse ("0,30 * * * *");
+  edgex_cron *seconds = edgex_cron_parse ("0 0,30 * * * *");
+  CU_ASSERT_PTR_NOT_NULL_FATAL (minutes);
+  CU_ASSERT_PTR_NOT_NULL_FATAL (seconds);
+  CU_ASSERT_EQUAL (edgex_cron_resolution (minutes), 60000);
+  CU_ASSERT_EQUAL (edgex_cron_resolution (seconds), 1000);
+  CU_ASSERT (edgex_cron_equal (minutes, seconds));
+  free (minutes);
+  free (seconds);
+}
+
+void cunit_cron_test_init (void)
+{
+  CU_pSuite suite = CU_add_suite ("cron", suite_init, suite_clean);
+  CU_add_test (suite, "test_next", test_next);
+  CU_add_test (suite, "test_days", test_days);
+  CU_add_test (suite, "test_invalid", test_invalid);
+  CU_add_test (suite, "test_resolution", test_resolution);
+}
@@ -0,0 +1,154 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#include "CUnit.h"
+#include "devqueue.h"
+#include "../../devqueue.h"
+
+#include <pthread.h>
+#include <time.h>
+
+/* Callers record the order in which their turns come */
+
+static int order[8];
+static unsigned norder;
+
+static int suite_init (void)
+{
+  return 0;
+}
+
+static int suite_clean (void)
+{
+  return 0;
+}
+
+static void turn (void *ctx)
+{
+  order[norder++] = *(int *)ctx;
+}
+
+static void test_fifo (void)
+{
+  static int ids[] = { 1, 2, 3 };
+  edgex_devqueue_t *q = edgex_devqueue_alloc (0);
+
+  norder = 0;
+  CU_ASSERT (edgex_devqueue_join (q, "dev", EDGEX_QOS_AUTOEVENT, turn, &ids[0]));
+  CU_ASSERT (!edgex_devqueue_join (q, "dev", EDGEX_QOS_AUTOEVENT, turn, &ids[1]));
+  CU_ASSERT (!edgex_devqueue_join (q, "dev", EDGEX_QOS_AUTOEVENT, turn, &ids[2]));
+  CU_ASSERT_EQUAL (norder, 0);
+  edgex_devqueue_leave (q, "dev");
+  CU_ASSERT_EQUAL (norder, 1);
+  edgex_devqueue_leave (q, "dev");
+  CU_ASSERT_EQUAL (norder, 2);
+  edgex_devqueue_leave (q, "dev");
+  CU_ASSERT_EQUAL (norder, 2);
+  CU_ASSERT_EQUAL (order[0], 2);
+  CU_ASSERT_EQUAL (order[1], 3);
+  edgex_devqueue_free (q);
+}
+
+static void test_devices (void)
+{
+  static int ids[] = { 1, 2 };
+  edgex_devqueue_t *q = edgex_devqueue_alloc (0);
+
+  norder = 0;
+  CU_ASSERT (edgex_devqueue_join (q, "dev1", EDGEX_QOS_AUTOEVENT, turn, &ids[0]));
+  CU_ASSERT (edgex_devqueue_join (q, "dev2", EDGEX_QOS_AUTOEVENT, turn, &ids[1]));
+  edgex_devqueue_leave (q, "dev1");
+  edgex_devqueue_leave (q, "dev2");
+  CU_ASSERT_EQUAL (norder, 0);
+  edgex_devqueue_free (q);
+}
+
+static void test_command_first (void)
+{
+  static int ids[] = { 1, 2, 3, 4 };
+  edgex_devqueue_t *q = edgex_devqueue_alloc (0);
+
+  norder = 0;
+  CU_ASSERT (edgex_devqueue_join (q, "dev", EDGEX_QOS_AUTOEVENT, turn, &ids[0]));
+  CU_ASSERT (!edgex_devqueue_join (q, "dev", EDGEX_QOS_AUTOEVENT, turn, &ids[1]));
+  CU_ASSERT (!edgex_devqueue_join (q, "dev", EDGEX_QOS_AUTOEVENT, turn, &ids[2]));
+  CU_ASSERT (!edgex_devqueue_join (q, "dev", EDGEX_QOS_COMMAND, turn, &ids[3]));
+  for (int i = 0; i < 4; i++)
+  {
+    edgex_devqueue_leave (q, "dev");
+  }
+  CU_ASSERT_EQUAL (norder, 3);
+  CU_ASSERT_EQUAL (order[0], 4);
+  CU_ASSERT_EQUAL (order[1], 2);
+  CU_ASSERT_EQUAL (order[2], 3);
+  edgex_devqueue_free (q);
+}
+
+static void test_promotion (void)
+{
+  static int ids[] = { 1, 2, 3 };
+  struct timespec ts = { 0, 20000000 };
+  edgex_devqueue_t *q = edgex_devqueue_alloc (10);
+
+  norder = 0;
+  CU_ASSERT (edgex_devqueue_join (q, "dev", EDGEX_QOS_COMMAND, turn, &ids[0]));
+  CU_ASSERT (!edgex_devqueue_join (q, "dev", EDGEX_QOS_AUTOEVENT, turn, &ids[1]));
+  nanosleep (&ts, NULL);
+  CU_ASSERT (!edgex_devqueue_join (q, "dev", EDGEX_QOS_COMMAND, turn, &ids[2]));
+  for (int i = 0; i < 3; i++)
+  {
+    edgex_devqueue_leave (q, "dev");
+  }
+  CU_ASSERT_EQUAL (norder, 2);
+  CU_ASSERT_EQUAL (order[0], 2);
+  CU_ASSERT_EQUAL (order[1], 3);
+  edgex_devqueue_free (q);
+}
+
+/* A blocking caller for a command is admitted before an AutoEvent which joined earlier */
+
+static edgex_devqueue_t *blockq;
+
+static void *command_caller (void *p)
+{
+  edgex_devqueue_enter (blockq, "dev", EDGEX_QOS_COMMAND);
+  turn (p);
+  edgex_devqueue_leave (blockq, "dev");
+  return NULL;
+}
+
+static void test_blocking (void)
+{
+  static int ids[] = { 1, 2, 3 };
+  struct timespec ts = { 0, 50000000 };
+  pthread_t thread;
+
+  blockq = edgex_devqueue_alloc (0);
+  norder = 0;
+  edgex_devqueue_enter (blockq, "dev", EDGEX_QOS_AUTOEVENT);
+  CU_ASSERT (!edgex_devqueue_join (blockq, "dev", EDGEX_QOS_AUTOEVENT, turn, &ids[1]));
+  pthread_create (&thread, NULL, command_caller, &ids[2]);
+  nanosleep (&ts, NULL);
+  edgex_devqueue_leave (blockq, "dev");
+  pthread_join (thread, NULL);
+  CU_ASSERT_EQUAL (norder, 2);
+  CU_ASSERT_EQUAL (order[0], 3);
+  CU_ASSERT_EQUAL (order[1], 2);
+  edgex_devqueue_leave (blockq, "dev");
+  edgex_devqueue_free (blockq);
+}
+
+void cunit_devqueue_test_init (void)
+{
+  CU_pSuite suite = CU_add_suite ("devqueue", suite_init, suite_clean);
+  CU_add_test (suite, "test_fifo", test_fifo);
+  CU_add_test (suite, "test_devices", test_devices);
+  CU_add_test (suite, "test_command_first", test_command_first);
+  CU_add_test (suite, "test_promotion", test_promotion);
+  CU_add_test (suite, "test_blocking", test_blocking);
+}
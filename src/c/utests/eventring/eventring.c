@@ -0,0 +1,202 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#include "CUnit.h"
+#include "eventring.h"
+#include "../../eventring.h"
+#include "../../errorlist.h"
+
+#include <stdio.h>
+#include <string.h>
+
+/*
+ * Records here are 200 bytes: a 40 byte header with the names, and JSON
+ * data of 160 bytes. In a 1 KiB ring, the sixth record does not fit before
+ * the end, so it is preceded by padding and overwrites the first.
+ */
+
+#define TEST_RING "csdk-utest-ring"
+#define TEST_JSONLEN 159
+
+static edgex_cmdinfo cmd = { .name = "src" };
+
+static int suite_init (void)
+{
+  return 0;
+}
+
+static int suite_clean (void)
+{
+  return 0;
+}
+
+static void put (edgex_eventring_t *ring, unsigned n)
+{
+  char json[TEST_JSONLEN + 1];
+  edgex_event_cooked event = { .encoding = JSON };
+
+  memset (json, 'a' + n % 26, TEST_JSONLEN);
+  json[TEST_JSONLEN] = '\0';
+  event.value.json = json;
+  edgex_eventring_put (ring, "dev", &cmd, NULL, n, &event);
+}
+
+static bool check (const edgex_eventring_record *rec, unsigned n)
+{
+  const char *data = edgex_eventring_data (rec);
+  return
+    rec->kind == EDGEX_EVENTRING_JSON && rec->length == 200 && rec->origin == n &&
+    rec->datalen == TEST_JSONLEN && strcmp (edgex_eventring_device (rec), "dev") == 0 &&
+    strcmp (edgex_eventring_source (rec), "src") == 0 && data[0] == 'a' + n % 26 &&
+    data[TEST_JSONLEN - 1] == 'a' + n % 26 && data[TEST_JSONLEN] == '\0';
+}
+
+static void test_wrap (void)
+{
+  edgex_error err = EDGEX_OK;
+  edgex_eventring_t *ring = edgex_eventring_alloc (NULL, TEST_RING, 1, NULL, &err);
+  edgex_eventring_reader *r;
+  const edgex_eventring_record *first = NULL;
+  edgex_eventring_stats stats;
+
+  CU_ASSERT_PTR_NOT_NULL_FATAL (ring);
+  r = edgex_eventring_open (TEST_RING);
+  CU_ASSERT_PTR_NOT_NULL_FATAL (r);
+  CU_ASSERT_PTR_NULL (edgex_eventring_next (r));
+
+  for (unsigned i = 1; i <= 12; i++)
+  {
+    const edgex_eventring_record *rec;
+    put (ring, i);
+    rec = edgex_eventring_next (r);
+    CU_ASSERT_PTR_NOT_NULL_FATAL (rec);
+    CU_ASSERT_EQUAL (rec->seq, i);
+    CU_ASSERT (check (rec, i));
+    CU_ASSERT (edgex_eventring_valid (r));
+    CU_ASSERT_PTR_NULL (edgex_eventring_next (r));
+    if (i == 1)
+    {
+      first = rec;
+    }
+
+    /* The sixth record is placed at the start, after padding */
+
+    if (i == 6 || i == 11)
+    {
+      CU_ASSERT_PTR_EQUAL (rec, first);
+    }
+  }
+  CU_ASSERT_EQUAL (edgex_eventring_lost (r), 0);
+  edgex_eventring_getstats (ring, &stats);
+  CU_ASSERT_EQUAL (stats.written, 12);
+  CU_ASSERT_EQUAL (stats.dropped, 0);
+  CU_ASSERT_EQUAL (stats.overwritten, 7);
+
+  edgex_eventring_close (r);
+  edgex_eventring_free (ring);
+}
+
+static void test_overwrite (void)
+{
+  edgex_error err = EDGEX_OK;
+  edgex_eventring_t *ring = edgex_eventring_alloc (NULL, TEST_RING, 1, NULL, &err);
+  edgex_eventring_reader *r = edgex_eventring_open (TEST_RING);
+  const edgex_eventring_record *rec;
+  uint64_t seq;
+  uint64_t lost;
+
+  CU_ASSERT_PTR_NOT_NULL_FATAL (r);
+  put (ring, 1);
+  rec = edgex_eventring_next (r);
+  CU_ASSERT_PTR_NOT_NULL_FATAL (rec);
+  CU_ASSERT_EQUAL (rec->seq, 1);
+
+  /* The reader falls behind: the oldest of these are overwritten before it reads them */
+
+  for (unsigned i = 2; i <= 11; i++)
+  {
+    put (ring, i);
+  }
+  rec = edgex_eventring_next (r);
+  CU_ASSERT_PTR_NOT_NULL_FATAL (rec);
+  seq = rec->seq;
+  CU_ASSERT (seq > 2);
+  CU_ASSERT (check (rec, seq));
+  CU_ASSERT (edgex_eventring_valid (r));
+  lost = edgex_eventring_lost (r);
+  CU_ASSERT_EQUAL (lost, seq - 2);
+  while ((rec = edgex_eventring_next (r)))
+  {
+    CU_ASSERT_EQUAL (rec->seq, ++seq);
+    CU_ASSERT (check (rec, seq));
+  }
+  CU_ASSERT_EQUAL (seq, 11);
+  CU_ASSERT_EQUAL (edgex_eventring_lost (r), lost);
+
+  edgex_eventring_close (r);
+  edgex_eventring_free (ring);
+}
+
+static void test_valid (void)
+{
+  edgex_error err = EDGEX_OK;
+  edgex_eventring_t *ring = edgex_eventring_alloc (NULL, TEST_RING, 1, NULL, &err);
+  edgex_eventring_reader *r = edgex_eventring_open (TEST_RING);
+  const edgex_eventring_record *rec;
+
+  CU_ASSERT_PTR_NOT_NULL_FATAL (r);
+  put (ring, 1);
+  rec = edgex_eventring_next (r);
+  CU_ASSERT_PTR_NOT_NULL_FATAL (rec);
+  CU_ASSERT (edgex_eventring_valid (r));
+
+  /* Four more records fill the ring; the sixth overwrites the one being read */
+
+  for (unsigned i = 2; i <= 5; i++)
+  {
+    put (ring, i);
+  }
+  CU_ASSERT (edgex_eventring_valid (r));
+  put (ring, 6);
+  CU_ASSERT (!edgex_eventring_valid (r));
+
+  edgex_eventring_close (r);
+  edgex_eventring_free (ring);
+}
+
+static void test_oversize (void)
+{
+  edgex_error err = EDGEX_OK;
+  edgex_eventring_t *ring = edgex_eventring_alloc (NULL, TEST_RING, 1, NULL, &err);
+  edgex_eventring_reader *r = edgex_eventring_open (TEST_RING);
+  char json[600];
+  edgex_event_cooked event = { .encoding = JSON };
+  edgex_eventring_stats stats;
+
+  CU_ASSERT_PTR_NOT_NULL_FATAL (r);
+  memset (json, 'x', sizeof (json) - 1);
+  json[sizeof (json) - 1] = '\0';
+  event.value.json = json;
+  edgex_eventring_put (ring, "dev", &cmd, NULL, 1, &event);
+  CU_ASSERT_PTR_NULL (edgex_eventring_next (r));
+  edgex_eventring_getstats (ring, &stats);
+  CU_ASSERT_EQUAL (stats.written, 0);
+  CU_ASSERT_EQUAL (stats.dropped, 1);
+
+  edgex_eventring_close (r);
+  edgex_eventring_free (ring);
+}
+
+void cunit_eventring_test_init (void)
+{
+  CU_pSuite suite = CU_add_suite ("eventring", suite_init, suite_clean);
+  CU_add_test (suite, "test_wrap", test_wrap);
+  CU_add_test (suite, "test_overwrite", test_overwrite);
+  CU_add_test (suite, "test_valid", test_valid);
+  CU_add_test (suite, "test_oversize", test_oversize);
+}
@@ -0,0 +1,105 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#include "CUnit.h"
+#include "floatfmt.h"
+#include "../../floatfmt.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+static int suite_init (void)
+{
+  return 0;
+}
+
+static int suite_clean (void)
+{
+  return 0;
+}
+
+static void check_double (double value, const char *expected)
+{
+  char buf[EDGEX_FLOAT_BUFSIZE];
+  edgex_float_tostring (value, false, buf, sizeof (buf));
+  CU_ASSERT_STRING_EQUAL (buf, expected);
+}
+
+static void check_float (float value, const char *expected)
+{
+  char buf[EDGEX_FLOAT_BUFSIZE];
+  edgex_float_tostring (value, true, buf, sizeof (buf));
+  CU_ASSERT_STRING_EQUAL (buf, expected);
+}
+
+static void test_double (void)
+{
+  check_double (0.0, "0e+00");
+  check_double (-0.0, "-0e+00");
+  check_double (1.0, "1e+00");
+  check_double (23.5, "2.35e+01");
+  check_double (0.1, "1e-01");
+  check_double (-3.14159, "-3.14159e+00");
+  check_double (1.0 / 3, "3.333333333333333e-01");
+  check_double (5e-324, "5e-324");
+  check_double (1.7976931348623157e308, "1.7976931348623157e+308");
+  check_double (2.2250738585072014e-308, "2.2250738585072014e-308");
+}
+
+static void test_float (void)
+{
+  check_float (0.1f, "1e-01");
+  check_float (23.5f, "2.35e+01");
+  check_float (100.25f, "1.0025e+02");
+  check_float (-7.0f, "-7e+00");
+  check_float (1e-45f, "1e-45");
+  check_float (3.4028235e38f, "3.4028235e+38");
+  check_float (1.17549435e-38f, "1.1754944e-38");
+}
+
+/* Pseudo-random bit patterns must read back exactly */
+
+static void test_roundtrip (void)
+{
+  char buf[EDGEX_FLOAT_BUFSIZE];
+  uint64_t x = 88172645463325252ULL;
+
+  for (int i = 0; i < 100000; i++)
+  {
+    double d;
+    float f;
+    uint32_t fbits;
+
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    memcpy (&d, &x, sizeof (d));
+    fbits = (uint32_t)x;
+    memcpy (&f, &fbits, sizeof (f));
+
+    if (d == d && d - d == 0.0)
+    {
+      edgex_float_tostring (d, false, buf, sizeof (buf));
+      CU_ASSERT (strtod (buf, NULL) == d);
+    }
+    if (f == f && f - f == 0.0f)
+    {
+      edgex_float_tostring (f, true, buf, sizeof (buf));
+      CU_ASSERT (strtof (buf, NULL) == f);
+    }
+  }
+}
+
+void cunit_floatfmt_test_init (void)
+{
+  CU_pSuite suite = CU_add_suite ("floatfmt", suite_init, suite_clean);
+  CU_add_test (suite, "test_double", test_double);
+  CU_add_test (suite, "test_float", test_float);
+  CU_add_test (suite, "test_roundtrip", test_roundtrip);
+}
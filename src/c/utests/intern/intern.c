@@ -0,0 +1,106 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#include "CUnit.h"
+#include "intern.h"
+#include "../../intern.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+static int suite_init (void)
+{
+  return 0;
+}
+
+static int suite_clean (void)
+{
+  return 0;
+}
+
+static void test_shared (void)
+{
+  const char *a = edgex_intern ("modbus-tcp");
+  const char *b = edgex_intern ("modbus-tcp");
+  char buf[] = "modbus-tcp";
+  const char *c = edgex_intern (buf);
+  const char *d;
+
+  CU_ASSERT_STRING_EQUAL (a, "modbus-tcp");
+  CU_ASSERT_PTR_EQUAL (a, b);
+  CU_ASSERT_PTR_EQUAL (a, c);
+  d = edgex_intern ("other");
+  CU_ASSERT_PTR_NOT_EQUAL (d, a);
+  edgex_intern_release (d);
+  edgex_intern_release (c);
+  edgex_intern_release (b);
+  edgex_intern_release (a);
+}
+
+static void test_refcount (void)
+{
+  const char *a = edgex_intern ("frequency");
+  const char *b = edgex_intern ("frequency");
+  const char *c;
+
+  edgex_intern_release (a);
+  c = edgex_intern ("frequency");
+  CU_ASSERT_PTR_EQUAL (b, c);
+  edgex_intern_release (b);
+  CU_ASSERT_STRING_EQUAL (c, "frequency");
+  edgex_intern_release (c);
+}
+
+static void test_fallback (void)
+{
+  const char *a = edgex_intern ("label");
+  char *plain = strdup ("label");
+
+  edgex_intern_release (plain);
+  CU_ASSERT_STRING_EQUAL (a, "label");
+  CU_ASSERT_PTR_EQUAL (edgex_intern ("label"), a);
+  edgex_intern_release (a);
+  edgex_intern_release (a);
+  edgex_intern_release (strdup ("never interned"));
+  edgex_intern_release (NULL);
+  CU_ASSERT_PTR_NULL (edgex_intern (NULL));
+}
+
+static void test_many (void)
+{
+  const char *strs[1000];
+  char buf[16];
+
+  for (int i = 0; i < 1000; i++)
+  {
+    sprintf (buf, "res%d", i);
+    strs[i] = edgex_intern (buf);
+  }
+  for (int i = 0; i < 1000; i++)
+  {
+    sprintf (buf, "res%d", i);
+    CU_ASSERT_PTR_EQUAL (edgex_intern (buf), strs[i]);
+    edgex_intern_release (strs[i]);
+  }
+  for (int i = 0; i < 1000; i++)
+  {
+    sprintf (buf, "res%d", i);
+    CU_ASSERT_STRING_EQUAL (strs[i], buf);
+    edgex_intern_release (strs[i]);
+  }
+}
+
+void cunit_intern_test_init (void)
+{
+  CU_pSuite suite = CU_add_suite ("intern", suite_init, suite_clean);
+  CU_add_test (suite, "test_shared", test_shared);
+  CU_add_test (suite, "test_refcount", test_refcount);
+  CU_add_test (suite, "test_fallback", test_fallback);
+  CU_add_test (suite, "test_many", test_many);
+}
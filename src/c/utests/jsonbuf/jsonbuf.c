@@ -0,0 +1,81 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#include "CUnit.h"
+#include "jsonbuf.h"
+#include "../../jsonbuf.h"
+#include "../../parson.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+static int suite_init (void)
+{
+  return 0;
+}
+
+static int suite_clean (void)
+{
+  return 0;
+}
+
+/* Encode a single-member object with both parson and jsonbuf, and compare */
+
+static void check_member (const char *key, const char *value)
+{
+  bool first = true;
+  edgex_jsonbuf buf;
+  JSON_Value *val = json_value_init_object ();
+  json_object_set_string (json_value_get_object (val), key, value);
+  json_object_set_uint (json_value_get_object (val), "origin", UINT64_MAX);
+  char *expected = json_serialize_to_string (val);
+
+  edgex_jsonbuf_init (&buf, 0);
+  edgex_jsonbuf_appendc (&buf, '{');
+  edgex_jsonbuf_member_string (&buf, &first, key, value);
+  edgex_jsonbuf_member_uint (&buf, &first, "origin", UINT64_MAX);
+  edgex_jsonbuf_appendc (&buf, '}');
+  char *actual = edgex_jsonbuf_finish (&buf);
+
+  CU_ASSERT_STRING_EQUAL (actual, expected);
+
+  free (actual);
+  json_free_serialized_string (expected);
+  json_value_free (val);
+}
+
+static void test_plain (void)
+{
+  check_member ("value", "");
+  check_member ("value", "1.23456789e+01");
+  check_member ("device", "Random-Integer-Generator01");
+}
+
+static void test_escapes (void)
+{
+  check_member ("value", "quote\" backslash\\ slash/");
+  check_member ("value", "\b\f\n\r\t");
+  check_member ("value", "\x01\x02\x0b\x1f\x7f end");
+}
+
+static void test_utf8 (void)
+{
+  check_member ("value", "\xc2\xa3\xe2\x82\xac\xf0\x9f\x98\x80");
+  check_member ("value", "bad \xc0\x80");
+  check_member ("value", "bad \xed\xa0\x80");
+  check_member ("value", "truncated \xe2\x82");
+  check_member ("value", "bad \xf4\x90\x80\x80");
+}
+
+void cunit_jsonbuf_test_init (void)
+{
+  CU_pSuite suite = CU_add_suite ("jsonbuf", suite_init, suite_clean);
+  CU_add_test (suite, "test_plain", test_plain);
+  CU_add_test (suite, "test_escapes", test_escapes);
+  CU_add_test (suite, "test_utf8", test_utf8);
+}
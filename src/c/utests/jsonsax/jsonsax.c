@@ -0,0 +1,152 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#include "CUnit.h"
+#include "jsonsax.h"
+#include "../../jsonsax.h"
+#include "../../parson.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/* The events are recorded as a string, and a capture is requested for keys named "raw" */
+
+typedef struct trace_ctx
+{
+  edgex_jsonsax_t *sax;
+  char out[1024];
+} trace_ctx;
+
+static int suite_init (void)
+{
+  return 0;
+}
+
+static int suite_clean (void)
+{
+  return 0;
+}
+
+static bool trace_event (void *ctx, edgex_json_event ev, const char *text, size_t len)
+{
+  static const char *names[] = { "{", "}", "[", "]", "k:", "s:", "n:", "t", "f", "z", "r:" };
+  trace_ctx *t = (trace_ctx *)ctx;
+
+  CU_ASSERT (text == NULL || strlen (text) == len);
+  strcat (t->out, names[ev]);
+  if (text)
+  {
+    strcat (t->out, text);
+  }
+  strcat (t->out, " ");
+  if (ev == EDGEX_JSON_KEY && strcmp (text, "raw") == 0)
+  {
+    edgex_jsonsax_capture (t->sax);
+  }
+  return true;
+}
+
+/* Read the text whole and a character at a time, returning the trace or NULL if the text is invalid */
+
+static char *trace (const char *json)
+{
+  static char result[1024];
+  trace_ctx whole;
+  trace_ctx bytes;
+  bool wok;
+  bool bok = true;
+
+  memset (&whole, 0, sizeof (whole));
+  whole.sax = edgex_jsonsax_alloc (trace_event, &whole);
+  wok = edgex_jsonsax_feed (whole.sax, json, strlen (json)) && edgex_jsonsax_finish (whole.sax);
+  edgex_jsonsax_free (whole.sax);
+
+  memset (&bytes, 0, sizeof (bytes));
+  bytes.sax = edgex_jsonsax_alloc (trace_event, &bytes);
+  for (const char *c = json; *c && bok; c++)
+  {
+    bok = edgex_jsonsax_feed (bytes.sax, c, 1);
+  }
+  bok = bok && edgex_jsonsax_finish (bytes.sax);
+  edgex_jsonsax_free (bytes.sax);
+
+  CU_ASSERT (wok == bok);
+  if (wok && bok)
+  {
+    CU_ASSERT_STRING_EQUAL (whole.out, bytes.out);
+  }
+  strcpy (result, whole.out);
+  return wok ? result : NULL;
+}
+
+/* Check that the text is accepted exactly when parson accepts it */
+
+static void check_valid (const char *json)
+{
+  JSON_Value *val = json_parse_string (json);
+  CU_ASSERT ((trace (json) != NULL) == (val != NULL));
+  json_value_free (val);
+}
+
+static void test_events (void)
+{
+  CU_ASSERT_STRING_EQUAL (trace ("{}"), "{ } ");
+  CU_ASSERT_STRING_EQUAL (trace (" [ 1 , -2.5e3 ] "), "[ n:1 n:-2.5e3 ] ");
+  CU_ASSERT_STRING_EQUAL (trace ("42"), "n:42 ");
+  CU_ASSERT_STRING_EQUAL (trace ("{\"a\":[true,false,null],\"b\":{}}"), "{ k:a [ t f z ] k:b { } } ");
+  CU_ASSERT_STRING_EQUAL (trace ("[\"x\",\"\"]"), "[ s:x s: ] ");
+}
+
+static void test_escapes (void)
+{
+  CU_ASSERT_STRING_EQUAL (trace ("[\"q\\\" b\\\\ s\\/ \\n\\t\"]"), "[ s:q\" b\\ s/ \n\t ] ");
+  CU_ASSERT_STRING_EQUAL (trace ("[\"\\u0041\\u00e9\\u20ac\\ud83d\\ude00\"]"), "[ s:A\xc3\xa9\xe2\x82\xac\xf0\x9f\x98\x80 ] ");
+  CU_ASSERT_STRING_EQUAL (trace ("{\"\\u0062\":1}"), "{ k:b n:1 } ");
+}
+
+static void test_capture (void)
+{
+  CU_ASSERT_STRING_EQUAL
+    (trace ("{\"raw\" : {\"a\": [1, \"}\"]} , \"b\":2}"), "{ k:raw r:{\"a\": [1, \"}\"]} k:b n:2 } ");
+  CU_ASSERT_STRING_EQUAL (trace ("{\"raw\":12,\"b\":true}"), "{ k:raw r:12 k:b t } ");
+  CU_ASSERT_STRING_EQUAL (trace ("{\"raw\":\"a\\\"b\"}"), "{ k:raw r:\"a\\\"b\" } ");
+  CU_ASSERT_STRING_EQUAL (trace ("{\"raw\":null}"), "{ k:raw r:null } ");
+}
+
+static void test_malformed (void)
+{
+  check_valid ("");
+  check_valid ("{\"a\":\"1\"");
+  check_valid ("{\"a\" \"1\"}");
+  check_valid ("{\"a\":\"1\",}");
+  check_valid ("[1,]");
+  check_valid ("[1 2]");
+  check_valid ("[1}");
+  check_valid ("{\"a\":\"\\x\"}");
+  check_valid ("{\"a\":\"\\ude00\"}");
+  check_valid ("{\"a\":\"\\ud83d\"}");
+  check_valid ("{\"a\":\"tab\there\"}");
+  check_valid ("{\"x\":tru}");
+  check_valid ("{\"x\":01}");
+  check_valid ("{\"x\":-}");
+  check_valid ("{\"raw\":[1,}");
+
+  /* Accepted by parson, which ignores trailing text and allows an empty fraction */
+
+  CU_ASSERT (trace ("[] []") == NULL);
+  CU_ASSERT (trace ("[1.]") == NULL);
+}
+
+void cunit_jsonsax_test_init (void)
+{
+  CU_pSuite suite = CU_add_suite ("jsonsax", suite_init, suite_clean);
+  CU_add_test (suite, "test_events", test_events);
+  CU_add_test (suite, "test_escapes", test_escapes);
+  CU_add_test (suite, "test_capture", test_capture);
+  CU_add_test (suite, "test_malformed", test_malformed);
+}
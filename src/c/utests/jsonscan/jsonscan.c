@@ -0,0 +1,100 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#include "CUnit.h"
+#include "jsonscan.h"
+#include "../../jsonscan.h"
+#include "../../parson.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+static const char *keys[] = { "a", "b", "c" };
+
+static int suite_init (void)
+{
+  return 0;
+}
+
+static int suite_clean (void)
+{
+  return 0;
+}
+
+/* Scan a document and compare the results with those obtained via parson */
+
+static void check_scan (const char *json)
+{
+  const char *values[3];
+  char *work = edgex_json_scan_strings (json, 3, keys, values);
+  JSON_Value *val = json_parse_string (json);
+  JSON_Object *obj = json_value_get_object (val);
+
+  CU_ASSERT ((work != NULL) == (obj != NULL));
+  if (work && obj)
+  {
+    for (int i = 0; i < 3; i++)
+    {
+      const char *expected = json_object_get_string (obj, keys[i]);
+      if (expected && values[i])
+      {
+        CU_ASSERT_STRING_EQUAL (values[i], expected);
+      }
+      else
+      {
+        CU_ASSERT (expected == NULL && values[i] == NULL);
+      }
+    }
+  }
+  free (work);
+  json_value_free (val);
+}
+
+static void test_members (void)
+{
+  check_scan ("{}");
+  check_scan (" { \"a\" : \"1\" } ");
+  check_scan ("{\"c\":\"3\",\"b\":\"2\",\"a\":\"1\"}");
+  check_scan ("{\"x\":{\"a\":\"no\",\"y\":[1,2.5e3,-0.1,true,false,null]},\"b\":\"yes\"}");
+  check_scan ("{\"a\":42,\"b\":null,\"c\":[\"3\"]}");
+  check_scan ("{\"a\":\"\"}");
+}
+
+static void test_escapes (void)
+{
+  check_scan ("{\"a\":\"q\\\" b\\\\ s\\/ \\b\\f\\n\\r\\t\"}");
+  check_scan ("{\"a\":\"\\u0041\\u00e9\\u20ac\\ud83d\\ude00\"}");
+  check_scan ("{\"\\u0062\":\"escaped key\"}");
+}
+
+static void test_malformed (void)
+{
+  check_scan ("");
+  check_scan ("[\"a\"]");
+  check_scan ("\"a\"");
+  check_scan ("{\"a\":\"1\"");
+  check_scan ("{\"a\" \"1\"}");
+  check_scan ("{\"a\":\"1\",}");
+  check_scan ("{\"a\":\"1\",\"a\":\"2\"}");
+  check_scan ("{\"a\":\"\\x\"}");
+  check_scan ("{\"a\":\"\\ude00\"}");
+  check_scan ("{\"a\":\"\\ud83d\"}");
+  check_scan ("{\"a\":\"tab\there\"}");
+  check_scan ("{\"x\":[1,}");
+  check_scan ("{\"x\":tru}");
+  check_scan ("{\"x\":01}");
+  check_scan ("{\"x\":1.}");
+}
+
+void cunit_jsonscan_test_init (void)
+{
+  CU_pSuite suite = CU_add_suite ("jsonscan", suite_init, suite_clean);
+  CU_add_test (suite, "test_members", test_members);
+  CU_add_test (suite, "test_escapes", test_escapes);
+  CU_add_test (suite, "test_malformed", test_malformed);
+}
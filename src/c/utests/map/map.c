@@ -0,0 +1,225 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#include "CUnit.h"
+#include "map.h"
+#include "../../map.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TEST_NKEYS 1000
+
+static int suite_init (void)
+{
+  return 0;
+}
+
+static int suite_clean (void)
+{
+  return 0;
+}
+
+static const char *key (int i)
+{
+  static char buf[16];
+  sprintf (buf, "key%d", i);
+  return buf;
+}
+
+static void fill (edgex_map_int *m, int n)
+{
+  for (int i = 0; i < n; i++)
+  {
+    CU_ASSERT_EQUAL (edgex_map_set (m, key (i), i), 0);
+  }
+}
+
+/* Entries set before and during growth of the table are all found, and iterated once each */
+
+static void test_resize (void)
+{
+  edgex_map_int m;
+  edgex_map_iter iter;
+  const char *k;
+  int *first;
+  bool *seen = calloc (TEST_NKEYS, sizeof (bool));
+  unsigned count = 0;
+
+  edgex_map_init (&m);
+  CU_ASSERT_PTR_NULL (edgex_map_get (&m, "key0"));
+  CU_ASSERT_EQUAL (edgex_map_set (&m, "key0", 0), 0);
+  first = edgex_map_get (&m, "key0");
+  fill (&m, TEST_NKEYS);
+  CU_ASSERT_EQUAL (edgex_map_size (&m), TEST_NKEYS);
+  CU_ASSERT (m.base.nslots / 4 * 3 >= m.base.nused);
+
+  /* Values stay where they are as the table grows */
+
+  CU_ASSERT_PTR_EQUAL (edgex_map_get (&m, "key0"), first);
+  for (int i = 0; i < TEST_NKEYS; i++)
+  {
+    int *v = edgex_map_get (&m, key (i));
+    CU_ASSERT_PTR_NOT_NULL_FATAL (v);
+    CU_ASSERT_EQUAL (*v, i);
+  }
+
+  iter = edgex_map_iter (m);
+  while ((k = edgex_map_next (&m, &iter)))
+  {
+    int i = atoi (k + 3);
+    CU_ASSERT (!seen[i]);
+    seen[i] = true;
+    count++;
+  }
+  CU_ASSERT_EQUAL (count, TEST_NKEYS);
+
+  /* Setting an existing key replaces its value */
+
+  CU_ASSERT_EQUAL (edgex_map_set (&m, key (7), 70), 0);
+  CU_ASSERT_EQUAL (*edgex_map_get (&m, key (7)), 70);
+  CU_ASSERT_EQUAL (edgex_map_size (&m), TEST_NKEYS);
+
+  free (seen);
+  edgex_map_deinit (&m);
+}
+
+static void test_remove (void)
+{
+  edgex_map_int m;
+  edgex_map_iter iter;
+  const char *k;
+  unsigned count = 0;
+
+  edgex_map_init (&m);
+  fill (&m, TEST_NKEYS);
+  for (int i = 0; i < TEST_NKEYS; i += 2)
+  {
+    edgex_map_remove (&m, key (i));
+  }
+  edgex_map_remove (&m, "absent");
+  CU_ASSERT_EQUAL (edgex_map_size (&m), TEST_NKEYS / 2);
+  for (int i = 0; i < TEST_NKEYS; i++)
+  {
+    int *v = edgex_map_get (&m, key (i));
+    if (i % 2)
+    {
+      CU_ASSERT_PTR_NOT_NULL_FATAL (v);
+      CU_ASSERT_EQUAL (*v, i);
+    }
+    else
+    {
+      CU_ASSERT_PTR_NULL (v);
+    }
+  }
+
+  /* Entries added after removals, growing the table again, are found alongside the others */
+
+  for (int i = TEST_NKEYS; i < 3 * TEST_NKEYS; i++)
+  {
+    CU_ASSERT_EQUAL (edgex_map_set (&m, key (i), i), 0);
+  }
+  iter = edgex_map_iter (m);
+  while ((k = edgex_map_next (&m, &iter)))
+  {
+    int i = atoi (k + 3);
+    CU_ASSERT (i % 2 || i >= TEST_NKEYS);
+    CU_ASSERT_EQUAL (*edgex_map_get (&m, k), i);
+    count++;
+  }
+  CU_ASSERT_EQUAL (count, TEST_NKEYS / 2 + 2 * TEST_NKEYS);
+  edgex_map_deinit (&m);
+}
+
+/* Removal during iteration is safe, and visits each remaining entry */
+
+static void test_remove_iterating (void)
+{
+  edgex_map_int m;
+  edgex_map_iter iter;
+  const char *k;
+  unsigned count = 0;
+
+  edgex_map_init (&m);
+  fill (&m, TEST_NKEYS);
+  iter = edgex_map_iter (m);
+  while ((k = edgex_map_next (&m, &iter)))
+  {
+    edgex_map_remove (&m, k);
+    count++;
+  }
+  CU_ASSERT_EQUAL (count, TEST_NKEYS);
+  CU_ASSERT_EQUAL (edgex_map_size (&m), 0);
+  iter = edgex_map_iter (m);
+  CU_ASSERT_PTR_NULL (edgex_map_next (&m, &iter));
+  edgex_map_deinit (&m);
+}
+
+/* Removed slots are reused, so a table whose size is steady does not grow */
+
+static void test_reuse (void)
+{
+  edgex_map_int m;
+  unsigned nslots;
+  unsigned nused;
+
+  edgex_map_init (&m);
+  fill (&m, 4);
+  nslots = m.base.nslots;
+  nused = m.base.nused;
+
+  /* Removing and restoring a key takes its old slot */
+
+  edgex_map_remove (&m, key (2));
+  CU_ASSERT_EQUAL (edgex_map_set (&m, key (2), 2), 0);
+  CU_ASSERT_EQUAL (m.base.nused, nused);
+
+  /* Churn through many keys while holding four */
+
+  for (int i = 4; i < TEST_NKEYS; i++)
+  {
+    edgex_map_remove (&m, key (i - 4));
+    CU_ASSERT_EQUAL (edgex_map_set (&m, key (i), i), 0);
+    CU_ASSERT_EQUAL (edgex_map_size (&m), 4);
+  }
+  CU_ASSERT_EQUAL (m.base.nslots, nslots);
+  for (int i = TEST_NKEYS - 4; i < TEST_NKEYS; i++)
+  {
+    CU_ASSERT_EQUAL (*edgex_map_get (&m, key (i)), i);
+  }
+  CU_ASSERT_PTR_NULL (edgex_map_get (&m, key (TEST_NKEYS - 5)));
+  edgex_map_deinit (&m);
+}
+
+static void test_reserve (void)
+{
+  edgex_map_int m;
+  unsigned nslots;
+
+  edgex_map_init (&m);
+  CU_ASSERT_EQUAL (edgex_map_reserve (&m, TEST_NKEYS), 0);
+  nslots = m.base.nslots;
+  CU_ASSERT (nslots / 4 * 3 >= TEST_NKEYS);
+  fill (&m, TEST_NKEYS);
+  CU_ASSERT_EQUAL (m.base.nslots, nslots);
+  CU_ASSERT_EQUAL (edgex_map_reserve (&m, 10), 0);
+  CU_ASSERT_EQUAL (m.base.nslots, nslots);
+  edgex_map_deinit (&m);
+}
+
+void cunit_map_test_init (void)
+{
+  CU_pSuite suite = CU_add_suite ("map", suite_init, suite_clean);
+  CU_add_test (suite, "test_resize", test_resize);
+  CU_add_test (suite, "test_remove", test_remove);
+  CU_add_test (suite, "test_remove_iterating", test_remove_iterating);
+  CU_add_test (suite, "test_reuse", test_reuse);
+  CU_add_test (suite, "test_reserve", test_reserve);
+}
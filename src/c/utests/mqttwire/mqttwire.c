@@ -0,0 +1,188 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#include "CUnit.h"
+#include "mqttwire.h"
+#include "../../mqttwire.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/* Packets seen by the scan callback */
+
+static unsigned char types[8];
+static size_t lens[8];
+static unsigned npackets;
+
+static int suite_init (void)
+{
+  return 0;
+}
+
+static int suite_clean (void)
+{
+  return 0;
+}
+
+static void packet (void *ctx, unsigned char type, const unsigned char *data, size_t len)
+{
+  (void)ctx;
+  (void)data;
+  types[npackets] = type;
+  lens[npackets++] = len;
+}
+
+static void test_remaining (void)
+{
+  static const size_t values[] = { 0, 127, 128, 16383, 16384, 2097151, 2097152, EDGEX_MQTT_MAXREMAINING };
+  static const size_t sizes[] = { 1, 1, 2, 2, 3, 3, 4, 4 };
+  unsigned char buf[5];
+
+  for (unsigned i = 0; i < sizeof (values) / sizeof (values[0]); i++)
+  {
+    size_t rem = 0;
+    buf[0] = 0x30;
+    CU_ASSERT_EQUAL (edgex_mqtt_put_remaining (buf + 1, values[i]), sizes[i]);
+    CU_ASSERT_EQUAL (edgex_mqtt_get_header (buf, sizes[i] + 1, &rem), (int)sizes[i] + 1);
+    CU_ASSERT_EQUAL (rem, values[i]);
+    CU_ASSERT_EQUAL (edgex_mqtt_get_header (buf, sizes[i], &rem), 0);
+  }
+}
+
+static void test_header_malformed (void)
+{
+  static const unsigned char bad[] = { 0x30, 0xff, 0xff, 0xff, 0xff, 0x01 };
+  size_t rem;
+
+  CU_ASSERT_EQUAL (edgex_mqtt_get_header (bad, sizeof (bad), &rem), -1);
+  CU_ASSERT_EQUAL (edgex_mqtt_get_header (bad, 1, &rem), 0);
+}
+
+static void test_scan (void)
+{
+  static const unsigned char buf[] =
+  {
+    0x20, 0x02, 0x00, 0x00,     /* CONNACK */
+    0x40, 0x02, 0x00, 0x07,     /* PUBACK */
+    0xd0, 0x00,                 /* PINGRESP */
+    0x40, 0x02, 0x00            /* Incomplete PUBACK */
+  };
+  size_t skip = 0;
+
+  npackets = 0;
+  CU_ASSERT_EQUAL (edgex_mqtt_scan (buf, sizeof (buf), 64, &skip, packet, NULL), 10);
+  CU_ASSERT_EQUAL (npackets, 3);
+  CU_ASSERT_EQUAL (types[0], 0x20);
+  CU_ASSERT_EQUAL (types[1], 0x40);
+  CU_ASSERT_EQUAL (types[2], 0xd0);
+  CU_ASSERT_EQUAL (lens[1], 2);
+  CU_ASSERT_EQUAL (lens[2], 0);
+  CU_ASSERT_EQUAL (skip, 0);
+
+  npackets = 0;
+  CU_ASSERT_EQUAL (edgex_mqtt_scan (buf + 10, 3, 64, &skip, packet, NULL), 0);
+  CU_ASSERT_EQUAL (npackets, 0);
+}
+
+static void test_scan_oversize (void)
+{
+  unsigned char buf[16] = { 0x30, 0x64 };   /* PUBLISH of 100 bytes */
+  size_t skip = 0;
+
+  buf[12] = 0xd0;
+  npackets = 0;
+  CU_ASSERT_EQUAL (edgex_mqtt_scan (buf, 12, 16, &skip, packet, NULL), 12);
+  CU_ASSERT_EQUAL (skip, 90);
+  CU_ASSERT_EQUAL (edgex_mqtt_scan (buf, 16, 16, &skip, packet, NULL), 16);
+  CU_ASSERT_EQUAL (skip, 74);
+  CU_ASSERT_EQUAL (npackets, 0);
+
+  /* The remainder of the packet arrives, followed by a PINGRESP */
+
+  memset (buf, 0, sizeof (buf));
+  buf[10] = 0xd0;
+  skip = 10;
+  CU_ASSERT_EQUAL (edgex_mqtt_scan (buf, 12, 16, &skip, packet, NULL), 12);
+  CU_ASSERT_EQUAL (skip, 0);
+  CU_ASSERT_EQUAL (npackets, 1);
+  CU_ASSERT_EQUAL (types[0], 0xd0);
+}
+
+static void test_scan_malformed (void)
+{
+  static const unsigned char bad[] = { 0xd0, 0x00, 0x30, 0x80, 0x80, 0x80, 0x80, 0x01 };
+  size_t skip = 0;
+
+  npackets = 0;
+  CU_ASSERT_EQUAL (edgex_mqtt_scan (bad, sizeof (bad), 64, &skip, packet, NULL), -1);
+}
+
+static void check_broker (const char *broker, const char *host, const char *port)
+{
+  char *h = NULL;
+  char *p = NULL;
+
+  if (host)
+  {
+    CU_ASSERT_FATAL (edgex_mqtt_parse_broker (broker, 1883, &h, &p));
+    CU_ASSERT_STRING_EQUAL (h, host);
+    CU_ASSERT_STRING_EQUAL (p, port);
+    free (h);
+    free (p);
+  }
+  else
+  {
+    CU_ASSERT (!edgex_mqtt_parse_broker (broker, 1883, &h, &p));
+    CU_ASSERT_PTR_NULL (h);
+    CU_ASSERT_PTR_NULL (p);
+  }
+}
+
+static void test_broker (void)
+{
+  check_broker ("localhost", "localhost", "1883");
+  check_broker ("localhost:1884", "localhost", "1884");
+  check_broker ("tcp://broker.local:8883", "broker.local", "8883");
+  check_broker ("MQTT://10.0.0.1", "10.0.0.1", "1883");
+  check_broker ("[::1]", "::1", "1883");
+  check_broker ("tcp://[fe80::1]:1999", "fe80::1", "1999");
+  check_broker ("ssl://localhost", NULL, NULL);
+  check_broker ("", NULL, NULL);
+  check_broker (":1883", NULL, NULL);
+  check_broker ("localhost:", NULL, NULL);
+  check_broker ("localhost:12a", NULL, NULL);
+  check_broker ("[::1", NULL, NULL);
+  check_broker ("[::1]x", NULL, NULL);
+}
+
+static void test_topic (void)
+{
+  char *t;
+
+  t = edgex_mqtt_topic ("edgex/events/{device}/{source}", "svc", "dev1", "temp");
+  CU_ASSERT_STRING_EQUAL (t, "edgex/events/dev1/temp");
+  free (t);
+  t = edgex_mqtt_topic ("{service}/{device}/{source}/{other}", "svc", "a+b", "c#");
+  CU_ASSERT_STRING_EQUAL (t, "svc/a_b/c_/{other}");
+  free (t);
+  t = edgex_mqtt_topic ("{device}-{source}", "svc", "dev", NULL);
+  CU_ASSERT_STRING_EQUAL (t, "dev-");
+  free (t);
+}
+
+void cunit_mqttwire_test_init (void)
+{
+  CU_pSuite suite = CU_add_suite ("mqttwire", suite_init, suite_clean);
+  CU_add_test (suite, "test_remaining", test_remaining);
+  CU_add_test (suite, "test_header_malformed", test_header_malformed);
+  CU_add_test (suite, "test_scan", test_scan);
+  CU_add_test (suite, "test_scan_oversize", test_scan_oversize);
+  CU_add_test (suite, "test_scan_malformed", test_scan_malformed);
+  CU_add_test (suite, "test_broker", test_broker);
+  CU_add_test (suite, "test_topic", test_topic);
+}
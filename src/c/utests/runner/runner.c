@@ -2,6 +2,19 @@
 #include "../../cunit/Automated.h"
 
 #include "../base64/base64.h"
+#include "../jsonbuf/jsonbuf.h"
+#include "../floatfmt/floatfmt.h"
+#include "../jsonscan/jsonscan.h"
+#include "../jsonsax/jsonsax.h"
+#include "../cron/cron.h"
+#include "../devqueue/devqueue.h"
+#include "../intern/intern.h"
+#include "../mqttwire/mqttwire.h"
+#include "../eventring/eventring.h"
+#include "../bufpool/bufpool.h"
+#include "../map/map.h"
+#include "../snapshot/snapshot.h"
+#include "../circuit/circuit.h"
 
 #include <stdbool.h>
 
@@ -60,6 +73,19 @@ int main (int argc, char *argv[])
   }
 
   cunit_base64_test_init ();
+  cunit_jsonbuf_test_init ();
+  cunit_floatfmt_test_init ();
+  cunit_jsonscan_test_init ();
+  cunit_jsonsax_test_init ();
+  cunit_cron_test_init ();
+  cunit_devqueue_test_init ();
+  cunit_intern_test_init ();
+  cunit_mqttwire_test_init ();
+  cunit_eventring_test_init ();
+  cunit_bufpool_test_init ();
+  cunit_map_test_init ();
+  cunit_snapshot_test_init ();
+  cunit_circuit_test_init ();
 
   CU_set_error_action (error_action);
 
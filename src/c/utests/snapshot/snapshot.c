@@ -0,0 +1,223 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#include "CUnit.h"
+#include "snapshot.h"
+#include "../../snapshot.h"
+#include "../../edgex-rest.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define TEST_FILE "csdk-utest-snapshot"
+
+static const char *devjson[] =
+{
+  "{\"name\":\"dev1\",\"id\":\"id1\",\"adminState\":\"UNLOCKED\",\"operatingState\":\"ENABLED\","
+  "\"description\":\"First\",\"labels\":[\"a\",\"b\"],\"protocols\":{\"modbus\":{\"Address\":\"1\"}},"
+  "\"profile\":{\"name\":\"prof1\",\"id\":\"p1\"},\"service\":{\"name\":\"svc\"}}",
+  "{\"name\":\"dev2\",\"id\":\"id2\",\"adminState\":\"LOCKED\",\"operatingState\":\"ENABLED\","
+  "\"description\":\"Second\",\"labels\":[],\"protocols\":{\"modbus\":{\"Address\":\"2\"}},"
+  "\"profile\":{\"name\":\"prof2\",\"id\":\"p2\"},\"service\":{\"name\":\"svc\"}}"
+};
+
+static char *buf;
+static size_t size;
+
+static int suite_init (void)
+{
+  return 0;
+}
+
+static int suite_clean (void)
+{
+  unlink (TEST_FILE);
+  return 0;
+}
+
+static edgex_devmap_t *make_map (void)
+{
+  edgex_devmap_t *map = edgex_devmap_alloc (NULL);
+  for (unsigned i = 0; i < sizeof (devjson) / sizeof (devjson[0]); i++)
+  {
+    edgex_device *dev = edgex_device_read (iot_logger_default (), devjson[i]);
+    CU_ASSERT_PTR_NOT_NULL_FATAL (dev);
+    edgex_devmap_replace_device (map, dev);
+    edgex_device_free (dev);
+  }
+  return map;
+}
+
+static void save (void)
+{
+  edgex_devmap_t *map = make_map ();
+  FILE *f;
+
+  CU_ASSERT_FATAL (edgex_snapshot_save (iot_logger_default (), TEST_FILE, map));
+  edgex_devmap_clear (map);
+  edgex_devmap_free (map);
+
+  free (buf);
+  f = fopen (TEST_FILE, "rb");
+  CU_ASSERT_PTR_NOT_NULL_FATAL (f);
+  fseek (f, 0, SEEK_END);
+  size = ftell (f);
+  fseek (f, 0, SEEK_SET);
+  buf = malloc (size);
+  CU_ASSERT_FATAL (fread (buf, 1, size, f) == size);
+  fclose (f);
+}
+
+/* Write the file saved, after modification, with its checksum recalculated if fix is set */
+
+static void rewrite (size_t len, bool fix)
+{
+  FILE *f = fopen (TEST_FILE, "wb");
+  if (fix)
+  {
+    uint32_t sum = 2166136261u;
+    for (size_t i = 0; i < len - sizeof (sum); i++)
+    {
+      sum = (sum ^ (unsigned char)buf[i]) * 16777619u;
+    }
+    memcpy (buf + len - sizeof (sum), &sum, sizeof (sum));
+  }
+  fwrite (buf, 1, len, f);
+  fclose (f);
+}
+
+static bool load (void)
+{
+  edgex_deviceprofile *profiles;
+  edgex_device *devices;
+  bool ok = edgex_snapshot_load (iot_logger_default (), TEST_FILE, &profiles, &devices);
+  if (!ok)
+  {
+    CU_ASSERT_PTR_NULL (profiles);
+    CU_ASSERT_PTR_NULL (devices);
+  }
+  edgex_deviceprofile_free (profiles);
+  edgex_device_free (devices);
+  return ok;
+}
+
+static void test_roundtrip (void)
+{
+  edgex_deviceprofile *profiles;
+  edgex_device *devices;
+  unsigned nprofiles = 0;
+  unsigned ndevices = 0;
+
+  save ();
+  CU_ASSERT_FATAL (edgex_snapshot_load (iot_logger_default (), TEST_FILE, &profiles, &devices));
+  for (const edgex_deviceprofile *p = profiles; p; p = p->next)
+  {
+    CU_ASSERT (strcmp (p->name, "prof1") == 0 || strcmp (p->name, "prof2") == 0);
+    nprofiles++;
+  }
+  for (const edgex_device *d = devices; d; d = d->next)
+  {
+    bool first = strcmp (d->name, "dev1") == 0;
+    CU_ASSERT (first || strcmp (d->name, "dev2") == 0);
+    CU_ASSERT_STRING_EQUAL (d->id, first ? "id1" : "id2");
+    CU_ASSERT_STRING_EQUAL (d->description, first ? "First" : "Second");
+    CU_ASSERT_STRING_EQUAL (d->profile->name, first ? "prof1" : "prof2");
+    CU_ASSERT_EQUAL (d->adminState, first ? UNLOCKED : LOCKED);
+    CU_ASSERT_STRING_EQUAL (d->protocols->name, "modbus");
+    CU_ASSERT_STRING_EQUAL (d->protocols->properties->value, first ? "1" : "2");
+    if (first)
+    {
+      CU_ASSERT_PTR_NOT_NULL_FATAL (d->labels);
+      CU_ASSERT_PTR_NOT_NULL_FATAL (d->labels->next);
+    }
+    else
+    {
+      CU_ASSERT_PTR_NULL (d->labels);
+    }
+    ndevices++;
+  }
+  CU_ASSERT_EQUAL (nprofiles, 2);
+  CU_ASSERT_EQUAL (ndevices, 2);
+  edgex_deviceprofile_free (profiles);
+  edgex_device_free (devices);
+}
+
+static void test_missing (void)
+{
+  unlink (TEST_FILE);
+  CU_ASSERT (!load ());
+}
+
+static void test_checksum (void)
+{
+  save ();
+  buf[size / 2] ^= 0x20;
+  rewrite (size, false);
+  CU_ASSERT (!load ());
+  buf[size / 2] ^= 0x20;
+  rewrite (size, false);
+  CU_ASSERT (load ());
+}
+
+static void test_truncated (void)
+{
+  save ();
+  rewrite (size - 1, false);
+  CU_ASSERT (!load ());
+  rewrite (20, false);
+  CU_ASSERT (!load ());
+  rewrite (3, false);
+  CU_ASSERT (!load ());
+
+  /* A shortened record area is rejected even with a valid checksum */
+
+  save ();
+  memmove (buf + size - 40, buf + size - 4, 4);
+  rewrite (size - 36, true);
+  CU_ASSERT (!load ());
+}
+
+static void test_header (void)
+{
+  uint32_t word;
+
+  save ();
+  memcpy (&word, buf + 4, sizeof (word));
+  word++;
+  memcpy (buf + 4, &word, sizeof (word));
+  rewrite (size, true);
+  CU_ASSERT (!load ());
+
+  /* Counts which overrun the records */
+
+  save ();
+  memcpy (&word, buf + 12, sizeof (word));
+  word++;
+  memcpy (buf + 12, &word, sizeof (word));
+  rewrite (size, true);
+  CU_ASSERT (!load ());
+
+  save ();
+  buf[0] = 'X';
+  rewrite (size, true);
+  CU_ASSERT (!load ());
+  free (buf);
+  buf = NULL;
+}
+
+void cunit_snapshot_test_init (void)
+{
+  CU_pSuite suite = CU_add_suite ("snapshot", suite_init, suite_clean);
+  CU_add_test (suite, "test_roundtrip", test_roundtrip);
+  CU_add_test (suite, "test_missing", test_missing);
+  CU_add_test (suite, "test_checksum", test_checksum);
+  CU_add_test (suite, "test_truncated", test_truncated);
+  CU_add_test (suite, "test_header", test_header);
+}
@@ -0,0 +1,310 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#include "watchers.h"
+#include "errorlist.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <regex.h>
+
+typedef struct watch_entry
+{
+  unsigned index;
+  char *name;
+  char *profile;
+  char *key;
+  bool hasmatch;
+  regex_t match;
+  unsigned nids;
+  char **idkeys;
+  regex_t *idmatch;
+  struct watch_entry *next;
+} watch_entry;
+
+struct edgex_watchlist_t
+{
+  watch_entry *entries;
+  unsigned count;
+  edgex_map_void bykey;
+  edgex_map_void byvalue;
+};
+
+static char *watch_valuekey (const char *key, const char *value)
+{
+  size_t sz = strlen (key) + strlen (value) + 2;
+  char *result = malloc (sz);
+  snprintf (result, sz, "%s\x1f%s", key, value);
+  return result;
+}
+
+/* If the expression matches exactly one string, return it. Escaped punctuation is allowed, as in ^10\.0\.0\.1$ */
+
+static char *watch_literal (const char *re)
+{
+  size_t len = strlen (re);
+  char *result;
+  char *out;
+
+  if (len < 2 || re[0] != '^' || re[len - 1] != '$' || (len > 2 && re[len - 2] == '\\'))
+  {
+    return NULL;
+  }
+  result = out = malloc (len);
+  for (const char *c = re + 1; c < re + len - 1; c++)
+  {
+    if (*c == '\\' && ispunct ((unsigned char)c[1]))
+    {
+      *out++ = *++c;
+    }
+    else if (strchr (".[]()*+?{}|\\^$", *c))
+    {
+      free (result);
+      return NULL;
+    }
+    else
+    {
+      *out++ = *c;
+    }
+  }
+  *out = '\0';
+  return result;
+}
+
+static bool watch_compile (iot_logger_t *lc, const char *watcher, regex_t *re, const char *str)
+{
+  int rc = regcomp (re, str, REG_EXTENDED | REG_NOSUB);
+  if (rc)
+  {
+    char msg[128];
+    regerror (rc, re, msg, sizeof (msg));
+    iot_log_error (lc, "Watcher %s: invalid expression %s: %s", watcher, str, msg);
+    return false;
+  }
+  return true;
+}
+
+static int watch_cmp (const void *a, const void *b)
+{
+  return strcmp (*(const char * const *)a, *(const char * const *)b);
+}
+
+static bool watch_entry_init
+  (iot_logger_t *lc, watch_entry *e, const char *name, const edgex_device_watcherinfo *w)
+{
+  e->name = strdup (name);
+  e->profile = strdup (w->profile);
+  e->key = strdup (w->key);
+  if (w->matchstring && *w->matchstring)
+  {
+    if (!watch_compile (lc, name, &e->match, w->matchstring))
+    {
+      return false;
+    }
+    e->hasmatch = true;
+  }
+  for (char **id = w->ids; id && *id; id++)
+  {
+    e->nids++;
+  }
+  e->idkeys = calloc (e->nids + 1, sizeof (char *));
+  e->idmatch = calloc (e->nids + 1, sizeof (regex_t));
+  for (unsigned i = 0; i < e->nids; i++)
+  {
+    const char *eq = strchr (w->ids[i], '=');
+    if (eq == NULL || eq == w->ids[i])
+    {
+      iot_log_error (lc, "Watcher %s: identifier %s should be of the form Property=Regex", name, w->ids[i]);
+      e->nids = i;
+      return false;
+    }
+    if (!watch_compile (lc, name, &e->idmatch[i], eq + 1))
+    {
+      e->nids = i;
+      return false;
+    }
+    e->idkeys[i] = strndup (w->ids[i], eq - w->ids[i]);
+  }
+  return true;
+}
+
+static void watch_entry_fini (watch_entry *e)
+{
+  if (e->hasmatch)
+  {
+    regfree (&e->match);
+  }
+  for (unsigned i = 0; i < e->nids; i++)
+  {
+    regfree (&e->idmatch[i]);
+    free (e->idkeys[i]);
+  }
+  free (e->idkeys);
+  free (e->idmatch);
+  free (e->name);
+  free (e->profile);
+  free (e->key);
+}
+
+edgex_watchlist_t *edgex_watchlist_alloc
+  (iot_logger_t *lc, edgex_map_device_watcherinfo *watchers, edgex_error *err)
+{
+  edgex_watchlist_t *wl = calloc (1, sizeof (edgex_watchlist_t));
+  edgex_map_iter iter = edgex_map_iter (*watchers);
+  const char *name;
+  const char **names;
+  unsigned n = 0;
+
+  edgex_map_init (&wl->bykey);
+  edgex_map_init (&wl->byvalue);
+
+  /* Entries are ordered by name, so that the first matching a device is found by the lowest index */
+
+  names = malloc ((edgex_map_size (watchers) + 1) * sizeof (char *));
+  while ((name = edgex_map_next (watchers, &iter)))
+  {
+    names[n++] = name;
+  }
+  qsort (names, n, sizeof (char *), watch_cmp);
+
+  wl->entries = calloc (n, sizeof (watch_entry));
+  for (wl->count = 0; wl->count < n; wl->count++)
+  {
+    watch_entry *e = &wl->entries[wl->count];
+    e->index = wl->count;
+    if (!watch_entry_init (lc, e, names[wl->count], edgex_map_get (watchers, names[wl->count])))
+    {
+      wl->count++;
+      free (names);
+      edgex_watchlist_free (wl);
+      *err = EDGEX_BAD_CONFIG;
+      return NULL;
+    }
+  }
+  free (names);
+
+  /* Build the indexes in reverse, so that each list is in index order */
+
+  for (unsigned i = wl->count; i-- > 0; )
+  {
+    watch_entry *e = &wl->entries[i];
+    void **head;
+    char *lit = NULL;
+    char *vkey = NULL;
+
+    if (e->hasmatch)
+    {
+      lit = watch_literal (edgex_map_get (watchers, e->name)->matchstring);
+    }
+    if (lit)
+    {
+      vkey = watch_valuekey (e->key, lit);
+      head = edgex_map_get (&wl->byvalue, vkey);
+      e->next = head ? *head : NULL;
+      edgex_map_set (&wl->byvalue, vkey, e);
+    }
+    else
+    {
+      head = edgex_map_get (&wl->bykey, e->key);
+      e->next = head ? *head : NULL;
+      edgex_map_set (&wl->bykey, e->key, e);
+    }
+    free (vkey);
+    free (lit);
+  }
+  return wl;
+}
+
+static bool watch_identifiers (const watch_entry *e, const edgex_protocols *p)
+{
+  for (unsigned i = 0; i < e->nids; i++)
+  {
+    const edgex_nvpairs *nv;
+    for (nv = p->properties; nv; nv = nv->next)
+    {
+      if (strcmp (nv->name, e->idkeys[i]) == 0)
+      {
+        break;
+      }
+    }
+    if (nv == NULL || regexec (&e->idmatch[i], nv->value, 0, NULL, 0))
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool edgex_watchlist_match (edgex_watchlist_t *wl, const edgex_protocols *prots, edgex_watchmatch *match)
+{
+  const watch_entry *best = NULL;
+
+  for (const edgex_protocols *p = prots; p; p = p->next)
+  {
+    for (const edgex_nvpairs *nv = p->properties; nv; nv = nv->next)
+    {
+      void **head;
+      if (edgex_map_size (&wl->byvalue))
+      {
+        char *vkey = watch_valuekey (nv->name, nv->value);
+        head = edgex_map_get (&wl->byvalue, vkey);
+        free (vkey);
+        for (const watch_entry *e = head ? *head : NULL; e && (best == NULL || e->index < best->index); e = e->next)
+        {
+          if (watch_identifiers (e, p))
+          {
+            best = e;
+            match->protocol = p->name;
+            match->value = nv->value;
+            break;
+          }
+        }
+      }
+      head = edgex_map_get (&wl->bykey, nv->name);
+      for (const watch_entry *e = head ? *head : NULL; e && (best == NULL || e->index < best->index); e = e->next)
+      {
+        if ((!e->hasmatch || regexec (&e->match, nv->value, 0, NULL, 0) == 0) && watch_identifiers (e, p))
+        {
+          best = e;
+          match->protocol = p->name;
+          match->value = nv->value;
+          break;
+        }
+      }
+    }
+  }
+
+  if (best)
+  {
+    match->watcher = best->name;
+    match->profile = best->profile;
+    match->key = best->key;
+  }
+  return best;
+}
+
+unsigned edgex_watchlist_size (const edgex_watchlist_t *wl)
+{
+  return wl->count;
+}
+
+void edgex_watchlist_free (edgex_watchlist_t *wl)
+{
+  if (wl)
+  {
+    for (unsigned i = 0; i < wl->count; i++)
+    {
+      watch_entry_fini (&wl->entries[i]);
+    }
+    free (wl->entries);
+    edgex_map_deinit (&wl->bykey);
+    edgex_map_deinit (&wl->byvalue);
+    free (wl);
+  }
+}
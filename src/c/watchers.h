@@ -0,0 +1,51 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#ifndef _EDGEX_DEVICE_WATCHERS_H_
+#define _EDGEX_DEVICE_WATCHERS_H_ 1
+
+#include "config.h"
+
+/*
+ * Provision watchers, compiled for matching discovered devices. A watcher
+ * matches a device which has, in one of its protocols, a property named by
+ * the watcher's Key whose value matches its MatchString (an extended regular
+ * expression; if not set any value matches), and whose properties named in
+ * its Identifiers (each of the form Property=Regex) also match.
+ *
+ * The watchers are indexed by Key, and those whose MatchString is an anchored
+ * literal (such as ^sensor-1$ or ^10\.0\.0\.1$) are indexed by Key and
+ * value, so that matching a device involves only the watchers which could
+ * match it. If several match, the first by name is used.
+ */
+
+typedef struct edgex_watchlist_t edgex_watchlist_t;
+
+typedef struct edgex_watchmatch
+{
+  const char *watcher;
+  const char *profile;
+  const char *protocol;
+  const char *key;
+  const char *value;
+} edgex_watchmatch;
+
+/* Compile the watchers. Fails with EDGEX_BAD_CONFIG if an expression is invalid */
+
+edgex_watchlist_t *edgex_watchlist_alloc
+  (iot_logger_t *lc, edgex_map_device_watcherinfo *watchers, edgex_error *err);
+
+/* Find the watcher for a device. The strings in the match refer to the watcher and to prots */
+
+bool edgex_watchlist_match (edgex_watchlist_t *wl, const edgex_protocols *prots, edgex_watchmatch *match);
+
+unsigned edgex_watchlist_size (const edgex_watchlist_t *wl);
+
+void edgex_watchlist_free (edgex_watchlist_t *wl);
+
+#endif